@@ -0,0 +1,166 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/benchmark/get/get.h"
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+
+#include "apps/ledger/benchmark/lib/data.h"
+#include "apps/ledger/benchmark/lib/get_ledger.h"
+#include "apps/ledger/benchmark/lib/logging.h"
+#include "apps/ledger/benchmark/lib/populate.h"
+#include "apps/tracing/lib/trace/event.h"
+#include "apps/tracing/lib/trace/provider.h"
+#include "lib/ftl/command_line.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/random/rand.h"
+#include "lib/ftl/strings/string_number_conversions.h"
+#include "lib/mtl/tasks/message_loop.h"
+
+namespace {
+constexpr ftl::StringView kStoragePath = "/data/benchmark/ledger/get";
+constexpr ftl::StringView kEntryCountFlag = "entry-count";
+constexpr ftl::StringView kValueSizeFlag = "value-size";
+
+void PrintUsage(const char* executable_name) {
+  std::cout << "Usage: " << executable_name << " --" << kEntryCountFlag
+            << "=<int> --" << kValueSizeFlag << "=<int>" << std::endl;
+}
+
+}  // namespace
+
+namespace benchmark {
+
+GetBenchmark::GetBenchmark(int entry_count, int value_size)
+    : tmp_dir_(kStoragePath),
+      application_context_(app::ApplicationContext::CreateFromStartupInfo()),
+      entry_count_(entry_count),
+      value_size_(value_size) {
+  FTL_DCHECK(entry_count > 0);
+  FTL_DCHECK(value_size > 0);
+  tracing::InitializeTracer(application_context_.get(),
+                            {"benchmark_ledger_get"});
+}
+
+void GetBenchmark::Run() {
+  for (int i = 0; i < entry_count_; i++) {
+    keys_.push_back(benchmark::MakeKey(i));
+    read_order_.push_back(i);
+  }
+  std::default_random_engine rng(ftl::RandUint64());
+  std::shuffle(read_order_.begin(), read_order_.end(), rng);
+
+  ledger_ = benchmark::GetLedger(application_context_.get(),
+                                 &ledger_controller_, "get", tmp_dir_.path(),
+                                 false, "");
+  benchmark::GetPageEnsureInitialized(
+      ledger_.get(), nullptr, [this](ledger::PagePtr page, auto id) {
+        page_ = std::move(page);
+        page_id_ = std::move(id);
+        TRACE_ASYNC_BEGIN("benchmark", "populate", 0);
+        benchmark::PopulatePage(
+            page_.get(), keys_, value_size_, [this](ledger::Status status) {
+              if (benchmark::QuitOnError(status, "PopulatePage")) {
+                return;
+              }
+              TRACE_ASYNC_END("benchmark", "populate", 0);
+              Restart();
+            });
+      });
+}
+
+void GetBenchmark::Restart() {
+  // Close the connections first, so that killing the Ledger process does not
+  // trigger their error handlers.
+  page_.reset();
+  ledger_.reset();
+  ledger_controller_->Kill();
+  ledger_controller_.WaitForIncomingResponseWithTimeout(
+      ftl::TimeDelta::FromSeconds(5));
+
+  ledger_ = benchmark::GetLedger(application_context_.get(),
+                                 &ledger_controller_, "get", tmp_dir_.path(),
+                                 false, "");
+  benchmark::GetPageEnsureInitialized(ledger_.get(), page_id_.Clone(),
+                                      [this](ledger::PagePtr page, auto id) {
+                                        page_ = std::move(page);
+                                        GetSnapshot();
+                                      });
+}
+
+void GetBenchmark::GetSnapshot() {
+  page_->GetSnapshot(snapshot_.NewRequest(), nullptr, nullptr,
+                     [this](ledger::Status status) {
+                       if (benchmark::QuitOnError(status, "GetSnapshot")) {
+                         return;
+                       }
+                       RunSingle(0, false);
+                     });
+}
+
+void GetBenchmark::RunSingle(size_t i, bool hot) {
+  if (i == read_order_.size()) {
+    if (hot) {
+      ShutDown();
+    } else {
+      RunSingle(0, true);
+    }
+    return;
+  }
+
+  if (hot) {
+    TRACE_ASYNC_BEGIN("benchmark", "get hot", i);
+  } else {
+    TRACE_ASYNC_BEGIN("benchmark", "get cold", i);
+  }
+  snapshot_->Get(keys_[read_order_[i]].Clone(),
+                 [this, i, hot](ledger::Status status, auto value) {
+                   if (benchmark::QuitOnError(status, "PageSnapshot::Get")) {
+                     return;
+                   }
+                   if (hot) {
+                     TRACE_ASYNC_END("benchmark", "get hot", i);
+                   } else {
+                     TRACE_ASYNC_END("benchmark", "get cold", i);
+                   }
+                   RunSingle(i + 1, hot);
+                 });
+}
+
+void GetBenchmark::ShutDown() {
+  // Shut down the Ledger process first as it relies on |tmp_dir_| storage.
+  ledger_controller_->Kill();
+  ledger_controller_.WaitForIncomingResponseWithTimeout(
+      ftl::TimeDelta::FromSeconds(5));
+  mtl::MessageLoop::GetCurrent()->PostQuitTask();
+}
+}  // namespace benchmark
+
+int main(int argc, const char** argv) {
+  ftl::CommandLine command_line = ftl::CommandLineFromArgcArgv(argc, argv);
+
+  std::string entry_count_str;
+  int entry_count;
+  std::string value_size_str;
+  int value_size;
+  if (!command_line.GetOptionValue(kEntryCountFlag.ToString(),
+                                   &entry_count_str) ||
+      !ftl::StringToNumberWithError(entry_count_str, &entry_count) ||
+      entry_count <= 0 ||
+      !command_line.GetOptionValue(kValueSizeFlag.ToString(),
+                                   &value_size_str) ||
+      !ftl::StringToNumberWithError(value_size_str, &value_size) ||
+      value_size <= 0) {
+    PrintUsage(argv[0]);
+    return -1;
+  }
+
+  mtl::MessageLoop loop;
+  benchmark::GetBenchmark app(entry_count, value_size);
+  loop.task_runner()->PostTask([&app] { app.Run(); });
+  loop.Run();
+  return 0;
+}
@@ -0,0 +1,64 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_BENCHMARK_GET_GET_H_
+#define APPS_LEDGER_BENCHMARK_GET_GET_H_
+
+#include <memory>
+#include <vector>
+
+#include "application/lib/app/application_context.h"
+#include "apps/ledger/services/public/ledger.fidl.h"
+#include "lib/ftl/files/scoped_temp_dir.h"
+
+namespace benchmark {
+
+// Benchmark that measures performance of the PageSnapshot.Get() operation.
+//
+// The page is first populated with |entry_count| entries, and the Ledger
+// application is restarted so that the first reads are served from disk. Each
+// key is then read once in random order ("get cold"), and the same reads are
+// repeated on the same snapshot ("get hot").
+//
+// Parameters:
+//   --entry-count=<int> the number of entries in the page
+//   --value-size=<int> the size of a single value in bytes
+class GetBenchmark {
+ public:
+  GetBenchmark(int entry_count, int value_size);
+
+  void Run();
+
+ private:
+  // Restarts the Ledger application and reads the entries from a new snapshot.
+  void Restart();
+
+  void GetSnapshot();
+
+  // Reads the entries in the order of |read_order_|, starting at the |i|-th
+  // one. |hot| indicates whether the entries were already read.
+  void RunSingle(size_t i, bool hot);
+
+  void ShutDown();
+
+  files::ScopedTempDir tmp_dir_;
+  std::unique_ptr<app::ApplicationContext> application_context_;
+  const int entry_count_;
+  const int value_size_;
+
+  std::vector<fidl::Array<uint8_t>> keys_;
+  // Indices in |keys_| of the entries to read.
+  std::vector<size_t> read_order_;
+  fidl::Array<uint8_t> page_id_;
+  app::ApplicationControllerPtr ledger_controller_;
+  ledger::LedgerPtr ledger_;
+  ledger::PagePtr page_;
+  ledger::PageSnapshotPtr snapshot_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(GetBenchmark);
+};
+
+}  // namespace benchmark
+
+#endif  // APPS_LEDGER_BENCHMARK_GET_GET_H_
@@ -9,28 +9,36 @@
 #include "application/lib/app/connect.h"
 #include "apps/ledger/benchmark/lib/convert.h"
 #include "apps/ledger/benchmark/lib/logging.h"
-#include "apps/ledger/services/internal/internal.fidl.h"
 #include "lib/ftl/functional/make_copyable.h"
 #include "lib/ftl/logging.h"
 #include "lib/mtl/tasks/message_loop.h"
 
 namespace benchmark {
 
-ledger::LedgerPtr GetLedger(app::ApplicationContext* context,
-                            app::ApplicationControllerPtr* controller,
-                            std::string ledger_name,
-                            std::string ledger_repository_path,
-                            bool sync,
-                            std::string server_id) {
+ledger::LedgerRepositoryFactoryPtr LaunchLedger(
+    app::ApplicationContext* context,
+    app::ApplicationControllerPtr* controller,
+    std::vector<std::string> arguments) {
   ledger::LedgerRepositoryFactoryPtr repository_factory;
   app::ServiceProviderPtr child_services;
   auto launch_info = app::ApplicationLaunchInfo::New();
   launch_info->url = "file:///system/apps/ledger";
+  for (auto& argument : arguments) {
+    launch_info->arguments.push_back(std::move(argument));
+  }
   launch_info->services = child_services.NewRequest();
   context->launcher()->CreateApplication(std::move(launch_info),
                                          controller->NewRequest());
   app::ConnectToService(child_services.get(), repository_factory.NewRequest());
+  return repository_factory;
+}
 
+ledger::LedgerPtr GetLedgerFromFactory(
+    ledger::LedgerRepositoryFactory* repository_factory,
+    std::string ledger_name,
+    std::string ledger_repository_path,
+    bool sync,
+    std::string server_id) {
   ledger::LedgerRepositoryPtr repository;
   fidl::String fidl_server_id = sync ? fidl::String(server_id) : fidl::String();
   repository_factory->GetRepository(
@@ -47,6 +55,19 @@ ledger::LedgerPtr GetLedger(app::ApplicationContext* context,
   return ledger;
 }
 
+ledger::LedgerPtr GetLedger(app::ApplicationContext* context,
+                            app::ApplicationControllerPtr* controller,
+                            std::string ledger_name,
+                            std::string ledger_repository_path,
+                            bool sync,
+                            std::string server_id) {
+  ledger::LedgerRepositoryFactoryPtr repository_factory =
+      LaunchLedger(context, controller, {});
+  return GetLedgerFromFactory(repository_factory.get(), std::move(ledger_name),
+                              std::move(ledger_repository_path), sync,
+                              std::move(server_id));
+}
+
 void GetPageEnsureInitialized(
     ledger::Ledger* ledger,
     fidl::Array<uint8_t> id,
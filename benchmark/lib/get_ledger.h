@@ -7,13 +7,35 @@
 
 #include <functional>
 #include <string>
+#include <vector>
 
 #include "application/lib/app/application_context.h"
+#include "apps/ledger/services/internal/internal.fidl.h"
 #include "apps/ledger/services/public/ledger.fidl.h"
 #include "lib/ftl/strings/string_view.h"
 
 namespace benchmark {
 
+// Starts a new Ledger application with the given command line |arguments| and
+// returns its repository factory.
+ledger::LedgerRepositoryFactoryPtr LaunchLedger(
+    app::ApplicationContext* context,
+    app::ApplicationControllerPtr* controller,
+    std::vector<std::string> arguments);
+
+// Retrieves the Ledger instance |ledger_name| of the repository at
+// |ledger_repository_path|, using |repository_factory|. Several repositories
+// retrieved from the same factory are served by the same Ledger application.
+ledger::LedgerPtr GetLedgerFromFactory(
+    ledger::LedgerRepositoryFactory* repository_factory,
+    std::string ledger_name,
+    std::string ledger_repository_path,
+    bool sync,
+    std::string server_id);
+
+// Starts a new Ledger application and retrieves the Ledger instance
+// |ledger_name| of the repository at |ledger_repository_path|.
+//
 // TODO(ppi): take the server_id as std::optional<std::string> and drop bool
 // sync once we're on C++17.
 ledger::LedgerPtr GetLedger(app::ApplicationContext* context,
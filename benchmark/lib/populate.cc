@@ -0,0 +1,28 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/benchmark/lib/populate.h"
+
+#include <utility>
+
+#include "apps/ledger/benchmark/lib/data.h"
+#include "apps/ledger/benchmark/lib/logging.h"
+
+namespace benchmark {
+
+void PopulatePage(ledger::Page* page,
+                  const std::vector<fidl::Array<uint8_t>>& keys,
+                  size_t value_size,
+                  std::function<void(ledger::Status)> callback) {
+  // Calls on the page connection are processed in order, so that all the puts
+  // are part of the transaction and done before the commit returns.
+  page->StartTransaction(QuitOnErrorCallback("Page::StartTransaction"));
+  for (const auto& key : keys) {
+    page->Put(key.Clone(), MakeValue(value_size),
+              QuitOnErrorCallback("Page::Put"));
+  }
+  page->Commit(std::move(callback));
+}
+
+}  // namespace benchmark
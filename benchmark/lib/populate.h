@@ -0,0 +1,27 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_BENCHMARK_LIB_POPULATE_H_
+#define APPS_LEDGER_BENCHMARK_LIB_POPULATE_H_
+
+#include <functional>
+#include <vector>
+
+#include "apps/ledger/services/public/ledger.fidl.h"
+#include "lib/fidl/cpp/bindings/array.h"
+
+namespace benchmark {
+
+// Puts an entry for each of the given |keys| in |page|, with random values of
+// |value_size| bytes, in a single transaction. |callback| is called with the
+// status of the commit of the transaction. Errors of the individual puts quit
+// the message loop.
+void PopulatePage(ledger::Page* page,
+                  const std::vector<fidl::Array<uint8_t>>& keys,
+                  size_t value_size,
+                  std::function<void(ledger::Status)> callback);
+
+}  // namespace benchmark
+
+#endif  // APPS_LEDGER_BENCHMARK_LIB_POPULATE_H_
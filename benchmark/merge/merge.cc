@@ -0,0 +1,475 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/benchmark/merge/merge.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+#include "apps/ledger/src/app/merging/auto_merge_strategy.h"
+#include "apps/ledger/src/app/merging/common_ancestor.h"
+#include "apps/ledger/src/app/merging/custom_merge_strategy.h"
+#include "apps/ledger/src/app/merging/last_one_wins_merge_strategy.h"
+#include "apps/ledger/src/app/merging/merge_resolver.h"
+#include "apps/ledger/src/storage/impl/page_storage_impl.h"
+#include "apps/tracing/lib/trace/event.h"
+#include "apps/tracing/lib/trace/provider.h"
+#include "lib/ftl/command_line.h"
+#include "lib/ftl/functional/make_copyable.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/strings/string_number_conversions.h"
+#include "lib/ftl/strings/string_printf.h"
+#include "lib/mtl/socket/strings.h"
+#include "lib/mtl/tasks/message_loop.h"
+#include "lib/mtl/threading/create_thread.h"
+
+namespace {
+constexpr ftl::StringView kStoragePath = "/data/benchmark/ledger/merge";
+constexpr ftl::StringView kStrategyFlag = "strategy";
+constexpr ftl::StringView kDepthFlag = "depth";
+constexpr ftl::StringView kChangeCountFlag = "change-count";
+constexpr ftl::StringView kOverlapPercentFlag = "overlap-percent";
+constexpr ftl::StringView kValueSizeFlag = "value-size";
+constexpr ftl::StringView kIterationCountFlag = "iteration-count";
+constexpr ftl::StringView kSeedFlag = "seed";
+
+constexpr ftl::StringView kLastOneWinsStrategy = "last_one_wins";
+constexpr ftl::StringView kAutomaticStrategy = "automatic_with_fallback";
+constexpr ftl::StringView kCustomStrategy = "custom";
+
+void PrintUsage(const char* executable_name) {
+  std::cout << "Usage: " << executable_name << " --" << kStrategyFlag << "=("
+            << kLastOneWinsStrategy << "|" << kAutomaticStrategy << "|"
+            << kCustomStrategy << ") --" << kDepthFlag << "=<int> --"
+            << kChangeCountFlag << "=<int> --" << kOverlapPercentFlag
+            << "=<int> --" << kValueSizeFlag << "=<int> --"
+            << kIterationCountFlag << "=<int> [--" << kSeedFlag << "=<int>]"
+            << std::endl;
+}
+
+bool ParseStrategy(const std::string& value, ledger::MergePolicy* policy) {
+  if (value == kLastOneWinsStrategy) {
+    *policy = ledger::MergePolicy::LAST_ONE_WINS;
+  } else if (value == kAutomaticStrategy) {
+    *policy = ledger::MergePolicy::AUTOMATIC_WITH_FALLBACK;
+  } else if (value == kCustomStrategy) {
+    *policy = ledger::MergePolicy::CUSTOM;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool GetSizeOption(const ftl::CommandLine& command_line,
+                   ftl::StringView flag,
+                   size_t* value) {
+  std::string value_str;
+  return command_line.GetOptionValue(flag.ToString(), &value_str) &&
+         ftl::StringToNumberWithError(value_str, value);
+}
+
+}  // namespace
+
+namespace benchmark {
+
+MergeBenchmark::ConflictResolverImpl::ConflictResolverImpl(
+    fidl::InterfaceRequest<ledger::ConflictResolver> request)
+    : binding_(this, std::move(request)) {}
+
+MergeBenchmark::ConflictResolverImpl::~ConflictResolverImpl() {}
+
+void MergeBenchmark::ConflictResolverImpl::Resolve(
+    fidl::InterfaceHandle<ledger::PageSnapshot> left_version,
+    fidl::InterfaceHandle<ledger::PageSnapshot> right_version,
+    fidl::InterfaceHandle<ledger::PageSnapshot> common_version,
+    fidl::InterfaceHandle<ledger::MergeResultProvider> result_provider) {
+  result_provider_ =
+      ledger::MergeResultProviderPtr::Create(std::move(result_provider));
+  MergeRightDiff(nullptr);
+}
+
+void MergeBenchmark::ConflictResolverImpl::MergeRightDiff(
+    fidl::Array<uint8_t> token) {
+  result_provider_->GetRightDiff(
+      std::move(token), [this](ledger::Status status,
+                               ledger::PageChangePtr change,
+                               fidl::Array<uint8_t> next_token) {
+        if (status != ledger::Status::OK &&
+            status != ledger::Status::PARTIAL_RESULT) {
+          FTL_LOG(ERROR) << "MergeResultProvider::GetRightDiff failed.";
+          mtl::MessageLoop::GetCurrent()->PostQuitTask();
+          return;
+        }
+        auto merged_values = fidl::Array<ledger::MergedValuePtr>::New(0);
+        if (change) {
+          for (auto& entry : change->changes) {
+            auto merged_value = ledger::MergedValue::New();
+            merged_value->key = std::move(entry->key);
+            merged_value->source = ledger::ValueSource::RIGHT;
+            merged_value->priority = entry->priority;
+            merged_values.push_back(std::move(merged_value));
+          }
+          for (auto& key : change->deleted_keys) {
+            auto merged_value = ledger::MergedValue::New();
+            merged_value->key = std::move(key);
+            merged_value->source = ledger::ValueSource::DELETE;
+            merged_values.push_back(std::move(merged_value));
+          }
+        }
+        result_provider_->Merge(
+            std::move(merged_values), [](ledger::Status status) {
+              if (status != ledger::Status::OK) {
+                FTL_LOG(ERROR) << "MergeResultProvider::Merge failed.";
+                mtl::MessageLoop::GetCurrent()->PostQuitTask();
+              }
+            });
+        if (next_token) {
+          MergeRightDiff(std::move(next_token));
+          return;
+        }
+        Done();
+      });
+}
+
+void MergeBenchmark::ConflictResolverImpl::Done() {
+  result_provider_->Done([](ledger::Status status) {
+    if (status != ledger::Status::OK) {
+      FTL_LOG(ERROR) << "MergeResultProvider::Done failed.";
+      mtl::MessageLoop::GetCurrent()->PostQuitTask();
+    }
+  });
+}
+
+MergeBenchmark::MergeBenchmark(ledger::MergePolicy policy,
+                               size_t depth,
+                               size_t change_count,
+                               size_t overlap_percent,
+                               size_t value_size,
+                               size_t iteration_count,
+                               uint64_t seed)
+    : application_context_(app::ApplicationContext::CreateFromStartupInfo()),
+      tmp_dir_(kStoragePath),
+      policy_(policy),
+      depth_(depth),
+      change_count_(change_count),
+      overlap_count_((change_count * overlap_percent + 50) / 100),
+      value_size_(value_size),
+      iteration_count_(iteration_count),
+      rng_(seed) {
+  FTL_DCHECK(depth > 0);
+  FTL_DCHECK(change_count > 0);
+  FTL_DCHECK(overlap_percent <= 100);
+  FTL_DCHECK(value_size > 0);
+  FTL_DCHECK(iteration_count > 0);
+  tracing::InitializeTracer(application_context_.get(),
+                            {"benchmark_ledger_merge"});
+  io_thread_ = mtl::CreateThread(&io_runner_, "io thread");
+  environment_ = std::make_unique<ledger::Environment>(
+      mtl::MessageLoop::GetCurrent()->task_runner(), nullptr, ftl::TimeDelta(),
+      io_runner_);
+}
+
+MergeBenchmark::~MergeBenchmark() {
+  strategy_.reset();
+  conflict_resolver_.reset();
+  page_manager_.reset();
+  io_runner_->PostTask([] { mtl::MessageLoop::GetCurrent()->QuitNow(); });
+  io_thread_.join();
+}
+
+void MergeBenchmark::Run() {
+  auto storage = std::make_unique<storage::PageStorageImpl>(
+      environment_->main_runner(), io_runner_,
+      environment_->coroutine_service(), tmp_dir_.path(), "benchmark_page");
+  storage::PageStorageImpl* storage_ptr = storage.get();
+  storage_ptr->Init(ftl::MakeCopyable([ this, storage = std::move(storage) ](
+      storage::Status status) mutable {
+    if (status != storage::Status::OK) {
+      QuitOnError(status, "PageStorageImpl::Init");
+      return;
+    }
+    storage_ = storage.get();
+    // The merge resolver of the page manager is not given any strategy, so
+    // that conflicts are only resolved by the benchmark.
+    auto merge_resolver = std::make_unique<ledger::MergeResolver>(
+        [] {}, environment_.get(), storage_);
+    page_manager_ = std::make_unique<ledger::PageManager>(
+        environment_.get(), std::move(storage), nullptr,
+        std::move(merge_resolver));
+    strategy_ = CreateStrategy();
+    strategy_->SetOnError([] {
+      FTL_LOG(ERROR) << "The merge strategy failed.";
+      mtl::MessageLoop::GetCurrent()->PostQuitTask();
+    });
+    value_ids_.resize(2 * change_count_);
+    CreateValues(0);
+  }));
+}
+
+void MergeBenchmark::CreateValues(size_t i) {
+  if (i == value_ids_.size()) {
+    RunIteration(0);
+    return;
+  }
+  std::uniform_int_distribution<int> byte_distribution(0, 255);
+  std::string value;
+  value.reserve(value_size_);
+  for (size_t j = 0; j < value_size_; ++j) {
+    value.push_back(static_cast<char>(byte_distribution(rng_)));
+  }
+  storage_->AddObjectFromLocal(
+      mtl::WriteStringToSocket(value), value.size(),
+      [this, i](storage::Status status, storage::ObjectId object_id) {
+        if (status != storage::Status::OK) {
+          QuitOnError(status, "PageStorage::AddObjectFromLocal");
+          return;
+        }
+        value_ids_[i] = std::move(object_id);
+        CreateValues(i + 1);
+      });
+}
+
+std::unique_ptr<ledger::MergeStrategy> MergeBenchmark::CreateStrategy() {
+  if (policy_ == ledger::MergePolicy::LAST_ONE_WINS) {
+    return std::make_unique<ledger::LastOneWinsMergeStrategy>();
+  }
+  ledger::ConflictResolverPtr conflict_resolver;
+  conflict_resolver_ =
+      std::make_unique<ConflictResolverImpl>(conflict_resolver.NewRequest());
+  if (policy_ == ledger::MergePolicy::AUTOMATIC_WITH_FALLBACK) {
+    return std::make_unique<ledger::AutoMergeStrategy>(
+        std::move(conflict_resolver));
+  }
+  FTL_DCHECK(policy_ == ledger::MergePolicy::CUSTOM);
+  return std::make_unique<ledger::CustomMergeStrategy>(
+      std::move(conflict_resolver));
+}
+
+void MergeBenchmark::RunIteration(size_t iteration) {
+  if (iteration == iteration_count_) {
+    PrintResults();
+    ShutDown();
+    return;
+  }
+
+  std::vector<storage::CommitId> heads;
+  storage::Status status = storage_->GetHeadCommitIds(&heads);
+  if (status != storage::Status::OK) {
+    QuitOnError(status, "PageStorage::GetHeadCommitIds");
+    return;
+  }
+  if (heads.size() != 1u) {
+    FTL_LOG(ERROR) << "Expected a single head, found " << heads.size() << ".";
+    ShutDown();
+    return;
+  }
+
+  storage::CommitId base_id = heads[0];
+  CreateBranch(iteration, true, 0, base_id,
+               [this, iteration, base_id](storage::CommitId left_id) {
+                 CreateBranch(iteration, false, 0, base_id, [
+                   this, iteration, left_id
+                 ](storage::CommitId right_id) {
+                   Merge(iteration, left_id, std::move(right_id));
+                 });
+               });
+}
+
+void MergeBenchmark::CreateBranch(
+    size_t iteration,
+    bool left,
+    size_t commit_index,
+    storage::CommitId parent_id,
+    std::function<void(storage::CommitId)> callback) {
+  if (commit_index == depth_) {
+    callback(std::move(parent_id));
+    return;
+  }
+
+  storage::Status status = storage_->StartCommit(
+      parent_id, storage::JournalType::IMPLICIT, &journal_);
+  if (status != storage::Status::OK) {
+    QuitOnError(status, "PageStorage::StartCommit");
+    return;
+  }
+  for (size_t i = 0; i < change_count_; ++i) {
+    const storage::ObjectId& value_id =
+        value_ids_[left ? i : change_count_ + i];
+    status = journal_->Put(GetKey(iteration, left, commit_index, i), value_id,
+                           storage::KeyPriority::EAGER);
+    if (status != storage::Status::OK) {
+      QuitOnError(status, "Journal::Put");
+      return;
+    }
+  }
+  journal_->Commit([ this, iteration, left, commit_index, callback ](
+      storage::Status status, std::unique_ptr<const storage::Commit> commit) {
+    if (status != storage::Status::OK) {
+      QuitOnError(status, "Journal::Commit");
+      return;
+    }
+    // The next commit replaces |journal_|, which must not be deleted while
+    // running this callback.
+    mtl::MessageLoop::GetCurrent()->task_runner()->PostTask([
+      this, iteration, left, commit_index, callback,
+      commit_id = commit->GetId()
+    ] {
+      CreateBranch(iteration, left, commit_index + 1, commit_id, callback);
+    });
+  });
+}
+
+std::string MergeBenchmark::GetKey(size_t iteration,
+                                   bool left,
+                                   size_t commit_index,
+                                   size_t change_index) const {
+  std::string key = ftl::StringPrintf("%06zu-%06zu-%06zu", iteration,
+                                      commit_index, change_index);
+  if (change_index >= overlap_count_) {
+    key.append(left ? "-left" : "-right");
+  }
+  return key;
+}
+
+void MergeBenchmark::Merge(size_t iteration,
+                           storage::CommitId left_id,
+                           storage::CommitId right_id) {
+  journal_.reset();
+  storage_->GetCommit(left_id, [this, iteration, right_id](
+                                   storage::Status status,
+                                   std::unique_ptr<const storage::Commit> left) {
+    if (status != storage::Status::OK) {
+      QuitOnError(status, "PageStorage::GetCommit");
+      return;
+    }
+    storage_->GetCommit(right_id, ftl::MakeCopyable([
+      this, iteration, left = std::move(left)
+    ](storage::Status status,
+      std::unique_ptr<const storage::Commit> right) mutable {
+      if (status != storage::Status::OK) {
+        QuitOnError(status, "PageStorage::GetCommit");
+        return;
+      }
+      // Strategies expect the first head to be the oldest one.
+      if (right->GetTimestamp() < left->GetTimestamp()) {
+        std::swap(left, right);
+      }
+      RunFindCommonAncestor(iteration, std::move(left), std::move(right));
+    }));
+  });
+}
+
+void MergeBenchmark::RunFindCommonAncestor(
+    size_t iteration,
+    std::unique_ptr<const storage::Commit> head1,
+    std::unique_ptr<const storage::Commit> head2) {
+  ftl::TimePoint start = ftl::TimePoint::Now();
+  TRACE_ASYNC_BEGIN("benchmark", "find_common_ancestor", iteration);
+  ledger::FindCommonAncestor(
+      environment_->main_runner(), storage_, head1->Clone(), head2->Clone(),
+      ftl::MakeCopyable([
+        this, iteration, start, head1 = std::move(head1),
+        head2 = std::move(head2)
+      ](ledger::Status status,
+        std::unique_ptr<const storage::Commit> ancestor) mutable {
+        if (status != ledger::Status::OK) {
+          FTL_LOG(ERROR) << "FindCommonAncestor failed.";
+          ShutDown();
+          return;
+        }
+        TRACE_ASYNC_END("benchmark", "find_common_ancestor", iteration);
+        find_common_ancestor_.durations.push_back(ftl::TimePoint::Now() -
+                                                  start);
+        RunStrategy(iteration, std::move(head1), std::move(head2),
+                    std::move(ancestor));
+      }));
+}
+
+void MergeBenchmark::RunStrategy(
+    size_t iteration,
+    std::unique_ptr<const storage::Commit> head1,
+    std::unique_ptr<const storage::Commit> head2,
+    std::unique_ptr<const storage::Commit> ancestor) {
+  ftl::TimePoint start = ftl::TimePoint::Now();
+  TRACE_ASYNC_BEGIN("benchmark", "merge", iteration);
+  strategy_->Merge(storage_, page_manager_.get(), std::move(head1),
+                   std::move(head2), std::move(ancestor),
+                   [this, iteration, start] {
+                     TRACE_ASYNC_END("benchmark", "merge", iteration);
+                     merge_.durations.push_back(ftl::TimePoint::Now() - start);
+                     // The strategy must not be used again from its own
+                     // callback.
+                     mtl::MessageLoop::GetCurrent()->task_runner()->PostTask(
+                         [this, iteration] { RunIteration(iteration + 1); });
+                   });
+}
+
+void MergeBenchmark::PrintResults() {
+  for (const PhaseDurations* phase : {&find_common_ancestor_, &merge_}) {
+    if (phase->durations.empty()) {
+      continue;
+    }
+    ftl::TimeDelta total;
+    ftl::TimeDelta max;
+    for (const ftl::TimeDelta& duration : phase->durations) {
+      total = total + duration;
+      max = std::max(max, duration);
+    }
+    std::cout << std::left << std::setw(22) << phase->name << std::right
+              << std::fixed << std::setprecision(2) << std::setw(10)
+              << total.ToMillisecondsF() / phase->durations.size()
+              << " ms avg" << std::setw(10) << max.ToMillisecondsF()
+              << " ms max" << std::endl;
+  }
+}
+
+void MergeBenchmark::QuitOnError(storage::Status status,
+                                 const char* operation) {
+  FTL_LOG(ERROR) << operation << " failed with status " << status << ".";
+  mtl::MessageLoop::GetCurrent()->PostQuitTask();
+}
+
+void MergeBenchmark::ShutDown() {
+  mtl::MessageLoop::GetCurrent()->PostQuitTask();
+}
+
+}  // namespace benchmark
+
+int main(int argc, const char** argv) {
+  ftl::CommandLine command_line = ftl::CommandLineFromArgcArgv(argc, argv);
+
+  std::string strategy;
+  ledger::MergePolicy policy;
+  size_t depth;
+  size_t change_count;
+  size_t overlap_percent;
+  size_t value_size;
+  size_t iteration_count;
+  std::string seed_str;
+  uint64_t seed = 0u;
+  if (!command_line.GetOptionValue(kStrategyFlag.ToString(), &strategy) ||
+      !ParseStrategy(strategy, &policy) ||
+      !GetSizeOption(command_line, kDepthFlag, &depth) || depth == 0 ||
+      !GetSizeOption(command_line, kChangeCountFlag, &change_count) ||
+      change_count == 0 ||
+      !GetSizeOption(command_line, kOverlapPercentFlag, &overlap_percent) ||
+      overlap_percent > 100 ||
+      !GetSizeOption(command_line, kValueSizeFlag, &value_size) ||
+      value_size == 0 ||
+      !GetSizeOption(command_line, kIterationCountFlag, &iteration_count) ||
+      iteration_count == 0 ||
+      (command_line.GetOptionValue(kSeedFlag.ToString(), &seed_str) &&
+       !ftl::StringToNumberWithError(seed_str, &seed))) {
+    PrintUsage(argv[0]);
+    return -1;
+  }
+
+  mtl::MessageLoop loop;
+  benchmark::MergeBenchmark app(policy, depth, change_count, overlap_percent,
+                                value_size, iteration_count, seed);
+  loop.task_runner()->PostTask([&app] { app.Run(); });
+  loop.Run();
+  return 0;
+}
@@ -0,0 +1,178 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_BENCHMARK_MERGE_MERGE_H_
+#define APPS_LEDGER_BENCHMARK_MERGE_MERGE_H_
+
+#include <stdint.h>
+
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "application/lib/app/application_context.h"
+#include "apps/ledger/services/public/ledger.fidl.h"
+#include "apps/ledger/src/app/merging/merge_strategy.h"
+#include "apps/ledger/src/app/page_manager.h"
+#include "apps/ledger/src/environment/environment.h"
+#include "apps/ledger/src/storage/public/commit.h"
+#include "apps/ledger/src/storage/public/journal.h"
+#include "apps/ledger/src/storage/public/page_storage.h"
+#include "apps/ledger/src/storage/public/types.h"
+#include "lib/fidl/cpp/bindings/binding.h"
+#include "lib/ftl/files/scoped_temp_dir.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/ref_ptr.h"
+#include "lib/ftl/tasks/task_runner.h"
+#include "lib/ftl/time/time_delta.h"
+#include "lib/ftl/time/time_point.h"
+
+namespace benchmark {
+
+// Benchmark of the conflict resolution of a page, using the merge strategies
+// of the Ledger application directly on a page stored in a temporary
+// directory.
+//
+// Each iteration creates two branches of |depth| commits from the head of the
+// page, each commit changing |change_count| keys. |overlap_percent|% of the
+// keys changed by the right branch are also changed by the left one, with a
+// different value. The two heads are then merged, and the following phases are
+// recorded as async trace events and printed:
+//   - find_common_ancestor: search of the common ancestor of the heads,
+//   - merge: merge by the selected strategy, including the merge commit, which
+//     is also traced in the "ledger" category as "merge_commit".
+// The custom and automatic strategies use an in-process ConflictResolver
+// taking the right value of each key it is asked to resolve.
+//
+// Parameters:
+//   --strategy=last_one_wins|automatic_with_fallback|custom the merge strategy
+//   --depth=<int> the number of commits of each branch
+//   --change-count=<int> the number of keys changed by each commit
+//   --overlap-percent=<int> the percentage of the changed keys common to both
+//     branches
+//   --value-size=<int> the size of a single value in bytes
+//   --iteration-count=<int> the number of merges
+//   --seed=<int> the seed of the generated data
+class MergeBenchmark {
+ public:
+  MergeBenchmark(ledger::MergePolicy policy,
+                 size_t depth,
+                 size_t change_count,
+                 size_t overlap_percent,
+                 size_t value_size,
+                 size_t iteration_count,
+                 uint64_t seed);
+  ~MergeBenchmark();
+
+  void Run();
+
+ private:
+  // ConflictResolver choosing the right value of every key to resolve.
+  class ConflictResolverImpl : public ledger::ConflictResolver {
+   public:
+    explicit ConflictResolverImpl(
+        fidl::InterfaceRequest<ledger::ConflictResolver> request);
+    ~ConflictResolverImpl() override;
+
+   private:
+    // ledger::ConflictResolver:
+    void Resolve(fidl::InterfaceHandle<ledger::PageSnapshot> left_version,
+                 fidl::InterfaceHandle<ledger::PageSnapshot> right_version,
+                 fidl::InterfaceHandle<ledger::PageSnapshot> common_version,
+                 fidl::InterfaceHandle<ledger::MergeResultProvider>
+                     result_provider) override;
+
+    // Requests the part of the right diff starting at |token|, and merges it.
+    void MergeRightDiff(fidl::Array<uint8_t> token);
+
+    void Done();
+
+    fidl::Binding<ledger::ConflictResolver> binding_;
+    ledger::MergeResultProviderPtr result_provider_;
+
+    FTL_DISALLOW_COPY_AND_ASSIGN(ConflictResolverImpl);
+  };
+
+  // Durations of the measured phases.
+  struct PhaseDurations {
+    std::string name;
+    std::vector<ftl::TimeDelta> durations;
+  };
+
+  // Adds the |i|-th value of |value_ids_| and the following ones to storage.
+  void CreateValues(size_t i);
+
+  std::unique_ptr<ledger::MergeStrategy> CreateStrategy();
+
+  void RunIteration(size_t iteration);
+
+  // Creates a branch of |depth_| commits on top of |parent_id|, starting at the
+  // |commit_index|-th commit, and calls |callback| with its head.
+  void CreateBranch(size_t iteration,
+                    bool left,
+                    size_t commit_index,
+                    storage::CommitId parent_id,
+                    std::function<void(storage::CommitId)> callback);
+
+  std::string GetKey(size_t iteration,
+                     bool left,
+                     size_t commit_index,
+                     size_t change_index) const;
+
+  // Merges the heads of the branches created by the |iteration|-th iteration.
+  void Merge(size_t iteration,
+             storage::CommitId left_id,
+             storage::CommitId right_id);
+
+  void RunFindCommonAncestor(size_t iteration,
+                             std::unique_ptr<const storage::Commit> head1,
+                             std::unique_ptr<const storage::Commit> head2);
+
+  void RunStrategy(size_t iteration,
+                   std::unique_ptr<const storage::Commit> head1,
+                   std::unique_ptr<const storage::Commit> head2,
+                   std::unique_ptr<const storage::Commit> ancestor);
+
+  void PrintResults();
+
+  void QuitOnError(storage::Status status, const char* operation);
+
+  void ShutDown();
+
+  std::unique_ptr<app::ApplicationContext> application_context_;
+  files::ScopedTempDir tmp_dir_;
+  const ledger::MergePolicy policy_;
+  const size_t depth_;
+  const size_t change_count_;
+  // Number of changes of each commit whose key is changed on both branches.
+  const size_t overlap_count_;
+  const size_t value_size_;
+  const size_t iteration_count_;
+  std::default_random_engine rng_;
+
+  std::thread io_thread_;
+  ftl::RefPtr<ftl::TaskRunner> io_runner_;
+  std::unique_ptr<ledger::Environment> environment_;
+  storage::PageStorage* storage_ = nullptr;
+  std::unique_ptr<ledger::PageManager> page_manager_;
+  std::unique_ptr<ConflictResolverImpl> conflict_resolver_;
+  std::unique_ptr<ledger::MergeStrategy> strategy_;
+  // Journal of the commit in progress, if any.
+  std::unique_ptr<storage::Journal> journal_;
+
+  // Values of the left branch changes, followed by the values of the right
+  // branch changes.
+  std::vector<storage::ObjectId> value_ids_;
+  PhaseDurations find_common_ancestor_{"find_common_ancestor", {}};
+  PhaseDurations merge_{"merge", {}};
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(MergeBenchmark);
+};
+
+}  // namespace benchmark
+
+#endif  // APPS_LEDGER_BENCHMARK_MERGE_MERGE_H_
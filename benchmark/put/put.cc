@@ -22,84 +22,118 @@ constexpr ftl::StringView kStoragePath = "/data/benchmark/ledger/put";
 constexpr ftl::StringView kEntryCountFlag = "entry-count";
 constexpr ftl::StringView kValueSizeFlag = "value-size";
 constexpr ftl::StringView kTransactionFlag = "transaction";
+constexpr ftl::StringView kPageCountFlag = "page-count";
 
 void PrintUsage(const char* executable_name) {
   std::cout << "Usage: " << executable_name << " --" << kEntryCountFlag
-            << "=<int> --" << kValueSizeFlag << "=<int>" << std::endl;
+            << "=<int> --" << kValueSizeFlag << "=<int> [--"
+            << kTransactionFlag << "] [--" << kPageCountFlag << "=<int>]"
+            << std::endl;
 }
 
 }  // namespace
 
 namespace benchmark {
 
-PutBenchmark::PutBenchmark(int entry_count, int value_size, bool transaction)
+PutBenchmark::PutBenchmark(int entry_count,
+                           int value_size,
+                           bool transaction,
+                           int page_count)
     : tmp_dir_(kStoragePath),
       application_context_(app::ApplicationContext::CreateFromStartupInfo()),
       entry_count_(entry_count),
       value_size_(value_size),
-      transaction_(transaction) {
+      transaction_(transaction),
+      page_count_(page_count) {
   FTL_DCHECK(entry_count > 0);
   FTL_DCHECK(value_size > 0);
+  FTL_DCHECK(page_count > 0);
   tracing::InitializeTracer(application_context_.get(),
                             {"benchmark_ledger_put"});
 }
 
 void PutBenchmark::Run() {
-  ledger::LedgerPtr ledger =
-      benchmark::GetLedger(application_context_.get(), &ledger_controller_,
-                           "put", tmp_dir_.path(), false, "");
+  ledger_ = benchmark::GetLedger(application_context_.get(),
+                                 &ledger_controller_, "put", tmp_dir_.path(),
+                                 false, "");
+  GetPages();
+}
+
+void PutBenchmark::GetPages() {
+  if (static_cast<int>(pages_.size()) == page_count_) {
+    // Each page writes to its own files, so that the puts to the different
+    // pages can be served in parallel.
+    for (int page_index = 0; page_index < page_count_; ++page_index) {
+      RunPage(page_index);
+    }
+    return;
+  }
   benchmark::GetPageEnsureInitialized(
-      ledger.get(), nullptr, [this](ledger::PagePtr page, auto id) {
-        page_ = std::move(page);
-        if (transaction_) {
-          page_->StartTransaction([this](ledger::Status status) {
-            if (benchmark::QuitOnError(status, "Page::StartTransaction")) {
-              return;
-            }
-            TRACE_ASYNC_BEGIN("benchmark", "transaction", 0);
-            RunSingle(0, entry_count_);
-          });
-        } else {
-          RunSingle(0, entry_count_);
+      ledger_.get(), nullptr, [this](ledger::PagePtr page, auto id) {
+        pages_.push_back(std::move(page));
+        GetPages();
+      });
+}
+
+void PutBenchmark::RunPage(int page_index) {
+  if (!transaction_) {
+    RunSingle(page_index, 0, entry_count_);
+    return;
+  }
+  pages_[page_index]->StartTransaction(
+      [this, page_index](ledger::Status status) {
+        if (benchmark::QuitOnError(status, "Page::StartTransaction")) {
+          return;
         }
+        TRACE_ASYNC_BEGIN("benchmark", "transaction", page_index);
+        RunSingle(page_index, 0, entry_count_);
       });
 }
 
-void PutBenchmark::RunSingle(int i, int count) {
+void PutBenchmark::RunSingle(int page_index, int i, int count) {
   if (i == count) {
     if (transaction_) {
-      CommitAndMeasure();
+      CommitAndMeasure(page_index);
     } else {
-      ShutDown();
+      OnPageDone();
     }
     return;
   }
 
   fidl::Array<uint8_t> key = benchmark::MakeKey(i);
   fidl::Array<uint8_t> value = benchmark::MakeValue(value_size_);
-  TRACE_ASYNC_BEGIN("benchmark", "put", i);
-  page_->Put(std::move(key), std::move(value),
-             [this, i, count](ledger::Status status) {
-               if (benchmark::QuitOnError(status, "Page::Put")) {
-                 return;
-               }
-               TRACE_ASYNC_END("benchmark", "put", i);
-               RunSingle(i + 1, count);
-             });
+  // The puts of all the pages need distinct trace ids.
+  uint64_t put_id = page_index * count + i;
+  TRACE_ASYNC_BEGIN("benchmark", "put", put_id);
+  pages_[page_index]->Put(
+      std::move(key), std::move(value),
+      [this, page_index, i, count, put_id](ledger::Status status) {
+        if (benchmark::QuitOnError(status, "Page::Put")) {
+          return;
+        }
+        TRACE_ASYNC_END("benchmark", "put", put_id);
+        RunSingle(page_index, i + 1, count);
+      });
 }
 
-void PutBenchmark::CommitAndMeasure() {
-  TRACE_ASYNC_BEGIN("benchmark", "commit", 0);
-  page_->Commit([this](ledger::Status status) {
+void PutBenchmark::CommitAndMeasure(int page_index) {
+  TRACE_ASYNC_BEGIN("benchmark", "commit", page_index);
+  pages_[page_index]->Commit([this, page_index](ledger::Status status) {
     if (benchmark::QuitOnError(status, "Page::Commit")) {
       return;
     }
-    TRACE_ASYNC_END("benchmark", "commit", 0);
-    TRACE_ASYNC_END("benchmark", "transaction", 0);
-    ShutDown();
+    TRACE_ASYNC_END("benchmark", "commit", page_index);
+    TRACE_ASYNC_END("benchmark", "transaction", page_index);
+    OnPageDone();
   });
 }
 
+void PutBenchmark::OnPageDone() {
+  if (++pages_done_ == page_count_) {
+    ShutDown();
+  }
+}
+
 void PutBenchmark::ShutDown() {
   // Shut down the Ledger process first as it relies on |tmp_dir_| storage.
   ledger_controller_->Kill();
@@ -117,6 +151,8 @@ int main(int argc, const char** argv) {
   std::string value_size_str;
   int value_size;
   bool transaction = command_line.HasOption(kTransactionFlag.ToString());
+  std::string page_count_str;
+  int page_count = 1;
   if (!command_line.GetOptionValue(kEntryCountFlag.ToString(),
                                    &entry_count_str) ||
       !ftl::StringToNumberWithError(entry_count_str, &entry_count) ||
@@ -128,9 +164,17 @@ int main(int argc, const char** argv) {
     PrintUsage(argv[0]);
     return -1;
   }
+  if (command_line.GetOptionValue(kPageCountFlag.ToString(),
+                                  &page_count_str) &&
+      (!ftl::StringToNumberWithError(page_count_str, &page_count) ||
+       page_count <= 0)) {
+    PrintUsage(argv[0]);
+    return -1;
+  }
 
   mtl::MessageLoop loop;
-  benchmark::PutBenchmark app(entry_count, value_size, transaction);
+  benchmark::PutBenchmark app(entry_count, value_size, transaction,
+                              page_count);
   loop.task_runner()->PostTask([&app] { app.Run(); });
   loop.Run();
   return 0;
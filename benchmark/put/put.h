@@ -6,6 +6,7 @@
 #define APPS_LEDGER_BENCHMARK_PUT_PUT_H_
 
 #include <memory>
+#include <vector>
 
 #include "application/lib/app/application_context.h"
 #include "apps/ledger/services/public/ledger.fidl.h"
@@ -19,15 +20,23 @@ namespace benchmark {
 //   --entry-count=<int> the number of entries to be put
 //   --value-size=<int> the size of a single value in bytes
 //   --transaction whether puts should be bundled into a single transaction
+//   --page-count=<int> the number of pages receiving the puts concurrently,
+//     each of them receiving |entry-count| entries (1 by default)
 class PutBenchmark {
  public:
-  PutBenchmark(int entry_count, int value_size, bool transaction);
+  PutBenchmark(int entry_count,
+               int value_size,
+               bool transaction,
+               int page_count);
 
   void Run();
 
  private:
-  void RunSingle(int i, int count);
-  void CommitAndMeasure();
+  void GetPages();
+  void RunPage(int page_index);
+  void RunSingle(int page_index, int i, int count);
+  void CommitAndMeasure(int page_index);
+  void OnPageDone();
 
   void ShutDown();
 
@@ -36,9 +45,12 @@ class PutBenchmark {
   const int entry_count_;
   const int value_size_;
   const bool transaction_;
+  const int page_count_;
 
   app::ApplicationControllerPtr ledger_controller_;
-  ledger::PagePtr page_;
+  ledger::LedgerPtr ledger_;
+  std::vector<ledger::PagePtr> pages_;
+  int pages_done_ = 0;
 
   FTL_DISALLOW_COPY_AND_ASSIGN(PutBenchmark);
 };
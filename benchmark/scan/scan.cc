@@ -0,0 +1,194 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/benchmark/scan/scan.h"
+
+#include <iostream>
+#include <vector>
+
+#include "apps/ledger/benchmark/lib/data.h"
+#include "apps/ledger/benchmark/lib/get_ledger.h"
+#include "apps/ledger/benchmark/lib/logging.h"
+#include "apps/ledger/benchmark/lib/populate.h"
+#include "apps/tracing/lib/trace/event.h"
+#include "apps/tracing/lib/trace/provider.h"
+#include "lib/ftl/command_line.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/strings/string_number_conversions.h"
+#include "lib/mtl/tasks/message_loop.h"
+
+namespace {
+constexpr ftl::StringView kStoragePath = "/data/benchmark/ledger/scan";
+constexpr ftl::StringView kEntryCountFlag = "entry-count";
+constexpr ftl::StringView kValueSizeFlag = "value-size";
+constexpr ftl::StringView kIterationCountFlag = "iteration-count";
+
+void PrintUsage(const char* executable_name) {
+  std::cout << "Usage: " << executable_name << " --" << kEntryCountFlag
+            << "=<int> --" << kValueSizeFlag << "=<int> --"
+            << kIterationCountFlag << "=<int>" << std::endl;
+}
+
+}  // namespace
+
+namespace benchmark {
+
+ScanBenchmark::ScanBenchmark(int entry_count,
+                             int value_size,
+                             int iteration_count)
+    : tmp_dir_(kStoragePath),
+      application_context_(app::ApplicationContext::CreateFromStartupInfo()),
+      entry_count_(entry_count),
+      value_size_(value_size),
+      iteration_count_(iteration_count) {
+  FTL_DCHECK(entry_count > 0);
+  FTL_DCHECK(value_size > 0);
+  FTL_DCHECK(iteration_count > 0);
+  tracing::InitializeTracer(application_context_.get(),
+                            {"benchmark_ledger_scan"});
+}
+
+void ScanBenchmark::Run() {
+  ledger::LedgerPtr ledger =
+      benchmark::GetLedger(application_context_.get(), &ledger_controller_,
+                           "scan", tmp_dir_.path(), false, "");
+  benchmark::GetPageEnsureInitialized(
+      ledger.get(), nullptr, [this](ledger::PagePtr page, auto id) {
+        page_ = std::move(page);
+        std::vector<fidl::Array<uint8_t>> keys;
+        for (int i = 0; i < entry_count_; i++) {
+          keys.push_back(benchmark::MakeKey(i));
+        }
+        benchmark::PopulatePage(
+            page_.get(), keys, value_size_, [this](ledger::Status status) {
+              if (benchmark::QuitOnError(status, "PopulatePage")) {
+                return;
+              }
+              page_->GetSnapshot(
+                  snapshot_.NewRequest(), nullptr, nullptr,
+                  [this](ledger::Status status) {
+                    if (benchmark::QuitOnError(status, "GetSnapshot")) {
+                      return;
+                    }
+                    ScanEntries(0);
+                  });
+            });
+      });
+}
+
+void ScanBenchmark::ScanEntries(int i) {
+  if (i == iteration_count_) {
+    ScanKeys(0);
+    return;
+  }
+  TRACE_ASYNC_BEGIN("benchmark", "scan entries", i);
+  GetEntriesPart(i, nullptr, 0);
+}
+
+void ScanBenchmark::GetEntriesPart(int i,
+                                   fidl::Array<uint8_t> token,
+                                   size_t entries_read) {
+  TRACE_ASYNC_BEGIN("benchmark", "get entries", i);
+  snapshot_->GetEntries(
+      nullptr, std::move(token),
+      [this, i, entries_read](ledger::Status status, auto entries,
+                              auto next_token) {
+        if (status != ledger::Status::PARTIAL_RESULT &&
+            benchmark::QuitOnError(status, "PageSnapshot::GetEntries")) {
+          return;
+        }
+        TRACE_ASYNC_END("benchmark", "get entries", i);
+        size_t total = entries_read + entries.size();
+        if (next_token) {
+          GetEntriesPart(i, std::move(next_token), total);
+          return;
+        }
+        // If the number of entries does not match, don't record the end of
+        // the scan, which will fail the benchmark.
+        if (total == static_cast<size_t>(entry_count_)) {
+          TRACE_ASYNC_END("benchmark", "scan entries", i);
+        } else {
+          FTL_LOG(ERROR) << "Expected " << entry_count_ << " entries, got "
+                         << total;
+        }
+        ScanEntries(i + 1);
+      });
+}
+
+void ScanBenchmark::ScanKeys(int i) {
+  if (i == iteration_count_) {
+    ShutDown();
+    return;
+  }
+  TRACE_ASYNC_BEGIN("benchmark", "scan keys", i);
+  GetKeysPart(i, nullptr, 0);
+}
+
+void ScanBenchmark::GetKeysPart(int i,
+                                fidl::Array<uint8_t> token,
+                                size_t keys_read) {
+  TRACE_ASYNC_BEGIN("benchmark", "get keys", i);
+  snapshot_->GetKeys(
+      nullptr, std::move(token),
+      [this, i, keys_read](ledger::Status status, auto keys, auto next_token) {
+        if (status != ledger::Status::PARTIAL_RESULT &&
+            benchmark::QuitOnError(status, "PageSnapshot::GetKeys")) {
+          return;
+        }
+        TRACE_ASYNC_END("benchmark", "get keys", i);
+        size_t total = keys_read + keys.size();
+        if (next_token) {
+          GetKeysPart(i, std::move(next_token), total);
+          return;
+        }
+        if (total == static_cast<size_t>(entry_count_)) {
+          TRACE_ASYNC_END("benchmark", "scan keys", i);
+        } else {
+          FTL_LOG(ERROR) << "Expected " << entry_count_ << " keys, got "
+                         << total;
+        }
+        ScanKeys(i + 1);
+      });
+}
+
+void ScanBenchmark::ShutDown() {
+  // Shut down the Ledger process first as it relies on |tmp_dir_| storage.
+  ledger_controller_->Kill();
+  ledger_controller_.WaitForIncomingResponseWithTimeout(
+      ftl::TimeDelta::FromSeconds(5));
+  mtl::MessageLoop::GetCurrent()->PostQuitTask();
+}
+}  // namespace benchmark
+
+int main(int argc, const char** argv) {
+  ftl::CommandLine command_line = ftl::CommandLineFromArgcArgv(argc, argv);
+
+  std::string entry_count_str;
+  int entry_count;
+  std::string value_size_str;
+  int value_size;
+  std::string iteration_count_str;
+  int iteration_count;
+  if (!command_line.GetOptionValue(kEntryCountFlag.ToString(),
+                                   &entry_count_str) ||
+      !ftl::StringToNumberWithError(entry_count_str, &entry_count) ||
+      entry_count <= 0 ||
+      !command_line.GetOptionValue(kValueSizeFlag.ToString(),
+                                   &value_size_str) ||
+      !ftl::StringToNumberWithError(value_size_str, &value_size) ||
+      value_size <= 0 ||
+      !command_line.GetOptionValue(kIterationCountFlag.ToString(),
+                                   &iteration_count_str) ||
+      !ftl::StringToNumberWithError(iteration_count_str, &iteration_count) ||
+      iteration_count <= 0) {
+    PrintUsage(argv[0]);
+    return -1;
+  }
+
+  mtl::MessageLoop loop;
+  benchmark::ScanBenchmark app(entry_count, value_size, iteration_count);
+  loop.task_runner()->PostTask([&app] { app.Run(); });
+  loop.Run();
+  return 0;
+}
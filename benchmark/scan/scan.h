@@ -0,0 +1,58 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_BENCHMARK_SCAN_SCAN_H_
+#define APPS_LEDGER_BENCHMARK_SCAN_SCAN_H_
+
+#include <memory>
+
+#include "application/lib/app/application_context.h"
+#include "apps/ledger/services/public/ledger.fidl.h"
+#include "lib/ftl/files/scoped_temp_dir.h"
+
+namespace benchmark {
+
+// Benchmark that measures performance of reading the full content of a page
+// with the PageSnapshot.GetEntries() and PageSnapshot.GetKeys() operations,
+// following the pagination tokens until the last result.
+//
+// Parameters:
+//   --entry-count=<int> the number of entries in the page
+//   --value-size=<int> the size of a single value in bytes
+//   --iteration-count=<int> the number of times each scan is repeated
+class ScanBenchmark {
+ public:
+  ScanBenchmark(int entry_count, int value_size, int iteration_count);
+
+  void Run();
+
+ private:
+  // Scans the entries of the page, for the |i|-th time.
+  void ScanEntries(int i);
+  // Requests the next part of the entries of the page, starting at |token|.
+  // |entries_read| is the number of entries already read by this scan.
+  void GetEntriesPart(int i, fidl::Array<uint8_t> token, size_t entries_read);
+
+  // Scans the keys of the page, for the |i|-th time.
+  void ScanKeys(int i);
+  void GetKeysPart(int i, fidl::Array<uint8_t> token, size_t keys_read);
+
+  void ShutDown();
+
+  files::ScopedTempDir tmp_dir_;
+  std::unique_ptr<app::ApplicationContext> application_context_;
+  const int entry_count_;
+  const int value_size_;
+  const int iteration_count_;
+
+  app::ApplicationControllerPtr ledger_controller_;
+  ledger::PagePtr page_;
+  ledger::PageSnapshotPtr snapshot_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ScanBenchmark);
+};
+
+}  // namespace benchmark
+
+#endif  // APPS_LEDGER_BENCHMARK_SCAN_SCAN_H_
@@ -0,0 +1,63 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/benchmark/storage/allocation_counter.h"
+
+#include <stdlib.h>
+
+#include <atomic>
+#include <new>
+
+namespace benchmark {
+
+namespace {
+
+std::atomic<uint64_t> allocation_count(0u);
+std::atomic<uint64_t> allocated_bytes(0u);
+
+void* CountedAllocate(size_t size) {
+  allocation_count.fetch_add(1u, std::memory_order_relaxed);
+  allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  void* result = malloc(size == 0u ? 1u : size);
+  if (!result) {
+    abort();
+  }
+  return result;
+}
+
+}  // namespace
+
+uint64_t GetAllocationCount() {
+  return allocation_count.load(std::memory_order_relaxed);
+}
+
+uint64_t GetAllocatedBytes() {
+  return allocated_bytes.load(std::memory_order_relaxed);
+}
+
+}  // namespace benchmark
+
+void* operator new(size_t size) {
+  return benchmark::CountedAllocate(size);
+}
+
+void* operator new[](size_t size) {
+  return benchmark::CountedAllocate(size);
+}
+
+void operator delete(void* ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete(void* ptr, size_t size) noexcept {
+  free(ptr);
+}
+
+void operator delete[](void* ptr, size_t size) noexcept {
+  free(ptr);
+}
@@ -0,0 +1,22 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_BENCHMARK_STORAGE_ALLOCATION_COUNTER_H_
+#define APPS_LEDGER_BENCHMARK_STORAGE_ALLOCATION_COUNTER_H_
+
+#include <stdint.h>
+
+namespace benchmark {
+
+// Returns the number of heap allocations made through operator new since the
+// start of the process. Linking allocation_counter.cc replaces the global
+// operator new and delete to count them.
+uint64_t GetAllocationCount();
+
+// Returns the number of bytes requested by these allocations.
+uint64_t GetAllocatedBytes();
+
+}  // namespace benchmark
+
+#endif  // APPS_LEDGER_BENCHMARK_STORAGE_ALLOCATION_COUNTER_H_
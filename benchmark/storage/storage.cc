@@ -0,0 +1,528 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/benchmark/storage/storage.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+
+#include "apps/ledger/benchmark/storage/allocation_counter.h"
+#include "apps/ledger/src/storage/impl/btree/encoding.h"
+#include "apps/tracing/lib/trace/event.h"
+#include "apps/tracing/lib/trace/provider.h"
+#include "lib/ftl/command_line.h"
+#include "lib/ftl/functional/closure.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/strings/string_number_conversions.h"
+#include "lib/ftl/strings/string_printf.h"
+#include "lib/mtl/socket/strings.h"
+#include "lib/mtl/tasks/message_loop.h"
+#include "lib/mtl/threading/create_thread.h"
+
+namespace {
+constexpr ftl::StringView kStoragePath = "/data/benchmark/ledger/storage";
+constexpr ftl::StringView kEntryCountFlag = "entry-count";
+constexpr ftl::StringView kKeySizeFlag = "key-size";
+constexpr ftl::StringView kValueSizeFlag = "value-size";
+constexpr ftl::StringView kBatchSizeFlag = "batch-size";
+constexpr ftl::StringView kSeedFlag = "seed";
+
+// Number of entries of the node encoded and decoded, close to the average size
+// of the nodes of the B-tree.
+constexpr size_t kNodeEntryCount = 32;
+// Number of times the scan of the head commit is repeated.
+constexpr size_t kScanCount = 10;
+// Distances, in commits, between the commits compared by the diff phase.
+constexpr size_t kDiffDistances[] = {1, 10, 100};
+
+void PrintUsage(const char* executable_name) {
+  std::cout << "Usage: " << executable_name << " --" << kEntryCountFlag
+            << "=<int> --" << kKeySizeFlag << "=<int> --" << kValueSizeFlag
+            << "=<int>[-<int>] [--" << kBatchSizeFlag << "=<int>] [--"
+            << kSeedFlag << "=<int>]" << std::endl;
+}
+
+bool ParseValueSize(const std::string& value,
+                    size_t* min_value_size,
+                    size_t* max_value_size) {
+  size_t separator = value.find('-');
+  if (separator == std::string::npos) {
+    if (!ftl::StringToNumberWithError(value, min_value_size)) {
+      return false;
+    }
+    *max_value_size = *min_value_size;
+  } else if (!ftl::StringToNumberWithError(
+                 ftl::StringView(value).substr(0, separator),
+                 min_value_size) ||
+             !ftl::StringToNumberWithError(
+                 ftl::StringView(value).substr(separator + 1),
+                 max_value_size)) {
+    return false;
+  }
+  return *min_value_size > 0 && *min_value_size <= *max_value_size;
+}
+
+// State of a RunSequentially() call.
+struct SequenceState {
+  size_t count = 0u;
+  size_t next = 0u;
+  // True while RunNext() is looping over the operations.
+  bool running = false;
+  // True if the last operation completed synchronously.
+  bool completed = false;
+  std::function<void(size_t, ftl::Closure)> operation;
+  ftl::Closure on_done;
+};
+
+void RunNext(std::shared_ptr<SequenceState> state) {
+  // Operations completing synchronously are run in a loop rather than
+  // recursively, so that the stack does not grow with the number of
+  // operations.
+  state->running = true;
+  while (state->next < state->count) {
+    size_t index = state->next++;
+    state->completed = false;
+    state->operation(index, [state] {
+      if (state->running) {
+        state->completed = true;
+        return;
+      }
+      RunNext(state);
+    });
+    if (!state->completed) {
+      state->running = false;
+      return;
+    }
+  }
+  state->running = false;
+  state->on_done();
+}
+
+// Calls |operation| for each index in [0, |count|), waiting for each call to
+// invoke its callback before the next one, then calls |on_done|.
+void RunSequentially(size_t count,
+                     std::function<void(size_t, ftl::Closure)> operation,
+                     ftl::Closure on_done) {
+  auto state = std::make_shared<SequenceState>();
+  state->count = count;
+  state->operation = std::move(operation);
+  state->on_done = std::move(on_done);
+  RunNext(std::move(state));
+}
+
+}  // namespace
+
+namespace benchmark {
+
+StorageBenchmark::StorageBenchmark(size_t entry_count,
+                                   size_t key_size,
+                                   size_t min_value_size,
+                                   size_t max_value_size,
+                                   size_t batch_size,
+                                   uint64_t seed)
+    : application_context_(app::ApplicationContext::CreateFromStartupInfo()),
+      tmp_dir_(kStoragePath),
+      entry_count_(entry_count),
+      key_size_(key_size),
+      min_value_size_(min_value_size),
+      max_value_size_(max_value_size),
+      batch_size_(batch_size),
+      rng_(seed) {
+  FTL_DCHECK(entry_count > 0);
+  FTL_DCHECK(key_size > 0);
+  FTL_DCHECK(min_value_size > 0 && min_value_size <= max_value_size);
+  FTL_DCHECK(batch_size > 0);
+  tracing::InitializeTracer(application_context_.get(),
+                            {"benchmark_ledger_storage"});
+  io_thread_ = mtl::CreateThread(&io_runner_, "io thread");
+}
+
+StorageBenchmark::~StorageBenchmark() {
+  storage_.reset();
+  io_runner_->PostTask([] { mtl::MessageLoop::GetCurrent()->QuitNow(); });
+  io_thread_.join();
+}
+
+void StorageBenchmark::Run() {
+  GenerateData();
+  storage_ = std::make_unique<storage::PageStorageImpl>(
+      mtl::MessageLoop::GetCurrent()->task_runner(), io_runner_,
+      &coroutine_service_, tmp_dir_.path(), "benchmark_page");
+  storage_->Init([this](storage::Status status) {
+    if (status != storage::Status::OK) {
+      QuitOnError(status, "PageStorageImpl::Init");
+      return;
+    }
+    RunEncodeNode();
+  });
+}
+
+void StorageBenchmark::GenerateData() {
+  std::uniform_int_distribution<int> byte_distribution(0, 255);
+  auto make_random_string = [this, &byte_distribution](size_t size) {
+    std::string result;
+    result.reserve(size);
+    for (size_t i = 0; i < size; ++i) {
+      result.push_back(static_cast<char>(byte_distribution(rng_)));
+    }
+    return result;
+  };
+  std::uniform_int_distribution<size_t> value_size_distribution(
+      min_value_size_, max_value_size_);
+
+  keys_.reserve(entry_count_);
+  values_.reserve(entry_count_);
+  for (size_t i = 0; i < entry_count_; ++i) {
+    // Keys start with their index, so that they are sorted by index.
+    std::string key = ftl::StringPrintf("%010zu", i);
+    if (key.size() < key_size_) {
+      key.append(make_random_string(key_size_ - key.size()));
+    }
+    keys_.push_back(std::move(key));
+    values_.push_back(make_random_string(value_size_distribution(rng_)));
+  }
+}
+
+void StorageBenchmark::StartPhase(std::string name) {
+  Phase phase;
+  phase.name = std::move(name);
+  phase.allocation_count = GetAllocationCount();
+  phase.allocated_bytes = GetAllocatedBytes();
+  phase.start = ftl::TimePoint::Now();
+  phases_.push_back(std::move(phase));
+}
+
+void StorageBenchmark::EndPhase() {
+  Phase& phase = phases_.back();
+  ftl::TimeDelta duration = ftl::TimePoint::Now() - phase.start;
+  double seconds = std::max(duration.ToSecondsF(), 1e-9);
+  double operation_count =
+      static_cast<double>(std::max<uint64_t>(phase.operation_count, 1u));
+  double allocation_count = GetAllocationCount() - phase.allocation_count;
+  double allocated_bytes = GetAllocatedBytes() - phase.allocated_bytes;
+  std::cout << std::left << std::setw(12) << phase.name << std::right
+            << std::fixed << std::setprecision(1) << std::setw(10)
+            << duration.ToMillisecondsF() << " ms" << std::setw(12)
+            << phase.operation_count / seconds << " ops/s" << std::setw(14)
+            << phase.byte_count / seconds << " B/s" << std::setw(10)
+            << allocation_count / operation_count << " allocs/op"
+            << std::setw(12) << allocated_bytes / operation_count
+            << " alloc B/op" << std::endl;
+}
+
+void StorageBenchmark::RunEncodeNode() {
+  std::vector<storage::Entry> entries;
+  for (size_t i = 0; i < std::min(kNodeEntryCount, entry_count_); ++i) {
+    entries.push_back({keys_[i], std::string(32, 'o'),
+                       storage::KeyPriority::EAGER});
+  }
+  std::vector<storage::ObjectId> children(entries.size() + 1);
+
+  StartPhase("encode_node");
+  TRACE_ASYNC_BEGIN("benchmark", "encode_node", 0);
+  Phase& phase = phases_.back();
+  for (size_t i = 0; i < entry_count_; ++i) {
+    std::string bytes = storage::EncodeNode(0u, entries, children, {});
+    phase.operation_count++;
+    phase.byte_count += bytes.size();
+  }
+  TRACE_ASYNC_END("benchmark", "encode_node", 0);
+  EndPhase();
+
+  RunDecodeNode();
+}
+
+void StorageBenchmark::RunDecodeNode() {
+  std::vector<storage::Entry> entries;
+  for (size_t i = 0; i < std::min(kNodeEntryCount, entry_count_); ++i) {
+    entries.push_back({keys_[i], std::string(32, 'o'),
+                       storage::KeyPriority::EAGER});
+  }
+  std::string bytes = storage::EncodeNode(
+      0u, entries, std::vector<storage::ObjectId>(entries.size() + 1), {});
+
+  StartPhase("decode_node");
+  TRACE_ASYNC_BEGIN("benchmark", "decode_node", 0);
+  Phase& phase = phases_.back();
+  for (size_t i = 0; i < entry_count_; ++i) {
+    uint8_t level;
+    std::vector<storage::Entry> decoded_entries;
+    std::vector<storage::ObjectId> children;
+    std::vector<storage::SubtreeSummary> summaries;
+    bool result = storage::DecodeNode(bytes, &level, &decoded_entries,
+                                      &children, &summaries);
+    FTL_DCHECK(result);
+    phase.operation_count++;
+    phase.byte_count += bytes.size();
+  }
+  TRACE_ASYNC_END("benchmark", "decode_node", 0);
+  EndPhase();
+
+  RunAddObject();
+}
+
+void StorageBenchmark::RunAddObject() {
+  StartPhase("add_object");
+  TRACE_ASYNC_BEGIN("benchmark", "add_object", 0);
+  object_ids_.resize(entry_count_);
+  RunSequentially(
+      entry_count_,
+      [this](size_t i, ftl::Closure on_done) {
+        storage_->AddObjectFromLocal(
+            mtl::WriteStringToSocket(values_[i]), values_[i].size(),
+            [this, i, on_done](storage::Status status,
+                               storage::ObjectId object_id) {
+              if (status != storage::Status::OK) {
+                QuitOnError(status, "PageStorage::AddObjectFromLocal");
+                return;
+              }
+              object_ids_[i] = std::move(object_id);
+              phases_.back().operation_count++;
+              phases_.back().byte_count += values_[i].size();
+              on_done();
+            });
+      },
+      [this] {
+        TRACE_ASYNC_END("benchmark", "add_object", 0);
+        EndPhase();
+        RunCommit();
+      });
+}
+
+void StorageBenchmark::RunCommit() {
+  std::vector<storage::CommitId> heads;
+  storage::Status status = storage_->GetHeadCommitIds(&heads);
+  if (status != storage::Status::OK) {
+    QuitOnError(status, "PageStorage::GetHeadCommitIds");
+    return;
+  }
+  FTL_DCHECK(heads.size() == 1u);
+
+  StartPhase("commit");
+  TRACE_ASYNC_BEGIN("benchmark", "commit", 0);
+  size_t batch_count = (entry_count_ + batch_size_ - 1) / batch_size_;
+  RunSequentially(
+      batch_count,
+      [ this, first_parent = heads[0] ](size_t batch, ftl::Closure on_done) {
+        const storage::CommitId& parent_id =
+            commits_.empty() ? first_parent : commits_.back()->GetId();
+        storage::Status status = storage_->StartCommit(
+            parent_id, storage::JournalType::IMPLICIT, &journal_);
+        if (status != storage::Status::OK) {
+          QuitOnError(status, "PageStorage::StartCommit");
+          return;
+        }
+        size_t end = std::min(entry_count_, (batch + 1) * batch_size_);
+        for (size_t i = batch * batch_size_; i < end; ++i) {
+          status = journal_->Put(keys_[i], object_ids_[i],
+                                 storage::KeyPriority::EAGER);
+          if (status != storage::Status::OK) {
+            QuitOnError(status, "Journal::Put");
+            return;
+          }
+          phases_.back().operation_count++;
+          phases_.back().byte_count += keys_[i].size() + values_[i].size();
+        }
+        journal_->Commit([this, on_done](
+            storage::Status status,
+            std::unique_ptr<const storage::Commit> commit) {
+          if (status != storage::Status::OK) {
+            QuitOnError(status, "Journal::Commit");
+            return;
+          }
+          commits_.push_back(std::move(commit));
+          // The next batch replaces |journal_|, which must not be deleted
+          // while running this callback.
+          mtl::MessageLoop::GetCurrent()->task_runner()->PostTask(on_done);
+        });
+      },
+      [this] {
+        TRACE_ASYNC_END("benchmark", "commit", 0);
+        EndPhase();
+        journal_.reset();
+        RunGetObject();
+      });
+}
+
+void StorageBenchmark::RunGetObject() {
+  StartPhase("get_object");
+  TRACE_ASYNC_BEGIN("benchmark", "get_object", 0);
+  RunSequentially(
+      entry_count_,
+      [this](size_t i, ftl::Closure on_done) {
+        storage_->GetObject(
+            object_ids_[i], storage::PageStorage::Location::LOCAL,
+            [this, on_done](storage::Status status,
+                            std::unique_ptr<const storage::Object> object) {
+              ftl::StringView data;
+              if (status == storage::Status::OK) {
+                status = object->GetData(&data);
+              }
+              if (status != storage::Status::OK) {
+                QuitOnError(status, "PageStorage::GetObject");
+                return;
+              }
+              phases_.back().operation_count++;
+              phases_.back().byte_count += data.size();
+              on_done();
+            });
+      },
+      [this] {
+        TRACE_ASYNC_END("benchmark", "get_object", 0);
+        EndPhase();
+        RunGetEntry();
+      });
+}
+
+void StorageBenchmark::RunGetEntry() {
+  std::vector<size_t> order(entry_count_);
+  for (size_t i = 0; i < entry_count_; ++i) {
+    order[i] = i;
+  }
+  std::shuffle(order.begin(), order.end(), rng_);
+
+  StartPhase("get_entry");
+  TRACE_ASYNC_BEGIN("benchmark", "get_entry", 0);
+  RunSequentially(
+      entry_count_,
+      [ this, order = std::move(order) ](size_t i, ftl::Closure on_done) {
+        storage_->GetEntryFromCommit(
+            *commits_.back(), keys_[order[i]],
+            [this, on_done](storage::Status status, storage::Entry entry) {
+              if (status != storage::Status::OK) {
+                QuitOnError(status, "PageStorage::GetEntryFromCommit");
+                return;
+              }
+              phases_.back().operation_count++;
+              phases_.back().byte_count += entry.key.size();
+              on_done();
+            });
+      },
+      [this] {
+        TRACE_ASYNC_END("benchmark", "get_entry", 0);
+        EndPhase();
+        RunScan();
+      });
+}
+
+void StorageBenchmark::RunScan() {
+  StartPhase("scan");
+  TRACE_ASYNC_BEGIN("benchmark", "scan", 0);
+  RunSequentially(
+      kScanCount,
+      [this](size_t i, ftl::Closure on_done) {
+        storage_->GetCommitContents(
+            *commits_.back(), "",
+            [this](storage::Entry entry) {
+              phases_.back().operation_count++;
+              phases_.back().byte_count += entry.key.size();
+              return true;
+            },
+            [this, on_done](storage::Status status) {
+              if (status != storage::Status::OK) {
+                QuitOnError(status, "PageStorage::GetCommitContents");
+                return;
+              }
+              on_done();
+            });
+      },
+      [this] {
+        TRACE_ASYNC_END("benchmark", "scan", 0);
+        EndPhase();
+        RunDiff();
+      });
+}
+
+void StorageBenchmark::RunDiff() {
+  std::vector<size_t> distances;
+  for (size_t distance : kDiffDistances) {
+    if (distance < commits_.size()) {
+      distances.push_back(distance);
+    }
+  }
+
+  StartPhase("diff");
+  TRACE_ASYNC_BEGIN("benchmark", "diff", 0);
+  RunSequentially(
+      distances.size(),
+      [ this, distances ](size_t i, ftl::Closure on_done) {
+        const storage::Commit& base =
+            *commits_[commits_.size() - 1 - distances[i]];
+        storage_->GetCommitContentsDiff(
+            base, *commits_.back(), "",
+            [this](storage::EntryChange change) {
+              phases_.back().operation_count++;
+              phases_.back().byte_count += change.entry.key.size();
+              return true;
+            },
+            [this, on_done](storage::Status status) {
+              if (status != storage::Status::OK) {
+                QuitOnError(status, "PageStorage::GetCommitContentsDiff");
+                return;
+              }
+              on_done();
+            });
+      },
+      [this] {
+        TRACE_ASYNC_END("benchmark", "diff", 0);
+        EndPhase();
+        ShutDown();
+      });
+}
+
+void StorageBenchmark::QuitOnError(storage::Status status,
+                                   const char* operation) {
+  FTL_LOG(ERROR) << operation << " failed with status " << status << ".";
+  mtl::MessageLoop::GetCurrent()->PostQuitTask();
+}
+
+void StorageBenchmark::ShutDown() {
+  mtl::MessageLoop::GetCurrent()->PostQuitTask();
+}
+
+}  // namespace benchmark
+
+int main(int argc, const char** argv) {
+  ftl::CommandLine command_line = ftl::CommandLineFromArgcArgv(argc, argv);
+
+  std::string entry_count_str;
+  size_t entry_count;
+  std::string key_size_str;
+  size_t key_size;
+  std::string value_size_str;
+  size_t min_value_size;
+  size_t max_value_size;
+  std::string batch_size_str;
+  size_t batch_size = 1;
+  std::string seed_str;
+  uint64_t seed = 0u;
+  if (!command_line.GetOptionValue(kEntryCountFlag.ToString(),
+                                   &entry_count_str) ||
+      !ftl::StringToNumberWithError(entry_count_str, &entry_count) ||
+      entry_count == 0 ||
+      !command_line.GetOptionValue(kKeySizeFlag.ToString(), &key_size_str) ||
+      !ftl::StringToNumberWithError(key_size_str, &key_size) ||
+      key_size == 0 ||
+      !command_line.GetOptionValue(kValueSizeFlag.ToString(),
+                                   &value_size_str) ||
+      !ParseValueSize(value_size_str, &min_value_size, &max_value_size) ||
+      (command_line.GetOptionValue(kBatchSizeFlag.ToString(),
+                                   &batch_size_str) &&
+       (!ftl::StringToNumberWithError(batch_size_str, &batch_size) ||
+        batch_size == 0)) ||
+      (command_line.GetOptionValue(kSeedFlag.ToString(), &seed_str) &&
+       !ftl::StringToNumberWithError(seed_str, &seed))) {
+    PrintUsage(argv[0]);
+    return -1;
+  }
+
+  mtl::MessageLoop loop;
+  benchmark::StorageBenchmark app(entry_count, key_size, min_value_size,
+                                  max_value_size, batch_size, seed);
+  loop.task_runner()->PostTask([&app] { app.Run(); });
+  loop.Run();
+  return 0;
+}
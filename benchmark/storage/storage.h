@@ -0,0 +1,121 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_BENCHMARK_STORAGE_STORAGE_H_
+#define APPS_LEDGER_BENCHMARK_STORAGE_STORAGE_H_
+
+#include <stdint.h>
+
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "application/lib/app/application_context.h"
+#include "apps/ledger/src/coroutine/coroutine_impl.h"
+#include "apps/ledger/src/storage/impl/page_storage_impl.h"
+#include "apps/ledger/src/storage/public/commit.h"
+#include "apps/ledger/src/storage/public/journal.h"
+#include "apps/ledger/src/storage/public/types.h"
+#include "lib/ftl/files/scoped_temp_dir.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/ref_ptr.h"
+#include "lib/ftl/tasks/task_runner.h"
+#include "lib/ftl/time/time_point.h"
+
+namespace benchmark {
+
+// Benchmark of the storage layer, using storage::PageStorageImpl directly
+// instead of going through the Ledger application. It runs the following
+// phases on a page stored in a temporary directory, and prints the throughput
+// and the number of heap allocations of each:
+//   - encode_node, decode_node: serialization of a tree node,
+//   - add_object: addition of the values as local objects,
+//   - commit: addition of the entries to the page, in batches of
+//     |batch_size| entries per commit,
+//   - get_object: reads of the values,
+//   - get_entry: lookups of the entries in the head commit, in random order,
+//   - scan: listing of the entries of the head commit,
+//   - diff: diffs of the head commit with commits 1, 10 and 100 batches older.
+// Each phase is also recorded as an async trace event.
+//
+// Parameters:
+//   --entry-count=<int> the number of entries to be put
+//   --key-size=<int> the size of a key in bytes
+//   --value-size=<int>[-<int>] the size of a value in bytes, or the bounds of
+//     a uniform distribution of sizes
+//   --batch-size=<int> the number of entries per commit
+//   --seed=<int> the seed of the generated data
+class StorageBenchmark {
+ public:
+  StorageBenchmark(size_t entry_count,
+                   size_t key_size,
+                   size_t min_value_size,
+                   size_t max_value_size,
+                   size_t batch_size,
+                   uint64_t seed);
+  ~StorageBenchmark();
+
+  void Run();
+
+ private:
+  // Measurement of a single phase.
+  struct Phase {
+    std::string name;
+    ftl::TimePoint start;
+    // Allocation counters at the start of the phase.
+    uint64_t allocation_count = 0u;
+    uint64_t allocated_bytes = 0u;
+    uint64_t operation_count = 0u;
+    uint64_t byte_count = 0u;
+  };
+
+  void GenerateData();
+
+  void StartPhase(std::string name);
+  void EndPhase();
+
+  void RunEncodeNode();
+  void RunDecodeNode();
+  void RunAddObject();
+  void RunCommit();
+  void RunGetObject();
+  void RunGetEntry();
+  void RunScan();
+  void RunDiff();
+
+  void QuitOnError(storage::Status status, const char* operation);
+
+  void ShutDown();
+
+  std::unique_ptr<app::ApplicationContext> application_context_;
+  files::ScopedTempDir tmp_dir_;
+  const size_t entry_count_;
+  const size_t key_size_;
+  const size_t min_value_size_;
+  const size_t max_value_size_;
+  const size_t batch_size_;
+  std::default_random_engine rng_;
+
+  std::thread io_thread_;
+  ftl::RefPtr<ftl::TaskRunner> io_runner_;
+  coroutine::CoroutineServiceImpl coroutine_service_;
+  std::unique_ptr<storage::PageStorageImpl> storage_;
+  // Journal of the commit in progress, if any.
+  std::unique_ptr<storage::Journal> journal_;
+
+  std::vector<std::string> keys_;
+  std::vector<std::string> values_;
+  std::vector<storage::ObjectId> object_ids_;
+  // Commits created by the commit phase, the last one being the head.
+  std::vector<std::unique_ptr<const storage::Commit>> commits_;
+  std::vector<Phase> phases_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(StorageBenchmark);
+};
+
+}  // namespace benchmark
+
+#endif  // APPS_LEDGER_BENCHMARK_STORAGE_STORAGE_H_
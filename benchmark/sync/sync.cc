@@ -24,11 +24,16 @@ constexpr ftl::StringView kStoragePath = "/data/benchmark/ledger/sync";
 constexpr ftl::StringView kEntryCountFlag = "entry-count";
 constexpr ftl::StringView kValueSizeFlag = "value-size";
 constexpr ftl::StringView kServerIdFlag = "server-id";
+constexpr ftl::StringView kFakeCloudFlag = "fake-cloud";
+// Firebase instance identifier used with the fake cloud, unless one is given.
+constexpr ftl::StringView kFakeServerId = "fake";
+// Flags with this prefix are passed to the Ledger applications.
+constexpr ftl::StringView kNetworkFlagPrefix = "network_";
 
 void PrintUsage(const char* executable_name) {
   std::cout << "Usage: " << executable_name << " --" << kEntryCountFlag
-            << "=<int> --" << kValueSizeFlag << "=<int> --" << kServerIdFlag
-            << "=<string>" << std::endl;
+            << "=<int> --" << kValueSizeFlag << "=<int> (--" << kServerIdFlag
+            << "=<string> | --" << kFakeCloudFlag << ")" << std::endl;
 }
 
 }  // namespace
@@ -37,11 +42,15 @@ namespace benchmark {
 
 SyncBenchmark::SyncBenchmark(int entry_count,
                              int value_size,
-                             std::string server_id)
+                             std::string server_id,
+                             bool fake_cloud,
+                             std::vector<std::string> ledger_arguments)
     : application_context_(app::ApplicationContext::CreateFromStartupInfo()),
       entry_count_(entry_count),
       value_size_(value_size),
       server_id_(std::move(server_id)),
+      fake_cloud_(fake_cloud),
+      ledger_arguments_(std::move(ledger_arguments)),
       page_watcher_binding_(this),
       alpha_tmp_dir_(kStoragePath),
       beta_tmp_dir_(kStoragePath) {
@@ -62,12 +71,8 @@ void SyncBenchmark::Run() {
   ret = files::CreateDirectory(beta_path);
   FTL_DCHECK(ret);
 
-  ledger::LedgerPtr alpha =
-      benchmark::GetLedger(application_context_.get(), &alpha_controller_,
-                           "sync", alpha_path, true, server_id_);
-  ledger::LedgerPtr beta =
-      benchmark::GetLedger(application_context_.get(), &beta_controller_,
-                           "sync", beta_path, true, server_id_);
+  ledger::LedgerPtr alpha = GetSyncLedger(&alpha_controller_, alpha_path);
+  ledger::LedgerPtr beta = GetSyncLedger(&beta_controller_, beta_path);
 
   benchmark::GetPageEnsureInitialized(
       alpha.get(), nullptr,
@@ -101,6 +106,30 @@ void SyncBenchmark::OnChange(ledger::PageChangePtr page_change,
   callback(nullptr);
 }
 
+ledger::LedgerPtr SyncBenchmark::GetSyncLedger(
+    app::ApplicationControllerPtr* controller,
+    std::string repository_path) {
+  if (!fake_cloud_) {
+    ledger::LedgerRepositoryFactoryPtr repository_factory =
+        benchmark::LaunchLedger(application_context_.get(), controller,
+                                ledger_arguments_);
+    return benchmark::GetLedgerFromFactory(repository_factory.get(), "sync",
+                                           std::move(repository_path), true,
+                                           server_id_);
+  }
+  // The fake cloud lives in the Ledger application, so that all instances must
+  // be served by the same application to sync with each other.
+  if (!repository_factory_) {
+    std::vector<std::string> arguments = ledger_arguments_;
+    arguments.push_back("--fake_cloud");
+    repository_factory_ = benchmark::LaunchLedger(application_context_.get(),
+                                                  controller, arguments);
+  }
+  return benchmark::GetLedgerFromFactory(repository_factory_.get(), "sync",
+                                         std::move(repository_path), true,
+                                         server_id_);
+}
+
 void SyncBenchmark::RunSingle(int i) {
   if (i == entry_count_) {
     Backlog();
@@ -119,8 +148,7 @@ void SyncBenchmark::Backlog() {
   bool ret = files::CreateDirectory(gamma_path);
   FTL_DCHECK(ret);
 
-  gamma_ = benchmark::GetLedger(application_context_.get(), &gamma_controller_,
-                                "sync", gamma_path, true, server_id_);
+  gamma_ = GetSyncLedger(&gamma_controller_, gamma_path);
   TRACE_ASYNC_BEGIN("benchmark", "get and verify backlog", 0);
   gamma_->GetPage(page_id_.Clone(), gamma_page_.NewRequest(),
                   [this](ledger::Status status) {
@@ -154,15 +182,16 @@ void SyncBenchmark::VerifyBacklog() {
 }
 
 void SyncBenchmark::ShutDown() {
-  alpha_controller_->Kill();
-  alpha_controller_.WaitForIncomingResponseWithTimeout(
-      ftl::TimeDelta::FromSeconds(5));
-  beta_controller_->Kill();
-  beta_controller_.WaitForIncomingResponseWithTimeout(
-      ftl::TimeDelta::FromSeconds(5));
-  gamma_controller_->Kill();
-  gamma_controller_.WaitForIncomingResponseWithTimeout(
-      ftl::TimeDelta::FromSeconds(5));
+  // When the fake cloud is used, only |alpha_controller_| is bound.
+  for (auto* controller :
+       {&alpha_controller_, &beta_controller_, &gamma_controller_}) {
+    if (!*controller) {
+      continue;
+    }
+    (*controller)->Kill();
+    controller->WaitForIncomingResponseWithTimeout(
+        ftl::TimeDelta::FromSeconds(5));
+  }
   mtl::MessageLoop::GetCurrent()->PostQuitTask();
 }
 }  // namespace benchmark
@@ -175,6 +204,7 @@ int main(int argc, const char** argv) {
   std::string value_size_str;
   int value_size;
   std::string server_id;
+  bool fake_cloud = command_line.HasOption(kFakeCloudFlag.ToString());
   if (!command_line.GetOptionValue(kEntryCountFlag.ToString(),
                                    &entry_count_str) ||
       !ftl::StringToNumberWithError(entry_count_str, &entry_count) ||
@@ -182,14 +212,29 @@ int main(int argc, const char** argv) {
       !command_line.GetOptionValue(kValueSizeFlag.ToString(),
                                    &value_size_str) ||
       !ftl::StringToNumberWithError(value_size_str, &value_size) ||
-      value_size <= 0 ||
-      !command_line.GetOptionValue(kServerIdFlag.ToString(), &server_id)) {
+      value_size <= 0) {
     PrintUsage(argv[0]);
     return -1;
   }
+  if (!command_line.GetOptionValue(kServerIdFlag.ToString(), &server_id)) {
+    if (!fake_cloud) {
+      PrintUsage(argv[0]);
+      return -1;
+    }
+    server_id = kFakeServerId.ToString();
+  }
+
+  std::vector<std::string> ledger_arguments;
+  for (const auto& option : command_line.options()) {
+    if (ftl::StringView(option.name).substr(0, kNetworkFlagPrefix.size()) ==
+        kNetworkFlagPrefix) {
+      ledger_arguments.push_back("--" + option.name + "=" + option.value);
+    }
+  }
 
   mtl::MessageLoop loop;
-  benchmark::SyncBenchmark app(entry_count, value_size, server_id);
+  benchmark::SyncBenchmark app(entry_count, value_size, server_id, fake_cloud,
+                               std::move(ledger_arguments));
   loop.task_runner()->PostTask([&app] { app.Run(); });
   loop.Run();
   return 0;
@@ -6,6 +6,8 @@
 #define APPS_LEDGER_BENCHMARK_SYNC_SYNC_H_
 
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "application/lib/app/application_context.h"
 #include "apps/ledger/services/public/ledger.fidl.h"
@@ -18,15 +20,26 @@ namespace benchmark {
 // instances have separate disk storage.
 //
 // Cloud sync needs to be configured on the device in order for the benchmark to
-// run.
+// run, unless --fake-cloud is passed. In that case, a single Ledger
+// application is started, serving the requests to the cloud from an in-memory
+// fake, and the Ledger instances are separate repositories of this
+// application.
 //
 // Parameters:
 //   --entry-count=<int> the number of entries to be put
 //   --value-size=<int> the size of a single value in bytes
 //   --server-id=<string> the ID of the Firebase instance ot use for syncing
+//   --fake-cloud sync through an in-memory fake cloud instead of Firebase
+//   --network_<option>=<value> network emulation flags passed to the Ledger
+//     application, e.g. --network_profile=3g (see
+//     src/network/network_conditions.h)
 class SyncBenchmark : public ledger::PageWatcher {
  public:
-  SyncBenchmark(int entry_count, int value_size, std::string server_id);
+  SyncBenchmark(int entry_count,
+                int value_size,
+                std::string server_id,
+                bool fake_cloud,
+                std::vector<std::string> ledger_arguments);
 
   void Run();
 
@@ -36,6 +49,12 @@ class SyncBenchmark : public ledger::PageWatcher {
                 const OnChangeCallback& callback) override;
 
  private:
+  // Returns the Ledger instance of the repository at |repository_path|. Starts
+  // a new Ledger application controlled by |controller|, unless the fake cloud
+  // is used and the application is already started.
+  ledger::LedgerPtr GetSyncLedger(app::ApplicationControllerPtr* controller,
+                                  std::string repository_path);
+
   void RunSingle(int i);
 
   void Backlog();
@@ -48,6 +67,9 @@ class SyncBenchmark : public ledger::PageWatcher {
   const int entry_count_;
   const int value_size_;
   std::string server_id_;
+  const bool fake_cloud_;
+  // Command line arguments of the Ledger applications.
+  std::vector<std::string> ledger_arguments_;
   fidl::Binding<ledger::PageWatcher> page_watcher_binding_;
   files::ScopedTempDir alpha_tmp_dir_;
   files::ScopedTempDir beta_tmp_dir_;
@@ -55,6 +77,9 @@ class SyncBenchmark : public ledger::PageWatcher {
   app::ApplicationControllerPtr alpha_controller_;
   app::ApplicationControllerPtr beta_controller_;
   app::ApplicationControllerPtr gamma_controller_;
+  // Factory of the Ledger application shared by all instances, when the fake
+  // cloud is used.
+  ledger::LedgerRepositoryFactoryPtr repository_factory_;
   ledger::LedgerPtr gamma_;
   fidl::Array<uint8_t> page_id_;
   ledger::PagePtr alpha_page_;
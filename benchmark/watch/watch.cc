@@ -0,0 +1,179 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/benchmark/watch/watch.h"
+
+#include <iostream>
+
+#include "apps/ledger/benchmark/lib/convert.h"
+#include "apps/ledger/benchmark/lib/data.h"
+#include "apps/ledger/benchmark/lib/get_ledger.h"
+#include "apps/ledger/benchmark/lib/logging.h"
+#include "apps/tracing/lib/trace/event.h"
+#include "apps/tracing/lib/trace/provider.h"
+#include "lib/ftl/command_line.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/strings/string_number_conversions.h"
+#include "lib/mtl/tasks/message_loop.h"
+
+namespace {
+constexpr ftl::StringView kStoragePath = "/data/benchmark/ledger/watch";
+constexpr ftl::StringView kEntryCountFlag = "entry-count";
+constexpr ftl::StringView kValueSizeFlag = "value-size";
+constexpr ftl::StringView kWatcherCountFlag = "watcher-count";
+constexpr ftl::StringView kPrefixCountFlag = "prefix-count";
+
+void PrintUsage(const char* executable_name) {
+  std::cout << "Usage: " << executable_name << " --" << kEntryCountFlag
+            << "=<int> --" << kValueSizeFlag << "=<int> --"
+            << kWatcherCountFlag << "=<int> [--" << kPrefixCountFlag
+            << "=<int>]" << std::endl;
+}
+
+bool GetPositiveIntOption(const ftl::CommandLine& command_line,
+                          ftl::StringView flag,
+                          int* value) {
+  std::string value_str;
+  return command_line.GetOptionValue(flag.ToString(), &value_str) &&
+         ftl::StringToNumberWithError(value_str, value) && *value > 0;
+}
+
+}  // namespace
+
+namespace benchmark {
+
+WatchBenchmark::Watcher::Watcher(WatchBenchmark* benchmark, int index)
+    : benchmark_(benchmark), index_(index), binding_(this) {}
+
+WatchBenchmark::Watcher::~Watcher() {}
+
+fidl::InterfaceHandle<ledger::PageWatcher>
+WatchBenchmark::Watcher::NewBinding() {
+  return binding_.NewBinding();
+}
+
+void WatchBenchmark::Watcher::OnChange(ledger::PageChangePtr page_change,
+                                       ledger::ResultState result_state,
+                                       const OnChangeCallback& callback) {
+  FTL_DCHECK(result_state == ledger::ResultState::COMPLETED);
+  callback(nullptr);
+  benchmark_->OnWatcherNotified(index_);
+}
+
+WatchBenchmark::WatchBenchmark(int entry_count,
+                               int value_size,
+                               int watcher_count,
+                               int prefix_count)
+    : tmp_dir_(kStoragePath),
+      application_context_(app::ApplicationContext::CreateFromStartupInfo()),
+      entry_count_(entry_count),
+      value_size_(value_size),
+      watcher_count_(watcher_count),
+      prefix_count_(prefix_count) {
+  FTL_DCHECK(entry_count > 0);
+  FTL_DCHECK(value_size > 0);
+  FTL_DCHECK(watcher_count > 0);
+  FTL_DCHECK(prefix_count > 0 && prefix_count <= watcher_count);
+  tracing::InitializeTracer(application_context_.get(),
+                            {"benchmark_ledger_watch"});
+}
+
+void WatchBenchmark::Run() {
+  ledger::LedgerPtr ledger =
+      benchmark::GetLedger(application_context_.get(), &ledger_controller_,
+                           "watch", tmp_dir_.path(), false, "");
+  benchmark::GetPageEnsureInitialized(ledger.get(), nullptr,
+                                      [this](ledger::PagePtr page, auto id) {
+                                        page_ = std::move(page);
+                                        RegisterWatcher(0);
+                                      });
+}
+
+void WatchBenchmark::RegisterWatcher(int i) {
+  if (i == watcher_count_) {
+    RunSingle(0);
+    return;
+  }
+  watchers_.push_back(std::make_unique<Watcher>(this, i));
+  ledger::PageSnapshotPtr snapshot;
+  page_->GetSnapshot(snapshot.NewRequest(),
+                     benchmark::ToArray(GetPrefix(i % prefix_count_)),
+                     watchers_.back()->NewBinding(),
+                     [this, i](ledger::Status status) {
+                       if (benchmark::QuitOnError(status, "GetSnapshot")) {
+                         return;
+                       }
+                       RegisterWatcher(i + 1);
+                     });
+}
+
+void WatchBenchmark::RunSingle(int i) {
+  if (i == entry_count_) {
+    ShutDown();
+    return;
+  }
+
+  current_entry_ = i;
+  pending_notifications_ = 0;
+  for (int w = 0; w < watcher_count_; w++) {
+    if (w % prefix_count_ == i % prefix_count_) {
+      pending_notifications_++;
+    }
+  }
+  fidl::Array<uint8_t> key = benchmark::MakeKey(i);
+  key = benchmark::ToArray(GetPrefix(i % prefix_count_) +
+                           benchmark::ToString(key));
+  fidl::Array<uint8_t> value = benchmark::MakeValue(value_size_);
+  TRACE_ASYNC_BEGIN("benchmark", "watch latency", i);
+  page_->Put(std::move(key), std::move(value),
+             benchmark::QuitOnErrorCallback("Page::Put"));
+}
+
+void WatchBenchmark::OnWatcherNotified(int watcher_index) {
+  FTL_DCHECK(watcher_index % prefix_count_ == current_entry_ % prefix_count_);
+  FTL_DCHECK(pending_notifications_ > 0);
+  if (--pending_notifications_ > 0) {
+    return;
+  }
+  TRACE_ASYNC_END("benchmark", "watch latency", current_entry_);
+  RunSingle(current_entry_ + 1);
+}
+
+std::string WatchBenchmark::GetPrefix(int i) const {
+  return "prefix" + std::to_string(i) + "/";
+}
+
+void WatchBenchmark::ShutDown() {
+  // Shut down the Ledger process first as it relies on |tmp_dir_| storage.
+  ledger_controller_->Kill();
+  ledger_controller_.WaitForIncomingResponseWithTimeout(
+      ftl::TimeDelta::FromSeconds(5));
+  mtl::MessageLoop::GetCurrent()->PostQuitTask();
+}
+}  // namespace benchmark
+
+int main(int argc, const char** argv) {
+  ftl::CommandLine command_line = ftl::CommandLineFromArgcArgv(argc, argv);
+
+  int entry_count;
+  int value_size;
+  int watcher_count;
+  int prefix_count = 1;
+  if (!GetPositiveIntOption(command_line, kEntryCountFlag, &entry_count) ||
+      !GetPositiveIntOption(command_line, kValueSizeFlag, &value_size) ||
+      !GetPositiveIntOption(command_line, kWatcherCountFlag, &watcher_count) ||
+      (command_line.HasOption(kPrefixCountFlag.ToString()) &&
+       !GetPositiveIntOption(command_line, kPrefixCountFlag, &prefix_count)) ||
+      prefix_count > watcher_count) {
+    PrintUsage(argv[0]);
+    return -1;
+  }
+
+  mtl::MessageLoop loop;
+  benchmark::WatchBenchmark app(entry_count, value_size, watcher_count,
+                                prefix_count);
+  loop.task_runner()->PostTask([&app] { app.Run(); });
+  loop.Run();
+  return 0;
+}
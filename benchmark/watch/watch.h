@@ -0,0 +1,96 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_BENCHMARK_WATCH_WATCH_H_
+#define APPS_LEDGER_BENCHMARK_WATCH_WATCH_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "application/lib/app/application_context.h"
+#include "apps/ledger/services/public/ledger.fidl.h"
+#include "lib/fidl/cpp/bindings/binding.h"
+#include "lib/ftl/files/scoped_temp_dir.h"
+
+namespace benchmark {
+
+// Benchmark that measures the latency between a change of a page and the
+// delivery of the corresponding OnChange() notifications, when several
+// watchers are registered on the page.
+//
+// Watcher |w| only watches the keys starting with the prefix |w| modulo
+// |prefix_count|, and the entries are put under each prefix in turn, so that
+// each change is notified to watcher_count / prefix_count watchers. The
+// "watch latency" event ends when all of them are notified.
+//
+// Parameters:
+//   --entry-count=<int> the number of entries to be put
+//   --value-size=<int> the size of a single value in bytes
+//   --watcher-count=<int> the number of watchers registered on the page
+//   --prefix-count=<int> the number of distinct key prefixes watched, at most
+//     the number of watchers
+class WatchBenchmark {
+ public:
+  WatchBenchmark(int entry_count,
+                 int value_size,
+                 int watcher_count,
+                 int prefix_count);
+
+  void Run();
+
+ private:
+  class Watcher : public ledger::PageWatcher {
+   public:
+    Watcher(WatchBenchmark* benchmark, int index);
+    ~Watcher() override;
+
+    fidl::InterfaceHandle<ledger::PageWatcher> NewBinding();
+
+   private:
+    // ledger::PageWatcher:
+    void OnChange(ledger::PageChangePtr page_change,
+                  ledger::ResultState result_state,
+                  const OnChangeCallback& callback) override;
+
+    WatchBenchmark* const benchmark_;
+    const int index_;
+    fidl::Binding<ledger::PageWatcher> binding_;
+
+    FTL_DISALLOW_COPY_AND_ASSIGN(Watcher);
+  };
+
+  // Registers the watchers, starting with the |i|-th one.
+  void RegisterWatcher(int i);
+
+  void RunSingle(int i);
+
+  // Called by the |watcher_index|-th watcher for each change notified.
+  void OnWatcherNotified(int watcher_index);
+
+  std::string GetPrefix(int i) const;
+
+  void ShutDown();
+
+  files::ScopedTempDir tmp_dir_;
+  std::unique_ptr<app::ApplicationContext> application_context_;
+  const int entry_count_;
+  const int value_size_;
+  const int watcher_count_;
+  const int prefix_count_;
+
+  std::vector<std::unique_ptr<Watcher>> watchers_;
+  // Index of the entry being put, and number of watchers yet to be notified
+  // of it.
+  int current_entry_ = 0;
+  int pending_notifications_ = 0;
+  app::ApplicationControllerPtr ledger_controller_;
+  ledger::PagePtr page_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(WatchBenchmark);
+};
+
+}  // namespace benchmark
+
+#endif  // APPS_LEDGER_BENCHMARK_WATCH_WATCH_H_
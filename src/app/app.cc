@@ -6,14 +6,23 @@
 #include <magenta/device/vfs.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <memory>
+#include <string>
 #include <utility>
 
 #include "application/lib/app/application_context.h"
 #include "apps/ledger/services/internal/internal.fidl.h"
+#include "apps/ledger/src/app/ledger_debug_impl.h"
 #include "apps/ledger/src/app/ledger_repository_factory_impl.h"
 #include "apps/ledger/src/backoff/exponential_backoff.h"
+#include "apps/ledger/src/cloud_sync/public/prefetch_policy.h"
 #include "apps/ledger/src/environment/environment.h"
+#include "apps/ledger/src/fake_cloud/fake_cloud_network_service.h"
+#include "apps/ledger/src/metrics/memory_budget.h"
+#include "apps/ledger/src/metrics/metrics_registry.h"
+#include "apps/ledger/src/network/emulated_network_service.h"
+#include "apps/ledger/src/network/network_conditions.h"
 #include "apps/ledger/src/network/network_service_impl.h"
 #include "apps/network/services/network_service.fidl.h"
 #include "apps/tracing/lib/trace/provider.h"
@@ -22,6 +31,7 @@
 #include "lib/ftl/files/unique_fd.h"
 #include "lib/ftl/logging.h"
 #include "lib/ftl/macros.h"
+#include "lib/ftl/strings/string_number_conversions.h"
 #include "lib/ftl/time/time_delta.h"
 #include "lib/ftl/time/time_point.h"
 #include "lib/mtl/tasks/message_loop.h"
@@ -32,11 +42,37 @@ constexpr ftl::StringView kPersistentFileSystem = "/data";
 constexpr ftl::StringView kMinFsName = "minfs";
 constexpr ftl::TimeDelta kMaxPollingDelay = ftl::TimeDelta::FromSeconds(10);
 constexpr ftl::StringView kNoMinFsFlag = "no_minfs_wait";
+// Serves the requests to the cloud from an in-memory fake instead of the
+// network. Used to run sync hermetically, e.g. in benchmarks.
+constexpr ftl::StringView kFakeCloudFlag = "fake_cloud";
+// Memory budget of the application, in megabytes. The caches are trimmed when
+// the accounted memory exceeds it. 0, the default, disables the budget: memory
+// is only accounted.
+constexpr ftl::StringView kMemoryBudgetFlag = "memory_budget_mb";
+constexpr int64_t kDefaultMemoryBudgetMb = 0;
+// Enables the prefetching of the values of LAZY entries synced from the cloud.
+// The value is an optional comma-separated list of key prefixes; all keys are
+// prefetched if it is empty.
+constexpr ftl::StringView kPrefetchFlag = "prefetch_lazy_values";
+// Maximum number of megabytes prefetched per page.
+constexpr ftl::StringView kPrefetchMaxMbFlag = "prefetch_max_mb";
+// Number of key prefixes recently fetched by clients whose values are also
+// prefetched.
+constexpr ftl::StringView kPrefetchRecentPrefixesFlag =
+    "prefetch_recent_prefixes";
 
 // Maximal time to wait before doing a merge to prevent multiple devices
 // competing on solving the same merge.
 constexpr ftl::TimeDelta kMaxMergingDelay = ftl::TimeDelta::FromSeconds(2);
 
+// Parameters of the Ledger application, set from the command line.
+struct AppParams {
+  bool use_fake_cloud = false;
+  NetworkEmulationConfig network_emulation;
+  int64_t memory_budget_bytes = kDefaultMemoryBudgetMb * 1024 * 1024;
+  cloud_sync::PrefetchPolicy prefetch_policy;
+};
+
 // App is the main entry point of the Ledger application.
 //
 // It is responsible for setting up the LedgerRepositoryFactory, which connects
@@ -45,24 +81,47 @@ constexpr ftl::TimeDelta kMaxMergingDelay = ftl::TimeDelta::FromSeconds(2);
 // separate processes when the app becomes multi-instance.
 class App : public LedgerController {
  public:
-  App()
-      : application_context_(app::ApplicationContext::CreateFromStartupInfo()) {
+  explicit App(AppParams app_params)
+      : app_params_(std::move(app_params)),
+        application_context_(app::ApplicationContext::CreateFromStartupInfo()) {
     FTL_DCHECK(application_context_);
     tracing::InitializeTracer(application_context_.get(), {"ledger"});
   }
   ~App() {}
 
   bool Start() {
-    network_service_ = std::make_unique<ledger::NetworkServiceImpl>(
-        loop_.task_runner(), [this] {
-          return application_context_
-              ->ConnectToEnvironmentService<network::NetworkService>();
-        });
+    // The budget must be set before any component registers its metrics.
+    memory_budget_ = std::make_unique<metrics::MemoryBudget>(
+        loop_.task_runner(), app_params_.memory_budget_bytes, &metrics_);
+    metrics_.SetMemoryBudget(memory_budget_.get());
+
+    if (app_params_.use_fake_cloud) {
+      FTL_LOG(INFO) << "Syncing with an in-memory fake cloud.";
+      base_network_service_ =
+          std::make_unique<fake_cloud::FakeCloudNetworkService>(
+              loop_.task_runner());
+    } else {
+      base_network_service_ = std::make_unique<ledger::NetworkServiceImpl>(
+          loop_.task_runner(),
+          [this] {
+            return application_context_
+                ->ConnectToEnvironmentService<network::NetworkService>();
+          },
+          metrics_.GetChild("network"));
+    }
+    if (app_params_.network_emulation.IsEmulated()) {
+      FTL_LOG(INFO) << "Emulating degraded network conditions.";
+      network_service_ = std::make_unique<EmulatedNetworkService>(
+          loop_.task_runner(), base_network_service_.get(),
+          app_params_.network_emulation);
+    }
     environment_ = std::make_unique<Environment>(
-        loop_.task_runner(), network_service_.get(), kMaxMergingDelay);
+        loop_.task_runner(),
+        network_service_ ? network_service_.get() : base_network_service_.get(),
+        kMaxMergingDelay, nullptr, &metrics_);
 
-    factory_impl_ =
-        std::make_unique<LedgerRepositoryFactoryImpl>(environment_.get());
+    factory_impl_ = std::make_unique<LedgerRepositoryFactoryImpl>(
+        environment_.get(), app_params_.prefetch_policy);
 
     application_context_->outgoing_services()
         ->AddService<LedgerRepositoryFactory>(
@@ -74,6 +133,11 @@ class App : public LedgerController {
         [this](fidl::InterfaceRequest<LedgerController> request) {
           controller_bindings_.AddBinding(this, std::move(request));
         });
+    debug_impl_ = std::make_unique<LedgerDebugImpl>(&metrics_);
+    application_context_->outgoing_services()->AddService<LedgerDebug>(
+        [this](fidl::InterfaceRequest<LedgerDebug> request) {
+          debug_bindings_.AddBinding(debug_impl_.get(), std::move(request));
+        });
 
     loop_.Run();
 
@@ -84,13 +148,21 @@ class App : public LedgerController {
   // LedgerController implementation.
   void Terminate() override { loop_.PostQuitTask(); }
 
+  const AppParams app_params_;
   mtl::MessageLoop loop_;
   std::unique_ptr<app::ApplicationContext> application_context_;
+  // Root of the metrics of all the components of the application.
+  metrics::MetricsRegistry metrics_;
+  std::unique_ptr<metrics::MemoryBudget> memory_budget_;
+  std::unique_ptr<NetworkService> base_network_service_;
+  // Wraps |base_network_service_| when emulating network conditions.
   std::unique_ptr<NetworkService> network_service_;
   std::unique_ptr<Environment> environment_;
   std::unique_ptr<LedgerRepositoryFactoryImpl> factory_impl_;
   fidl::BindingSet<LedgerRepositoryFactory> factory_bindings_;
   fidl::BindingSet<LedgerController> controller_bindings_;
+  std::unique_ptr<LedgerDebugImpl> debug_impl_;
+  fidl::BindingSet<LedgerDebug> debug_bindings_;
 
   FTL_DISALLOW_COPY_AND_ASSIGN(App);
 };
@@ -118,6 +190,40 @@ void WaitForData() {
                    << " is not persistent. Did you forget to configure it?";
 }
 
+// Parses the prefetch flags of |command_line| into |policy|. Returns false if
+// a flag is invalid.
+bool PrefetchPolicyFromCommandLine(const ftl::CommandLine& command_line,
+                                   cloud_sync::PrefetchPolicy* policy) {
+  std::string value;
+  if (!command_line.GetOptionValue(kPrefetchFlag.ToString(), &value)) {
+    return true;
+  }
+  policy->enabled = true;
+  ftl::StringView remaining = value;
+  do {
+    size_t end = std::min(remaining.find(','), remaining.size());
+    policy->key_prefixes.push_back(remaining.substr(0, end).ToString());
+    remaining = remaining.substr(std::min(end + 1, remaining.size()));
+  } while (!remaining.empty());
+
+  if (command_line.GetOptionValue(kPrefetchMaxMbFlag.ToString(), &value)) {
+    uint64_t max_mb;
+    if (!ftl::StringToNumberWithError(value, &max_mb)) {
+      FTL_LOG(ERROR) << "Invalid --" << kPrefetchMaxMbFlag << ": " << value;
+      return false;
+    }
+    policy->max_bytes = max_mb * 1024 * 1024;
+  }
+  if (command_line.GetOptionValue(kPrefetchRecentPrefixesFlag.ToString(),
+                                  &value) &&
+      !ftl::StringToNumberWithError(value, &policy->max_recent_prefixes)) {
+    FTL_LOG(ERROR) << "Invalid --" << kPrefetchRecentPrefixesFlag << ": "
+                   << value;
+    return false;
+  }
+  return true;
+}
+
 }  // namespace ledger
 
 int main(int argc, const char** argv) {
@@ -129,7 +235,30 @@ int main(int argc, const char** argv) {
     ledger::WaitForData();
   }
 
-  ledger::App app;
+  ledger::AppParams app_params;
+  app_params.use_fake_cloud =
+      command_line.HasOption(ledger::kFakeCloudFlag.ToString());
+  if (!ledger::NetworkEmulationConfigFromCommandLine(
+          command_line, &app_params.network_emulation)) {
+    return 1;
+  }
+  std::string memory_budget_mb;
+  if (command_line.GetOptionValue(ledger::kMemoryBudgetFlag.ToString(),
+                                  &memory_budget_mb)) {
+    int64_t value;
+    if (!ftl::StringToNumberWithError(memory_budget_mb, &value) || value < 0) {
+      FTL_LOG(ERROR) << "Invalid --" << ledger::kMemoryBudgetFlag << ": "
+                     << memory_budget_mb;
+      return 1;
+    }
+    app_params.memory_budget_bytes = value * 1024 * 1024;
+  }
+  if (!ledger::PrefetchPolicyFromCommandLine(command_line,
+                                             &app_params.prefetch_policy)) {
+    return 1;
+  }
+
+  ledger::App app(std::move(app_params));
   if (!app.Start()) {
     return 1;
   }
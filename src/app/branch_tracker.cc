@@ -9,9 +9,14 @@
 #include "apps/ledger/src/app/diff_utils.h"
 #include "apps/ledger/src/app/fidl/serialization_size.h"
 #include "apps/ledger/src/app/page_manager.h"
+#include "apps/ledger/src/callback/trace_callback.h"
+#include "apps/ledger/src/callback/trace_flow.h"
 #include "apps/ledger/src/callback/waiter.h"
+#include "apps/ledger/src/metrics/memory_budget.h"
+#include "apps/tracing/lib/trace/event.h"
 #include "lib/ftl/functional/auto_call.h"
 #include "lib/ftl/functional/make_copyable.h"
+#include "lib/ftl/time/time_point.h"
 
 namespace ledger {
 class BranchTracker::PageWatcherContainer {
@@ -21,14 +26,22 @@ class BranchTracker::PageWatcherContainer {
                        PageManager* page_manager,
                        storage::PageStorage* storage,
                        std::unique_ptr<const storage::Commit> base_commit,
-                       std::string key_prefix)
+                       std::string key_prefix,
+                       metrics::MetricsRegistry* metrics)
       : change_in_flight_(false),
         last_commit_(std::move(base_commit)),
         coroutine_service_(coroutine_service),
         key_prefix_(std::move(key_prefix)),
         manager_(page_manager),
         storage_(storage),
-        interface_(std::move(watcher)) {
+        interface_(std::move(watcher)),
+        watcher_count_(metrics->GetGauge("watchers")),
+        busy_watcher_count_(metrics->GetGauge("busy_watchers")),
+        notifications_(metrics->GetCounter("watcher_notifications")),
+        notification_latency_(
+            metrics->GetHistogram("watcher_notification_latency")),
+        pending_changes_memory_(metrics, "memory_watcher_changes_bytes") {
+    watcher_count_->Add(1);
     interface_.set_connection_error_handler([this] {
       if (handler_) {
         handler_->Continue(true);
@@ -40,6 +53,8 @@ class BranchTracker::PageWatcherContainer {
   }
 
   ~PageWatcherContainer() {
+    watcher_count_->Add(-1);
+    SetChangeInFlight(false);
     if (on_drained_) {
       on_drained_();
     }
@@ -80,6 +95,14 @@ class BranchTracker::PageWatcherContainer {
   }
 
  private:
+  void SetChangeInFlight(bool change_in_flight) {
+    if (change_in_flight == change_in_flight_) {
+      return;
+    }
+    change_in_flight_ = change_in_flight;
+    busy_watcher_count_->Add(change_in_flight ? 1 : -1);
+  }
+
   // Returns true if all changes have been sent to the watcher client, false
   // otherwise.
   bool Drained() {
@@ -87,8 +110,12 @@ class BranchTracker::PageWatcherContainer {
            last_commit_->GetId() == current_commit_->GetId();
   }
 
-  std::vector<PageChangePtr> PaginateChanges(PageChangePtr change) {
+  // Splits |change| in changes that fit in a single FIDL message. Returns the
+  // total serialization size of the changes in |total_size|.
+  std::vector<PageChangePtr> PaginateChanges(PageChangePtr change,
+                                             size_t* total_size) {
     std::vector<PageChangePtr> changes;
+    *total_size = 0;
 
     size_t fidl_size;
     size_t timestamp = change->timestamp;
@@ -111,8 +138,10 @@ class BranchTracker::PageWatcherContainer {
         changes.back()->deleted_keys =
             fidl::Array<fidl::Array<uint8_t>>::New(0);
         fidl_size = fidl_serialization::kPageChangeHeaderSize;
+        *total_size += fidl_size;
       }
       fidl_size += entry_size;
+      *total_size += entry_size;
       if (add_entry) {
         changes.back()->changes.push_back(std::move(entries[i]));
         ++i;
@@ -128,27 +157,35 @@ class BranchTracker::PageWatcherContainer {
                   ResultState state,
                   std::unique_ptr<const storage::Commit> new_commit,
                   ftl::Closure on_done) {
-    interface_->OnChange(
-        std::move(page_change), state, ftl::MakeCopyable([
-          this, state, new_commit = std::move(new_commit),
-          on_done = std::move(on_done)
-        ](fidl::InterfaceRequest<PageSnapshot> snapshot_request) mutable {
-          if (snapshot_request) {
-            manager_->BindPageSnapshot(
-                new_commit->Clone(), std::move(snapshot_request), key_prefix_);
-          }
-          if (state != ResultState::COMPLETED &&
-              state != ResultState::PARTIAL_COMPLETED) {
-            on_done();
-            return;
-          }
-          change_in_flight_ = false;
-          last_commit_.swap(new_commit);
-          // SendCommit will start handling the following commit, so we need to
-          // make sure on_done() is called before that.
-          on_done();
-          SendCommit();
-        }));
+    TRACE_DURATION("ledger", "page_watcher_send_change", "commit_id",
+                   callback::TraceIdArg(new_commit->GetId()));
+    TRACE_FLOW_STEP("ledger", "commit",
+                    callback::TraceFlowId(new_commit->GetId()));
+    notifications_->Increment();
+    auto on_change_done = ftl::MakeCopyable([
+      this, state, new_commit = std::move(new_commit),
+      on_done = std::move(on_done), start = ftl::TimePoint::Now()
+    ](fidl::InterfaceRequest<PageSnapshot> snapshot_request) mutable {
+      notification_latency_->Record(ftl::TimePoint::Now() - start);
+      if (snapshot_request) {
+        manager_->BindPageSnapshot(
+            new_commit->Clone(), std::move(snapshot_request), key_prefix_);
+      }
+      if (state != ResultState::COMPLETED &&
+          state != ResultState::PARTIAL_COMPLETED) {
+        on_done();
+        return;
+      }
+      SetChangeInFlight(false);
+      last_commit_.swap(new_commit);
+      // SendCommit will start handling the following commit, so we need to
+      // make sure on_done() is called before that.
+      on_done();
+      SendCommit();
+    });
+    interface_->OnChange(std::move(page_change), state,
+                         TRACE_CALLBACK(std::move(on_change_done), "ledger",
+                                        "page_watcher_on_change"));
   }
 
   // Sends a commit to the watcher if needed.
@@ -165,7 +202,7 @@ class BranchTracker::PageWatcherContainer {
       return;
     }
 
-    change_in_flight_ = true;
+    SetChangeInFlight(true);
 
     // TODO(etiennej): See LE-74: clean object ownership
     diff_utils::ComputePageChange(
@@ -179,18 +216,19 @@ class BranchTracker::PageWatcherContainer {
             // we will try again (but not before). The next notification
             // will cover both this change and the next.
             FTL_LOG(ERROR) << "Unable to compute PageChange for Watch update.";
-            change_in_flight_ = false;
+            SetChangeInFlight(false);
             return;
           }
 
           if (!page_change_ptr.first) {
-            change_in_flight_ = false;
+            SetChangeInFlight(false);
             last_commit_.swap(new_commit);
             SendCommit();
             return;
           }
-          std::vector<PageChangePtr> paginated_changes =
-              PaginateChanges(std::move(page_change_ptr.first));
+          size_t paginated_size;
+          std::vector<PageChangePtr> paginated_changes = PaginateChanges(
+              std::move(page_change_ptr.first), &paginated_size);
           if (paginated_changes.size() == 1) {
             SendChange(std::move(paginated_changes[0]), ResultState::COMPLETED,
                        std::move(new_commit), [] {});
@@ -198,7 +236,9 @@ class BranchTracker::PageWatcherContainer {
           }
           coroutine_service_->StartCoroutine(ftl::MakeCopyable([
             this, new_commit = std::move(new_commit),
-            paginated_changes = std::move(paginated_changes)
+            paginated_changes = std::move(paginated_changes),
+            charge = metrics::ScopedMemoryCharge(pending_changes_memory_,
+                                                 paginated_size)
           ](coroutine::CoroutineHandler * handler) mutable {
             auto guard = ftl::MakeAutoCall([this] { handler_ = nullptr; });
             FTL_DCHECK(!handler_);
@@ -239,14 +279,23 @@ class BranchTracker::PageWatcherContainer {
   PageManager* manager_;
   storage::PageStorage* storage_;
   PageWatcherPtr interface_;
+  metrics::Gauge* const watcher_count_;
+  // Number of watchers of the page with a change being sent.
+  metrics::Gauge* const busy_watcher_count_;
+  metrics::Counter* const notifications_;
+  metrics::Histogram* const notification_latency_;
+  // Paginated changes waiting to be sent to the watcher.
+  const metrics::MemoryAccount pending_changes_memory_;
 };
 
 BranchTracker::BranchTracker(coroutine::CoroutineService* coroutine_service,
                              PageManager* manager,
-                             storage::PageStorage* storage)
+                             storage::PageStorage* storage,
+                             metrics::MetricsRegistry* metrics)
     : coroutine_service_(coroutine_service),
       manager_(manager),
       storage_(storage),
+      metrics_(metrics::OrUnreported(metrics)),
       transaction_in_progress_(false) {
   watchers_.set_on_empty([this] { CheckEmpty(); });
   std::vector<storage::CommitId> commit_ids;
@@ -275,6 +324,8 @@ const storage::CommitId& BranchTracker::GetBranchHeadId() {
 void BranchTracker::OnNewCommits(
     const std::vector<std::unique_ptr<const storage::Commit>>& commits,
     storage::ChangeSource source) {
+  TRACE_DURATION("ledger", "branch_tracker_on_new_commits", "count",
+                 commits.size());
   bool changed = false;
   const std::unique_ptr<const storage::Commit>* new_current_commit = nullptr;
   for (const auto& commit : commits) {
@@ -289,6 +340,8 @@ void BranchTracker::OnNewCommits(
         parent_ids.end()) {
       continue;
     }
+    TRACE_FLOW_STEP("ledger", "commit",
+                    callback::TraceFlowId(commit->GetId()));
     changed = true;
     current_commit_id_ = commit->GetId();
     new_current_commit = &commit;
@@ -347,7 +400,8 @@ void BranchTracker::RegisterPageWatcher(
     std::unique_ptr<const storage::Commit> base_commit,
     std::string key_prefix) {
   watchers_.emplace(coroutine_service_, std::move(page_watcher_ptr), manager_,
-                    storage_, std::move(base_commit), std::move(key_prefix));
+                    storage_, std::move(base_commit), std::move(key_prefix),
+                    metrics_);
 }
 
 bool BranchTracker::IsEmpty() {
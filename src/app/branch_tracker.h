@@ -11,6 +11,7 @@
 #include "apps/ledger/src/app/page_snapshot_impl.h"
 #include "apps/ledger/src/callback/auto_cleanable.h"
 #include "apps/ledger/src/coroutine/coroutine.h"
+#include "apps/ledger/src/metrics/metrics_registry.h"
 #include "apps/ledger/src/storage/public/commit_watcher.h"
 #include "apps/ledger/src/storage/public/page_storage.h"
 #include "apps/ledger/src/storage/public/types.h"
@@ -24,9 +25,12 @@ class PageManager;
 // have the same parent, the first one to be received will be followed.
 class BranchTracker : public storage::CommitWatcher {
  public:
+  // The number of watchers and the latency of their notifications are recorded
+  // in |metrics|, if not null.
   BranchTracker(coroutine::CoroutineService* coroutine_service,
                 PageManager* manager,
-                storage::PageStorage* storage);
+                storage::PageStorage* storage,
+                metrics::MetricsRegistry* metrics = nullptr);
   ~BranchTracker();
 
   void set_on_empty(ftl::Closure on_empty_callback);
@@ -69,6 +73,7 @@ class BranchTracker : public storage::CommitWatcher {
   coroutine::CoroutineService* coroutine_service_;
   PageManager* manager_;
   storage::PageStorage* storage_;
+  metrics::MetricsRegistry* const metrics_;
   callback::AutoCleanableSet<PageWatcherContainer> watchers_;
   ftl::Closure on_empty_callback_;
 
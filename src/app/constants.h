@@ -28,6 +28,14 @@ constexpr ftl::StringView kLastUserRepositoryPath =
 // the repository dir of that user.
 constexpr ftl::StringView kServerIdFilename = "server_id";
 
+// Filenames, within the repository dir of a user, through which `ledger_tool`
+// requests the metrics of the running Ledger, and the Ledger answers with them.
+constexpr ftl::StringView kMetricsRequestFilename = "metrics_request";
+constexpr ftl::StringView kMetricsFilename = "metrics";
+// Content of a metrics request asking for the metrics to be reset once they
+// are exported.
+constexpr ftl::StringView kMetricsResetRequest = "reset";
+
 }  // namespace ledger
 
 #endif  // APPS_LEDGER_SRC_APP_CONSTANTS_H_
@@ -0,0 +1,65 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/app/ledger_debug_impl.h"
+
+#include <string>
+#include <vector>
+
+#include "lib/ftl/logging.h"
+
+namespace ledger {
+
+namespace {
+
+MetricType ToMetricType(metrics::MetricValue::Type type) {
+  switch (type) {
+    case metrics::MetricValue::Type::COUNTER:
+      return MetricType::COUNTER;
+    case metrics::MetricValue::Type::GAUGE:
+      return MetricType::GAUGE;
+    case metrics::MetricValue::Type::HISTOGRAM:
+      return MetricType::HISTOGRAM;
+  }
+  FTL_NOTREACHED();
+  return MetricType::COUNTER;
+}
+
+}  // namespace
+
+LedgerDebugImpl::LedgerDebugImpl(metrics::MetricsRegistry* metrics)
+    : metrics_(metrics) {
+  FTL_DCHECK(metrics_);
+}
+
+LedgerDebugImpl::~LedgerDebugImpl() {}
+
+void LedgerDebugImpl::GetMetrics(const fidl::String& path_prefix,
+                                 const GetMetricsCallback& callback) {
+  std::vector<metrics::MetricValue> values;
+  metrics_->Snapshot(path_prefix.is_null() ? "" : path_prefix.get(), &values);
+
+  auto result = fidl::Array<MetricPtr>::New(0);
+  for (auto& value : values) {
+    MetricPtr metric = Metric::New();
+    metric->path = std::move(value.path);
+    metric->name = std::move(value.name);
+    metric->type = ToMetricType(value.type);
+    metric->value = value.value;
+    metric->count = value.count;
+    metric->sum = value.sum;
+    if (value.type == metrics::MetricValue::Type::HISTOGRAM) {
+      metric->buckets = fidl::Array<int64_t>::From(value.buckets);
+    }
+    result.push_back(std::move(metric));
+  }
+  callback(std::move(result));
+}
+
+void LedgerDebugImpl::ResetMetrics(const ResetMetricsCallback& callback) {
+  metrics_->Reset();
+  callback();
+}
+
+}  // namespace ledger
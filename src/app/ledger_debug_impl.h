@@ -0,0 +1,33 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_APP_LEDGER_DEBUG_IMPL_H_
+#define APPS_LEDGER_SRC_APP_LEDGER_DEBUG_IMPL_H_
+
+#include "apps/ledger/services/internal/internal.fidl.h"
+#include "apps/ledger/src/metrics/metrics_registry.h"
+#include "lib/ftl/macros.h"
+
+namespace ledger {
+
+// Exposes the content of a metrics registry through the LedgerDebug interface.
+class LedgerDebugImpl : public LedgerDebug {
+ public:
+  explicit LedgerDebugImpl(metrics::MetricsRegistry* metrics);
+  ~LedgerDebugImpl() override;
+
+ private:
+  // LedgerDebug:
+  void GetMetrics(const fidl::String& path_prefix,
+                  const GetMetricsCallback& callback) override;
+  void ResetMetrics(const ResetMetricsCallback& callback) override;
+
+  metrics::MetricsRegistry* const metrics_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(LedgerDebugImpl);
+};
+
+}  // namespace ledger
+
+#endif  // APPS_LEDGER_SRC_APP_LEDGER_DEBUG_IMPL_H_
@@ -22,11 +22,20 @@ namespace ledger {
 // callbacks and fires them when the PageManager is available.
 class LedgerManager::PageManagerContainer {
  public:
-  PageManagerContainer() : status_(Status::OK) {}
+  // The metrics of the page are recorded in the child of |ledger_metrics| named
+  // |page_node_name|, which is deleted along with the container.
+  PageManagerContainer(metrics::MetricsRegistry* ledger_metrics,
+                       std::string page_node_name)
+      : ledger_metrics_(ledger_metrics),
+        page_node_name_(std::move(page_node_name)),
+        status_(Status::OK) {}
   ~PageManagerContainer() {
     for (const auto& request : requests_) {
       request.second(Status::INTERNAL_ERROR);
     }
+    // The components of the page keep pointers to its metrics.
+    page_manager_.reset();
+    ledger_metrics_->RemoveChild(page_node_name_);
   }
 
   void set_on_empty(const ftl::Closure& on_empty_callback) {
@@ -77,6 +86,8 @@ class LedgerManager::PageManagerContainer {
   }
 
  private:
+  metrics::MetricsRegistry* const ledger_metrics_;
+  const std::string page_node_name_;
   std::unique_ptr<PageManager> page_manager_;
   Status status_;
   std::vector<
@@ -89,10 +100,12 @@ class LedgerManager::PageManagerContainer {
 
 LedgerManager::LedgerManager(Environment* environment,
                              std::unique_ptr<storage::LedgerStorage> storage,
-                             std::unique_ptr<cloud_sync::LedgerSync> sync)
+                             std::unique_ptr<cloud_sync::LedgerSync> sync,
+                             metrics::MetricsRegistry* metrics)
     : environment_(environment),
       storage_(std::move(storage)),
       sync_(std::move(sync)),
+      metrics_(metrics::OrUnreported(metrics)),
       ledger_impl_(this),
       merge_manager_(environment_) {}
 
@@ -169,9 +182,9 @@ void LedgerManager::CreatePageStorage(storage::PageId page_id,
 
 LedgerManager::PageManagerContainer* LedgerManager::AddPageManagerContainer(
     storage::PageIdView page_id) {
-  auto ret = page_managers_.emplace(std::piecewise_construct,
-                                    std::forward_as_tuple(page_id.ToString()),
-                                    std::forward_as_tuple());
+  auto ret = page_managers_.emplace(
+      std::piecewise_construct, std::forward_as_tuple(page_id.ToString()),
+      std::forward_as_tuple(metrics_, metrics::PageNodeName(page_id)));
   FTL_DCHECK(ret.second);
   return &ret.first->second;
 }
@@ -185,9 +198,14 @@ std::unique_ptr<PageManager> LedgerManager::NewPageManager(
       FTL_LOG(ERROR) << "Page Sync stopped due to unrecoverable error.";
     });
   }
+  metrics::MetricsRegistry* page_metrics =
+      metrics_->GetChild(metrics::PageNodeName(page_storage->GetId()));
+  std::unique_ptr<MergeResolver> merge_resolver =
+      merge_manager_.GetMergeResolver(page_storage.get(), page_metrics);
   return std::make_unique<PageManager>(
       environment_, std::move(page_storage), std::move(page_sync_context),
-      merge_manager_.GetMergeResolver(page_storage.get()));
+      std::move(merge_resolver), PageManager::kDefaultSyncTimeout,
+      page_metrics);
 }
 
 void LedgerManager::CheckEmpty() {
@@ -15,6 +15,7 @@
 #include "apps/ledger/src/callback/auto_cleanable.h"
 #include "apps/ledger/src/convert/convert.h"
 #include "apps/ledger/src/environment/environment.h"
+#include "apps/ledger/src/metrics/metrics_registry.h"
 #include "apps/ledger/src/storage/public/types.h"
 #include "lib/fidl/cpp/bindings/binding_set.h"
 #include "lib/ftl/macros.h"
@@ -28,11 +29,15 @@ namespace ledger {
 // LedgerManager owns all per-ledger-instance objects: LedgerStorage and a Mojo
 // LedgerImpl. It is safe to delete it at any point - this closes all channels,
 // deletes the LedgerImpl and tears down the storage.
+//
+// The metrics of each page are recorded in a child of |metrics| named after
+// the page, if |metrics| is not null.
 class LedgerManager : public LedgerImpl::Delegate {
  public:
   LedgerManager(Environment* environment,
                 std::unique_ptr<storage::LedgerStorage> storage,
-                std::unique_ptr<cloud_sync::LedgerSync> sync);
+                std::unique_ptr<cloud_sync::LedgerSync> sync,
+                metrics::MetricsRegistry* metrics = nullptr);
   ~LedgerManager();
 
   // Creates a new proxy for the LedgerImpl managed by this LedgerManager.
@@ -71,6 +76,7 @@ class LedgerManager : public LedgerImpl::Delegate {
   Environment* const environment_;
   std::unique_ptr<storage::LedgerStorage> storage_;
   std::unique_ptr<cloud_sync::LedgerSync> sync_;
+  metrics::MetricsRegistry* const metrics_;
   LedgerImpl ledger_impl_;
   // merge_manager_ must be destructed after page_managers_ to ensure it
   // outlives any page-specific merge resolver.
@@ -127,12 +127,13 @@ class LedgerManagerTest : public test::TestWithMessageLoop {
         std::make_unique<FakeLedgerSync>(message_loop_.task_runner());
     sync_ptr = sync.get();
     ledger_manager_ = std::make_unique<LedgerManager>(
-        &environment_, std::move(storage), std::move(sync));
+        &environment_, std::move(storage), std::move(sync), &ledger_metrics_);
     ledger_manager_->BindLedger(ledger.NewRequest());
   }
 
  protected:
   ledger::Environment environment_;
+  metrics::MetricsRegistry ledger_metrics_;
   FakeLedgerStorage* storage_ptr;
   FakeLedgerSync* sync_ptr;
   std::unique_ptr<LedgerManager> ledger_manager_;
@@ -229,6 +230,26 @@ TEST_F(LedgerManagerTest, CallGetPageTwice) {
   EXPECT_EQ(0u, storage_ptr->delete_page_calls.size());
 }
 
+// Verifies that the metrics of a page are deleted when the page is closed.
+TEST_F(LedgerManagerTest, ClosingPageDeletesItsMetrics) {
+  storage::PageId id = RandomId();
+  std::string page_node_name = metrics::PageNodeName(id);
+  PagePtr page;
+  ledger->GetPage(convert::ToArray(id), page.NewRequest(),
+                  [this](Status) { message_loop_.PostQuitTask(); });
+  EXPECT_FALSE(RunLoopWithTimeout());
+
+  std::vector<metrics::MetricValue> values;
+  ledger_metrics_.Snapshot(page_node_name, &values);
+  EXPECT_FALSE(values.empty());
+
+  page.reset();
+  EXPECT_TRUE(RunLoopWithTimeout(ftl::TimeDelta::FromMilliseconds(20)));
+  values.clear();
+  ledger_metrics_.Snapshot(page_node_name, &values);
+  EXPECT_TRUE(values.empty());
+}
+
 // Cloud should never be queried.
 TEST_F(LedgerManagerTest, GetPageDoNotCallTheCloud) {
   storage_ptr->should_get_page_fail = true;
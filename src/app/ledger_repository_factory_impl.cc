@@ -25,8 +25,10 @@ ftl::StringView GetStorageDirectoryName(ftl::StringView repository_path) {
   return repository_path.substr(separator + 1);
 }
 
-cloud_sync::UserConfig GetUserConfig(const fidl::String& server_id,
-                                     ftl::StringView user_id) {
+cloud_sync::UserConfig GetUserConfig(
+    const fidl::String& server_id,
+    ftl::StringView user_id,
+    const cloud_sync::PrefetchPolicy& prefetch_policy) {
   if (!server_id || server_id.size() == 0) {
     cloud_sync::UserConfig user_config;
     user_config.use_sync = false;
@@ -37,6 +39,7 @@ cloud_sync::UserConfig GetUserConfig(const fidl::String& server_id,
   user_config.use_sync = true;
   user_config.server_id = server_id.get();
   user_config.user_id = user_id.ToString();
+  user_config.prefetch_policy = prefetch_policy;
   return user_config;
 }
 
@@ -103,8 +106,9 @@ bool CheckSyncConfig(const cloud_sync::UserConfig& user_config,
 }  // namespace
 
 LedgerRepositoryFactoryImpl::LedgerRepositoryFactoryImpl(
-    ledger::Environment* environment)
-    : environment_(environment) {}
+    ledger::Environment* environment,
+    cloud_sync::PrefetchPolicy prefetch_policy)
+    : environment_(environment), prefetch_policy_(std::move(prefetch_policy)) {}
 
 LedgerRepositoryFactoryImpl::~LedgerRepositoryFactoryImpl() {}
 
@@ -119,7 +123,8 @@ void LedgerRepositoryFactoryImpl::GetRepository(
   auto it = repositories_.find(sanitized_path);
   if (it == repositories_.end()) {
     ftl::StringView user_id = GetStorageDirectoryName(sanitized_path);
-    cloud_sync::UserConfig user_config = GetUserConfig(server_id, user_id);
+    cloud_sync::UserConfig user_config =
+        GetUserConfig(server_id, user_id, prefetch_policy_);
     if (!user_config.use_sync) {
       FTL_LOG(WARNING) << "No sync configuration set, "
                        << "Ledger will work locally but won't sync";
@@ -136,8 +141,10 @@ void LedgerRepositoryFactoryImpl::GetRepository(
     }
     auto result = repositories_.emplace(
         std::piecewise_construct, std::forward_as_tuple(sanitized_path),
-        std::forward_as_tuple(sanitized_path, environment_,
-                              std::move(user_config)));
+        std::forward_as_tuple(
+            sanitized_path, environment_, std::move(user_config),
+            environment_->metrics()->GetChild(
+                metrics::RepositoryNodeName(sanitized_path))));
     FTL_DCHECK(result.second);
     it = result.first;
   }
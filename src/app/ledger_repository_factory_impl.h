@@ -11,6 +11,7 @@
 #include "apps/ledger/services/internal/internal.fidl.h"
 #include "apps/ledger/src/app/ledger_repository_impl.h"
 #include "apps/ledger/src/callback/auto_cleanable.h"
+#include "apps/ledger/src/cloud_sync/public/prefetch_policy.h"
 #include "apps/ledger/src/environment/environment.h"
 #include "lib/ftl/macros.h"
 
@@ -18,7 +19,12 @@ namespace ledger {
 
 class LedgerRepositoryFactoryImpl : public LedgerRepositoryFactory {
  public:
-  explicit LedgerRepositoryFactoryImpl(ledger::Environment* environment);
+  // The values of the LAZY entries synced from the cloud are prefetched
+  // according to |prefetch_policy|.
+  explicit LedgerRepositoryFactoryImpl(
+      ledger::Environment* environment,
+      cloud_sync::PrefetchPolicy prefetch_policy =
+          cloud_sync::PrefetchPolicy());
   ~LedgerRepositoryFactoryImpl() override;
 
  private:
@@ -30,6 +36,7 @@ class LedgerRepositoryFactoryImpl : public LedgerRepositoryFactory {
       const GetRepositoryCallback& callback) override;
 
   ledger::Environment* const environment_;
+  const cloud_sync::PrefetchPolicy prefetch_policy_;
   callback::AutoCleanableMap<std::string, LedgerRepositoryImpl> repositories_;
 
   FTL_DISALLOW_COPY_AND_ASSIGN(LedgerRepositoryFactoryImpl);
@@ -13,10 +13,15 @@ namespace ledger {
 
 LedgerRepositoryImpl::LedgerRepositoryImpl(const std::string& base_storage_dir,
                                            Environment* environment,
-                                           cloud_sync::UserConfig user_config)
+                                           cloud_sync::UserConfig user_config,
+                                           metrics::MetricsRegistry* metrics)
     : base_storage_dir_(base_storage_dir),
       environment_(environment),
-      user_config_(std::move(user_config)) {
+      user_config_(std::move(user_config)),
+      metrics_(metrics::OrUnreported(metrics)),
+      metrics_exporter_(environment_->main_runner(),
+                        base_storage_dir_,
+                        environment_->metrics()) {
   bindings_.set_on_empty_set_handler([this] { CheckEmpty(); });
   ledger_managers_.set_on_empty([this] { CheckEmpty(); });
 }
@@ -42,21 +47,23 @@ void LedgerRepositoryImpl::GetLedger(
   auto it = ledger_managers_.find(ledger_name);
   if (it == ledger_managers_.end()) {
     std::string name_as_string = convert::ToString(ledger_name);
+    metrics::MetricsRegistry* ledger_metrics =
+        metrics_->GetChild(metrics::LedgerNodeName(name_as_string));
     std::unique_ptr<storage::LedgerStorage> ledger_storage =
         std::make_unique<storage::LedgerStorageImpl>(
-            environment_->main_runner(), environment_->GetIORunner(),
+            environment_->main_runner(), environment_->GetIOPool(),
             environment_->coroutine_service(), base_storage_dir_,
-            name_as_string);
+            name_as_string, ledger_metrics, environment_->GetWorkerPool());
     std::unique_ptr<cloud_sync::LedgerSync> ledger_sync;
     if (user_config_.use_sync) {
       ledger_sync = std::make_unique<cloud_sync::LedgerSyncImpl>(
-          environment_, &user_config_, name_as_string);
+          environment_, &user_config_, name_as_string, ledger_metrics);
     }
     auto result = ledger_managers_.emplace(
         std::piecewise_construct,
         std::forward_as_tuple(std::move(name_as_string)),
         std::forward_as_tuple(environment_, std::move(ledger_storage),
-                              std::move(ledger_sync)));
+                              std::move(ledger_sync), ledger_metrics));
     FTL_DCHECK(result.second);
     it = result.first;
   }
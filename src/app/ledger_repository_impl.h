@@ -8,10 +8,12 @@
 #include "apps/ledger/services/internal/internal.fidl.h"
 #include "apps/ledger/services/public/ledger.fidl.h"
 #include "apps/ledger/src/app/ledger_manager.h"
+#include "apps/ledger/src/app/metrics_exporter.h"
 #include "apps/ledger/src/callback/auto_cleanable.h"
 #include "apps/ledger/src/cloud_sync/public/user_config.h"
 #include "apps/ledger/src/convert/convert.h"
 #include "apps/ledger/src/environment/environment.h"
+#include "apps/ledger/src/metrics/metrics_registry.h"
 #include "lib/fidl/cpp/bindings/binding_set.h"
 #include "lib/ftl/macros.h"
 
@@ -19,9 +21,13 @@ namespace ledger {
 
 class LedgerRepositoryImpl : public LedgerRepository {
  public:
+  // The metrics of each ledger are recorded in a child of |metrics| named after
+  // the ledger, if |metrics| is not null. The metrics of the whole application
+  // are exported to `ledger_tool` through |base_storage_dir|.
   LedgerRepositoryImpl(const std::string& base_storage_dir,
                        Environment* environment,
-                       cloud_sync::UserConfig user_config);
+                       cloud_sync::UserConfig user_config,
+                       metrics::MetricsRegistry* metrics = nullptr);
   ~LedgerRepositoryImpl() override;
 
   void set_on_empty(const ftl::Closure& on_empty_callback) {
@@ -44,12 +50,14 @@ class LedgerRepositoryImpl : public LedgerRepository {
   const std::string base_storage_dir_;
   Environment* const environment_;
   const cloud_sync::UserConfig user_config_;
+  metrics::MetricsRegistry* const metrics_;
   callback::AutoCleanableMap<std::string,
                              LedgerManager,
                              convert::StringViewComparator>
       ledger_managers_;
   fidl::BindingSet<LedgerRepository> bindings_;
   ftl::Closure on_empty_callback_;
+  MetricsExporter metrics_exporter_;
 
   FTL_DISALLOW_COPY_AND_ASSIGN(LedgerRepositoryImpl);
 };
@@ -6,15 +6,28 @@
 
 #include <memory>
 #include <string>
-#include <vector>
 
 #include "apps/ledger/src/app/merging/conflict_resolver_client.h"
 #include "apps/ledger/src/app/page_manager.h"
+#include "apps/ledger/src/callback/trace_callback.h"
+#include "apps/tracing/lib/trace/event.h"
 #include "lib/ftl/functional/closure.h"
-#include "lib/ftl/functional/make_copyable.h"
 #include "lib/ftl/memory/weak_ptr.h"
 
 namespace ledger {
+namespace {
+
+// Returns whether |lhs| and |rhs| are both absent, or are the same entry.
+bool SameEntry(const std::unique_ptr<storage::Entry>& lhs,
+               const std::unique_ptr<storage::Entry>& rhs) {
+  if (!lhs || !rhs) {
+    return !lhs && !rhs;
+  }
+  return *lhs == *rhs;
+}
+
+}  // namespace
+
 class AutoMergeStrategy::AutoMerger {
  public:
   AutoMerger(storage::PageStorage* storage,
@@ -31,12 +44,7 @@ class AutoMergeStrategy::AutoMerger {
   void Done();
 
  private:
-  void OnRightChangeReady(
-      storage::Status status,
-      std::unique_ptr<std::vector<storage::EntryChange>> right_change);
-  void OnComparisonDone(storage::Status status,
-                        std::unique_ptr<std::vector<storage::EntryChange>>,
-                        bool distinct);
+  void OnDiffDone(storage::Status status);
 
   storage::PageStorage* const storage_;
   PageManager* const manager_;
@@ -52,6 +60,8 @@ class AutoMergeStrategy::AutoMerger {
 
   std::unique_ptr<storage::Journal> journal_;
   bool cancelled_ = false;
+  // Whether a key was changed differently by the two commits.
+  bool has_conflict_ = false;
 
   // This must be the last member of the class.
   ftl::WeakPtrFactory<AutoMergeStrategy::AutoMerger> weak_factory_;
@@ -83,104 +93,60 @@ AutoMergeStrategy::AutoMerger::~AutoMerger() {
 }
 
 void AutoMergeStrategy::AutoMerger::Start() {
-  std::unique_ptr<std::vector<storage::EntryChange>> changes(
-      new std::vector<storage::EntryChange>());
-  auto on_next =
-      [ weak_this = weak_factory_.GetWeakPtr(),
-        changes = changes.get() ](storage::EntryChange change) {
-    if (!weak_this) {
-      return false;
-    }
-
-    if (weak_this->cancelled_) {
-      return false;
-    }
-
-    changes->push_back(change);
-    return true;
-  };
-
-  auto on_done = ftl::MakeCopyable([
-    weak_this = weak_factory_.GetWeakPtr(), changes = std::move(changes)
-  ](storage::Status status) mutable {
-    if (weak_this) {
-      weak_this->OnRightChangeReady(std::move(status), std::move(changes));
-    }
-  });
-
-  storage_->GetCommitContentsDiff(*ancestor_, *right_, "", std::move(on_next),
-                                  std::move(on_done));
-}
-
-void AutoMergeStrategy::AutoMerger::OnRightChangeReady(
-    storage::Status status,
-    std::unique_ptr<std::vector<storage::EntryChange>> right_change) {
-  if (cancelled_) {
-    Done();
-    return;
-  }
-
-  if (status != storage::Status::OK) {
-    FTL_LOG(ERROR) << "Unable to compute diff due to error " << status
-                   << ", aborting.";
+  // StartMergeCommit uses the left commit (first parameter) as its base, so
+  // only the changes of the right commit have to be applied to it.
+  storage::Status s =
+      storage_->StartMergeCommit(left_->GetId(), right_->GetId(), &journal_);
+  if (s != storage::Status::OK) {
+    FTL_LOG(ERROR) << "Unable to start merge commit: " << s;
     Done();
     return;
   }
 
-  struct PageChangeIndex {
-    size_t entry_index = 0;
-    bool distinct = true;
-  };
-
-  std::unique_ptr<PageChangeIndex> index(new PageChangeIndex());
-
-  auto on_next = ftl::MakeCopyable([
-    weak_this = weak_factory_.GetWeakPtr(), index = index.get(),
-    right_change = right_change.get()
-  ](storage::EntryChange change) {
-    if (!weak_this) {
+  auto on_next = [weak_this = weak_factory_.GetWeakPtr()](
+      storage::ThreeWayChange change) {
+    if (!weak_this || weak_this->cancelled_) {
       return false;
     }
-
-    if (weak_this->cancelled_) {
-      return false;
-    }
-
-    while (change.entry.key > (*right_change)[index->entry_index].entry.key) {
-      index->entry_index++;
-      if (index->entry_index >= right_change->size()) {
-        return false;
-      }
+    if (SameEntry(change.base, change.right)) {
+      // Only the left commit changed this key.
+      return true;
     }
-    if (change.entry.key == (*right_change)[index->entry_index].entry.key) {
-      if (change == (*right_change)[index->entry_index]) {
+    if (!SameEntry(change.base, change.left)) {
+      if (SameEntry(change.left, change.right)) {
+        // Both commits made the same change.
         return true;
       }
-      index->distinct = false;
+      // Both commits changed this key differently: the merge must be
+      // delegated to the conflict resolver.
+      weak_this->has_conflict_ = true;
       return false;
     }
+    storage::Status s;
+    if (change.right) {
+      s = weak_this->journal_->Put(change.right->key, change.right->object_id,
+                                   change.right->priority);
+    } else {
+      s = weak_this->journal_->Delete(change.base->key);
+    }
+    if (s != storage::Status::OK) {
+      FTL_LOG(ERROR) << "Error while merging commits: " << s;
+    }
     return true;
-  });
+  };
 
-  // |on_done| is called when the full diff is computed.
-  auto on_done = ftl::MakeCopyable([
-    weak_this = weak_factory_.GetWeakPtr(),
-    right_change = std::move(right_change), index = std::move(index)
-  ](storage::Status status) mutable {
+  auto on_done = [weak_this = weak_factory_.GetWeakPtr()](
+      storage::Status status) {
     if (weak_this) {
-      weak_this->OnComparisonDone(status, std::move(right_change),
-                                  index->distinct);
+      weak_this->OnDiffDone(status);
     }
-  });
+  };
 
-  storage_->GetCommitContentsDiff(*ancestor_, *left_, "", std::move(on_next),
-                                  std::move(on_done));
+  storage_->GetThreeWayContentsDiff(*ancestor_, *left_, *right_, "",
+                                    std::move(on_next), std::move(on_done));
 }
 
-void AutoMergeStrategy::AutoMerger::OnComparisonDone(
-    storage::Status status,
-    std::unique_ptr<std::vector<storage::EntryChange>> right_changes,
-    bool distinct) {
+void AutoMergeStrategy::AutoMerger::OnDiffDone(storage::Status status) {
   if (cancelled_) {
     Done();
     return;
@@ -193,10 +159,11 @@ void AutoMergeStrategy::AutoMerger::OnComparisonDone(
     return;
   }
 
-  if (!distinct) {
+  if (has_conflict_) {
     // Some keys are overlapping, so we need to proceed like the CUSTOM
-    // strategy. We could be more efficient if we reused |right_changes| instead
-    // of re-computing the diff inside |ConflictResolverClient|.
+    // strategy.
+    journal_->Rollback();
+    journal_.reset();
     delegated_merge_ = std::make_unique<ConflictResolverClient>(
         storage_, manager_, conflict_resolver_, std::move(left_),
         std::move(right_), std::move(ancestor_),
@@ -210,25 +177,7 @@ void AutoMergeStrategy::AutoMerger::OnComparisonDone(
     return;
   }
 
-  // Here, we reuse the diff we computed before to create the merge commit. As
-  // StartMergeCommit uses the left commit (first parameter) as its base, we
-  // only have to apply the right diff to it and we are done.
-  storage::Status s =
-      storage_->StartMergeCommit(left_->GetId(), right_->GetId(), &journal_);
-  if (s != storage::Status::OK) {
-    FTL_LOG(ERROR) << "Unable to start merge commit: " << s;
-    Done();
-    return;
-  }
-  for (const storage::EntryChange& change : *right_changes) {
-    if (change.deleted) {
-      journal_->Delete(change.entry.key);
-    } else {
-      journal_->Put(change.entry.key, change.entry.object_id,
-                    change.entry.priority);
-    }
-  }
-  journal_->Commit([weak_this = weak_factory_.GetWeakPtr()](
+  auto on_commit = [weak_this = weak_factory_.GetWeakPtr()](
       storage::Status status, std::unique_ptr<const storage::Commit>) {
     if (status != storage::Status::OK) {
       FTL_LOG(ERROR) << "Unable to commit merge journal: " << status;
@@ -237,12 +186,16 @@ void AutoMergeStrategy::AutoMerger::OnComparisonDone(
       weak_this->journal_.reset();
       weak_this->Done();
     }
-  });
+  };
+  journal_->Commit(
+      TRACE_CALLBACK(std::move(on_commit), "ledger", "merge_commit"));
 }
 
 void AutoMergeStrategy::AutoMerger::Cancel() {
   cancelled_ = true;
-  delegated_merge_->Cancel();
+  if (delegated_merge_) {
+    delegated_merge_->Cancel();
+  }
 }
 
 void AutoMergeStrategy::AutoMerger::Done() {
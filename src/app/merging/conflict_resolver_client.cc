@@ -13,7 +13,9 @@
 #include "apps/ledger/src/app/fidl/serialization_size.h"
 #include "apps/ledger/src/app/page_manager.h"
 #include "apps/ledger/src/app/page_utils.h"
+#include "apps/ledger/src/callback/trace_callback.h"
 #include "apps/ledger/src/callback/waiter.h"
+#include "apps/tracing/lib/trace/event.h"
 #include "lib/ftl/functional/closure.h"
 #include "lib/ftl/functional/make_copyable.h"
 #include "lib/ftl/memory/weak_ptr.h"
@@ -256,7 +258,7 @@ void ConflictResolverClient::Done(const DoneCallback& callback) {
   FTL_DCHECK(!cancelled_);
   FTL_DCHECK(journal_);
 
-  journal_->Commit([
+  auto on_commit = [
     weak_this = weak_factory_.GetWeakPtr(), callback = std::move(callback)
   ](storage::Status status, std::unique_ptr<const storage::Commit>) {
     if (status != storage::Status::OK) {
@@ -267,7 +269,9 @@ void ConflictResolverClient::Done(const DoneCallback& callback) {
       weak_this->journal_.reset();
       weak_this->Finalize();
     }
-  });
+  };
+  journal_->Commit(
+      TRACE_CALLBACK(std::move(on_commit), "ledger", "merge_commit"));
 }
 
 }  // namespace ledger
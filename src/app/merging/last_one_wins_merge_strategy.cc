@@ -8,6 +8,8 @@
 #include <string>
 
 #include "apps/ledger/src/app/page_manager.h"
+#include "apps/ledger/src/callback/trace_callback.h"
+#include "apps/tracing/lib/trace/event.h"
 #include "lib/ftl/functional/closure.h"
 #include "lib/ftl/memory/weak_ptr.h"
 
@@ -103,16 +105,18 @@ void LastOneWinsMergeStrategy::LastOneWinsMerger::Start() {
       weak_this->Done();
       return;
     }
+    auto on_commit = [weak_this](storage::Status s,
+                                 std::unique_ptr<const storage::Commit>) {
+      if (s != storage::Status::OK) {
+        FTL_LOG(ERROR) << "Unable to commit merge journal: " << s;
+      }
+      if (!weak_this) {
+        return;
+      }
+      weak_this->Done();
+    };
     weak_this->journal_->Commit(
-        [weak_this](storage::Status s, std::unique_ptr<const storage::Commit>) {
-          if (s != storage::Status::OK) {
-            FTL_LOG(ERROR) << "Unable to commit merge journal: " << s;
-          }
-          if (!weak_this) {
-            return;
-          }
-          weak_this->Done();
-        });
+        TRACE_CALLBACK(std::move(on_commit), "ledger", "merge_commit"));
   };
   storage_->GetCommitContentsDiff(*ancestor_, *right_, "", std::move(on_next),
                                   std::move(on_diff_done));
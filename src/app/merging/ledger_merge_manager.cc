@@ -39,10 +39,12 @@ void LedgerMergeManager::RemoveResolver(const storage::PageId& page_id) {
 }
 
 std::unique_ptr<MergeResolver> LedgerMergeManager::GetMergeResolver(
-    storage::PageStorage* storage) {
+    storage::PageStorage* storage,
+    metrics::MetricsRegistry* metrics) {
   storage::PageId page_id = storage->GetId();
   std::unique_ptr<MergeResolver> resolver = std::make_unique<MergeResolver>(
-      [this, page_id]() { RemoveResolver(page_id); }, environment_, storage);
+      [this, page_id]() { RemoveResolver(page_id); }, environment_, storage,
+      metrics);
   resolvers_[page_id] = resolver.get();
   GetResolverStrategyForPage(
       page_id,
@@ -26,8 +26,11 @@ class LedgerMergeManager {
 
   void SetFactory(fidl::InterfaceHandle<ConflictResolverFactory> factory);
 
+  // Returns a MergeResolver for the page of |storage|, recording its metrics
+  // in |metrics| if not null.
   std::unique_ptr<MergeResolver> GetMergeResolver(
-      storage::PageStorage* storage);
+      storage::PageStorage* storage,
+      metrics::MetricsRegistry* metrics = nullptr);
 
  private:
   void RemoveResolver(const storage::PageId& page_id);
@@ -19,18 +19,41 @@
 #include "lib/ftl/functional/auto_call.h"
 #include "lib/ftl/functional/make_copyable.h"
 #include "lib/ftl/memory/weak_ptr.h"
+#include "lib/ftl/time/time_point.h"
 #include "lib/mtl/tasks/message_loop.h"
 
 namespace ledger {
 
+namespace {
+
+// Ratio between the maximum delay before the first merge and the maximum delay
+// between chained merges.
+constexpr uint64_t kChainedMergeDelayDivisor = 8;
+
+}  // namespace
+
 MergeResolver::MergeResolver(ftl::Closure on_destroyed,
                              Environment* environment,
-                             storage::PageStorage* storage)
+                             storage::PageStorage* storage,
+                             metrics::MetricsRegistry* metrics)
     : storage_(storage),
       environment_(environment),
       wait_distribution_(0, environment_->max_merging_delay().ToMilliseconds()),
+      chained_wait_distribution_(
+          0,
+          environment_->max_merging_delay().ToMilliseconds() /
+              kChainedMergeDelayDivisor),
       rng_(glue::RandUint64()),
       on_destroyed_(on_destroyed),
+      merges_(metrics::OrUnreported(metrics)->GetCounter("merges")),
+      identical_commit_merges_(metrics::OrUnreported(metrics)->GetCounter(
+          "identical_commit_merges")),
+      chained_merges_(
+          metrics::OrUnreported(metrics)->GetCounter("chained_merges")),
+      merge_failures_(
+          metrics::OrUnreported(metrics)->GetCounter("merge_failures")),
+      merge_latency_(
+          metrics::OrUnreported(metrics)->GetHistogram("merge_latency")),
       weak_ptr_factory_(this) {
   storage_->AddCommitWatcher(this);
   PostCheckConflicts();
@@ -73,15 +96,18 @@ void MergeResolver::OnNewCommits(
   PostCheckConflicts();
 }
 
-void MergeResolver::PostCheckConflicts() {
+void MergeResolver::PostCheckConflicts(bool chained) {
+  uint64_t delay_ms =
+      chained ? chained_wait_distribution_(rng_) : wait_distribution_(rng_);
   mtl::MessageLoop::GetCurrent()->task_runner()->PostDelayedTask(
       [weak_this_ptr = weak_ptr_factory_.GetWeakPtr()]() {
         if (weak_this_ptr) {
           weak_this_ptr->CheckConflicts();
         }
       },
-      ftl::TimeDelta::FromMilliseconds(wait_distribution_(rng_)));
+      ftl::TimeDelta::FromMilliseconds(delay_ms));
 }
+
 void MergeResolver::CheckConflicts() {
   if (!strategy_ || merge_in_progress_) {
     // No strategy, or a merge already in progress. Let's bail out early.
@@ -103,15 +129,34 @@ void MergeResolver::ResolveConflicts(std::vector<storage::CommitId> heads) {
   FTL_DCHECK(std::is_sorted(heads.begin(), heads.end()));
 
   merge_in_progress_ = true;
-  auto cleanup = ftl::MakeAutoCall([this] {
+  merges_->Increment();
+  auto cleanup = ftl::MakeAutoCall([
+    this, start = ftl::TimePoint::Now(), head_count = heads.size()
+  ] {
+    merge_latency_->Record(ftl::TimePoint::Now() - start);
     // |merge_in_progress_| must be reset before calling |on_empty_callback_|.
     merge_in_progress_ = false;
 
+    bool strategy_changed = false;
     if (next_strategy_) {
       strategy_ = std::move(next_strategy_);
       next_strategy_.reset();
+      strategy_changed = true;
+    }
+    // If the merge succeeded and heads remain, merge them after a shorter
+    // delay: the devices were already spread apart before the first merge,
+    // but the jitter keeps devices that saw the same heads from producing
+    // each merge of the chain in lockstep. Failed or cancelled merges leave
+    // the number of heads unchanged, and are retried after the full delay.
+    std::vector<storage::CommitId> remaining_heads;
+    if (!strategy_changed &&
+        storage_->GetHeadCommitIds(&remaining_heads) == storage::Status::OK &&
+        remaining_heads.size() > 1 && remaining_heads.size() < head_count) {
+      chained_merges_->Increment();
+      PostCheckConflicts(true);
+    } else {
+      PostCheckConflicts();
     }
-    PostCheckConflicts();
     // Call on_empty_callback_ at the very end as this might delete this.
     if (on_empty_callback_) {
       on_empty_callback_();
@@ -131,12 +176,14 @@ void MergeResolver::ResolveConflicts(std::vector<storage::CommitId> heads) {
     if (commits[0]->GetRootId() == commits[1]->GetRootId()) {
       // In that case, the result must be a commit with the same content, and
       // the smallest timestamp.
+      identical_commit_merges_->Increment();
       storage_->MergeIdenticalCommits(
-          std::move(commits[0]), std::move(commits[1]),
-          ftl::MakeCopyable([cleanup =
-                                 std::move(cleanup)](storage::Status status) {
+          std::move(commits[0]), std::move(commits[1]), ftl::MakeCopyable([
+            this, cleanup = std::move(cleanup)
+          ](storage::Status status) {
             if (status != storage::Status::OK) {
               FTL_LOG(ERROR) << "Unable to merge identical commits.";
+              merge_failures_->Increment();
             }
           }));
       return;
@@ -149,18 +196,38 @@ void MergeResolver::ResolveConflicts(std::vector<storage::CommitId> heads) {
 
     if (status != storage::Status::OK) {
       FTL_LOG(ERROR) << "Failed to retrieve head commits.";
+      merge_failures_->Increment();
       return;
     }
     FTL_DCHECK(commits.size() >= 2);
-    std::sort(commits.begin(), commits.end(),
-              [](const std::unique_ptr<const storage::Commit>& lhs,
-                 const std::unique_ptr<const storage::Commit>& rhs) {
-                return lhs->GetTimestamp() < rhs->GetTimestamp();
-              });
+    // Merge the two heads of lowest generation first. Each merge commit is one
+    // generation above its parents, so the heads are merged as a balanced
+    // tree, and the history grows by log2(K) generations rather than K - 1.
+    // Ties are broken by timestamp, then by id, so that all devices merge the
+    // same heads in the same order and produce the same merge commit.
+    auto is_older = [](const std::unique_ptr<const storage::Commit>& lhs,
+                       const std::unique_ptr<const storage::Commit>& rhs) {
+      if (lhs->GetTimestamp() != rhs->GetTimestamp()) {
+        return lhs->GetTimestamp() < rhs->GetTimestamp();
+      }
+      return lhs->GetId() < rhs->GetId();
+    };
+    std::partial_sort(
+        commits.begin(), commits.begin() + 2, commits.end(),
+        [&is_older](const std::unique_ptr<const storage::Commit>& lhs,
+                    const std::unique_ptr<const storage::Commit>& rhs) {
+          if (lhs->GetGeneration() != rhs->GetGeneration()) {
+            return lhs->GetGeneration() < rhs->GetGeneration();
+          }
+          return is_older(lhs, rhs);
+        });
 
-    // Merge the first two commits using the most recent one as the base.
+    // Merge the two commits using the most recent one as the base.
     auto head1 = std::move(commits[0]);
     auto head2 = std::move(commits[1]);
+    if (is_older(head2, head1)) {
+      std::swap(head1, head2);
+    }
     FindCommonAncestor(
         environment_->main_runner(), storage_, head1->Clone(), head2->Clone(),
         ftl::MakeCopyable([
@@ -175,6 +242,7 @@ void MergeResolver::ResolveConflicts(std::vector<storage::CommitId> heads) {
 
           if (status != Status::OK) {
             FTL_LOG(ERROR) << "Failed to find common ancestor of head commits.";
+            merge_failures_->Increment();
             return;
           }
           strategy_->Merge(storage_, page_manager_, std::move(head1),
@@ -10,6 +10,7 @@
 
 #include "apps/ledger/services/public/ledger.fidl.h"
 #include "apps/ledger/src/environment/environment.h"
+#include "apps/ledger/src/metrics/metrics_registry.h"
 #include "apps/ledger/src/storage/public/page_storage.h"
 #include "lib/ftl/functional/closure.h"
 #include "lib/ftl/macros.h"
@@ -20,12 +21,23 @@ class PageManager;
 class MergeStrategy;
 
 // MergeResolver watches a page and resolves conflicts as they appear using the
-// provided merge strategy.
+// provided merge strategy. The number of merges and their latency are recorded
+// in |metrics|, if not null.
+//
+// Conflicts are checked after a random delay, so that the devices seeing the
+// same heads do not all merge them at the same time. Heads are merged two at a
+// time: when more than two heads diverge, as after a sync of several devices,
+// the remaining heads are merged after each successful merge, following a
+// shorter random delay. This delay still lets the merges of other devices
+// arrive, so that the devices racing on a chain of merges drift apart instead
+// of duplicating each of its merges. The two heads of lowest generation are
+// merged first, so that the merge commits form a balanced tree.
 class MergeResolver : public storage::CommitWatcher {
  public:
   MergeResolver(ftl::Closure on_destroyed,
                 Environment* environment,
-                storage::PageStorage* storage);
+                storage::PageStorage* storage,
+                metrics::MetricsRegistry* metrics = nullptr);
   ~MergeResolver();
 
   void set_on_empty(ftl::Closure on_empty_callback);
@@ -44,13 +56,16 @@ class MergeResolver : public storage::CommitWatcher {
       const std::vector<std::unique_ptr<const storage::Commit>>& commits,
       storage::ChangeSource source) override;
 
-  void PostCheckConflicts();
+  // Checks the conflicts after a random delay, which is shorter if |chained|
+  // is true, i.e. if the check follows a successful merge.
+  void PostCheckConflicts(bool chained = false);
   void CheckConflicts();
   void ResolveConflicts(std::vector<storage::CommitId> heads);
 
   storage::PageStorage* const storage_;
   Environment* const environment_;
   std::uniform_int_distribution<uint64_t> wait_distribution_;
+  std::uniform_int_distribution<uint64_t> chained_wait_distribution_;
   std::default_random_engine rng_;
   PageManager* page_manager_ = nullptr;
   std::unique_ptr<MergeStrategy> strategy_;
@@ -59,6 +74,12 @@ class MergeResolver : public storage::CommitWatcher {
   ftl::Closure on_empty_callback_;
   ftl::Closure on_destroyed_;
 
+  metrics::Counter* const merges_;
+  metrics::Counter* const identical_commit_merges_;
+  metrics::Counter* const chained_merges_;
+  metrics::Counter* const merge_failures_;
+  metrics::Histogram* const merge_latency_;
+
   // WeakPtrFactory must be the last field of the class.
   ftl::WeakPtrFactory<MergeResolver> weak_ptr_factory_;
 
@@ -4,10 +4,14 @@
 
 #include "apps/ledger/src/app/merging/merge_resolver.h"
 
+#include <algorithm>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "apps/ledger/src/app/constants.h"
 #include "apps/ledger/src/app/merging/last_one_wins_merge_strategy.h"
+#include "apps/ledger/src/app/merging/merge_strategy.h"
 #include "apps/ledger/src/callback/cancellable_helper.h"
 #include "apps/ledger/src/callback/capture.h"
 #include "apps/ledger/src/coroutine/coroutine_impl.h"
@@ -45,6 +49,40 @@ std::function<void(storage::Journal*)> DeleteKeyFromJournal(
   };
 }
 
+// Merge strategy recording the heads it is given, and merging them with
+// LastOneWinsMergeStrategy.
+class RecordingMergeStrategy : public MergeStrategy {
+ public:
+  explicit RecordingMergeStrategy(
+      std::vector<std::pair<storage::CommitId, storage::CommitId>>* merges)
+      : merges_(merges) {}
+  ~RecordingMergeStrategy() override {}
+
+  void SetOnError(std::function<void()> on_error) override {
+    strategy_.SetOnError(std::move(on_error));
+  }
+
+  void Merge(storage::PageStorage* storage,
+             PageManager* page_manager,
+             std::unique_ptr<const storage::Commit> head_1,
+             std::unique_ptr<const storage::Commit> head_2,
+             std::unique_ptr<const storage::Commit> ancestor,
+             ftl::Closure on_done) override {
+    merges_->emplace_back(head_1->GetId(), head_2->GetId());
+    strategy_.Merge(storage, page_manager, std::move(head_1),
+                    std::move(head_2), std::move(ancestor),
+                    std::move(on_done));
+  }
+
+  void Cancel() override { strategy_.Cancel(); }
+
+ private:
+  std::vector<std::pair<storage::CommitId, storage::CommitId>>* const merges_;
+  LastOneWinsMergeStrategy strategy_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(RecordingMergeStrategy);
+};
+
 class MergeResolverTest : public test::TestWithMessageLoop {
  public:
   MergeResolverTest()
@@ -85,6 +123,36 @@ class MergeResolverTest : public test::TestWithMessageLoop {
     return actual_commit->GetId();
   }
 
+  storage::CommitId CreateMergeCommit(
+      storage::CommitIdView left,
+      storage::CommitIdView right,
+      std::function<void(storage::Journal*)> contents) {
+    std::unique_ptr<storage::Journal> journal;
+    EXPECT_EQ(storage::Status::OK,
+              page_storage_->StartMergeCommit(left.ToString(),
+                                              right.ToString(), &journal));
+    contents(journal.get());
+    storage::Status actual_status;
+    std::unique_ptr<const storage::Commit> actual_commit;
+    journal->Commit(callback::Capture([this] { message_loop_.PostQuitTask(); },
+                                      &actual_status, &actual_commit));
+    EXPECT_FALSE(RunLoopWithTimeout());
+    EXPECT_EQ(storage::Status::OK, actual_status);
+    return actual_commit->GetId();
+  }
+
+  std::unique_ptr<const storage::Commit> GetCommit(
+      const storage::CommitId& id) {
+    storage::Status status;
+    std::unique_ptr<const storage::Commit> commit;
+    page_storage_->GetCommit(
+        id, ::callback::Capture([this] { message_loop_.PostQuitTask(); },
+                                &status, &commit));
+    EXPECT_FALSE(RunLoopWithTimeout());
+    EXPECT_EQ(storage::Status::OK, status);
+    return commit;
+  }
+
   std::vector<storage::Entry> GetCommitContents(const storage::Commit& commit) {
     storage::Status status;
     std::vector<storage::Entry> result;
@@ -257,6 +325,108 @@ TEST_F(MergeResolverTest, LastOneWins) {
   EXPECT_EQ(MakeObjectId("val3.0"), content_vector[1].object_id);
 }
 
+TEST_F(MergeResolverTest, ChainsMergesOfMoreThanTwoHeads) {
+  // Set up a conflict between three heads.
+  CreateCommit(storage::kFirstPageCommitId, AddKeyValueToJournal("key1", "a"));
+  CreateCommit(storage::kFirstPageCommitId, AddKeyValueToJournal("key2", "b"));
+  CreateCommit(storage::kFirstPageCommitId, AddKeyValueToJournal("key3", "c"));
+
+  std::vector<storage::CommitId> ids;
+  EXPECT_EQ(storage::Status::OK, page_storage_->GetHeadCommitIds(&ids));
+  EXPECT_EQ(3u, ids.size());
+
+  metrics::MetricsRegistry metrics;
+  MergeResolver resolver([] {}, &environment_, page_storage_.get(), &metrics);
+  resolver.SetMergeStrategy(std::make_unique<LastOneWinsMergeStrategy>());
+  resolver.set_on_empty([this, &ids] {
+    EXPECT_EQ(storage::Status::OK, page_storage_->GetHeadCommitIds(&ids));
+    if (ids.size() == 1u) {
+      message_loop_.PostQuitTask();
+    }
+  });
+
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_TRUE(resolver.IsEmpty());
+  EXPECT_EQ(1u, ids.size());
+  EXPECT_EQ(2, metrics.GetCounter("merges")->value());
+  // The second merge was chained to the first one.
+  EXPECT_EQ(1, metrics.GetCounter("chained_merges")->value());
+}
+
+TEST_F(MergeResolverTest, MergesHeadsAsBalancedTree) {
+  // Set up a conflict between four heads of the same generation.
+  CreateCommit(storage::kFirstPageCommitId, AddKeyValueToJournal("key1", "a"));
+  CreateCommit(storage::kFirstPageCommitId, AddKeyValueToJournal("key2", "b"));
+  CreateCommit(storage::kFirstPageCommitId, AddKeyValueToJournal("key3", "c"));
+  CreateCommit(storage::kFirstPageCommitId, AddKeyValueToJournal("key4", "d"));
+
+  std::vector<storage::CommitId> ids;
+  EXPECT_EQ(storage::Status::OK, page_storage_->GetHeadCommitIds(&ids));
+  EXPECT_EQ(4u, ids.size());
+
+  MergeResolver resolver([] {}, &environment_, page_storage_.get());
+  resolver.SetMergeStrategy(std::make_unique<LastOneWinsMergeStrategy>());
+  resolver.set_on_empty([this, &ids] {
+    EXPECT_EQ(storage::Status::OK, page_storage_->GetHeadCommitIds(&ids));
+    if (ids.size() == 1u) {
+      message_loop_.PostQuitTask();
+    }
+  });
+
+  EXPECT_FALSE(RunLoopWithTimeout());
+  ASSERT_EQ(1u, ids.size());
+  storage::Status status;
+  std::unique_ptr<const storage::Commit> commit;
+  page_storage_->GetCommit(
+      ids[0], ::callback::Capture([this] { message_loop_.PostQuitTask(); },
+                                  &status, &commit));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(storage::Status::OK, status);
+  // The heads are one generation above the first commit. They are merged
+  // pairwise, then the two merge commits are merged together.
+  EXPECT_EQ(3u, commit->GetGeneration());
+  EXPECT_EQ(4u, GetCommitContents(*commit).size());
+}
+
+TEST_F(MergeResolverTest, BreaksTimestampTiesById) {
+  storage::CommitId commit_1 = CreateCommit(
+      storage::kFirstPageCommitId, AddKeyValueToJournal("key1", "a"));
+  storage::CommitId commit_2 = CreateCommit(
+      storage::kFirstPageCommitId, AddKeyValueToJournal("key2", "b"));
+  // Two different merges of the same parents.
+  storage::CommitId merge_1 =
+      CreateMergeCommit(commit_1, commit_2, AddKeyValueToJournal("key3", "c"));
+  storage::CommitId merge_2 =
+      CreateMergeCommit(commit_1, commit_2, AddKeyValueToJournal("key4", "d"));
+  ASSERT_NE(merge_1, merge_2);
+
+  // A merge commit is strictly newer than its parents, and two merges of the
+  // same parents have the same timestamp.
+  int64_t parent_timestamp = std::max(GetCommit(commit_1)->GetTimestamp(),
+                                      GetCommit(commit_2)->GetTimestamp());
+  EXPECT_EQ(parent_timestamp + 1, GetCommit(merge_1)->GetTimestamp());
+  EXPECT_EQ(parent_timestamp + 1, GetCommit(merge_2)->GetTimestamp());
+
+  std::vector<std::pair<storage::CommitId, storage::CommitId>> merges;
+  std::vector<storage::CommitId> ids;
+  MergeResolver resolver([] {}, &environment_, page_storage_.get());
+  resolver.SetMergeStrategy(std::make_unique<RecordingMergeStrategy>(&merges));
+  resolver.set_on_empty([this, &ids] {
+    EXPECT_EQ(storage::Status::OK, page_storage_->GetHeadCommitIds(&ids));
+    if (ids.size() == 1u) {
+      message_loop_.PostQuitTask();
+    }
+  });
+  EXPECT_FALSE(RunLoopWithTimeout());
+
+  // The heads tie on timestamp, so the one with the smallest id comes first.
+  ASSERT_EQ(1u, merges.size());
+  EXPECT_EQ(std::min(merge_1, merge_2), merges[0].first);
+  EXPECT_EQ(std::max(merge_1, merge_2), merges[0].second);
+  ASSERT_EQ(1u, ids.size());
+  EXPECT_EQ(parent_timestamp + 2, GetCommit(ids[0])->GetTimestamp());
+}
+
 TEST_F(MergeResolverTest, None) {
   // Set up conflict
   storage::CommitId commit_1 = CreateCommit(
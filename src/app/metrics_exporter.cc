@@ -0,0 +1,68 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/app/metrics_exporter.h"
+
+#include <utility>
+#include <vector>
+
+#include "apps/ledger/src/app/constants.h"
+#include "apps/ledger/src/metrics/metrics_encoding.h"
+#include "lib/ftl/files/file.h"
+#include "lib/ftl/files/path.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/strings/concatenate.h"
+
+namespace ledger {
+
+constexpr ftl::TimeDelta MetricsExporter::kDefaultPollPeriod;
+
+MetricsExporter::MetricsExporter(ftl::RefPtr<ftl::TaskRunner> task_runner,
+                                 std::string repository_path,
+                                 metrics::MetricsRegistry* metrics,
+                                 ftl::TimeDelta poll_period)
+    : task_runner_(std::move(task_runner)),
+      request_path_(
+          ftl::Concatenate({repository_path, "/", kMetricsRequestFilename})),
+      metrics_path_(ftl::Concatenate({repository_path, "/", kMetricsFilename})),
+      temp_dir_(ftl::Concatenate({repository_path, "/tmp"})),
+      metrics_(metrics),
+      poll_period_(poll_period),
+      weak_factory_(this) {
+  FTL_DCHECK(metrics_);
+  ScheduleCheck();
+}
+
+MetricsExporter::~MetricsExporter() {}
+
+void MetricsExporter::ScheduleCheck() {
+  task_runner_->PostDelayedTask(
+      [weak_this = weak_factory_.GetWeakPtr()] {
+        if (weak_this) {
+          weak_this->CheckRequest();
+        }
+      },
+      poll_period_);
+}
+
+void MetricsExporter::CheckRequest() {
+  std::string request;
+  if (files::IsFile(request_path_) &&
+      files::ReadFileToString(request_path_, &request)) {
+    files::DeletePath(request_path_, false);
+
+    std::vector<metrics::MetricValue> values;
+    metrics_->Snapshot("", &values);
+    if (!files::WriteFileInTwoPhases(
+            metrics_path_, metrics::EncodeMetrics(values), temp_dir_)) {
+      FTL_LOG(ERROR) << "Unable to write the metrics to " << metrics_path_;
+    }
+    if (request == kMetricsResetRequest) {
+      metrics_->Reset();
+    }
+  }
+  ScheduleCheck();
+}
+
+}  // namespace ledger
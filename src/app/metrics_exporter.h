@@ -0,0 +1,55 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_APP_METRICS_EXPORTER_H_
+#define APPS_LEDGER_SRC_APP_METRICS_EXPORTER_H_
+
+#include <string>
+
+#include "apps/ledger/src/metrics/metrics_registry.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/ref_ptr.h"
+#include "lib/ftl/memory/weak_ptr.h"
+#include "lib/ftl/tasks/task_runner.h"
+#include "lib/ftl/time/time_delta.h"
+
+namespace ledger {
+
+// Exports the metrics of the running Ledger to `ledger_tool`. The tool reaches
+// the Ledger through the repository dir of the user, as for its other
+// commands: it writes a request file in this directory, which is checked every
+// |poll_period|, and |metrics| are written to the metrics file in answer.
+class MetricsExporter {
+ public:
+  static constexpr ftl::TimeDelta kDefaultPollPeriod =
+      ftl::TimeDelta::FromSeconds(1);
+
+  MetricsExporter(ftl::RefPtr<ftl::TaskRunner> task_runner,
+                  std::string repository_path,
+                  metrics::MetricsRegistry* metrics,
+                  ftl::TimeDelta poll_period = kDefaultPollPeriod);
+  ~MetricsExporter();
+
+ private:
+  void ScheduleCheck();
+
+  // Answers the pending request, if any.
+  void CheckRequest();
+
+  ftl::RefPtr<ftl::TaskRunner> task_runner_;
+  const std::string request_path_;
+  const std::string metrics_path_;
+  const std::string temp_dir_;
+  metrics::MetricsRegistry* const metrics_;
+  const ftl::TimeDelta poll_period_;
+
+  // Must be the last member field.
+  ftl::WeakPtrFactory<MetricsExporter> weak_factory_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(MetricsExporter);
+};
+
+}  // namespace ledger
+
+#endif  // APPS_LEDGER_SRC_APP_METRICS_EXPORTER_H_
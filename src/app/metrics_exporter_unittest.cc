@@ -0,0 +1,83 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/app/metrics_exporter.h"
+
+#include <string>
+#include <vector>
+
+#include "apps/ledger/src/app/constants.h"
+#include "apps/ledger/src/metrics/metrics_encoding.h"
+#include "apps/ledger/src/test/test_with_message_loop.h"
+#include "gtest/gtest.h"
+#include "lib/ftl/files/file.h"
+#include "lib/ftl/files/path.h"
+#include "lib/ftl/files/scoped_temp_dir.h"
+#include "lib/ftl/strings/concatenate.h"
+
+namespace ledger {
+namespace {
+
+class MetricsExporterTest : public test::TestWithMessageLoop {
+ public:
+  MetricsExporterTest()
+      : request_path_(
+            ftl::Concatenate({tmp_dir_.path(), "/", kMetricsRequestFilename})),
+        metrics_path_(
+            ftl::Concatenate({tmp_dir_.path(), "/", kMetricsFilename})),
+        exporter_(message_loop_.task_runner(),
+                  tmp_dir_.path(),
+                  &metrics_,
+                  ftl::TimeDelta::FromMilliseconds(1)) {}
+
+ protected:
+  // Sends |request| to the exporter and returns the metrics it exports.
+  std::vector<metrics::MetricValue> RequestMetrics(ftl::StringView request) {
+    EXPECT_TRUE(files::WriteFile(request_path_, request.data(),
+                                 request.size()));
+    for (int i = 0; i < 1000 && !files::IsFile(metrics_path_); ++i) {
+      RunLoopWithTimeout(ftl::TimeDelta::FromMilliseconds(1));
+    }
+    EXPECT_TRUE(files::IsFile(metrics_path_));
+    EXPECT_FALSE(files::IsFile(request_path_));
+
+    std::string data;
+    EXPECT_TRUE(files::ReadFileToString(metrics_path_, &data));
+    EXPECT_TRUE(files::DeletePath(metrics_path_, false));
+    std::vector<metrics::MetricValue> values;
+    EXPECT_TRUE(metrics::DecodeMetrics(data, &values));
+    return values;
+  }
+
+  files::ScopedTempDir tmp_dir_;
+  const std::string request_path_;
+  const std::string metrics_path_;
+  metrics::MetricsRegistry metrics_;
+  MetricsExporter exporter_;
+
+ private:
+  FTL_DISALLOW_COPY_AND_ASSIGN(MetricsExporterTest);
+};
+
+TEST_F(MetricsExporterTest, ExportMetrics) {
+  metrics_.GetChild("page:00")->GetCounter("merges")->Increment(2);
+
+  std::vector<metrics::MetricValue> values = RequestMetrics("");
+  ASSERT_EQ(1u, values.size());
+  EXPECT_EQ("page:00", values[0].path);
+  EXPECT_EQ("merges", values[0].name);
+  EXPECT_EQ(2, values[0].value);
+
+  // The metrics are only reset if requested.
+  values = RequestMetrics(kMetricsResetRequest);
+  ASSERT_EQ(1u, values.size());
+  EXPECT_EQ(2, values[0].value);
+
+  values = RequestMetrics("");
+  ASSERT_EQ(1u, values.size());
+  EXPECT_EQ(0, values[0].value);
+}
+
+}  // namespace
+}  // namespace ledger
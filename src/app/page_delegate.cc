@@ -12,6 +12,7 @@
 #include "apps/ledger/src/app/page_manager.h"
 #include "apps/ledger/src/app/page_snapshot_impl.h"
 #include "apps/ledger/src/app/page_utils.h"
+#include "apps/ledger/src/callback/trace_flow.h"
 #include "apps/ledger/src/convert/convert.h"
 #include "apps/tracing/lib/trace/event.h"
 #include "lib/ftl/functional/make_copyable.h"
@@ -26,7 +27,7 @@ PageDelegate::PageDelegate(coroutine::CoroutineService* coroutine_service,
     : manager_(manager),
       storage_(storage),
       interface_(std::move(request), this),
-      branch_tracker_(coroutine_service, manager, storage) {
+      branch_tracker_(coroutine_service, manager, storage, manager->metrics()) {
   interface_.set_on_empty([this] {
     branch_tracker_.StopTransaction(nullptr);
     CheckEmpty();
@@ -88,6 +89,8 @@ void PageDelegate::PutWithPriority(
     fidl::Array<uint8_t> value,
     Priority priority,
     const Page::PutWithPriorityCallback& callback) {
+  TRACE_DURATION("ledger", "page_delegate_put", "key_size", key.size(),
+                 "value_size", value.size());
   auto tracked_callback = TrackCallback(std::move(callback));
   // TODO(etiennej): Use asynchronous write, otherwise the run loop may block
   // until the socket is drained.
@@ -102,7 +105,12 @@ void PageDelegate::PutWithPriority(
           return;
         }
 
-        PutInCommit(std::move(key), std::move(object_id),
+        // Links the written value to its insertion in the journal, which
+        // waits for the previous operations on the page.
+        uint64_t trace_flow_id = TRACE_NONCE();
+        TRACE_FLOW_BEGIN("ledger", "object", trace_flow_id, "object_id",
+                         callback::TraceIdArg(object_id));
+        PutInCommit(std::move(key), std::move(object_id), trace_flow_id,
                     priority == Priority::EAGER ? storage::KeyPriority::EAGER
                                                 : storage::KeyPriority::LAZY,
                     std::move(callback));
@@ -129,7 +137,10 @@ void PageDelegate::PutReference(fidl::Array<uint8_t> key,
               PageUtils::ConvertStatus(status, Status::REFERENCE_NOT_FOUND));
           return;
         }
-        PutInCommit(std::move(key), std::move(object_id),
+        uint64_t trace_flow_id = TRACE_NONCE();
+        TRACE_FLOW_BEGIN("ledger", "object", trace_flow_id, "object_id",
+                         callback::TraceIdArg(object_id));
+        PutInCommit(std::move(key), std::move(object_id), trace_flow_id,
                     priority == Priority::EAGER ? storage::KeyPriority::EAGER
                                                 : storage::KeyPriority::LAZY,
                     std::move(callback));
@@ -237,12 +248,17 @@ const storage::CommitId& PageDelegate::GetCurrentCommitId() {
 
 void PageDelegate::PutInCommit(fidl::Array<uint8_t> key,
                                storage::ObjectId object_id,
+                               uint64_t trace_flow_id,
                                storage::KeyPriority priority,
                                std::function<void(Status)> callback) {
   RunInTransaction(
       ftl::MakeCopyable([
-        key = std::move(key), object_id = std::move(object_id), priority
+        key = std::move(key), object_id = std::move(object_id), trace_flow_id,
+        priority
       ](storage::Journal * journal) mutable {
+        TRACE_DURATION("ledger", "page_delegate_journal_put", "object_id",
+                       callback::TraceIdArg(object_id));
+        TRACE_FLOW_END("ledger", "object", trace_flow_id);
         return PageUtils::ConvertStatus(
             journal->Put(std::move(key), std::move(object_id), priority));
       }),
@@ -298,6 +314,7 @@ void PageDelegate::CommitJournal(
     std::unique_ptr<storage::Journal> journal,
     std::function<void(Status, std::unique_ptr<const storage::Commit>)>
         callback) {
+  TRACE_DURATION("ledger", "page_delegate_commit_journal");
   storage::Journal* journal_ptr = journal.get();
   in_progress_journals_.push_back(std::move(journal));
 
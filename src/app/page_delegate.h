@@ -81,8 +81,11 @@ class PageDelegate {
 
   const storage::CommitId& GetCurrentCommitId();
 
+  // Puts |value| in the current journal, ending the trace flow
+  // |trace_flow_id| started when |value| was added to storage.
   void PutInCommit(fidl::Array<uint8_t> key,
                    storage::ObjectId value,
+                   uint64_t trace_flow_id,
                    storage::KeyPriority priority,
                    StatusCallback callback);
 
@@ -684,6 +684,88 @@ TEST_F(PageImplTest, PutGetSnapshotGetEntriesWithStart) {
   EXPECT_EQ(lazy_key, convert::ExtendedStringView(actual_entries[1]->key));
 }
 
+TEST_F(PageImplTest, PutGetSnapshotGetEntriesFromOffset) {
+  auto callback_statusok = [this](Status status) {
+    EXPECT_EQ(Status::OK, status);
+    message_loop_.PostQuitTask();
+  };
+  for (int i = 0; i < 5; ++i) {
+    page_ptr_->Put(convert::ToArray(ftl::StringPrintf("00%d-key", i)),
+                   convert::ToArray("value"), callback_statusok);
+    EXPECT_FALSE(RunLoopWithTimeout());
+  }
+
+  PageSnapshotPtr snapshot = GetSnapshot();
+  fidl::Array<EntryPtr> actual_entries;
+  auto callback_getentries = [this, &actual_entries](
+                                 Status status, fidl::Array<EntryPtr> entries,
+                                 fidl::Array<uint8_t> next_token) {
+    EXPECT_EQ(Status::OK, status);
+    EXPECT_TRUE(next_token.is_null());
+    actual_entries = std::move(entries);
+    message_loop_.PostQuitTask();
+  };
+  snapshot->GetEntriesFromOffset(nullptr, 3, callback_getentries);
+  EXPECT_FALSE(RunLoopWithTimeout());
+
+  ASSERT_EQ(2u, actual_entries.size());
+  EXPECT_EQ("003-key", convert::ExtendedStringView(actual_entries[0]->key));
+  EXPECT_EQ("004-key", convert::ExtendedStringView(actual_entries[1]->key));
+
+  snapshot->GetEntriesFromOffset(convert::ToArray("001"), 2,
+                                 callback_getentries);
+  EXPECT_FALSE(RunLoopWithTimeout());
+
+  ASSERT_EQ(2u, actual_entries.size());
+  EXPECT_EQ("003-key", convert::ExtendedStringView(actual_entries[0]->key));
+
+  snapshot->GetEntriesFromOffset(nullptr, 5, callback_getentries);
+  EXPECT_FALSE(RunLoopWithTimeout());
+
+  EXPECT_EQ(0u, actual_entries.size());
+}
+
+TEST_F(PageImplTest, PutGetSnapshotCount) {
+  auto callback_statusok = [this](Status status) {
+    EXPECT_EQ(Status::OK, status);
+    message_loop_.PostQuitTask();
+  };
+  for (const auto& key : {"001-a", "001-b", "002-a"}) {
+    page_ptr_->Put(convert::ToArray(key), convert::ToArray("value"),
+                   callback_statusok);
+    EXPECT_FALSE(RunLoopWithTimeout());
+  }
+
+  uint64_t actual_count;
+  auto callback_count = [this, &actual_count](Status status, uint64_t count) {
+    EXPECT_EQ(Status::OK, status);
+    actual_count = count;
+    message_loop_.PostQuitTask();
+  };
+
+  PageSnapshotPtr snapshot = GetSnapshot();
+  snapshot->Count(nullptr, callback_count);
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(3u, actual_count);
+
+  snapshot->Count(convert::ToArray("001"), callback_count);
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(2u, actual_count);
+
+  snapshot = GetSnapshot(convert::ToArray("001"));
+  snapshot->Count(nullptr, callback_count);
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(2u, actual_count);
+
+  snapshot->Count(convert::ToArray("001-b"), callback_count);
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(1u, actual_count);
+
+  snapshot->Count(convert::ToArray("002"), callback_count);
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(0u, actual_count);
+}
+
 TEST_F(PageImplTest, PutGetSnapshotGetKeys) {
   std::string key1("some_key");
   std::string value1("a small value");
@@ -11,17 +11,21 @@
 
 namespace ledger {
 
+constexpr ftl::TimeDelta PageManager::kDefaultSyncTimeout;
+
 PageManager::PageManager(
     Environment* environment,
     std::unique_ptr<storage::PageStorage> page_storage,
     std::unique_ptr<cloud_sync::PageSyncContext> page_sync_context,
     std::unique_ptr<MergeResolver> merge_resolver,
-    ftl::TimeDelta sync_timeout)
+    ftl::TimeDelta sync_timeout,
+    metrics::MetricsRegistry* metrics)
     : environment_(environment),
       page_storage_(std::move(page_storage)),
       page_sync_context_(std::move(page_sync_context)),
       merge_resolver_(std::move(merge_resolver)),
       sync_timeout_(sync_timeout),
+      metrics_(metrics::OrUnreported(metrics)),
       weak_factory_(this) {
   pages_.set_on_empty([this] { CheckEmpty(); });
   snapshots_.set_on_empty([this] { CheckEmpty(); });
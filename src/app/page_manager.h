@@ -15,6 +15,7 @@
 #include "apps/ledger/src/callback/auto_cleanable.h"
 #include "apps/ledger/src/cloud_sync/public/ledger_sync.h"
 #include "apps/ledger/src/environment/environment.h"
+#include "apps/ledger/src/metrics/metrics_registry.h"
 #include "apps/ledger/src/storage/public/page_storage.h"
 #include "apps/ledger/src/storage/public/page_sync_delegate.h"
 #include "lib/fidl/cpp/bindings/interface_request.h"
@@ -34,13 +35,19 @@ namespace ledger {
 // |on_empty_callback|.
 class PageManager {
  public:
+  // Maximal time to wait for the initial sync before serving the local data.
+  static constexpr ftl::TimeDelta kDefaultSyncTimeout =
+      ftl::TimeDelta::FromSeconds(5);
+
   // Both |page_storage| and |page_sync| are owned by PageManager and are
-  // deleted when it goes away.
+  // deleted when it goes away. The page-level objects record their metrics in
+  // |metrics|, if not null.
   PageManager(Environment* environment,
               std::unique_ptr<storage::PageStorage> page_storage,
               std::unique_ptr<cloud_sync::PageSyncContext> page_sync,
               std::unique_ptr<MergeResolver> merge_resolver,
-              ftl::TimeDelta sync_timeout = ftl::TimeDelta::FromSeconds(5));
+              ftl::TimeDelta sync_timeout = kDefaultSyncTimeout,
+              metrics::MetricsRegistry* metrics = nullptr);
   ~PageManager();
 
   // Creates a new PageImpl managed by this PageManager, and binds it to the
@@ -57,6 +64,8 @@ class PageManager {
     on_empty_callback_ = on_empty_callback;
   }
 
+  metrics::MetricsRegistry* metrics() { return metrics_; }
+
  private:
   void CheckEmpty();
   void OnSyncBacklogDownloaded();
@@ -66,6 +75,7 @@ class PageManager {
   std::unique_ptr<cloud_sync::PageSyncContext> page_sync_context_;
   std::unique_ptr<MergeResolver> merge_resolver_;
   const ftl::TimeDelta sync_timeout_;
+  metrics::MetricsRegistry* const metrics_;
   callback::AutoCleanableSet<BoundInterface<PageSnapshot, PageSnapshotImpl>>
       snapshots_;
   callback::AutoCleanableSet<PageDelegate> pages_;
@@ -158,6 +158,59 @@ void PageSnapshotImpl::GetEntries(fidl::Array<uint8_t> key_start,
                                    std::move(on_next), std::move(on_done));
 }
 
+void PageSnapshotImpl::GetEntriesFromOffset(
+    fidl::Array<uint8_t> key_start,
+    uint64_t offset,
+    const GetEntriesFromOffsetCallback& callback) {
+  auto timed_callback = TRACE_CALLBACK(std::move(callback), "ledger",
+                                       "snapshot_get_entries_from_offset");
+
+  page_storage_->GetCommitKeyAtOffset(
+      *commit_, std::max(key_prefix_, convert::ToString(key_start)), offset,
+      [ this, callback = std::move(timed_callback) ](storage::Status status,
+                                                     std::string key) {
+        if (status == storage::Status::NOT_FOUND) {
+          callback(Status::OK, fidl::Array<EntryPtr>::New(0), nullptr);
+          return;
+        }
+        if (status != storage::Status::OK) {
+          FTL_LOG(ERROR) << "Error while reading.";
+          callback(Status::IO_ERROR, nullptr, nullptr);
+          return;
+        }
+        // Starting from the found key is equivalent to continuing a previous
+        // |GetEntries| call that returned it as token.
+        GetEntries(nullptr, convert::ToArray(key), callback);
+      });
+}
+
+void PageSnapshotImpl::Count(fidl::Array<uint8_t> key_prefix,
+                             const CountCallback& callback) {
+  auto timed_callback =
+      TRACE_CALLBACK(std::move(callback), "ledger", "snapshot_count");
+
+  // Counted entries must match both |key_prefix_| and |key_prefix|, which is
+  // only possible if one of them is a prefix of the other.
+  std::string prefix = convert::ToString(key_prefix);
+  if (PageUtils::MatchesPrefix(key_prefix_, prefix)) {
+    prefix = key_prefix_;
+  } else if (!PageUtils::MatchesPrefix(prefix, key_prefix_)) {
+    timed_callback(Status::OK, 0u);
+    return;
+  }
+
+  page_storage_->GetCommitContentsCount(
+      *commit_, std::move(prefix), [callback = std::move(timed_callback)](
+                                       storage::Status status, uint64_t count) {
+        if (status != storage::Status::OK) {
+          FTL_LOG(ERROR) << "Error while counting.";
+          callback(Status::IO_ERROR, 0u);
+          return;
+        }
+        callback(Status::OK, count);
+      });
+}
+
 void PageSnapshotImpl::GetKeys(fidl::Array<uint8_t> key_start,
                                fidl::Array<uint8_t> token,
                                const GetKeysCallback& callback) {
@@ -26,6 +26,12 @@ class PageSnapshotImpl : public PageSnapshot {
   void GetEntries(fidl::Array<uint8_t> key_start,
                   fidl::Array<uint8_t> token,
                   const GetEntriesCallback& callback) override;
+  void GetEntriesFromOffset(
+      fidl::Array<uint8_t> key_start,
+      uint64_t offset,
+      const GetEntriesFromOffsetCallback& callback) override;
+  void Count(fidl::Array<uint8_t> key_prefix,
+             const CountCallback& callback) override;
   void GetKeys(fidl::Array<uint8_t> key_start,
                fidl::Array<uint8_t> token,
                const GetKeysCallback& callback) override;
@@ -0,0 +1,37 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/callback/trace_flow.h"
+
+namespace callback {
+
+namespace {
+
+constexpr uint64_t kFnvOffsetBasis = 14695981039346656037ull;
+constexpr uint64_t kFnvPrime = 1099511628211ull;
+
+}  // namespace
+
+uint64_t TraceFlowId(ftl::StringView id) {
+  // FNV-1a, so that the flow ids are stable across processes and runs.
+  uint64_t hash = kFnvOffsetBasis;
+  for (unsigned char c : id) {
+    hash ^= c;
+    hash *= kFnvPrime;
+  }
+  return hash;
+}
+
+std::string TraceIdArg(ftl::StringView id) {
+  constexpr char kHexDigits[] = "0123456789abcdef";
+  std::string result;
+  result.reserve(id.size() * 2);
+  for (unsigned char c : id) {
+    result.push_back(kHexDigits[c >> 4]);
+    result.push_back(kHexDigits[c & 0xf]);
+  }
+  return result;
+}
+
+}  // namespace callback
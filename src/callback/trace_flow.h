@@ -0,0 +1,29 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_CALLBACK_TRACE_FLOW_H_
+#define APPS_LEDGER_SRC_CALLBACK_TRACE_FLOW_H_
+
+#include <stdint.h>
+
+#include <string>
+
+#include "lib/ftl/strings/string_view.h"
+
+namespace callback {
+
+// Returns the id of the trace flow following the commit with the given |id|
+// through the ledger. All components compute the same flow id for a given
+// commit, so that they can add their events to the flow without passing the
+// flow id around. Objects are not identified this way: the same content can be
+// written several times, while each write needs its own flow.
+uint64_t TraceFlowId(ftl::StringView id);
+
+// Returns the hexadecimal representation of the given object or commit |id|,
+// to be used as a trace argument.
+std::string TraceIdArg(ftl::StringView id);
+
+}  // namespace callback
+
+#endif  // APPS_LEDGER_SRC_CALLBACK_TRACE_FLOW_H_
@@ -0,0 +1,27 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/callback/trace_flow.h"
+
+#include <string>
+
+#include "gtest/gtest.h"
+
+namespace callback {
+namespace {
+
+TEST(TraceFlow, TraceFlowId) {
+  EXPECT_EQ(TraceFlowId("commit_id"), TraceFlowId(std::string("commit_id")));
+  EXPECT_NE(TraceFlowId("commit_id1"), TraceFlowId("commit_id2"));
+  EXPECT_NE(TraceFlowId(""), TraceFlowId(std::string(1, '\0')));
+}
+
+TEST(TraceFlow, TraceIdArg) {
+  EXPECT_EQ("", TraceIdArg(""));
+  EXPECT_EQ("00ff10", TraceIdArg(std::string("\x00\xff\x10", 3)));
+  EXPECT_EQ("6964", TraceIdArg("id"));
+}
+
+}  // namespace
+}  // namespace callback
@@ -8,6 +8,7 @@
 #include "apps/ledger/src/cloud_provider/impl/timestamp_conversions.h"
 #include "apps/ledger/src/firebase/encoding.h"
 #include "apps/ledger/src/firebase/status.h"
+#include "lib/ftl/functional/make_copyable.h"
 #include "lib/ftl/logging.h"
 #include "lib/ftl/strings/concatenate.h"
 #include "lib/ftl/strings/string_number_conversions.h"
@@ -27,28 +28,69 @@ std::string GetCommitPath(const Commit& commit) {
 }  // namespace
 
 CloudProviderImpl::CloudProviderImpl(firebase::Firebase* firebase,
-                                     gcs::CloudStorage* cloud_storage)
-    : firebase_(firebase), cloud_storage_(cloud_storage) {}
+                                     gcs::CloudStorage* cloud_storage,
+                                     ftl::RefPtr<ftl::TaskRunner> main_runner,
+                                     ledger::WorkerPool* worker_pool)
+    : firebase_(firebase),
+      cloud_storage_(cloud_storage),
+      main_runner_(std::move(main_runner)),
+      worker_pool_(worker_pool),
+      encoder_(worker_pool_, main_runner_),
+      decoder_(worker_pool_, main_runner_),
+      weak_factory_(this) {
+  FTL_DCHECK(!worker_pool_ || main_runner_);
+}
 
 CloudProviderImpl::~CloudProviderImpl() {}
 
 void CloudProviderImpl::AddCommit(const Commit& commit,
                                   const std::function<void(Status)>& callback) {
-  std::string encoded_commit;
-  bool ok = EncodeCommit(commit, &encoded_commit);
-  FTL_DCHECK(ok);
-
-  firebase_->Put(GetCommitPath(commit), encoded_commit,
-                 [callback](firebase::Status status) {
-                   callback(ConvertFirebaseStatus(status));
-                 });
+  encoder_.PostTaskAndReply(
+      ftl::MakeCopyable([commit = commit.Clone()] {
+        std::string encoded_commit;
+        bool ok = EncodeCommit(commit, &encoded_commit);
+        FTL_DCHECK(ok);
+        return encoded_commit;
+      }),
+      [ this, path = GetCommitPath(commit),
+        callback ](std::string encoded_commit) {
+        firebase_->Put(path, encoded_commit,
+                       [callback](firebase::Status status) {
+                         callback(ConvertFirebaseStatus(status));
+                       });
+      });
+}
+
+void CloudProviderImpl::AddCommits(
+    std::vector<Commit> commits,
+    const std::function<void(Status)>& callback) {
+  FTL_DCHECK(!commits.empty());
+  if (commits.size() == 1) {
+    AddCommit(commits.front(), callback);
+    return;
+  }
+
+  encoder_.PostTaskAndReply(
+      ftl::MakeCopyable([commits = std::move(commits)] {
+        std::string encoded_commits;
+        bool ok = EncodeCommits(commits, &encoded_commits);
+        FTL_DCHECK(ok);
+        return encoded_commits;
+      }),
+      [ this, callback ](std::string encoded_commits) {
+        // Write all commits in a single multi-path update of the commit root.
+        firebase_->Patch(kCommitRoot.ToString(), encoded_commits,
+                         [callback](firebase::Status status) {
+                           callback(ConvertFirebaseStatus(status));
+                         });
+      });
 }
 
 void CloudProviderImpl::WatchCommits(const std::string& min_timestamp,
                                      CommitWatcher* watcher) {
   watchers_[watcher] = std::make_unique<WatchClientImpl>(
       firebase_, kCommitRoot.ToString(), GetTimestampQuery(min_timestamp),
-      watcher);
+      watcher, main_runner_, worker_pool_);
 }
 
 void CloudProviderImpl::UnwatchCommits(CommitWatcher* watcher) {
@@ -58,29 +100,21 @@ void CloudProviderImpl::UnwatchCommits(CommitWatcher* watcher) {
 void CloudProviderImpl::GetCommits(
     const std::string& min_timestamp,
     std::function<void(Status, std::vector<Record>)> callback) {
-  firebase_->Get(
-      kCommitRoot.ToString(), GetTimestampQuery(min_timestamp),
-      [callback](firebase::Status status, const rapidjson::Value& value) {
-        if (status != firebase::Status::OK) {
-          callback(ConvertFirebaseStatus(status), std::vector<Record>());
-          return;
-        }
-        if (value.IsNull()) {
-          // No commits synced for this page yet.
-          callback(Status::OK, std::vector<Record>());
-          return;
-        }
-        if (!value.IsObject()) {
-          callback(Status::PARSE_ERROR, std::vector<Record>());
-          return;
-        }
-        std::vector<Record> records;
-        if (!DecodeMultipleCommitsFromValue(value, &records)) {
-          callback(Status::PARSE_ERROR, std::vector<Record>());
-          return;
-        }
-        callback(Status::OK, std::move(records));
-      });
+  GetCommitsWithQuery(GetTimestampQuery(min_timestamp), std::move(callback));
+}
+
+void CloudProviderImpl::GetCommitsPage(
+    const std::string& min_timestamp,
+    size_t max_count,
+    std::function<void(Status, std::vector<Record>)> callback) {
+  FTL_DCHECK(max_count > 0u);
+  // Firebase only allows to limit the number of results of an ordered query.
+  std::string query = min_timestamp.empty()
+                          ? "orderBy=\"timestamp\""
+                          : GetTimestampQuery(min_timestamp);
+  query.append("&limitToFirst=");
+  query.append(ftl::NumberToString(max_count));
+  GetCommitsWithQuery(query, std::move(callback));
 }
 
 void CloudProviderImpl::AddObject(ObjectIdView object_id,
@@ -98,12 +132,13 @@ void CloudProviderImpl::AddObject(ObjectIdView object_id,
 
 void CloudProviderImpl::GetObject(
     ObjectIdView object_id,
+    ledger::RequestPriority priority,
     std::function<void(Status status, uint64_t size, mx::socket data)>
         callback) {
   cloud_storage_->DownloadObject(
-      firebase::EncodeKey(object_id), [callback = std::move(callback)](
-                                          gcs::Status status, uint64_t size,
-                                          mx::socket data) {
+      firebase::EncodeKey(object_id), priority,
+      [callback = std::move(callback)](gcs::Status status, uint64_t size,
+                                       mx::socket data) {
         callback(ConvertGcsStatus(status), size, std::move(data));
       });
 }
@@ -118,4 +153,42 @@ std::string CloudProviderImpl::GetTimestampQuery(
          ftl::NumberToString(BytesToServerTimestamp(min_timestamp));
 }
 
+void CloudProviderImpl::GetCommitsWithQuery(
+    const std::string& query,
+    std::function<void(Status, std::vector<Record>)> callback) {
+  // Extract the commits as they are received, so that the whole JSON response
+  // is never held in memory, then decode them on the worker pool.
+  auto decoder = std::make_shared<MultipleCommitsDecoder>();
+  firebase_->GetObjectMembers(
+      kCommitRoot.ToString(), query,
+      [decoder](const std::string& key, const rapidjson::Value& value) {
+        decoder->AddCommitFromValue(value);
+      },
+      [
+        weak_this = weak_factory_.GetWeakPtr(), decoder,
+        callback = std::move(callback)
+      ](firebase::Status status) {
+        if (!weak_this) {
+          return;
+        }
+        if (status != firebase::Status::OK) {
+          callback(ConvertFirebaseStatus(status), std::vector<Record>());
+          return;
+        }
+        weak_this->decoder_.PostTaskAndReply(
+            [decoder] {
+              std::vector<Record> records;
+              bool ok = decoder->GetRecords(&records);
+              return std::make_pair(ok, std::move(records));
+            },
+            [callback](std::pair<bool, std::vector<Record>> result) {
+              if (!result.first) {
+                callback(Status::PARSE_ERROR, std::vector<Record>());
+                return;
+              }
+              callback(Status::OK, std::move(result.second));
+            });
+      });
+}
+
 }  // namespace cloud_provider
@@ -8,13 +8,19 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "apps/ledger/src/cloud_provider/impl/watch_client_impl.h"
 #include "apps/ledger/src/cloud_provider/public/cloud_provider.h"
 #include "apps/ledger/src/cloud_provider/public/types.h"
+#include "apps/ledger/src/environment/ordered_worker_tasks.h"
+#include "apps/ledger/src/environment/worker_pool.h"
 #include "apps/ledger/src/firebase/firebase.h"
 #include "apps/ledger/src/firebase/watch_client.h"
 #include "apps/ledger/src/gcs/cloud_storage.h"
+#include "lib/ftl/memory/weak_ptr.h"
+#include "lib/ftl/tasks/task_runner.h"
 #include "mx/socket.h"
 #include "mx/vmo.h"
 
@@ -22,14 +28,21 @@ namespace cloud_provider {
 
 class CloudProviderImpl : public CloudProvider {
  public:
+  // If |worker_pool| is not null, commits are encoded and decoded on it
+  // instead of on the main thread, whose runner is |main_runner|.
   CloudProviderImpl(firebase::Firebase* firebase,
-                    gcs::CloudStorage* cloud_storage);
+                    gcs::CloudStorage* cloud_storage,
+                    ftl::RefPtr<ftl::TaskRunner> main_runner = nullptr,
+                    ledger::WorkerPool* worker_pool = nullptr);
   ~CloudProviderImpl() override;
 
   // CloudProvider:
   void AddCommit(const Commit& commit,
                  const std::function<void(Status)>& callback) override;
 
+  void AddCommits(std::vector<Commit> commits,
+                  const std::function<void(Status)>& callback) override;
+
   void WatchCommits(const std::string& min_timestamp,
                     CommitWatcher* watcher) override;
 
@@ -39,12 +52,18 @@ class CloudProviderImpl : public CloudProvider {
       const std::string& min_timestamp,
       std::function<void(Status, std::vector<Record>)> callback) override;
 
+  void GetCommitsPage(
+      const std::string& min_timestamp,
+      size_t max_count,
+      std::function<void(Status, std::vector<Record>)> callback) override;
+
   void AddObject(ObjectIdView object_id,
                  mx::vmo data,
                  std::function<void(Status)> callback) override;
 
   void GetObject(
       ObjectIdView object_id,
+      ledger::RequestPriority priority,
       std::function<void(Status status, uint64_t size, mx::socket data)>
           callback) override;
 
@@ -54,9 +73,24 @@ class CloudProviderImpl : public CloudProvider {
   // returns empty query.
   std::string GetTimestampQuery(const std::string& min_timestamp);
 
+  // Retrieves the commits matching the given Firebase |query|.
+  void GetCommitsWithQuery(
+      const std::string& query,
+      std::function<void(Status, std::vector<Record>)> callback);
+
   firebase::Firebase* const firebase_;
   gcs::CloudStorage* const cloud_storage_;
+  const ftl::RefPtr<ftl::TaskRunner> main_runner_;
+  ledger::WorkerPool* const worker_pool_;
   std::map<CommitWatcher*, std::unique_ptr<WatchClientImpl>> watchers_;
+  // Encodes the commits to upload. Uploads are started in the order in which
+  // the commits were added.
+  ledger::OrderedWorkerTasks<std::string> encoder_;
+  // Decodes the commits retrieved by GetCommitsWithQuery().
+  ledger::OrderedWorkerTasks<std::pair<bool, std::vector<Record>>> decoder_;
+
+  // This must be the last member of the class.
+  ftl::WeakPtrFactory<CloudProviderImpl> weak_factory_;
 };
 
 }  // namespace cloud_provider
@@ -51,10 +51,12 @@ class CloudProviderImplTest : public test::TestWithMessageLoop,
 
   void DownloadObject(
       const std::string& key,
+      ledger::RequestPriority priority,
       const std::function<
           void(gcs::Status status, uint64_t size, mx::socket data)>& callback)
       override {
     download_keys_.push_back(key);
+    download_priorities_.push_back(priority);
     message_loop_.task_runner()->PostTask([this, callback] {
       callback(download_status_, download_response_size_,
                std::move(download_response_));
@@ -75,6 +77,27 @@ class CloudProviderImplTest : public test::TestWithMessageLoop,
     });
   }
 
+  void GetObjectMembers(
+      const std::string& key,
+      const std::string& query,
+      const std::function<firebase::ObjectMemberCallback>& on_member,
+      const std::function<void(firebase::Status status)>& callback) override {
+    get_keys_.push_back(key);
+    get_queries_.push_back(query);
+    message_loop_.task_runner()->PostTask([this, on_member, callback]() {
+      if (get_response_->IsObject()) {
+        for (auto& it : get_response_->GetObject()) {
+          on_member(it.name.GetString(), it.value);
+        }
+        callback(firebase::Status::OK);
+      } else {
+        callback(get_response_->IsNull() ? firebase::Status::OK
+                                         : firebase::Status::PARSE_ERROR);
+      }
+      message_loop_.PostQuitTask();
+    });
+  }
+
   void Put(
       const std::string& key,
       const std::string& data,
@@ -87,6 +110,18 @@ class CloudProviderImplTest : public test::TestWithMessageLoop,
     });
   }
 
+  void Patch(
+      const std::string& key,
+      const std::string& data,
+      const std::function<void(firebase::Status status)>& callback) override {
+    patch_keys_.push_back(key);
+    patch_data_.push_back(data);
+    message_loop_.task_runner()->PostTask([this, callback]() {
+      callback(firebase::Status::OK);
+      message_loop_.PostQuitTask();
+    });
+  }
+
   void Delete(
       const std::string& key,
       const std::function<void(firebase::Status status)>& callback) override {
@@ -122,6 +157,7 @@ class CloudProviderImplTest : public test::TestWithMessageLoop,
 
   // These members keep track of calls made on the GCS client.
   std::vector<std::string> download_keys_;
+  std::vector<ledger::RequestPriority> download_priorities_;
   std::vector<std::string> upload_keys_;
   std::vector<mx::vmo> upload_data_;
 
@@ -136,6 +172,8 @@ class CloudProviderImplTest : public test::TestWithMessageLoop,
   std::vector<std::string> get_queries_;
   std::vector<std::string> put_keys_;
   std::vector<std::string> put_data_;
+  std::vector<std::string> patch_keys_;
+  std::vector<std::string> patch_data_;
   std::vector<std::string> watch_keys_;
   std::vector<std::string> watch_queries_;
   unsigned int unwatch_count_ = 0u;
@@ -184,6 +222,85 @@ TEST_F(CloudProviderImplTest, AddCommit) {
   EXPECT_EQ(0u, unwatch_count_);
 }
 
+TEST_F(CloudProviderImplTest, AddCommits) {
+  std::vector<Commit> commits;
+  commits.emplace_back("id_1", "content_1", std::map<ObjectId, Data>{});
+  commits.emplace_back("id_2", "content_2", std::map<ObjectId, Data>{});
+
+  Status status;
+  cloud_provider_->AddCommits(
+      std::move(commits),
+      callback::Capture([this] { message_loop_.PostQuitTask(); }, &status));
+  EXPECT_FALSE(RunLoopWithTimeout());
+
+  EXPECT_EQ(Status::OK, status);
+  EXPECT_TRUE(put_keys_.empty());
+  EXPECT_EQ(1u, patch_keys_.size());
+  EXPECT_EQ(patch_keys_.size(), patch_data_.size());
+  EXPECT_EQ("commits", patch_keys_[0]);
+  EXPECT_EQ(
+      "{\"id_1V\":"
+      "{\"id\":\"id_1V\","
+      "\"content\":\"content_1V\","
+      "\"timestamp\":{\".sv\":\"timestamp\"},"
+      "\"batch_position\":0},"
+      "\"id_2V\":"
+      "{\"id\":\"id_2V\","
+      "\"content\":\"content_2V\","
+      "\"timestamp\":{\".sv\":\"timestamp\"},"
+      "\"batch_position\":1}"
+      "}",
+      patch_data_[0]);
+}
+
+// Verifies that a batch of a single commit is written as a single commit.
+TEST_F(CloudProviderImplTest, AddCommitsSingle) {
+  std::vector<Commit> commits;
+  commits.emplace_back("commit_id", "some_content", std::map<ObjectId, Data>{});
+
+  Status status;
+  cloud_provider_->AddCommits(
+      std::move(commits),
+      callback::Capture([this] { message_loop_.PostQuitTask(); }, &status));
+  EXPECT_FALSE(RunLoopWithTimeout());
+
+  EXPECT_EQ(Status::OK, status);
+  EXPECT_TRUE(patch_keys_.empty());
+  EXPECT_EQ(1u, put_keys_.size());
+  EXPECT_EQ("commits/commit_idV", put_keys_[0]);
+}
+
+// Verifies that commits encoded on a worker pool are uploaded in the order in
+// which they were added.
+TEST_F(CloudProviderImplTest, AddCommitsOnWorkerPool) {
+  ledger::WorkerPool worker_pool(4);
+  CloudProviderImpl cloud_provider(this, this, message_loop_.task_runner(),
+                                   &worker_pool);
+
+  const size_t kBatchCount = 10;
+  size_t done_count = 0;
+  for (size_t i = 0; i < kBatchCount; ++i) {
+    std::vector<Commit> commits;
+    commits.emplace_back("id_" + std::to_string(i), "content",
+                         std::map<ObjectId, Data>{});
+    commits.emplace_back("other_id_" + std::to_string(i), "content",
+                         std::map<ObjectId, Data>{});
+    cloud_provider.AddCommits(std::move(commits), [&done_count](Status status) {
+      EXPECT_EQ(Status::OK, status);
+      ++done_count;
+    });
+  }
+  while (done_count < kBatchCount) {
+    ASSERT_FALSE(RunLoopWithTimeout());
+  }
+
+  ASSERT_EQ(kBatchCount, patch_data_.size());
+  for (size_t i = 0; i < kBatchCount; ++i) {
+    EXPECT_NE(std::string::npos,
+              patch_data_[i].find("\"id_" + std::to_string(i) + "V\""));
+  }
+}
+
 TEST_F(CloudProviderImplTest, WatchUnwatch) {
   cloud_provider_->WatchCommits("", this);
   EXPECT_EQ(1u, watch_keys_.size());
@@ -236,6 +353,78 @@ TEST_F(CloudProviderImplTest, WatchAndGetNotifiedMultiple) {
   EXPECT_EQ(0u, malformed_notification_calls_);
 }
 
+// Tests handling a server event whose commits are streamed one by one.
+TEST_F(CloudProviderImplTest, WatchAndGetNotifiedStreamed) {
+  cloud_provider_->WatchCommits("", this);
+
+  EXPECT_TRUE(watch_client_->StreamsDataMembers("put", "/"));
+  std::string commit_1 =
+      "{\"content\":\"some_contentV\","
+      "\"id\":\"id_1V\","
+      "\"timestamp\":42"
+      "}";
+  std::string commit_2 =
+      "{\"content\":\"some_other_contentV\","
+      "\"id\":\"id_2V\","
+      "\"timestamp\":43"
+      "}";
+  for (const std::string& commit : {commit_1, commit_2}) {
+    rapidjson::Document document;
+    document.Parse(commit.c_str(), commit.size());
+    ASSERT_FALSE(document.HasParseError());
+    watch_client_->OnDataMember(document["id"].GetString(), document);
+  }
+  EXPECT_TRUE(commits_.empty());
+
+  watch_client_->OnDataEnd("put", "/");
+
+  Commit expected_n1("id_1", "some_content", std::map<ObjectId, Data>{});
+  Commit expected_n2("id_2", "some_other_content", std::map<ObjectId, Data>{});
+  EXPECT_EQ(2u, commits_.size());
+  EXPECT_EQ(expected_n1, commits_[0]);
+  EXPECT_EQ(ServerTimestampToBytes(42), server_timestamps_[0]);
+  EXPECT_EQ(expected_n2, commits_[1]);
+  EXPECT_EQ(ServerTimestampToBytes(43), server_timestamps_[1]);
+  EXPECT_EQ(0u, malformed_notification_calls_);
+
+  // The events for single commits are not streamed.
+  EXPECT_FALSE(watch_client_->StreamsDataMembers("put", "/id_3V"));
+}
+
+// Tests handling a patch event containing a batch of commits written together,
+// which share the same timestamp.
+TEST_F(CloudProviderImplTest, WatchAndGetNotifiedPatch) {
+  cloud_provider_->WatchCommits("", this);
+
+  std::string patch_content =
+      "{\"id_1V\":"
+      "{\"content\":\"some_contentV\","
+      "\"id\":\"id_1V\","
+      "\"timestamp\":42,"
+      "\"batch_position\":1"
+      "},"
+      "\"id_2V\":"
+      "{\"content\":\"some_other_contentV\","
+      "\"id\":\"id_2V\","
+      "\"timestamp\":42,"
+      "\"batch_position\":0"
+      "}}";
+  rapidjson::Document document;
+  document.Parse(patch_content.c_str(), patch_content.size());
+  ASSERT_FALSE(document.HasParseError());
+
+  watch_client_->OnPatch("/", document);
+
+  Commit expected_n1("id_1", "some_content", std::map<ObjectId, Data>{});
+  Commit expected_n2("id_2", "some_other_content", std::map<ObjectId, Data>{});
+  EXPECT_EQ(2u, commits_.size());
+  EXPECT_EQ(expected_n2, commits_[0]);
+  EXPECT_EQ(expected_n1, commits_[1]);
+  EXPECT_EQ(ServerTimestampToBytes(42), server_timestamps_[0]);
+  EXPECT_EQ(ServerTimestampToBytes(42), server_timestamps_[1]);
+  EXPECT_EQ(0u, malformed_notification_calls_);
+}
+
 // Tests handling a server event containing a single commit.
 TEST_F(CloudProviderImplTest, WatchAndGetNotifiedSingle) {
   cloud_provider_->WatchCommits("", this);
@@ -264,6 +453,39 @@ TEST_F(CloudProviderImplTest, WatchAndGetNotifiedSingle) {
   EXPECT_EQ(expected_timestamp, server_timestamps_[0]);
 }
 
+// Verifies that commits decoded on a worker pool are delivered to the watcher
+// in the order in which they were received.
+TEST_F(CloudProviderImplTest, WatchOnWorkerPool) {
+  ledger::WorkerPool worker_pool(4);
+  CloudProviderImpl cloud_provider(this, this, message_loop_.task_runner(),
+                                   &worker_pool);
+  cloud_provider.WatchCommits("", this);
+
+  const size_t kCommitCount = 10;
+  for (size_t i = 0; i < kCommitCount; ++i) {
+    std::string id = "id_" + std::to_string(i);
+    std::string put_content = "{\"id\":\"" + id +
+                              "V\",\"content\":\"some_contentV\","
+                              "\"timestamp\":" +
+                              std::to_string(i) + "}";
+    rapidjson::Document document;
+    document.Parse(put_content.c_str(), put_content.size());
+    ASSERT_FALSE(document.HasParseError());
+    watch_client_->OnPut("/" + id + "V", document);
+  }
+  EXPECT_TRUE(commits_.empty());
+
+  for (int i = 0; i < 100 && commits_.size() < kCommitCount; ++i) {
+    RunLoopWithTimeout(ftl::TimeDelta::FromMilliseconds(10));
+  }
+  ASSERT_EQ(kCommitCount, commits_.size());
+  for (size_t i = 0; i < kCommitCount; ++i) {
+    EXPECT_EQ("id_" + std::to_string(i), commits_[i].id);
+    EXPECT_EQ(ServerTimestampToBytes(i), server_timestamps_[i]);
+  }
+  EXPECT_EQ(0u, malformed_notification_calls_);
+}
+
 // Verifies that the initial response when there is no matching commits is
 // ignored.
 TEST_F(CloudProviderImplTest, WatchWhenThereIsNothingToWatch) {
@@ -373,6 +595,44 @@ TEST_F(CloudProviderImplTest, GetCommits) {
   EXPECT_EQ("orderBy=\"timestamp\"&startAt=42", get_queries_[0]);
 }
 
+TEST_F(CloudProviderImplTest, GetCommitsOnWorkerPool) {
+  ledger::WorkerPool worker_pool(4);
+  CloudProviderImpl cloud_provider(this, this, message_loop_.task_runner(),
+                                   &worker_pool);
+  std::string get_response_content =
+      "{\"id1V\":"
+      "{\"content\":\"xyzV\","
+      "\"id\":\"id1V\","
+      "\"timestamp\":43"
+      "},"
+      "\"id2V\":"
+      "{\"content\":\"bazingaV\","
+      "\"id\":\"id2V\","
+      "\"timestamp\":42"
+      "}}";
+  get_response_ = std::make_unique<rapidjson::Document>();
+  get_response_->Parse(get_response_content.c_str(),
+                       get_response_content.size());
+
+  bool called = false;
+  Status status;
+  std::vector<Record> records;
+  cloud_provider.GetCommits(
+      "", callback::Capture(
+              [this, &called] {
+                called = true;
+                message_loop_.PostQuitTask();
+              },
+              &status, &records));
+  while (!called) {
+    ASSERT_FALSE(RunLoopWithTimeout());
+  }
+  EXPECT_EQ(Status::OK, status);
+  ASSERT_EQ(2u, records.size());
+  EXPECT_EQ("id2", records[0].commit.id);
+  EXPECT_EQ("id1", records[1].commit.id);
+}
+
 TEST_F(CloudProviderImplTest, GetCommitsWhenThereAreNone) {
   std::string get_response_content = "null";
   get_response_ = std::make_unique<rapidjson::Document>();
@@ -391,6 +651,66 @@ TEST_F(CloudProviderImplTest, GetCommitsWhenThereAreNone) {
   EXPECT_TRUE(records.empty());
 }
 
+TEST_F(CloudProviderImplTest, GetCommitsMalformedCommit) {
+  std::string get_response_content =
+      "{\"id1V\":"
+      "{\"content\":\"xyzV\","
+      "\"id\":\"id1V\","
+      "\"timestamp\":42"
+      "},"
+      "\"id2V\":"
+      "{\"id\":\"id2V\","
+      "\"timestamp\":43"
+      "}}";
+  get_response_ = std::make_unique<rapidjson::Document>();
+  get_response_->Parse(get_response_content.c_str(),
+                       get_response_content.size());
+
+  Status status;
+  std::vector<Record> records;
+  cloud_provider_->GetCommits(
+      "", callback::Capture([this] { message_loop_.PostQuitTask(); }, &status,
+                            &records));
+  EXPECT_FALSE(RunLoopWithTimeout());
+
+  EXPECT_EQ(Status::PARSE_ERROR, status);
+  EXPECT_TRUE(records.empty());
+}
+
+TEST_F(CloudProviderImplTest, GetCommitsPage) {
+  std::string get_response_content =
+      "{\"id1V\":"
+      "{\"content\":\"xyzV\","
+      "\"id\":\"id1V\","
+      "\"timestamp\":43"
+      "}}";
+  get_response_ = std::make_unique<rapidjson::Document>();
+  get_response_->Parse(get_response_content.c_str(),
+                       get_response_content.size());
+
+  Status status;
+  std::vector<Record> records;
+  cloud_provider_->GetCommitsPage(
+      "", 10, callback::Capture([this] { message_loop_.PostQuitTask(); },
+                                &status, &records));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+  EXPECT_EQ(1u, records.size());
+
+  cloud_provider_->GetCommitsPage(
+      ServerTimestampToBytes(43), 10,
+      callback::Capture([this] { message_loop_.PostQuitTask(); }, &status,
+                        &records));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+  EXPECT_EQ(1u, records.size());
+
+  EXPECT_EQ(2u, get_queries_.size());
+  EXPECT_EQ("orderBy=\"timestamp\"&limitToFirst=10", get_queries_[0]);
+  EXPECT_EQ("orderBy=\"timestamp\"&startAt=43&limitToFirst=10",
+            get_queries_[1]);
+}
+
 TEST_F(CloudProviderImplTest, AddObject) {
   mx::vmo data;
   ASSERT_TRUE(mtl::VmoFromString("bazinga", &data));
@@ -421,8 +741,9 @@ TEST_F(CloudProviderImplTest, GetObject) {
   uint64_t size;
   mx::socket data;
   cloud_provider_->GetObject(
-      "object_id", callback::Capture([this] { message_loop_.PostQuitTask(); },
-                                     &status, &size, &data));
+      "object_id", ledger::RequestPriority::INTERACTIVE,
+      callback::Capture([this] { message_loop_.PostQuitTask(); }, &status,
+                        &size, &data));
   EXPECT_FALSE(RunLoopWithTimeout());
 
   EXPECT_EQ(Status::OK, status);
@@ -434,6 +755,7 @@ TEST_F(CloudProviderImplTest, GetObject) {
 
   EXPECT_EQ(1u, download_keys_.size());
   EXPECT_EQ("object_idV", download_keys_[0]);
+  EXPECT_EQ(ledger::RequestPriority::INTERACTIVE, download_priorities_[0]);
 }
 
 TEST_F(CloudProviderImplTest, GetObjectNotFound) {
@@ -444,8 +766,9 @@ TEST_F(CloudProviderImplTest, GetObjectNotFound) {
   uint64_t size;
   mx::socket data;
   cloud_provider_->GetObject(
-      "object_id", callback::Capture([this] { message_loop_.PostQuitTask(); },
-                                     &status, &size, &data));
+      "object_id", ledger::RequestPriority::INTERACTIVE,
+      callback::Capture([this] { message_loop_.PostQuitTask(); }, &status,
+                        &size, &data));
   EXPECT_FALSE(RunLoopWithTimeout());
 
   EXPECT_EQ(Status::NOT_FOUND, status);
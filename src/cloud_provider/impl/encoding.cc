@@ -22,43 +22,90 @@ const char kIdKey[] = "id";
 const char kContentKey[] = "content";
 const char kObjectsKey[] = "objects";
 const char kTimestampKey[] = "timestamp";
+const char kBatchPositionKey[] = "batch_position";
 
-}  // namespace
-
-bool EncodeCommit(const Commit& commit, std::string* output_json) {
-  rapidjson::StringBuffer string_buffer;
-  rapidjson::Writer<rapidjson::StringBuffer> writer(string_buffer);
+// Writes the JSON representation of |commit| using |writer|. If
+// |batch_position| is not negative, it is written as the position of the commit
+// in the batch of commits written together with it.
+void WriteCommit(const Commit& commit,
+                 int64_t batch_position,
+                 rapidjson::Writer<rapidjson::StringBuffer>* writer) {
+  writer->StartObject();
 
-  writer.StartObject();
-
-  writer.Key(kIdKey);
+  writer->Key(kIdKey);
   std::string id = firebase::EncodeValue(commit.id);
-  writer.String(id.c_str(), id.size());
+  writer->String(id.c_str(), id.size());
 
-  writer.Key(kContentKey);
+  writer->Key(kContentKey);
   std::string content = firebase::EncodeValue(commit.content);
-  writer.String(content.c_str(), content.size());
+  writer->String(content.c_str(), content.size());
 
   if (!commit.storage_objects.empty()) {
-    writer.Key(kObjectsKey);
-    writer.StartObject();
+    writer->Key(kObjectsKey);
+    writer->StartObject();
     for (const auto& entry : commit.storage_objects) {
       std::string key = firebase::EncodeKey(entry.first);
-      writer.Key(key.c_str(), key.size());
+      writer->Key(key.c_str(), key.size());
       std::string value = firebase::EncodeValue(entry.second);
-      writer.String(value.c_str(), value.size());
+      writer->String(value.c_str(), value.size());
     }
-    writer.EndObject();
+    writer->EndObject();
   }
 
-  writer.Key(kTimestampKey);
+  writer->Key(kTimestampKey);
   // Placeholder that Firebase will replace with server timestamp. See
   // https://firebase.google.com/docs/database/rest/save-data.
-  writer.StartObject();
-  writer.Key(".sv");
-  writer.String("timestamp");
-  writer.EndObject();
+  writer->StartObject();
+  writer->Key(".sv");
+  writer->String("timestamp");
+  writer->EndObject();
+
+  if (batch_position >= 0) {
+    writer->Key(kBatchPositionKey);
+    writer->Int64(batch_position);
+  }
+
+  writer->EndObject();
+}
+
+// Returns the position of the commit represented by |value| in the batch of
+// commits written together with it. Commits written alone have position 0.
+int64_t GetBatchPosition(const rapidjson::Value& value) {
+  if (value.HasMember(kBatchPositionKey) &&
+      value[kBatchPositionKey].IsInt64()) {
+    return value[kBatchPositionKey].GetInt64();
+  }
+  return 0;
+}
+
+}  // namespace
+
+bool EncodeCommit(const Commit& commit, std::string* output_json) {
+  rapidjson::StringBuffer string_buffer;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(string_buffer);
 
+  WriteCommit(commit, -1, &writer);
+
+  if (!writer.IsComplete()) {
+    return false;
+  }
+
+  std::string result = string_buffer.GetString();
+  output_json->swap(result);
+  return true;
+}
+
+bool EncodeCommits(const std::vector<Commit>& commits,
+                   std::string* output_json) {
+  rapidjson::StringBuffer string_buffer;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(string_buffer);
+
+  writer.StartObject();
+  for (size_t i = 0; i < commits.size(); ++i) {
+    std::string key = firebase::EncodeKey(commits[i].id);
+    writer.Key(key.c_str(), key.size());
+    WriteCommit(commits[i], i, &writer);
+  }
   writer.EndObject();
 
   if (!writer.IsComplete()) {
@@ -107,75 +154,117 @@ bool DecodeMultipleCommitsFromValue(const rapidjson::Value& value,
   FTL_DCHECK(output_records);
   FTL_DCHECK(value.IsObject());
 
-  std::vector<Record> records;
+  MultipleCommitsDecoder decoder;
   for (auto& it : value.GetObject()) {
-    std::string encoded_id = it.name.GetString();
-
-    if (!it.value.IsObject()) {
-      return false;
-    }
-
-    std::unique_ptr<Record> record;
-    if (!DecodeCommitFromValue(it.value, &record)) {
+    if (!decoder.AddCommitFromValue(it.value)) {
       return false;
     }
-    FTL_DCHECK(record);
-    records.push_back(std::move(*record));
   }
-
-  std::sort(records.begin(), records.end(),
-            [](const Record& lhs, const Record& rhs) {
-              return BytesToServerTimestamp(lhs.timestamp) <
-                     BytesToServerTimestamp(rhs.timestamp);
-            });
-
-  output_records->swap(records);
-  return true;
+  return decoder.GetRecords(output_records);
 }
 
-bool DecodeCommitFromValue(const rapidjson::Value& value,
-                           std::unique_ptr<Record>* output_record) {
-  FTL_DCHECK(output_record);
-  FTL_DCHECK(value.IsObject());
+MultipleCommitsDecoder::MultipleCommitsDecoder() {}
+
+MultipleCommitsDecoder::~MultipleCommitsDecoder() {}
 
-  CommitId commit_id;
-  if (!value.HasMember(kIdKey) || !value[kIdKey].IsString() ||
-      !firebase::Decode(value[kIdKey].GetString(), &commit_id)) {
+bool MultipleCommitsDecoder::AddCommitFromValue(const rapidjson::Value& value) {
+  if (errored_) {
     return false;
   }
 
-  Data commit_content;
-  if (!value.HasMember(kContentKey) || !value[kContentKey].IsString() ||
-      !firebase::Decode(value[kContentKey].GetString(), &commit_content)) {
+  if (!value.IsObject() || !value.HasMember(kIdKey) ||
+      !value[kIdKey].IsString() || !value.HasMember(kContentKey) ||
+      !value[kContentKey].IsString() || !value.HasMember(kTimestampKey) ||
+      !value[kTimestampKey].IsNumber()) {
+    errored_ = true;
     return false;
   }
 
-  std::map<ObjectId, Data> storage_objects;
+  EncodedCommit commit;
+  commit.id = value[kIdKey].GetString();
+  commit.content = value[kContentKey].GetString();
   if (value.HasMember(kObjectsKey)) {
+    if (!value[kObjectsKey].IsObject()) {
+      errored_ = true;
+      return false;
+    }
     for (auto& it : value[kObjectsKey].GetObject()) {
-      ObjectId storage_object_id;
-      if (!firebase::Decode(it.name.GetString(), &storage_object_id)) {
+      if (!it.value.IsString()) {
+        errored_ = true;
         return false;
       }
+      commit.storage_objects.emplace_back(it.name.GetString(),
+                                          it.value.GetString());
+    }
+  }
+  commit.timestamp = value[kTimestampKey].GetInt64();
+  commit.batch_position = GetBatchPosition(value);
+  commits_.push_back(std::move(commit));
+  return true;
+}
+
+bool MultipleCommitsDecoder::GetRecords(std::vector<Record>* output_records) {
+  FTL_DCHECK(output_records);
+  if (errored_) {
+    return false;
+  }
+
+  // Commits written in a single batch share the same server timestamp. They
+  // are ordered by their position in the batch.
+  std::sort(commits_.begin(), commits_.end(),
+            [](const EncodedCommit& lhs, const EncodedCommit& rhs) {
+              if (lhs.timestamp != rhs.timestamp) {
+                return lhs.timestamp < rhs.timestamp;
+              }
+              return lhs.batch_position < rhs.batch_position;
+            });
+
+  std::vector<Record> records;
+  records.reserve(commits_.size());
+  for (const auto& commit : commits_) {
+    CommitId commit_id;
+    Data commit_content;
+    if (!firebase::Decode(commit.id, &commit_id) ||
+        !firebase::Decode(commit.content, &commit_content)) {
+      errored_ = true;
+      return false;
+    }
 
+    std::map<ObjectId, Data> storage_objects;
+    for (const auto& storage_object : commit.storage_objects) {
+      ObjectId storage_object_id;
       Data storage_object_data;
-      if (!it.value.IsString() ||
-          !firebase::Decode(it.value.GetString(), &storage_object_data)) {
+      if (!firebase::Decode(storage_object.first, &storage_object_id) ||
+          !firebase::Decode(storage_object.second, &storage_object_data)) {
+        errored_ = true;
         return false;
       }
-      storage_objects[storage_object_id] = storage_object_data;
+      storage_objects[storage_object_id] = std::move(storage_object_data);
     }
+
+    records.emplace_back(
+        Commit(std::move(commit_id), std::move(commit_content),
+               std::move(storage_objects)),
+        ServerTimestampToBytes(commit.timestamp));
   }
+  commits_.clear();
+
+  output_records->swap(records);
+  return true;
+}
+
+bool DecodeCommitFromValue(const rapidjson::Value& value,
+                           std::unique_ptr<Record>* output_record) {
+  FTL_DCHECK(output_record);
+  FTL_DCHECK(value.IsObject());
 
-  if (!value.HasMember(kTimestampKey) || !value[kTimestampKey].IsNumber()) {
+  MultipleCommitsDecoder decoder;
+  std::vector<Record> records;
+  if (!decoder.AddCommitFromValue(value) || !decoder.GetRecords(&records)) {
     return false;
   }
-
-  auto record = std::make_unique<Record>(
-      Commit(std::move(commit_id), std::move(commit_content),
-             std::move(storage_objects)),
-      ServerTimestampToBytes(value[kTimestampKey].GetInt64()));
-  output_record->swap(record);
+  FTL_DCHECK(records.size() == 1u);
+  *output_record = std::make_unique<Record>(std::move(records.front()));
   return true;
 }
 
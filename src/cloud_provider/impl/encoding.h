@@ -6,10 +6,13 @@
 #define APPS_LEDGER_SRC_CLOUD_PROVIDER_IMPL_ENCODING_H_
 
 #include <memory>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include "apps/ledger/src/cloud_provider/public/commit.h"
 #include "apps/ledger/src/cloud_provider/public/record.h"
+#include "lib/ftl/macros.h"
 
 #include <rapidjson/document.h>
 
@@ -24,6 +27,15 @@ namespace cloud_provider {
 // server timestamp.
 bool EncodeCommit(const Commit& commit, std::string* output_json);
 
+// Encodes a batch of commits as a JSON object mapping the encoded id of each
+// commit to its representation, suitable for a multi-path update of the
+// commits in Firebase Realtime Database. All commits of the batch are tagged
+// with the same server timestamp, so each commit also records its position in
+// |commits|, which DecodeMultipleCommits() uses to preserve the order of the
+// batch.
+bool EncodeCommits(const std::vector<Commit>& commits,
+                   std::string* output_json);
+
 // Decodes a commit from the JSON representation in Firebase
 // Realtime Database. If successful, the method returns true, and
 // |output_record| contains the decoded commit, along with opaque
@@ -44,6 +56,43 @@ bool DecodeCommitFromValue(const rapidjson::Value& value,
 bool DecodeMultipleCommitsFromValue(const rapidjson::Value& value,
                                     std::vector<Record>* output_records);
 
+// Decodes multiple commits from the members of the JSON object holding them in
+// Firebase Realtime Database. The commits are extracted one at a time, as they
+// are received, and only their fields are retained. The fields are decoded at
+// the end by GetRecords(), which can run on any thread.
+class MultipleCommitsDecoder {
+ public:
+  MultipleCommitsDecoder();
+  ~MultipleCommitsDecoder();
+
+  // Extracts the commit represented by |value|, the value of a member of the
+  // object holding the commits. Returns false if |value| is not a valid
+  // commit, in which case the subsequent commits are ignored.
+  bool AddCommitFromValue(const rapidjson::Value& value);
+
+  // If all commits were successfully decoded, returns true, and
+  // |output_records| contain the decoded commits along with their timestamps,
+  // in the same order as returned by DecodeMultipleCommitsFromValue().
+  bool GetRecords(std::vector<Record>* output_records);
+
+ private:
+  // A commit whose fields are still encoded.
+  struct EncodedCommit {
+    std::string id;
+    std::string content;
+    std::vector<std::pair<std::string, std::string>> storage_objects;
+    int64_t timestamp;
+    // Position of the commit in the batch of commits written together with
+    // it.
+    int64_t batch_position;
+  };
+
+  std::vector<EncodedCommit> commits_;
+  bool errored_ = false;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(MultipleCommitsDecoder);
+};
+
 }  // namespace cloud_provider
 
 #endif  // APPS_LEDGER_SRC_CLOUD_PROVIDER_IMPL_ENCODING_H_
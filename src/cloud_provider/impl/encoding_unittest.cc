@@ -91,6 +91,53 @@ TEST(EncodingTest, DecodeMultiple) {
   EXPECT_EQ(ServerTimestampToBytes(1472722368296), records[1].timestamp);
 }
 
+TEST(EncodingTest, EncodeMultiple) {
+  std::vector<Commit> commits;
+  commits.emplace_back("id1", "content1", std::map<ObjectId, Data>{});
+  commits.emplace_back("id2", "content2", std::map<ObjectId, Data>{});
+
+  std::string encoded;
+  EXPECT_TRUE(EncodeCommits(commits, &encoded));
+  EXPECT_EQ(
+      "{\"id1V\":"
+      "{\"id\":\"id1V\","
+      "\"content\":\"content1V\","
+      "\"timestamp\":{\".sv\":\"timestamp\"},"
+      "\"batch_position\":0},"
+      "\"id2V\":"
+      "{\"id\":\"id2V\","
+      "\"content\":\"content2V\","
+      "\"timestamp\":{\".sv\":\"timestamp\"},"
+      "\"batch_position\":1}"
+      "}",
+      encoded);
+}
+
+// Verifies that commits written in a single batch, which share the same server
+// timestamp, are decoded in the order of the batch.
+TEST(EncodingTest, EncodeDecodeMultipleWithSameTimestamp) {
+  std::vector<Commit> commits;
+  for (const auto& id : {"c", "a", "d", "b"}) {
+    commits.emplace_back(id, "content", std::map<ObjectId, Data>{});
+  }
+
+  std::string encoded;
+  EXPECT_TRUE(EncodeCommits(commits, &encoded));
+  std::string pattern = "{\".sv\":\"timestamp\"}";
+  for (size_t pos = encoded.find(pattern); pos != std::string::npos;
+       pos = encoded.find(pattern)) {
+    encoded.replace(pos, pattern.size(), "42");
+  }
+
+  std::vector<Record> records;
+  EXPECT_TRUE(DecodeMultipleCommits(encoded, &records));
+  ASSERT_EQ(commits.size(), records.size());
+  for (size_t i = 0; i < commits.size(); ++i) {
+    EXPECT_EQ(commits[i], records[i].commit);
+    EXPECT_EQ(ServerTimestampToBytes(42), records[i].timestamp);
+  }
+}
+
 // Verifies that encoding and JSON parsing we use work with zero bytes within
 // strings.
 TEST(EncodingTest, EncodeDecodeZeroByte) {
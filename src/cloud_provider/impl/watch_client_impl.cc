@@ -8,8 +8,8 @@
 #include <rapidjson/stringbuffer.h>
 #include <rapidjson/writer.h>
 
-#include "apps/ledger/src/cloud_provider/impl/encoding.h"
 #include "apps/ledger/src/cloud_provider/impl/timestamp_conversions.h"
+#include "lib/ftl/functional/make_copyable.h"
 #include "lib/ftl/logging.h"
 #include "lib/ftl/time/time_delta.h"
 
@@ -18,8 +18,12 @@ namespace cloud_provider {
 WatchClientImpl::WatchClientImpl(firebase::Firebase* firebase,
                                  const std::string& firebase_key,
                                  const std::string& query,
-                                 CommitWatcher* commit_watcher)
-    : firebase_(firebase), commit_watcher_(commit_watcher) {
+                                 CommitWatcher* commit_watcher,
+                                 ftl::RefPtr<ftl::TaskRunner> main_runner,
+                                 ledger::WorkerPool* worker_pool)
+    : firebase_(firebase),
+      commit_watcher_(commit_watcher),
+      decoder_(worker_pool, std::move(main_runner)) {
   firebase_->Watch(firebase_key, query, this);
 }
 
@@ -48,16 +52,15 @@ void WatchClientImpl::OnPut(const std::string& path,
 
   if (path == "/") {
     // The initial put event contains multiple commits.
-    std::vector<Record> records;
-    if (!DecodeMultipleCommitsFromValue(value, &records)) {
-      HandleDecodingError(path, value,
-                          "failed to decode a collection of commits");
-      return;
-    }
-    for (auto& record : records) {
-      commit_watcher_->OnRemoteCommit(std::move(record.commit),
-                                      std::move(record.timestamp));
+    auto decoder = std::make_unique<MultipleCommitsDecoder>();
+    for (auto& it : value.GetObject()) {
+      if (!decoder->AddCommitFromValue(it.value)) {
+        HandleDecodingError(path, value,
+                            "failed to decode a collection of commits");
+        return;
+      }
     }
+    DecodeAndNotify(path, std::move(decoder));
     return;
   }
 
@@ -66,14 +69,74 @@ void WatchClientImpl::OnPut(const std::string& path,
     return;
   }
 
-  std::unique_ptr<Record> record;
-  if (!DecodeCommitFromValue(value, &record)) {
+  auto decoder = std::make_unique<MultipleCommitsDecoder>();
+  if (!decoder->AddCommitFromValue(value)) {
     HandleDecodingError(path, value, "failed to decode the commit");
     return;
   }
+  DecodeAndNotify(path, std::move(decoder));
+}
+
+void WatchClientImpl::OnPatch(const std::string& path,
+                              const rapidjson::Value& value) {
+  if (errored_) {
+    return;
+  }
+
+  // Patch events are generated by multi-path updates of the commit root, which
+  // add multiple commits at once.
+  if (path != "/") {
+    HandleDecodingError(path, value, "invalid path of a patch event");
+    return;
+  }
+
+  if (!value.IsObject()) {
+    HandleDecodingError(path, value, "received data is not a dictionary");
+    return;
+  }
+
+  auto decoder = std::make_unique<MultipleCommitsDecoder>();
+  for (auto& it : value.GetObject()) {
+    if (!decoder->AddCommitFromValue(it.value)) {
+      HandleDecodingError(path, value,
+                          "failed to decode a collection of commits");
+      return;
+    }
+  }
+  DecodeAndNotify(path, std::move(decoder));
+}
+
+bool WatchClientImpl::StreamsDataMembers(const std::string& event,
+                                         const std::string& path) {
+  // The events at the root carry a collection of commits.
+  if (errored_ || path != "/") {
+    return false;
+  }
+  streamed_commits_ = std::make_unique<MultipleCommitsDecoder>();
+  return true;
+}
+
+void WatchClientImpl::OnDataMember(const std::string& key,
+                                   const rapidjson::Value& value) {
+  if (errored_) {
+    return;
+  }
+
+  FTL_DCHECK(streamed_commits_);
+  if (!streamed_commits_->AddCommitFromValue(value)) {
+    HandleDecodingError("/" + key, value,
+                        "failed to decode a collection of commits");
+  }
+}
+
+void WatchClientImpl::OnDataEnd(const std::string& event,
+                                const std::string& path) {
+  if (errored_) {
+    return;
+  }
 
-  commit_watcher_->OnRemoteCommit(std::move(record->commit),
-                                  std::move(record->timestamp));
+  FTL_DCHECK(streamed_commits_);
+  DecodeAndNotify(path, std::move(streamed_commits_));
 }
 
 void WatchClientImpl::OnMalformedEvent() {
@@ -103,6 +166,34 @@ void WatchClientImpl::HandleDecodingError(const std::string& path,
   commit_watcher_->OnMalformedNotification();
 }
 
+void WatchClientImpl::DecodeAndNotify(
+    const std::string& path,
+    std::unique_ptr<MultipleCommitsDecoder> decoder) {
+  decoder_.PostTaskAndReply(
+      ftl::MakeCopyable([decoder = std::move(decoder)] {
+        std::vector<Record> records;
+        bool ok = decoder->GetRecords(&records);
+        return std::make_pair(ok, std::move(records));
+      }),
+      [ this, path ](std::pair<bool, std::vector<Record>> result) {
+        if (errored_) {
+          return;
+        }
+        if (!result.first) {
+          FTL_LOG(ERROR) << "Error processing received commits: "
+                         << "failed to decode the commits";
+          FTL_LOG(ERROR) << "Path: " << path;
+          HandleError();
+          commit_watcher_->OnMalformedNotification();
+          return;
+        }
+        for (auto& record : result.second) {
+          commit_watcher_->OnRemoteCommit(std::move(record.commit),
+                                          std::move(record.timestamp));
+        }
+      });
+}
+
 void WatchClientImpl::HandleError() {
   FTL_DCHECK(!errored_);
   errored_ = true;
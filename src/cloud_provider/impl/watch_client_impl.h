@@ -5,9 +5,18 @@
 #ifndef APPS_LEDGER_SRC_CLOUD_PROVIDER_IMPL_WATCH_CLIENT_IMPL_H_
 #define APPS_LEDGER_SRC_CLOUD_PROVIDER_IMPL_WATCH_CLIENT_IMPL_H_
 
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "apps/ledger/src/cloud_provider/impl/encoding.h"
 #include "apps/ledger/src/cloud_provider/public/commit_watcher.h"
+#include "apps/ledger/src/environment/ordered_worker_tasks.h"
+#include "apps/ledger/src/environment/worker_pool.h"
 #include "apps/ledger/src/firebase/firebase.h"
 #include "apps/ledger/src/firebase/watch_client.h"
+#include "lib/ftl/tasks/task_runner.h"
 
 #include <rapidjson/document.h>
 
@@ -15,16 +24,33 @@ namespace cloud_provider {
 
 // Relay between Firebase and a CommitWatcher corresponding to
 // particular WatchCommits() request.
+//
+// The events adding multiple commits, such as the initial put event holding
+// all the commits matching the query, are received one commit at a time, so
+// that the whole event is never held in memory.
+//
+// If |worker_pool| is not null, the received commits are decoded on it instead
+// of on the main thread, whose runner is |main_runner|. They are still
+// delivered to the watcher in the order in which they were received.
 class WatchClientImpl : public firebase::WatchClient {
  public:
   WatchClientImpl(firebase::Firebase* firebase,
                   const std::string& firebase_key,
                   const std::string& query,
-                  CommitWatcher* commit_watcher);
+                  CommitWatcher* commit_watcher,
+                  ftl::RefPtr<ftl::TaskRunner> main_runner = nullptr,
+                  ledger::WorkerPool* worker_pool = nullptr);
   ~WatchClientImpl() override;
 
   // firebase::WatchClient:
   void OnPut(const std::string& path, const rapidjson::Value& value) override;
+  void OnPatch(const std::string& path,
+               const rapidjson::Value& value) override;
+  bool StreamsDataMembers(const std::string& event,
+                          const std::string& path) override;
+  void OnDataMember(const std::string& key,
+                    const rapidjson::Value& value) override;
+  void OnDataEnd(const std::string& event, const std::string& path) override;
   void OnMalformedEvent() override;
   void OnConnectionError() override;
 
@@ -34,9 +60,17 @@ class WatchClientImpl : public firebase::WatchClient {
                            const char error_description[]);
   void HandleError();
 
+  // Decodes the commits extracted by |decoder| and delivers them to the
+  // watcher.
+  void DecodeAndNotify(const std::string& path,
+                       std::unique_ptr<MultipleCommitsDecoder> decoder);
+
   firebase::Firebase* const firebase_;
   CommitWatcher* const commit_watcher_;
   bool errored_ = false;
+  // Extracts the commits of the event whose data is being received.
+  std::unique_ptr<MultipleCommitsDecoder> streamed_commits_;
+  ledger::OrderedWorkerTasks<std::pair<bool, std::vector<Record>>> decoder_;
 };
 
 }  // namespace cloud_provider
@@ -13,6 +13,7 @@
 #include "apps/ledger/src/cloud_provider/public/commit_watcher.h"
 #include "apps/ledger/src/cloud_provider/public/record.h"
 #include "apps/ledger/src/cloud_provider/public/types.h"
+#include "apps/ledger/src/network/network_service.h"
 #include "lib/ftl/macros.h"
 #include "mx/socket.h"
 #include "mx/vmo.h"
@@ -38,6 +39,13 @@ class CloudProvider {
   virtual void AddCommit(const Commit& commit,
                          const std::function<void(Status)>& callback) = 0;
 
+  // Adds the given commits to the cloud in a single request. The commits must
+  // be ordered so that each commit comes after its parents: watchers and
+  // GetCommits() return them in the same order. The given callback will be
+  // called asynchronously with Status::OK if the operation have succeeded.
+  virtual void AddCommits(std::vector<Commit> commits,
+                          const std::function<void(Status)>& callback) = 0;
+
   // Registers the given watcher to be notified about commits already present
   // and these being added to the cloud later. This includes commits added by
   // the same CloudProvider instance through AddCommit().
@@ -68,6 +76,19 @@ class CloudProvider {
       const std::string& min_timestamp,
       std::function<void(Status, std::vector<Record>)> callback) = 0;
 
+  // Retrieves at most |max_count| commits not older than the given
+  // |min_timestamp|, starting with the oldest ones. Passing empty
+  // |min_timestamp| retrieves the oldest commits.
+  //
+  // This allows to retrieve a long list of commits in bounded pages: the next
+  // page can be retrieved by passing the timestamp of the last retrieved commit
+  // as |min_timestamp|. As |min_timestamp| is inclusive, the commits sharing
+  // this timestamp are retrieved again.
+  virtual void GetCommitsPage(
+      const std::string& min_timestamp,
+      size_t max_count,
+      std::function<void(Status, std::vector<Record>)> callback) = 0;
+
   // Uploads the given object to the cloud under the given id.
   virtual void AddObject(ObjectIdView object_id,
                          mx::vmo data,
@@ -75,9 +96,11 @@ class CloudProvider {
 
   // Retrieves the object of the given id from the cloud. The size of the object
   // is passed to the callback along with the socket handle, so that the client
-  // can verify that all data was streamed when draining the socket.
+  // can verify that all data was streamed when draining the socket. The
+  // download is scheduled with |priority| among the other network requests.
   virtual void GetObject(
       ObjectIdView object_id,
+      ledger::RequestPriority priority,
       std::function<void(Status status, uint64_t size, mx::socket data)>
           callback) = 0;
 
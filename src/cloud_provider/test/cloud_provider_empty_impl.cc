@@ -15,6 +15,12 @@ void CloudProviderEmptyImpl::AddCommit(
   FTL_NOTIMPLEMENTED();
 }
 
+void CloudProviderEmptyImpl::AddCommits(
+    std::vector<Commit> commits,
+    const std::function<void(Status)>& callback) {
+  FTL_NOTIMPLEMENTED();
+}
+
 void CloudProviderEmptyImpl::WatchCommits(const std::string& min_timestamp,
                                           CommitWatcher* watcher) {
   FTL_NOTIMPLEMENTED();
@@ -30,6 +36,13 @@ void CloudProviderEmptyImpl::GetCommits(
   FTL_NOTIMPLEMENTED();
 }
 
+void CloudProviderEmptyImpl::GetCommitsPage(
+    const std::string& min_timestamp,
+    size_t max_count,
+    std::function<void(Status, std::vector<Record>)> callback) {
+  FTL_NOTIMPLEMENTED();
+}
+
 void CloudProviderEmptyImpl::AddObject(ObjectIdView object_id,
                                        mx::vmo data,
                                        std::function<void(Status)> callback) {
@@ -38,6 +51,7 @@ void CloudProviderEmptyImpl::AddObject(ObjectIdView object_id,
 
 void CloudProviderEmptyImpl::GetObject(
     ObjectIdView object_id,
+    ledger::RequestPriority priority,
     std::function<void(Status status, uint64_t size, mx::socket data)>
         callback) {
   FTL_NOTIMPLEMENTED();
@@ -6,6 +6,11 @@
 
 #include <utility>
 
+#include "apps/ledger/src/callback/trace_flow.h"
+#include "apps/ledger/src/callback/waiter.h"
+#include "apps/tracing/lib/trace/event.h"
+#include "lib/mtl/socket/strings.h"
+
 namespace cloud_sync {
 
 BatchDownload::BatchDownload(storage::PageStorage* storage,
@@ -24,8 +29,38 @@ BatchDownload::~BatchDownload() {}
 void BatchDownload::Start() {
   FTL_DCHECK(!started_);
   started_ = true;
+
+  // Add the objects inlined in the commits first, so that storage doesn't need
+  // to fetch them when adding the commits.
+  auto waiter = callback::StatusWaiter<storage::Status>::Create(
+      storage::Status::OK);
+  for (auto& record : records_) {
+    for (auto& object : record.commit.storage_objects) {
+      size_t size = object.second.size();
+      storage_->AddObjectFromSync(
+          object.first, mtl::WriteStringToSocket(object.second), size,
+          waiter->NewCallback());
+    }
+    record.commit.storage_objects.clear();
+  }
+  waiter->Finalize([this](storage::Status status) {
+    if (status != storage::Status::OK) {
+      on_error_();
+      return;
+    }
+    AddCommits();
+  });
+}
+
+void BatchDownload::AddCommits() {
+  TRACE_DURATION("ledger", "batch_download_add_commits", "count",
+                 records_.size());
   std::vector<storage::PageStorage::CommitIdAndBytes> commits;
   for (auto& record : records_) {
+    // Commits received from the cloud start their flow here.
+    TRACE_FLOW_BEGIN("ledger", "commit",
+                     callback::TraceFlowId(record.commit.id), "commit_id",
+                     callback::TraceIdArg(record.commit.id));
     commits.push_back(storage::PageStorage::CommitIdAndBytes(
         std::move(record.commit.id), std::move(record.commit.content)));
   }
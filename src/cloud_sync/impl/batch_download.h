@@ -15,7 +15,8 @@ namespace cloud_sync {
 //
 // Given a list of commit metadata, this class makes a request to add them to
 // storage, and waits until storage confirms that the operation completed before
-// calling |on_done|.
+// calling |on_done|. The objects inlined in the commits are added to storage
+// before the commits.
 //
 // The operation is not retryable, and errors reported through |on_error| are
 // not recoverable.
@@ -31,6 +32,8 @@ class BatchDownload {
   void Start();
 
  private:
+  void AddCommits();
+
   storage::PageStorage* const storage_;
   std::vector<cloud_provider::Record> records_;
   ftl::Closure on_done_;
@@ -4,6 +4,7 @@
 
 #include "apps/ledger/src/cloud_sync/impl/batch_download.h"
 
+#include <map>
 #include <unordered_map>
 
 #include "apps/ledger/src/storage/test/page_storage_empty_impl.h"
@@ -11,6 +12,7 @@
 #include "gtest/gtest.h"
 #include "lib/ftl/functional/make_copyable.h"
 #include "lib/ftl/macros.h"
+#include "lib/mtl/socket/strings.h"
 #include "lib/mtl/tasks/message_loop.h"
 
 namespace cloud_sync {
@@ -43,6 +45,21 @@ class TestPageStorage : public storage::test::PageStorageEmptyImpl {
         }));
   }
 
+  void AddObjectFromSync(
+      storage::ObjectIdView object_id,
+      mx::socket data,
+      size_t size,
+      const std::function<void(storage::Status)>& callback) override {
+    std::string content;
+    EXPECT_TRUE(mtl::BlockingCopyToString(std::move(data), &content));
+    EXPECT_EQ(size, content.size());
+    // Objects must be added before the commits referencing them.
+    EXPECT_TRUE(received_commits.empty());
+    received_objects[object_id.ToString()] = std::move(content);
+    message_loop_->task_runner()->PostTask(
+        [callback]() { callback(storage::Status::OK); });
+  }
+
   storage::Status SetSyncMetadata(ftl::StringView sync_state) override {
     sync_metadata = sync_state.ToString();
     return storage::Status::OK;
@@ -50,6 +67,7 @@ class TestPageStorage : public storage::test::PageStorageEmptyImpl {
 
   bool should_fail_add_commit_from_sync = false;
   std::unordered_map<storage::CommitId, std::string> received_commits;
+  std::unordered_map<storage::ObjectId, std::string> received_objects;
   std::string sync_metadata;
 
  private:
@@ -112,6 +130,34 @@ TEST_F(BatchDownloadTest, AddMultipleCommits) {
   EXPECT_EQ("43", storage_.sync_metadata);
 }
 
+TEST_F(BatchDownloadTest, AddCommitWithInlinedObjects) {
+  int done_calls = 0;
+  int error_calls = 0;
+  std::vector<cloud_provider::Record> records;
+  records.emplace_back(
+      cloud_provider::Commit(
+          "id1", "content1",
+          std::map<cloud_provider::ObjectId, cloud_provider::Data>{
+              {"object_a", "data_a"}, {"object_b", "data_b"}}),
+      "42");
+  BatchDownload batch_download(&storage_, std::move(records),
+                               [this, &done_calls] {
+                                 done_calls++;
+                                 message_loop_.PostQuitTask();
+                               },
+                               [&error_calls] { error_calls++; });
+  batch_download.Start();
+
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(1, done_calls);
+  EXPECT_EQ(0, error_calls);
+  EXPECT_EQ(2u, storage_.received_objects.size());
+  EXPECT_EQ("data_a", storage_.received_objects["object_a"]);
+  EXPECT_EQ("data_b", storage_.received_objects["object_b"]);
+  EXPECT_EQ(1u, storage_.received_commits.size());
+  EXPECT_EQ("content1", storage_.received_commits["id1"]);
+}
+
 TEST_F(BatchDownloadTest, FailToAddCommit) {
   int done_calls = 0;
   int error_calls = 0;
@@ -4,25 +4,45 @@
 
 #include "apps/ledger/src/cloud_sync/impl/commit_upload.h"
 
+#include <set>
+
+#include "apps/ledger/src/callback/trace_flow.h"
+#include "apps/ledger/src/callback/waiter.h"
 #include "apps/ledger/src/cloud_provider/public/commit.h"
 #include "apps/ledger/src/cloud_provider/public/types.h"
+#include "apps/tracing/lib/trace/event.h"
 #include "lib/ftl/logging.h"
-#include "lib/mtl/vmo/strings.h"
 
 namespace cloud_sync {
 
-CommitUpload::CommitUpload(storage::PageStorage* storage,
-                           cloud_provider::CloudProvider* cloud_provider,
-                           std::unique_ptr<const storage::Commit> commit,
-                           ftl::Closure on_done,
-                           ftl::Closure on_error)
+namespace {
+
+// Objects not bigger than this are inlined in the commits instead of being
+// uploaded separately.
+constexpr size_t kMaxInlinedObjectSize = 4 * 1024;
+
+// Maximum total size of the objects inlined in a single commit.
+constexpr size_t kMaxInlinedBytesPerCommit = 64 * 1024;
+
+}  // namespace
+
+CommitUpload::CommitUpload(
+    storage::PageStorage* storage,
+    cloud_provider::CloudProvider* cloud_provider,
+    ObjectUploadQueue* object_upload_queue,
+    std::vector<std::unique_ptr<const storage::Commit>> commits,
+    ftl::Closure on_done,
+    ftl::Closure on_error)
     : storage_(storage),
       cloud_provider_(cloud_provider),
-      commit_(std::move(commit)),
+      object_upload_queue_(object_upload_queue),
+      commits_(std::move(commits)),
       on_done_(on_done),
       on_error_(on_error) {
   FTL_DCHECK(storage);
   FTL_DCHECK(cloud_provider);
+  FTL_DCHECK(object_upload_queue);
+  FTL_DCHECK(!commits_.empty());
 }
 
 CommitUpload::~CommitUpload() {}
@@ -31,48 +51,105 @@ void CommitUpload::Start() {
   FTL_DCHECK(!active_or_finished_);
   current_attempt_++;
   active_or_finished_ = true;
+  objects_uploaded_ = false;
+
+  auto waiter = callback::Waiter<storage::Status,
+                                 std::vector<storage::ObjectId>>::Create(
+      storage::Status::OK);
+  for (const auto& commit : commits_) {
+    storage_->GetUnsyncedObjectIds(commit->GetId(), waiter->NewCallback());
+  }
+  waiter->Finalize([this](
+      storage::Status status,
+      std::vector<std::vector<storage::ObjectId>> object_ids_per_commit) {
+    FTL_DCHECK(status == storage::Status::OK);
+    GetObjects(std::move(object_ids_per_commit));
+  });
+}
+
+void CommitUpload::HoldCommits() {
+  commits_held_ = true;
+}
+
+void CommitUpload::ReleaseCommits() {
+  if (!commits_held_) {
+    return;
+  }
+  commits_held_ = false;
+  if (active_or_finished_) {
+    UploadCommitsIfReady();
+  }
+}
+
+void CommitUpload::GetObjects(
+    std::vector<std::vector<storage::ObjectId>> object_ids_per_commit) {
+  // Commits of the batch usually share objects: each object is attributed to
+  // the first commit referencing it.
+  std::set<storage::ObjectId> seen_ids;
+  std::vector<size_t> commit_indexes;
+  auto waiter = callback::Waiter<storage::Status,
+                                 std::unique_ptr<const storage::Object>>::
+      Create(storage::Status::OK);
+  for (size_t i = 0; i < object_ids_per_commit.size(); ++i) {
+    for (const auto& id : object_ids_per_commit[i]) {
+      if (seen_ids.insert(id).second) {
+        commit_indexes.push_back(i);
+        storage_->GetObject(id, storage::PageStorage::Location::LOCAL,
+                            waiter->NewCallback());
+      }
+    }
+  }
+  waiter->Finalize([ this, commit_indexes = std::move(commit_indexes) ](
+      storage::Status status,
+      std::vector<std::unique_ptr<const storage::Object>> objects) {
+    FTL_DCHECK(status == storage::Status::OK);
+    FTL_DCHECK(objects.size() == commit_indexes.size());
 
-  storage_->GetUnsyncedObjectIds(
-      commit_->GetId(), [this](storage::Status status,
-                               std::vector<storage::ObjectId> object_ids) {
-        FTL_DCHECK(status == storage::Status::OK);
-
-        // If there are no unsynced objects referenced by the commit, upload the
-        // commit directly.
-        if (object_ids.empty()) {
-          UploadCommit();
-          return;
-        }
-
-        // Upload all unsynced objects referenced by the commit. The last upload
-        // that succeeds triggers uploading the commit.
-        objects_to_upload_ = object_ids.size();
-        for (const auto& id : object_ids) {
-          storage_->GetObject(
-              id, storage::PageStorage::Location::LOCAL,
-              [this](storage::Status storage_status,
-                     std::unique_ptr<const storage::Object> object) {
-                FTL_DCHECK(storage_status == storage::Status::OK);
-                UploadObject(std::move(object));
-              });
-        }
-      });
+    // Inline the small objects in the commit they are attributed to, and
+    // upload the others separately.
+    inlined_objects_.clear();
+    inlined_objects_.resize(commits_.size());
+    std::vector<size_t> inlined_bytes(commits_.size(), 0);
+    std::vector<storage::ObjectId> object_ids;
+    for (size_t i = 0; i < objects.size(); ++i) {
+      ftl::StringView data;
+      status = objects[i]->GetData(&data);
+      FTL_DCHECK(status == storage::Status::OK);
+
+      size_t commit_index = commit_indexes[i];
+      if (data.size() <= kMaxInlinedObjectSize &&
+          inlined_bytes[commit_index] + data.size() <=
+              kMaxInlinedBytesPerCommit) {
+        inlined_bytes[commit_index] += data.size();
+        inlined_objects_[commit_index][objects[i]->GetId()] = data.ToString();
+        continue;
+      }
+      object_ids.push_back(objects[i]->GetId());
+    }
+    UploadObjects(std::move(object_ids));
+  });
 }
 
-void CommitUpload::UploadObject(std::unique_ptr<const storage::Object> object) {
-  ftl::StringView data_view;
-  auto status = object->GetData(&data_view);
-  FTL_DCHECK(status == storage::Status::OK);
+void CommitUpload::UploadObjects(std::vector<storage::ObjectId> object_ids) {
+  // If there are no unsynced objects referenced by the commits, upload the
+  // commits directly.
+  if (object_ids.empty()) {
+    objects_uploaded_ = true;
+    UploadCommitsIfReady();
+    return;
+  }
 
-  // TODO(ppi): get the virtual memory object directly from storage::Object,
-  // once it can give us one.
-  mx::vmo data;
-  auto result = mtl::VmoFromString(data_view, &data);
-  FTL_DCHECK(result);
+  // Upload all unsynced objects referenced by the commits. The last upload
+  // that succeeds triggers uploading the commits.
+  objects_to_upload_ = object_ids.size();
+  for (const auto& id : object_ids) {
+    UploadObject(id);
+  }
+}
 
-  storage::ObjectId id = object->GetId();
-  cloud_provider_->AddObject(object->GetId(), std::move(data), [
-    this, id = std::move(id), upload_attempt = current_attempt_
+void CommitUpload::UploadObject(storage::ObjectIdView object_id) {
+  object_upload_queue_->UploadObject(object_id, [
+    this, id = object_id.ToString(), upload_attempt = current_attempt_
   ](cloud_provider::Status status) {
     if (upload_attempt != current_attempt_) {
       // Object upload was completed for a previous .Start() call. If it
@@ -94,20 +171,41 @@ void CommitUpload::UploadObject(std::unique_ptr<const storage::Object> object) {
     storage_->MarkObjectSynced(id);
     objects_to_upload_--;
     if (objects_to_upload_ == 0) {
-      // All the referenced objects are uploaded, upload the commit.
-      UploadCommit();
+      // All the referenced objects are uploaded, upload the commits.
+      objects_uploaded_ = true;
+      UploadCommitsIfReady();
     }
   });
 }
 
-void CommitUpload::UploadCommit() {
-  cloud_provider::Commit commit(
-      commit_->GetId(), commit_->GetStorageBytes().ToString(),
-      std::map<cloud_provider::ObjectId, cloud_provider::Data>{});
-  storage::CommitId commit_id = commit_->GetId();
-  cloud_provider_->AddCommit(commit, [ this, commit_id = std::move(commit_id) ](
-                                         cloud_provider::Status status) {
-    // UploadCommit() is called as a last step of a so-far-successful upload
+void CommitUpload::UploadCommitsIfReady() {
+  if (objects_uploaded_ && !commits_held_) {
+    UploadCommits();
+  }
+}
+
+void CommitUpload::UploadCommits() {
+  TRACE_DURATION("ledger", "commit_upload_commits", "count", commits_.size());
+  std::vector<cloud_provider::Commit> commits;
+  std::vector<storage::CommitId> commit_ids;
+  std::vector<storage::ObjectId> inlined_object_ids;
+  FTL_DCHECK(inlined_objects_.size() == commits_.size());
+  for (size_t i = 0; i < commits_.size(); ++i) {
+    for (const auto& object : inlined_objects_[i]) {
+      inlined_object_ids.push_back(object.first);
+    }
+    commits.emplace_back(commits_[i]->GetId(),
+                         commits_[i]->GetStorageBytes().ToString(),
+                         inlined_objects_[i]);
+    commit_ids.push_back(commits_[i]->GetId());
+    TRACE_FLOW_STEP("ledger", "commit",
+                    callback::TraceFlowId(commits_[i]->GetId()));
+  }
+  cloud_provider_->AddCommits(std::move(commits), [
+    this, commit_ids = std::move(commit_ids),
+    inlined_object_ids = std::move(inlined_object_ids)
+  ](cloud_provider::Status status) {
+    // UploadCommits() is called as a last step of a so-far-successful upload
     // attempt, so we couldn't have failed before.
     FTL_DCHECK(active_or_finished_);
     if (status != cloud_provider::Status::OK) {
@@ -115,7 +213,16 @@ void CommitUpload::UploadCommit() {
       on_error_();
       return;
     }
-    storage_->MarkCommitSynced(commit_id);
+    // The inlined objects are uploaded along with the commits.
+    for (const auto& object_id : inlined_object_ids) {
+      storage_->MarkObjectSynced(object_id);
+    }
+    TRACE_DURATION("ledger", "commit_upload_done");
+    for (const auto& commit_id : commit_ids) {
+      TRACE_FLOW_END("ledger", "commit", callback::TraceFlowId(commit_id),
+                     "commit_id", callback::TraceIdArg(commit_id));
+      storage_->MarkCommitSynced(commit_id);
+    }
     on_done_();
   });
 }
@@ -6,9 +6,12 @@
 #define APPS_LEDGER_SRC_CLOUD_SYNC_IMPL_COMMIT_UPLOAD_H_
 
 #include <functional>
+#include <map>
 #include <memory>
+#include <vector>
 
 #include "apps/ledger/src/cloud_provider/public/cloud_provider.h"
+#include "apps/ledger/src/cloud_sync/impl/object_upload_queue.h"
 #include "apps/ledger/src/storage/public/commit.h"
 #include "apps/ledger/src/storage/public/page_storage.h"
 #include "lib/ftl/functional/closure.h"
@@ -16,13 +19,20 @@
 
 namespace cloud_sync {
 
-// Uploads a single commit along with the storage objects referenced by it
+// Uploads a batch of commits along with the storage objects referenced by them
 // through the cloud provider and marks the uploaded artifacts as synced.
 //
-// Contract: Unsynced objects referenced by the commit are marked as synced as
-// they are uploaded. The commit itself is uploaded only once all objects are
-// uploaded. The entire commit is marked as synced once all objects are uploaded
-// and the commit itself is uploaded.
+// Contract: Unsynced objects referenced by the commits are marked as synced as
+// they are uploaded. The commits themselves are uploaded only once all objects
+// are uploaded, in a single request. Small objects are not uploaded
+// separately, but inlined in the first commit of the batch referencing them,
+// and are marked as synced along with the commits. The commits are marked as
+// synced once all objects are uploaded and the commits themselves are
+// uploaded.
+//
+// The upload of the commits themselves can be held back with HoldCommits(), so
+// that the objects of several batches can be uploaded concurrently while the
+// commits themselves are uploaded in order.
 //
 // Usage: call Start() to kick off the upload. |on_done| is called after upload
 // is successfully completed. |on_error| will be called at most once after each
@@ -30,14 +40,16 @@ namespace cloud_sync {
 // call Start() again to retry the upload.
 //
 // Lifetime: if CommitUpload is deleted between Start() and |on_done| being
-// called, it has to be deleted along with |storage| and |cloud_provider|, which
-// otherwise can retain callbacks for pending uploads. This isn't a problem as
-// long as the lifetime of page storage and page sync is managed together.
+// called, it has to be deleted along with |storage|, |cloud_provider| and
+// |object_upload_queue|, which otherwise can retain callbacks for pending
+// uploads. This isn't a problem as long as the lifetime of page storage and
+// page sync is managed together.
 class CommitUpload {
  public:
   CommitUpload(storage::PageStorage* storage,
                cloud_provider::CloudProvider* cloud_provider,
-               std::unique_ptr<const storage::Commit> commit,
+               ObjectUploadQueue* object_upload_queue,
+               std::vector<std::unique_ptr<const storage::Commit>> commits,
                ftl::Closure on_done,
                ftl::Closure on_error);
   ~CommitUpload();
@@ -47,16 +59,37 @@ class CommitUpload {
   // called the client can retry by calling Start() again.
   void Start();
 
+  // Prevents the commits from being uploaded until ReleaseCommits() is called.
+  // The objects referenced by the commits are still uploaded by Start().
+  void HoldCommits();
+
+  // Allows the commits to be uploaded, right away if all their objects are
+  // already uploaded in the current upload attempt.
+  void ReleaseCommits();
+
  private:
-  // Uploads the given object.
-  void UploadObject(std::unique_ptr<const storage::Object> object);
+  // Uploads the object with the given id.
+  void UploadObject(storage::ObjectIdView object_id);
+
+  // Retrieves the given objects from storage, inlines the small ones in the
+  // commits and uploads the others.
+  void GetObjects(
+      std::vector<std::vector<storage::ObjectId>> object_ids_per_commit);
+
+  // Uploads the given objects.
+  void UploadObjects(std::vector<storage::ObjectId> object_ids);
+
+  // Uploads the commits if all objects are uploaded and the commits are not
+  // held.
+  void UploadCommitsIfReady();
 
-  // Uploads the commit.
-  void UploadCommit();
+  // Uploads the commits.
+  void UploadCommits();
 
   storage::PageStorage* storage_;
   cloud_provider::CloudProvider* cloud_provider_;
-  std::unique_ptr<const storage::Commit> commit_;
+  ObjectUploadQueue* object_upload_queue_;
+  std::vector<std::unique_ptr<const storage::Commit>> commits_;
   ftl::Closure on_done_;
   ftl::Closure on_error_;
   // Incremented on every upload attempt / Start() call. Tracked to detect stale
@@ -71,6 +104,13 @@ class CommitUpload {
   // Count of the remaining objects to be uploaded in the current upload
   // attempt.
   int objects_to_upload_ = 0;
+  // True iff all the objects of the current upload attempt are uploaded.
+  bool objects_uploaded_ = false;
+  // Objects inlined in each commit in the current upload attempt.
+  std::vector<std::map<cloud_provider::ObjectId, cloud_provider::Data>>
+      inlined_objects_;
+  // True iff the upload of the commits is held back by HoldCommits().
+  bool commits_held_ = false;
 
   FTL_DISALLOW_COPY_AND_ASSIGN(CommitUpload);
 };
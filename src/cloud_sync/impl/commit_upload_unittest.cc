@@ -5,8 +5,10 @@
 #include "apps/ledger/src/cloud_sync/impl/commit_upload.h"
 
 #include <functional>
+#include <iterator>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "apps/ledger/src/cloud_provider/public/cloud_provider.h"
 #include "apps/ledger/src/cloud_provider/test/cloud_provider_empty_impl.h"
@@ -18,6 +20,7 @@
 #include "gtest/gtest.h"
 #include "lib/ftl/macros.h"
 #include "lib/ftl/strings/string_view.h"
+#include "lib/ftl/time/time_delta.h"
 #include "lib/mtl/tasks/message_loop.h"
 #include "lib/mtl/vmo/strings.h"
 
@@ -82,8 +85,9 @@ class TestPageStorage : public storage::test::PageStorageEmptyImpl {
       const std::function<void(storage::Status,
                                std::unique_ptr<const storage::Object>)>&
           callback) override {
+    const auto& object = unsynced_objects_to_return[object_id.ToString()];
     callback(storage::Status::OK,
-             std::move(unsynced_objects_to_return[object_id.ToString()]));
+             std::make_unique<TestObject>(object->id, object->data));
   }
 
   storage::Status MarkObjectSynced(storage::ObjectIdView object_id) override {
@@ -113,10 +117,12 @@ class TestCloudProvider : public cloud_provider::test::CloudProviderEmptyImpl {
 
   ~TestCloudProvider() override = default;
 
-  void AddCommit(
-      const cloud_provider::Commit& commit,
+  void AddCommits(
+      std::vector<cloud_provider::Commit> commits,
       const std::function<void(cloud_provider::Status)>& callback) override {
-    received_commits.push_back(commit.Clone());
+    add_commits_calls++;
+    std::move(commits.begin(), commits.end(),
+              std::back_inserter(received_commits));
     message_loop_->task_runner()->PostTask(
         [this, callback]() { callback(commit_status_to_return); });
   }
@@ -135,6 +141,7 @@ class TestCloudProvider : public cloud_provider::test::CloudProviderEmptyImpl {
 
   cloud_provider::Status object_status_to_return = cloud_provider::Status::OK;
   cloud_provider::Status commit_status_to_return = cloud_provider::Status::OK;
+  unsigned int add_commits_calls = 0u;
   std::vector<cloud_provider::Commit> received_commits;
   std::map<cloud_provider::ObjectId, std::string> received_objects;
 
@@ -142,15 +149,31 @@ class TestCloudProvider : public cloud_provider::test::CloudProviderEmptyImpl {
   mtl::MessageLoop* message_loop_;
 };
 
+// Returns data starting with |prefix|, too big to be inlined in a commit.
+std::string LargeData(std::string prefix) {
+  prefix.resize(8 * 1024, '.');
+  return prefix;
+}
+
+std::vector<std::unique_ptr<const storage::Commit>> MakeCommitList(
+    std::unique_ptr<const storage::Commit> commit) {
+  std::vector<std::unique_ptr<const storage::Commit>> commits;
+  commits.push_back(std::move(commit));
+  return commits;
+}
+
 class CommitUploadTest : public ::testing::Test {
  public:
-  CommitUploadTest() : cloud_provider_(&message_loop_) {}
+  CommitUploadTest()
+      : cloud_provider_(&message_loop_),
+        object_upload_queue_(&storage_, &cloud_provider_, 10) {}
   ~CommitUploadTest() override {}
 
  protected:
   mtl::MessageLoop message_loop_;
   TestPageStorage storage_;
   TestCloudProvider cloud_provider_;
+  ObjectUploadQueue object_upload_queue_;
 
  private:
   FTL_DISALLOW_COPY_AND_ASSIGN(CommitUploadTest);
@@ -164,15 +187,17 @@ TEST_F(CommitUploadTest, NoObjects) {
 
   auto done_calls = 0u;
   auto error_calls = 0u;
-  CommitUpload commit_upload(&storage_, &cloud_provider_, std::move(commit),
-                             [this, &done_calls] {
-                               done_calls++;
-                               message_loop_.PostQuitTask();
-                             },
-                             [this, &error_calls] {
-                               error_calls++;
-                               message_loop_.PostQuitTask();
-                             });
+  CommitUpload commit_upload(
+      &storage_, &cloud_provider_, &object_upload_queue_,
+      MakeCommitList(std::move(commit)),
+      [this, &done_calls] {
+        done_calls++;
+        message_loop_.PostQuitTask();
+      },
+      [this, &error_calls] {
+        error_calls++;
+        message_loop_.PostQuitTask();
+      });
 
   commit_upload.Start();
   message_loop_.Run();
@@ -198,21 +223,23 @@ TEST_F(CommitUploadTest, WithObjects) {
   commit->storage_bytes = "content";
 
   storage_.unsynced_objects_to_return["obj_id1"] =
-      std::make_unique<TestObject>("obj_id1", "obj_data1");
+      std::make_unique<TestObject>("obj_id1", LargeData("obj_data1"));
   storage_.unsynced_objects_to_return["obj_id2"] =
-      std::make_unique<TestObject>("obj_id2", "obj_data2");
+      std::make_unique<TestObject>("obj_id2", LargeData("obj_data2"));
 
   auto done_calls = 0u;
   auto error_calls = 0u;
-  CommitUpload commit_upload(&storage_, &cloud_provider_, std::move(commit),
-                             [this, &done_calls] {
-                               done_calls++;
-                               message_loop_.PostQuitTask();
-                             },
-                             [this, &error_calls] {
-                               error_calls++;
-                               message_loop_.PostQuitTask();
-                             });
+  CommitUpload commit_upload(
+      &storage_, &cloud_provider_, &object_upload_queue_,
+      MakeCommitList(std::move(commit)),
+      [this, &done_calls] {
+        done_calls++;
+        message_loop_.PostQuitTask();
+      },
+      [this, &error_calls] {
+        error_calls++;
+        message_loop_.PostQuitTask();
+      });
 
   commit_upload.Start();
   message_loop_.Run();
@@ -224,8 +251,10 @@ TEST_F(CommitUploadTest, WithObjects) {
   EXPECT_EQ("id", cloud_provider_.received_commits.front().id);
   EXPECT_EQ("content", cloud_provider_.received_commits.front().content);
   EXPECT_EQ(2u, cloud_provider_.received_objects.size());
-  EXPECT_EQ("obj_data1", cloud_provider_.received_objects["obj_id1"]);
-  EXPECT_EQ("obj_data2", cloud_provider_.received_objects["obj_id2"]);
+  EXPECT_EQ(LargeData("obj_data1"),
+            cloud_provider_.received_objects["obj_id1"]);
+  EXPECT_EQ(LargeData("obj_data2"),
+            cloud_provider_.received_objects["obj_id2"]);
 
   // Verify the sync status in storage.
   EXPECT_EQ(1u, storage_.commits_marked_as_synced.size());
@@ -235,6 +264,101 @@ TEST_F(CommitUploadTest, WithObjects) {
   EXPECT_EQ(1u, storage_.objects_marked_as_synced.count("obj_id2"));
 }
 
+// Test an upload of several commits referencing the same unsynced objects.
+TEST_F(CommitUploadTest, MultipleCommits) {
+  std::vector<std::unique_ptr<const storage::Commit>> commits;
+  for (const auto& id : {"id1", "id2"}) {
+    auto commit = std::make_unique<TestCommit>();
+    commit->id = id;
+    commit->storage_bytes = std::string("content_") + id;
+    commits.push_back(std::move(commit));
+  }
+
+  storage_.unsynced_objects_to_return["obj_id1"] =
+      std::make_unique<TestObject>("obj_id1", LargeData("obj_data1"));
+
+  auto done_calls = 0u;
+  auto error_calls = 0u;
+  CommitUpload commit_upload(
+      &storage_, &cloud_provider_, &object_upload_queue_, std::move(commits),
+      [this, &done_calls] {
+        done_calls++;
+        message_loop_.PostQuitTask();
+      },
+      [this, &error_calls] {
+        error_calls++;
+        message_loop_.PostQuitTask();
+      });
+
+  commit_upload.Start();
+  message_loop_.Run();
+  EXPECT_EQ(1u, done_calls);
+  EXPECT_EQ(0u, error_calls);
+
+  // Verify that the commits were uploaded in order in a single request, and
+  // that the shared object was uploaded once.
+  EXPECT_EQ(1u, cloud_provider_.add_commits_calls);
+  ASSERT_EQ(2u, cloud_provider_.received_commits.size());
+  EXPECT_EQ("id1", cloud_provider_.received_commits[0].id);
+  EXPECT_EQ("content_id1", cloud_provider_.received_commits[0].content);
+  EXPECT_EQ("id2", cloud_provider_.received_commits[1].id);
+  EXPECT_EQ("content_id2", cloud_provider_.received_commits[1].content);
+  EXPECT_EQ(1u, cloud_provider_.received_objects.size());
+  EXPECT_EQ(LargeData("obj_data1"),
+            cloud_provider_.received_objects["obj_id1"]);
+
+  // Verify the sync status in storage.
+  EXPECT_EQ(2u, storage_.commits_marked_as_synced.size());
+  EXPECT_EQ(1u, storage_.objects_marked_as_synced.count("obj_id1"));
+}
+
+// Test an upload of a commit with small objects, which are inlined in the
+// commit.
+TEST_F(CommitUploadTest, InlinedObjects) {
+  auto commit = std::make_unique<TestCommit>();
+  commit->id = "id";
+  commit->storage_bytes = "content";
+
+  storage_.unsynced_objects_to_return["obj_id1"] =
+      std::make_unique<TestObject>("obj_id1", "obj_data1");
+  storage_.unsynced_objects_to_return["obj_id2"] =
+      std::make_unique<TestObject>("obj_id2", LargeData("obj_data2"));
+
+  auto done_calls = 0u;
+  auto error_calls = 0u;
+  CommitUpload commit_upload(
+      &storage_, &cloud_provider_, &object_upload_queue_,
+      MakeCommitList(std::move(commit)),
+      [this, &done_calls] {
+        done_calls++;
+        message_loop_.PostQuitTask();
+      },
+      [this, &error_calls] {
+        error_calls++;
+        message_loop_.PostQuitTask();
+      });
+
+  commit_upload.Start();
+  message_loop_.Run();
+  EXPECT_EQ(1u, done_calls);
+  EXPECT_EQ(0u, error_calls);
+
+  // Verify that only the large object was uploaded separately, and that the
+  // small one was uploaded with the commit.
+  EXPECT_EQ(1u, cloud_provider_.received_objects.size());
+  EXPECT_EQ(LargeData("obj_data2"),
+            cloud_provider_.received_objects["obj_id2"]);
+  ASSERT_EQ(1u, cloud_provider_.received_commits.size());
+  const auto& storage_objects =
+      cloud_provider_.received_commits.front().storage_objects;
+  EXPECT_EQ(1u, storage_objects.size());
+  EXPECT_EQ("obj_data1", storage_objects.at("obj_id1"));
+
+  // Verify the sync status in storage.
+  EXPECT_EQ(1u, storage_.commits_marked_as_synced.count("id"));
+  EXPECT_EQ(2u, storage_.objects_marked_as_synced.size());
+}
+
 // Test un upload that fails on uploading objects.
 TEST_F(CommitUploadTest, FailedObjectUpload) {
   auto commit = std::make_unique<TestCommit>();
@@ -242,21 +366,23 @@ TEST_F(CommitUploadTest, FailedObjectUpload) {
   commit->storage_bytes = "content";
 
   storage_.unsynced_objects_to_return["obj_id1"] =
-      std::make_unique<TestObject>("obj_id1", "obj_data1");
+      std::make_unique<TestObject>("obj_id1", LargeData("obj_data1"));
   storage_.unsynced_objects_to_return["obj_id2"] =
-      std::make_unique<TestObject>("obj_id2", "obj_data2");
+      std::make_unique<TestObject>("obj_id2", LargeData("obj_data2"));
 
   auto done_calls = 0u;
   auto error_calls = 0u;
-  CommitUpload commit_upload(&storage_, &cloud_provider_, std::move(commit),
-                             [this, &done_calls] {
-                               done_calls++;
-                               message_loop_.PostQuitTask();
-                             },
-                             [this, &error_calls] {
-                               error_calls++;
-                               message_loop_.PostQuitTask();
-                             });
+  CommitUpload commit_upload(
+      &storage_, &cloud_provider_, &object_upload_queue_,
+      MakeCommitList(std::move(commit)),
+      [this, &done_calls] {
+        done_calls++;
+        message_loop_.PostQuitTask();
+      },
+      [this, &error_calls] {
+        error_calls++;
+        message_loop_.PostQuitTask();
+      });
 
   cloud_provider_.object_status_to_return =
       cloud_provider::Status::NETWORK_ERROR;
@@ -280,21 +406,23 @@ TEST_F(CommitUploadTest, FailedCommitUpload) {
   commit->storage_bytes = "content";
 
   storage_.unsynced_objects_to_return["obj_id1"] =
-      std::make_unique<TestObject>("obj_id1", "obj_data1");
+      std::make_unique<TestObject>("obj_id1", LargeData("obj_data1"));
   storage_.unsynced_objects_to_return["obj_id2"] =
-      std::make_unique<TestObject>("obj_id2", "obj_data2");
+      std::make_unique<TestObject>("obj_id2", LargeData("obj_data2"));
 
   auto done_calls = 0u;
   auto error_calls = 0u;
-  CommitUpload commit_upload(&storage_, &cloud_provider_, std::move(commit),
-                             [this, &done_calls] {
-                               done_calls++;
-                               message_loop_.PostQuitTask();
-                             },
-                             [this, &error_calls] {
-                               error_calls++;
-                               message_loop_.PostQuitTask();
-                             });
+  CommitUpload commit_upload(
+      &storage_, &cloud_provider_, &object_upload_queue_,
+      MakeCommitList(std::move(commit)),
+      [this, &done_calls] {
+        done_calls++;
+        message_loop_.PostQuitTask();
+      },
+      [this, &error_calls] {
+        error_calls++;
+        message_loop_.PostQuitTask();
+      });
 
   cloud_provider_.commit_status_to_return =
       cloud_provider::Status::NETWORK_ERROR;
@@ -306,8 +434,10 @@ TEST_F(CommitUploadTest, FailedCommitUpload) {
   // Verify that the objects were uploaded to cloud provider and marked as
   // synced.
   EXPECT_EQ(2u, cloud_provider_.received_objects.size());
-  EXPECT_EQ("obj_data1", cloud_provider_.received_objects["obj_id1"]);
-  EXPECT_EQ("obj_data2", cloud_provider_.received_objects["obj_id2"]);
+  EXPECT_EQ(LargeData("obj_data1"),
+            cloud_provider_.received_objects["obj_id1"]);
+  EXPECT_EQ(LargeData("obj_data2"),
+            cloud_provider_.received_objects["obj_id2"]);
   EXPECT_EQ(2u, storage_.objects_marked_as_synced.size());
   EXPECT_EQ(1u, storage_.objects_marked_as_synced.count("obj_id1"));
   EXPECT_EQ(1u, storage_.objects_marked_as_synced.count("obj_id2"));
@@ -323,21 +453,23 @@ TEST_F(CommitUploadTest, ErrorAndRetry) {
   commit->storage_bytes = "content";
 
   storage_.unsynced_objects_to_return["obj_id1"] =
-      std::make_unique<TestObject>("obj_id1", "obj_data1");
+      std::make_unique<TestObject>("obj_id1", LargeData("obj_data1"));
   storage_.unsynced_objects_to_return["obj_id2"] =
-      std::make_unique<TestObject>("obj_id2", "obj_data2");
+      std::make_unique<TestObject>("obj_id2", LargeData("obj_data2"));
 
   auto done_calls = 0u;
   auto error_calls = 0u;
-  CommitUpload commit_upload(&storage_, &cloud_provider_, std::move(commit),
-                             [this, &done_calls] {
-                               done_calls++;
-                               message_loop_.PostQuitTask();
-                             },
-                             [this, &error_calls] {
-                               error_calls++;
-                               message_loop_.PostQuitTask();
-                             });
+  CommitUpload commit_upload(
+      &storage_, &cloud_provider_, &object_upload_queue_,
+      MakeCommitList(std::move(commit)),
+      [this, &done_calls] {
+        done_calls++;
+        message_loop_.PostQuitTask();
+      },
+      [this, &error_calls] {
+        error_calls++;
+        message_loop_.PostQuitTask();
+      });
 
   cloud_provider_.object_status_to_return =
       cloud_provider::Status::NETWORK_ERROR;
@@ -349,12 +481,6 @@ TEST_F(CommitUploadTest, ErrorAndRetry) {
   EXPECT_EQ(0u, storage_.commits_marked_as_synced.size());
   EXPECT_EQ(0u, storage_.objects_marked_as_synced.size());
 
-  // TestStorage moved the objects to be returned out, need to add them again
-  // before retry.
-  storage_.unsynced_objects_to_return["obj_id1"] =
-      std::make_unique<TestObject>("obj_id1", "obj_data1");
-  storage_.unsynced_objects_to_return["obj_id2"] =
-      std::make_unique<TestObject>("obj_id2", "obj_data2");
   cloud_provider_.object_status_to_return = cloud_provider::Status::OK;
   commit_upload.Start();
   message_loop_.Run();
@@ -364,8 +490,10 @@ TEST_F(CommitUploadTest, ErrorAndRetry) {
   EXPECT_EQ("id", cloud_provider_.received_commits.front().id);
   EXPECT_EQ("content", cloud_provider_.received_commits.front().content);
   EXPECT_EQ(2u, cloud_provider_.received_objects.size());
-  EXPECT_EQ("obj_data1", cloud_provider_.received_objects["obj_id1"]);
-  EXPECT_EQ("obj_data2", cloud_provider_.received_objects["obj_id2"]);
+  EXPECT_EQ(LargeData("obj_data1"),
+            cloud_provider_.received_objects["obj_id1"]);
+  EXPECT_EQ(LargeData("obj_data2"),
+            cloud_provider_.received_objects["obj_id2"]);
 
   // Verify the sync status in storage.
   EXPECT_EQ(1u, storage_.commits_marked_as_synced.size());
@@ -375,6 +503,52 @@ TEST_F(CommitUploadTest, ErrorAndRetry) {
   EXPECT_EQ(1u, storage_.objects_marked_as_synced.count("obj_id2"));
 }
 
+// Test an upload with the commits held: the objects are uploaded right away,
+// but the commit only once it is released.
+TEST_F(CommitUploadTest, HoldCommit) {
+  auto commit = std::make_unique<TestCommit>();
+  commit->id = "id";
+  commit->storage_bytes = "content";
+
+  storage_.unsynced_objects_to_return["obj_id1"] =
+      std::make_unique<TestObject>("obj_id1", LargeData("obj_data1"));
+
+  auto done_calls = 0u;
+  auto error_calls = 0u;
+  CommitUpload commit_upload(
+      &storage_, &cloud_provider_, &object_upload_queue_,
+      MakeCommitList(std::move(commit)),
+      [this, &done_calls] {
+        done_calls++;
+        message_loop_.PostQuitTask();
+      },
+      [this, &error_calls] {
+        error_calls++;
+        message_loop_.PostQuitTask();
+      });
+
+  commit_upload.HoldCommits();
+  commit_upload.Start();
+  message_loop_.task_runner()->PostDelayedTask(
+      [this] { message_loop_.PostQuitTask(); },
+      ftl::TimeDelta::FromMilliseconds(10));
+  message_loop_.Run();
+  EXPECT_EQ(0u, done_calls);
+  EXPECT_EQ(0u, error_calls);
+
+  // Verify that the object was uploaded, but not the commit.
+  EXPECT_EQ(1u, cloud_provider_.received_objects.size());
+  EXPECT_EQ(1u, storage_.objects_marked_as_synced.count("obj_id1"));
+  EXPECT_TRUE(cloud_provider_.received_commits.empty());
+
+  commit_upload.ReleaseCommits();
+  message_loop_.Run();
+  EXPECT_EQ(1u, done_calls);
+  EXPECT_EQ(0u, error_calls);
+  EXPECT_EQ(1u, cloud_provider_.received_commits.size());
+  EXPECT_EQ(1u, storage_.commits_marked_as_synced.count("id"));
+}
+
 }  // namespace
 
 }  // namespace cloud_sync
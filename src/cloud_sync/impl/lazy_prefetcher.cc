@@ -0,0 +1,321 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/cloud_sync/impl/lazy_prefetcher.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "lib/ftl/logging.h"
+#include "lib/ftl/strings/string_view.h"
+
+namespace cloud_sync {
+
+namespace {
+
+// Maximum number of values not prefetched because of the policy that are
+// remembered to learn the recently fetched key prefixes.
+constexpr size_t kMaxSkippedObjects = 1000;
+
+bool HasPrefix(const std::string& key, const std::string& prefix) {
+  return key.size() >= prefix.size() &&
+         key.compare(0, prefix.size(), prefix) == 0;
+}
+
+}  // namespace
+
+LazyPrefetcher::LazyPrefetcher(ftl::RefPtr<ftl::TaskRunner> task_runner,
+                               storage::PageStorage* storage,
+                               PrefetchPolicy policy,
+                               std::function<bool()> is_sync_idle,
+                               metrics::MetricsRegistry* metrics)
+    : task_runner_(std::move(task_runner)),
+      storage_(storage),
+      policy_(std::move(policy)),
+      is_sync_idle_(std::move(is_sync_idle)),
+      prefetched_objects_(
+          metrics::OrUnreported(metrics)->GetCounter("prefetched_objects")),
+      prefetched_bytes_(
+          metrics::OrUnreported(metrics)->GetCounter("prefetched_bytes")),
+      objects_already_present_(metrics::OrUnreported(metrics)->GetCounter(
+          "prefetch_objects_already_present")),
+      prefetch_failures_(
+          metrics::OrUnreported(metrics)->GetCounter("prefetch_failures")),
+      objects_skipped_(metrics::OrUnreported(metrics)->GetCounter(
+          "prefetch_objects_skipped")),
+      pending_prefetches_(
+          metrics::OrUnreported(metrics)->GetGauge("pending_prefetches")),
+      weak_factory_(this) {
+  FTL_DCHECK(storage_);
+}
+
+LazyPrefetcher::~LazyPrefetcher() {
+  pending_prefetches_->Set(0);
+}
+
+void LazyPrefetcher::OnRemoteCommit(const storage::Commit& commit) {
+  if (!policy_.enabled || BudgetExhausted()) {
+    return;
+  }
+  commits_to_scan_.push_back(commit.Clone());
+  if (!current_commit_) {
+    ScanNextCommit();
+  }
+}
+
+void LazyPrefetcher::OnObjectRequested(storage::ObjectIdView object_id) {
+  if (!policy_.enabled || policy_.max_recent_prefixes == 0 ||
+      BudgetExhausted() || object_id == object_in_flight_) {
+    return;
+  }
+  auto it = skipped_objects_.find(object_id.ToString());
+  if (it == skipped_objects_.end()) {
+    return;
+  }
+  size_t separator = it->second.rfind(policy_.prefix_separator);
+  if (policy_.prefix_separator.empty() || separator == std::string::npos) {
+    return;
+  }
+  std::string prefix =
+      it->second.substr(0, separator + policy_.prefix_separator.size());
+  AddRecentPrefix(prefix);
+
+  // Queue the other values under the same prefix, the requested one being
+  // downloaded on behalf of the client.
+  std::deque<storage::ObjectId> remaining_objects;
+  for (auto& id : skipped_objects_order_) {
+    auto skipped = skipped_objects_.find(id);
+    if (skipped == skipped_objects_.end()) {
+      continue;
+    }
+    if (!HasPrefix(skipped->second, prefix)) {
+      remaining_objects.push_back(std::move(id));
+      continue;
+    }
+    if (skipped->first != object_id) {
+      objects_to_fetch_.push_back(skipped->first);
+    }
+    skipped_objects_.erase(skipped);
+  }
+  skipped_objects_order_ = std::move(remaining_objects);
+  UpdatePendingPrefetches();
+
+  FetchNext();
+}
+
+void LazyPrefetcher::OnSyncIdle() {
+  FetchNext();
+}
+
+void LazyPrefetcher::SetPaused(bool paused) {
+  paused_ = paused;
+  if (!paused_) {
+    FetchNext();
+  }
+}
+
+void LazyPrefetcher::ScanNextCommit() {
+  FTL_DCHECK(!current_commit_);
+  if (BudgetExhausted()) {
+    commits_to_scan_.clear();
+  }
+  if (commits_to_scan_.empty()) {
+    FetchNext();
+    return;
+  }
+  current_commit_ = std::move(commits_to_scan_.front());
+  commits_to_scan_.pop_front();
+
+  std::vector<storage::CommitIdView> parent_ids =
+      current_commit_->GetParentIds();
+  if (parent_ids.empty()) {
+    // The root commit does not have any entry.
+    OnCommitScanned(storage::Status::OK);
+    return;
+  }
+  auto weak_this = weak_factory_.GetWeakPtr();
+  storage_->GetCommit(
+      parent_ids[0],
+      [weak_this](storage::Status status,
+                  std::unique_ptr<const storage::Commit> base) {
+        if (!weak_this) {
+          return;
+        }
+        if (status != storage::Status::OK) {
+          weak_this->OnCommitScanned(status);
+          return;
+        }
+        weak_this->current_base_ = std::move(base);
+        weak_this->ScanCurrentCommit();
+      });
+}
+
+void LazyPrefetcher::ScanCurrentCommit() {
+  auto weak_this = weak_factory_.GetWeakPtr();
+  storage_->GetCommitContentsDiff(
+      *current_base_, *current_commit_, "",
+      [weak_this](storage::EntryChange change) {
+        if (!weak_this) {
+          return false;
+        }
+        return weak_this->OnEntryChange(change);
+      },
+      [weak_this](storage::Status status) {
+        if (weak_this) {
+          weak_this->OnCommitScanned(status);
+        }
+      });
+}
+
+void LazyPrefetcher::OnCommitScanned(storage::Status status) {
+  if (status != storage::Status::OK) {
+    FTL_LOG(WARNING) << "Failed to list the entries of a remote commit to "
+                     << "prefetch, status: " << status;
+  }
+  current_commit_.reset();
+  current_base_.reset();
+  ScanNextCommit();
+}
+
+bool LazyPrefetcher::OnEntryChange(const storage::EntryChange& change) {
+  if (BudgetExhausted()) {
+    // Nothing else will be downloaded, stop scanning.
+    return false;
+  }
+  if (change.deleted || change.entry.priority != storage::KeyPriority::LAZY) {
+    return true;
+  }
+  if (IsKeyAllowed(change.entry.key)) {
+    objects_to_fetch_.push_back(change.entry.object_id);
+    UpdatePendingPrefetches();
+    return true;
+  }
+
+  objects_skipped_->Increment();
+  if (policy_.max_recent_prefixes == 0) {
+    return true;
+  }
+  auto result =
+      skipped_objects_.emplace(change.entry.object_id, change.entry.key);
+  if (!result.second) {
+    return true;
+  }
+  skipped_objects_order_.push_back(change.entry.object_id);
+  while (skipped_objects_order_.size() > kMaxSkippedObjects) {
+    skipped_objects_.erase(skipped_objects_order_.front());
+    skipped_objects_order_.pop_front();
+  }
+  return true;
+}
+
+bool LazyPrefetcher::IsKeyAllowed(const std::string& key) const {
+  auto has_prefix = [&key](const std::string& prefix) {
+    return HasPrefix(key, prefix);
+  };
+  return std::any_of(policy_.key_prefixes.begin(), policy_.key_prefixes.end(),
+                     has_prefix) ||
+         std::any_of(recent_prefixes_.begin(), recent_prefixes_.end(),
+                     has_prefix);
+}
+
+void LazyPrefetcher::AddRecentPrefix(std::string prefix) {
+  auto it = std::find(recent_prefixes_.begin(), recent_prefixes_.end(), prefix);
+  if (it != recent_prefixes_.end()) {
+    recent_prefixes_.erase(it);
+  }
+  recent_prefixes_.push_back(std::move(prefix));
+  while (recent_prefixes_.size() > policy_.max_recent_prefixes) {
+    recent_prefixes_.pop_front();
+  }
+}
+
+void LazyPrefetcher::FetchNext() {
+  if (!object_in_flight_.empty() || paused_ || objects_to_fetch_.empty() ||
+      BudgetExhausted()) {
+    return;
+  }
+  if (policy_.only_when_idle && !is_sync_idle_()) {
+    // OnSyncIdle() resumes the download.
+    return;
+  }
+
+  object_in_flight_ = std::move(objects_to_fetch_.front());
+  objects_to_fetch_.pop_front();
+  UpdatePendingPrefetches();
+
+  auto weak_this = weak_factory_.GetWeakPtr();
+  storage_->GetObject(
+      object_in_flight_, storage::PageStorage::Location::LOCAL,
+      [weak_this](storage::Status status,
+                  std::unique_ptr<const storage::Object> object) {
+        if (!weak_this) {
+          return;
+        }
+        if (status == storage::Status::OK) {
+          weak_this->objects_already_present_->Increment();
+          weak_this->object_in_flight_.clear();
+          weak_this->PostFetchNext();
+          return;
+        }
+        if (status != storage::Status::NOT_FOUND) {
+          weak_this->OnObjectFetched(status, nullptr);
+          return;
+        }
+        // Prefetches must not delay the downloads clients are waiting for.
+        weak_this->storage_->GetObject(
+            weak_this->object_in_flight_,
+            storage::PageStorage::Location::NETWORK_IN_BACKGROUND,
+            [weak_this](storage::Status status,
+                        std::unique_ptr<const storage::Object> object) {
+              if (weak_this) {
+                weak_this->OnObjectFetched(status, std::move(object));
+              }
+            });
+      });
+}
+
+void LazyPrefetcher::PostFetchNext() {
+  task_runner_->PostTask([weak_this = weak_factory_.GetWeakPtr()] {
+    if (weak_this) {
+      weak_this->FetchNext();
+    }
+  });
+}
+
+void LazyPrefetcher::OnObjectFetched(
+    storage::Status status,
+    std::unique_ptr<const storage::Object> object) {
+  ftl::StringView data;
+  if (status == storage::Status::OK) {
+    status = object->GetData(&data);
+  }
+  if (status != storage::Status::OK) {
+    FTL_LOG(WARNING) << "Failed to prefetch an object, status: " << status;
+    prefetch_failures_->Increment();
+  } else {
+    prefetched_objects_->Increment();
+    prefetched_bytes_->Increment(data.size());
+    bytes_prefetched_ += data.size();
+  }
+  object_in_flight_.clear();
+  if (BudgetExhausted()) {
+    // Release what was queued, as it will never be downloaded.
+    commits_to_scan_.clear();
+    objects_to_fetch_.clear();
+    UpdatePendingPrefetches();
+    skipped_objects_.clear();
+    skipped_objects_order_.clear();
+  }
+  PostFetchNext();
+}
+
+bool LazyPrefetcher::BudgetExhausted() const {
+  return bytes_prefetched_ >= policy_.max_bytes;
+}
+
+void LazyPrefetcher::UpdatePendingPrefetches() {
+  pending_prefetches_->Set(objects_to_fetch_.size());
+}
+
+}  // namespace cloud_sync
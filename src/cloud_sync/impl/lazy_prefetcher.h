@@ -0,0 +1,146 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_CLOUD_SYNC_IMPL_LAZY_PREFETCHER_H_
+#define APPS_LEDGER_SRC_CLOUD_SYNC_IMPL_LAZY_PREFETCHER_H_
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "apps/ledger/src/cloud_sync/public/prefetch_policy.h"
+#include "apps/ledger/src/metrics/metrics_registry.h"
+#include "apps/ledger/src/storage/public/commit.h"
+#include "apps/ledger/src/storage/public/page_storage.h"
+#include "apps/ledger/src/storage/public/types.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/ref_ptr.h"
+#include "lib/ftl/memory/weak_ptr.h"
+#include "lib/ftl/tasks/task_runner.h"
+
+namespace cloud_sync {
+
+// Downloads in the background the values of the LAZY entries introduced by
+// remote commits, according to the given PrefetchPolicy.
+//
+// Each commit passed to |OnRemoteCommit()| is compared with its first parent,
+// and the values of the LAZY entries it adds or modifies are queued for
+// download if their key is allowed by the policy. Values are downloaded one at
+// a time through storage, so that a value requested by a client while being
+// prefetched is only downloaded once. Once the byte budget of the policy is
+// exhausted, remote commits are not scanned anymore.
+//
+// The values of the entries not allowed by the policy are remembered, so that
+// when a client fetches one of them, the values of the other entries sharing
+// the key prefix of the fetched one can be prefetched.
+//
+// The activity of the prefetcher is recorded in |metrics|, if not null:
+// - "prefetched_objects" and "prefetched_bytes" count the values downloaded,
+// - "prefetch_objects_already_present" counts the queued values that were
+//   already present locally,
+// - "prefetch_failures" counts the values that failed to download,
+// - "prefetch_objects_skipped" counts the LAZY values not queued because of
+//   the policy,
+// - "pending_prefetches" is the number of values waiting to be downloaded.
+class LazyPrefetcher {
+ public:
+  // |is_sync_idle| is called before each download when the policy only allows
+  // prefetching while sync is idle, and must return true iff it is.
+  LazyPrefetcher(ftl::RefPtr<ftl::TaskRunner> task_runner,
+                 storage::PageStorage* storage,
+                 PrefetchPolicy policy,
+                 std::function<bool()> is_sync_idle,
+                 metrics::MetricsRegistry* metrics = nullptr);
+  ~LazyPrefetcher();
+
+  // Queues the values of the LAZY entries introduced by |commit|.
+  void OnRemoteCommit(const storage::Commit& commit);
+
+  // Notifies the prefetcher that a value was requested from the cloud. If it
+  // is not being prefetched, this is a fetch made on behalf of a client.
+  void OnObjectRequested(storage::ObjectIdView object_id);
+
+  // Resumes downloading, if it was waiting for sync to become idle.
+  void OnSyncIdle();
+
+  void SetPaused(bool paused);
+
+  bool IsPaused() const { return paused_; }
+
+ private:
+  // Compares the next commit of |commits_to_scan_| with its parent.
+  void ScanNextCommit();
+
+  // Compares |current_commit_| with |current_base_|.
+  void ScanCurrentCommit();
+
+  void OnCommitScanned(storage::Status status);
+
+  // Queues the value of |change| if needed. Returns false if the scan must
+  // stop because the budget is exhausted.
+  bool OnEntryChange(const storage::EntryChange& change);
+
+  // Returns true iff the value of the entry with the given |key| should be
+  // prefetched.
+  bool IsKeyAllowed(const std::string& key) const;
+
+  void AddRecentPrefix(std::string prefix);
+
+  // Starts downloading the next queued value, if allowed.
+  void FetchNext();
+
+  // Posts a task calling FetchNext(), so that a long list of values already
+  // present locally does not grow the stack.
+  void PostFetchNext();
+
+  void OnObjectFetched(storage::Status status,
+                       std::unique_ptr<const storage::Object> object);
+
+  bool BudgetExhausted() const;
+
+  // Updates the gauge of the number of values waiting to be downloaded.
+  void UpdatePendingPrefetches();
+
+  ftl::RefPtr<ftl::TaskRunner> task_runner_;
+  storage::PageStorage* const storage_;
+  const PrefetchPolicy policy_;
+  const std::function<bool()> is_sync_idle_;
+
+  bool paused_ = false;
+  // Commits waiting to be scanned.
+  std::deque<std::unique_ptr<const storage::Commit>> commits_to_scan_;
+  // The commit being scanned and its parent, null if there is none.
+  std::unique_ptr<const storage::Commit> current_commit_;
+  std::unique_ptr<const storage::Commit> current_base_;
+  // Values waiting to be downloaded.
+  std::deque<storage::ObjectId> objects_to_fetch_;
+  // Id of the value being downloaded, empty if there is none.
+  storage::ObjectId object_in_flight_;
+  // Values not prefetched because of the policy, indexed by object id and
+  // bounded in size. Used to learn the recently fetched key prefixes.
+  std::map<storage::ObjectId, std::string> skipped_objects_;
+  std::deque<storage::ObjectId> skipped_objects_order_;
+  // Recently fetched key prefixes, the most recent one last.
+  std::deque<std::string> recent_prefixes_;
+  // Total size of the values downloaded, compared with the budget.
+  uint64_t bytes_prefetched_ = 0;
+
+  metrics::Counter* const prefetched_objects_;
+  metrics::Counter* const prefetched_bytes_;
+  metrics::Counter* const objects_already_present_;
+  metrics::Counter* const prefetch_failures_;
+  metrics::Counter* const objects_skipped_;
+  metrics::Gauge* const pending_prefetches_;
+
+  // Must be the last member field.
+  ftl::WeakPtrFactory<LazyPrefetcher> weak_factory_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(LazyPrefetcher);
+};
+
+}  // namespace cloud_sync
+
+#endif  // APPS_LEDGER_SRC_CLOUD_SYNC_IMPL_LAZY_PREFETCHER_H_
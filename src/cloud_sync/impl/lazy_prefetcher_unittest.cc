@@ -0,0 +1,345 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/cloud_sync/impl/lazy_prefetcher.h"
+
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "apps/ledger/src/storage/test/commit_empty_impl.h"
+#include "apps/ledger/src/storage/test/page_storage_empty_impl.h"
+#include "apps/ledger/src/test/test_with_message_loop.h"
+#include "gtest/gtest.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/time/time_delta.h"
+
+namespace cloud_sync {
+namespace {
+
+// Fake implementation of storage::Commit with a single parent.
+class TestCommit : public storage::test::CommitEmptyImpl {
+ public:
+  TestCommit(storage::CommitId id, storage::CommitId parent_id)
+      : id(std::move(id)), parent_id(std::move(parent_id)) {}
+  ~TestCommit() override = default;
+
+  std::unique_ptr<Commit> Clone() const override {
+    return std::make_unique<TestCommit>(id, parent_id);
+  }
+
+  const storage::CommitId& GetId() const override { return id; }
+
+  std::vector<storage::CommitIdView> GetParentIds() const override {
+    if (parent_id.empty()) {
+      return {};
+    }
+    return {parent_id};
+  }
+
+  storage::CommitId id;
+  storage::CommitId parent_id;
+};
+
+// Fake implementation of storage::Object.
+class TestObject : public storage::Object {
+ public:
+  TestObject(storage::ObjectId id, std::string data) : id(id), data(data) {}
+  ~TestObject() override = default;
+
+  storage::ObjectId GetId() const override { return id; };
+
+  storage::Status GetData(ftl::StringView* result) const override {
+    *result = ftl::StringView(data);
+    return storage::Status::OK;
+  }
+
+  storage::ObjectId id;
+  std::string data;
+};
+
+// Fake implementation of storage::PageStorage. Returns the changes registered
+// in |changes| for each commit, and objects whose content is "data_" followed
+// by their id. Registers the objects requested from the network.
+class TestPageStorage : public storage::test::PageStorageEmptyImpl {
+ public:
+  TestPageStorage() = default;
+  ~TestPageStorage() override = default;
+
+  void GetCommit(storage::CommitIdView commit_id,
+                 std::function<void(storage::Status,
+                                    std::unique_ptr<const storage::Commit>)>
+                     callback) override {
+    callback(storage::Status::OK,
+             std::make_unique<TestCommit>(commit_id.ToString(), ""));
+  }
+
+  void GetObject(
+      storage::ObjectIdView object_id,
+      Location location,
+      const std::function<void(storage::Status,
+                               std::unique_ptr<const storage::Object>)>&
+          callback) override {
+    std::string id = object_id.ToString();
+    if (local_objects.count(id) == 0) {
+      if (location == Location::LOCAL) {
+        callback(storage::Status::NOT_FOUND, nullptr);
+        return;
+      }
+      network_requests.push_back(id);
+      network_request_locations.push_back(location);
+      local_objects.insert(id);
+    }
+    callback(storage::Status::OK,
+             std::make_unique<TestObject>(id, "data_" + id));
+  }
+
+  void GetCommitContentsDiff(
+      const storage::Commit& base_commit,
+      const storage::Commit& other_commit,
+      std::string min_key,
+      std::function<bool(storage::EntryChange)> on_next_diff,
+      std::function<void(storage::Status)> on_done) override {
+    scanned_commits.push_back(other_commit.GetId());
+    for (const auto& change : changes[other_commit.GetId()]) {
+      if (!on_next_diff(change)) {
+        break;
+      }
+    }
+    on_done(storage::Status::OK);
+  }
+
+  void AddChange(const storage::CommitId& commit_id,
+                 std::string key,
+                 storage::ObjectId object_id,
+                 storage::KeyPriority priority,
+                 bool deleted = false) {
+    changes[commit_id].push_back(
+        {{std::move(key), std::move(object_id), priority}, deleted});
+  }
+
+  std::map<storage::CommitId, std::vector<storage::EntryChange>> changes;
+  std::set<storage::ObjectId> local_objects;
+  std::vector<storage::ObjectId> network_requests;
+  std::vector<Location> network_request_locations;
+  std::vector<storage::CommitId> scanned_commits;
+};
+
+class LazyPrefetcherTest : public test::TestWithMessageLoop {
+ public:
+  LazyPrefetcherTest() {}
+  ~LazyPrefetcherTest() override {}
+
+ protected:
+  void CreatePrefetcher(PrefetchPolicy policy) {
+    policy.enabled = true;
+    prefetcher_ = std::make_unique<LazyPrefetcher>(
+        message_loop_.task_runner(), &storage_, std::move(policy),
+        [this] { return sync_idle_; }, &metrics_);
+  }
+
+  // Runs the loop until all pending downloads are done.
+  void RunUntilDone() {
+    EXPECT_TRUE(RunLoopWithTimeout(ftl::TimeDelta::FromMilliseconds(20)));
+  }
+
+  TestPageStorage storage_;
+  metrics::MetricsRegistry metrics_;
+  bool sync_idle_ = true;
+  std::unique_ptr<LazyPrefetcher> prefetcher_;
+
+ private:
+  FTL_DISALLOW_COPY_AND_ASSIGN(LazyPrefetcherTest);
+};
+
+TEST_F(LazyPrefetcherTest, PrefetchAllowedLazyValues) {
+  PrefetchPolicy policy;
+  policy.key_prefixes = {"photos/"};
+  policy.only_when_idle = false;
+  CreatePrefetcher(std::move(policy));
+
+  storage_.AddChange("id1", "photos/1", "object1", storage::KeyPriority::LAZY);
+  storage_.AddChange("id1", "photos/2", "object2", storage::KeyPriority::EAGER);
+  storage_.AddChange("id1", "photos/3", "object3", storage::KeyPriority::LAZY,
+                     true);
+  storage_.AddChange("id1", "videos/1", "object4", storage::KeyPriority::LAZY);
+  storage_.AddChange("id2", "photos/4", "object5", storage::KeyPriority::LAZY);
+  prefetcher_->OnRemoteCommit(TestCommit("id1", "id0"));
+  prefetcher_->OnRemoteCommit(TestCommit("id2", "id1"));
+  RunUntilDone();
+
+  EXPECT_EQ(std::vector<storage::ObjectId>({"object1", "object5"}),
+            storage_.network_requests);
+  EXPECT_EQ(2, metrics_.GetCounter("prefetched_objects")->value());
+  EXPECT_EQ(static_cast<int64_t>(2 * std::string("data_object1").size()),
+            metrics_.GetCounter("prefetched_bytes")->value());
+  EXPECT_EQ(1, metrics_.GetCounter("prefetch_objects_skipped")->value());
+  EXPECT_EQ(0, metrics_.GetGauge("pending_prefetches")->value());
+}
+
+TEST_F(LazyPrefetcherTest, PrefetchInBackground) {
+  PrefetchPolicy policy;
+  policy.key_prefixes = {"photos/"};
+  policy.only_when_idle = false;
+  CreatePrefetcher(std::move(policy));
+
+  storage_.AddChange("id1", "photos/1", "object1", storage::KeyPriority::LAZY);
+  storage_.AddChange("id1", "photos/2", "object2", storage::KeyPriority::LAZY);
+  prefetcher_->OnRemoteCommit(TestCommit("id1", "id0"));
+  RunUntilDone();
+
+  // Prefetches must not compete with the downloads clients are waiting for.
+  ASSERT_EQ(2u, storage_.network_request_locations.size());
+  for (auto location : storage_.network_request_locations) {
+    EXPECT_EQ(storage::PageStorage::Location::NETWORK_IN_BACKGROUND, location);
+  }
+}
+
+TEST_F(LazyPrefetcherTest, SkipLocalValues) {
+  PrefetchPolicy policy;
+  policy.key_prefixes = {""};
+  policy.only_when_idle = false;
+  CreatePrefetcher(std::move(policy));
+
+  storage_.local_objects.insert("object1");
+  storage_.AddChange("id1", "key1", "object1", storage::KeyPriority::LAZY);
+  storage_.AddChange("id1", "key2", "object2", storage::KeyPriority::LAZY);
+  prefetcher_->OnRemoteCommit(TestCommit("id1", "id0"));
+  RunUntilDone();
+
+  EXPECT_EQ(std::vector<storage::ObjectId>({"object2"}),
+            storage_.network_requests);
+  EXPECT_EQ(1,
+            metrics_.GetCounter("prefetch_objects_already_present")->value());
+}
+
+TEST_F(LazyPrefetcherTest, ByteBudget) {
+  PrefetchPolicy policy;
+  policy.key_prefixes = {""};
+  policy.only_when_idle = false;
+  // Values are 12 bytes long, the budget is exhausted after two of them.
+  policy.max_bytes = 20;
+  CreatePrefetcher(std::move(policy));
+
+  storage_.AddChange("id1", "key1", "object1", storage::KeyPriority::LAZY);
+  storage_.AddChange("id1", "key2", "object2", storage::KeyPriority::LAZY);
+  storage_.AddChange("id1", "key3", "object3", storage::KeyPriority::LAZY);
+  prefetcher_->OnRemoteCommit(TestCommit("id1", "id0"));
+  RunUntilDone();
+
+  EXPECT_EQ(std::vector<storage::ObjectId>({"object1", "object2"}),
+            storage_.network_requests);
+}
+
+TEST_F(LazyPrefetcherTest, ByteBudgetStopsScanning) {
+  PrefetchPolicy policy;
+  policy.key_prefixes = {""};
+  policy.only_when_idle = false;
+  policy.max_bytes = 10;
+  CreatePrefetcher(std::move(policy));
+
+  storage_.AddChange("id1", "key1", "object1", storage::KeyPriority::LAZY);
+  prefetcher_->OnRemoteCommit(TestCommit("id1", "id0"));
+  RunUntilDone();
+  EXPECT_EQ(1u, storage_.network_requests.size());
+
+  // The budget is exhausted: the next commits are not even compared with
+  // their parent.
+  storage_.AddChange("id2", "key2", "object2", storage::KeyPriority::LAZY);
+  prefetcher_->OnRemoteCommit(TestCommit("id2", "id1"));
+  RunUntilDone();
+  EXPECT_EQ(std::vector<storage::CommitId>({"id1"}), storage_.scanned_commits);
+  EXPECT_EQ(1u, storage_.network_requests.size());
+}
+
+TEST_F(LazyPrefetcherTest, OnlyWhenIdle) {
+  PrefetchPolicy policy;
+  policy.key_prefixes = {""};
+  policy.only_when_idle = true;
+  CreatePrefetcher(std::move(policy));
+
+  sync_idle_ = false;
+  storage_.AddChange("id1", "key1", "object1", storage::KeyPriority::LAZY);
+  prefetcher_->OnRemoteCommit(TestCommit("id1", "id0"));
+  RunUntilDone();
+  EXPECT_TRUE(storage_.network_requests.empty());
+  EXPECT_EQ(1, metrics_.GetGauge("pending_prefetches")->value());
+
+  sync_idle_ = true;
+  prefetcher_->OnSyncIdle();
+  RunUntilDone();
+  EXPECT_EQ(std::vector<storage::ObjectId>({"object1"}),
+            storage_.network_requests);
+}
+
+TEST_F(LazyPrefetcherTest, Pause) {
+  PrefetchPolicy policy;
+  policy.key_prefixes = {""};
+  policy.only_when_idle = false;
+  CreatePrefetcher(std::move(policy));
+
+  prefetcher_->SetPaused(true);
+  storage_.AddChange("id1", "key1", "object1", storage::KeyPriority::LAZY);
+  prefetcher_->OnRemoteCommit(TestCommit("id1", "id0"));
+  RunUntilDone();
+  EXPECT_TRUE(storage_.network_requests.empty());
+
+  prefetcher_->SetPaused(false);
+  RunUntilDone();
+  EXPECT_EQ(std::vector<storage::ObjectId>({"object1"}),
+            storage_.network_requests);
+}
+
+// Verifies that when a client fetches a value that was not prefetched, the
+// values sharing the key prefix of the fetched one are prefetched.
+TEST_F(LazyPrefetcherTest, RecentPrefixes) {
+  PrefetchPolicy policy;
+  policy.only_when_idle = false;
+  policy.max_recent_prefixes = 1;
+  CreatePrefetcher(std::move(policy));
+
+  storage_.AddChange("id1", "album1/a", "object1", storage::KeyPriority::LAZY);
+  storage_.AddChange("id1", "album1/b", "object2", storage::KeyPriority::LAZY);
+  storage_.AddChange("id1", "album2/a", "object3", storage::KeyPriority::LAZY);
+  prefetcher_->OnRemoteCommit(TestCommit("id1", "id0"));
+  RunUntilDone();
+  EXPECT_TRUE(storage_.network_requests.empty());
+  EXPECT_EQ(3, metrics_.GetCounter("prefetch_objects_skipped")->value());
+
+  prefetcher_->OnObjectRequested("object1");
+  RunUntilDone();
+  EXPECT_EQ(std::vector<storage::ObjectId>({"object2"}),
+            storage_.network_requests);
+
+  // New values under the recent prefix are prefetched as well.
+  storage_.AddChange("id2", "album1/c", "object4", storage::KeyPriority::LAZY);
+  prefetcher_->OnRemoteCommit(TestCommit("id2", "id1"));
+  RunUntilDone();
+  EXPECT_EQ(std::vector<storage::ObjectId>({"object2", "object4"}),
+            storage_.network_requests);
+
+  // Only the most recent prefix is kept.
+  prefetcher_->OnObjectRequested("object3");
+  storage_.AddChange("id3", "album1/d", "object5", storage::KeyPriority::LAZY);
+  prefetcher_->OnRemoteCommit(TestCommit("id3", "id2"));
+  RunUntilDone();
+  EXPECT_EQ(std::vector<storage::ObjectId>({"object2", "object4"}),
+            storage_.network_requests);
+}
+
+TEST_F(LazyPrefetcherTest, Disabled) {
+  LazyPrefetcher prefetcher(message_loop_.task_runner(), &storage_,
+                            PrefetchPolicy(), [] { return true; });
+
+  storage_.AddChange("id1", "key1", "object1", storage::KeyPriority::LAZY);
+  prefetcher.OnRemoteCommit(TestCommit("id1", "id0"));
+  RunUntilDone();
+  EXPECT_TRUE(storage_.network_requests.empty());
+}
+
+}  // namespace
+}  // namespace cloud_sync
@@ -16,7 +16,8 @@ namespace cloud_sync {
 
 LedgerSyncImpl::LedgerSyncImpl(ledger::Environment* environment,
                                const UserConfig* user_config,
-                               ftl::StringView app_id)
+                               ftl::StringView app_id,
+                               metrics::MetricsRegistry* metrics)
     : environment_(environment),
       user_config_(user_config),
       app_gcs_prefix_(GetGcsPrefixForApp(user_config->user_id, app_id)),
@@ -24,7 +25,8 @@ LedgerSyncImpl::LedgerSyncImpl(ledger::Environment* environment,
       app_firebase_(std::make_unique<firebase::FirebaseImpl>(
           environment_->network_service(),
           user_config->server_id,
-          app_firebase_path_)) {
+          app_firebase_path_)),
+      metrics_(metrics::OrUnreported(metrics)) {
   FTL_DCHECK(user_config->use_sync);
   FTL_DCHECK(!user_config->server_id.empty());
 }
@@ -76,10 +78,13 @@ std::unique_ptr<PageSyncContext> LedgerSyncImpl::CreatePageContext(
       user_config_->server_id,
       GetGcsPrefixForPage(app_gcs_prefix_, page_storage->GetId()));
   result->cloud_provider = std::make_unique<cloud_provider::CloudProviderImpl>(
-      result->firebase.get(), result->cloud_storage.get());
+      result->firebase.get(), result->cloud_storage.get(),
+      environment_->main_runner(), environment_->GetWorkerPool());
   result->page_sync = std::make_unique<PageSyncImpl>(
       environment_->main_runner(), page_storage, result->cloud_provider.get(),
-      std::make_unique<backoff::ExponentialBackoff>(), error_callback);
+      user_config_->prefetch_policy,
+      std::make_unique<backoff::ExponentialBackoff>(), error_callback,
+      metrics_->GetChild(metrics::PageNodeName(page_storage->GetId())));
   return result;
 }
 
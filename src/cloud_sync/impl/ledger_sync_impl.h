@@ -9,15 +9,19 @@
 #include "apps/ledger/src/cloud_sync/public/user_config.h"
 #include "apps/ledger/src/environment/environment.h"
 #include "apps/ledger/src/firebase/firebase.h"
+#include "apps/ledger/src/metrics/metrics_registry.h"
 #include "apps/ledger/src/network/network_service.h"
 
 namespace cloud_sync {
 
 class LedgerSyncImpl : public LedgerSync {
  public:
+  // The metrics of the sync of each page are recorded in a child of |metrics|
+  // named after the page, if |metrics| is not null.
   LedgerSyncImpl(ledger::Environment* environment,
                  const UserConfig* user_config,
-                 ftl::StringView app_id);
+                 ftl::StringView app_id,
+                 metrics::MetricsRegistry* metrics = nullptr);
   ~LedgerSyncImpl();
 
   void RemoteContains(ftl::StringView page_id,
@@ -35,6 +39,7 @@ class LedgerSyncImpl : public LedgerSync {
   const std::string app_firebase_path_;
   // Firebase instance scoped to |app_path_|.
   std::unique_ptr<firebase::Firebase> app_firebase_;
+  metrics::MetricsRegistry* const metrics_;
 };
 
 }  // namespace cloud_sync
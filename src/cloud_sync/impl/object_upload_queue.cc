@@ -0,0 +1,91 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/cloud_sync/impl/object_upload_queue.h"
+
+#include <utility>
+
+#include "lib/ftl/logging.h"
+#include "lib/mtl/vmo/strings.h"
+
+namespace cloud_sync {
+
+ObjectUploadQueue::ObjectUploadQueue(
+    storage::PageStorage* storage,
+    cloud_provider::CloudProvider* cloud_provider,
+    size_t max_concurrent_uploads)
+    : storage_(storage),
+      cloud_provider_(cloud_provider),
+      max_concurrent_uploads_(max_concurrent_uploads) {
+  FTL_DCHECK(storage);
+  FTL_DCHECK(cloud_provider);
+  FTL_DCHECK(max_concurrent_uploads > 0);
+}
+
+ObjectUploadQueue::~ObjectUploadQueue() {}
+
+void ObjectUploadQueue::UploadObject(
+    storage::ObjectIdView object_id,
+    std::function<void(cloud_provider::Status)> callback) {
+  auto& callbacks = callbacks_[object_id.ToString()];
+  callbacks.push_back(std::move(callback));
+  if (callbacks.size() > 1) {
+    // The object is already queued or being uploaded.
+    return;
+  }
+  queued_objects_.push(object_id.ToString());
+  UploadNext();
+}
+
+void ObjectUploadQueue::UploadNext() {
+  while (active_uploads_ < max_concurrent_uploads_ &&
+         !queued_objects_.empty()) {
+    storage::ObjectId object_id = std::move(queued_objects_.front());
+    queued_objects_.pop();
+    active_uploads_++;
+
+    storage_->GetObject(object_id, storage::PageStorage::Location::LOCAL, [
+      this, object_id
+    ](storage::Status storage_status,
+      std::unique_ptr<const storage::Object> object) {
+      FTL_DCHECK(storage_status == storage::Status::OK);
+
+      ftl::StringView data_view;
+      auto status = object->GetData(&data_view);
+      FTL_DCHECK(status == storage::Status::OK);
+
+      // TODO(ppi): get the virtual memory object directly from
+      // storage::Object, once it can give us one.
+      mx::vmo data;
+      auto result = mtl::VmoFromString(data_view, &data);
+      FTL_DCHECK(result);
+
+      cloud_provider_->AddObject(
+          object_id, std::move(data),
+          [ this, object_id ](cloud_provider::Status status) {
+            OnUploadDone(object_id, status);
+          });
+    });
+  }
+}
+
+void ObjectUploadQueue::OnUploadDone(const storage::ObjectId& object_id,
+                                     cloud_provider::Status status) {
+  FTL_DCHECK(active_uploads_ > 0);
+  active_uploads_--;
+
+  auto it = callbacks_.find(object_id);
+  FTL_DCHECK(it != callbacks_.end());
+  auto callbacks = std::move(it->second);
+  callbacks_.erase(it);
+
+  // Start the next uploads before calling the callbacks, which can result in
+  // new objects being queued.
+  UploadNext();
+  for (auto& callback : callbacks) {
+    callback(status);
+  }
+}
+
+}  // namespace cloud_sync
@@ -0,0 +1,65 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_CLOUD_SYNC_IMPL_OBJECT_UPLOAD_QUEUE_H_
+#define APPS_LEDGER_SRC_CLOUD_SYNC_IMPL_OBJECT_UPLOAD_QUEUE_H_
+
+#include <functional>
+#include <map>
+#include <queue>
+#include <vector>
+
+#include "apps/ledger/src/cloud_provider/public/cloud_provider.h"
+#include "apps/ledger/src/storage/public/page_storage.h"
+#include "lib/ftl/macros.h"
+
+namespace cloud_sync {
+
+// Uploads storage objects through the cloud provider, with at most
+// |max_concurrent_uploads| uploads in progress at any time. Objects waiting for
+// an upload slot are uploaded in the order in which they were requested.
+//
+// Concurrent requests to upload the same object are coalesced: the object is
+// uploaded once and all callbacks are called with the result.
+//
+// Lifetime: same as CommitUpload, if ObjectUploadQueue is deleted while uploads
+// are pending, it has to be deleted along with |storage| and |cloud_provider|.
+class ObjectUploadQueue {
+ public:
+  ObjectUploadQueue(storage::PageStorage* storage,
+                    cloud_provider::CloudProvider* cloud_provider,
+                    size_t max_concurrent_uploads);
+  ~ObjectUploadQueue();
+
+  // Reads the object with the given id from storage, uploads it and calls
+  // |callback| with the result of the upload.
+  void UploadObject(storage::ObjectIdView object_id,
+                    std::function<void(cloud_provider::Status)> callback);
+
+ private:
+  // Starts uploads of queued objects until all upload slots are taken.
+  void UploadNext();
+
+  void OnUploadDone(const storage::ObjectId& object_id,
+                    cloud_provider::Status status);
+
+  storage::PageStorage* const storage_;
+  cloud_provider::CloudProvider* const cloud_provider_;
+  const size_t max_concurrent_uploads_;
+
+  // Callbacks to call when the upload of each queued or uploading object
+  // completes.
+  std::map<storage::ObjectId,
+           std::vector<std::function<void(cloud_provider::Status)>>>
+      callbacks_;
+  // Objects waiting for an upload slot.
+  std::queue<storage::ObjectId> queued_objects_;
+  size_t active_uploads_ = 0;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ObjectUploadQueue);
+};
+
+}  // namespace cloud_sync
+
+#endif  // APPS_LEDGER_SRC_CLOUD_SYNC_IMPL_OBJECT_UPLOAD_QUEUE_H_
@@ -0,0 +1,152 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/cloud_sync/impl/object_upload_queue.h"
+
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "apps/ledger/src/cloud_provider/test/cloud_provider_empty_impl.h"
+#include "apps/ledger/src/storage/public/object.h"
+#include "apps/ledger/src/storage/test/page_storage_empty_impl.h"
+#include "gtest/gtest.h"
+#include "lib/ftl/macros.h"
+#include "lib/mtl/vmo/strings.h"
+
+namespace cloud_sync {
+namespace {
+
+// Fake implementation of storage::Object.
+class TestObject : public storage::Object {
+ public:
+  TestObject(storage::ObjectId id, std::string data) : id(id), data(data) {}
+  ~TestObject() override = default;
+
+  storage::ObjectId GetId() const override { return id; };
+
+  storage::Status GetData(ftl::StringView* result) const override {
+    *result = ftl::StringView(data);
+    return storage::Status::OK;
+  }
+
+  storage::ObjectId id;
+  std::string data;
+};
+
+// Fake implementation of storage::PageStorage returning objects whose content
+// is "data_" followed by their id.
+class TestPageStorage : public storage::test::PageStorageEmptyImpl {
+ public:
+  TestPageStorage() = default;
+  ~TestPageStorage() override = default;
+
+  void GetObject(
+      storage::ObjectIdView object_id,
+      Location location,
+      const std::function<void(storage::Status,
+                               std::unique_ptr<const storage::Object>)>&
+          callback) override {
+    callback(storage::Status::OK,
+             std::make_unique<TestObject>(object_id.ToString(),
+                                          "data_" + object_id.ToString()));
+  }
+};
+
+// Fake implementation of cloud_provider::CloudProvider. Registers the uploaded
+// objects and keeps the upload callbacks until the test calls them.
+class TestCloudProvider : public cloud_provider::test::CloudProviderEmptyImpl {
+ public:
+  TestCloudProvider() = default;
+  ~TestCloudProvider() override = default;
+
+  void AddObject(
+      cloud_provider::ObjectIdView object_id,
+      mx::vmo data,
+      std::function<void(cloud_provider::Status)> callback) override {
+    std::string received_data;
+    ASSERT_TRUE(mtl::StringFromVmo(std::move(data), &received_data));
+    received_objects.emplace_back(object_id.ToString(), received_data);
+    pending_callbacks.push_back(std::move(callback));
+  }
+
+  // Completes the oldest pending upload with the given status.
+  void CompleteUpload(cloud_provider::Status status) {
+    ASSERT_FALSE(pending_callbacks.empty());
+    auto callback = std::move(pending_callbacks.front());
+    pending_callbacks.erase(pending_callbacks.begin());
+    callback(status);
+  }
+
+  std::vector<std::pair<cloud_provider::ObjectId, std::string>>
+      received_objects;
+  std::vector<std::function<void(cloud_provider::Status)>> pending_callbacks;
+};
+
+class ObjectUploadQueueTest : public ::testing::Test {
+ public:
+  ObjectUploadQueueTest() : queue_(&storage_, &cloud_provider_, 2) {}
+  ~ObjectUploadQueueTest() override {}
+
+ protected:
+  TestPageStorage storage_;
+  TestCloudProvider cloud_provider_;
+  ObjectUploadQueue queue_;
+
+ private:
+  FTL_DISALLOW_COPY_AND_ASSIGN(ObjectUploadQueueTest);
+};
+
+TEST_F(ObjectUploadQueueTest, LimitsConcurrentUploads) {
+  std::map<storage::ObjectId, cloud_provider::Status> results;
+  for (const auto& id : {"id1", "id2", "id3"}) {
+    queue_.UploadObject(id, [&results, id](cloud_provider::Status status) {
+      results[id] = status;
+    });
+  }
+
+  // Only two uploads can be in progress at the same time.
+  ASSERT_EQ(2u, cloud_provider_.received_objects.size());
+  EXPECT_EQ("id1", cloud_provider_.received_objects[0].first);
+  EXPECT_EQ("data_id1", cloud_provider_.received_objects[0].second);
+  EXPECT_EQ("id2", cloud_provider_.received_objects[1].first);
+
+  cloud_provider_.CompleteUpload(cloud_provider::Status::OK);
+  EXPECT_EQ(1u, results.size());
+  EXPECT_EQ(cloud_provider::Status::OK, results["id1"]);
+  ASSERT_EQ(3u, cloud_provider_.received_objects.size());
+  EXPECT_EQ("id3", cloud_provider_.received_objects[2].first);
+
+  cloud_provider_.CompleteUpload(cloud_provider::Status::NETWORK_ERROR);
+  cloud_provider_.CompleteUpload(cloud_provider::Status::OK);
+  EXPECT_EQ(3u, results.size());
+  EXPECT_EQ(cloud_provider::Status::NETWORK_ERROR, results["id2"]);
+  EXPECT_EQ(cloud_provider::Status::OK, results["id3"]);
+  EXPECT_TRUE(cloud_provider_.pending_callbacks.empty());
+}
+
+TEST_F(ObjectUploadQueueTest, CoalescesUploadsOfTheSameObject) {
+  int calls = 0;
+  for (int i = 0; i < 3; ++i) {
+    queue_.UploadObject("id", [&calls](cloud_provider::Status status) {
+      EXPECT_EQ(cloud_provider::Status::OK, status);
+      calls++;
+    });
+  }
+
+  EXPECT_EQ(1u, cloud_provider_.received_objects.size());
+  cloud_provider_.CompleteUpload(cloud_provider::Status::OK);
+  EXPECT_EQ(3, calls);
+
+  // Once the upload is done, a new request uploads the object again.
+  queue_.UploadObject("id", [&calls](cloud_provider::Status status) {
+    calls++;
+  });
+  EXPECT_EQ(2u, cloud_provider_.received_objects.size());
+  cloud_provider_.CompleteUpload(cloud_provider::Status::OK);
+  EXPECT_EQ(4, calls);
+}
+
+}  // namespace
+}  // namespace cloud_sync
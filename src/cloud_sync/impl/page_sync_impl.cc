@@ -5,6 +5,7 @@
 #include "apps/ledger/src/cloud_sync/impl/page_sync_impl.h"
 
 #include <algorithm>
+#include <iterator>
 #include <map>
 #include <memory>
 #include <utility>
@@ -12,19 +13,66 @@
 
 #include "apps/ledger/src/storage/public/types.h"
 #include "lib/ftl/logging.h"
+#include "lib/ftl/time/time_point.h"
 
 namespace cloud_sync {
 
+namespace {
+
+// Maximum number of commits uploaded in a single request.
+constexpr size_t kMaxCommitsPerUpload = 20;
+
+// Maximum number of remote commits retrieved in a single request when
+// downloading the backlog. Commits uploaded in a single request share the same
+// timestamp, so a page needs to be able to hold all of them for the download to
+// make progress.
+constexpr size_t kBacklogPageSize = 100;
+static_assert(kBacklogPageSize > kMaxCommitsPerUpload,
+              "A backlog page must hold all commits of a single upload.");
+
+// Maximum number of commit uploads in progress at any time. Only the first one
+// uploads its commits, the others upload the objects they reference.
+constexpr size_t kMaxPipelinedCommitUploads = 10;
+
+// Maximum number of objects uploaded concurrently.
+constexpr size_t kMaxConcurrentObjectUploads = 10;
+
+}  // namespace
+
 PageSyncImpl::PageSyncImpl(ftl::RefPtr<ftl::TaskRunner> task_runner,
                            storage::PageStorage* storage,
                            cloud_provider::CloudProvider* cloud_provider,
+                           PrefetchPolicy prefetch_policy,
                            std::unique_ptr<backoff::Backoff> backoff,
-                           ftl::Closure on_error)
+                           ftl::Closure on_error,
+                           metrics::MetricsRegistry* metrics)
     : task_runner_(task_runner),
       storage_(storage),
       cloud_provider_(cloud_provider),
       backoff_(std::move(backoff)),
       on_error_(on_error),
+      object_upload_queue_(storage,
+                           cloud_provider,
+                           kMaxConcurrentObjectUploads),
+      prefetcher_(task_runner,
+                  storage,
+                  std::move(prefetch_policy),
+                  [this] { return IsIdle(); },
+                  metrics),
+      pending_uploads_(
+          metrics::OrUnreported(metrics)->GetGauge("pending_commit_uploads")),
+      commits_uploaded_(
+          metrics::OrUnreported(metrics)->GetCounter("commits_uploaded")),
+      upload_retries_(
+          metrics::OrUnreported(metrics)->GetCounter("commit_upload_retries")),
+      upload_latency_(metrics::OrUnreported(metrics)->GetHistogram(
+          "commit_upload_latency")),
+      pending_downloads_(metrics::OrUnreported(metrics)->GetGauge(
+          "pending_commit_downloads")),
+      commits_downloaded_(
+          metrics::OrUnreported(metrics)->GetCounter("commits_downloaded")),
+      download_latency_(metrics::OrUnreported(metrics)->GetHistogram(
+          "commit_download_latency")),
       weak_factory_(this) {
   FTL_DCHECK(storage);
   FTL_DCHECK(cloud_provider);
@@ -60,9 +108,7 @@ void PageSyncImpl::Start() {
           return;
         }
 
-        for (auto& commit : commits) {
-          EnqueueUpload(std::move(commit));
-        }
+        EnqueueUpload(std::move(commits));
 
         // Subscribe to notifications about new commits in Storage.
         storage_->AddCommitWatcher(this);
@@ -87,37 +133,66 @@ void PageSyncImpl::SetOnBacklogDownloaded(ftl::Closure on_backlog_downloaded) {
   on_backlog_downloaded_ = on_backlog_downloaded;
 }
 
+void PageSyncImpl::SetPrefetchPaused(bool paused) {
+  prefetch_paused_ = paused;
+  UpdatePrefetchPaused();
+}
+
 void PageSyncImpl::OnNewCommits(
     const std::vector<std::unique_ptr<const storage::Commit>>& commits,
     storage::ChangeSource source) {
-  // Only upload the locally created commits.
+  // Only upload the locally created commits. The values of the remote ones
+  // are prefetched.
   // TODO(ppi): revisit this when we have p2p sync, too.
   if (source != storage::ChangeSource::LOCAL) {
+    for (const auto& commit : commits) {
+      prefetcher_.OnRemoteCommit(*commit);
+    }
     return;
   }
 
+  std::vector<std::unique_ptr<const storage::Commit>> commits_to_upload;
   for (const auto& commit : commits) {
-    EnqueueUpload(commit->Clone());
+    commits_to_upload.push_back(commit->Clone());
   }
+  EnqueueUpload(std::move(commits_to_upload));
 }
 
 void PageSyncImpl::GetObject(
     storage::ObjectIdView object_id,
+    storage::DownloadPriority priority,
     std::function<void(storage::Status status, uint64_t size, mx::socket data)>
         callback) {
-  cloud_provider_->GetObject(object_id, [
-    this, object_id = object_id.ToString(), callback
+  ledger::RequestPriority request_priority;
+  if (priority == storage::DownloadPriority::FOREGROUND) {
+    // A client is waiting for the object.
+    prefetcher_.OnObjectRequested(object_id);
+    request_priority = ledger::RequestPriority::INTERACTIVE;
+    foreground_downloads_++;
+    UpdatePrefetchPaused();
+  } else {
+    request_priority = ledger::RequestPriority::BACKGROUND;
+  }
+  cloud_provider_->GetObject(object_id, request_priority, [
+    this, object_id = object_id.ToString(), priority, callback
   ](cloud_provider::Status status, uint64_t size, mx::socket data) {
+    if (priority == storage::DownloadPriority::FOREGROUND) {
+      // Retries count the download again.
+      foreground_downloads_--;
+      UpdatePrefetchPaused();
+    }
     if (status == cloud_provider::Status::NETWORK_ERROR) {
       FTL_LOG(WARNING)
           << "GetObject() failed due to a connection error, retrying.";
       Retry([
-        this, object_id = std::move(object_id), callback = std::move(callback)
-      ] { GetObject(object_id, callback); });
+        this, object_id = std::move(object_id), priority,
+        callback = std::move(callback)
+      ] { GetObject(object_id, priority, callback); });
       return;
     }
 
     backoff_->Reset();
+    SetConnectionLost(false);
     if (status != cloud_provider::Status::OK) {
       FTL_LOG(WARNING) << "Fetching remote object failed with status: "
                        << status;
@@ -131,6 +206,7 @@ void PageSyncImpl::GetObject(
 
 void PageSyncImpl::OnRemoteCommit(cloud_provider::Commit commit,
                                   std::string timestamp) {
+  SetConnectionLost(false);
   std::vector<cloud_provider::Record> records;
   records.emplace_back(std::move(commit), std::move(timestamp));
   if (batch_download_) {
@@ -138,6 +214,7 @@ void PageSyncImpl::OnRemoteCommit(cloud_provider::Commit commit,
     // to be downloaded when it is done.
     std::move(std::begin(records), std::end(records),
               std::back_inserter(commits_to_download_));
+    pending_downloads_->Set(commits_to_download_.size());
     return;
   }
 
@@ -170,41 +247,77 @@ void PageSyncImpl::DownloadBacklog() {
     return;
   }
 
-  // TODO(ppi): handle pagination when the response is huge.
-  cloud_provider_->GetCommits(
-      std::move(last_commit_ts),
-      [this](cloud_provider::Status cloud_status,
-             std::vector<cloud_provider::Record> records) {
-        if (cloud_status != cloud_provider::Status::OK) {
-          // Fetching the remote commits failed, schedule a retry.
-          FTL_LOG(WARNING)
-              << "Fetching the backlog of remote objects failed due to a "
-              << "connection error, status: " << cloud_status << ", retrying.";
-          Retry([this] { DownloadBacklog(); });
-          return;
-        }
-        backoff_->Reset();
+  DownloadBacklogPage(std::move(last_commit_ts));
+}
 
-        if (records.empty()) {
-          // If there is no remote commits to add, announce that we're done.
-          BacklogDownloaded();
-        } else {
-          // If not, fire the backlog download callback when the remote commits
-          // are downloaded.
-          DownloadBatch(std::move(records), [this] { BacklogDownloaded(); });
-        }
+void PageSyncImpl::DownloadBacklogPage(std::string min_timestamp) {
+  cloud_provider_->GetCommitsPage(min_timestamp, kBacklogPageSize, [
+    this, min_timestamp
+  ](cloud_provider::Status cloud_status,
+    std::vector<cloud_provider::Record> records) {
+    if (cloud_status != cloud_provider::Status::OK) {
+      // Fetching the remote commits failed, schedule a retry.
+      FTL_LOG(WARNING)
+          << "Fetching the backlog of remote objects failed due to a "
+          << "connection error, status: " << cloud_status << ", retrying.";
+      Retry([this, min_timestamp] { DownloadBacklogPage(min_timestamp); });
+      return;
+    }
+    backoff_->Reset();
+    SetConnectionLost(false);
+
+    if (records.size() == kBacklogPageSize &&
+        records.front().timestamp != records.back().timestamp) {
+      // The page is full, more commits can follow. The commits uploaded in a
+      // single request share the same timestamp, and the page can end in the
+      // middle of them: a commit could then be added without its parent.
+      // Leave out the commits with the last timestamp, add the others to
+      // storage, which persists the timestamp of the last one, and retrieve
+      // the next page starting at the timestamp that was left out.
+      std::string next_timestamp = records.back().timestamp;
+      while (records.back().timestamp == next_timestamp) {
+        records.pop_back();
+      }
+      DownloadBatch(std::move(records), [
+        this, next_timestamp = std::move(next_timestamp)
+      ] { DownloadBacklogPage(next_timestamp); });
+      return;
+    }
 
-        download_list_retrieved_ = true;
-        CheckIdle();
-        SetRemoteWatcher();
-      });
+    if (records.size() == kBacklogPageSize) {
+      // All commits of the page share the same timestamp, retrieving the next
+      // page would return the same commits again. The remaining commits will
+      // be delivered by the remote watcher.
+      FTL_LOG(WARNING) << "Too many remote commits share the same timestamp, "
+                       << "unable to paginate the backlog download.";
+    }
+
+    if (records.empty()) {
+      // If there is no remote commits to add, announce that we're done.
+      BacklogDownloaded();
+    } else {
+      // If not, fire the backlog download callback when the remote commits
+      // are downloaded.
+      DownloadBatch(std::move(records), [this] { BacklogDownloaded(); });
+    }
+
+    download_list_retrieved_ = true;
+    CheckIdle();
+    SetRemoteWatcher();
+  });
 }
 
 void PageSyncImpl::DownloadBatch(std::vector<cloud_provider::Record> records,
                                  ftl::Closure on_done) {
   FTL_DCHECK(!batch_download_);
+  size_t commit_count = records.size();
   batch_download_ = std::make_unique<BatchDownload>(
-      storage_, std::move(records), [ this, on_done = std::move(on_done) ] {
+      storage_, std::move(records), [
+        this, on_done = std::move(on_done), commit_count,
+        start = ftl::TimePoint::Now()
+      ] {
+        commits_downloaded_->Increment(commit_count);
+        download_latency_->Record(ftl::TimePoint::Now() - start);
         if (on_done) {
           on_done();
         }
@@ -216,6 +329,7 @@ void PageSyncImpl::DownloadBatch(std::vector<cloud_provider::Record> records,
         }
         auto commits = std::move(commits_to_download_);
         commits_to_download_.clear();
+        pending_downloads_->Set(0);
         DownloadBatch(std::move(commits), nullptr);
       },
       [this] { HandleError("Failed to persist a remote commit in storage"); });
@@ -237,37 +351,93 @@ void PageSyncImpl::SetRemoteWatcher() {
 }
 
 void PageSyncImpl::EnqueueUpload(
-    std::unique_ptr<const storage::Commit> commit) {
-  // If there are no commits currently being uploaded, start the upload after
-  // enqueing this one.
-  const bool start_after_adding = commit_uploads_.empty();
-
-  commit_uploads_.emplace(
-      storage_, cloud_provider_, std::move(commit),
-      [this] {
+    std::vector<std::unique_ptr<const storage::Commit>> commits) {
+  // Commits available at the same time are uploaded together, in batches of at
+  // most kMaxCommitsPerUpload commits.
+  for (size_t i = 0; i < commits.size(); i += kMaxCommitsPerUpload) {
+    size_t batch_end = std::min(i + kMaxCommitsPerUpload, commits.size());
+    std::vector<std::unique_ptr<const storage::Commit>> batch;
+    batch.reserve(batch_end - i);
+    std::move(commits.begin() + i, commits.begin() + batch_end,
+              std::back_inserter(batch));
+    EnqueueBatchUpload(std::move(batch));
+  }
+}
+
+void PageSyncImpl::EnqueueBatchUpload(
+    std::vector<std::unique_ptr<const storage::Commit>> commits) {
+  const uint64_t upload_index = first_upload_index_ + commit_uploads_.size();
+  const size_t commit_count = commits.size();
+
+  commit_uploads_.emplace_back(
+      storage_, cloud_provider_, &object_upload_queue_, std::move(commits),
+      [ this, upload_index, commit_count, start = ftl::TimePoint::Now() ] {
+        // Only the first upload in the queue is allowed to upload its commits.
+        FTL_DCHECK(upload_index == first_upload_index_);
         // Upload succeeded, reset the backoff delay.
         backoff_->Reset();
-
-        commit_uploads_.pop();
-        if (!commit_uploads_.empty()) {
-          commit_uploads_.front().Start();
-        } else {
+        SetConnectionLost(false);
+        commits_uploaded_->Increment(commit_count);
+        upload_latency_->Record(ftl::TimePoint::Now() - start);
+
+        commit_uploads_.pop_front();
+        first_upload_index_++;
+        pending_uploads_->Set(commit_uploads_.size());
+        if (commit_uploads_.empty()) {
           CheckIdle();
+          return;
+        }
+        if (commit_uploads_.size() >= kMaxPipelinedCommitUploads) {
+          commit_uploads_[kMaxPipelinedCommitUploads - 1].Start();
         }
+        commit_uploads_.front().ReleaseCommits();
       },
-      [this] {
+      [this, upload_index] {
         FTL_LOG(WARNING)
             << "Uploading a commit and its associated objects failed "
             << "due to a connection error, retrying.";
-        Retry([this] { commit_uploads_.front().Start(); });
+        upload_retries_->Increment();
+        Retry([this, upload_index] {
+          // Uploads are only removed from the queue once they succeed, so the
+          // failed upload is still in the queue.
+          FTL_DCHECK(upload_index >= first_upload_index_);
+          commit_uploads_[upload_index - first_upload_index_].Start();
+        });
       });
 
-  if (start_after_adding) {
-    commit_uploads_.front().Start();
+  pending_uploads_->Set(commit_uploads_.size());
+
+  // Commits are uploaded in order: the commits of each upload are only
+  // uploaded once the previous ones are. The objects of the next uploads in the
+  // queue are uploaded in the meantime.
+  if (commit_uploads_.size() > 1) {
+    commit_uploads_.back().HoldCommits();
+  }
+  if (commit_uploads_.size() <= kMaxPipelinedCommitUploads) {
+    commit_uploads_.back().Start();
+  }
+}
+
+void PageSyncImpl::SetConnectionLost(bool connection_lost) {
+  if (connection_lost_ == connection_lost) {
+    return;
+  }
+  connection_lost_ = connection_lost;
+  UpdatePrefetchPaused();
+}
+
+void PageSyncImpl::UpdatePrefetchPaused() {
+  bool paused = errored_ || prefetch_paused_ || connection_lost_ ||
+                foreground_downloads_ > 0;
+  if (paused != prefetcher_.IsPaused()) {
+    prefetcher_.SetPaused(paused);
   }
 }
 
 void PageSyncImpl::Retry(ftl::Closure callable) {
+  // Retries are only scheduled for network errors: stop prefetching until the
+  // cloud is reachable again.
+  SetConnectionLost(true);
   task_runner_->PostDelayedTask(
       [
         weak_this = weak_factory_.GetWeakPtr(), callable = std::move(callable)
@@ -288,12 +458,17 @@ void PageSyncImpl::HandleError(const char error_description[]) {
     cloud_provider_->UnwatchCommits(this);
   }
   storage_->SetSyncDelegate(nullptr);
+  prefetcher_.SetPaused(true);
   on_error_();
   errored_ = true;
 }
 
 void PageSyncImpl::CheckIdle() {
-  if (on_idle_ && IsIdle()) {
+  if (!IsIdle()) {
+    return;
+  }
+  prefetcher_.OnSyncIdle();
+  if (on_idle_) {
     on_idle_();
   }
 }
@@ -5,15 +5,20 @@
 #ifndef APPS_LEDGER_SRC_CLOUD_SYNC_IMPL_PAGE_SYNC_IMPL_H_
 #define APPS_LEDGER_SRC_CLOUD_SYNC_IMPL_PAGE_SYNC_IMPL_H_
 
+#include <deque>
 #include <functional>
-#include <queue>
+#include <vector>
 
 #include "apps/ledger/src/backoff/backoff.h"
 #include "apps/ledger/src/cloud_provider/public/cloud_provider.h"
 #include "apps/ledger/src/cloud_provider/public/commit_watcher.h"
 #include "apps/ledger/src/cloud_sync/impl/batch_download.h"
 #include "apps/ledger/src/cloud_sync/impl/commit_upload.h"
+#include "apps/ledger/src/cloud_sync/impl/lazy_prefetcher.h"
+#include "apps/ledger/src/cloud_sync/impl/object_upload_queue.h"
 #include "apps/ledger/src/cloud_sync/public/page_sync.h"
+#include "apps/ledger/src/cloud_sync/public/prefetch_policy.h"
+#include "apps/ledger/src/metrics/metrics_registry.h"
 #include "apps/ledger/src/storage/public/commit_watcher.h"
 #include "apps/ledger/src/storage/public/page_storage.h"
 #include "apps/ledger/src/storage/public/page_sync_delegate.h"
@@ -28,17 +33,28 @@ namespace cloud_sync {
 //
 // Contract: commits are uploaded in the same order as storage delivers them.
 // The backlog of unsynced commits is uploaded first, then we upload commits
-// delivered through storage watcher in the notification order.
+// delivered through storage watcher in the notification order. Commits
+// available at the same time, such as the backlog, are uploaded in batches. The
+// objects referenced by the next commits in the queue are uploaded while the
+// previous commits are being uploaded.
 //
 // Conversely for the remote commits: the backlog of remote commits is
-// downloaded first, then a cloud watcher is set to track new remote commits
-// appearing in the cloud provider. Remote commits are added to storage in the
-// order in which they were added to the cloud provided.
+// downloaded first, page by page, then a cloud watcher is set to track new
+// remote commits appearing in the cloud provider. Remote commits are added to
+// storage in the order in which they were added to the cloud provided.
 //
 // In order to track which remote commits were already fetched, we keep track of
 // the server-side timestamp of the last commit we added to storage. As this
 // information needs to be persisted through reboots, we store the timestamp
-// itself in storage using a dedicated API (Get/SetSyncMetadata()).
+// itself in storage using a dedicated API (Get/SetSyncMetadata()). The
+// timestamp is persisted after each page of the backlog, so that an interrupted
+// backlog download resumes from the last page added to storage.
+//
+// The values of the LAZY entries introduced by remote commits are downloaded
+// in the background by a LazyPrefetcher, according to the given prefetch
+// policy. Prefetching is paused while a client waits for the download of an
+// object, after a network error until the next request to the cloud succeeds,
+// and while SetPrefetchPaused(true) is in effect.
 //
 // Recoverable errors (such as network errors) are automatically retried with
 // the given backoff policy, using the given task runner to schedule the tasks.
@@ -49,6 +65,9 @@ namespace cloud_sync {
 // Unrecoverable errors (such as internal errors accessing the storage) cause
 // the page sync to stop, in which case the client is notified using the given
 // error callback.
+//
+// The upload and download queues and latencies, and the activity of the
+// prefetcher, are recorded in |metrics|, if not null.
 class PageSyncImpl : public PageSync,
                      public storage::CommitWatcher,
                      public storage::PageSyncDelegate,
@@ -57,8 +76,10 @@ class PageSyncImpl : public PageSync,
   PageSyncImpl(ftl::RefPtr<ftl::TaskRunner> task_runner,
                storage::PageStorage* storage,
                cloud_provider::CloudProvider* cloud_provider,
+               PrefetchPolicy prefetch_policy,
                std::unique_ptr<backoff::Backoff> backoff,
-               ftl::Closure on_error);
+               ftl::Closure on_error,
+               metrics::MetricsRegistry* metrics = nullptr);
   ~PageSyncImpl() override;
 
   // PageSync:
@@ -70,6 +91,12 @@ class PageSyncImpl : public PageSync,
 
   void SetOnBacklogDownloaded(ftl::Closure on_backlog_downloaded) override;
 
+  void SetPrefetchPaused(bool paused) override;
+
+  // Returns whether the background download of LAZY values is paused, either
+  // through SetPrefetchPaused() or because of the state of sync.
+  bool IsPrefetchPaused() const { return prefetcher_.IsPaused(); }
+
   // storage::CommitWatcher:
   void OnNewCommits(
       const std::vector<std::unique_ptr<const storage::Commit>>& commits,
@@ -77,6 +104,7 @@ class PageSyncImpl : public PageSync,
 
   // storage::PageSyncDelegate:
   void GetObject(storage::ObjectIdView object_id,
+                 storage::DownloadPriority priority,
                  std::function<void(storage::Status status,
                                     uint64_t size,
                                     mx::socket data)> callback) override;
@@ -94,13 +122,23 @@ class PageSyncImpl : public PageSync,
   // watcher upon success.
   void DownloadBacklog();
 
+  // Downloads the page of the backlog of remote commits starting at the given
+  // timestamp, then the following pages.
+  void DownloadBacklogPage(std::string min_timestamp);
+
   // Downloads the given batch of commits.
   void DownloadBatch(std::vector<cloud_provider::Record> record,
                      ftl::Closure on_done);
 
   void SetRemoteWatcher();
 
-  void EnqueueUpload(std::unique_ptr<const storage::Commit> commit);
+  // Enqueues the upload of the given commits, which must be ordered so that
+  // each commit comes after its parents.
+  void EnqueueUpload(
+      std::vector<std::unique_ptr<const storage::Commit>> commits);
+
+  void EnqueueBatchUpload(
+      std::vector<std::unique_ptr<const storage::Commit>> commits);
 
   void HandleError(const char error_description[]);
 
@@ -112,6 +150,12 @@ class PageSyncImpl : public PageSync,
   // |backoff_|, but only if |this| still is valid and |errored_| is not set.
   void Retry(ftl::Closure callable);
 
+  // Records whether the cloud is unreachable, pausing prefetching if it is.
+  void SetConnectionLost(bool connection_lost);
+
+  // Pauses or resumes the prefetcher depending on the state of sync.
+  void UpdatePrefetchPaused();
+
   ftl::RefPtr<ftl::TaskRunner> task_runner_;
   storage::PageStorage* const storage_;
   cloud_provider::CloudProvider* const cloud_provider_;
@@ -132,13 +176,36 @@ class PageSyncImpl : public PageSync,
   // ensures that sync is not reported as idle until the commits to be
   // downloaded are retrieved.
   bool download_list_retrieved_ = false;
-
+  // Set through SetPrefetchPaused().
+  bool prefetch_paused_ = false;
+  // Set when a request is retried because of a network error, until a request
+  // succeeds.
+  bool connection_lost_ = false;
+  // Number of objects being downloaded for a client waiting for them.
+  size_t foreground_downloads_ = 0;
+
+  // Uploads the objects referenced by the commits, shared between all commit
+  // uploads so that the number of concurrent object uploads is bounded.
+  ObjectUploadQueue object_upload_queue_;
   // A queue of pending commit uploads.
-  std::queue<CommitUpload> commit_uploads_;
+  std::deque<CommitUpload> commit_uploads_;
+  // Index of the first upload in |commit_uploads_| among all uploads ever
+  // enqueued.
+  uint64_t first_upload_index_ = 0;
   // The current batch of remote commits being downloaded.
   std::unique_ptr<BatchDownload> batch_download_;
   // Pending remote commits to download.
   std::vector<cloud_provider::Record> commits_to_download_;
+  // Downloads the values of the LAZY entries of the remote commits.
+  LazyPrefetcher prefetcher_;
+
+  metrics::Gauge* const pending_uploads_;
+  metrics::Counter* const commits_uploaded_;
+  metrics::Counter* const upload_retries_;
+  metrics::Histogram* const upload_latency_;
+  metrics::Gauge* const pending_downloads_;
+  metrics::Counter* const commits_downloaded_;
+  metrics::Histogram* const download_latency_;
 
   // Must be the last member field.
   ftl::WeakPtrFactory<PageSyncImpl> weak_factory_;
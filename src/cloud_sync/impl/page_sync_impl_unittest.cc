@@ -4,7 +4,10 @@
 
 #include "apps/ledger/src/cloud_sync/impl/page_sync_impl.h"
 
+#include <algorithm>
+#include <iterator>
 #include <memory>
+#include <string>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -19,6 +22,7 @@
 #include "gtest/gtest.h"
 #include "lib/ftl/functional/make_copyable.h"
 #include "lib/ftl/macros.h"
+#include "lib/ftl/strings/string_printf.h"
 #include "lib/mtl/socket/strings.h"
 #include "lib/mtl/tasks/message_loop.h"
 
@@ -84,6 +88,11 @@ class TestPageStorage : public storage::test::PageStorageEmptyImpl {
       std::vector<PageStorage::CommitIdAndBytes> ids_and_bytes,
       std::function<void(storage::Status status)> callback) override {
     add_commits_from_sync_calls++;
+    std::vector<storage::CommitId> ids;
+    for (const auto& commit : ids_and_bytes) {
+      ids.push_back(commit.id);
+    }
+    added_commit_ids.push_back(std::move(ids));
 
     if (should_fail_add_commit_from_sync) {
       message_loop_->task_runner()->PostTask(
@@ -164,6 +173,8 @@ class TestPageStorage : public storage::test::PageStorageEmptyImpl {
   bool should_delay_add_commit_confirmation = false;
   std::vector<ftl::Closure> delayed_add_commit_confirmations;
   unsigned int add_commits_from_sync_calls = 0u;
+  // Ids of the commits passed to each AddCommitsFromSync() call.
+  std::vector<std::vector<storage::CommitId>> added_commit_ids;
 
   std::set<storage::CommitId> commits_marked_as_synced;
   bool watcher_set = false;
@@ -185,10 +196,12 @@ class TestCloudProvider : public cloud_provider::test::CloudProviderEmptyImpl {
 
   ~TestCloudProvider() override = default;
 
-  void AddCommit(
-      const cloud_provider::Commit& commit,
+  void AddCommits(
+      std::vector<cloud_provider::Commit> commits,
       const std::function<void(cloud_provider::Status)>& callback) override {
-    received_commits.push_back(commit.Clone());
+    add_commits_calls++;
+    std::move(commits.begin(), commits.end(),
+              std::back_inserter(received_commits));
     message_loop_->task_runner()->PostTask(
         [this, callback]() { callback(commit_status_to_return); });
   }
@@ -210,11 +223,14 @@ class TestCloudProvider : public cloud_provider::test::CloudProviderEmptyImpl {
     watcher_removed = true;
   }
 
-  void GetCommits(const std::string& min_timestamp,
-                  std::function<void(cloud_provider::Status,
-                                     std::vector<cloud_provider::Record>)>
-                      callback) override {
+  void GetCommitsPage(const std::string& min_timestamp,
+                      size_t max_count,
+                      std::function<void(cloud_provider::Status,
+                                         std::vector<cloud_provider::Record>)>
+                          callback) override {
     get_commits_calls++;
+    get_commits_min_timestamps.push_back(min_timestamp);
+    get_commits_max_counts.push_back(max_count);
     if (should_fail_get_commits) {
       message_loop_->task_runner()->PostTask([callback]() {
         callback(cloud_provider::Status::NETWORK_ERROR, {});
@@ -222,16 +238,31 @@ class TestCloudProvider : public cloud_provider::test::CloudProviderEmptyImpl {
       return;
     }
 
-    message_loop_->task_runner()->PostTask([this, callback]() {
-      callback(cloud_provider::Status::OK, std::move(records_to_return));
-    });
+    message_loop_->task_runner()->PostTask(
+        [this, min_timestamp, max_count, callback]() {
+          // As the cloud, return the first records with a timestamp not
+          // smaller than |min_timestamp|.
+          std::vector<cloud_provider::Record> page;
+          for (const auto& record : records_to_return) {
+            if (page.size() == max_count) {
+              break;
+            }
+            if (record.timestamp >= min_timestamp) {
+              page.push_back(cloud_provider::Record(record.commit.Clone(),
+                                                    record.timestamp));
+            }
+          }
+          callback(cloud_provider::Status::OK, std::move(page));
+        });
   }
 
   void GetObject(cloud_provider::ObjectIdView object_id,
+                 ledger::RequestPriority priority,
                  std::function<void(cloud_provider::Status status,
                                     uint64_t size,
                                     mx::socket data)> callback) override {
     get_object_calls++;
+    get_object_priorities.push_back(priority);
     if (should_fail_get_object) {
       message_loop_->task_runner()->PostTask([callback]() {
         callback(cloud_provider::Status::NETWORK_ERROR, 0, mx::socket());
@@ -249,6 +280,7 @@ class TestCloudProvider : public cloud_provider::test::CloudProviderEmptyImpl {
 
   bool should_fail_get_commits = false;
   bool should_fail_get_object = false;
+  // Records to be returned from GetCommitsPage() calls, sorted by timestamp.
   std::vector<cloud_provider::Record> records_to_return;
   std::vector<cloud_provider::Record> notifications_to_deliver;
   cloud_provider::Status commit_status_to_return = cloud_provider::Status::OK;
@@ -256,7 +288,11 @@ class TestCloudProvider : public cloud_provider::test::CloudProviderEmptyImpl {
 
   unsigned int watch_commits_calls = 0u;
   unsigned int get_commits_calls = 0u;
+  std::vector<std::string> get_commits_min_timestamps;
+  std::vector<size_t> get_commits_max_counts;
   unsigned int get_object_calls = 0u;
+  std::vector<ledger::RequestPriority> get_object_priorities;
+  unsigned int add_commits_calls = 0u;
   std::vector<cloud_provider::Commit> received_commits;
   bool watcher_removed = false;
 
@@ -289,6 +325,7 @@ class PageSyncImplTest : public test::TestWithMessageLoop {
         page_sync_(message_loop_.task_runner(),
                    &storage_,
                    &cloud_provider_,
+                   PrefetchPolicy(),
                    std::make_unique<TestBackoff>(&backoff_get_next_calls_),
                    [this] {
                      EXPECT_FALSE(error_callback_called_);
@@ -331,6 +368,8 @@ TEST_F(PageSyncImplTest, UploadBacklog) {
   EXPECT_EQ(2u, storage_.commits_marked_as_synced.size());
   EXPECT_EQ(1u, storage_.commits_marked_as_synced.count("id1"));
   EXPECT_EQ(1u, storage_.commits_marked_as_synced.count("id2"));
+  // The backlog is uploaded in a single request.
+  EXPECT_EQ(1u, cloud_provider_.add_commits_calls);
 }
 
 // Verfies that the new commits that PageSync is notified about through storage
@@ -422,6 +461,38 @@ TEST_F(PageSyncImplTest, RetryUpload) {
   EXPECT_EQ(5, backoff_get_next_calls_);
 }
 
+// Verifies that when the upload of a commit fails, the next commits are not
+// uploaded before it.
+TEST_F(PageSyncImplTest, RetryUploadKeepsCommitOrder) {
+  storage_.unsynced_commits_to_return.push_back(
+      std::make_unique<const TestCommit>("id1", "content1"));
+  cloud_provider_.commit_status_to_return =
+      cloud_provider::Status::NETWORK_ERROR;
+  page_sync_.Start();
+
+  storage_.new_commits_to_return["id2"] =
+      std::make_unique<const TestCommit>("id2", "content2");
+  page_sync_.OnNewCommits(TestCommit::AsList("id2", "content2"),
+                          storage::ChangeSource::LOCAL);
+
+  // Let the first two attempts to upload the first commit fail.
+  message_loop_.SetAfterTaskCallback([this] {
+    if (cloud_provider_.received_commits.size() == 3u) {
+      cloud_provider_.commit_status_to_return = cloud_provider::Status::OK;
+    }
+    if (storage_.commits_marked_as_synced.size() == 2u) {
+      message_loop_.PostQuitTask();
+    }
+  });
+  EXPECT_FALSE(RunLoopWithTimeout());
+
+  ASSERT_EQ(4u, cloud_provider_.received_commits.size());
+  for (size_t i = 0; i < 3u; ++i) {
+    EXPECT_EQ("id1", cloud_provider_.received_commits[i].id);
+  }
+  EXPECT_EQ("id2", cloud_provider_.received_commits[3].id);
+}
+
 // Verifies that the on idle callback is called when there is no pending upload
 // tasks.
 TEST_F(PageSyncImplTest, UploadIdleCallback) {
@@ -520,6 +591,78 @@ TEST_F(PageSyncImplTest, DownloadBacklog) {
   EXPECT_EQ(1, on_backlog_downloaded_calls);
 }
 
+// Verifies that a backlog of remote commits bigger than a single page is
+// retrieved in multiple pages, each added to storage before retrieving the next
+// one.
+TEST_F(PageSyncImplTest, DownloadBacklogInPages) {
+  const size_t commit_count = 250;
+  for (size_t i = 0; i < commit_count; ++i) {
+    std::string suffix = ftl::StringPrintf("%03" PRIuMAX, i);
+    cloud_provider_.records_to_return.push_back(cloud_provider::Record(
+        cloud_provider::Commit("id" + suffix, "content" + suffix, {}),
+        "ts" + suffix));
+  }
+
+  int on_backlog_downloaded_calls = 0;
+  page_sync_.SetOnBacklogDownloaded(
+      [&on_backlog_downloaded_calls] { on_backlog_downloaded_calls++; });
+  page_sync_.SetOnIdle([this] { message_loop_.PostQuitTask(); });
+  page_sync_.Start();
+  EXPECT_FALSE(RunLoopWithTimeout());
+
+  EXPECT_EQ(commit_count, storage_.received_commits.size());
+  EXPECT_EQ("ts249", storage_.sync_metadata);
+  EXPECT_EQ(1, on_backlog_downloaded_calls);
+  EXPECT_EQ(1u, cloud_provider_.watch_commits_calls);
+
+  // Each page is added to storage separately, and the next page is retrieved
+  // starting at the timestamp of the last commit of the previous one, which is
+  // left out of the first page.
+  size_t page_size = cloud_provider_.get_commits_max_counts.front();
+  ASSERT_LT(page_size, commit_count);
+  EXPECT_LT(1u, storage_.add_commits_from_sync_calls);
+  EXPECT_EQ(storage_.add_commits_from_sync_calls,
+            cloud_provider_.get_commits_calls);
+  EXPECT_EQ("", cloud_provider_.get_commits_min_timestamps[0]);
+  EXPECT_EQ(ftl::StringPrintf("ts%03" PRIuMAX, page_size - 1),
+            cloud_provider_.get_commits_min_timestamps[1]);
+  EXPECT_EQ(page_size - 1, storage_.added_commit_ids[0].size());
+}
+
+// Verifies that commits uploaded together, which share the same timestamp, are
+// added to storage together even if they cross the boundary of a backlog page.
+TEST_F(PageSyncImplTest, DownloadBacklogPageDoesNotSplitBatches) {
+  const size_t single_commit_count = 95;
+  const size_t batch_size = 10;
+  for (size_t i = 0; i < single_commit_count + batch_size; ++i) {
+    std::string suffix = ftl::StringPrintf("%03" PRIuMAX, i);
+    std::string timestamp =
+        ftl::StringPrintf("ts%03" PRIuMAX, std::min(i, single_commit_count));
+    cloud_provider_.records_to_return.push_back(cloud_provider::Record(
+        cloud_provider::Commit("id" + suffix, "content" + suffix, {}),
+        std::move(timestamp)));
+  }
+
+  page_sync_.SetOnIdle([this] { message_loop_.PostQuitTask(); });
+  page_sync_.Start();
+  EXPECT_FALSE(RunLoopWithTimeout());
+
+  // The batch does not fit in the first page.
+  ASSERT_LT(cloud_provider_.get_commits_max_counts.front(),
+            single_commit_count + batch_size);
+  EXPECT_EQ(single_commit_count + batch_size,
+            storage_.received_commits.size());
+  EXPECT_EQ(ftl::StringPrintf("ts%03" PRIuMAX, single_commit_count),
+            storage_.sync_metadata);
+
+  // All commits of the batch are added in the same call.
+  ASSERT_EQ(2u, storage_.added_commit_ids.size());
+  EXPECT_EQ(single_commit_count, storage_.added_commit_ids[0].size());
+  EXPECT_EQ(batch_size, storage_.added_commit_ids[1].size());
+  EXPECT_EQ(ftl::StringPrintf("id%03" PRIuMAX, single_commit_count),
+            storage_.added_commit_ids[1].front());
+}
+
 // Verifies that callbacks are correctly run after downloading an empty backlog
 // of remote commits.
 TEST_F(PageSyncImplTest, DownloadEmptyBacklog) {
@@ -736,7 +879,7 @@ TEST_F(PageSyncImplTest, GetObject) {
   uint64_t size;
   mx::socket data;
   page_sync_.GetObject(
-      storage::ObjectIdView("object_id"),
+      storage::ObjectIdView("object_id"), storage::DownloadPriority::FOREGROUND,
       callback::Capture([this] { message_loop_.PostQuitTask(); }, &status,
                         &size, &data));
   EXPECT_FALSE(RunLoopWithTimeout());
@@ -746,6 +889,38 @@ TEST_F(PageSyncImplTest, GetObject) {
   std::string content;
   EXPECT_TRUE(mtl::BlockingCopyToString(std::move(data), &content));
   EXPECT_EQ("content", content);
+  ASSERT_EQ(1u, cloud_provider_.get_object_priorities.size());
+  EXPECT_EQ(ledger::RequestPriority::INTERACTIVE,
+            cloud_provider_.get_object_priorities[0]);
+}
+
+// Verifies that objects requested in background, such as prefetched values, are
+// downloaded with a background priority, including when the download is
+// retried.
+TEST_F(PageSyncImplTest, GetObjectInBackground) {
+  cloud_provider_.should_fail_get_object = true;
+  page_sync_.Start();
+
+  message_loop_.SetAfterTaskCallback([this] {
+    if (cloud_provider_.get_object_calls == 2u) {
+      cloud_provider_.should_fail_get_object = false;
+      cloud_provider_.objects_to_return["object_id"] = "content";
+    }
+  });
+  storage::Status status;
+  uint64_t size;
+  mx::socket data;
+  page_sync_.GetObject(
+      storage::ObjectIdView("object_id"), storage::DownloadPriority::BACKGROUND,
+      callback::Capture([this] { message_loop_.PostQuitTask(); }, &status,
+                        &size, &data));
+  EXPECT_FALSE(RunLoopWithTimeout());
+
+  EXPECT_EQ(storage::Status::OK, status);
+  ASSERT_EQ(3u, cloud_provider_.get_object_priorities.size());
+  for (auto priority : cloud_provider_.get_object_priorities) {
+    EXPECT_EQ(ledger::RequestPriority::BACKGROUND, priority);
+  }
 }
 
 // Verifies that sync retries GetObject() attempts upon connection error.
@@ -764,7 +939,7 @@ TEST_F(PageSyncImplTest, RetryGetObject) {
   uint64_t size;
   mx::socket data;
   page_sync_.GetObject(
-      storage::ObjectIdView("object_id"),
+      storage::ObjectIdView("object_id"), storage::DownloadPriority::FOREGROUND,
       callback::Capture([this] { message_loop_.PostQuitTask(); }, &status,
                         &size, &data));
   EXPECT_FALSE(RunLoopWithTimeout());
@@ -777,5 +952,48 @@ TEST_F(PageSyncImplTest, RetryGetObject) {
   EXPECT_EQ("content", content);
 }
 
+// Verifies that prefetching is paused while a client waits for an object and
+// while the cloud is unreachable.
+TEST_F(PageSyncImplTest, PausePrefetchDuringForegroundDownloads) {
+  cloud_provider_.should_fail_get_object = true;
+  page_sync_.Start();
+  EXPECT_FALSE(page_sync_.IsPrefetchPaused());
+
+  bool paused_during_retries = true;
+  message_loop_.SetAfterTaskCallback([this, &paused_during_retries] {
+    if (cloud_provider_.get_object_calls == 3u) {
+      cloud_provider_.should_fail_get_object = false;
+      cloud_provider_.objects_to_return["object_id"] = "content";
+    }
+    if (cloud_provider_.get_object_calls < 4u) {
+      paused_during_retries &= page_sync_.IsPrefetchPaused();
+    }
+  });
+  storage::Status status;
+  uint64_t size;
+  mx::socket data;
+  page_sync_.GetObject(
+      storage::ObjectIdView("object_id"), storage::DownloadPriority::FOREGROUND,
+      callback::Capture([this] { message_loop_.PostQuitTask(); }, &status,
+                        &size, &data));
+  EXPECT_TRUE(page_sync_.IsPrefetchPaused());
+  EXPECT_FALSE(RunLoopWithTimeout());
+
+  EXPECT_EQ(storage::Status::OK, status);
+  EXPECT_TRUE(paused_during_retries);
+  EXPECT_FALSE(page_sync_.IsPrefetchPaused());
+
+  // The pause requested by the client outlasts the downloads.
+  page_sync_.SetPrefetchPaused(true);
+  page_sync_.GetObject(
+      storage::ObjectIdView("object_id"), storage::DownloadPriority::FOREGROUND,
+      callback::Capture([this] { message_loop_.PostQuitTask(); }, &status,
+                        &size, &data));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_TRUE(page_sync_.IsPrefetchPaused());
+  page_sync_.SetPrefetchPaused(false);
+  EXPECT_FALSE(page_sync_.IsPrefetchPaused());
+}
+
 }  // namespace
 }  // namespace cloud_sync
@@ -43,6 +43,10 @@ class PageSync {
   // most once and only before calling Start().
   virtual void SetOnBacklogDownloaded(ftl::Closure on_backlog_downloaded) = 0;
 
+  // Pauses or resumes the background download of LAZY values. Downloads in
+  // progress when pausing are completed, but no new one is started.
+  virtual void SetPrefetchPaused(bool paused) = 0;
+
  private:
   FTL_DISALLOW_COPY_AND_ASSIGN(PageSync);
 };
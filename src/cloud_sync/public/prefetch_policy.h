@@ -0,0 +1,40 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_CLOUD_SYNC_PUBLIC_PREFETCH_POLICY_H_
+#define APPS_LEDGER_SRC_CLOUD_SYNC_PUBLIC_PREFETCH_POLICY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+namespace cloud_sync {
+
+// Governs the background download of the values of LAZY entries introduced by
+// remote commits, so that they are available locally before being fetched.
+struct PrefetchPolicy {
+  // Whether values are prefetched at all.
+  bool enabled = false;
+  // Values of entries whose key starts with one of these prefixes are
+  // prefetched. An empty prefix allows all keys.
+  std::vector<std::string> key_prefixes;
+  // Maximum number of bytes downloaded by the prefetcher of a page.
+  uint64_t max_bytes = 10 * 1024 * 1024;
+  // If true, values are only prefetched while sync is otherwise idle, so that
+  // prefetching does not compete with the upload and download of commits.
+  bool only_when_idle = true;
+  // Number of recently fetched key prefixes whose values are prefetched in
+  // addition to |key_prefixes|. When a client fetches the value of an entry
+  // that was not prefetched, the key of the entry up to and including the last
+  // occurrence of |prefix_separator| is added to the recent prefixes. 0
+  // disables the heuristic.
+  size_t max_recent_prefixes = 0;
+  std::string prefix_separator = "/";
+};
+
+}  // namespace cloud_sync
+
+#endif  // APPS_LEDGER_SRC_CLOUD_SYNC_PUBLIC_PREFETCH_POLICY_H_
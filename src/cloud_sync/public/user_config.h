@@ -7,6 +7,8 @@
 
 #include <string>
 
+#include "apps/ledger/src/cloud_sync/public/prefetch_policy.h"
+
 namespace cloud_sync {
 
 // Sync configuration for a particular user.
@@ -16,6 +18,8 @@ struct UserConfig {
   std::string server_id;
   // The id of the user.
   std::string user_id;
+  // Policy of the background download of LAZY values.
+  PrefetchPolicy prefetch_policy;
 };
 
 }  // namespace cloud_sync
@@ -27,5 +27,9 @@ void PageSyncEmptyImpl::SetOnBacklogDownloaded(
   FTL_NOTIMPLEMENTED();
 }
 
+void PageSyncEmptyImpl::SetPrefetchPaused(bool paused) {
+  FTL_NOTIMPLEMENTED();
+}
+
 }  // namespace test
 }  // namespace cloud_sync
@@ -100,12 +100,29 @@ bool CoroutineServiceImpl::CoroutineHandlerImpl::DoYield() {
   return interrupted_;
 }
 
-CoroutineServiceImpl::CoroutineServiceImpl() {}
+CoroutineServiceImpl::CoroutineServiceImpl(metrics::MetricsRegistry* metrics)
+    : memory_budget_(metrics::OrUnreported(metrics)->memory_budget()),
+      stacks_memory_(metrics, "memory_coroutine_stacks_bytes") {
+  if (memory_budget_) {
+    memory_budget_->AddTrimmable(this);
+  }
+}
 
 CoroutineServiceImpl::~CoroutineServiceImpl() {
+  if (memory_budget_) {
+    memory_budget_->RemoveTrimmable(this);
+  }
   while (!handlers_.empty()) {
     handlers_[0]->Continue(true);
   }
+  Trim();
+}
+
+void CoroutineServiceImpl::Trim() {
+  for (const auto& stack : available_stack_) {
+    stacks_memory_.Add(-static_cast<int64_t>(stack->stack_size()));
+  }
+  available_stack_.clear();
 }
 
 void CoroutineServiceImpl::StartCoroutine(
@@ -113,6 +130,7 @@ void CoroutineServiceImpl::StartCoroutine(
   std::unique_ptr<context::Stack> stack;
   if (available_stack_.empty()) {
     stack = std::make_unique<context::Stack>();
+    stacks_memory_.Add(stack->stack_size());
   } else {
     stack = std::move(available_stack_.back());
     available_stack_.pop_back();
@@ -125,6 +143,8 @@ void CoroutineServiceImpl::StartCoroutine(
     if (available_stack_.size() < kMaxAvailableStacks) {
       stack->Release();
       available_stack_.push_back(std::move(stack));
+    } else {
+      stacks_memory_.Add(-static_cast<int64_t>(stack->stack_size()));
     }
     handlers_.erase(std::remove_if(
         handlers_.begin(), handlers_.end(),
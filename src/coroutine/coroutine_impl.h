@@ -9,6 +9,7 @@
 #include <vector>
 
 #include "apps/ledger/src/coroutine/coroutine.h"
+#include "apps/ledger/src/metrics/memory_budget.h"
 #include "lib/ftl/macros.h"
 
 namespace context {
@@ -17,17 +18,27 @@ class Stack;
 
 namespace coroutine {
 
-class CoroutineServiceImpl : public CoroutineService {
+// Implementation of CoroutineService. The stacks of the coroutines are pooled
+// for reuse, the pool is released when the memory budget of |metrics|, if any,
+// is exceeded.
+class CoroutineServiceImpl : public CoroutineService,
+                             public metrics::MemoryBudget::Trimmable {
  public:
-  CoroutineServiceImpl();
+  explicit CoroutineServiceImpl(metrics::MetricsRegistry* metrics = nullptr);
   ~CoroutineServiceImpl() override;
 
   // CoroutineService.
   void StartCoroutine(std::function<void(CoroutineHandler*)> runnable) override;
 
+  // metrics::MemoryBudget::Trimmable:
+  void Trim() override;
+
  private:
   class CoroutineHandlerImpl;
 
+  metrics::MemoryBudget* const memory_budget_;
+  // Memory of the stacks of the running coroutines and of the pool.
+  const metrics::MemoryAccount stacks_memory_;
   std::vector<std::unique_ptr<context::Stack>> available_stack_;
   std::vector<std::unique_ptr<CoroutineHandlerImpl>> handlers_;
 
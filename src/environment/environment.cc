@@ -5,35 +5,44 @@
 #include "apps/ledger/src/environment/environment.h"
 
 #include "apps/ledger/src/coroutine/coroutine_impl.h"
-#include "lib/mtl/tasks/message_loop.h"
-#include "lib/mtl/threading/create_thread.h"
 
 namespace ledger {
 
 Environment::Environment(ftl::RefPtr<ftl::TaskRunner> main_runner,
                          NetworkService* network_service,
                          ftl::TimeDelta max_merging_delay,
-                         ftl::RefPtr<ftl::TaskRunner> io_runner)
+                         ftl::RefPtr<ftl::TaskRunner> io_runner,
+                         metrics::MetricsRegistry* metrics)
     : main_runner_(std::move(main_runner)),
       network_service_(network_service),
       max_merging_delay_(max_merging_delay),
-      coroutine_service_(std::make_unique<coroutine::CoroutineServiceImpl>()),
+      coroutine_service_(
+          std::make_unique<coroutine::CoroutineServiceImpl>(metrics)),
+      metrics_(metrics::OrUnreported(metrics)),
       io_runner_(std::move(io_runner)) {
   FTL_DCHECK(main_runner_);
 }
 
-Environment::~Environment() {
-  if (io_thread_.joinable()) {
-    io_runner_->PostTask([] { mtl::MessageLoop::GetCurrent()->QuitNow(); });
-    io_thread_.join();
+Environment::~Environment() {}
+
+IOPool* Environment::GetIOPool() {
+  if (!io_pool_) {
+    if (io_runner_) {
+      io_pool_ = std::make_unique<IOPool>(io_runner_);
+    } else {
+      io_pool_ = std::make_unique<IOPool>(IOPool::kDefaultThreadCount,
+                                          metrics_->GetChild("io"));
+    }
   }
+  return io_pool_.get();
 }
 
-const ftl::RefPtr<ftl::TaskRunner> Environment::GetIORunner() {
-  if (!io_runner_) {
-    io_thread_ = mtl::CreateThread(&io_runner_, "io thread");
+WorkerPool* Environment::GetWorkerPool() {
+  if (!worker_pool_) {
+    worker_pool_ = std::make_unique<WorkerPool>(
+        WorkerPool::DefaultThreadCount(), metrics_->GetChild("workers"));
   }
-  return io_runner_;
+  return worker_pool_.get();
 }
 
 }  // namespace ledger
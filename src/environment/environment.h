@@ -5,9 +5,10 @@
 #ifndef APPS_LEDGER_SRC_ENVIRONMENT_ENVIRONMENT_H_
 #define APPS_LEDGER_SRC_ENVIRONMENT_ENVIRONMENT_H_
 
-#include <thread>
-
 #include "apps/ledger/src/coroutine/coroutine.h"
+#include "apps/ledger/src/environment/io_pool.h"
+#include "apps/ledger/src/environment/worker_pool.h"
+#include "apps/ledger/src/metrics/metrics_registry.h"
 #include "apps/ledger/src/network/network_service.h"
 #include "lib/ftl/macros.h"
 #include "lib/ftl/memory/weak_ptr.h"
@@ -17,12 +18,18 @@
 namespace ledger {
 
 // Environment for the ledger application.
+//
+// |metrics| is the root registry in which the components of the application
+// record their metrics. If null, metrics are recorded but not reported. The
+// memory accounted by the components is charged to the memory budget of
+// |metrics|, if any.
 class Environment {
  public:
   Environment(ftl::RefPtr<ftl::TaskRunner> main_runner,
               NetworkService* network_service,
               ftl::TimeDelta max_merging_delay,
-              ftl::RefPtr<ftl::TaskRunner> io_runner = nullptr);
+              ftl::RefPtr<ftl::TaskRunner> io_runner = nullptr,
+              metrics::MetricsRegistry* metrics = nullptr);
   ~Environment();
 
   const ftl::RefPtr<ftl::TaskRunner> main_runner() { return main_runner_; }
@@ -31,19 +38,25 @@ class Environment {
   coroutine::CoroutineService* coroutine_service() {
     return coroutine_service_.get();
   }
+  metrics::MetricsRegistry* metrics() { return metrics_; }
+
+  // Returns the pool of I/O threads, which should be used to access the file
+  // system. If an |io_runner| was given, all I/O runs on it.
+  IOPool* GetIOPool();
 
-  // Returns a TaskRunner allowing to access the I/O thread. The I/O thread
-  // should be used to access the file system.
-  const ftl::RefPtr<ftl::TaskRunner> GetIORunner();
+  // Returns the pool of worker threads on which CPU-bound work should be run.
+  WorkerPool* GetWorkerPool();
 
  private:
   ftl::RefPtr<ftl::TaskRunner> main_runner_;
   NetworkService* const network_service_;
   ftl::TimeDelta max_merging_delay_;
   std::unique_ptr<coroutine::CoroutineService> coroutine_service_;
+  metrics::MetricsRegistry* const metrics_;
 
-  std::thread io_thread_;
   ftl::RefPtr<ftl::TaskRunner> io_runner_;
+  std::unique_ptr<IOPool> io_pool_;
+  std::unique_ptr<WorkerPool> worker_pool_;
 
   FTL_DISALLOW_COPY_AND_ASSIGN(Environment);
 };
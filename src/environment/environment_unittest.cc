@@ -21,7 +21,9 @@ TEST(Environment, GivenIOThread) {
   Environment env(loop.task_runner(), nullptr, ftl::TimeDelta(),
                   loop.task_runner());
 
-  EXPECT_EQ(loop.task_runner(), env.GetIORunner());
+  IOPool* io_pool = env.GetIOPool();
+  EXPECT_EQ(1u, io_pool->thread_count());
+  EXPECT_EQ(loop.task_runner(), io_pool->GetRunner("page"));
 }
 
 TEST(Environment, DefaultIOThread) {
@@ -29,11 +31,20 @@ TEST(Environment, DefaultIOThread) {
   int value = 0;
   {
     Environment env(loop.task_runner(), nullptr, ftl::TimeDelta());
-    auto io_runner = env.GetIORunner();
+    auto io_runner = env.GetIOPool()->GetRunner("page");
     io_runner->PostTask([&value] { value = 1; });
   }
   EXPECT_EQ(1, value);
 }
 
+TEST(Environment, WorkerPool) {
+  mtl::MessageLoop loop;
+  Environment env(loop.task_runner(), nullptr, ftl::TimeDelta());
+  WorkerPool* worker_pool = env.GetWorkerPool();
+  ASSERT_TRUE(worker_pool);
+  EXPECT_GE(worker_pool->thread_count(), 1u);
+  EXPECT_EQ(worker_pool, env.GetWorkerPool());
+}
+
 }  // namespace
 }  // namespace ledger
@@ -0,0 +1,128 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/environment/io_pool.h"
+
+#include <functional>
+#include <string>
+#include <utility>
+
+#include "lib/ftl/logging.h"
+#include "lib/ftl/memory/ref_counted.h"
+#include "lib/ftl/strings/concatenate.h"
+#include "lib/ftl/time/time_point.h"
+#include "lib/mtl/tasks/message_loop.h"
+#include "lib/mtl/threading/create_thread.h"
+
+namespace ledger {
+
+namespace {
+
+// TaskRunner forwarding its tasks to another runner, and recording the number
+// of queued tasks, the time they wait and the time they run. Only the posted
+// tasks are measured: the work done by the message loop of the thread in
+// response to handle signals, such as draining a socket, is not.
+class InstrumentedTaskRunner : public ftl::TaskRunner {
+ public:
+  inline static ftl::RefPtr<InstrumentedTaskRunner> Create(
+      ftl::RefPtr<ftl::TaskRunner> runner,
+      metrics::MetricsRegistry* metrics) {
+    return ftl::AdoptRef(
+        new InstrumentedTaskRunner(std::move(runner), metrics));
+  }
+
+  void PostTask(ftl::Closure task) override {
+    runner_->PostTask(Instrument(std::move(task), ftl::TimePoint::Now()));
+  }
+
+  void PostTaskForTime(ftl::Closure task,
+                       ftl::TimePoint target_time) override {
+    runner_->PostTaskForTime(Instrument(std::move(task), target_time),
+                             target_time);
+  }
+
+  void PostDelayedTask(ftl::Closure task, ftl::TimeDelta delay) override {
+    runner_->PostDelayedTask(
+        Instrument(std::move(task), ftl::TimePoint::Now() + delay), delay);
+  }
+
+  bool RunsTasksOnCurrentThread() override {
+    return runner_->RunsTasksOnCurrentThread();
+  }
+
+ private:
+  FRIEND_REF_COUNTED_THREAD_SAFE(InstrumentedTaskRunner);
+
+  InstrumentedTaskRunner(ftl::RefPtr<ftl::TaskRunner> runner,
+                         metrics::MetricsRegistry* metrics)
+      : runner_(std::move(runner)),
+        queued_tasks_(metrics->GetGauge("io_posted_tasks")),
+        wait_time_(metrics->GetHistogram("io_posted_task_wait_time")),
+        run_time_(metrics->GetHistogram("io_posted_task_run_time")) {}
+  ~InstrumentedTaskRunner() override {}
+
+  // Returns a closure running |task| that is expected to run at |target_time|.
+  // The metrics are never deleted, so the closure does not need to retain this
+  // runner.
+  ftl::Closure Instrument(ftl::Closure task, ftl::TimePoint target_time) {
+    queued_tasks_->Add(1);
+    return [
+      task = std::move(task), target_time, queued_tasks = queued_tasks_,
+      wait_time = wait_time_, run_time = run_time_
+    ] {
+      queued_tasks->Add(-1);
+      ftl::TimePoint start = ftl::TimePoint::Now();
+      wait_time->Record(start - target_time);
+      task();
+      run_time->Record(ftl::TimePoint::Now() - start);
+    };
+  }
+
+  const ftl::RefPtr<ftl::TaskRunner> runner_;
+  metrics::Gauge* const queued_tasks_;
+  metrics::Histogram* const wait_time_;
+  metrics::Histogram* const run_time_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(InstrumentedTaskRunner);
+};
+
+}  // namespace
+
+constexpr size_t IOPool::kDefaultThreadCount;
+
+IOPool::IOPool(size_t thread_count, metrics::MetricsRegistry* metrics) {
+  FTL_DCHECK(thread_count > 0);
+  metrics = metrics::OrUnreported(metrics);
+  for (size_t i = 0; i < thread_count; ++i) {
+    ftl::RefPtr<ftl::TaskRunner> runner;
+    threads_.push_back(mtl::CreateThread(
+        &runner, ftl::Concatenate({"io thread ", std::to_string(i)})));
+    runners_.push_back(InstrumentedTaskRunner::Create(runner, metrics));
+    thread_runners_.push_back(std::move(runner));
+  }
+}
+
+IOPool::IOPool(ftl::RefPtr<ftl::TaskRunner> runner) {
+  FTL_DCHECK(runner);
+  runners_.push_back(std::move(runner));
+}
+
+IOPool::~IOPool() {
+  for (const auto& runner : thread_runners_) {
+    runner->PostTask([] { mtl::MessageLoop::GetCurrent()->QuitNow(); });
+  }
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+ftl::RefPtr<ftl::TaskRunner> IOPool::GetRunner(ftl::StringView key) {
+  if (runners_.size() == 1) {
+    return runners_.front();
+  }
+  size_t index = std::hash<std::string>()(key.ToString()) % runners_.size();
+  return runners_[index];
+}
+
+}  // namespace ledger
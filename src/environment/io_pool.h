@@ -0,0 +1,63 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_ENVIRONMENT_IO_POOL_H_
+#define APPS_LEDGER_SRC_ENVIRONMENT_IO_POOL_H_
+
+#include <stddef.h>
+
+#include <thread>
+#include <vector>
+
+#include "apps/ledger/src/metrics/metrics_registry.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/ref_ptr.h"
+#include "lib/ftl/strings/string_view.h"
+#include "lib/ftl/tasks/task_runner.h"
+
+namespace ledger {
+
+// Set of I/O threads, used to access the file system. Each key, such as the
+// directory of a page, is assigned to a single thread: the tasks posted for a
+// key run in the order in which they were posted, while the tasks of different
+// keys can run in parallel.
+//
+// The number of queued tasks, the time tasks wait in the queue and the time
+// they take to run are recorded in |metrics|, if not null. These statistics
+// only cover the tasks posted to the pool, and not the asynchronous reads of
+// the sockets written to files: the whole write of an object is measured by
+// the add_object_latency histogram of the page storage.
+class IOPool {
+ public:
+  // Default number of I/O threads. Flash storage serves a few concurrent
+  // requests well, and more threads mostly add contention.
+  static constexpr size_t kDefaultThreadCount = 4;
+
+  explicit IOPool(size_t thread_count,
+                  metrics::MetricsRegistry* metrics = nullptr);
+  // Runs the tasks of all keys on |runner|. The pool does not own the thread
+  // of |runner|.
+  explicit IOPool(ftl::RefPtr<ftl::TaskRunner> runner);
+  // Runs the tasks already posted, then stops the threads.
+  ~IOPool();
+
+  size_t thread_count() const { return runners_.size(); }
+
+  // Returns the runner of the thread assigned to |key|. Can be called from any
+  // thread.
+  ftl::RefPtr<ftl::TaskRunner> GetRunner(ftl::StringView key);
+
+ private:
+  // Runners of the underlying threads, used to stop them.
+  std::vector<ftl::RefPtr<ftl::TaskRunner>> thread_runners_;
+  std::vector<std::thread> threads_;
+  // Runners returned to the clients of the pool.
+  std::vector<ftl::RefPtr<ftl::TaskRunner>> runners_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(IOPool);
+};
+
+}  // namespace ledger
+
+#endif  // APPS_LEDGER_SRC_ENVIRONMENT_IO_POOL_H_
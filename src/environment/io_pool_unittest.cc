@@ -0,0 +1,102 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/environment/io_pool.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "apps/ledger/src/test/test_with_message_loop.h"
+#include "gtest/gtest.h"
+
+namespace ledger {
+namespace {
+
+class IOPoolTest : public test::TestWithMessageLoop {
+ public:
+  IOPoolTest() {}
+
+ private:
+  FTL_DISALLOW_COPY_AND_ASSIGN(IOPoolTest);
+};
+
+TEST_F(IOPoolTest, TasksOfAKeyRunInOrder) {
+  const int kTaskCount = 100;
+  std::vector<int> order;
+  {
+    IOPool pool(4);
+    EXPECT_EQ(4u, pool.thread_count());
+    auto runner = pool.GetRunner("page");
+    EXPECT_EQ(runner, pool.GetRunner("page"));
+    for (int i = 0; i < kTaskCount; ++i) {
+      runner->PostTask([&order, i] { order.push_back(i); });
+    }
+  }
+  ASSERT_EQ(static_cast<size_t>(kTaskCount), order.size());
+  for (int i = 0; i < kTaskCount; ++i) {
+    EXPECT_EQ(i, order[i]);
+  }
+}
+
+TEST_F(IOPoolTest, KeysRunInParallel) {
+  IOPool pool(4);
+  auto first_runner = pool.GetRunner("page0");
+  ftl::RefPtr<ftl::TaskRunner> second_runner;
+  for (int i = 1; !second_runner; ++i) {
+    auto runner = pool.GetRunner("page" + std::to_string(i));
+    if (runner != first_runner) {
+      second_runner = runner;
+    }
+  }
+
+  // The task of the first key can only finish if the task of the second key
+  // runs while it is blocked.
+  std::mutex mutex;
+  std::condition_variable condition;
+  bool second_task_done = false;
+  first_runner->PostTask([this, &mutex, &condition, &second_task_done] {
+    std::unique_lock<std::mutex> lock(mutex);
+    condition.wait(lock, [&second_task_done] { return second_task_done; });
+    message_loop_.task_runner()->PostTask(
+        [this] { message_loop_.PostQuitTask(); });
+  });
+  second_runner->PostTask([&mutex, &condition, &second_task_done] {
+    std::lock_guard<std::mutex> lock(mutex);
+    second_task_done = true;
+    condition.notify_one();
+  });
+  EXPECT_FALSE(RunLoopWithTimeout());
+}
+
+TEST_F(IOPoolTest, GivenRunner) {
+  IOPool pool(message_loop_.task_runner());
+  EXPECT_EQ(1u, pool.thread_count());
+  EXPECT_EQ(message_loop_.task_runner(), pool.GetRunner("page0"));
+  EXPECT_EQ(message_loop_.task_runner(), pool.GetRunner("page1"));
+}
+
+TEST_F(IOPoolTest, Metrics) {
+  const int kTaskCount = 10;
+  metrics::MetricsRegistry registry;
+  {
+    IOPool pool(2, &registry);
+    for (int i = 0; i < kTaskCount; ++i) {
+      pool.GetRunner("page" + std::to_string(i))->PostTask([] {});
+    }
+  }
+  EXPECT_EQ(0, registry.GetGauge("io_posted_tasks")->value());
+  int64_t count;
+  int64_t sum;
+  std::vector<int64_t> buckets;
+  registry.GetHistogram("io_posted_task_wait_time")->GetValues(&count, &sum, &buckets);
+  EXPECT_EQ(kTaskCount, count);
+  registry.GetHistogram("io_posted_task_run_time")
+      ->GetValues(&count, &sum, &buckets);
+  EXPECT_EQ(kTaskCount, count);
+}
+
+}  // namespace
+}  // namespace ledger
@@ -0,0 +1,101 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_ENVIRONMENT_ORDERED_WORKER_TASKS_H_
+#define APPS_LEDGER_SRC_ENVIRONMENT_ORDERED_WORKER_TASKS_H_
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <utility>
+
+#include "apps/ledger/src/environment/worker_pool.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/ref_ptr.h"
+#include "lib/ftl/memory/weak_ptr.h"
+#include "lib/ftl/tasks/task_runner.h"
+
+namespace ledger {
+
+// Runs tasks producing a |T| concurrently on a WorkerPool, and calls the
+// replies to these tasks with their results in the order in which the tasks
+// were posted. This allows to move the encoding or the decoding of a stream of
+// messages off the main thread without reordering the stream.
+//
+// If the pool is null, tasks and replies are called synchronously.
+template <typename T>
+class OrderedWorkerTasks {
+ public:
+  // Replies are called on |reply_runner|, which must be the runner of the
+  // thread using this object.
+  OrderedWorkerTasks(WorkerPool* worker_pool,
+                     ftl::RefPtr<ftl::TaskRunner> reply_runner)
+      : worker_pool_(worker_pool),
+        reply_runner_(std::move(reply_runner)),
+        weak_factory_(this) {
+    FTL_DCHECK(!worker_pool_ || reply_runner_);
+  }
+
+  ~OrderedWorkerTasks() {}
+
+  // Runs |task| on the pool, then calls |reply| with its result once the
+  // replies to all the tasks posted before have been called. Replies are
+  // dropped if this object is deleted.
+  void PostTaskAndReply(std::function<T()> task,
+                        std::function<void(T)> reply) {
+    if (!worker_pool_) {
+      reply(task());
+      return;
+    }
+
+    // Elements of a deque are not moved when adding or removing elements at
+    // either end.
+    pending_tasks_.emplace_back();
+    PendingTask* pending_task = &pending_tasks_.back();
+    pending_task->reply = std::move(reply);
+    worker_pool_->PostTaskAndReply<T>(
+        std::move(task), reply_runner_,
+        [ weak_this = weak_factory_.GetWeakPtr(), pending_task ](T result) {
+          if (!weak_this) {
+            return;
+          }
+          pending_task->result = std::make_unique<T>(std::move(result));
+          weak_this->CallReadyReplies();
+        });
+  }
+
+ private:
+  struct PendingTask {
+    std::function<void(T)> reply;
+    // Null until the task is done.
+    std::unique_ptr<T> result;
+  };
+
+  void CallReadyReplies() {
+    auto weak_this = weak_factory_.GetWeakPtr();
+    while (!pending_tasks_.empty() && pending_tasks_.front().result) {
+      PendingTask pending_task = std::move(pending_tasks_.front());
+      pending_tasks_.pop_front();
+      pending_task.reply(std::move(*pending_task.result));
+      // The reply might have deleted this object.
+      if (!weak_this) {
+        return;
+      }
+    }
+  }
+
+  WorkerPool* const worker_pool_;
+  const ftl::RefPtr<ftl::TaskRunner> reply_runner_;
+  std::deque<PendingTask> pending_tasks_;
+
+  // This must be the last member of the class.
+  ftl::WeakPtrFactory<OrderedWorkerTasks> weak_factory_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(OrderedWorkerTasks);
+};
+
+}  // namespace ledger
+
+#endif  // APPS_LEDGER_SRC_ENVIRONMENT_ORDERED_WORKER_TASKS_H_
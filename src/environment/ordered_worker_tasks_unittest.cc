@@ -0,0 +1,78 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/environment/ordered_worker_tasks.h"
+
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "apps/ledger/src/test/test_with_message_loop.h"
+#include "gtest/gtest.h"
+
+namespace ledger {
+namespace {
+
+class OrderedWorkerTasksTest : public test::TestWithMessageLoop {
+ public:
+  OrderedWorkerTasksTest() {}
+
+ private:
+  FTL_DISALLOW_COPY_AND_ASSIGN(OrderedWorkerTasksTest);
+};
+
+TEST_F(OrderedWorkerTasksTest, RepliesInOrder) {
+  const int kTaskCount = 20;
+  WorkerPool pool(4);
+  OrderedWorkerTasks<int> tasks(&pool, message_loop_.task_runner());
+  std::vector<int> results;
+  for (int i = 0; i < kTaskCount; ++i) {
+    tasks.PostTaskAndReply(
+        [i] {
+          // Make the first tasks finish last.
+          std::this_thread::sleep_for(
+              std::chrono::milliseconds(kTaskCount - i));
+          return i;
+        },
+        [this, &results](int result) {
+          results.push_back(result);
+          if (results.size() == static_cast<size_t>(kTaskCount)) {
+            message_loop_.PostQuitTask();
+          }
+        });
+  }
+  EXPECT_FALSE(RunLoopWithTimeout());
+  ASSERT_EQ(static_cast<size_t>(kTaskCount), results.size());
+  for (int i = 0; i < kTaskCount; ++i) {
+    EXPECT_EQ(i, results[i]);
+  }
+}
+
+TEST_F(OrderedWorkerTasksTest, NoPool) {
+  OrderedWorkerTasks<int> tasks(nullptr, nullptr);
+  int result = 0;
+  tasks.PostTaskAndReply([] { return 42; },
+                         [&result](int value) { result = value; });
+  EXPECT_EQ(42, result);
+}
+
+TEST_F(OrderedWorkerTasksTest, DeleteInReply) {
+  WorkerPool pool(2);
+  auto tasks = std::make_unique<OrderedWorkerTasks<int>>(
+      &pool, message_loop_.task_runner());
+  int replies = 0;
+  tasks->PostTaskAndReply([] { return 0; }, [this, &tasks, &replies](int) {
+    ++replies;
+    tasks.reset();
+    message_loop_.PostQuitTask();
+  });
+  tasks->PostTaskAndReply([] { return 1; },
+                          [&replies](int) { ++replies; });
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(1, replies);
+}
+
+}  // namespace
+}  // namespace ledger
@@ -0,0 +1,73 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/environment/worker_pool.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "lib/ftl/logging.h"
+
+namespace ledger {
+
+WorkerPool::WorkerPool(size_t thread_count, metrics::MetricsRegistry* metrics)
+    : posted_tasks_(
+          metrics::OrUnreported(metrics)->GetCounter("worker_posted_tasks")),
+      queued_tasks_(
+          metrics::OrUnreported(metrics)->GetGauge("worker_queued_tasks")) {
+  FTL_DCHECK(thread_count > 0);
+  for (size_t i = 0; i < thread_count; ++i) {
+    threads_.emplace_back([this] { Run(); });
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    quit_ = true;
+    queued_tasks_->Add(-static_cast<int64_t>(tasks_.size()));
+    tasks_.clear();
+  }
+  task_available_.notify_all();
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+size_t WorkerPool::DefaultThreadCount() {
+  size_t cores = std::thread::hardware_concurrency();
+  return std::max<size_t>(1u, cores > 0 ? cores - 1 : 0);
+}
+
+void WorkerPool::PostTask(ftl::Closure task) {
+  posted_tasks_->Increment();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (quit_) {
+      return;
+    }
+    tasks_.push_back(std::move(task));
+    queued_tasks_->Add(1);
+  }
+  task_available_.notify_one();
+}
+
+void WorkerPool::Run() {
+  while (true) {
+    ftl::Closure task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      task_available_.wait(lock, [this] { return quit_ || !tasks_.empty(); });
+      if (quit_) {
+        return;
+      }
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+      queued_tasks_->Add(-1);
+    }
+    task();
+  }
+}
+
+}  // namespace ledger
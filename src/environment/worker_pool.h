@@ -0,0 +1,83 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_ENVIRONMENT_WORKER_POOL_H_
+#define APPS_LEDGER_SRC_ENVIRONMENT_WORKER_POOL_H_
+
+#include <stddef.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "apps/ledger/src/metrics/metrics_registry.h"
+#include "lib/ftl/functional/closure.h"
+#include "lib/ftl/functional/make_copyable.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/ref_ptr.h"
+#include "lib/ftl/tasks/task_runner.h"
+
+namespace ledger {
+
+// Pool of threads running CPU-bound work, such as encoding or hashing, off the
+// main and the I/O threads. Tasks are taken from a single queue by the first
+// idle worker: they run concurrently and in no particular order. Tasks must
+// not block on I/O.
+//
+// The number of posted, and of queued tasks are recorded in |metrics|, if not
+// null.
+class WorkerPool {
+ public:
+  explicit WorkerPool(size_t thread_count,
+                      metrics::MetricsRegistry* metrics = nullptr);
+  // Waits for the running tasks to finish. The queued tasks are dropped.
+  ~WorkerPool();
+
+  // Returns the default number of workers on this device: one per core not
+  // used by the main thread.
+  static size_t DefaultThreadCount();
+
+  size_t thread_count() const { return threads_.size(); }
+
+  // Runs |task| on one of the worker threads. Can be called from any thread.
+  void PostTask(ftl::Closure task);
+
+  // Runs |task| on one of the worker threads, then calls |callback| with its
+  // result on |reply_runner|.
+  template <typename T>
+  void PostTaskAndReply(std::function<T()> task,
+                        ftl::RefPtr<ftl::TaskRunner> reply_runner,
+                        std::function<void(T)> callback) {
+    PostTask(ftl::MakeCopyable([
+      task = std::move(task), reply_runner = std::move(reply_runner),
+      callback = std::move(callback)
+    ]() mutable {
+      T result = task();
+      reply_runner->PostTask(ftl::MakeCopyable([
+        callback = std::move(callback), result = std::move(result)
+      ]() mutable { callback(std::move(result)); }));
+    }));
+  }
+
+ private:
+  void Run();
+
+  std::mutex mutex_;
+  std::condition_variable task_available_;
+  std::deque<ftl::Closure> tasks_;
+  bool quit_ = false;
+  std::vector<std::thread> threads_;
+
+  metrics::Counter* const posted_tasks_;
+  metrics::Gauge* const queued_tasks_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(WorkerPool);
+};
+
+}  // namespace ledger
+
+#endif  // APPS_LEDGER_SRC_ENVIRONMENT_WORKER_POOL_H_
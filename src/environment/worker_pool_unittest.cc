@@ -0,0 +1,71 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/environment/worker_pool.h"
+
+#include <atomic>
+#include <string>
+
+#include "apps/ledger/src/test/test_with_message_loop.h"
+#include "gtest/gtest.h"
+
+namespace ledger {
+namespace {
+
+class WorkerPoolTest : public test::TestWithMessageLoop {
+ public:
+  WorkerPoolTest() {}
+
+ private:
+  FTL_DISALLOW_COPY_AND_ASSIGN(WorkerPoolTest);
+};
+
+TEST_F(WorkerPoolTest, RunsAllTasks) {
+  const int kTaskCount = 100;
+  std::atomic<int> count(0);
+  {
+    WorkerPool pool(4);
+    EXPECT_EQ(4u, pool.thread_count());
+    for (int i = 0; i < kTaskCount; ++i) {
+      pool.PostTask([ this, &count ] {
+        if (++count == kTaskCount) {
+          message_loop_.task_runner()->PostTask(
+              [this] { message_loop_.PostQuitTask(); });
+        }
+      });
+    }
+    EXPECT_FALSE(RunLoopWithTimeout());
+  }
+  EXPECT_EQ(kTaskCount, count.load());
+}
+
+TEST_F(WorkerPoolTest, PostTaskAndReply) {
+  WorkerPool pool(2);
+  auto main_runner = message_loop_.task_runner();
+  bool task_on_main_thread = true;
+  bool reply_on_main_thread = false;
+  std::string result;
+  pool.PostTaskAndReply<std::string>(
+      [&main_runner, &task_on_main_thread] {
+        task_on_main_thread = main_runner->RunsTasksOnCurrentThread();
+        return std::string("result");
+      },
+      main_runner,
+      [this, &main_runner, &reply_on_main_thread, &result](std::string value) {
+        reply_on_main_thread = main_runner->RunsTasksOnCurrentThread();
+        result = std::move(value);
+        message_loop_.PostQuitTask();
+      });
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_FALSE(task_on_main_thread);
+  EXPECT_TRUE(reply_on_main_thread);
+  EXPECT_EQ("result", result);
+}
+
+TEST_F(WorkerPoolTest, DefaultThreadCount) {
+  EXPECT_GE(WorkerPool::DefaultThreadCount(), 1u);
+}
+
+}  // namespace
+}  // namespace ledger
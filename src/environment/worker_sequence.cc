@@ -0,0 +1,56 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/environment/worker_sequence.h"
+
+#include <utility>
+
+#include "lib/ftl/logging.h"
+
+namespace ledger {
+
+WorkerSequence::WorkerSequence(WorkerPool* worker_pool)
+    : worker_pool_(worker_pool), state_(std::make_shared<State>()) {
+  FTL_DCHECK(worker_pool_);
+}
+
+WorkerSequence::~WorkerSequence() {}
+
+void WorkerSequence::PostTask(ftl::Closure task) {
+  {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    state_->tasks.push_back(std::move(task));
+    if (state_->running) {
+      return;
+    }
+    state_->running = true;
+  }
+  worker_pool_->PostTask([ worker_pool = worker_pool_, state = state_ ] {
+    RunNextTask(worker_pool, state);
+  });
+}
+
+void WorkerSequence::RunNextTask(WorkerPool* worker_pool,
+                                 std::shared_ptr<State> state) {
+  ftl::Closure task;
+  {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    FTL_DCHECK(state->running);
+    FTL_DCHECK(!state->tasks.empty());
+    task = std::move(state->tasks.front());
+    state->tasks.pop_front();
+  }
+  task();
+  {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    if (state->tasks.empty()) {
+      state->running = false;
+      return;
+    }
+  }
+  worker_pool->PostTask(
+      [worker_pool, state] { RunNextTask(worker_pool, std::move(state)); });
+}
+
+}  // namespace ledger
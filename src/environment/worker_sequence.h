@@ -0,0 +1,54 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_ENVIRONMENT_WORKER_SEQUENCE_H_
+#define APPS_LEDGER_SRC_ENVIRONMENT_WORKER_SEQUENCE_H_
+
+#include <deque>
+#include <memory>
+#include <mutex>
+
+#include "apps/ledger/src/environment/worker_pool.h"
+#include "lib/ftl/functional/closure.h"
+#include "lib/ftl/macros.h"
+
+namespace ledger {
+
+// Runs tasks on a WorkerPool one at a time and in the order in which they are
+// posted, so that successive tasks can share state without locking, for
+// instance to hash a stream of data. The tasks may run on different workers.
+//
+// The tasks posted before the sequence is deleted still run: they must not
+// access objects that may be deleted with it.
+class WorkerSequence {
+ public:
+  explicit WorkerSequence(WorkerPool* worker_pool);
+  ~WorkerSequence();
+
+  // Runs |task| after the tasks previously posted to this sequence. Can be
+  // called from any thread.
+  void PostTask(ftl::Closure task);
+
+ private:
+  struct State {
+    std::mutex mutex;
+    std::deque<ftl::Closure> tasks;
+    // Whether a task of the sequence is posted to the pool or running.
+    bool running = false;
+  };
+
+  // Runs the next task of the sequence, then posts itself again if more tasks
+  // are queued, so that long sequences do not hold a worker.
+  static void RunNextTask(WorkerPool* worker_pool,
+                          std::shared_ptr<State> state);
+
+  WorkerPool* const worker_pool_;
+  const std::shared_ptr<State> state_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(WorkerSequence);
+};
+
+}  // namespace ledger
+
+#endif  // APPS_LEDGER_SRC_ENVIRONMENT_WORKER_SEQUENCE_H_
@@ -0,0 +1,69 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/environment/worker_sequence.h"
+
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "apps/ledger/src/test/test_with_message_loop.h"
+#include "gtest/gtest.h"
+
+namespace ledger {
+namespace {
+
+class WorkerSequenceTest : public test::TestWithMessageLoop {
+ public:
+  WorkerSequenceTest() {}
+
+ private:
+  FTL_DISALLOW_COPY_AND_ASSIGN(WorkerSequenceTest);
+};
+
+TEST_F(WorkerSequenceTest, RunsTasksInOrder) {
+  const int kTaskCount = 20;
+  WorkerPool pool(4);
+  WorkerSequence sequence(&pool);
+  // Only accessed by the tasks of the sequence, then on the main thread once
+  // they are all done.
+  std::vector<int> results;
+  for (int i = 0; i < kTaskCount; ++i) {
+    sequence.PostTask([i, &results] {
+      // Make the first tasks the longest.
+      std::this_thread::sleep_for(std::chrono::milliseconds(kTaskCount - i));
+      results.push_back(i);
+    });
+  }
+  sequence.PostTask([this] {
+    message_loop_.task_runner()->PostTask(
+        [this] { message_loop_.PostQuitTask(); });
+  });
+  EXPECT_FALSE(RunLoopWithTimeout());
+  ASSERT_EQ(static_cast<size_t>(kTaskCount), results.size());
+  for (int i = 0; i < kTaskCount; ++i) {
+    EXPECT_EQ(i, results[i]);
+  }
+}
+
+TEST_F(WorkerSequenceTest, RunsTasksPostedBeforeDeletion) {
+  WorkerPool pool(2);
+  bool ran = false;
+  {
+    WorkerSequence sequence(&pool);
+    sequence.PostTask(
+        [] { std::this_thread::sleep_for(std::chrono::milliseconds(10)); });
+    sequence.PostTask([this, &ran] {
+      ran = true;
+      message_loop_.task_runner()->PostTask(
+          [this] { message_loop_.PostQuitTask(); });
+    });
+  }
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_TRUE(ran);
+}
+
+}  // namespace
+}  // namespace ledger
@@ -0,0 +1,178 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/fake_cloud/fake_cloud_network_service.h"
+
+#include <utility>
+
+#include "apps/ledger/src/callback/cancellable_helper.h"
+#include "lib/ftl/functional/make_copyable.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/strings/ascii.h"
+#include "lib/ftl/strings/string_view.h"
+#include "lib/mtl/socket/strings.h"
+#include "lib/mtl/vmo/strings.h"
+
+namespace fake_cloud {
+
+namespace {
+
+constexpr ftl::StringView kFirebaseHostSuffix = ".firebaseio.com";
+constexpr ftl::StringView kGcsHost = "firebasestorage.googleapis.com";
+constexpr ftl::StringView kJsonSuffix = ".json";
+
+// Components of a URL.
+struct Url {
+  std::string host;
+  std::string path;
+  std::string query;
+};
+
+bool ParseUrl(ftl::StringView url, Url* result) {
+  size_t scheme_end = url.find("://");
+  if (scheme_end == ftl::StringView::npos) {
+    return false;
+  }
+  url = url.substr(scheme_end + 3);
+  size_t query_start = url.find('?');
+  if (query_start != ftl::StringView::npos) {
+    result->query = url.substr(query_start + 1).ToString();
+    url = url.substr(0, query_start);
+  }
+  size_t path_start = url.find('/');
+  if (path_start == ftl::StringView::npos) {
+    path_start = url.size();
+  }
+  result->host = url.substr(0, path_start).ToString();
+  result->path = url.substr(path_start).ToString();
+  return true;
+}
+
+bool EndsWith(ftl::StringView value, ftl::StringView suffix) {
+  return value.size() >= suffix.size() &&
+         value.substr(value.size() - suffix.size()) == suffix;
+}
+
+// Returns the keys of the Firebase location designated by |path|.
+std::vector<std::string> GetFirebasePath(ftl::StringView path) {
+  if (EndsWith(path, kJsonSuffix)) {
+    path = path.substr(0, path.size() - kJsonSuffix.size());
+  }
+  std::vector<std::string> result;
+  while (!path.empty()) {
+    size_t end = path.find('/');
+    if (end == ftl::StringView::npos) {
+      end = path.size();
+    }
+    if (end > 0u) {
+      result.push_back(path.substr(0, end).ToString());
+    }
+    path = path.substr(std::min(end + 1, path.size()));
+  }
+  return result;
+}
+
+bool IsEventStreamRequest(const network::URLRequest& request) {
+  for (const auto& header : request.headers.storage()) {
+    if (ftl::EqualsCaseInsensitiveASCII(header->name.get(), "accept") &&
+        header->value.get() == "text/event-stream") {
+      return true;
+    }
+  }
+  return false;
+}
+
+network::URLResponsePtr MakeNotFoundResponse() {
+  network::URLResponsePtr response = network::URLResponse::New();
+  response->status_code = 404;
+  response->status_line = "HTTP/1.1 404 Not Found";
+  response->body = network::URLBody::New();
+  response->body->set_stream(mtl::WriteStringToSocket(""));
+  return response;
+}
+
+}  // namespace
+
+FakeCloudNetworkService::FakeCloudNetworkService(
+    ftl::RefPtr<ftl::TaskRunner> task_runner)
+    : task_runner_(std::move(task_runner)) {}
+
+FakeCloudNetworkService::~FakeCloudNetworkService() {}
+
+ftl::RefPtr<callback::Cancellable> FakeCloudNetworkService::Request(
+    std::function<network::URLRequestPtr()> request_factory,
+    std::function<void(network::URLResponsePtr)> callback,
+    ledger::RequestPriority priority) {
+  auto cancelled = std::make_shared<bool>(false);
+  auto cancellable =
+      callback::CancellableImpl::Create([cancelled] { *cancelled = true; });
+
+  network::URLRequestPtr request = request_factory();
+  std::function<void(std::string)> on_body = ftl::MakeCopyable([
+    this, cancelled, request = std::move(request),
+    callback = cancellable->WrapCallback(callback)
+  ](std::string body) mutable {
+    if (*cancelled) {
+      return;
+    }
+    network::URLResponsePtr response =
+        HandleRequest(*request, std::move(body));
+    response->url = request->url;
+    // Responses are always delivered asynchronously, as by the real network
+    // service.
+    task_runner_->PostTask(ftl::MakeCopyable([
+      cancelled, callback = std::move(callback),
+      response = std::move(response)
+    ]() mutable {
+      if (!*cancelled) {
+        callback(std::move(response));
+      }
+    }));
+  });
+
+  network::URLRequest* request_ptr = request.get();
+  if (!request_ptr->body) {
+    on_body("");
+  } else if (request_ptr->body->is_buffer()) {
+    std::string body;
+    if (!mtl::StringFromVmo(request_ptr->body->get_buffer(), &body)) {
+      FTL_LOG(ERROR) << "Unable to read the body of a request.";
+    }
+    on_body(std::move(body));
+  } else {
+    drainers_.emplace().Start(std::move(request_ptr->body->get_stream()),
+                              on_body);
+  }
+  return cancellable;
+}
+
+network::URLResponsePtr FakeCloudNetworkService::HandleRequest(
+    const network::URLRequest& request,
+    std::string body) {
+  Url url;
+  if (!ParseUrl(request.url.get(), &url)) {
+    FTL_LOG(ERROR) << "Invalid url: " << request.url;
+    return MakeNotFoundResponse();
+  }
+
+  if (EndsWith(url.host, kFirebaseHostSuffix)) {
+    std::unique_ptr<FakeFirebase>& firebase = firebases_[url.host];
+    if (!firebase) {
+      firebase = std::make_unique<FakeFirebase>();
+    }
+    return firebase->HandleRequest(request.method, GetFirebasePath(url.path),
+                                   url.query, IsEventStreamRequest(request),
+                                   body);
+  }
+
+  if (url.host == kGcsHost) {
+    return gcs_.HandleRequest(request.method, url.path, url.query,
+                              std::move(body));
+  }
+
+  FTL_LOG(ERROR) << "Request to an unknown host: " << request.url;
+  return MakeNotFoundResponse();
+}
+
+}  // namespace fake_cloud
@@ -0,0 +1,58 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_FAKE_CLOUD_FAKE_CLOUD_NETWORK_SERVICE_H_
+#define APPS_LEDGER_SRC_FAKE_CLOUD_FAKE_CLOUD_NETWORK_SERVICE_H_
+
+#include <map>
+#include <memory>
+#include <string>
+
+#include "apps/ledger/src/callback/auto_cleanable.h"
+#include "apps/ledger/src/fake_cloud/fake_firebase.h"
+#include "apps/ledger/src/fake_cloud/fake_gcs.h"
+#include "apps/ledger/src/glue/socket/socket_drainer_client.h"
+#include "apps/ledger/src/network/network_service.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/ref_ptr.h"
+#include "lib/ftl/tasks/task_runner.h"
+
+namespace fake_cloud {
+
+// Implementation of ledger::NetworkService serving the requests made by sync
+// from an in-memory fake of Firebase and of Firebase Storage, instead of
+// sending them to the network. Each Firebase database is identified by the
+// host name of the requests, and is created on first use.
+//
+// All Ledger instances using the same FakeCloudNetworkService sync with each
+// other, which allows to run sync hermetically, e.g. for benchmarks.
+class FakeCloudNetworkService : public ledger::NetworkService {
+ public:
+  explicit FakeCloudNetworkService(ftl::RefPtr<ftl::TaskRunner> task_runner);
+  ~FakeCloudNetworkService() override;
+
+  // ledger::NetworkService:
+  ftl::RefPtr<callback::Cancellable> Request(
+      std::function<network::URLRequestPtr()> request_factory,
+      std::function<void(network::URLResponsePtr)> callback,
+      ledger::RequestPriority priority) override;
+
+ private:
+  // Returns the response to |request|, whose body is |body|.
+  network::URLResponsePtr HandleRequest(const network::URLRequest& request,
+                                        std::string body);
+
+  ftl::RefPtr<ftl::TaskRunner> task_runner_;
+  // Firebase databases, indexed by host name.
+  std::map<std::string, std::unique_ptr<FakeFirebase>> firebases_;
+  FakeGcs gcs_;
+  // Readers of the request bodies.
+  callback::AutoCleanableSet<glue::SocketDrainerClient> drainers_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(FakeCloudNetworkService);
+};
+
+}  // namespace fake_cloud
+
+#endif  // APPS_LEDGER_SRC_FAKE_CLOUD_FAKE_CLOUD_NETWORK_SERVICE_H_
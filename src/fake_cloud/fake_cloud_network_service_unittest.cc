@@ -0,0 +1,207 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/fake_cloud/fake_cloud_network_service.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "apps/ledger/src/callback/capture.h"
+#include "apps/ledger/src/firebase/firebase_impl.h"
+#include "apps/ledger/src/firebase/watch_client.h"
+#include "apps/ledger/src/gcs/cloud_storage_impl.h"
+#include "apps/ledger/src/test/test_with_message_loop.h"
+#include "gtest/gtest.h"
+#include "lib/ftl/macros.h"
+#include "lib/mtl/socket/strings.h"
+#include "lib/mtl/vmo/strings.h"
+
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+namespace fake_cloud {
+namespace {
+
+std::string ToString(const rapidjson::Value& value) {
+  rapidjson::StringBuffer buffer;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+  value.Accept(writer);
+  return std::string(buffer.GetString(), buffer.GetSize());
+}
+
+class FakeCloudNetworkServiceTest : public test::TestWithMessageLoop,
+                                    public firebase::WatchClient {
+ public:
+  FakeCloudNetworkServiceTest()
+      : network_service_(message_loop_.task_runner()),
+        firebase_(&network_service_, "database", "prefix"),
+        gcs_(message_loop_.task_runner(),
+             &network_service_,
+             "project",
+             "prefix") {}
+  ~FakeCloudNetworkServiceTest() override {}
+
+  // firebase::WatchClient:
+  void OnPut(const std::string& path, const rapidjson::Value& value) override {
+    events_.push_back("put " + path + " " + ToString(value));
+    message_loop_.PostQuitTask();
+  }
+
+  void OnPatch(const std::string& path,
+               const rapidjson::Value& value) override {
+    events_.push_back("patch " + path + " " + ToString(value));
+    message_loop_.PostQuitTask();
+  }
+
+ protected:
+  firebase::Status Put(const std::string& key, const std::string& data) {
+    firebase::Status status;
+    firebase_.Put(
+        key, data,
+        callback::Capture([this] { message_loop_.PostQuitTask(); }, &status));
+    EXPECT_FALSE(RunLoopWithTimeout());
+    return status;
+  }
+
+  std::string Get(const std::string& key, const std::string& query) {
+    std::string result;
+    firebase_.Get(key, query, [this, &result](firebase::Status status,
+                                              const rapidjson::Value& value) {
+      EXPECT_EQ(firebase::Status::OK, status);
+      result = ToString(value);
+      message_loop_.PostQuitTask();
+    });
+    EXPECT_FALSE(RunLoopWithTimeout());
+    return result;
+  }
+
+  FakeCloudNetworkService network_service_;
+  firebase::FirebaseImpl firebase_;
+  gcs::CloudStorageImpl gcs_;
+  std::vector<std::string> events_;
+
+ private:
+  FTL_DISALLOW_COPY_AND_ASSIGN(FakeCloudNetworkServiceTest);
+};
+
+TEST_F(FakeCloudNetworkServiceTest, FirebasePutGetDelete) {
+  EXPECT_EQ(firebase::Status::OK, Put("a/b", "{\"c\":1}"));
+  EXPECT_EQ(firebase::Status::OK, Put("a/d", "\"e\""));
+  EXPECT_EQ("{\"b\":{\"c\":1},\"d\":\"e\"}", Get("a", ""));
+  EXPECT_EQ("{\"b\":true,\"d\":true}", Get("a", "shallow=true"));
+  EXPECT_EQ("null", Get("f", ""));
+
+  firebase::Status status;
+  firebase_.Delete(
+      "a/b",
+      callback::Capture([this] { message_loop_.PostQuitTask(); }, &status));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(firebase::Status::OK, status);
+  EXPECT_EQ("{\"d\":\"e\"}", Get("a", ""));
+}
+
+TEST_F(FakeCloudNetworkServiceTest, FirebasePatch) {
+  EXPECT_EQ(firebase::Status::OK, Put("a", "{\"b\":1,\"c\":2}"));
+
+  firebase::Status status;
+  firebase_.Patch(
+      "a", "{\"c\":3,\"d/e\":4}",
+      callback::Capture([this] { message_loop_.PostQuitTask(); }, &status));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(firebase::Status::OK, status);
+  EXPECT_EQ("{\"b\":1,\"c\":3,\"d\":{\"e\":4}}", Get("a", ""));
+}
+
+TEST_F(FakeCloudNetworkServiceTest, FirebaseQuery) {
+  EXPECT_EQ(firebase::Status::OK, Put("a/x", "{\"t\":3}"));
+  EXPECT_EQ(firebase::Status::OK, Put("a/y", "{\"t\":1}"));
+  EXPECT_EQ(firebase::Status::OK, Put("a/z", "{\"t\":2}"));
+
+  EXPECT_EQ("{\"x\":{\"t\":3},\"z\":{\"t\":2}}",
+            Get("a", "orderBy=\"t\"&startAt=2"));
+  EXPECT_EQ("{\"y\":{\"t\":1},\"z\":{\"t\":2}}",
+            Get("a", "orderBy=\"t\"&limitToFirst=2"));
+}
+
+TEST_F(FakeCloudNetworkServiceTest, FirebaseServerTimestamp) {
+  EXPECT_EQ(firebase::Status::OK, Put("a", "{\".sv\":\"timestamp\"}"));
+  std::string value = Get("a", "");
+  EXPECT_FALSE(value.empty());
+  EXPECT_NE(std::string::npos, value.find_first_of("0123456789"));
+  EXPECT_EQ(std::string::npos, value.find("sv"));
+}
+
+TEST_F(FakeCloudNetworkServiceTest, FirebaseWatch) {
+  EXPECT_EQ(firebase::Status::OK, Put("a/x", "{\"t\":1}"));
+
+  firebase_.Watch("a", "orderBy=\"t\"&startAt=1", this);
+  EXPECT_FALSE(RunLoopWithTimeout());
+  ASSERT_EQ(1u, events_.size());
+  EXPECT_EQ("put / {\"x\":{\"t\":1}}", events_[0]);
+
+  // Changes matching the query are notified.
+  firebase::Status status;
+  firebase_.Put("a/y", "{\"t\":2}", [](firebase::Status status) {});
+  EXPECT_FALSE(RunLoopWithTimeout());
+  ASSERT_EQ(2u, events_.size());
+  EXPECT_EQ("put /y {\"t\":2}", events_[1]);
+
+  // Changes not matching the query are not.
+  EXPECT_EQ(firebase::Status::OK, Put("a/z", "{\"t\":0}"));
+  EXPECT_EQ(firebase::Status::OK, Put("b", "1"));
+  EXPECT_EQ(2u, events_.size());
+
+  firebase_.Patch("a", "{\"v\":{\"t\":5},\"w\":{\"t\":6}}",
+                  callback::Capture([] {}, &status));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  ASSERT_EQ(3u, events_.size());
+  EXPECT_EQ("patch / {\"v\":{\"t\":5},\"w\":{\"t\":6}}", events_[2]);
+
+  firebase_.UnWatch(this);
+}
+
+TEST_F(FakeCloudNetworkServiceTest, GcsUploadDownload) {
+  const std::string content = "Hello World\n";
+  mx::vmo data;
+  ASSERT_TRUE(mtl::VmoFromString(content, &data));
+  gcs::Status status;
+  gcs_.UploadObject(
+      "hello-world", std::move(data),
+      callback::Capture([this] { message_loop_.PostQuitTask(); }, &status));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(gcs::Status::OK, status);
+
+  // Objects can only be written once.
+  ASSERT_TRUE(mtl::VmoFromString(content, &data));
+  gcs_.UploadObject(
+      "hello-world", std::move(data),
+      callback::Capture([this] { message_loop_.PostQuitTask(); }, &status));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(gcs::Status::OBJECT_ALREADY_EXISTS, status);
+
+  uint64_t size;
+  mx::socket socket;
+  gcs_.DownloadObject(
+      "hello-world", ledger::RequestPriority::INTERACTIVE,
+      callback::Capture([this] { message_loop_.PostQuitTask(); }, &status,
+                        &size, &socket));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(gcs::Status::OK, status);
+  EXPECT_EQ(content.size(), size);
+  std::string downloaded_content;
+  EXPECT_TRUE(mtl::BlockingCopyToString(std::move(socket),
+                                        &downloaded_content));
+  EXPECT_EQ(content, downloaded_content);
+
+  gcs_.DownloadObject(
+      "missing", ledger::RequestPriority::INTERACTIVE,
+      callback::Capture([this] { message_loop_.PostQuitTask(); }, &status,
+                        &size, &socket));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(gcs::Status::NOT_FOUND, status);
+}
+
+}  // namespace
+}  // namespace fake_cloud
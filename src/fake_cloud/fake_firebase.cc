@@ -0,0 +1,494 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/fake_cloud/fake_firebase.h"
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+#include "apps/ledger/src/glue/socket/socket_pair.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/strings/string_number_conversions.h"
+#include "lib/ftl/time/time_point.h"
+#include "lib/mtl/socket/strings.h"
+
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+namespace fake_cloud {
+
+namespace {
+
+network::URLResponsePtr MakeResponse(uint32_t status_code,
+                                     const std::string& status_line,
+                                     const std::string& body) {
+  network::URLResponsePtr response = network::URLResponse::New();
+  response->status_code = status_code;
+  response->status_line = status_line;
+  response->body = network::URLBody::New();
+  response->body->set_stream(mtl::WriteStringToSocket(body));
+  return response;
+}
+
+network::URLResponsePtr MakeErrorResponse(const std::string& error) {
+  return MakeResponse(400, "HTTP/1.1 400 Bad Request",
+                      "{\"error\":\"" + error + "\"}");
+}
+
+std::string ValueToString(const rapidjson::Value& value) {
+  rapidjson::StringBuffer buffer;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+  value.Accept(writer);
+  return buffer.GetString();
+}
+
+// Removes the quotes around a query parameter value, which may be URL-encoded.
+std::string Unquote(ftl::StringView value) {
+  for (ftl::StringView quote : {"\"", "%22"}) {
+    if (value.size() >= 2 * quote.size() &&
+        value.substr(0, quote.size()) == quote &&
+        value.substr(value.size() - quote.size()) == quote) {
+      return value.substr(quote.size(), value.size() - 2 * quote.size())
+          .ToString();
+    }
+  }
+  return value.ToString();
+}
+
+// Splits |input| on |separator|, dropping the empty parts.
+std::vector<ftl::StringView> Split(ftl::StringView input, char separator) {
+  std::vector<ftl::StringView> result;
+  while (!input.empty()) {
+    size_t end = input.find(separator);
+    if (end == ftl::StringView::npos) {
+      end = input.size();
+    }
+    if (end > 0u) {
+      result.push_back(input.substr(0, end));
+    }
+    input = input.substr(std::min(end + 1, input.size()));
+  }
+  return result;
+}
+
+// Returns the value of the member |key| of |value|, or nullptr if there is
+// none.
+const rapidjson::Value* GetMember(const rapidjson::Value& value,
+                                  const std::string& key) {
+  if (!value.IsObject()) {
+    return nullptr;
+  }
+  auto it = value.FindMember(key.c_str());
+  if (it == value.MemberEnd()) {
+    return nullptr;
+  }
+  return &it->value;
+}
+
+// Returns true if |prefix| is a prefix of |path|.
+bool IsPrefix(const std::vector<std::string>& prefix,
+              const std::vector<std::string>& path) {
+  return prefix.size() <= path.size() &&
+         std::equal(prefix.begin(), prefix.end(), path.begin());
+}
+
+}  // namespace
+
+FakeFirebase::Watcher::Watcher(std::vector<std::string> path, Query query)
+    : path_(std::move(path)), query_(std::move(query)), writer_(this) {}
+
+FakeFirebase::Watcher::~Watcher() {}
+
+void FakeFirebase::Watcher::Start(mx::socket destination) {
+  writer_.Start(std::move(destination));
+}
+
+void FakeFirebase::Watcher::SendEvent(const std::string& event,
+                                      const std::string& data) {
+  buffer_.append("event: " + event + "\ndata: " + data + "\n\n");
+  if (pending_callback_) {
+    auto callback = std::move(pending_callback_);
+    pending_callback_ = nullptr;
+    callback(ftl::StringView(buffer_).substr(0, max_size_));
+  }
+}
+
+void FakeFirebase::Watcher::GetNext(
+    size_t offset,
+    size_t max_size,
+    std::function<void(ftl::StringView)> callback) {
+  // The data before |offset| is written to the socket.
+  FTL_DCHECK(offset >= buffer_offset_);
+  buffer_.erase(0, offset - buffer_offset_);
+  buffer_offset_ = offset;
+
+  if (buffer_.empty()) {
+    // Keep the stream open until the next event.
+    max_size_ = max_size;
+    pending_callback_ = std::move(callback);
+    return;
+  }
+  callback(ftl::StringView(buffer_).substr(0, max_size));
+}
+
+void FakeFirebase::Watcher::OnDataComplete() {
+  // The client closed the stream.
+  if (on_empty_callback_) {
+    on_empty_callback_();
+  }
+}
+
+FakeFirebase::FakeFirebase() {}
+
+FakeFirebase::~FakeFirebase() {}
+
+network::URLResponsePtr FakeFirebase::HandleRequest(
+    const std::string& method,
+    std::vector<std::string> path,
+    const std::string& query,
+    bool event_stream,
+    const std::string& body) {
+  Query parsed_query;
+  if (!ParseQuery(query, &parsed_query)) {
+    return MakeErrorResponse("Invalid query: " + query);
+  }
+
+  if (method == "GET") {
+    if (event_stream) {
+      return HandleWatch(std::move(path), std::move(parsed_query));
+    }
+    return HandleGet(path, parsed_query);
+  }
+
+  if (method == "DELETE") {
+    std::vector<Write> writes;
+    writes.push_back({std::move(path), rapidjson::Value()});
+    ApplyWrites(std::move(writes), false);
+    return MakeResponse(200, "HTTP/1.1 200 OK", "null");
+  }
+
+  if (method != "PUT" && method != "PATCH") {
+    return MakeResponse(405, "HTTP/1.1 405 Method Not Allowed", "");
+  }
+
+  rapidjson::Document document(&root_.GetAllocator());
+  document.Parse(body.c_str(), body.size());
+  if (document.HasParseError()) {
+    return MakeErrorResponse("Invalid data; couldn't parse JSON object.");
+  }
+  ResolveServerValues(&document);
+  // The response contains the data written, with the server values resolved.
+  std::string response_body = ValueToString(document);
+
+  std::vector<Write> writes;
+  if (method == "PUT") {
+    writes.push_back({std::move(path), std::move(document)});
+    ApplyWrites(std::move(writes), false);
+    return MakeResponse(200, "HTTP/1.1 200 OK", response_body);
+  }
+
+  if (!document.IsObject()) {
+    return MakeErrorResponse("Invalid data; the data of a PATCH must be an "
+                             "object.");
+  }
+  // Keys of the patch can be paths, relative to the patched location.
+  for (auto& member : document.GetObject()) {
+    std::vector<std::string> member_path = path;
+    for (ftl::StringView key : Split(member.name.GetString(), '/')) {
+      member_path.push_back(key.ToString());
+    }
+    writes.push_back({std::move(member_path), std::move(member.value)});
+  }
+  ApplyWrites(std::move(writes), true);
+  return MakeResponse(200, "HTTP/1.1 200 OK", response_body);
+}
+
+// static
+bool FakeFirebase::ParseQuery(const std::string& query, Query* result) {
+  for (ftl::StringView parameter : Split(query, '&')) {
+    size_t separator = parameter.find('=');
+    if (separator == ftl::StringView::npos) {
+      return false;
+    }
+    ftl::StringView name = parameter.substr(0, separator);
+    std::string value = Unquote(parameter.substr(separator + 1));
+    if (name == "orderBy") {
+      result->order_by = std::move(value);
+    } else if (name == "startAt") {
+      result->has_start_at = true;
+      if (!ftl::StringToNumberWithError(value, &result->start_at)) {
+        // Only numeric values are supported.
+        return false;
+      }
+    } else if (name == "limitToFirst") {
+      if (!ftl::StringToNumberWithError(value, &result->limit_to_first)) {
+        return false;
+      }
+    } else if (name == "shallow") {
+      result->shallow = value == "true";
+    } else {
+      FTL_LOG(WARNING) << "Ignoring unsupported query parameter: " << name;
+    }
+  }
+  // Filtering and limiting require an order.
+  return !result->order_by.empty() ||
+         (!result->has_start_at && result->limit_to_first == 0u);
+}
+
+network::URLResponsePtr FakeFirebase::HandleGet(
+    const std::vector<std::string>& path,
+    const Query& query) {
+  rapidjson::Document result;
+  ApplyQuery(query, Find(path), &result, result.GetAllocator());
+  return MakeResponse(200, "HTTP/1.1 200 OK", ValueToString(result));
+}
+
+network::URLResponsePtr FakeFirebase::HandleWatch(std::vector<std::string> path,
+                                                  Query query) {
+  glue::SocketPair socket;
+  Watcher& watcher = watchers_.emplace(std::move(path), std::move(query));
+
+  // The first event contains the current value of the location.
+  rapidjson::Document data;
+  ApplyQuery(watcher.query(), Find(watcher.path()), &data,
+             data.GetAllocator());
+  watcher.SendEvent("put",
+                    "{\"path\":\"/\",\"data\":" + ValueToString(data) + "}");
+  watcher.Start(std::move(socket.socket1));
+
+  network::URLResponsePtr response = network::URLResponse::New();
+  response->status_code = 200;
+  response->status_line = "HTTP/1.1 200 OK";
+  response->body = network::URLBody::New();
+  response->body->set_stream(std::move(socket.socket2));
+  return response;
+}
+
+void FakeFirebase::ApplyWrites(std::vector<Write> writes, bool is_patch) {
+  for (auto& write : writes) {
+    SetValue(write.path, std::move(write.value));
+  }
+
+  // Watchers can be deleted while being notified, if their stream is closed.
+  std::vector<Watcher*> watchers;
+  for (auto& watcher : watchers_) {
+    watchers.push_back(&watcher);
+  }
+  for (Watcher* watcher : watchers) {
+    NotifyWatcher(watcher, writes, is_patch);
+  }
+}
+
+const rapidjson::Value* FakeFirebase::Find(
+    const std::vector<std::string>& path) const {
+  const rapidjson::Value* node = &root_;
+  for (const auto& key : path) {
+    node = GetMember(*node, key);
+    if (!node) {
+      return nullptr;
+    }
+  }
+  return node->IsNull() ? nullptr : node;
+}
+
+void FakeFirebase::SetValue(const std::vector<std::string>& path,
+                            rapidjson::Value value) {
+  // Null values and empty objects are not stored.
+  if (value.IsNull() || (value.IsObject() && value.MemberCount() == 0u)) {
+    if (path.empty()) {
+      root_.SetNull();
+    } else {
+      RemoveValue(&root_, path, 0u);
+    }
+    return;
+  }
+
+  rapidjson::Value* node = &root_;
+  for (const auto& key : path) {
+    if (!node->IsObject()) {
+      node->SetObject();
+    }
+    auto it = node->FindMember(key.c_str());
+    if (it == node->MemberEnd()) {
+      node->AddMember(rapidjson::Value(key.c_str(), root_.GetAllocator()),
+                      rapidjson::Value(), root_.GetAllocator());
+      it = node->FindMember(key.c_str());
+    }
+    node = &it->value;
+  }
+  *node = std::move(value);
+}
+
+// static
+bool FakeFirebase::RemoveValue(rapidjson::Value* node,
+                               const std::vector<std::string>& path,
+                               size_t index) {
+  if (!node->IsObject()) {
+    return false;
+  }
+  auto it = node->FindMember(path[index].c_str());
+  if (it == node->MemberEnd()) {
+    return false;
+  }
+  if (index + 1 == path.size() || RemoveValue(&it->value, path, index + 1)) {
+    node->RemoveMember(it);
+  }
+  return node->MemberCount() == 0u;
+}
+
+void FakeFirebase::ResolveServerValues(rapidjson::Value* value) {
+  if (!value->IsObject()) {
+    return;
+  }
+  const rapidjson::Value* server_value = GetMember(*value, ".sv");
+  if (server_value) {
+    if (server_value->IsString() &&
+        server_value->GetString() == std::string("timestamp")) {
+      value->SetInt64(GetServerTimestamp());
+    }
+    return;
+  }
+  for (auto& member : value->GetObject()) {
+    ResolveServerValues(&member.value);
+  }
+}
+
+void FakeFirebase::ApplyQuery(
+    const Query& query,
+    const rapidjson::Value* value,
+    rapidjson::Value* result,
+    rapidjson::Document::AllocatorType& allocator) const {
+  if (!value) {
+    result->SetNull();
+    return;
+  }
+  if (!value->IsObject()) {
+    result->CopyFrom(*value, allocator);
+    return;
+  }
+
+  std::vector<std::pair<int64_t, const rapidjson::Value::Member*>> children;
+  for (const auto& member : value->GetObject()) {
+    if (query.order_by.empty()) {
+      children.emplace_back(0, &member);
+      continue;
+    }
+    if (!MatchesFilter(query, member.value)) {
+      continue;
+    }
+    const rapidjson::Value* order_value =
+        GetMember(member.value, query.order_by);
+    children.emplace_back(order_value && order_value->IsInt64()
+                              ? order_value->GetInt64()
+                              : std::numeric_limits<int64_t>::min(),
+                          &member);
+  }
+  if (!query.order_by.empty()) {
+    std::sort(children.begin(), children.end(),
+              [](const auto& lhs, const auto& rhs) {
+                if (lhs.first != rhs.first) {
+                  return lhs.first < rhs.first;
+                }
+                return std::string(lhs.second->name.GetString()) <
+                       std::string(rhs.second->name.GetString());
+              });
+  }
+  if (query.limit_to_first > 0u && children.size() > query.limit_to_first) {
+    children.resize(query.limit_to_first);
+  }
+
+  result->SetObject();
+  for (const auto& child : children) {
+    rapidjson::Value child_value;
+    if (query.shallow) {
+      child_value.SetBool(true);
+    } else {
+      child_value.CopyFrom(child.second->value, allocator);
+    }
+    result->AddMember(rapidjson::Value(child.second->name, allocator),
+                      std::move(child_value), allocator);
+  }
+}
+
+// static
+bool FakeFirebase::MatchesFilter(const Query& query,
+                                 const rapidjson::Value& value) {
+  if (query.order_by.empty()) {
+    return true;
+  }
+  const rapidjson::Value* order_value = GetMember(value, query.order_by);
+  if (!order_value || !order_value->IsInt64()) {
+    // Children without the ordering value come first, and are thus excluded by
+    // any numeric lower bound.
+    return !query.has_start_at;
+  }
+  return !query.has_start_at || order_value->GetInt64() >= query.start_at;
+}
+
+void FakeFirebase::NotifyWatcher(Watcher* watcher,
+                                 const std::vector<Write>& writes,
+                                 bool is_patch) {
+  const std::vector<std::string>& watched_path = watcher->path();
+
+  // Keys of the children of the watched location modified by the writes.
+  std::vector<std::string> modified_children;
+  for (const auto& write : writes) {
+    if (IsPrefix(write.path, watched_path)) {
+      // The whole watched location is affected.
+      rapidjson::Document data;
+      ApplyQuery(watcher->query(), Find(watched_path), &data,
+                 data.GetAllocator());
+      watcher->SendEvent(
+          "put", "{\"path\":\"/\",\"data\":" + ValueToString(data) + "}");
+      return;
+    }
+    if (IsPrefix(watched_path, write.path)) {
+      const std::string& child = write.path[watched_path.size()];
+      if (std::find(modified_children.begin(), modified_children.end(),
+                    child) == modified_children.end()) {
+        modified_children.push_back(child);
+      }
+    }
+  }
+
+  rapidjson::Document data;
+  data.SetObject();
+  const rapidjson::Value* location = Find(watched_path);
+  for (const auto& child : modified_children) {
+    const rapidjson::Value* child_value =
+        location ? GetMember(*location, child) : nullptr;
+    rapidjson::Value value;
+    if (child_value) {
+      if (!MatchesFilter(watcher->query(), *child_value)) {
+        continue;
+      }
+      value.CopyFrom(*child_value, data.GetAllocator());
+    }
+    data.AddMember(rapidjson::Value(child.c_str(), data.GetAllocator()),
+                   std::move(value), data.GetAllocator());
+  }
+  if (data.MemberCount() == 0u) {
+    return;
+  }
+
+  if (!is_patch && data.MemberCount() == 1u) {
+    auto& member = *data.MemberBegin();
+    watcher->SendEvent("put", "{\"path\":\"/" +
+                                  std::string(member.name.GetString()) +
+                                  "\",\"data\":" +
+                                  ValueToString(member.value) + "}");
+    return;
+  }
+  watcher->SendEvent("patch",
+                     "{\"path\":\"/\",\"data\":" + ValueToString(data) + "}");
+}
+
+int64_t FakeFirebase::GetServerTimestamp() {
+  int64_t now = ftl::TimePoint::Now().ToEpochDelta().ToMilliseconds();
+  last_timestamp_ = std::max(last_timestamp_, now);
+  return last_timestamp_;
+}
+
+}  // namespace fake_cloud
@@ -0,0 +1,155 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_FAKE_CLOUD_FAKE_FIREBASE_H_
+#define APPS_LEDGER_SRC_FAKE_CLOUD_FAKE_FIREBASE_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "apps/ledger/src/callback/auto_cleanable.h"
+#include "apps/ledger/src/glue/socket/socket_writer.h"
+#include "apps/network/services/url_response.fidl.h"
+#include "lib/ftl/functional/closure.h"
+#include "lib/ftl/macros.h"
+
+#include <rapidjson/document.h>
+
+namespace fake_cloud {
+
+// In-memory implementation of the subset of the Firebase Realtime Database
+// REST API used by firebase::FirebaseImpl:
+//  - GET, PUT, PATCH (including multi-path updates) and DELETE of a location,
+//  - the "shallow", "orderBy", "startAt" and "limitToFirst" query parameters,
+//    ordering by a numeric child only,
+//  - the {".sv": "timestamp"} server value,
+//  - event-stream watches of a location, delivering "put" and "patch" events.
+//    The query of a watch filters the events, but "limitToFirst" only applies
+//    to the initial event.
+class FakeFirebase {
+ public:
+  FakeFirebase();
+  ~FakeFirebase();
+
+  // Handles a request on the location at |path|, given as a list of keys.
+  // |query| is the query string of the request, without the leading "?". If
+  // |event_stream| is true, the response body is a stream of the events
+  // notifying the changes of the location.
+  network::URLResponsePtr HandleRequest(const std::string& method,
+                                        std::vector<std::string> path,
+                                        const std::string& query,
+                                        bool event_stream,
+                                        const std::string& body);
+
+ private:
+  struct Query {
+    std::string order_by;
+    bool has_start_at = false;
+    int64_t start_at = 0;
+    size_t limit_to_first = 0;
+    bool shallow = false;
+  };
+
+  // A single event stream, sending events to the client as they are added.
+  class Watcher : public glue::SocketWriter::Client {
+   public:
+    Watcher(std::vector<std::string> path, Query query);
+    ~Watcher() override;
+
+    void Start(mx::socket destination);
+
+    void SendEvent(const std::string& event, const std::string& data);
+
+    const std::vector<std::string>& path() const { return path_; }
+    const Query& query() const { return query_; }
+
+    void set_on_empty(ftl::Closure on_empty_callback) {
+      on_empty_callback_ = std::move(on_empty_callback);
+    }
+
+   private:
+    // glue::SocketWriter::Client:
+    void GetNext(size_t offset,
+                 size_t max_size,
+                 std::function<void(ftl::StringView)> callback) override;
+    void OnDataComplete() override;
+
+    const std::vector<std::string> path_;
+    const Query query_;
+    // Data not yet written to the socket, starting at |buffer_offset_|.
+    std::string buffer_;
+    size_t buffer_offset_ = 0u;
+    size_t max_size_ = 0u;
+    // Callback of the writer waiting for new data, if any.
+    std::function<void(ftl::StringView)> pending_callback_;
+    glue::SocketWriter writer_;
+    ftl::Closure on_empty_callback_;
+
+    FTL_DISALLOW_COPY_AND_ASSIGN(Watcher);
+  };
+
+  // A write at a single location.
+  struct Write {
+    std::vector<std::string> path;
+    rapidjson::Value value;
+  };
+
+  static bool ParseQuery(const std::string& query, Query* result);
+
+  network::URLResponsePtr HandleGet(const std::vector<std::string>& path,
+                                    const Query& query);
+
+  network::URLResponsePtr HandleWatch(std::vector<std::string> path,
+                                      Query query);
+
+  // Applies the given writes, and notifies the watchers. If |is_patch| is
+  // true, the changes are notified as "patch" events. The values of |writes|
+  // are moved into the database.
+  void ApplyWrites(std::vector<Write> writes, bool is_patch);
+
+  // Returns the value at |path|, or nullptr if there is none.
+  const rapidjson::Value* Find(const std::vector<std::string>& path) const;
+
+  void SetValue(const std::vector<std::string>& path, rapidjson::Value value);
+
+  // Removes the member at |path| from |node|, and returns true if |node| is
+  // empty as a result.
+  static bool RemoveValue(rapidjson::Value* node,
+                          const std::vector<std::string>& path,
+                          size_t index);
+
+  // Replaces the server values in |value| by their actual value.
+  void ResolveServerValues(rapidjson::Value* value);
+
+  // Copies into |result| the part of |value| selected by |query|.
+  void ApplyQuery(const Query& query,
+                  const rapidjson::Value* value,
+                  rapidjson::Value* result,
+                  rapidjson::Document::AllocatorType& allocator) const;
+
+  // Returns true if the child |value| of a location matches the filter of
+  // |query|.
+  static bool MatchesFilter(const Query& query, const rapidjson::Value& value);
+
+  void NotifyWatcher(Watcher* watcher,
+                     const std::vector<Write>& writes,
+                     bool is_patch);
+
+  // Returns a server timestamp, in milliseconds. Timestamps never decrease.
+  int64_t GetServerTimestamp();
+
+  // Root of the database. Removed values are not freed from its allocator
+  // until the database is deleted.
+  rapidjson::Document root_;
+  int64_t last_timestamp_ = 0;
+  callback::AutoCleanableSet<Watcher> watchers_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(FakeFirebase);
+};
+
+}  // namespace fake_cloud
+
+#endif  // APPS_LEDGER_SRC_FAKE_CLOUD_FAKE_FIREBASE_H_
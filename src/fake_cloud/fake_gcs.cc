@@ -0,0 +1,64 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/fake_cloud/fake_gcs.h"
+
+#include <utility>
+
+#include "lib/ftl/strings/string_number_conversions.h"
+#include "lib/mtl/socket/strings.h"
+
+namespace fake_cloud {
+
+namespace {
+
+network::URLResponsePtr MakeResponse(uint32_t status_code,
+                                     const std::string& status_line,
+                                     const std::string& body) {
+  network::URLResponsePtr response = network::URLResponse::New();
+  response->status_code = status_code;
+  response->status_line = status_line;
+  network::HttpHeaderPtr content_length_header = network::HttpHeader::New();
+  content_length_header->name = "content-length";
+  content_length_header->value = ftl::NumberToString(body.size());
+  response->headers.push_back(std::move(content_length_header));
+  response->body = network::URLBody::New();
+  response->body->set_stream(mtl::WriteStringToSocket(body));
+  return response;
+}
+
+}  // namespace
+
+FakeGcs::FakeGcs() {}
+
+FakeGcs::~FakeGcs() {}
+
+network::URLResponsePtr FakeGcs::HandleRequest(const std::string& method,
+                                               const std::string& path,
+                                               const std::string& query,
+                                               std::string body) {
+  if (method == "GET") {
+    if (query != "alt=media") {
+      return MakeResponse(400, "HTTP/1.1 400 Bad Request", "");
+    }
+    auto it = objects_.find(path);
+    if (it == objects_.end()) {
+      return MakeResponse(404, "HTTP/1.1 404 Not Found", "");
+    }
+    return MakeResponse(200, "HTTP/1.1 200 OK", it->second);
+  }
+
+  if (method == "POST") {
+    // CloudStorageImpl always requires the object not to exist yet.
+    if (objects_.count(path)) {
+      return MakeResponse(412, "HTTP/1.1 412 Precondition Failed", "");
+    }
+    objects_[path] = std::move(body);
+    return MakeResponse(200, "HTTP/1.1 200 OK", "{}");
+  }
+
+  return MakeResponse(405, "HTTP/1.1 405 Method Not Allowed", "");
+}
+
+}  // namespace fake_cloud
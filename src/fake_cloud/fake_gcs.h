@@ -0,0 +1,39 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_FAKE_CLOUD_FAKE_GCS_H_
+#define APPS_LEDGER_SRC_FAKE_CLOUD_FAKE_GCS_H_
+
+#include <map>
+#include <string>
+
+#include "apps/network/services/url_response.fidl.h"
+#include "lib/ftl/macros.h"
+
+namespace fake_cloud {
+
+// In-memory implementation of the subset of the Firebase Storage REST API used
+// by gcs::CloudStorageImpl: upload of an object that must not already exist,
+// and download of its content.
+class FakeGcs {
+ public:
+  FakeGcs();
+  ~FakeGcs();
+
+  // Handles a request on the object at |path|. |query| is the query string of
+  // the request, without the leading "?".
+  network::URLResponsePtr HandleRequest(const std::string& method,
+                                        const std::string& path,
+                                        const std::string& query,
+                                        std::string body);
+
+ private:
+  std::map<std::string, std::string> objects_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(FakeGcs);
+};
+
+}  // namespace fake_cloud
+
+#endif  // APPS_LEDGER_SRC_FAKE_CLOUD_FAKE_GCS_H_
@@ -25,17 +25,35 @@ void EventStream::Start(
   drainer_->Start(std::move(source));
 }
 
+void EventStream::StreamData(std::function<DataStartCallback> on_data_start,
+                             std::function<DataChunkCallback> on_data_chunk) {
+  on_data_start_ = std::move(on_data_start);
+  on_data_chunk_ = std::move(on_data_chunk);
+}
+
 void EventStream::OnDataAvailable(const void* data, size_t num_bytes) {
   const char* current = static_cast<const char*>(data);
   const char* const end = current + num_bytes;
   while (current < end) {
     const char* newline = std::find(current, end, '\n');
-    pending_line_.append(current, newline - current);
+    if (streaming_line_) {
+      if (!StreamLineData(ftl::StringView(current, newline - current)))
+        return;
+    } else {
+      pending_line_.append(current, newline - current);
+      // Stream the beginning of a data line without waiting for its end.
+      if (newline == end && on_data_chunk_ && !StreamPendingLine())
+        return;
+    }
     current = newline;
     if (newline != end) {
-      if (!ProcessLine(std::move(pending_line_)))
-        return;
-      pending_line_.clear();
+      if (streaming_line_) {
+        streaming_line_ = false;
+      } else {
+        if (!ProcessLine(std::move(pending_line_)))
+          return;
+        pending_line_.clear();
+      }
       ++current;
     }
   }
@@ -49,6 +67,20 @@ void EventStream::OnDataComplete() {
 bool EventStream::ProcessLine(ftl::StringView line) {
   // If the line is empty, dispatch the event.
   if (line.empty()) {
+    if (streaming_event_) {
+      event_data_started_ = false;
+      streaming_event_ = false;
+      streamed_lines_ = 0;
+      if (destruction_sentinel_.DestructedWhile([this] {
+            event_callback_(Status::OK, std::move(event_type_), "");
+          })) {
+        return false;
+      }
+      event_type_.clear();
+      return true;
+    }
+    event_data_started_ = false;
+
     // If data is empty, clear event type and abort.
     if (data_.empty()) {
       event_type_.clear();
@@ -80,20 +112,21 @@ bool EventStream::ProcessLine(ftl::StringView line) {
   if (colon_pos != std::string::npos) {
     ftl::StringView field(line.substr(0, colon_pos));
     ftl::StringView value = line.substr(colon_pos + 1);
-    ProcessField(field, ftl::TrimString(value, " "));
-    return true;
+    return ProcessField(field, ftl::TrimString(value, " "));
   }
 
   // If the line does not contain a colon, process the field using the whole
   // line as the field name and empty string as field value.
-  ProcessField(line, "");
-  return true;
+  return ProcessField(line, "");
 }
 
-void EventStream::ProcessField(ftl::StringView field, ftl::StringView value) {
+bool EventStream::ProcessField(ftl::StringView field, ftl::StringView value) {
   if (field == "event") {
     event_type_ = value.ToString();
   } else if (field == "data") {
+    if (IsDataStreamed()) {
+      return StartStreamedLine() && StreamLineData(value);
+    }
     data_.append(value.data(), value.size());
     data_.append("\n");
   } else if (field == "id" || field == "retry") {
@@ -103,6 +136,61 @@ void EventStream::ProcessField(ftl::StringView field, ftl::StringView value) {
     // The spec says to ignore unknown field names.
     FTL_LOG(WARNING) << "Event stream - unknown field name: " << field;
   }
+  return true;
+}
+
+bool EventStream::IsDataStreamed() {
+  if (!event_data_started_) {
+    event_data_started_ = true;
+    streaming_event_ = on_data_start_ && on_data_start_(event_type_);
+  }
+  return streaming_event_;
+}
+
+bool EventStream::StreamPendingLine() {
+  constexpr ftl::StringView kDataPrefix = "data:";
+  ftl::StringView line(pending_line_);
+  if (!(line.substr(0, kDataPrefix.size()) == kDataPrefix) ||
+      !IsDataStreamed()) {
+    return true;
+  }
+
+  std::string data = pending_line_.substr(kDataPrefix.size());
+  pending_line_.clear();
+  streaming_line_ = true;
+  return StartStreamedLine() && StreamLineData(data);
+}
+
+bool EventStream::StartStreamedLine() {
+  skip_spaces_ = true;
+  // Lines of data are separated by line breaks.
+  if (streamed_lines_++ == 0) {
+    return true;
+  }
+  return SendDataChunk("\n");
+}
+
+bool EventStream::StreamLineData(ftl::StringView data) {
+  if (skip_spaces_) {
+    size_t start = 0;
+    while (start < data.size() && data[start] == ' ') {
+      ++start;
+    }
+    if (start == data.size()) {
+      return true;
+    }
+    data = data.substr(start);
+    skip_spaces_ = false;
+  }
+  if (data.empty()) {
+    return true;
+  }
+  return SendDataChunk(data);
+}
+
+bool EventStream::SendDataChunk(ftl::StringView chunk) {
+  return !destruction_sentinel_.DestructedWhile(
+      [this, chunk] { on_data_chunk_(chunk); });
 }
 
 }  // namespace firebase
@@ -18,10 +18,16 @@
 namespace firebase {
 
 // TODO(ppi): Use a client interface instead.
+// |data| is passed by value, so that the client can modify it, e.g. to parse it
+// in place.
 using EventCallback = void(Status status,
                            const std::string& event,
-                           const std::string& data);
+                           std::string data);
 using CompletionCallback = void();
+// Called when the data of an event of type |event| starts to be received.
+// Returns whether the data of the event is streamed.
+using DataStartCallback = bool(const std::string& event);
+using DataChunkCallback = void(ftl::StringView chunk);
 
 // Socket drainer that parses a stream of Server-Sent Events.
 // Data format of the stream is specified in http://www.w3.org/TR/eventsource/.
@@ -34,6 +40,15 @@ class EventStream : public mtl::SocketDrainer::Client {
              const std::function<EventCallback>& event_callback,
              const std::function<CompletionCallback>& completion_callback);
 
+  // Passes the data of the events for which |on_data_start| returns true to
+  // |on_data_chunk| as it is received, instead of accumulating it and passing
+  // it to the event callback. The event callback is still called once each
+  // such event is complete, with empty data. The leading spaces of the data
+  // lines are skipped, but not their trailing spaces. |on_data_start| must not
+  // delete the stream.
+  void StreamData(std::function<DataStartCallback> on_data_start,
+                  std::function<DataChunkCallback> on_data_chunk);
+
  private:
   friend class EventStreamTest;
 
@@ -44,15 +59,49 @@ class EventStream : public mtl::SocketDrainer::Client {
   // Returns false if the object has been destroyed within this method.
   bool ProcessLine(ftl::StringView line);
 
-  void ProcessField(ftl::StringView field, ftl::StringView value);
+  // Returns false if the object has been destroyed within this method.
+  bool ProcessField(ftl::StringView field, ftl::StringView value);
+
+  // Returns whether the data of the current event is streamed, deciding it
+  // when the first data line of the event is received.
+  bool IsDataStreamed();
+
+  // Starts streaming the incomplete line in |pending_line_| if it is a data
+  // line of an event whose data is streamed. Returns false if the object has
+  // been destroyed within this method.
+  bool StreamPendingLine();
+
+  // Starts a new data line of a streamed event. Returns false if the object
+  // has been destroyed within this method.
+  bool StartStreamedLine();
+
+  // Streams a part of the current data line. Returns false if the object has
+  // been destroyed within this method.
+  bool StreamLineData(ftl::StringView data);
+
+  // Passes |chunk| to the client. Returns false if the object has been
+  // destroyed within this method.
+  bool SendDataChunk(ftl::StringView chunk);
 
   std::function<EventCallback> event_callback_;
   std::function<CompletionCallback> completion_callback_;
+  std::function<DataStartCallback> on_data_start_;
+  std::function<DataChunkCallback> on_data_chunk_;
 
   // Unprocessed part of the current line.
   std::string pending_line_;
   std::string data_;
   std::string event_type_;
+  // Whether a data line of the current event was received.
+  bool event_data_started_ = false;
+  // Whether the data of the current event is streamed.
+  bool streaming_event_ = false;
+  // Number of data lines of the current event streamed so far.
+  size_t streamed_lines_ = 0;
+  // Whether the current line is a data line being streamed.
+  bool streaming_line_ = false;
+  // Whether the leading spaces of the streamed line are not skipped yet.
+  bool skip_spaces_ = false;
 
   std::unique_ptr<mtl::SocketDrainer> drainer_;
 
@@ -7,6 +7,7 @@
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "apps/ledger/src/glue/socket/socket_pair.h"
 #include "gtest/gtest.h"
@@ -52,13 +53,29 @@ class EventStreamTest : public ::testing::Test {
 
   void Done() { event_stream_->OnDataComplete(); }
 
+  // Streams the data of the events of type |event|.
+  void StreamData(const std::string& event) {
+    event_stream_->StreamData(
+        [event](const std::string& current_event) {
+          return current_event == event;
+        },
+        [this](ftl::StringView chunk) {
+          chunks_.push_back(chunk.ToString());
+          if (delete_on_chunk_) {
+            event_stream_.reset();
+          }
+        });
+  }
+
   mtl::MessageLoop message_loop_;
   mx::socket producer_socket_;
   std::unique_ptr<EventStream> event_stream_;
   std::vector<Status> status_;
   std::vector<std::string> events_;
   std::vector<std::string> data_;
+  std::vector<std::string> chunks_;
   bool delete_on_event_ = false;
+  bool delete_on_chunk_ = false;
 
  private:
   FTL_DISALLOW_COPY_AND_ASSIGN(EventStreamTest);
@@ -189,5 +206,34 @@ TEST_F(EventStreamTest, DeleteOnEvent) {
   EXPECT_EQ("bazinga", data_[0]);
 }
 
+TEST_F(EventStreamTest, StreamData) {
+  StreamData("put");
+  Feed("event: put\n");
+  Feed("data:  {\"a\"");
+  EXPECT_EQ(std::vector<std::string>({"{\"a\""}), chunks_);
+  Feed(": 1}\ndata: x\n");
+  EXPECT_TRUE(events_.empty());
+  Feed("\nevent: abc\ndata: bazinga\n\n");
+  Done();
+
+  EXPECT_EQ(std::vector<std::string>({"{\"a\"", ": 1}", "\n", "x"}),
+            chunks_);
+  EXPECT_EQ(2u, status_.size());
+  EXPECT_EQ("put", events_[0]);
+  EXPECT_EQ("", data_[0]);
+  EXPECT_EQ("abc", events_[1]);
+  EXPECT_EQ("bazinga", data_[1]);
+}
+
+TEST_F(EventStreamTest, DeleteOnDataChunk) {
+  StreamData("put");
+  delete_on_chunk_ = true;
+  Feed("event: put\ndata: 42\n\nevent: put\ndata: 43\n\n");
+
+  EXPECT_FALSE(event_stream_);
+  EXPECT_EQ(std::vector<std::string>({"42"}), chunks_);
+  EXPECT_TRUE(status_.empty());
+}
+
 }  // namespace
 }  // namespace firebase
@@ -8,6 +8,7 @@
 #include <functional>
 #include <string>
 
+#include "apps/ledger/src/firebase/json_object_stream_parser.h"
 #include "apps/ledger/src/firebase/status.h"
 #include "apps/ledger/src/firebase/watch_client.h"
 #include "lib/ftl/macros.h"
@@ -33,6 +34,18 @@ class Firebase {
       const std::function<void(Status status, const rapidjson::Value& value)>&
           callback) = 0;
 
+  // Retrieves the JSON object under the given path, like Get(), but passes each
+  // member of the object to |on_member| as soon as it is received, instead of
+  // holding the whole response in memory. A path holding no data yields no
+  // members. |callback| is called once the whole object is received; if it is
+  // called with a status other than Status::OK, the members already passed to
+  // |on_member| must be discarded.
+  virtual void GetObjectMembers(
+      const std::string& key,
+      const std::string& query,
+      const std::function<ObjectMemberCallback>& on_member,
+      const std::function<void(Status status)>& callback) = 0;
+
   // Overwrites the data under the given path. Data needs to be a valid JSON
   // object or JSON primitive value.
   // https://firebase.google.com/docs/database/rest/save-data
@@ -40,6 +53,15 @@ class Firebase {
                    const std::string& data,
                    const std::function<void(Status status)>& callback) = 0;
 
+  // Updates the children listed in |data| under the given path, leaving the
+  // other children untouched. Data needs to be a valid JSON object, whose keys
+  // can be paths relative to |key|, allowing to write to multiple locations in
+  // a single atomic operation.
+  // https://firebase.google.com/docs/database/rest/save-data
+  virtual void Patch(const std::string& key,
+                     const std::string& data,
+                     const std::function<void(Status status)>& callback) = 0;
+
   // Deletes the data under the given path.
   virtual void Delete(const std::string& key,
                       const std::function<void(Status status)>& callback) = 0;
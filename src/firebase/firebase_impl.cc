@@ -4,14 +4,19 @@
 
 #include "apps/ledger/src/firebase/firebase_impl.h"
 
+#include <string>
 #include <utility>
 
+#include "apps/ledger/src/callback/destruction_sentinel.h"
 #include "apps/ledger/src/glue/socket/socket_drainer_client.h"
 #include "apps/ledger/src/glue/socket/socket_pair.h"
 #include "apps/ledger/src/glue/socket/socket_writer.h"
 #include "lib/ftl/logging.h"
 #include "lib/ftl/strings/ascii.h"
 
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
 namespace firebase {
 
 namespace {
@@ -44,8 +49,46 @@ std::function<network::URLRequestPtr()> MakeRequest(
   };
 }
 
+std::string ValueToString(const rapidjson::Value& value) {
+  rapidjson::StringBuffer buffer;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+  value.Accept(writer);
+  return buffer.GetString();
+}
+
 }  // namespace
 
+// Payload of a put or patch event, parsed as it is received.
+struct FirebaseImpl::EventPayload {
+  EventPayload(coroutine::CoroutineService* coroutine_service,
+               std::string event,
+               std::function<ObjectMemberCallback> on_member);
+  ~EventPayload();
+
+  const std::string event;
+  JsonObjectStreamParser parser;
+  bool parse_error = false;
+  // Whether the payload has a `path` string member, whose value is |path|.
+  bool has_path = false;
+  std::string path;
+  // Whether the watch client streams the members of the data at |path|.
+  bool stream_data = false;
+  // Whether the members of the `data` member were passed to the watch client.
+  bool data_streamed = false;
+  // Value of the `data` member, if it was not streamed.
+  std::unique_ptr<rapidjson::Document> data;
+
+  callback::DestructionSentinel destruction_sentinel;
+};
+
+FirebaseImpl::EventPayload::EventPayload(
+    coroutine::CoroutineService* coroutine_service,
+    std::string event,
+    std::function<ObjectMemberCallback> on_member)
+    : event(std::move(event)),
+      parser(coroutine_service, std::move(on_member)) {}
+FirebaseImpl::EventPayload::~EventPayload() {}
+
 struct FirebaseImpl::WatchData {
   WatchData();
   ~WatchData();
@@ -53,6 +96,8 @@ struct FirebaseImpl::WatchData {
   callback::AutoCancel request;
   std::unique_ptr<EventStream> event_stream;
   std::unique_ptr<glue::SocketDrainerClient> drainer;
+  // Payload of the event being received, if it is streamed.
+  std::unique_ptr<EventPayload> payload;
 };
 
 FirebaseImpl::WatchData::WatchData() {}
@@ -92,6 +137,19 @@ void FirebaseImpl::Get(
   Request(BuildRequestUrl(key, query), "GET", "", request_callback);
 }
 
+void FirebaseImpl::GetObjectMembers(
+    const std::string& key,
+    const std::string& query,
+    const std::function<ObjectMemberCallback>& on_member,
+    const std::function<void(Status status)>& callback) {
+  requests_.emplace(network_service_->Request(
+      MakeRequest(BuildRequestUrl(key, query), "GET", ""),
+      [this, on_member, callback](network::URLResponsePtr response) {
+        OnObjectMembersResponse(on_member, callback, std::move(response));
+      },
+      ledger::RequestPriority::SYNC));
+}
+
 void FirebaseImpl::Put(const std::string& key,
                        const std::string& data,
                        const std::function<void(Status status)>& callback) {
@@ -103,6 +161,17 @@ void FirebaseImpl::Put(const std::string& key,
           });
 }
 
+void FirebaseImpl::Patch(const std::string& key,
+                         const std::string& data,
+                         const std::function<void(Status status)>& callback) {
+  Request(BuildRequestUrl(key, ""), "PATCH", data,
+          [callback](Status status, const std::string& response) {
+            // Ignore the response body, which is the same data we sent to the
+            // server.
+            callback(status);
+          });
+}
+
 void FirebaseImpl::Delete(const std::string& key,
                           const std::function<void(Status status)>& callback) {
   Request(BuildRequestUrl(key, ""), "DELETE", "",
@@ -119,7 +188,8 @@ void FirebaseImpl::Watch(const std::string& key,
       MakeRequest(BuildRequestUrl(key, query), "GET", "", true),
       [this, watch_client](network::URLResponsePtr response) {
         OnStream(watch_client, std::move(response));
-      }));
+      },
+      ledger::RequestPriority::SYNC));
 }
 
 void FirebaseImpl::UnWatch(WatchClient* watch_client) {
@@ -163,7 +233,8 @@ void FirebaseImpl::Request(
       MakeRequest(url, method, message),
       [this, callback](network::URLResponsePtr response) {
         OnResponse(callback, std::move(response));
-      }));
+      },
+      ledger::RequestPriority::SYNC));
 }
 
 void FirebaseImpl::OnResponse(
@@ -198,6 +269,24 @@ void FirebaseImpl::OnResponse(
       [callback](const std::string& body) { callback(Status::OK, body); });
 }
 
+void FirebaseImpl::OnObjectMembersResponse(
+    const std::function<ObjectMemberCallback>& on_member,
+    const std::function<void(Status status)>& callback,
+    network::URLResponsePtr response) {
+  if (response->error ||
+      (response->status_code != 200 && response->status_code != 204)) {
+    // Let OnResponse() log and report the error.
+    OnResponse([callback](Status status,
+                          std::string response) { callback(status); },
+               std::move(response));
+    return;
+  }
+
+  FTL_DCHECK(response->body->is_stream());
+  auto& reader = object_readers_.emplace(&coroutine_service_);
+  reader.Start(std::move(response->body->get_stream()), on_member, callback);
+}
+
 void FirebaseImpl::OnStream(WatchClient* watch_client,
                             network::URLResponsePtr response) {
   if (response->error) {
@@ -227,11 +316,18 @@ void FirebaseImpl::OnStream(WatchClient* watch_client,
   }
 
   watch_data_[watch_client]->event_stream = std::make_unique<EventStream>();
+  watch_data_[watch_client]->event_stream->StreamData(
+      [this, watch_client](const std::string& event) {
+        return OnStreamPayloadStart(watch_client, event);
+      },
+      [this, watch_client](ftl::StringView chunk) {
+        OnStreamPayloadChunk(watch_client, chunk);
+      });
   watch_data_[watch_client]->event_stream->Start(
       std::move(response->body->get_stream()),
       [this, watch_client](Status status, const std::string& event,
-                           const std::string& data) {
-        OnStreamEvent(watch_client, status, event, data);
+                           std::string data) {
+        OnStreamEvent(watch_client, status, event, std::move(data));
       },
       [this, watch_client]() { OnStreamComplete(watch_client); });
 }
@@ -245,52 +341,9 @@ void FirebaseImpl::OnStreamComplete(WatchClient* watch_client) {
 void FirebaseImpl::OnStreamEvent(WatchClient* watch_client,
                                  Status status,
                                  const std::string& event,
-                                 const std::string& payload) {
+                                 std::string payload) {
   if (event == "put" || event == "patch") {
-    rapidjson::Document parsed_payload;
-    parsed_payload.Parse(payload.c_str(), payload.size());
-    if (parsed_payload.HasParseError()) {
-      HandleMalformedEvent(watch_client, event, payload,
-                           "failed to parse the event payload");
-      return;
-    }
-
-    // Both 'put' and 'patch' events must carry a dictionary of "path" and
-    // "data".
-    if (!parsed_payload.IsObject()) {
-      HandleMalformedEvent(watch_client, event, payload,
-                           "event payload doesn't appear to be an object");
-      return;
-    }
-    if (!parsed_payload.HasMember("path") ||
-        !parsed_payload["path"].IsString()) {
-      HandleMalformedEvent(watch_client, event, payload,
-                           "event payload doesn't contain the `path` string");
-      return;
-    }
-    if (!parsed_payload.HasMember("data")) {
-      HandleMalformedEvent(watch_client, event, payload,
-                           "event payload doesn't contain the `data` member");
-      return;
-    }
-
-    if (event == "put") {
-      watch_client->OnPut(parsed_payload["path"].GetString(),
-                          parsed_payload["data"]);
-    } else if (event == "patch") {
-      // In case of patch, data must be a dictionary itself.
-      if (!parsed_payload["data"].IsObject()) {
-        HandleMalformedEvent(
-            watch_client, event, payload,
-            "event payload `data` member doesn't appear to be an object");
-        return;
-      }
-
-      watch_client->OnPatch(parsed_payload["path"].GetString(),
-                            parsed_payload["data"]);
-    } else {
-      FTL_NOTREACHED();
-    }
+    OnStreamPayloadEnd(watch_client, event);
   } else if (event == "keep-alive") {
     // Do nothing.
   } else if (event == "cancel") {
@@ -317,6 +370,127 @@ void FirebaseImpl::OnStreamEvent(WatchClient* watch_client,
   }
 }
 
+bool FirebaseImpl::OnStreamPayloadStart(WatchClient* watch_client,
+                                        const std::string& event) {
+  // The payload of the initial put event can hold all the data under the
+  // watched path.
+  if (event != "put" && event != "patch") {
+    return false;
+  }
+
+  WatchData* watch_data = watch_data_[watch_client].get();
+  watch_data->payload = std::make_unique<EventPayload>(
+      &coroutine_service_, event,
+      [this, watch_client](const std::string& key,
+                           const rapidjson::Value& value) {
+        OnStreamPayloadMember(watch_client, key, value);
+      });
+  EventPayload* payload = watch_data->payload.get();
+  payload->parser.StreamNestedObject(
+      "data",
+      [payload] {
+        payload->data_streamed = payload->stream_data;
+        return payload->stream_data;
+      },
+      [watch_client](const std::string& key, const rapidjson::Value& value) {
+        watch_client->OnDataMember(key, value);
+      });
+  return true;
+}
+
+void FirebaseImpl::OnStreamPayloadChunk(WatchClient* watch_client,
+                                        ftl::StringView chunk) {
+  EventPayload* payload = watch_data_[watch_client]->payload.get();
+  FTL_DCHECK(payload);
+  if (payload->parse_error) {
+    return;
+  }
+
+  bool parsed = false;
+  // The watch client can stop watching when receiving the data members.
+  if (payload->destruction_sentinel.DestructedWhile([payload, chunk, &parsed] {
+        parsed = payload->parser.Feed(chunk);
+      })) {
+    return;
+  }
+  payload->parse_error = !parsed;
+}
+
+void FirebaseImpl::OnStreamPayloadMember(WatchClient* watch_client,
+                                         const std::string& key,
+                                         const rapidjson::Value& value) {
+  EventPayload* payload = watch_data_[watch_client]->payload.get();
+  if (key == "path") {
+    if (!value.IsString()) {
+      return;
+    }
+    payload->has_path = true;
+    payload->path.assign(value.GetString(), value.GetStringLength());
+    payload->stream_data =
+        watch_client->StreamsDataMembers(payload->event, payload->path);
+  } else if (key == "data") {
+    // The data is only kept whole if the watch client doesn't stream it.
+    payload->data = std::make_unique<rapidjson::Document>();
+    payload->data->CopyFrom(value, payload->data->GetAllocator());
+  }
+}
+
+void FirebaseImpl::OnStreamPayloadEnd(WatchClient* watch_client,
+                                      const std::string& event) {
+  WatchData* watch_data = watch_data_[watch_client].get();
+  EventPayload* payload = watch_data->payload.get();
+  FTL_DCHECK(payload);
+
+  bool parsed = false;
+  if (!payload->parse_error &&
+      payload->destruction_sentinel.DestructedWhile(
+          [payload, &parsed] { parsed = payload->parser.Finish(); })) {
+    return;
+  }
+  std::unique_ptr<EventPayload> finished_payload =
+      std::move(watch_data->payload);
+
+  if (!parsed) {
+    HandleMalformedEvent(watch_client, event, "",
+                         "failed to parse the event payload");
+    return;
+  }
+
+  // Both 'put' and 'patch' events must carry a dictionary of "path" and
+  // "data".
+  if (!finished_payload->has_path) {
+    HandleMalformedEvent(watch_client, event, "",
+                         "event payload doesn't contain the `path` string");
+    return;
+  }
+  const std::string& path = finished_payload->path;
+  if (finished_payload->data_streamed) {
+    watch_client->OnDataEnd(event, path);
+    return;
+  }
+  if (!finished_payload->data) {
+    HandleMalformedEvent(watch_client, event, path,
+                         "event payload doesn't contain the `data` member");
+    return;
+  }
+
+  const rapidjson::Value& data = *finished_payload->data;
+  if (event == "put") {
+    watch_client->OnPut(path, data);
+  } else if (event == "patch") {
+    // In case of patch, data must be a dictionary itself.
+    if (!data.IsObject()) {
+      HandleMalformedEvent(
+          watch_client, event, ValueToString(data),
+          "event payload `data` member doesn't appear to be an object");
+      return;
+    }
+    watch_client->OnPatch(path, data);
+  } else {
+    FTL_NOTREACHED();
+  }
+}
+
 void FirebaseImpl::HandleMalformedEvent(WatchClient* watch_client,
                                         const std::string& event,
                                         const std::string& payload,
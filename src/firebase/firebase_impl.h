@@ -12,8 +12,10 @@
 
 #include "apps/ledger/src/callback/auto_cleanable.h"
 #include "apps/ledger/src/callback/cancellable.h"
+#include "apps/ledger/src/coroutine/coroutine_impl.h"
 #include "apps/ledger/src/firebase/event_stream.h"
 #include "apps/ledger/src/firebase/firebase.h"
+#include "apps/ledger/src/firebase/json_object_stream_parser.h"
 #include "apps/ledger/src/firebase/status.h"
 #include "apps/ledger/src/firebase/watch_client.h"
 #include "apps/ledger/src/glue/socket/socket_drainer_client.h"
@@ -43,9 +45,17 @@ class FirebaseImpl : public Firebase {
       const std::string& query,
       const std::function<void(Status status, const rapidjson::Value& value)>&
           callback) override;
+  void GetObjectMembers(
+      const std::string& key,
+      const std::string& query,
+      const std::function<ObjectMemberCallback>& on_member,
+      const std::function<void(Status status)>& callback) override;
   void Put(const std::string& key,
            const std::string& data,
            const std::function<void(Status status)>& callback) override;
+  void Patch(const std::string& key,
+             const std::string& data,
+             const std::function<void(Status status)>& callback) override;
   void Delete(const std::string& key,
               const std::function<void(Status status)>& callback) override;
   void Watch(const std::string& key,
@@ -71,6 +81,11 @@ class FirebaseImpl : public Firebase {
       const std::function<void(Status status, std::string response)>& callback,
       network::URLResponsePtr response);
 
+  void OnObjectMembersResponse(
+      const std::function<ObjectMemberCallback>& on_member,
+      const std::function<void(Status status)>& callback,
+      network::URLResponsePtr response);
+
   void OnStream(WatchClient* watch_client, network::URLResponsePtr response);
 
   void OnStreamComplete(WatchClient* watch_client);
@@ -78,7 +93,21 @@ class FirebaseImpl : public Firebase {
   void OnStreamEvent(WatchClient* watch_client,
                      Status status,
                      const std::string& event,
-                     const std::string& payload);
+                     std::string payload);
+
+  // Starts parsing the payload of the event as it is received, if it is a put
+  // or patch event, so that the members of its data can be passed to the watch
+  // client one by one. Returns whether the payload is to be streamed.
+  bool OnStreamPayloadStart(WatchClient* watch_client,
+                            const std::string& event);
+
+  void OnStreamPayloadChunk(WatchClient* watch_client, ftl::StringView chunk);
+
+  void OnStreamPayloadMember(WatchClient* watch_client,
+                             const std::string& key,
+                             const rapidjson::Value& value);
+
+  void OnStreamPayloadEnd(WatchClient* watch_client, const std::string& event);
 
   void HandleMalformedEvent(WatchClient* watch_client,
                             const std::string& event,
@@ -89,9 +118,13 @@ class FirebaseImpl : public Firebase {
   // Api url against which requests are made, without a trailing slash.
   const std::string api_url_;
 
+  // Runs the parsers of the streamed JSON data. Must outlive them.
+  coroutine::CoroutineServiceImpl coroutine_service_;
   callback::CancellableContainer requests_;
   callback::AutoCleanableSet<glue::SocketDrainerClient> drainers_;
+  callback::AutoCleanableSet<JsonObjectStreamReader> object_readers_;
 
+  struct EventPayload;
   struct WatchData;
   std::map<WatchClient*, std::unique_ptr<WatchData>> watch_data_;
 };
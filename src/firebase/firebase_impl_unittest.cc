@@ -5,7 +5,9 @@
 #include "apps/ledger/src/firebase/firebase_impl.h"
 
 #include <memory>
+#include <string>
 #include <utility>
+#include <vector>
 
 #include <rapidjson/document.h>
 
@@ -45,6 +47,24 @@ class FirebaseImplTest : public test::TestWithMessageLoop, public WatchClient {
     patch_data_.push_back(rapidjson::Value(value, document_.GetAllocator()));
   }
 
+  bool StreamsDataMembers(const std::string& event,
+                          const std::string& path) override {
+    return path == streamed_path_;
+  }
+
+  void OnDataMember(const std::string& key,
+                    const rapidjson::Value& value) override {
+    data_member_keys_.push_back(key);
+    data_member_values_.push_back(
+        rapidjson::Value(value, document_.GetAllocator()));
+  }
+
+  void OnDataEnd(const std::string& event, const std::string& path) override {
+    data_end_count_++;
+    data_end_events_.push_back(event);
+    data_end_paths_.push_back(path);
+  }
+
   void OnCancel() override { cancel_count_++; }
 
   void OnAuthRevoked(const std::string& reason) override {
@@ -67,6 +87,14 @@ class FirebaseImplTest : public test::TestWithMessageLoop, public WatchClient {
   std::vector<rapidjson::Value> patch_data_;
   unsigned int patch_count_ = 0u;
 
+  // Path of the events whose data members are streamed.
+  std::string streamed_path_;
+  std::vector<std::string> data_member_keys_;
+  std::vector<rapidjson::Value> data_member_values_;
+  std::vector<std::string> data_end_events_;
+  std::vector<std::string> data_end_paths_;
+  unsigned int data_end_count_ = 0u;
+
   unsigned int cancel_count_ = 0u;
 
   std::vector<std::string> auth_revoked_reasons_;
@@ -131,6 +159,48 @@ TEST_F(FirebaseImplTest, GetWithQuery) {
   EXPECT_EQ("GET", fake_network_service_.GetRequest()->method);
 }
 
+TEST_F(FirebaseImplTest, GetObjectMembers) {
+  fake_network_service_.SetStringResponse("{\"a\": 1, \"b\": {\"c\": 2}}",
+                                          200);
+  std::vector<std::string> keys;
+  Status status;
+  firebase_.GetObjectMembers(
+      "bazinga", "orderBy=\"timestamp\"",
+      [&keys](const std::string& key, const rapidjson::Value& value) {
+        keys.push_back(key);
+      },
+      [this, &status](Status s) {
+        status = s;
+        message_loop_.PostQuitTask();
+      });
+
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+  EXPECT_EQ(std::vector<std::string>({"a", "b"}), keys);
+  EXPECT_EQ(
+      "https://example.firebaseio.com/pre/fix/"
+      "bazinga.json?orderBy=\"timestamp\"",
+      fake_network_service_.GetRequest()->url);
+  EXPECT_EQ("GET", fake_network_service_.GetRequest()->method);
+}
+
+TEST_F(FirebaseImplTest, GetObjectMembersParseError) {
+  fake_network_service_.SetStringResponse("\"content\"", 200);
+  Status status;
+  firebase_.GetObjectMembers(
+      "bazinga", "",
+      [](const std::string& key, const rapidjson::Value& value) {
+        ADD_FAILURE();
+      },
+      [this, &status](Status s) {
+        status = s;
+        message_loop_.PostQuitTask();
+      });
+
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::PARSE_ERROR, status);
+}
+
 // Verifies that request urls for root of the db are correctly formed.
 TEST_F(FirebaseImplTest, Root) {
   fake_network_service_.SetStringResponse("42", 200);
@@ -159,6 +229,20 @@ TEST_F(FirebaseImplTest, Put) {
   EXPECT_EQ("PUT", fake_network_service_.GetRequest()->method);
 }
 
+// Verifies that PATCH requests are handled correctly.
+TEST_F(FirebaseImplTest, Patch) {
+  fake_network_service_.SetStringResponse("{\"name\":\"Alice\"}", 200);
+  firebase_.Patch("person", "{\"name\":\"Alice\"}", [this](Status status) {
+    EXPECT_EQ(Status::OK, status);
+    message_loop_.PostQuitTask();
+  });
+
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ("https://example.firebaseio.com/pre/fix/person.json",
+            fake_network_service_.GetRequest()->url);
+  EXPECT_EQ("PATCH", fake_network_service_.GetRequest()->method);
+}
+
 // Verifies that DELETE requests are made correctly.
 TEST_F(FirebaseImplTest, Delete) {
   fake_network_service_.SetStringResponse("", 200);
@@ -260,6 +344,66 @@ TEST_F(FirebaseImplTest, WatchPatch) {
   EXPECT_EQ("Bob", patch_data_[0]["name2"]);
 }
 
+// Verifies that the members of the data of the events are passed one by one to
+// the watch clients that stream them.
+TEST_F(FirebaseImplTest, WatchStreamedData) {
+  std::string stream_body = std::string(
+      "event: put\n"
+      "data: {\"path\":\"/\",\"data\":{\"a\":{\"name\":\"Alice\"},"
+      "\"b\":42}}\n"
+      "\n"
+      "event: patch\n"
+      "data: {\"path\":\"/\",\"data\":{\"c\":\"Bob\"}}\n"
+      "\n"
+      "event: put\n"
+      "data: {\"path\":\"/bla/\",\"data\":{\"name\":\"Bob\"}}\n"
+      "\n"
+      "event: put\n"
+      "data: {\"path\":\"/\",\"data\":null}\n"
+      "\n");
+  fake_network_service_.SetStringResponse(stream_body, 200);
+  streamed_path_ = "/";
+
+  firebase_.Watch("/", "", this);
+  EXPECT_FALSE(RunLoopWithTimeout());
+
+  EXPECT_EQ(2u, data_end_count_);
+  EXPECT_EQ(std::vector<std::string>({"put", "patch"}), data_end_events_);
+  EXPECT_EQ(std::vector<std::string>({"/", "/"}), data_end_paths_);
+  ASSERT_EQ(3u, data_member_keys_.size());
+  EXPECT_EQ("a", data_member_keys_[0]);
+  EXPECT_EQ("Alice", data_member_values_[0]["name"]);
+  EXPECT_EQ("b", data_member_keys_[1]);
+  EXPECT_EQ(42, data_member_values_[1]);
+  EXPECT_EQ("c", data_member_keys_[2]);
+  EXPECT_EQ("Bob", data_member_values_[2]);
+
+  // The data that is not streamed is passed whole.
+  EXPECT_EQ(2u, put_count_);
+  EXPECT_EQ("/bla/", put_paths_[0]);
+  EXPECT_EQ("Bob", put_data_[0]["name"]);
+  EXPECT_EQ("/", put_paths_[1]);
+  EXPECT_TRUE(put_data_[1].IsNull());
+  EXPECT_EQ(0u, patch_count_);
+  EXPECT_EQ(0u, malformed_event_count_);
+}
+
+TEST_F(FirebaseImplTest, WatchMalformedStreamedData) {
+  std::string stream_body = std::string(
+      "event: put\n"
+      "data: {\"path\":\"/\",\"data\":{\"a\":1,\"b\":}}\n"
+      "\n");
+  fake_network_service_.SetStringResponse(stream_body, 200);
+  streamed_path_ = "/";
+
+  firebase_.Watch("/", "", this);
+  EXPECT_FALSE(RunLoopWithTimeout());
+
+  EXPECT_EQ(1u, malformed_event_count_);
+  EXPECT_EQ(0u, data_end_count_);
+  EXPECT_EQ(0u, put_count_);
+}
+
 TEST_F(FirebaseImplTest, WatchKeepAlive) {
   std::string stream_body = std::string(
       "event: keep-alive\n"
@@ -0,0 +1,296 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/firebase/json_object_stream_parser.h"
+
+#include <utility>
+
+#include "lib/ftl/logging.h"
+
+namespace firebase {
+
+namespace {
+
+// The values are parsed with an explicit stack, so that nested values do not
+// exhaust the stack of the coroutine, and the parsing stops at the end of each
+// value instead of expecting the end of the data.
+constexpr unsigned kParseFlags =
+    rapidjson::kParseIterativeFlag | rapidjson::kParseStopWhenDoneFlag;
+
+bool IsWhitespace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// Handler of a rapidjson reader accepting a single string.
+class KeyHandler
+    : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, KeyHandler> {
+ public:
+  explicit KeyHandler(std::string* key) : key_(key) {}
+
+  bool String(const char* str, rapidjson::SizeType length, bool /*copy*/) {
+    key_->assign(str, length);
+    return true;
+  }
+
+  bool Default() { return false; }
+
+ private:
+  std::string* const key_;
+};
+
+}  // namespace
+
+// Input stream of the rapidjson readers, reading the data received by the
+// parser.
+class JsonObjectStreamParser::InputStream {
+ public:
+  typedef char Ch;
+
+  explicit InputStream(JsonObjectStreamParser* parser) : parser_(parser) {}
+
+  char Peek() const { return parser_->Peek(); }
+  char Take() { return parser_->Take(); }
+  size_t Tell() const { return parser_->offset_; }
+
+  // Only used for parsing in place, which the parser doesn't do.
+  char* PutBegin() {
+    FTL_NOTREACHED();
+    return nullptr;
+  }
+  void Put(char /*c*/) { FTL_NOTREACHED(); }
+  void Flush() { FTL_NOTREACHED(); }
+  size_t PutEnd(char* /*begin*/) {
+    FTL_NOTREACHED();
+    return 0;
+  }
+
+ private:
+  JsonObjectStreamParser* const parser_;
+};
+
+JsonObjectStreamParser::JsonObjectStreamParser(
+    coroutine::CoroutineService* coroutine_service,
+    std::function<ObjectMemberCallback> on_member)
+    : on_member_(std::move(on_member)) {
+  // The coroutine runs until it needs the first chunk of data.
+  coroutine_service->StartCoroutine(
+      [this](coroutine::CoroutineHandler* handler) {
+        handler_ = handler;
+        success_ = Parse();
+        done_ = true;
+      });
+}
+
+JsonObjectStreamParser::~JsonObjectStreamParser() {
+  if (!done_) {
+    // Make the coroutine unwind its stack.
+    handler_->Continue(true);
+  }
+}
+
+void JsonObjectStreamParser::StreamNestedObject(
+    std::string key,
+    std::function<bool()> should_stream,
+    std::function<ObjectMemberCallback> on_nested_member) {
+  nested_key_ = std::move(key);
+  should_stream_nested_ = std::move(should_stream);
+  on_nested_member_ = std::move(on_nested_member);
+}
+
+bool JsonObjectStreamParser::Feed(ftl::StringView data) {
+  FTL_DCHECK(!finished_);
+  if (done_) {
+    return success_;
+  }
+
+  buffer_.erase(0, position_);
+  position_ = 0;
+  buffer_.append(data.data(), data.size());
+  if (!Resume()) {
+    return false;
+  }
+  return !done_ || success_;
+}
+
+bool JsonObjectStreamParser::Finish() {
+  FTL_DCHECK(!finished_);
+  finished_ = true;
+  if (!done_ && !Resume()) {
+    return false;
+  }
+  FTL_DCHECK(done_);
+  return success_;
+}
+
+bool JsonObjectStreamParser::Parse() {
+  if (SkipWhitespace() == '{') {
+    Take();
+    if (!ParseMembers(false)) {
+      return false;
+    }
+  } else {
+    rapidjson::Document value;
+    if (!ParseValue(&value) || !value.IsNull()) {
+      return false;
+    }
+  }
+
+  // Only whitespace can follow the value.
+  SkipWhitespace();
+  return position_ == buffer_.size() && !interrupted_;
+}
+
+bool JsonObjectStreamParser::ParseMembers(bool nested) {
+  if (SkipWhitespace() == '}') {
+    Take();
+    return true;
+  }
+
+  while (true) {
+    std::string key;
+    if (!ParseKey(&key) || SkipWhitespace() != ':') {
+      return false;
+    }
+    Take();
+
+    if (!nested && should_stream_nested_ && key == nested_key_ &&
+        SkipWhitespace() == '{' && should_stream_nested_()) {
+      Take();
+      if (!ParseMembers(true)) {
+        return false;
+      }
+    } else {
+      auto value = std::make_unique<rapidjson::Document>();
+      if (!ParseValue(value.get()) ||
+          !YieldMember(std::move(key), std::move(value), nested)) {
+        return false;
+      }
+    }
+
+    char separator = SkipWhitespace();
+    Take();
+    if (separator == '}') {
+      return true;
+    }
+    if (separator != ',') {
+      return false;
+    }
+  }
+}
+
+bool JsonObjectStreamParser::ParseValue(rapidjson::Document* value) {
+  InputStream stream(this);
+  value->ParseStream<kParseFlags>(stream);
+  return !value->HasParseError();
+}
+
+bool JsonObjectStreamParser::ParseKey(std::string* key) {
+  InputStream stream(this);
+  KeyHandler handler(key);
+  return !key_reader_.Parse<kParseFlags>(stream, handler).IsError();
+}
+
+bool JsonObjectStreamParser::YieldMember(
+    std::string key,
+    std::unique_ptr<rapidjson::Document> value,
+    bool nested) {
+  pending_key_ = std::move(key);
+  pending_value_ = std::move(value);
+  pending_nested_ = nested;
+  if (handler_->Yield()) {
+    interrupted_ = true;
+    pending_value_.reset();
+    return false;
+  }
+  return true;
+}
+
+char JsonObjectStreamParser::SkipWhitespace() {
+  char c = Peek();
+  while (IsWhitespace(c)) {
+    Take();
+    c = Peek();
+  }
+  return c;
+}
+
+char JsonObjectStreamParser::Peek() {
+  while (position_ == buffer_.size()) {
+    if (finished_ || interrupted_) {
+      return '\0';
+    }
+    if (handler_->Yield()) {
+      interrupted_ = true;
+    }
+  }
+  return buffer_[position_];
+}
+
+char JsonObjectStreamParser::Take() {
+  char c = Peek();
+  if (position_ < buffer_.size()) {
+    ++position_;
+    ++offset_;
+  }
+  return c;
+}
+
+bool JsonObjectStreamParser::Resume() {
+  handler_->Continue(false);
+  while (pending_value_) {
+    std::string key = std::move(pending_key_);
+    std::unique_ptr<rapidjson::Document> value = std::move(pending_value_);
+    const std::function<ObjectMemberCallback>& callback =
+        pending_nested_ ? on_nested_member_ : on_member_;
+    if (destruction_sentinel_.DestructedWhile(
+            [&callback, &key, &value] { callback(key, *value); })) {
+      return false;
+    }
+    handler_->Continue(false);
+  }
+  return true;
+}
+
+JsonObjectStreamReader::JsonObjectStreamReader(
+    coroutine::CoroutineService* coroutine_service)
+    : coroutine_service_(coroutine_service), drainer_(this) {}
+
+JsonObjectStreamReader::~JsonObjectStreamReader() {}
+
+void JsonObjectStreamReader::Start(
+    mx::socket source,
+    std::function<ObjectMemberCallback> on_member,
+    std::function<void(Status)> callback) {
+  parser_ = std::make_unique<JsonObjectStreamParser>(coroutine_service_,
+                                                     std::move(on_member));
+  callback_ = std::move(callback);
+  drainer_.Start(std::move(source));
+}
+
+void JsonObjectStreamReader::OnDataAvailable(const void* data,
+                                             size_t num_bytes) {
+  if (parse_error_) {
+    // Drain the rest of the response, the error is reported on completion.
+    return;
+  }
+  parse_error_ = !parser_->Feed(
+      ftl::StringView(static_cast<const char*>(data), num_bytes));
+}
+
+void JsonObjectStreamReader::OnDataComplete() {
+  if (!parse_error_ && !parser_->Finish()) {
+    parse_error_ = true;
+  }
+  if (parse_error_) {
+    FTL_LOG(ERROR) << "Failed to parse the response as a JSON object.";
+  }
+
+  ftl::Closure on_empty_callback = std::move(on_empty_callback_);
+  callback_(parse_error_ ? Status::PARSE_ERROR : Status::OK);
+  // This class might be deleted here. Do not access any field.
+  if (on_empty_callback)
+    on_empty_callback();
+}
+
+}  // namespace firebase
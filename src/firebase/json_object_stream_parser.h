@@ -0,0 +1,173 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_FIREBASE_JSON_OBJECT_STREAM_PARSER_H_
+#define APPS_LEDGER_SRC_FIREBASE_JSON_OBJECT_STREAM_PARSER_H_
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "apps/ledger/src/callback/destruction_sentinel.h"
+#include "apps/ledger/src/coroutine/coroutine.h"
+#include "apps/ledger/src/firebase/status.h"
+#include "lib/ftl/functional/closure.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/strings/string_view.h"
+#include "lib/mtl/socket/socket_drainer.h"
+
+#include <rapidjson/document.h>
+#include <rapidjson/reader.h>
+
+namespace firebase {
+
+using ObjectMemberCallback = void(const std::string& key,
+                                  const rapidjson::Value& value);
+
+// Incrementally parses a JSON object received in chunks, passing each member
+// of the object to the client as soon as it is fully received. Only the member
+// being received is held in memory, so that the memory needed to parse the
+// object is bounded by the size of its biggest member rather than by the size
+// of the whole object.
+//
+// The data is decoded by rapidjson readers pulling it from an input stream. The
+// readers run in a coroutine of |coroutine_service|, which is suspended when
+// the received data is exhausted and continued by the next call to Feed(). The
+// members are passed to the client outside of the coroutine.
+//
+// A JSON null is accepted as an empty object, as this is what Firebase returns
+// for a location holding no data.
+class JsonObjectStreamParser {
+ public:
+  // |on_member| is called with the key and the value of each member of the
+  // object, in the order in which they are received.
+  JsonObjectStreamParser(coroutine::CoroutineService* coroutine_service,
+                         std::function<ObjectMemberCallback> on_member);
+  ~JsonObjectStreamParser();
+
+  // Passes the members of the value of the member |key| to |on_nested_member|
+  // one by one as they are received, instead of passing the whole value to
+  // |on_member|. This only applies if the value is an object and
+  // |should_stream| returns true when the value starts to be received.
+  // |should_stream| must not call back into the parser. This must be called
+  // before the key is received.
+  void StreamNestedObject(std::string key,
+                          std::function<bool()> should_stream,
+                          std::function<ObjectMemberCallback> on_nested_member);
+
+  // Parses the next chunk of data. Returns false if the data received so far is
+  // not the beginning of a valid JSON object, in which case no further members
+  // are passed to the client. The parser can be deleted from the member
+  // callbacks, in which case the return value is false and must be ignored.
+  bool Feed(ftl::StringView data);
+
+  // Returns true iff the data received is a complete JSON object or a JSON
+  // null. Feed() must not be called after this method.
+  bool Finish();
+
+ private:
+  class InputStream;
+
+  // Parses the received data. This runs in the coroutine.
+  bool Parse();
+
+  // Parses the members of an object whose opening brace was consumed, up to
+  // and including the closing brace.
+  bool ParseMembers(bool nested);
+
+  // Parses the next JSON value of the data into |value|.
+  bool ParseValue(rapidjson::Document* value);
+
+  // Parses the next JSON string of the data into |key|.
+  bool ParseKey(std::string* key);
+
+  // Suspends the coroutine so that the given member is passed to the client.
+  bool YieldMember(std::string key,
+                   std::unique_ptr<rapidjson::Document> value,
+                   bool nested);
+
+  // Skips whitespace, then returns the next character without consuming it.
+  char SkipWhitespace();
+
+  // Returns the next character of the data without consuming it, suspending
+  // the coroutine until more data is received if needed. Returns '\0' at the
+  // end of the data.
+  char Peek();
+
+  // Consumes the next character of the data.
+  char Take();
+
+  // Continues the coroutine until it needs more data or terminates, passing
+  // the members it parses to the client. Returns false if the parser is
+  // deleted by the client.
+  bool Resume();
+
+  const std::function<ObjectMemberCallback> on_member_;
+  std::string nested_key_;
+  std::function<bool()> should_stream_nested_;
+  std::function<ObjectMemberCallback> on_nested_member_;
+
+  coroutine::CoroutineHandler* handler_ = nullptr;
+  // Reads the keys, reusing its parsing stack between them.
+  rapidjson::Reader key_reader_;
+  // Data received and not consumed yet, starting at |position_|.
+  std::string buffer_;
+  size_t position_ = 0;
+  // Number of bytes consumed since the beginning of the data.
+  size_t offset_ = 0;
+  // Set by Finish(), after which the end of |buffer_| is the end of the data.
+  bool finished_ = false;
+  // Set if the coroutine is interrupted on deletion.
+  bool interrupted_ = false;
+  // Set once the coroutine terminates.
+  bool done_ = false;
+  bool success_ = false;
+
+  // Member parsed by the coroutine and not passed to the client yet.
+  std::string pending_key_;
+  std::unique_ptr<rapidjson::Document> pending_value_;
+  bool pending_nested_ = false;
+
+  callback::DestructionSentinel destruction_sentinel_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(JsonObjectStreamParser);
+};
+
+// Socket drainer parsing the data it reads with a JsonObjectStreamParser.
+class JsonObjectStreamReader : public mtl::SocketDrainer::Client {
+ public:
+  explicit JsonObjectStreamReader(
+      coroutine::CoroutineService* coroutine_service);
+  ~JsonObjectStreamReader() override;
+
+  // Parses the JSON object read from |source|, calling |on_member| with each of
+  // its members. |callback| is called once the whole object is read, with
+  // Status::PARSE_ERROR if the data is not a valid JSON object, in which case
+  // the members already passed to |on_member| must be discarded.
+  void Start(mx::socket source,
+             std::function<ObjectMemberCallback> on_member,
+             std::function<void(Status)> callback);
+
+  void set_on_empty(ftl::Closure on_empty_callback) {
+    on_empty_callback_ = std::move(on_empty_callback);
+  }
+
+ private:
+  // mtl::SocketDrainer::Client:
+  void OnDataAvailable(const void* data, size_t num_bytes) override;
+  void OnDataComplete() override;
+
+  coroutine::CoroutineService* const coroutine_service_;
+  std::unique_ptr<JsonObjectStreamParser> parser_;
+  std::function<void(Status)> callback_;
+  bool parse_error_ = false;
+  mtl::SocketDrainer drainer_;
+  ftl::Closure on_empty_callback_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(JsonObjectStreamReader);
+};
+
+}  // namespace firebase
+
+#endif  // APPS_LEDGER_SRC_FIREBASE_JSON_OBJECT_STREAM_PARSER_H_
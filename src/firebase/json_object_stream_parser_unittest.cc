@@ -0,0 +1,193 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/firebase/json_object_stream_parser.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include "apps/ledger/src/coroutine/coroutine_impl.h"
+#include "gtest/gtest.h"
+#include "lib/ftl/macros.h"
+
+namespace firebase {
+namespace {
+
+std::string ToString(const rapidjson::Value& value) {
+  rapidjson::StringBuffer buffer;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+  value.Accept(writer);
+  return buffer.GetString();
+}
+
+class JsonObjectStreamParserTest : public ::testing::Test {
+ public:
+  JsonObjectStreamParserTest()
+      : parser_(&coroutine_service_,
+                [this](const std::string& key, const rapidjson::Value& value) {
+                  members_.emplace_back(key, ToString(value));
+                }) {}
+  ~JsonObjectStreamParserTest() override {}
+
+ protected:
+  // Feeds |data| to the parser in chunks of |chunk_size| bytes.
+  bool FeedInChunks(const std::string& data, size_t chunk_size) {
+    for (size_t i = 0; i < data.size(); i += chunk_size) {
+      if (!parser_.Feed(ftl::StringView(data).substr(i, chunk_size))) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  coroutine::CoroutineServiceImpl coroutine_service_;
+  JsonObjectStreamParser parser_;
+  std::vector<std::pair<std::string, std::string>> members_;
+
+ private:
+  FTL_DISALLOW_COPY_AND_ASSIGN(JsonObjectStreamParserTest);
+};
+
+TEST_F(JsonObjectStreamParserTest, Members) {
+  EXPECT_TRUE(FeedInChunks(
+      "{\"a\": 1, \"b\" : {\"c\": [1, {\"d\": \"}\"}]},\n\"e\\\"\": \"\\\"{\"}",
+      1));
+  EXPECT_TRUE(parser_.Finish());
+
+  ASSERT_EQ(3u, members_.size());
+  EXPECT_EQ("a", members_[0].first);
+  EXPECT_EQ("1", members_[0].second);
+  EXPECT_EQ("b", members_[1].first);
+  EXPECT_EQ("{\"c\":[1,{\"d\":\"}\"}]}", members_[1].second);
+  EXPECT_EQ("e\"", members_[2].first);
+  EXPECT_EQ("\"\\\"{\"", members_[2].second);
+}
+
+// Verifies that each member is passed to the client as soon as it is received.
+TEST_F(JsonObjectStreamParserTest, MembersAreStreamed) {
+  EXPECT_TRUE(parser_.Feed("{\"a\": {\"b\""));
+  EXPECT_TRUE(members_.empty());
+  EXPECT_TRUE(parser_.Feed(": 1}, \"c\""));
+  ASSERT_EQ(1u, members_.size());
+  EXPECT_EQ("a", members_[0].first);
+  EXPECT_EQ("{\"b\":1}", members_[0].second);
+
+  // The end of a number is only known once the next character is received.
+  EXPECT_TRUE(parser_.Feed(": 2"));
+  EXPECT_EQ(1u, members_.size());
+  EXPECT_TRUE(parser_.Feed("}  "));
+  ASSERT_EQ(2u, members_.size());
+  EXPECT_EQ("c", members_[1].first);
+  EXPECT_EQ("2", members_[1].second);
+  EXPECT_TRUE(parser_.Finish());
+}
+
+TEST_F(JsonObjectStreamParserTest, StreamNestedObject) {
+  std::vector<std::pair<std::string, std::string>> nested_members;
+  bool stream = false;
+  parser_.StreamNestedObject(
+      "data", [&stream] { return stream; },
+      [&nested_members](const std::string& key,
+                        const rapidjson::Value& value) {
+        nested_members.emplace_back(key, ToString(value));
+      });
+
+  EXPECT_TRUE(parser_.Feed("{\"data\": {\"a\": 1}, "));
+  ASSERT_EQ(1u, members_.size());
+  EXPECT_EQ("data", members_[0].first);
+  EXPECT_TRUE(nested_members.empty());
+
+  stream = true;
+  EXPECT_TRUE(parser_.Feed("\"data\": {\"b\": [2], \"c\": {\"d\""));
+  ASSERT_EQ(1u, nested_members.size());
+  EXPECT_EQ("b", nested_members[0].first);
+  EXPECT_EQ("[2]", nested_members[0].second);
+
+  EXPECT_TRUE(FeedInChunks(": 3}}, \"data\": null}", 1));
+  EXPECT_TRUE(parser_.Finish());
+  ASSERT_EQ(2u, nested_members.size());
+  EXPECT_EQ("c", nested_members[1].first);
+  EXPECT_EQ("{\"d\":3}", nested_members[1].second);
+  // Values that are not objects are not streamed.
+  ASSERT_EQ(2u, members_.size());
+  EXPECT_EQ("data", members_[1].first);
+  EXPECT_EQ("null", members_[1].second);
+}
+
+TEST_F(JsonObjectStreamParserTest, DeleteOnMember) {
+  std::unique_ptr<JsonObjectStreamParser> parser;
+  int member_count = 0;
+  parser = std::make_unique<JsonObjectStreamParser>(
+      &coroutine_service_,
+      [&parser, &member_count](const std::string& key,
+                               const rapidjson::Value& value) {
+        ++member_count;
+        parser.reset();
+      });
+  parser->Feed("{\"a\": 1, \"b\": 2, \"c\": 3}");
+  EXPECT_FALSE(parser);
+  EXPECT_EQ(1, member_count);
+}
+
+TEST_F(JsonObjectStreamParserTest, DeleteBeforeEnd) {
+  auto parser = std::make_unique<JsonObjectStreamParser>(
+      &coroutine_service_,
+      [](const std::string& key, const rapidjson::Value& value) {});
+  EXPECT_TRUE(parser->Feed("{\"a\": [1, "));
+  parser.reset();
+}
+
+TEST_F(JsonObjectStreamParserTest, EmptyObject) {
+  EXPECT_TRUE(parser_.Feed(" { } "));
+  EXPECT_TRUE(parser_.Finish());
+  EXPECT_TRUE(members_.empty());
+}
+
+TEST_F(JsonObjectStreamParserTest, Null) {
+  EXPECT_TRUE(FeedInChunks("null", 1));
+  EXPECT_TRUE(parser_.Finish());
+  EXPECT_TRUE(members_.empty());
+}
+
+TEST_F(JsonObjectStreamParserTest, NotAnObject) {
+  EXPECT_FALSE(parser_.Feed("[1, 2]"));
+  EXPECT_FALSE(parser_.Finish());
+  EXPECT_TRUE(members_.empty());
+}
+
+TEST_F(JsonObjectStreamParserTest, MalformedMember) {
+  EXPECT_FALSE(parser_.Feed("{\"a\": 1, \"b\" 2, \"c\": 3}"));
+  EXPECT_FALSE(parser_.Finish());
+  ASSERT_EQ(1u, members_.size());
+  EXPECT_EQ("a", members_[0].first);
+}
+
+TEST_F(JsonObjectStreamParserTest, TrailingComma) {
+  EXPECT_FALSE(parser_.Feed("{\"a\": 1,}"));
+  EXPECT_FALSE(parser_.Finish());
+}
+
+TEST_F(JsonObjectStreamParserTest, UnbalancedBrackets) {
+  EXPECT_FALSE(parser_.Feed("{\"a\": [1]]}"));
+  EXPECT_FALSE(parser_.Finish());
+}
+
+TEST_F(JsonObjectStreamParserTest, DataAfterObject) {
+  EXPECT_FALSE(parser_.Feed("{\"a\": 1} 2"));
+  EXPECT_FALSE(parser_.Finish());
+}
+
+TEST_F(JsonObjectStreamParserTest, Incomplete) {
+  EXPECT_TRUE(parser_.Feed("{\"a\": 1"));
+  EXPECT_TRUE(members_.empty());
+  EXPECT_FALSE(parser_.Finish());
+}
+
+}  // namespace
+}  // namespace firebase
@@ -18,6 +18,23 @@ class WatchClient {
   virtual void OnPut(const std::string& path, const rapidjson::Value& value) {}
   virtual void OnPatch(const std::string& path, const rapidjson::Value& value) {
   }
+
+  // Returns true if the members of the data of the |event| put or patch event
+  // at |path| are to be passed one by one to OnDataMember() as they are
+  // received, followed by a call to OnDataEnd() once the event is complete,
+  // instead of passing the whole data to OnPut() or OnPatch(). This bounds the
+  // memory needed to receive the events holding a lot of data, such as the
+  // initial put event. It only applies if the data is an object. The members
+  // already received must be discarded if OnMalformedEvent() is called instead
+  // of OnDataEnd().
+  virtual bool StreamsDataMembers(const std::string& event,
+                                  const std::string& path) {
+    return false;
+  }
+  virtual void OnDataMember(const std::string& key,
+                            const rapidjson::Value& value) {}
+  virtual void OnDataEnd(const std::string& event, const std::string& path) {}
+
   virtual void OnCancel() {}
   virtual void OnAuthRevoked(const std::string& reason) {}
 
@@ -9,6 +9,7 @@
 #include <string>
 
 #include "apps/ledger/src/gcs/status.h"
+#include "apps/ledger/src/network/network_service.h"
 #include "lib/ftl/macros.h"
 #include "mx/socket.h"
 #include "mx/vmo.h"
@@ -24,8 +25,11 @@ class CloudStorage {
                             mx::vmo data,
                             const std::function<void(Status)>& callback) = 0;
 
+  // Downloads the object stored under |key|. The request is scheduled with
+  // |priority| among the other network requests.
   virtual void DownloadObject(
       const std::string& key,
+      ledger::RequestPriority priority,
       const std::function<void(Status status, uint64_t size, mx::socket data)>&
           callback) = 0;
 
@@ -118,7 +118,9 @@ void CloudStorageImpl::UploadObject(
     return request;
   });
 
-  Request(std::move(request_factory),
+  // Uploads happen in the background, they must not delay the requests that
+  // sync or clients are waiting for.
+  Request(std::move(request_factory), ledger::RequestPriority::BACKGROUND,
           [callback](Status status, network::URLResponsePtr response) {
             RunUploadObjectCallback(std::move(callback), status,
                                     std::move(response));
@@ -127,6 +129,7 @@ void CloudStorageImpl::UploadObject(
 
 void CloudStorageImpl::DownloadObject(
     const std::string& key,
+    ledger::RequestPriority priority,
     const std::function<void(Status status, uint64_t size, mx::socket data)>&
         callback) {
   std::string url = GetDownloadUrl(key);
@@ -139,6 +142,7 @@ void CloudStorageImpl::DownloadObject(
         request->auto_follow_redirects = true;
         return request;
       },
+      priority,
       [ this, callback = std::move(callback) ](
           Status status, network::URLResponsePtr response) {
         OnDownloadResponseReceived(std::move(callback), status,
@@ -158,13 +162,15 @@ std::string CloudStorageImpl::GetUploadUrl(ftl::StringView key) {
 
 void CloudStorageImpl::Request(
     std::function<network::URLRequestPtr()> request_factory,
+    ledger::RequestPriority priority,
     const std::function<void(Status status, network::URLResponsePtr response)>&
         callback) {
   network_service_->Request(std::move(request_factory),
                             [this, callback](network::URLResponsePtr response) {
                               OnResponse(std::move(callback),
                                          std::move(response));
-                            });
+                            },
+                            priority);
 }
 
 void CloudStorageImpl::OnResponse(
@@ -34,6 +34,7 @@ class CloudStorageImpl : public CloudStorage {
 
   void DownloadObject(
       const std::string& key,
+      ledger::RequestPriority priority,
       const std::function<void(Status status, uint64_t size, mx::socket data)>&
           callback) override;
 
@@ -44,6 +45,7 @@ class CloudStorageImpl : public CloudStorage {
 
   void Request(
       std::function<network::URLRequestPtr()> request_factory,
+      ledger::RequestPriority priority,
       const std::function<void(Status status,
                                network::URLResponsePtr response)>& callback);
   void OnResponse(
@@ -140,8 +140,9 @@ TEST_F(CloudStorageImplTest, TestDownload) {
   uint64_t size;
   mx::socket data;
   gcs_.DownloadObject(
-      "hello-world", callback::Capture([this] { message_loop_.PostQuitTask(); },
-                                       &status, &size, &data));
+      "hello-world", ledger::RequestPriority::INTERACTIVE,
+      callback::Capture([this] { message_loop_.PostQuitTask(); }, &status,
+                        &size, &data));
   ASSERT_FALSE(RunLoopWithTimeout());
 
   EXPECT_EQ(Status::OK, status);
@@ -150,6 +151,8 @@ TEST_F(CloudStorageImplTest, TestDownload) {
       "/v0/b/project.appspot.com/o/prefixhello-world?alt=media",
       fake_network_service_.GetRequest()->url);
   EXPECT_EQ("GET", fake_network_service_.GetRequest()->method);
+  EXPECT_EQ(ledger::RequestPriority::INTERACTIVE,
+            fake_network_service_.GetRequestPriority());
 
   std::string downloaded_content;
   EXPECT_TRUE(mtl::BlockingCopyToString(std::move(data), &downloaded_content));
@@ -157,6 +160,24 @@ TEST_F(CloudStorageImplTest, TestDownload) {
   EXPECT_EQ(size, content.size());
 }
 
+TEST_F(CloudStorageImplTest, TestDownloadInBackground) {
+  const std::string content = "Hello World\n";
+  SetResponse(content, content.size(), 200);
+
+  Status status;
+  uint64_t size;
+  mx::socket data;
+  gcs_.DownloadObject(
+      "hello-world", ledger::RequestPriority::BACKGROUND,
+      callback::Capture([this] { message_loop_.PostQuitTask(); }, &status,
+                        &size, &data));
+  ASSERT_FALSE(RunLoopWithTimeout());
+
+  EXPECT_EQ(Status::OK, status);
+  EXPECT_EQ(ledger::RequestPriority::BACKGROUND,
+            fake_network_service_.GetRequestPriority());
+}
+
 TEST_F(CloudStorageImplTest, TestDownloadNotFound) {
   SetResponse("", 0, 404);
 
@@ -164,8 +185,9 @@ TEST_F(CloudStorageImplTest, TestDownloadNotFound) {
   uint64_t size;
   mx::socket data;
   gcs_.DownloadObject(
-      "whoa", callback::Capture([this] { message_loop_.PostQuitTask(); },
-                                &status, &size, &data));
+      "whoa", ledger::RequestPriority::INTERACTIVE,
+      callback::Capture([this] { message_loop_.PostQuitTask(); }, &status,
+                        &size, &data));
   ASSERT_FALSE(RunLoopWithTimeout());
 
   EXPECT_EQ(Status::NOT_FOUND, status);
@@ -184,8 +206,9 @@ TEST_F(CloudStorageImplTest, TestDownloadWithResponseBodyTooShort) {
   uint64_t size;
   mx::socket data;
   gcs_.DownloadObject(
-      "hello-world", callback::Capture([this] { message_loop_.PostQuitTask(); },
-                                       &status, &size, &data));
+      "hello-world", ledger::RequestPriority::INTERACTIVE,
+      callback::Capture([this] { message_loop_.PostQuitTask(); }, &status,
+                        &size, &data));
   ASSERT_FALSE(RunLoopWithTimeout());
 
   std::string downloaded_content;
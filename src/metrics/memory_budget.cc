@@ -0,0 +1,173 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/metrics/memory_budget.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "lib/ftl/logging.h"
+
+namespace metrics {
+
+namespace {
+
+// Bounds of the delay between two trims. The delay doubles after each trim
+// that releases nothing.
+constexpr ftl::TimeDelta kMinTrimInterval = ftl::TimeDelta::FromSeconds(1);
+constexpr ftl::TimeDelta kMaxTrimInterval = ftl::TimeDelta::FromSeconds(60);
+
+// After a trim leaving the usage over the budget, the next trim only happens
+// once the usage grew by this fraction of the budget.
+constexpr int64_t kTrimHysteresisDivisor = 8;
+
+}  // namespace
+
+MemoryBudget::MemoryBudget(ftl::RefPtr<ftl::TaskRunner> task_runner,
+                           int64_t budget_bytes,
+                           MetricsRegistry* metrics)
+    : task_runner_(std::move(task_runner)),
+      budget_bytes_(budget_bytes),
+      trim_threshold_(budget_bytes),
+      trim_interval_(kMinTrimInterval),
+      usage_gauge_(OrUnreported(metrics)->GetGauge("memory_usage_bytes")),
+      trims_(OrUnreported(metrics)->GetCounter("memory_trims")),
+      weak_factory_(this) {
+  FTL_DCHECK(task_runner_);
+  FTL_DCHECK(budget_bytes_ >= 0);
+  OrUnreported(metrics)->GetGauge("memory_budget_bytes")->Set(budget_bytes_);
+}
+
+MemoryBudget::~MemoryBudget() {
+  FTL_DCHECK(trimmables_.empty());
+}
+
+void MemoryBudget::Charge(int64_t delta) {
+  int64_t usage = usage_.fetch_add(delta, std::memory_order_relaxed) + delta;
+  usage_gauge_->Add(delta);
+  if (budget_bytes_ == 0) {
+    return;
+  }
+  if (delta <= 0) {
+    if (usage <= budget_bytes_) {
+      trim_threshold_.store(budget_bytes_, std::memory_order_relaxed);
+    }
+    return;
+  }
+  if (usage <= trim_threshold_.load(std::memory_order_relaxed)) {
+    return;
+  }
+  if (trim_scheduled_.exchange(true)) {
+    return;
+  }
+  task_runner_->PostTask(
+      [weak_this = weak_factory_.GetWeakPtr()] {
+        if (weak_this) {
+          weak_this->OnTrimScheduled();
+        }
+      });
+}
+
+void MemoryBudget::AddTrimmable(Trimmable* trimmable) {
+  FTL_DCHECK(task_runner_->RunsTasksOnCurrentThread());
+  trimmables_.push_back(trimmable);
+}
+
+void MemoryBudget::RemoveTrimmable(Trimmable* trimmable) {
+  FTL_DCHECK(task_runner_->RunsTasksOnCurrentThread());
+  auto it = std::find(trimmables_.begin(), trimmables_.end(), trimmable);
+  FTL_DCHECK(it != trimmables_.end());
+  trimmables_.erase(it);
+}
+
+void MemoryBudget::Trim() {
+  FTL_DCHECK(task_runner_->RunsTasksOnCurrentThread());
+  last_trim_ = ftl::TimePoint::Now();
+  trims_->Increment();
+  int64_t usage_before_trim = usage();
+  // Trimming a component must not add or remove components, but iterate on a
+  // copy to be safe.
+  std::vector<Trimmable*> trimmables = trimmables_;
+  for (Trimmable* trimmable : trimmables) {
+    trimmable->Trim();
+  }
+
+  if (budget_bytes_ == 0) {
+    return;
+  }
+  int64_t usage_after_trim = usage();
+  if (usage_after_trim < usage_before_trim) {
+    trim_interval_ = kMinTrimInterval;
+  } else {
+    trim_interval_ = std::min(trim_interval_ * 2, kMaxTrimInterval);
+  }
+  trim_threshold_.store(
+      usage_after_trim <= budget_bytes_
+          ? budget_bytes_
+          : usage_after_trim + budget_bytes_ / kTrimHysteresisDivisor,
+      std::memory_order_relaxed);
+}
+
+void MemoryBudget::OnTrimScheduled() {
+  ftl::TimeDelta since_last_trim = ftl::TimePoint::Now() - last_trim_;
+  if (since_last_trim < trim_interval_) {
+    task_runner_->PostDelayedTask(
+        [weak_this = weak_factory_.GetWeakPtr()] {
+          if (weak_this) {
+            weak_this->OnTrimScheduled();
+          }
+        },
+        trim_interval_ - since_last_trim);
+    return;
+  }
+  trim_scheduled_ = false;
+  if (usage() <= trim_threshold_.load(std::memory_order_relaxed)) {
+    return;
+  }
+  FTL_LOG(INFO) << "Memory usage (" << usage() << " bytes) exceeds the budget ("
+                << budget_bytes_ << " bytes), trimming caches.";
+  Trim();
+}
+
+MemoryAccount::MemoryAccount(MetricsRegistry* metrics, const std::string& name)
+    : gauge_(OrUnreported(metrics)->GetGauge(name)),
+      budget_(OrUnreported(metrics)->memory_budget()) {}
+
+void MemoryAccount::Add(int64_t delta) const {
+  if (delta == 0) {
+    return;
+  }
+  if (gauge_) {
+    gauge_->Add(delta);
+  }
+  if (budget_) {
+    budget_->Charge(delta);
+  }
+}
+
+ScopedMemoryCharge::ScopedMemoryCharge(MemoryAccount account, int64_t bytes)
+    : account_(account), bytes_(bytes) {
+  account_.Add(bytes_);
+}
+
+ScopedMemoryCharge::ScopedMemoryCharge(ScopedMemoryCharge&& other)
+    : account_(other.account_), bytes_(other.bytes_) {
+  other.bytes_ = 0;
+}
+
+ScopedMemoryCharge::~ScopedMemoryCharge() {
+  account_.Add(-bytes_);
+}
+
+ScopedMemoryCharge& ScopedMemoryCharge::operator=(ScopedMemoryCharge&& other) {
+  if (this != &other) {
+    account_.Add(-bytes_);
+    account_ = other.account_;
+    bytes_ = other.bytes_;
+    other.bytes_ = 0;
+  }
+  return *this;
+}
+
+}  // namespace metrics
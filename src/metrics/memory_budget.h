@@ -0,0 +1,130 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_METRICS_MEMORY_BUDGET_H_
+#define APPS_LEDGER_SRC_METRICS_MEMORY_BUDGET_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "apps/ledger/src/metrics/metrics_registry.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/weak_ptr.h"
+#include "lib/ftl/tasks/task_runner.h"
+#include "lib/ftl/time/time_point.h"
+
+namespace metrics {
+
+// Ledger-wide accounting of the memory held by the caches and the buffers of
+// the components, enforced by trimming the caches when the usage exceeds the
+// budget.
+//
+// Only the memory of the registered caches can be released: the budget is a
+// target, not a hard limit. When a trim leaves the usage over the budget, the
+// next trim waits for the usage to grow further, and trims that release nothing
+// are spaced out exponentially, so that memory that can not be released (such
+// as the LevelDB memtables) does not cause the caches to be trimmed
+// continuously.
+class MemoryBudget {
+ public:
+  // Component holding memory that can be released on demand.
+  class Trimmable {
+   public:
+    Trimmable() {}
+    virtual ~Trimmable() {}
+
+    // Releases as much memory as possible. Called on the main thread.
+    virtual void Trim() = 0;
+
+   private:
+    FTL_DISALLOW_COPY_AND_ASSIGN(Trimmable);
+  };
+
+  // |task_runner| is the runner of the main thread, on which the trims happen.
+  // A |budget_bytes| of 0 disables the budget, memory is then only accounted.
+  MemoryBudget(ftl::RefPtr<ftl::TaskRunner> task_runner,
+               int64_t budget_bytes,
+               MetricsRegistry* metrics);
+  ~MemoryBudget();
+
+  // Records that |delta| bytes were allocated, or released if negative. Can be
+  // called from any thread. Schedules a trim if the usage exceeds the budget.
+  void Charge(int64_t delta);
+
+  int64_t usage() const { return usage_.load(std::memory_order_relaxed); }
+  int64_t budget_bytes() const { return budget_bytes_; }
+
+  // Registers and unregisters components to trim. Must be called on the main
+  // thread.
+  void AddTrimmable(Trimmable* trimmable);
+  void RemoveTrimmable(Trimmable* trimmable);
+
+  // Trims all the registered components.
+  void Trim();
+
+ private:
+  void OnTrimScheduled();
+
+  ftl::RefPtr<ftl::TaskRunner> task_runner_;
+  const int64_t budget_bytes_;
+  std::atomic<int64_t> usage_{0};
+  std::atomic<bool> trim_scheduled_{false};
+  // Usage above which a trim is scheduled. Equal to the budget, unless the last
+  // trim could not bring the usage under it.
+  std::atomic<int64_t> trim_threshold_;
+  ftl::TimePoint last_trim_;
+  // Minimal delay between the last trim and the next one.
+  ftl::TimeDelta trim_interval_;
+  Gauge* const usage_gauge_;
+  Counter* const trims_;
+  std::vector<Trimmable*> trimmables_;
+
+  // This must be the last member of the class.
+  ftl::WeakPtrFactory<MemoryBudget> weak_factory_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(MemoryBudget);
+};
+
+// Memory held by one kind of data of a component, such as the object contents
+// of a page. Reported as the gauge |name| of the registry of the component, and
+// charged to the memory budget of the registry, if any. Copyable, and valid as
+// long as the memory budget.
+class MemoryAccount {
+ public:
+  MemoryAccount() {}
+  MemoryAccount(MetricsRegistry* metrics, const std::string& name);
+
+  void Add(int64_t delta) const;
+
+ private:
+  Gauge* gauge_ = nullptr;
+  MemoryBudget* budget_ = nullptr;
+};
+
+// Charges the given number of bytes to an account for the lifetime of this
+// object.
+class ScopedMemoryCharge {
+ public:
+  ScopedMemoryCharge() {}
+  ScopedMemoryCharge(MemoryAccount account, int64_t bytes);
+  ScopedMemoryCharge(ScopedMemoryCharge&& other);
+  ~ScopedMemoryCharge();
+
+  ScopedMemoryCharge& operator=(ScopedMemoryCharge&& other);
+
+  int64_t bytes() const { return bytes_; }
+
+ private:
+  MemoryAccount account_;
+  int64_t bytes_ = 0;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ScopedMemoryCharge);
+};
+
+}  // namespace metrics
+
+#endif  // APPS_LEDGER_SRC_METRICS_MEMORY_BUDGET_H_
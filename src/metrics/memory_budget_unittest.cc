@@ -0,0 +1,139 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/metrics/memory_budget.h"
+
+#include <utility>
+
+#include "apps/ledger/src/test/test_with_message_loop.h"
+#include "gtest/gtest.h"
+#include "lib/ftl/functional/closure.h"
+
+namespace metrics {
+namespace {
+
+class FakeTrimmable : public MemoryBudget::Trimmable {
+ public:
+  explicit FakeTrimmable(ftl::Closure on_trim)
+      : on_trim_(std::move(on_trim)) {}
+
+  void Trim() override {
+    ++trim_count;
+    cache = ScopedMemoryCharge();
+    on_trim_();
+  }
+
+  int trim_count = 0;
+  ScopedMemoryCharge cache;
+
+ private:
+  ftl::Closure on_trim_;
+};
+
+class MemoryBudgetTest : public test::TestWithMessageLoop {
+ public:
+  MemoryBudgetTest() {}
+  ~MemoryBudgetTest() override {}
+
+ protected:
+  MetricsRegistry registry_;
+
+ private:
+  FTL_DISALLOW_COPY_AND_ASSIGN(MemoryBudgetTest);
+};
+
+TEST_F(MemoryBudgetTest, Accounting) {
+  MemoryBudget budget(message_loop_.task_runner(), 0, &registry_);
+  registry_.SetMemoryBudget(&budget);
+  MetricsRegistry* page = registry_.GetChild("page");
+  EXPECT_EQ(&budget, page->memory_budget());
+
+  MemoryAccount account(page, "memory_objects_bytes");
+  {
+    ScopedMemoryCharge charge(account, 10);
+    account.Add(5);
+    EXPECT_EQ(15, budget.usage());
+    EXPECT_EQ(15, page->GetGauge("memory_objects_bytes")->value());
+    EXPECT_EQ(15, registry_.GetGauge("memory_usage_bytes")->value());
+
+    ScopedMemoryCharge moved = std::move(charge);
+    EXPECT_EQ(15, budget.usage());
+  }
+  EXPECT_EQ(5, budget.usage());
+  account.Add(-5);
+  EXPECT_EQ(0, budget.usage());
+  EXPECT_EQ(0, page->GetGauge("memory_objects_bytes")->value());
+}
+
+TEST_F(MemoryBudgetTest, AccountWithoutBudget) {
+  MemoryAccount account(&registry_, "memory_objects_bytes");
+  account.Add(5);
+  EXPECT_EQ(5, registry_.GetGauge("memory_objects_bytes")->value());
+
+  // A default account ignores the charges.
+  ScopedMemoryCharge charge(MemoryAccount(), 10);
+  EXPECT_EQ(10, charge.bytes());
+}
+
+TEST_F(MemoryBudgetTest, TrimWhenOverBudget) {
+  MemoryBudget budget(message_loop_.task_runner(), 100, &registry_);
+  registry_.SetMemoryBudget(&budget);
+  FakeTrimmable trimmable([this] { message_loop_.PostQuitTask(); });
+  budget.AddTrimmable(&trimmable);
+
+  MemoryAccount account(&registry_, "memory_cache_bytes");
+  trimmable.cache = ScopedMemoryCharge(account, 80);
+  EXPECT_TRUE(RunLoopWithTimeout(ftl::TimeDelta::FromMilliseconds(10)));
+  EXPECT_EQ(0, trimmable.trim_count);
+
+  ScopedMemoryCharge other(account, 30);
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(1, trimmable.trim_count);
+  EXPECT_EQ(30, budget.usage());
+  EXPECT_EQ(1, registry_.GetCounter("memory_trims")->value());
+
+  budget.RemoveTrimmable(&trimmable);
+}
+
+TEST_F(MemoryBudgetTest, NoRepeatedTrimOfMemoryThatCannotBeReleased) {
+  MemoryBudget budget(message_loop_.task_runner(), 100, &registry_);
+  registry_.SetMemoryBudget(&budget);
+  FakeTrimmable trimmable([this] { message_loop_.PostQuitTask(); });
+  budget.AddTrimmable(&trimmable);
+
+  // Memory that is not held by |trimmable| can not be released.
+  MemoryAccount account(&registry_, "memory_buffers_bytes");
+  ScopedMemoryCharge buffers(account, 150);
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(1, trimmable.trim_count);
+
+  // Growing a little does not trigger a new trim.
+  ScopedMemoryCharge more_buffers(account, 5);
+  EXPECT_TRUE(RunLoopWithTimeout(ftl::TimeDelta::FromMilliseconds(10)));
+  EXPECT_EQ(1, trimmable.trim_count);
+
+  // Once the usage is back under the budget, exceeding it trims again.
+  buffers = ScopedMemoryCharge();
+  ScopedMemoryCharge new_buffers(account, 100);
+  EXPECT_FALSE(RunLoopWithTimeout(ftl::TimeDelta::FromSeconds(5)));
+  EXPECT_EQ(2, trimmable.trim_count);
+
+  budget.RemoveTrimmable(&trimmable);
+}
+
+TEST_F(MemoryBudgetTest, NoTrimWithoutBudget) {
+  MemoryBudget budget(message_loop_.task_runner(), 0, &registry_);
+  registry_.SetMemoryBudget(&budget);
+  FakeTrimmable trimmable([this] { message_loop_.PostQuitTask(); });
+  budget.AddTrimmable(&trimmable);
+
+  MemoryAccount(&registry_, "memory_cache_bytes").Add(1000);
+  EXPECT_TRUE(RunLoopWithTimeout(ftl::TimeDelta::FromMilliseconds(10)));
+  EXPECT_EQ(0, trimmable.trim_count);
+
+  budget.RemoveTrimmable(&trimmable);
+}
+
+}  // namespace
+}  // namespace metrics
@@ -0,0 +1,104 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/metrics/metrics_encoding.h"
+
+#include <utility>
+
+#include "lib/ftl/logging.h"
+#include "lib/ftl/strings/concatenate.h"
+#include "lib/ftl/strings/string_number_conversions.h"
+
+namespace metrics {
+
+namespace {
+
+constexpr ftl::StringView kFieldSeparator = "\t";
+constexpr ftl::StringView kLineSeparator = "\n";
+constexpr size_t kFieldCount = 6;
+
+constexpr ftl::StringView kCounterType = "counter";
+constexpr ftl::StringView kGaugeType = "gauge";
+constexpr ftl::StringView kHistogramType = "histogram";
+
+ftl::StringView EncodeType(MetricValue::Type type) {
+  switch (type) {
+    case MetricValue::Type::COUNTER:
+      return kCounterType;
+    case MetricValue::Type::GAUGE:
+      return kGaugeType;
+    case MetricValue::Type::HISTOGRAM:
+      return kHistogramType;
+  }
+  FTL_NOTREACHED();
+  return kCounterType;
+}
+
+bool DecodeType(ftl::StringView data, MetricValue::Type* type) {
+  if (data == kCounterType) {
+    *type = MetricValue::Type::COUNTER;
+  } else if (data == kGaugeType) {
+    *type = MetricValue::Type::GAUGE;
+  } else if (data == kHistogramType) {
+    *type = MetricValue::Type::HISTOGRAM;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// Splits |data| at each occurrence of |separator|.
+std::vector<ftl::StringView> Split(ftl::StringView data, char separator) {
+  std::vector<ftl::StringView> result;
+  size_t start = 0;
+  for (size_t i = 0; i < data.size(); ++i) {
+    if (data[i] == separator) {
+      result.push_back(data.substr(start, i - start));
+      start = i + 1;
+    }
+  }
+  result.push_back(data.substr(start));
+  return result;
+}
+
+}  // namespace
+
+std::string EncodeMetrics(const std::vector<MetricValue>& values) {
+  std::string result;
+  for (const MetricValue& value : values) {
+    // Paths and names never contain the separators: the names of the nested
+    // registries are escaped, and the names of the metrics are constants.
+    result.append(ftl::Concatenate(
+        {EncodeType(value.type), kFieldSeparator, value.path, kFieldSeparator,
+         value.name, kFieldSeparator, ftl::NumberToString(value.value),
+         kFieldSeparator, ftl::NumberToString(value.count), kFieldSeparator,
+         ftl::NumberToString(value.sum), kLineSeparator}));
+  }
+  return result;
+}
+
+bool DecodeMetrics(ftl::StringView data, std::vector<MetricValue>* values) {
+  std::vector<ftl::StringView> lines = Split(data, kLineSeparator[0]);
+  // The encoding ends with a line separator, so the last line is empty.
+  if (!lines.back().empty()) {
+    return false;
+  }
+  lines.pop_back();
+  for (ftl::StringView line : lines) {
+    std::vector<ftl::StringView> fields = Split(line, kFieldSeparator[0]);
+    MetricValue value;
+    if (fields.size() != kFieldCount || !DecodeType(fields[0], &value.type) ||
+        !ftl::StringToNumberWithError(fields[3], &value.value) ||
+        !ftl::StringToNumberWithError(fields[4], &value.count) ||
+        !ftl::StringToNumberWithError(fields[5], &value.sum)) {
+      return false;
+    }
+    value.path = fields[1].ToString();
+    value.name = fields[2].ToString();
+    values->push_back(std::move(value));
+  }
+  return true;
+}
+
+}  // namespace metrics
@@ -0,0 +1,27 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_METRICS_METRICS_ENCODING_H_
+#define APPS_LEDGER_SRC_METRICS_METRICS_ENCODING_H_
+
+#include <string>
+#include <vector>
+
+#include "apps/ledger/src/metrics/metrics_registry.h"
+#include "lib/ftl/strings/string_view.h"
+
+namespace metrics {
+
+// Encodes |values| as text, one metric per line, so that the metrics of the
+// running Ledger can be written to a file. The buckets of the histograms are
+// not encoded.
+std::string EncodeMetrics(const std::vector<MetricValue>& values);
+
+// Decodes the metrics encoded by EncodeMetrics() and appends them to |values|.
+// Returns false if |data| is malformed.
+bool DecodeMetrics(ftl::StringView data, std::vector<MetricValue>* values);
+
+}  // namespace metrics
+
+#endif  // APPS_LEDGER_SRC_METRICS_METRICS_ENCODING_H_
@@ -0,0 +1,57 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/metrics/metrics_encoding.h"
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace metrics {
+namespace {
+
+TEST(MetricsEncodingTest, EncodeDecode) {
+  MetricsRegistry registry;
+  registry.GetCounter("requests")->Increment(3);
+  MetricsRegistry* page = registry.GetChild("ledger:a")->GetChild("page:00");
+  page->GetGauge("watchers")->Set(-2);
+  page->GetHistogram("latency")->RecordMicroseconds(10);
+  page->GetHistogram("latency")->RecordMicroseconds(20);
+  std::vector<MetricValue> values;
+  registry.Snapshot("", &values);
+
+  std::vector<MetricValue> decoded_values;
+  ASSERT_TRUE(DecodeMetrics(EncodeMetrics(values), &decoded_values));
+  ASSERT_EQ(3u, decoded_values.size());
+  EXPECT_EQ("", decoded_values[0].path);
+  EXPECT_EQ("requests", decoded_values[0].name);
+  EXPECT_EQ(MetricValue::Type::COUNTER, decoded_values[0].type);
+  EXPECT_EQ(3, decoded_values[0].value);
+  EXPECT_EQ("ledger:a/page:00", decoded_values[1].path);
+  EXPECT_EQ("watchers", decoded_values[1].name);
+  EXPECT_EQ(MetricValue::Type::GAUGE, decoded_values[1].type);
+  EXPECT_EQ(-2, decoded_values[1].value);
+  EXPECT_EQ("latency", decoded_values[2].name);
+  EXPECT_EQ(MetricValue::Type::HISTOGRAM, decoded_values[2].type);
+  EXPECT_EQ(2, decoded_values[2].count);
+  EXPECT_EQ(30, decoded_values[2].sum);
+}
+
+TEST(MetricsEncodingTest, DecodeEmpty) {
+  std::vector<MetricValue> values;
+  EXPECT_TRUE(DecodeMetrics(EncodeMetrics(values), &values));
+  EXPECT_TRUE(values.empty());
+}
+
+TEST(MetricsEncodingTest, DecodeMalformed) {
+  std::vector<MetricValue> values;
+  EXPECT_FALSE(DecodeMetrics("counter\t\trequests\t3\t0\t0", &values));
+  EXPECT_FALSE(DecodeMetrics("timer\t\trequests\t3\t0\t0\n", &values));
+  EXPECT_FALSE(DecodeMetrics("counter\t\trequests\tthree\t0\t0\n", &values));
+  EXPECT_FALSE(DecodeMetrics("counter\trequests\t3\t0\t0\n", &values));
+}
+
+}  // namespace
+}  // namespace metrics
@@ -0,0 +1,233 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/metrics/metrics_registry.h"
+
+#include <ctype.h>
+
+#include <algorithm>
+
+#include "lib/ftl/logging.h"
+#include "lib/ftl/strings/concatenate.h"
+
+namespace metrics {
+
+namespace {
+
+template <typename T>
+T* GetOrCreate(std::map<std::string, std::unique_ptr<T>>* map,
+               const std::string& name) {
+  auto it = map->find(name);
+  if (it == map->end()) {
+    it = map->emplace(name, std::make_unique<T>()).first;
+  }
+  return it->second.get();
+}
+
+std::string ToHex(ftl::StringView bytes) {
+  constexpr char kHexadecimalCharacters[] = "0123456789abcdef";
+  std::string result;
+  result.reserve(bytes.size() * 2);
+  for (char c : bytes) {
+    result.push_back(kHexadecimalCharacters[(c >> 4) & 0xf]);
+    result.push_back(kHexadecimalCharacters[c & 0xf]);
+  }
+  return result;
+}
+
+// Escapes the characters of |name| that are not alphanumeric, '.', '_' or '-'
+// as '%' followed by their hexadecimal value, so that the name can not contain
+// the path separator.
+std::string Escape(ftl::StringView name) {
+  std::string result;
+  result.reserve(name.size());
+  for (char c : name) {
+    if (isalnum(static_cast<unsigned char>(c)) || c == '.' || c == '_' ||
+        c == '-') {
+      result.push_back(c);
+    } else {
+      result.push_back('%');
+      result.append(ToHex(ftl::StringView(&c, 1)));
+    }
+  }
+  return result;
+}
+
+}  // namespace
+
+constexpr size_t Histogram::kBucketCount;
+
+Histogram::Histogram() {
+  std::fill(buckets_, buckets_ + kBucketCount, 0);
+}
+
+Histogram::~Histogram() {}
+
+void Histogram::Record(ftl::TimeDelta duration) {
+  RecordMicroseconds(duration.ToMicroseconds());
+}
+
+void Histogram::RecordMicroseconds(int64_t value) {
+  if (value < 0) {
+    value = 0;
+  }
+  size_t index = GetBucketIndex(value);
+  std::lock_guard<std::mutex> lock(mutex_);
+  ++count_;
+  sum_ += value;
+  ++buckets_[index];
+}
+
+void Histogram::GetValues(int64_t* count,
+                          int64_t* sum,
+                          std::vector<int64_t>* buckets) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  *count = count_;
+  *sum = sum_;
+  buckets->assign(buckets_, buckets_ + kBucketCount);
+}
+
+void Histogram::Reset() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  count_ = 0;
+  sum_ = 0;
+  std::fill(buckets_, buckets_ + kBucketCount, 0);
+}
+
+size_t Histogram::GetBucketIndex(int64_t value) {
+  size_t index = 0;
+  while (value > 0 && index < kBucketCount - 1) {
+    value >>= 1;
+    ++index;
+  }
+  return index;
+}
+
+MetricsRegistry::MetricsRegistry() {}
+
+MetricsRegistry::~MetricsRegistry() {}
+
+Counter* MetricsRegistry::GetCounter(const std::string& name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return GetOrCreate(&counters_, name);
+}
+
+Gauge* MetricsRegistry::GetGauge(const std::string& name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return GetOrCreate(&gauges_, name);
+}
+
+Histogram* MetricsRegistry::GetHistogram(const std::string& name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return GetOrCreate(&histograms_, name);
+}
+
+MetricsRegistry* MetricsRegistry::GetChild(const std::string& name) {
+  FTL_DCHECK(name.find('/') == std::string::npos);
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = children_.find(name);
+  if (it == children_.end()) {
+    it = children_.emplace(name, std::make_unique<MetricsRegistry>()).first;
+    it->second->memory_budget_ = memory_budget_;
+  }
+  return it->second.get();
+}
+
+void MetricsRegistry::RemoveChild(const std::string& name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  children_.erase(name);
+}
+
+void MetricsRegistry::SetMemoryBudget(MemoryBudget* memory_budget) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  FTL_DCHECK(children_.empty());
+  memory_budget_ = memory_budget;
+}
+
+void MetricsRegistry::Snapshot(ftl::StringView path_prefix,
+                               std::vector<MetricValue>* values) const {
+  SnapshotWithPath("", path_prefix, values);
+}
+
+void MetricsRegistry::Reset() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto& counter : counters_) {
+    counter.second->Reset();
+  }
+  for (const auto& histogram : histograms_) {
+    histogram.second->Reset();
+  }
+  for (const auto& child : children_) {
+    child.second->Reset();
+  }
+}
+
+void MetricsRegistry::SnapshotWithPath(
+    const std::string& path,
+    ftl::StringView path_prefix,
+    std::vector<MetricValue>* values) const {
+  // Skip the subtrees that can not match the prefix.
+  size_t common_size = std::min(path.size(), path_prefix.size());
+  if (ftl::StringView(path).substr(0, common_size) !=
+      path_prefix.substr(0, common_size)) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (path.size() >= path_prefix.size()) {
+    for (const auto& counter : counters_) {
+      MetricValue value;
+      value.path = path;
+      value.name = counter.first;
+      value.type = MetricValue::Type::COUNTER;
+      value.value = counter.second->value();
+      values->push_back(std::move(value));
+    }
+    for (const auto& gauge : gauges_) {
+      MetricValue value;
+      value.path = path;
+      value.name = gauge.first;
+      value.type = MetricValue::Type::GAUGE;
+      value.value = gauge.second->value();
+      values->push_back(std::move(value));
+    }
+    for (const auto& histogram : histograms_) {
+      MetricValue value;
+      value.path = path;
+      value.name = histogram.first;
+      value.type = MetricValue::Type::HISTOGRAM;
+      histogram.second->GetValues(&value.count, &value.sum, &value.buckets);
+      values->push_back(std::move(value));
+    }
+  }
+  for (const auto& child : children_) {
+    std::string child_path =
+        path.empty() ? child.first : ftl::Concatenate({path, "/", child.first});
+    child.second->SnapshotWithPath(child_path, path_prefix, values);
+  }
+}
+
+MetricsRegistry* OrUnreported(MetricsRegistry* registry) {
+  if (registry) {
+    return registry;
+  }
+  // Intentionally leaked, as the pointers to its metrics may be used until the
+  // end of the process.
+  static MetricsRegistry* unreported = new MetricsRegistry();
+  return unreported;
+}
+
+std::string RepositoryNodeName(ftl::StringView repository_path) {
+  return ftl::Concatenate({"repository:", Escape(repository_path)});
+}
+
+std::string LedgerNodeName(ftl::StringView ledger_name) {
+  return ftl::Concatenate({"ledger:", Escape(ledger_name)});
+}
+
+std::string PageNodeName(ftl::StringView page_id) {
+  return ftl::Concatenate({"page:", ToHex(page_id)});
+}
+
+}  // namespace metrics
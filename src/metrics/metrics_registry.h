@@ -0,0 +1,190 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_METRICS_METRICS_REGISTRY_H_
+#define APPS_LEDGER_SRC_METRICS_METRICS_REGISTRY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "lib/ftl/macros.h"
+#include "lib/ftl/strings/string_view.h"
+#include "lib/ftl/time/time_delta.h"
+
+namespace metrics {
+
+class MemoryBudget;
+
+// Monotonic count of events. Can be updated from any thread.
+class Counter {
+ public:
+  Counter() {}
+  ~Counter() {}
+
+  void Increment(int64_t delta = 1) {
+    value_.fetch_add(delta, std::memory_order_relaxed);
+  }
+
+  int64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+  void Reset() { value_.store(0, std::memory_order_relaxed); }
+
+ private:
+  std::atomic<int64_t> value_{0};
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(Counter);
+};
+
+// Current value of a quantity, such as the size of a queue. Can be updated
+// from any thread.
+class Gauge {
+ public:
+  Gauge() {}
+  ~Gauge() {}
+
+  void Set(int64_t value) { value_.store(value, std::memory_order_relaxed); }
+
+  void Add(int64_t delta) {
+    value_.fetch_add(delta, std::memory_order_relaxed);
+  }
+
+  int64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<int64_t> value_{0};
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(Gauge);
+};
+
+// Distribution of latencies, recorded in microseconds. Bucket 0 counts the
+// samples below 1us, and bucket i > 0 counts the samples in [2^(i-1), 2^i)
+// microseconds. The last bucket also counts all larger samples. Can be updated
+// from any thread.
+class Histogram {
+ public:
+  static constexpr size_t kBucketCount = 32;
+
+  Histogram();
+  ~Histogram();
+
+  void Record(ftl::TimeDelta duration);
+  void RecordMicroseconds(int64_t value);
+
+  // Copies the current content of the histogram in the given parameters.
+  void GetValues(int64_t* count,
+                 int64_t* sum,
+                 std::vector<int64_t>* buckets) const;
+
+  void Reset();
+
+  // Returns the index of the bucket counting the given |value|.
+  static size_t GetBucketIndex(int64_t value);
+
+ private:
+  mutable std::mutex mutex_;
+  int64_t count_ = 0;
+  int64_t sum_ = 0;
+  int64_t buckets_[kBucketCount];
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(Histogram);
+};
+
+// Snapshot of the value of a single metric.
+struct MetricValue {
+  enum class Type { COUNTER, GAUGE, HISTOGRAM };
+
+  // Path of the registry holding the metric, as the names of the nested
+  // registries separated by "/". Empty for the root registry.
+  std::string path;
+  std::string name;
+  Type type;
+  // Value of a counter or a gauge.
+  int64_t value = 0;
+  // Number of samples, sum of the samples and content of the buckets of a
+  // histogram.
+  int64_t count = 0;
+  int64_t sum = 0;
+  std::vector<int64_t> buckets;
+};
+
+// Tree of named metrics. Each component of the ledger registers its metrics in
+// the registry of the object it serves (the repository, the ledger or the
+// page), obtained through GetChild(), so that the metrics can be broken down
+// by repository, ledger and page.
+//
+// Metrics and child registries are created on first access. Metrics are never
+// deleted, so that the returned pointers are valid for the lifetime of the
+// registry, while child registries are deleted by RemoveChild(), e.g. when the
+// page they measure is closed. Lookups are thread safe, but components are
+// expected to look their metrics up once and to keep the returned pointers.
+class MetricsRegistry {
+ public:
+  MetricsRegistry();
+  ~MetricsRegistry();
+
+  Counter* GetCounter(const std::string& name);
+  Gauge* GetGauge(const std::string& name);
+  Histogram* GetHistogram(const std::string& name);
+
+  // Returns the nested registry with the given |name|, creating it if needed.
+  MetricsRegistry* GetChild(const std::string& name);
+
+  // Deletes the nested registry with the given |name|, if any. The pointers to
+  // this registry, its metrics and its descendants must no longer be used.
+  void RemoveChild(const std::string& name);
+
+  // Sets the budget to which the memory accounted in this registry and in its
+  // descendants is charged. Must be called before any child is created.
+  void SetMemoryBudget(MemoryBudget* memory_budget);
+
+  // Returns the memory budget of this registry, or null if there is none.
+  MemoryBudget* memory_budget() const { return memory_budget_; }
+
+  // Appends to |values| the current value of the metrics of this registry and
+  // of its descendants whose path starts with |path_prefix|. The values of a
+  // registry are listed before the values of its children.
+  void Snapshot(ftl::StringView path_prefix,
+                std::vector<MetricValue>* values) const;
+
+  // Resets the counters and the histograms of this registry and of its
+  // descendants. Gauges are left untouched, as they reflect the current state
+  // of the component they measure.
+  void Reset();
+
+ private:
+  void SnapshotWithPath(const std::string& path,
+                        ftl::StringView path_prefix,
+                        std::vector<MetricValue>* values) const;
+
+  mutable std::mutex mutex_;
+  std::map<std::string, std::unique_ptr<Counter>> counters_;
+  std::map<std::string, std::unique_ptr<Gauge>> gauges_;
+  std::map<std::string, std::unique_ptr<Histogram>> histograms_;
+  std::map<std::string, std::unique_ptr<MetricsRegistry>> children_;
+  MemoryBudget* memory_budget_ = nullptr;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(MetricsRegistry);
+};
+
+// Returns |registry| if it is not null, and otherwise a process-wide registry
+// whose metrics are not reported. This allows components to always record
+// their metrics, whether or not they were given a registry.
+MetricsRegistry* OrUnreported(MetricsRegistry* registry);
+
+// Names of the registries of a repository, a ledger and a page. Page ids are
+// hex encoded, other names are escaped to never contain "/".
+std::string RepositoryNodeName(ftl::StringView repository_path);
+std::string LedgerNodeName(ftl::StringView ledger_name);
+std::string PageNodeName(ftl::StringView page_id);
+
+}  // namespace metrics
+
+#endif  // APPS_LEDGER_SRC_METRICS_METRICS_REGISTRY_H_
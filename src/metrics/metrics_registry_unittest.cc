@@ -0,0 +1,126 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/metrics/metrics_registry.h"
+
+#include <limits>
+
+#include "gtest/gtest.h"
+
+namespace metrics {
+namespace {
+
+TEST(MetricsRegistryTest, CountersAndGauges) {
+  MetricsRegistry registry;
+  Counter* counter = registry.GetCounter("counter");
+  EXPECT_EQ(counter, registry.GetCounter("counter"));
+  counter->Increment();
+  counter->Increment(2);
+  EXPECT_EQ(3, counter->value());
+
+  Gauge* gauge = registry.GetGauge("gauge");
+  gauge->Set(5);
+  gauge->Add(-2);
+  EXPECT_EQ(3, gauge->value());
+}
+
+TEST(MetricsRegistryTest, HistogramBuckets) {
+  EXPECT_EQ(0u, Histogram::GetBucketIndex(0));
+  EXPECT_EQ(1u, Histogram::GetBucketIndex(1));
+  EXPECT_EQ(2u, Histogram::GetBucketIndex(2));
+  EXPECT_EQ(2u, Histogram::GetBucketIndex(3));
+  EXPECT_EQ(3u, Histogram::GetBucketIndex(4));
+  EXPECT_EQ(Histogram::kBucketCount - 1,
+            Histogram::GetBucketIndex(std::numeric_limits<int64_t>::max()));
+
+  Histogram histogram;
+  histogram.RecordMicroseconds(3);
+  histogram.Record(ftl::TimeDelta::FromMilliseconds(1));
+  int64_t count;
+  int64_t sum;
+  std::vector<int64_t> buckets;
+  histogram.GetValues(&count, &sum, &buckets);
+  EXPECT_EQ(2, count);
+  EXPECT_EQ(1003, sum);
+  ASSERT_EQ(Histogram::kBucketCount, buckets.size());
+  EXPECT_EQ(1, buckets[2]);
+  EXPECT_EQ(1, buckets[10]);
+}
+
+TEST(MetricsRegistryTest, SnapshotWithPrefix) {
+  MetricsRegistry registry;
+  registry.GetCounter("requests")->Increment();
+  MetricsRegistry* ledger = registry.GetChild("ledger:a");
+  EXPECT_EQ(ledger, registry.GetChild("ledger:a"));
+  MetricsRegistry* page = ledger->GetChild("page:00");
+  page->GetGauge("watchers")->Set(2);
+  page->GetHistogram("latency")->RecordMicroseconds(1);
+  registry.GetChild("ledger:b")->GetCounter("gets")->Increment();
+
+  std::vector<MetricValue> values;
+  registry.Snapshot("", &values);
+  ASSERT_EQ(4u, values.size());
+  EXPECT_EQ("", values[0].path);
+  EXPECT_EQ("requests", values[0].name);
+  EXPECT_EQ("ledger:a/page:00", values[1].path);
+  EXPECT_EQ("watchers", values[1].name);
+  EXPECT_EQ(MetricValue::Type::GAUGE, values[1].type);
+  EXPECT_EQ(2, values[1].value);
+  EXPECT_EQ("latency", values[2].name);
+  EXPECT_EQ(MetricValue::Type::HISTOGRAM, values[2].type);
+  EXPECT_EQ(1, values[2].count);
+  EXPECT_EQ("ledger:b", values[3].path);
+
+  values.clear();
+  registry.Snapshot("ledger:a", &values);
+  ASSERT_EQ(2u, values.size());
+  EXPECT_EQ("ledger:a/page:00", values[0].path);
+  EXPECT_EQ("ledger:a/page:00", values[1].path);
+}
+
+TEST(MetricsRegistryTest, Reset) {
+  MetricsRegistry registry;
+  MetricsRegistry* child = registry.GetChild("child");
+  child->GetCounter("counter")->Increment();
+  child->GetGauge("gauge")->Set(4);
+  child->GetHistogram("histogram")->RecordMicroseconds(10);
+
+  registry.Reset();
+
+  EXPECT_EQ(0, child->GetCounter("counter")->value());
+  EXPECT_EQ(4, child->GetGauge("gauge")->value());
+  int64_t count;
+  int64_t sum;
+  std::vector<int64_t> buckets;
+  child->GetHistogram("histogram")->GetValues(&count, &sum, &buckets);
+  EXPECT_EQ(0, count);
+  EXPECT_EQ(0, sum);
+}
+
+TEST(MetricsRegistryTest, RemoveChild) {
+  MetricsRegistry registry;
+  registry.GetChild("page:00")->GetCounter("counter")->Increment();
+  registry.GetChild("page:01")->GetCounter("counter")->Increment();
+
+  registry.RemoveChild("page:00");
+  registry.RemoveChild("page:02");
+
+  std::vector<MetricValue> values;
+  registry.Snapshot("", &values);
+  ASSERT_EQ(1u, values.size());
+  EXPECT_EQ("page:01", values[0].path);
+
+  // A removed child is created again on access, with new metrics.
+  EXPECT_EQ(0, registry.GetChild("page:00")->GetCounter("counter")->value());
+}
+
+TEST(MetricsRegistryTest, NodeNames) {
+  EXPECT_EQ("page:00ff", PageNodeName(std::string("\0\xff", 2)));
+  EXPECT_EQ("ledger:my_app", LedgerNodeName("my_app"));
+  EXPECT_EQ("repository:%2fdata%2fledger", RepositoryNodeName("/data/ledger"));
+  EXPECT_NE(nullptr, OrUnreported(nullptr));
+}
+
+}  // namespace
+}  // namespace metrics
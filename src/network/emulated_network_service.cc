@@ -0,0 +1,411 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/network/emulated_network_service.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "apps/ledger/src/callback/cancellable_helper.h"
+#include "apps/ledger/src/glue/socket/socket_pair.h"
+#include "apps/ledger/src/glue/socket/socket_writer.h"
+#include "lib/ftl/functional/closure.h"
+#include "lib/ftl/functional/make_copyable.h"
+#include "lib/ftl/time/time_point.h"
+#include "lib/mtl/socket/socket_drainer.h"
+#include "lib/mtl/socket/strings.h"
+
+namespace ledger {
+
+namespace {
+
+// Error code of the requests disconnected by the emulation, as reported by the
+// network service when a connection is closed.
+constexpr int32_t kConnectionClosedErrorCode = -100;
+
+// Returns the host, including the port if any, of the given url.
+std::string GetHost(const std::string& url) {
+  size_t host_start = url.find("://");
+  host_start = host_start == std::string::npos ? 0 : host_start + 3;
+  size_t host_end = url.find_first_of("/?#", host_start);
+  if (host_end == std::string::npos) {
+    host_end = url.size();
+  }
+  return url.substr(host_start, host_end - host_start);
+}
+
+// Returns the size of the body of |request|, if known.
+uint64_t GetBodySize(const network::URLRequest& request) {
+  uint64_t size = 0u;
+  if (request.body && request.body->is_buffer() &&
+      request.body->get_buffer().get_size(&size) != NO_ERROR) {
+    return 0u;
+  }
+  return size;
+}
+
+network::URLResponsePtr NewErrorResponse(int32_t code, std::string reason) {
+  auto response = network::URLResponse::New();
+  response->error = network::NetworkError::New();
+  response->error->code = code;
+  response->error->description = std::move(reason);
+  return response;
+}
+
+network::URLResponsePtr NewServiceUnavailableResponse() {
+  auto response = network::URLResponse::New();
+  response->status_code = 503;
+  response->status_line = "HTTP/1.1 503 Service Unavailable";
+  response->body = network::URLBody::New();
+  response->body->set_stream(mtl::WriteStringToSocket(""));
+  return response;
+}
+
+// State shared by the tasks of a single request.
+struct RequestState {
+  bool cancelled = false;
+  ftl::RefPtr<callback::Cancellable> base_request;
+};
+
+}  // namespace
+
+// Forwards the content of a socket to another one, delivering each chunk read
+// at the time it would be received through the emulated link.
+class EmulatedNetworkService::ThrottledStream
+    : public glue::SocketWriter::Client {
+ public:
+  ThrottledStream(EmulatedNetworkService* service,
+                  const NetworkConditions* conditions,
+                  Link* link)
+      : service_(service),
+        conditions_(conditions),
+        link_(link),
+        reader_(this),
+        writer_(this),
+        weak_factory_(this) {}
+  ~ThrottledStream() override {}
+
+  // Starts forwarding the content of |source|. Returns the socket from which
+  // it can be read.
+  mx::socket Start(mx::socket source) {
+    glue::SocketPair socket;
+    reader_.Start(std::move(source));
+    writer_.Start(std::move(socket.socket1));
+    return std::move(socket.socket2);
+  }
+
+  void set_on_empty(ftl::Closure on_empty_callback) {
+    on_empty_callback_ = std::move(on_empty_callback);
+  }
+
+ private:
+  class Reader : public mtl::SocketDrainer::Client {
+   public:
+    explicit Reader(ThrottledStream* stream)
+        : stream_(stream), drainer_(this) {}
+    ~Reader() override {}
+
+    void Start(mx::socket source) { drainer_.Start(std::move(source)); }
+
+   private:
+    void OnDataAvailable(const void* data, size_t num_bytes) override {
+      stream_->OnChunkRead(
+          std::string(static_cast<const char*>(data), num_bytes));
+    }
+    void OnDataComplete() override { stream_->OnSourceComplete(); }
+
+    ThrottledStream* const stream_;
+    mtl::SocketDrainer drainer_;
+
+    FTL_DISALLOW_COPY_AND_ASSIGN(Reader);
+  };
+
+  void OnChunkRead(std::string chunk) {
+    ftl::TimePoint transferred =
+        EmulatedNetworkService::ReserveLink(*conditions_, link_, chunk.size());
+    ftl::TimeDelta stall;
+    if (service_->Draw(conditions_->stall_rate)) {
+      stall = conditions_->stall_duration;
+    }
+    bool disconnect = service_->Draw(conditions_->disconnect_rate);
+    PostAt(transferred, stall, [chunk, disconnect](ThrottledStream* stream) {
+      if (disconnect) {
+        // The rest of the body is lost.
+        stream->source_done_ = true;
+      } else {
+        stream->buffer_.append(chunk);
+      }
+      stream->SendPendingData();
+    });
+  }
+
+  void OnSourceComplete() {
+    PostAt(ftl::TimePoint::Now(), ftl::TimeDelta(),
+           [](ThrottledStream* stream) {
+             stream->source_done_ = true;
+             stream->SendPendingData();
+           });
+  }
+
+  // Runs |task| at |time|, but not before the data previously read is
+  // delivered, and |delay| after that.
+  void PostAt(ftl::TimePoint time,
+              ftl::TimeDelta delay,
+              std::function<void(ThrottledStream*)> task) {
+    ftl::TimePoint now = ftl::TimePoint::Now();
+    next_delivery_ = std::max(time, next_delivery_) + delay;
+    service_->task_runner_->PostDelayedTask(
+        [ weak_this = weak_factory_.GetWeakPtr(), task = std::move(task) ] {
+          if (weak_this && !weak_this->source_done_) {
+            task(weak_this.get());
+          }
+        },
+        next_delivery_ - now);
+  }
+
+  void SendPendingData() {
+    if (!pending_callback_ || (buffer_.empty() && !source_done_)) {
+      return;
+    }
+    auto callback = std::move(pending_callback_);
+    pending_callback_ = nullptr;
+    // An empty view completes the stream, which may delete this object.
+    callback(ftl::StringView(buffer_).substr(0, max_size_));
+  }
+
+  // glue::SocketWriter::Client:
+  void GetNext(size_t offset,
+               size_t max_size,
+               std::function<void(ftl::StringView)> callback) override {
+    // The data before |offset| is written to the socket.
+    FTL_DCHECK(offset >= buffer_offset_);
+    buffer_.erase(0, offset - buffer_offset_);
+    buffer_offset_ = offset;
+    max_size_ = max_size;
+    pending_callback_ = std::move(callback);
+    SendPendingData();
+  }
+
+  void OnDataComplete() override {
+    if (on_empty_callback_) {
+      on_empty_callback_();
+    }
+  }
+
+  EmulatedNetworkService* const service_;
+  const NetworkConditions* const conditions_;
+  Link* const link_;
+  // Time at which the last chunk read is delivered.
+  ftl::TimePoint next_delivery_;
+  // Data delivered but not yet written to the socket, starting at
+  // |buffer_offset_|.
+  std::string buffer_;
+  size_t buffer_offset_ = 0u;
+  size_t max_size_ = 0u;
+  // True once the end of the body is delivered, or the stream disconnected.
+  bool source_done_ = false;
+  // Callback of the writer waiting for new data, if any.
+  std::function<void(ftl::StringView)> pending_callback_;
+  Reader reader_;
+  glue::SocketWriter writer_;
+  ftl::Closure on_empty_callback_;
+
+  // Must be the last member field.
+  ftl::WeakPtrFactory<ThrottledStream> weak_factory_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ThrottledStream);
+};
+
+EmulatedNetworkService::EmulatedNetworkService(
+    ftl::RefPtr<ftl::TaskRunner> task_runner,
+    NetworkService* base_network_service,
+    NetworkEmulationConfig config)
+    : task_runner_(std::move(task_runner)),
+      base_network_service_(base_network_service),
+      config_(std::move(config)),
+      rng_(config_.seed),
+      weak_factory_(this) {
+  FTL_DCHECK(base_network_service_);
+}
+
+EmulatedNetworkService::~EmulatedNetworkService() {}
+
+ftl::RefPtr<callback::Cancellable> EmulatedNetworkService::Request(
+    std::function<network::URLRequestPtr()> request_factory,
+    std::function<void(network::URLResponsePtr)> callback,
+    RequestPriority priority) {
+  network::URLRequestPtr request = request_factory();
+  std::string host = GetHost(request->url);
+  const NetworkConditions& conditions = GetConditions(host);
+  if (!conditions.IsEmulated()) {
+    return base_network_service_->Request(std::move(request_factory),
+                                          std::move(callback), priority);
+  }
+
+  auto state = std::make_shared<RequestState>();
+  auto cancellable = callback::CancellableImpl::Create([state] {
+    state->cancelled = true;
+    if (state->base_request) {
+      state->base_request->Cancel();
+    }
+  });
+  auto wrapped_callback = cancellable->WrapCallback(callback);
+
+  // Streamed request bodies are sent through the uplink as the base network
+  // service reads them.
+  HostLinks* links = &links_[host];
+  ftl::TimePoint now = ftl::TimePoint::Now();
+  ftl::TimeDelta send_delay =
+      GetLatency(conditions) +
+      (ReserveLink(conditions, &links->uplink, GetBodySize(*request)) - now);
+
+  if (Draw(conditions.disconnect_rate)) {
+    task_runner_->PostDelayedTask(
+        [ state, callback = std::move(wrapped_callback) ] {
+          if (!state->cancelled) {
+            callback(NewErrorResponse(kConnectionClosedErrorCode,
+                                      "Connection closed by the emulation."));
+          }
+        },
+        send_delay);
+    return cancellable;
+  }
+
+  if (Draw(conditions.error_rate)) {
+    task_runner_->PostDelayedTask(
+        [ state, callback = std::move(wrapped_callback) ] {
+          if (!state->cancelled) {
+            callback(NewServiceUnavailableResponse());
+          }
+        },
+        send_delay + GetLatency(conditions));
+    return cancellable;
+  }
+
+  task_runner_->PostDelayedTask(
+      [
+        weak_this = weak_factory_.GetWeakPtr(), state, &conditions, links,
+        request_factory = std::move(request_factory),
+        callback = std::move(wrapped_callback), priority
+      ] {
+        if (!weak_this || state->cancelled) {
+          return;
+        }
+        state->base_request = weak_this->base_network_service_->Request(
+            [weak_this, &conditions, links, request_factory] {
+              network::URLRequestPtr request = request_factory();
+              if (!weak_this) {
+                return request;
+              }
+              return weak_this->ThrottleRequest(conditions, &links->uplink,
+                                                std::move(request));
+            },
+            [weak_this, state, &conditions, links,
+             callback](network::URLResponsePtr response) {
+              if (!weak_this || state->cancelled) {
+                return;
+              }
+              weak_this->task_runner_->PostDelayedTask(
+                  ftl::MakeCopyable([
+                    state, callback,
+                    response = weak_this->ThrottleResponse(
+                        conditions, &links->downlink, std::move(response))
+                  ]() mutable {
+                    if (!state->cancelled) {
+                      callback(std::move(response));
+                    }
+                  }),
+                  weak_this->GetLatency(conditions));
+            },
+            priority);
+      },
+      send_delay);
+  return cancellable;
+}
+
+const NetworkConditions& EmulatedNetworkService::GetConditions(
+    const std::string& host) const {
+  auto it = config_.host_conditions.find(host);
+  if (it == config_.host_conditions.end()) {
+    return config_.default_conditions;
+  }
+  return it->second;
+}
+
+bool EmulatedNetworkService::Draw(double probability) {
+  if (probability <= 0.0) {
+    return false;
+  }
+  return std::bernoulli_distribution(probability)(rng_);
+}
+
+ftl::TimeDelta EmulatedNetworkService::GetLatency(
+    const NetworkConditions& conditions) {
+  ftl::TimeDelta latency = conditions.latency;
+  if (conditions.jitter > ftl::TimeDelta()) {
+    latency = latency + ftl::TimeDelta::FromMicroseconds(
+                            std::uniform_int_distribution<int64_t>(
+                                0, conditions.jitter.ToMicroseconds())(rng_));
+  }
+  return latency;
+}
+
+// static
+ftl::TimeDelta EmulatedNetworkService::GetTransferTime(
+    const NetworkConditions& conditions,
+    uint64_t size) {
+  if (conditions.bandwidth == 0u) {
+    return ftl::TimeDelta();
+  }
+  return ftl::TimeDelta::FromMicroseconds(size * 1000000u /
+                                          conditions.bandwidth);
+}
+
+// static
+ftl::TimePoint EmulatedNetworkService::ReserveLink(
+    const NetworkConditions& conditions,
+    Link* link,
+    uint64_t size) {
+  link->available = std::max(ftl::TimePoint::Now(), link->available) +
+                    GetTransferTime(conditions, size);
+  return link->available;
+}
+
+network::URLRequestPtr EmulatedNetworkService::ThrottleRequest(
+    const NetworkConditions& conditions,
+    Link* uplink,
+    network::URLRequestPtr request) {
+  if (!request->body || !request->body->is_stream()) {
+    return request;
+  }
+  request->body->set_stream(ThrottleStream(
+      conditions, uplink, std::move(request->body->get_stream())));
+  return request;
+}
+
+network::URLResponsePtr EmulatedNetworkService::ThrottleResponse(
+    const NetworkConditions& conditions,
+    Link* downlink,
+    network::URLResponsePtr response) {
+  if (response->error || !response->body || !response->body->is_stream()) {
+    return response;
+  }
+  response->body->set_stream(ThrottleStream(
+      conditions, downlink, std::move(response->body->get_stream())));
+  return response;
+}
+
+mx::socket EmulatedNetworkService::ThrottleStream(
+    const NetworkConditions& conditions,
+    Link* link,
+    mx::socket source) {
+  if (conditions.bandwidth == 0u && conditions.stall_rate <= 0.0 &&
+      conditions.disconnect_rate <= 0.0) {
+    return source;
+  }
+  ThrottledStream& stream = streams_.emplace(this, &conditions, link);
+  return stream.Start(std::move(source));
+}
+
+}  // namespace ledger
@@ -0,0 +1,109 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_NETWORK_EMULATED_NETWORK_SERVICE_H_
+#define APPS_LEDGER_SRC_NETWORK_EMULATED_NETWORK_SERVICE_H_
+
+#include <map>
+#include <random>
+#include <string>
+
+#include "apps/ledger/src/callback/auto_cleanable.h"
+#include "apps/ledger/src/network/network_conditions.h"
+#include "apps/ledger/src/network/network_service.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/weak_ptr.h"
+#include "lib/ftl/tasks/task_runner.h"
+#include "lib/ftl/time/time_delta.h"
+#include "lib/ftl/time/time_point.h"
+#include "mx/socket.h"
+
+namespace ledger {
+
+// Implementation of NetworkService emulating degraded network conditions on
+// top of another NetworkService. Requests are delayed according to the latency
+// and bandwidth of their host, may fail or be disconnected, and the streamed
+// bodies of the requests and of the responses are forwarded according to the
+// bandwidth, with random stalls and disconnections. The bandwidth of each host
+// is shared by all the requests to it: each direction is a single link on
+// which the bodies are transferred one chunk after the other.
+//
+// All random decisions are taken from a generator initialized with the seed
+// of the configuration, so that a sequence of requests is subject to the same
+// conditions across runs.
+class EmulatedNetworkService : public NetworkService {
+ public:
+  EmulatedNetworkService(ftl::RefPtr<ftl::TaskRunner> task_runner,
+                         NetworkService* base_network_service,
+                         NetworkEmulationConfig config);
+  ~EmulatedNetworkService() override;
+
+  ftl::RefPtr<callback::Cancellable> Request(
+      std::function<network::URLRequestPtr()> request_factory,
+      std::function<void(network::URLResponsePtr)> callback,
+      RequestPriority priority) override;
+
+ private:
+  class ThrottledStream;
+
+  // One direction of the connection to a host.
+  struct Link {
+    // Time at which the data already sent is transferred.
+    ftl::TimePoint available;
+  };
+  struct HostLinks {
+    Link uplink;
+    Link downlink;
+  };
+
+  const NetworkConditions& GetConditions(const std::string& host) const;
+
+  // Returns true with the given probability.
+  bool Draw(double probability);
+
+  // Returns the latency of a single transmission, including jitter.
+  ftl::TimeDelta GetLatency(const NetworkConditions& conditions);
+
+  // Returns the time needed to transfer |size| bytes.
+  static ftl::TimeDelta GetTransferTime(const NetworkConditions& conditions,
+                                        uint64_t size);
+
+  // Reserves |link| for the transfer of |size| bytes after the data already
+  // sent, and returns the time at which the transfer is complete.
+  static ftl::TimePoint ReserveLink(const NetworkConditions& conditions,
+                                    Link* link,
+                                    uint64_t size);
+
+  // Returns |request| with its streamed body, if any, sent through |uplink|.
+  network::URLRequestPtr ThrottleRequest(const NetworkConditions& conditions,
+                                         Link* uplink,
+                                         network::URLRequestPtr request);
+
+  // Returns |response| with its body received through |downlink|.
+  network::URLResponsePtr ThrottleResponse(const NetworkConditions& conditions,
+                                           Link* downlink,
+                                           network::URLResponsePtr response);
+
+  // Returns the socket from which the content of |source| can be read as it
+  // is transferred through |link|.
+  mx::socket ThrottleStream(const NetworkConditions& conditions,
+                            Link* link,
+                            mx::socket source);
+
+  ftl::RefPtr<ftl::TaskRunner> task_runner_;
+  NetworkService* const base_network_service_;
+  const NetworkEmulationConfig config_;
+  std::mt19937 rng_;
+  std::map<std::string, HostLinks> links_;
+  callback::AutoCleanableSet<ThrottledStream> streams_;
+
+  // Must be the last member field.
+  ftl::WeakPtrFactory<EmulatedNetworkService> weak_factory_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(EmulatedNetworkService);
+};
+
+}  // namespace ledger
+
+#endif  // APPS_LEDGER_SRC_NETWORK_EMULATED_NETWORK_SERVICE_H_
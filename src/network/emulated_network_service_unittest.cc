@@ -0,0 +1,326 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/network/emulated_network_service.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "apps/ledger/src/callback/cancellable_helper.h"
+#include "apps/ledger/src/glue/socket/socket_drainer_client.h"
+#include "apps/ledger/src/test/test_with_message_loop.h"
+#include "gtest/gtest.h"
+#include "lib/ftl/arraysize.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/time/time_delta.h"
+#include "lib/ftl/time/time_point.h"
+#include "lib/mtl/socket/strings.h"
+
+namespace ledger {
+namespace {
+
+const char kUrl[] = "https://example.com/path";
+
+// NetworkService answering all requests with a 200 response whose body is
+// |response_body|. Streamed request bodies are read before answering.
+class TestNetworkService : public NetworkService {
+ public:
+  explicit TestNetworkService(ftl::RefPtr<ftl::TaskRunner> task_runner)
+      : task_runner_(std::move(task_runner)) {}
+  ~TestNetworkService() override {}
+
+  ftl::RefPtr<callback::Cancellable> Request(
+      std::function<network::URLRequestPtr()> request_factory,
+      std::function<void(network::URLResponsePtr)> callback,
+      RequestPriority priority) override {
+    network::URLRequestPtr request = request_factory();
+    request_count++;
+    auto cancellable = callback::CancellableImpl::Create([] {});
+    auto respond = [ this, callback = cancellable->WrapCallback(callback) ] {
+      network::URLResponsePtr response = network::URLResponse::New();
+      response->status_code = 200;
+      response->body = network::URLBody::New();
+      response->body->set_stream(mtl::WriteStringToSocket(response_body));
+      callback(std::move(response));
+    };
+    if (request->body && request->body->is_stream()) {
+      request_body_drainers_.push_back(
+          std::make_unique<glue::SocketDrainerClient>());
+      request_body_drainers_.back()->Start(
+          std::move(request->body->get_stream()),
+          [this, respond](std::string body) {
+            request_body = std::move(body);
+            respond();
+          });
+    } else {
+      task_runner_->PostTask(respond);
+    }
+    return cancellable;
+  }
+
+  int request_count = 0;
+  std::string request_body;
+  std::string response_body = "body";
+
+ private:
+  ftl::RefPtr<ftl::TaskRunner> task_runner_;
+  std::vector<std::unique_ptr<glue::SocketDrainerClient>>
+      request_body_drainers_;
+};
+
+class EmulatedNetworkServiceTest : public test::TestWithMessageLoop {
+ public:
+  EmulatedNetworkServiceTest() : base_(message_loop_.task_runner()) {}
+  ~EmulatedNetworkServiceTest() override {}
+
+ protected:
+  std::unique_ptr<EmulatedNetworkService> CreateService(
+      NetworkConditions conditions,
+      uint64_t seed = 0u) {
+    NetworkEmulationConfig config;
+    config.default_conditions = conditions;
+    config.seed = seed;
+    return std::make_unique<EmulatedNetworkService>(
+        message_loop_.task_runner(), &base_, std::move(config));
+  }
+
+  ftl::RefPtr<callback::Cancellable> MakeRequest(
+      NetworkService* network_service,
+      network::URLResponsePtr* response) {
+    return network_service->Request(
+        [] {
+          network::URLRequestPtr request = network::URLRequest::New();
+          request->url = kUrl;
+          return request;
+        },
+        [this, response](network::URLResponsePtr received_response) {
+          *response = std::move(received_response);
+          message_loop_.PostQuitTask();
+        },
+        RequestPriority::SYNC);
+  }
+
+  std::string ReadBody(network::URLResponsePtr response) {
+    std::string result;
+    glue::SocketDrainerClient drainer;
+    drainer.Start(std::move(response->body->get_stream()),
+                  [this, &result](std::string body) {
+                    result = std::move(body);
+                    message_loop_.PostQuitTask();
+                  });
+    EXPECT_FALSE(RunLoopWithTimeout());
+    return result;
+  }
+
+  TestNetworkService base_;
+
+ private:
+  FTL_DISALLOW_COPY_AND_ASSIGN(EmulatedNetworkServiceTest);
+};
+
+TEST_F(EmulatedNetworkServiceTest, NoEmulation) {
+  auto network_service = CreateService(NetworkConditions());
+  network::URLResponsePtr response;
+  MakeRequest(network_service.get(), &response);
+  EXPECT_FALSE(RunLoopWithTimeout());
+  ASSERT_TRUE(response);
+  EXPECT_EQ(200u, response->status_code);
+  EXPECT_EQ(1, base_.request_count);
+  EXPECT_EQ("body", ReadBody(std::move(response)));
+}
+
+TEST_F(EmulatedNetworkServiceTest, Latency) {
+  NetworkConditions conditions;
+  conditions.latency = ftl::TimeDelta::FromMilliseconds(50);
+  auto network_service = CreateService(conditions);
+
+  network::URLResponsePtr response;
+  MakeRequest(network_service.get(), &response);
+  EXPECT_TRUE(RunLoopWithTimeout(ftl::TimeDelta::FromMilliseconds(20)));
+  EXPECT_FALSE(response);
+  EXPECT_EQ(0, base_.request_count);
+
+  EXPECT_FALSE(RunLoopWithTimeout());
+  ASSERT_TRUE(response);
+  EXPECT_EQ(200u, response->status_code);
+  EXPECT_EQ(1, base_.request_count);
+}
+
+TEST_F(EmulatedNetworkServiceTest, Bandwidth) {
+  NetworkConditions conditions;
+  conditions.bandwidth = 1000000u;
+  auto network_service = CreateService(conditions);
+  base_.response_body = std::string(10000, 'a');
+
+  network::URLResponsePtr response;
+  MakeRequest(network_service.get(), &response);
+  EXPECT_FALSE(RunLoopWithTimeout());
+  ASSERT_TRUE(response);
+  EXPECT_EQ(base_.response_body, ReadBody(std::move(response)));
+}
+
+// Verifies that concurrent requests to the same host share its bandwidth.
+TEST_F(EmulatedNetworkServiceTest, SharedBandwidth) {
+  NetworkConditions conditions;
+  conditions.bandwidth = 1000000u;
+  auto network_service = CreateService(conditions);
+  base_.response_body = std::string(50000, 'a');
+
+  ftl::TimePoint start = ftl::TimePoint::Now();
+  network::URLResponsePtr responses[2];
+  for (auto& response : responses) {
+    MakeRequest(network_service.get(), &response);
+  }
+  for (size_t i = 0; i < arraysize(responses); ++i) {
+    EXPECT_FALSE(RunLoopWithTimeout());
+  }
+  for (auto& response : responses) {
+    ASSERT_TRUE(response);
+    EXPECT_EQ(base_.response_body, ReadBody(std::move(response)));
+  }
+  // Each body alone takes 50ms to transfer.
+  EXPECT_LE(ftl::TimeDelta::FromMilliseconds(100),
+            ftl::TimePoint::Now() - start);
+}
+
+// Verifies that streamed request bodies are sent according to the bandwidth.
+TEST_F(EmulatedNetworkServiceTest, StreamedRequestBody) {
+  NetworkConditions conditions;
+  conditions.bandwidth = 1000000u;
+  auto network_service = CreateService(conditions);
+  std::string body(50000, 'b');
+
+  ftl::TimePoint start = ftl::TimePoint::Now();
+  network::URLResponsePtr response;
+  network_service->Request(
+      [&body] {
+        network::URLRequestPtr request = network::URLRequest::New();
+        request->url = kUrl;
+        request->body = network::URLBody::New();
+        request->body->set_stream(mtl::WriteStringToSocket(body));
+        return request;
+      },
+      [this, &response](network::URLResponsePtr received_response) {
+        response = std::move(received_response);
+        message_loop_.PostQuitTask();
+      },
+      RequestPriority::SYNC);
+  EXPECT_FALSE(RunLoopWithTimeout());
+  ASSERT_TRUE(response);
+  EXPECT_EQ(body, base_.request_body);
+  EXPECT_LE(ftl::TimeDelta::FromMilliseconds(50),
+            ftl::TimePoint::Now() - start);
+}
+
+TEST_F(EmulatedNetworkServiceTest, Error) {
+  NetworkConditions conditions;
+  conditions.error_rate = 1.0;
+  auto network_service = CreateService(conditions);
+
+  network::URLResponsePtr response;
+  MakeRequest(network_service.get(), &response);
+  EXPECT_FALSE(RunLoopWithTimeout());
+  ASSERT_TRUE(response);
+  EXPECT_EQ(503u, response->status_code);
+  EXPECT_EQ(0, base_.request_count);
+}
+
+TEST_F(EmulatedNetworkServiceTest, Disconnect) {
+  NetworkConditions conditions;
+  conditions.disconnect_rate = 1.0;
+  auto network_service = CreateService(conditions);
+
+  network::URLResponsePtr response;
+  MakeRequest(network_service.get(), &response);
+  EXPECT_FALSE(RunLoopWithTimeout());
+  ASSERT_TRUE(response);
+  EXPECT_TRUE(response->error);
+  EXPECT_EQ(0, base_.request_count);
+}
+
+TEST_F(EmulatedNetworkServiceTest, Cancel) {
+  NetworkConditions conditions;
+  conditions.latency = ftl::TimeDelta::FromMilliseconds(5);
+  auto network_service = CreateService(conditions);
+
+  network::URLResponsePtr response;
+  MakeRequest(network_service.get(), &response)->Cancel();
+  EXPECT_TRUE(RunLoopWithTimeout(ftl::TimeDelta::FromMilliseconds(20)));
+  EXPECT_FALSE(response);
+  EXPECT_EQ(0, base_.request_count);
+}
+
+// Verifies that the same seed leads to the same outcomes.
+TEST_F(EmulatedNetworkServiceTest, Deterministic) {
+  NetworkConditions conditions;
+  conditions.error_rate = 0.5;
+
+  std::vector<std::vector<uint32_t>> status_codes(2);
+  for (auto& run_status_codes : status_codes) {
+    auto network_service = CreateService(conditions, 42u);
+    for (size_t i = 0; i < 20; ++i) {
+      network::URLResponsePtr response;
+      MakeRequest(network_service.get(), &response);
+      EXPECT_FALSE(RunLoopWithTimeout());
+      ASSERT_TRUE(response);
+      run_status_codes.push_back(response->status_code);
+    }
+  }
+  EXPECT_EQ(status_codes[0], status_codes[1]);
+}
+
+TEST_F(EmulatedNetworkServiceTest, HostConditions) {
+  NetworkEmulationConfig config;
+  config.host_conditions["other.com"].error_rate = 1.0;
+  EmulatedNetworkService network_service(message_loop_.task_runner(), &base_,
+                                         std::move(config));
+
+  network::URLResponsePtr response;
+  MakeRequest(&network_service, &response);
+  EXPECT_FALSE(RunLoopWithTimeout());
+  ASSERT_TRUE(response);
+  EXPECT_EQ(200u, response->status_code);
+}
+
+TEST(NetworkConditionsTest, Profiles) {
+  NetworkConditions conditions;
+  EXPECT_TRUE(GetNetworkProfile("3g", &conditions));
+  EXPECT_TRUE(conditions.IsEmulated());
+  EXPECT_TRUE(GetNetworkProfile("none", &conditions));
+  EXPECT_FALSE(conditions.IsEmulated());
+  EXPECT_FALSE(GetNetworkProfile("carrier_pigeon", &conditions));
+}
+
+TEST(NetworkConditionsTest, FromCommandLine) {
+  const char* argv[] = {"ledger", "--network_profile=satellite",
+                        "--network_latency_ms=42",
+                        "--network_error_rate=0.25",
+                        "--network_host_profiles=a.com:2g,b.com:none",
+                        "--network_seed=7"};
+  ftl::CommandLine command_line =
+      ftl::CommandLineFromArgcArgv(arraysize(argv), argv);
+  NetworkEmulationConfig config;
+  EXPECT_TRUE(NetworkEmulationConfigFromCommandLine(command_line, &config));
+
+  NetworkConditions satellite;
+  EXPECT_TRUE(GetNetworkProfile("satellite", &satellite));
+  EXPECT_EQ(ftl::TimeDelta::FromMilliseconds(42),
+            config.default_conditions.latency);
+  EXPECT_EQ(0.25, config.default_conditions.error_rate);
+  EXPECT_EQ(satellite.bandwidth, config.default_conditions.bandwidth);
+  EXPECT_EQ(2u, config.host_conditions.size());
+  EXPECT_TRUE(config.host_conditions["a.com"].IsEmulated());
+  EXPECT_FALSE(config.host_conditions["b.com"].IsEmulated());
+  EXPECT_EQ(7u, config.seed);
+
+  const char* invalid_argv[] = {"ledger", "--network_error_rate=2"};
+  EXPECT_FALSE(NetworkEmulationConfigFromCommandLine(
+      ftl::CommandLineFromArgcArgv(arraysize(invalid_argv), invalid_argv),
+      &config));
+}
+
+}  // namespace
+}  // namespace ledger
@@ -18,6 +18,10 @@ network::URLRequest* FakeNetworkService::GetRequest() {
   return request_received_.get();
 }
 
+RequestPriority FakeNetworkService::GetRequestPriority() {
+  return request_priority_;
+}
+
 void FakeNetworkService::SetResponse(network::URLResponsePtr response) {
   response_to_return_ = std::move(response);
 }
@@ -38,7 +42,9 @@ void FakeNetworkService::SetStringResponse(const std::string& body,
 
 ftl::RefPtr<callback::Cancellable> FakeNetworkService::Request(
     std::function<network::URLRequestPtr()> request_factory,
-    std::function<void(network::URLResponsePtr)> callback) {
+    std::function<void(network::URLResponsePtr)> callback,
+    RequestPriority priority) {
+  request_priority_ = priority;
   std::unique_ptr<bool> cancelled = std::make_unique<bool>(false);
 
   bool* cancelled_ptr = cancelled.get();
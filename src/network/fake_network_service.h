@@ -19,6 +19,9 @@ class FakeNetworkService : public NetworkService {
 
   network::URLRequest* GetRequest();
 
+  // Returns the priority of the last request.
+  RequestPriority GetRequestPriority();
+
   void SetResponse(network::URLResponsePtr response);
 
   void SetSocketResponse(mx::socket body, uint32_t status_code);
@@ -29,9 +32,11 @@ class FakeNetworkService : public NetworkService {
   // NetworkService
   ftl::RefPtr<callback::Cancellable> Request(
       std::function<network::URLRequestPtr()> request_factory,
-      std::function<void(network::URLResponsePtr)> callback) override;
+      std::function<void(network::URLResponsePtr)> callback,
+      RequestPriority priority) override;
 
   network::URLRequestPtr request_received_;
+  RequestPriority request_priority_ = RequestPriority::SYNC;
   network::URLResponsePtr response_to_return_;
   ftl::RefPtr<ftl::TaskRunner> task_runner_;
 
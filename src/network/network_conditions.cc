@@ -0,0 +1,200 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/network/network_conditions.h"
+
+#include <stdlib.h>
+
+#include <algorithm>
+
+#include "lib/ftl/logging.h"
+#include "lib/ftl/strings/string_number_conversions.h"
+
+namespace ledger {
+
+namespace {
+
+constexpr ftl::StringView kProfileFlag = "network_profile";
+constexpr ftl::StringView kLatencyFlag = "network_latency_ms";
+constexpr ftl::StringView kJitterFlag = "network_jitter_ms";
+constexpr ftl::StringView kBandwidthFlag = "network_bandwidth_kbps";
+constexpr ftl::StringView kErrorRateFlag = "network_error_rate";
+constexpr ftl::StringView kDisconnectRateFlag = "network_disconnect_rate";
+constexpr ftl::StringView kStallRateFlag = "network_stall_rate";
+constexpr ftl::StringView kStallDurationFlag = "network_stall_ms";
+constexpr ftl::StringView kHostProfilesFlag = "network_host_profiles";
+constexpr ftl::StringView kSeedFlag = "network_seed";
+
+struct NetworkProfile {
+  const char* name;
+  int64_t latency_ms;
+  int64_t jitter_ms;
+  uint64_t bandwidth_kbps;
+  double error_rate;
+  double disconnect_rate;
+  double stall_rate;
+  int64_t stall_ms;
+};
+
+// Rough approximations of common networks. Latencies are one-way.
+constexpr NetworkProfile kProfiles[] = {
+    {"none", 0, 0, 0, 0.0, 0.0, 0.0, 0},
+    {"wifi", 10, 5, 25000, 0.0, 0.0, 0.0, 0},
+    {"3g", 100, 50, 750, 0.01, 0.01, 0.02, 1000},
+    {"2g", 300, 100, 50, 0.02, 0.03, 0.05, 3000},
+    {"satellite", 300, 20, 1000, 0.005, 0.005, 0.01, 2000},
+};
+
+uint64_t KbpsToBytesPerSecond(uint64_t kbps) {
+  return kbps * 1000 / 8;
+}
+
+bool ParseMilliseconds(const std::string& value, ftl::TimeDelta* result) {
+  int64_t milliseconds;
+  if (!ftl::StringToNumberWithError(value, &milliseconds) ||
+      milliseconds < 0) {
+    return false;
+  }
+  *result = ftl::TimeDelta::FromMilliseconds(milliseconds);
+  return true;
+}
+
+bool ParseRate(const std::string& value, double* result) {
+  if (value.empty()) {
+    return false;
+  }
+  char* end;
+  double rate = strtod(value.c_str(), &end);
+  if (*end != '\0' || rate < 0.0 || rate > 1.0) {
+    return false;
+  }
+  *result = rate;
+  return true;
+}
+
+// Applies the value of |flag| in |command_line|, if present, using |parse|.
+// Returns false if the value is invalid.
+template <typename T, typename P>
+bool ApplyFlag(const ftl::CommandLine& command_line,
+               ftl::StringView flag,
+               P parse,
+               T* result) {
+  std::string value;
+  if (!command_line.GetOptionValue(flag.ToString(), &value)) {
+    return true;
+  }
+  if (!parse(value, result)) {
+    FTL_LOG(ERROR) << "Invalid value for --" << flag << ": " << value;
+    return false;
+  }
+  return true;
+}
+
+bool ParseHostProfiles(const std::string& value,
+                       std::map<std::string, NetworkConditions>* result) {
+  ftl::StringView remaining = value;
+  while (!remaining.empty()) {
+    size_t end = remaining.find(',');
+    if (end == ftl::StringView::npos) {
+      end = remaining.size();
+    }
+    ftl::StringView host_profile = remaining.substr(0, end);
+    remaining = remaining.substr(std::min(end + 1, remaining.size()));
+
+    size_t separator = host_profile.rfind(':');
+    if (separator == ftl::StringView::npos || separator == 0u) {
+      return false;
+    }
+    NetworkConditions conditions;
+    if (!GetNetworkProfile(host_profile.substr(separator + 1), &conditions)) {
+      return false;
+    }
+    (*result)[host_profile.substr(0, separator).ToString()] = conditions;
+  }
+  return true;
+}
+
+}  // namespace
+
+bool NetworkConditions::IsEmulated() const {
+  return latency > ftl::TimeDelta() || jitter > ftl::TimeDelta() ||
+         bandwidth > 0u || error_rate > 0.0 || disconnect_rate > 0.0 ||
+         (stall_rate > 0.0 && stall_duration > ftl::TimeDelta());
+}
+
+NetworkEmulationConfig::NetworkEmulationConfig() {}
+
+NetworkEmulationConfig::~NetworkEmulationConfig() {}
+
+bool NetworkEmulationConfig::IsEmulated() const {
+  if (default_conditions.IsEmulated()) {
+    return true;
+  }
+  for (const auto& host : host_conditions) {
+    if (host.second.IsEmulated()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool GetNetworkProfile(ftl::StringView name, NetworkConditions* conditions) {
+  for (const auto& profile : kProfiles) {
+    if (name != profile.name) {
+      continue;
+    }
+    conditions->latency = ftl::TimeDelta::FromMilliseconds(profile.latency_ms);
+    conditions->jitter = ftl::TimeDelta::FromMilliseconds(profile.jitter_ms);
+    conditions->bandwidth = KbpsToBytesPerSecond(profile.bandwidth_kbps);
+    conditions->error_rate = profile.error_rate;
+    conditions->disconnect_rate = profile.disconnect_rate;
+    conditions->stall_rate = profile.stall_rate;
+    conditions->stall_duration =
+        ftl::TimeDelta::FromMilliseconds(profile.stall_ms);
+    return true;
+  }
+  return false;
+}
+
+bool NetworkEmulationConfigFromCommandLine(const ftl::CommandLine& command_line,
+                                           NetworkEmulationConfig* config) {
+  NetworkConditions* conditions = &config->default_conditions;
+  auto parse_bandwidth = [](const std::string& value, uint64_t* result) {
+    uint64_t kbps;
+    if (!ftl::StringToNumberWithError(value, &kbps)) {
+      return false;
+    }
+    *result = KbpsToBytesPerSecond(kbps);
+    return true;
+  };
+  auto parse_seed = [](const std::string& value, uint64_t* result) {
+    return ftl::StringToNumberWithError(value, result);
+  };
+  auto parse_profile = [](const std::string& value,
+                          NetworkConditions* result) {
+    return GetNetworkProfile(value, result);
+  };
+
+  // The profile is applied first, so that the other flags override it.
+  return ApplyFlag(command_line, kProfileFlag, parse_profile, conditions) &&
+         ApplyFlag(command_line, kLatencyFlag, ParseMilliseconds,
+                   &conditions->latency) &&
+         ApplyFlag(command_line, kJitterFlag, ParseMilliseconds,
+                   &conditions->jitter) &&
+         ApplyFlag(command_line, kBandwidthFlag, parse_bandwidth,
+                   &conditions->bandwidth) &&
+         ApplyFlag(command_line, kErrorRateFlag, ParseRate,
+                   &conditions->error_rate) &&
+         ApplyFlag(command_line, kDisconnectRateFlag, ParseRate,
+                   &conditions->disconnect_rate) &&
+         ApplyFlag(command_line, kStallRateFlag, ParseRate,
+                   &conditions->stall_rate) &&
+         ApplyFlag(command_line, kStallDurationFlag, ParseMilliseconds,
+                   &conditions->stall_duration) &&
+         ApplyFlag(command_line, kHostProfilesFlag, ParseHostProfiles,
+                   &config->host_conditions) &&
+         ApplyFlag(command_line, kSeedFlag, parse_seed, &config->seed);
+}
+
+}  // namespace ledger
@@ -0,0 +1,81 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_NETWORK_NETWORK_CONDITIONS_H_
+#define APPS_LEDGER_SRC_NETWORK_NETWORK_CONDITIONS_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+
+#include "lib/ftl/command_line.h"
+#include "lib/ftl/strings/string_view.h"
+#include "lib/ftl/time/time_delta.h"
+
+namespace ledger {
+
+// Conditions of the network emulated by EmulatedNetworkService for the
+// requests to a host.
+struct NetworkConditions {
+  // Delay added to each request before it is sent, and to each response before
+  // it is received.
+  ftl::TimeDelta latency;
+  // Maximum random delay added to |latency|, uniformly distributed.
+  ftl::TimeDelta jitter;
+  // Maximum throughput of request and response bodies, in bytes per second. 0
+  // means unlimited.
+  uint64_t bandwidth = 0u;
+  // Probability that a request fails with a server error (HTTP 503) without
+  // reaching the server.
+  double error_rate = 0.0;
+  // Probability that the connection drops, evaluated for each request, failing
+  // it with a network error, and for each chunk of a response body,
+  // truncating it.
+  double disconnect_rate = 0.0;
+  // Probability that the delivery of a chunk of a response body stalls for
+  // |stall_duration|.
+  double stall_rate = 0.0;
+  ftl::TimeDelta stall_duration;
+
+  // Returns true if these conditions differ from a perfect network.
+  bool IsEmulated() const;
+};
+
+// Configuration of the emulated network.
+struct NetworkEmulationConfig {
+  NetworkEmulationConfig();
+  ~NetworkEmulationConfig();
+
+  // Conditions applying to the hosts not in |host_conditions|.
+  NetworkConditions default_conditions;
+  // Conditions specific to some hosts, indexed by host name.
+  std::map<std::string, NetworkConditions> host_conditions;
+  // Seed of the random decisions, so that runs can be reproduced.
+  uint64_t seed = 0u;
+
+  // Returns true if any host is subject to emulated conditions.
+  bool IsEmulated() const;
+};
+
+// Sets |conditions| to the predefined profile |name|, and returns true, if it
+// exists. Profiles are "none", "wifi", "3g", "2g" and "satellite".
+bool GetNetworkProfile(ftl::StringView name, NetworkConditions* conditions);
+
+// Parses the network emulation flags of |command_line| into |config|. Returns
+// false if a flag is invalid. The flags are:
+//   --network_profile=<name>: predefined conditions applying to all hosts,
+//   --network_latency_ms=<int>, --network_jitter_ms=<int>,
+//   --network_bandwidth_kbps=<int>, --network_error_rate=<float>,
+//   --network_disconnect_rate=<float>, --network_stall_rate=<float>,
+//   --network_stall_ms=<int>: override the conditions applying to all hosts,
+//   --network_host_profiles=<host>:<name>,...: predefined conditions applying
+//     to the given hosts,
+//   --network_seed=<int>: seed of the random decisions.
+bool NetworkEmulationConfigFromCommandLine(const ftl::CommandLine& command_line,
+                                           NetworkEmulationConfig* config);
+
+}  // namespace ledger
+
+#endif  // APPS_LEDGER_SRC_NETWORK_NETWORK_CONDITIONS_H_
@@ -13,18 +13,34 @@
 
 namespace ledger {
 
+// Priority of a network request. Pending requests of higher priority are
+// started first.
+enum class RequestPriority {
+  // Requests that a user-visible operation is waiting for, such as fetching an
+  // object requested by a client.
+  INTERACTIVE,
+  // Requests needed for sync to make progress, such as registering or
+  // retrieving commits.
+  SYNC,
+  // Background transfers, such as uploading objects.
+  BACKGROUND,
+};
+
 // Abstraction for the network service. It will reconnect to the network service
 // application in case of disconnection, as well as handle 307 and 308
-// redirections.
+// redirections. The number of concurrent requests to each host may be limited,
+// in which case pending requests are started in the order of their priority.
 class NetworkService {
  public:
   NetworkService() {}
   virtual ~NetworkService() {}
 
-  // Starts a url network request.
+  // Starts a url network request. Cancelling the request before it is started
+  // removes it from the pending requests.
   virtual ftl::RefPtr<callback::Cancellable> Request(
       std::function<network::URLRequestPtr()> request_factory,
-      std::function<void(network::URLResponsePtr)> callback) = 0;
+      std::function<void(network::URLResponsePtr)> callback,
+      RequestPriority priority) = 0;
 
  private:
   FTL_DISALLOW_COPY_AND_ASSIGN(NetworkService);
@@ -4,10 +4,15 @@
 
 #include "apps/ledger/src/network/network_service_impl.h"
 
+#include <algorithm>
+#include <utility>
+
 #include "apps/ledger/src/callback/cancellable_helper.h"
 #include "apps/ledger/src/callback/destruction_sentinel.h"
 #include "apps/ledger/src/callback/trace_callback.h"
+#include "apps/tracing/lib/trace/event.h"
 #include "lib/ftl/strings/ascii.h"
+#include "lib/ftl/time/time_point.h"
 
 namespace ledger {
 
@@ -15,15 +20,42 @@ const uint32_t kMaxRedirectCount = 32;
 const int32_t kTooManyRedirectErrorCode = -310;
 const int32_t kInvalidResponseErrorCode = -320;
 
-class NetworkServiceImpl::RunningRequest {
- public:
-  RunningRequest(std::function<network::URLRequestPtr()> request_factory)
-      : request_factory_(std::move(request_factory)), redirect_count_(0u) {}
+// Maximum number of requests in progress to a single host.
+const size_t kMaxConcurrentRequestsPerHost = 6;
 
-  void Cancel() {
-    FTL_DCHECK(on_empty_callback_);
-    on_empty_callback_();
+namespace {
+
+// Returns the host, including the port if any, of the given url.
+std::string GetHost(const std::string& url) {
+  size_t host_start = url.find("://");
+  host_start = host_start == std::string::npos ? 0 : host_start + 3;
+  size_t host_end = url.find_first_of("/?#", host_start);
+  if (host_end == std::string::npos) {
+    host_end = url.size();
   }
+  return url.substr(host_start, host_end - host_start);
+}
+
+}  // namespace
+
+class NetworkServiceImpl::RunningRequest {
+ public:
+  // |request| is the request to make when the request starts, created by
+  // |request_factory|. |request_factory| is called again when the request
+  // needs to be restarted.
+  RunningRequest(std::function<network::URLRequestPtr()> request_factory,
+                 network::URLRequestPtr request)
+      : request_factory_(std::move(request_factory)),
+        next_request_(std::move(request)),
+        redirect_count_(0u),
+        trace_flow_id_(TRACE_NONCE()) {}
+
+  // Id of the trace flow linking the caller of the request to the request
+  // being started, once a slot is available for its host, and to its
+  // completion.
+  uint64_t trace_flow_id() const { return trace_flow_id_; }
+
+  void Cancel() { Done(); }
 
   // Set the network service to use. This will start (or restart) the request.
   void SetNetworkService(network::NetworkService* network_service) {
@@ -39,12 +71,14 @@ class NetworkServiceImpl::RunningRequest {
     callback_ = [ this, callback = std::move(callback) ](
         network::URLResponsePtr response) {
       FTL_DCHECK(on_empty_callback_);
+      TRACE_DURATION("ledger", "network_request_done");
+      TRACE_FLOW_END("ledger", "network_request", trace_flow_id_);
       if (destruction_sentinel_.DestructedWhile([
             callback = std::move(callback), &response
           ] { callback(std::move(response)); })) {
         return;
       }
-      on_empty_callback_();
+      Done();
     };
   }
 
@@ -52,7 +86,21 @@ class NetworkServiceImpl::RunningRequest {
     on_empty_callback_ = on_empty_callback;
   }
 
+  // Sets the closure called after the request is done, either because it
+  // completed or because it was cancelled, once it is deleted.
+  void set_on_done(ftl::Closure on_done) { on_done_ = std::move(on_done); }
+
  private:
+  void Done() {
+    FTL_DCHECK(on_empty_callback_);
+    ftl::Closure on_done = std::move(on_done_);
+    on_empty_callback_();
+    // This class is deleted at this point. Do not access any field.
+    if (on_done) {
+      on_done();
+    }
+  }
+
   void Start() {
     // Cancel any pending request.
     url_loader_.reset();
@@ -61,7 +109,10 @@ class NetworkServiceImpl::RunningRequest {
     if (!network_service_)
       return;
 
-    auto request = request_factory_();
+    TRACE_DURATION("ledger", "network_request_start");
+    TRACE_FLOW_STEP("ledger", "network_request", trace_flow_id_);
+    network::URLRequestPtr request =
+        next_request_ ? std::move(next_request_) : request_factory_();
 
     // If last response was a redirect, follow it.
     if (!next_url_.empty())
@@ -136,42 +187,94 @@ class NetworkServiceImpl::RunningRequest {
   }
 
   std::function<network::URLRequestPtr()> request_factory_;
+  // The request to make on the next start, if already created.
+  network::URLRequestPtr next_request_;
   std::function<void(network::URLResponsePtr)> callback_;
   ftl::Closure on_empty_callback_;
+  ftl::Closure on_done_;
   std::string next_url_;
   uint32_t redirect_count_;
-  network::NetworkService* network_service_;
+  network::NetworkService* network_service_ = nullptr;
   network::URLLoaderPtr url_loader_;
+  const uint64_t trace_flow_id_;
   callback::DestructionSentinel destruction_sentinel_;
 };
 
+NetworkServiceImpl::HostRequests::HostRequests() {}
+
+NetworkServiceImpl::HostRequests::~HostRequests() {}
+
 NetworkServiceImpl::NetworkServiceImpl(
     ftl::RefPtr<ftl::TaskRunner> task_runner,
-    std::function<network::NetworkServicePtr()> network_service_factory)
+    std::function<network::NetworkServicePtr()> network_service_factory,
+    metrics::MetricsRegistry* metrics)
     : task_runner_(task_runner),
       network_service_factory_(network_service_factory),
+      requests_(metrics::OrUnreported(metrics)->GetCounter("requests")),
+      active_requests_(
+          metrics::OrUnreported(metrics)->GetGauge("active_requests")),
+      pending_requests_(
+          metrics::OrUnreported(metrics)->GetGauge("pending_requests")),
+      request_latency_(
+          metrics::OrUnreported(metrics)->GetHistogram("request_latency")),
       weak_factory_(this) {}
 
 NetworkServiceImpl::~NetworkServiceImpl() {}
 
 ftl::RefPtr<callback::Cancellable> NetworkServiceImpl::Request(
     std::function<network::URLRequestPtr()> request_factory,
-    std::function<void(network::URLResponsePtr)> callback) {
-  RunningRequest& request =
-      running_requests_.emplace(std::move(request_factory));
+    std::function<void(network::URLResponsePtr)> callback,
+    RequestPriority priority) {
+  // Create the request right away to find out which host it is made to.
+  network::URLRequestPtr url_request = request_factory();
+  TRACE_DURATION("ledger", "network_request_enqueue", "url",
+                 url_request->url.get());
+  std::string host = GetHost(url_request->url.get());
+  RunningRequest& request = running_requests_.emplace(
+      std::move(request_factory), std::move(url_request));
+  TRACE_FLOW_BEGIN("ledger", "network_request", request.trace_flow_id());
+  request.set_on_done([ this, host, request_ptr = &request ] {
+    OnRequestDone(host, request_ptr);
+  });
 
   auto cancellable =
       callback::CancellableImpl::Create([&request]() { request.Cancel(); });
 
+  auto timed_callback = [
+    request_latency = request_latency_, start = ftl::TimePoint::Now(),
+    callback = std::move(callback)
+  ](network::URLResponsePtr response) {
+    request_latency->Record(ftl::TimePoint::Now() - start);
+    callback(std::move(response));
+  };
   request.set_callback(cancellable->WrapCallback(
-      TRACE_CALLBACK(std::move(callback), "ledger", "network_request")));
-  if (!in_backoff_) {
-    request.SetNetworkService(GetNetworkService());
-  }
+      TRACE_CALLBACK(std::move(timed_callback), "ledger", "network_request")));
+
+  requests_->Increment();
+  pending_requests_->Add(1);
+  hosts_[host].pending[static_cast<size_t>(priority)].push_back(&request);
+  StartPendingRequests(host);
 
   return cancellable;
 }
 
+size_t NetworkServiceImpl::GetPendingRequestCount(
+    RequestPriority priority) const {
+  size_t count = 0;
+  for (const auto& host : hosts_) {
+    count += host.second.pending[static_cast<size_t>(priority)].size();
+  }
+  return count;
+}
+
+size_t NetworkServiceImpl::GetActiveRequestCount() const {
+  size_t count = 0;
+  for (const auto& host : hosts_) {
+    count += host.second.active.size();
+  }
+  return count;
+}
+
 network::NetworkService* NetworkServiceImpl::GetNetworkService() {
   if (!network_service_) {
     network_service_ = network_service_factory_();
@@ -180,8 +283,10 @@ network::NetworkService* NetworkServiceImpl::GetNetworkService() {
                        << "in environment, trying to reconnect.";
       FTL_DCHECK(!in_backoff_);
       in_backoff_ = true;
-      for (auto& request : running_requests_) {
-        request.SetNetworkService(nullptr);
+      for (auto& host : hosts_) {
+        for (RunningRequest* request : host.second.active) {
+          request->SetNetworkService(nullptr);
+        }
       }
       network_service_.reset();
       task_runner_->PostDelayedTask(
@@ -203,8 +308,56 @@ void NetworkServiceImpl::RetryGetNetworkService() {
     return;
   }
   network::NetworkService* network_service = GetNetworkService();
-  for (auto& request : running_requests_) {
-    request.SetNetworkService(network_service);
+  for (auto& host : hosts_) {
+    for (RunningRequest* request : host.second.active) {
+      request->SetNetworkService(network_service);
+    }
+  }
+}
+
+void NetworkServiceImpl::StartPendingRequests(const std::string& host) {
+  HostRequests& requests = hosts_[host];
+  for (auto& pending : requests.pending) {
+    while (!pending.empty() &&
+           requests.active.size() < kMaxConcurrentRequestsPerHost) {
+      RunningRequest* request = pending.front();
+      pending.pop_front();
+      requests.active.insert(request);
+      pending_requests_->Add(-1);
+      active_requests_->Add(1);
+      if (!in_backoff_) {
+        request->SetNetworkService(GetNetworkService());
+      }
+    }
+  }
+}
+
+void NetworkServiceImpl::OnRequestDone(const std::string& host,
+                                       RunningRequest* request) {
+  auto it = hosts_.find(host);
+  FTL_DCHECK(it != hosts_.end());
+  HostRequests& requests = it->second;
+  if (requests.active.erase(request)) {
+    active_requests_->Add(-1);
+    StartPendingRequests(host);
+  } else {
+    // The request was cancelled before being started.
+    for (auto& pending : requests.pending) {
+      auto pending_it = std::find(pending.begin(), pending.end(), request);
+      if (pending_it != pending.end()) {
+        pending.erase(pending_it);
+        pending_requests_->Add(-1);
+        break;
+      }
+    }
+  }
+
+  if (requests.active.empty() &&
+      std::all_of(requests.pending.begin(), requests.pending.end(),
+                  [](const std::deque<RunningRequest*>& pending) {
+                    return pending.empty();
+                  })) {
+    hosts_.erase(it);
   }
 }
 
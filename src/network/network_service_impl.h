@@ -5,8 +5,15 @@
 #ifndef APPS_LEDGER_SRC_NETWORK_NETWORK_SERVICE_IMPL_H_
 #define APPS_LEDGER_SRC_NETWORK_NETWORK_SERVICE_IMPL_H_
 
+#include <array>
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+
 #include "apps/ledger/src/backoff/exponential_backoff.h"
 #include "apps/ledger/src/callback/auto_cleanable.h"
+#include "apps/ledger/src/metrics/metrics_registry.h"
 #include "apps/ledger/src/network/network_service.h"
 #include "apps/network/services/network_service.fidl.h"
 #include "lib/ftl/memory/weak_ptr.h"
@@ -14,30 +21,72 @@
 
 namespace ledger {
 
+// Implementation of NetworkService limiting the number of concurrent requests
+// to each host. Requests exceeding the limit are queued and started by order of
+// priority, then in the order in which they were made.
+//
+// The number of requests and their latency are recorded in |metrics|, if not
+// null.
 class NetworkServiceImpl : public NetworkService {
  public:
   NetworkServiceImpl(
       ftl::RefPtr<ftl::TaskRunner> task_runner,
-      std::function<network::NetworkServicePtr()> network_service_factory);
+      std::function<network::NetworkServicePtr()> network_service_factory,
+      metrics::MetricsRegistry* metrics = nullptr);
   ~NetworkServiceImpl() override;
 
   ftl::RefPtr<callback::Cancellable> Request(
       std::function<network::URLRequestPtr()> request_factory,
-      std::function<void(network::URLResponsePtr)> callback) override;
+      std::function<void(network::URLResponsePtr)> callback,
+      RequestPriority priority) override;
+
+  // Returns the number of requests of the given priority waiting to be
+  // started.
+  size_t GetPendingRequestCount(RequestPriority priority) const;
+
+  // Returns the number of requests in progress.
+  size_t GetActiveRequestCount() const;
 
  private:
   class RunningRequest;
 
+  // Number of values of RequestPriority.
+  static constexpr size_t kPriorityCount = 3;
+
+  // Requests made to a single host.
+  struct HostRequests {
+    HostRequests();
+    ~HostRequests();
+
+    std::set<RunningRequest*> active;
+    // Pending requests, indexed by priority.
+    std::array<std::deque<RunningRequest*>, kPriorityCount> pending;
+  };
+
   network::NetworkService* GetNetworkService();
 
   void RetryGetNetworkService();
 
+  // Starts the pending requests to the given host, as long as the number of
+  // requests in progress allows it.
+  void StartPendingRequests(const std::string& host);
+
+  // Called when the given request either completed or was cancelled.
+  void OnRequestDone(const std::string& host, RunningRequest* request);
+
   ftl::RefPtr<ftl::TaskRunner> task_runner_;
   backoff::ExponentialBackoff backoff_;
   bool in_backoff_ = false;
   std::function<network::NetworkServicePtr()> network_service_factory_;
   network::NetworkServicePtr network_service_;
+  // All requests, pending or in progress.
   callback::AutoCleanableSet<RunningRequest> running_requests_;
+  std::map<std::string, HostRequests> hosts_;
+
+  metrics::Counter* const requests_;
+  metrics::Gauge* const active_requests_;
+  metrics::Gauge* const pending_requests_;
+  metrics::Histogram* const request_latency_;
 
   // Must be the last member field.
   ftl::WeakPtrFactory<NetworkServiceImpl> weak_factory_;
@@ -199,7 +199,8 @@ TEST_F(NetworkServiceImplTest, SimpleRequest) {
       ](network::URLResponsePtr received_response) {
         response = std::move(received_response);
         message_loop_.PostQuitTask();
-      });
+      },
+      RequestPriority::SYNC);
   EXPECT_FALSE(callback_destroyed);
   EXPECT_FALSE(RunLoopWithTimeout());
 
@@ -225,7 +226,8 @@ TEST_F(NetworkServiceImplTest, CancelRequest) {
       ](network::URLResponsePtr) {
         received_response = true;
         message_loop_.PostQuitTask();
-      });
+      },
+      RequestPriority::SYNC);
 
   message_loop_.task_runner()->PostTask([cancel] { cancel->Cancel(); });
   cancel = nullptr;
@@ -239,9 +241,6 @@ TEST_F(NetworkServiceImplTest, NetworkDeleted) {
   network::URLResponsePtr response;
   network_service_.Request(
       [this, &request_count]() {
-        if (request_count == 0) {
-          fake_network_service_.reset();
-        }
         ++request_count;
         SetStringResponse("Hello", 200);
         return NewRequest("GET", "http://example.com");
@@ -249,7 +248,10 @@ TEST_F(NetworkServiceImplTest, NetworkDeleted) {
       [this, &response](network::URLResponsePtr received_response) {
         response = std::move(received_response);
         message_loop_.PostQuitTask();
-      });
+      },
+      RequestPriority::SYNC);
+  // Delete the network service while the request is in progress.
+  fake_network_service_.reset();
   EXPECT_FALSE(RunLoopWithTimeout());
 
   EXPECT_TRUE(response);
@@ -273,7 +275,8 @@ TEST_F(NetworkServiceImplTest, Redirection) {
       [this, &response](network::URLResponsePtr received_response) {
         response = std::move(received_response);
         message_loop_.PostQuitTask();
-      });
+      },
+      RequestPriority::SYNC);
   EXPECT_FALSE(RunLoopWithTimeout());
 
   EXPECT_TRUE(response);
@@ -296,12 +299,99 @@ TEST_F(NetworkServiceImplTest, CancelOnCallback) {
         message_loop_.PostQuitTask();
         request->Cancel();
         request = nullptr;
-      });
+      },
+      RequestPriority::SYNC);
   EXPECT_FALSE(response);
   EXPECT_FALSE(RunLoopWithTimeout());
 
   EXPECT_TRUE(response);
 }
 
+// Verifies that the number of concurrent requests to a single host is
+// limited.
+TEST_F(NetworkServiceImplTest, LimitConcurrentRequestsPerHost) {
+  std::vector<ftl::RefPtr<callback::Cancellable>> requests;
+  for (size_t i = 0; i < 10; ++i) {
+    requests.push_back(network_service_.Request(
+        [this] { return NewRequest("GET", "http://example.com/path"); },
+        [](network::URLResponsePtr response) {}, RequestPriority::SYNC));
+  }
+  size_t active_count = network_service_.GetActiveRequestCount();
+  EXPECT_LT(0u, active_count);
+  EXPECT_GT(10u, active_count);
+  EXPECT_EQ(10u - active_count,
+            network_service_.GetPendingRequestCount(RequestPriority::SYNC));
+
+  // Requests to another host are not limited by the ones above.
+  requests.push_back(network_service_.Request(
+      [this] { return NewRequest("GET", "http://example.org/path"); },
+      [](network::URLResponsePtr response) {}, RequestPriority::SYNC));
+  EXPECT_EQ(active_count + 1, network_service_.GetActiveRequestCount());
+  EXPECT_EQ(10u - active_count,
+            network_service_.GetPendingRequestCount(RequestPriority::SYNC));
+
+  // Completing (here, cancelling) an active request starts a pending one.
+  requests.front()->Cancel();
+  EXPECT_EQ(active_count + 1, network_service_.GetActiveRequestCount());
+  EXPECT_EQ(9u - active_count,
+            network_service_.GetPendingRequestCount(RequestPriority::SYNC));
+}
+
+// Verifies that pending requests are started by order of priority.
+TEST_F(NetworkServiceImplTest, PendingRequestsPriority) {
+  std::vector<ftl::RefPtr<callback::Cancellable>> requests;
+  // Make requests until some of them are pending.
+  while (network_service_.GetPendingRequestCount(
+             RequestPriority::BACKGROUND) == 0u) {
+    requests.push_back(network_service_.Request(
+        [this] { return NewRequest("GET", "http://example.com/background"); },
+        [](network::URLResponsePtr response) {},
+        RequestPriority::BACKGROUND));
+  }
+  auto interactive_request = network_service_.Request(
+      [this] { return NewRequest("GET", "http://example.com/interactive"); },
+      [](network::URLResponsePtr response) {}, RequestPriority::INTERACTIVE);
+  EXPECT_EQ(1u, network_service_.GetPendingRequestCount(
+                    RequestPriority::INTERACTIVE));
+
+  // The interactive request is started first, even though the background one
+  // was made earlier.
+  requests.front()->Cancel();
+  EXPECT_EQ(0u, network_service_.GetPendingRequestCount(
+                    RequestPriority::INTERACTIVE));
+  EXPECT_EQ(1u, network_service_.GetPendingRequestCount(
+                    RequestPriority::BACKGROUND));
+
+  requests[1]->Cancel();
+  EXPECT_EQ(0u, network_service_.GetPendingRequestCount(
+                    RequestPriority::BACKGROUND));
+}
+
+// Verifies that cancelling a pending request removes it from the queue.
+TEST_F(NetworkServiceImplTest, CancelPendingRequest) {
+  std::vector<ftl::RefPtr<callback::Cancellable>> requests;
+  while (network_service_.GetPendingRequestCount(RequestPriority::SYNC) ==
+         0u) {
+    requests.push_back(network_service_.Request(
+        [this] { return NewRequest("GET", "http://example.com"); },
+        [](network::URLResponsePtr response) {}, RequestPriority::SYNC));
+  }
+  size_t active_count = network_service_.GetActiveRequestCount();
+
+  bool callback_destroyed = false;
+  auto pending_request = network_service_.Request(
+      [this] { return NewRequest("GET", "http://example.com"); },
+      [destroy_watcher = DestroyWatcher::Create([&callback_destroyed] {
+         callback_destroyed = true;
+       })](network::URLResponsePtr response) { ADD_FAILURE(); },
+      RequestPriority::SYNC);
+  EXPECT_EQ(2u, network_service_.GetPendingRequestCount(RequestPriority::SYNC));
+
+  pending_request->Cancel();
+  EXPECT_TRUE(callback_destroyed);
+  EXPECT_EQ(1u, network_service_.GetPendingRequestCount(RequestPriority::SYNC));
+  EXPECT_EQ(active_count, network_service_.GetActiveRequestCount());
+}
+
 }  // namespace
 }  // namespace ledger
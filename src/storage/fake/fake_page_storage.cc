@@ -171,6 +171,51 @@ void FakePageStorage::GetCommitContents(const Commit& commit,
   on_done(Status::OK);
 }
 
+void FakePageStorage::GetCommitContentsCount(
+    const Commit& commit,
+    std::string prefix,
+    std::function<void(Status, uint64_t)> callback) {
+  // |GetCommitContents| is synchronous in this implementation.
+  uint64_t count = 0;
+  GetCommitContents(commit, prefix,
+                    [&prefix, &count](Entry entry) {
+                      if (entry.key.compare(0, prefix.size(), prefix) != 0) {
+                        return false;
+                      }
+                      ++count;
+                      return true;
+                    },
+                    [&count, &callback](Status status) {
+                      callback(status, count);
+                    });
+}
+
+void FakePageStorage::GetCommitKeyAtOffset(
+    const Commit& commit,
+    std::string min_key,
+    uint64_t offset,
+    std::function<void(Status, std::string)> callback) {
+  // |GetCommitContents| is synchronous in this implementation.
+  bool found = false;
+  std::string key;
+  GetCommitContents(commit, std::move(min_key),
+                    [&offset, &found, &key](Entry entry) {
+                      if (offset == 0) {
+                        found = true;
+                        key = std::move(entry.key);
+                        return false;
+                      }
+                      --offset;
+                      return true;
+                    },
+                    [&found, &key, &callback](Status status) {
+                      if (status == Status::OK && !found) {
+                        status = Status::NOT_FOUND;
+                      }
+                      callback(status, std::move(key));
+                    });
+}
+
 void FakePageStorage::GetEntryFromCommit(
     const Commit& commit,
     std::string key,
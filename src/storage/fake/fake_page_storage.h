@@ -49,6 +49,15 @@ class FakePageStorage : public test::PageStorageEmptyImpl {
                          std::string min_key,
                          std::function<bool(Entry)> on_next,
                          std::function<void(Status)> on_done) override;
+  void GetCommitContentsCount(
+      const Commit& commit,
+      std::string prefix,
+      std::function<void(Status, uint64_t)> callback) override;
+  void GetCommitKeyAtOffset(
+      const Commit& commit,
+      std::string min_key,
+      uint64_t offset,
+      std::function<void(Status, std::string)> callback) override;
   void GetEntryFromCommit(const Commit& commit,
                           std::string key,
                           std::function<void(Status, Entry)> callback) override;
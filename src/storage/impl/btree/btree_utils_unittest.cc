@@ -6,6 +6,7 @@
 #include <stdio.h>
 
 #include <algorithm>
+#include <limits>
 
 #include "apps/ledger/src/callback/capture.h"
 #include "apps/ledger/src/coroutine/coroutine_impl.h"
@@ -46,6 +47,23 @@ uint8_t GetTestNodeLevel(convert::ExtendedStringView key) {
 
 constexpr NodeLevelCalculator kTestNodeLevelCalculator = {&GetTestNodeLevel};
 
+class TestObject : public Object {
+ public:
+  TestObject(ObjectId id, std::string content)
+      : id_(std::move(id)), content_(std::move(content)) {}
+  ~TestObject() override {}
+
+  ObjectId GetId() const override { return id_; }
+  Status GetData(ftl::StringView* data) const override {
+    *data = content_;
+    return Status::OK;
+  }
+
+ private:
+  const ObjectId id_;
+  const std::string content_;
+};
+
 class TrackGetObjectFakePageStorage : public fake::FakePageStorage {
  public:
   TrackGetObjectFakePageStorage(PageId id) : fake::FakePageStorage(id) {}
@@ -57,10 +75,49 @@ class TrackGetObjectFakePageStorage : public fake::FakePageStorage {
       const std::function<void(Status, std::unique_ptr<const Object>)>&
           callback) override {
     object_requests.insert(object_id.ToString());
-    fake::FakePageStorage::GetObject(object_id, location, callback);
+    if (synchronous_requests > 0) {
+      --synchronous_requests;
+      auto it = GetObjects().find(object_id);
+      ASSERT_NE(GetObjects().end(), it);
+      callback(Status::OK,
+               std::make_unique<TestObject>(it->first, it->second));
+      return;
+    }
+    ++pending_requests;
+    max_pending_requests = std::max(max_pending_requests, pending_requests);
+    fake::FakePageStorage::GetObject(
+        object_id, location,
+        [ this, callback ](Status status,
+                           std::unique_ptr<const Object> object) {
+          --pending_requests;
+          callback(status, std::move(object));
+        });
   }
 
   std::set<ObjectId> object_requests;
+  size_t pending_requests = 0;
+  size_t max_pending_requests = 0;
+  // Number of the next requests for which the object is returned
+  // synchronously, as for objects available locally.
+  size_t synchronous_requests = 0;
+};
+
+// Coroutine service counting the coroutines it starts.
+class CountingCoroutineService : public coroutine::CoroutineService {
+ public:
+  CountingCoroutineService() {}
+  ~CountingCoroutineService() override {}
+
+  void StartCoroutine(
+      std::function<void(coroutine::CoroutineHandler*)> runnable) override {
+    ++started_coroutines;
+    coroutine_service_.StartCoroutine(std::move(runnable));
+  }
+
+  size_t started_coroutines = 0;
+
+ private:
+  coroutine::CoroutineServiceImpl coroutine_service_;
 };
 
 class BTreeUtilsTest : public StorageTest {
@@ -112,7 +169,7 @@ class BTreeUtilsTest : public StorageTest {
     return entries;
   }
 
-  coroutine::CoroutineServiceImpl coroutine_service_;
+  CountingCoroutineService coroutine_service_;
   TrackGetObjectFakePageStorage fake_storage_;
 
  private:
@@ -724,7 +781,7 @@ TEST_F(BTreeUtilsTest, GetObjectsFromSync) {
   //       /        \
   // [00, 01, 02]  [04]
   GetObjectsFromSync(
-      &coroutine_service_, &fake_storage_, root_id,
+      &fake_storage_, root_id, 10,
       callback::Capture([this] { message_loop_.PostQuitTask(); }, &status));
   ASSERT_FALSE(RunLoopWithTimeout());
   ASSERT_EQ(Status::OK, status);
@@ -752,6 +809,34 @@ TEST_F(BTreeUtilsTest, GetObjectsFromSync) {
   }
 }
 
+TEST_F(BTreeUtilsTest, GetObjectsFromSyncLimitsConcurrentRequests) {
+  std::vector<EntryChange> entries;
+  ASSERT_TRUE(CreateEntryChanges(100, &entries));
+  ObjectId root_id = CreateTree(entries);
+
+  std::set<ObjectId> object_ids;
+  Status status;
+  GetObjectIds(&coroutine_service_, &fake_storage_, root_id,
+               callback::Capture([this] { message_loop_.PostQuitTask(); },
+                                 &status, &object_ids));
+  ASSERT_FALSE(RunLoopWithTimeout());
+  ASSERT_EQ(Status::OK, status);
+
+  fake_storage_.object_requests.clear();
+  fake_storage_.max_pending_requests = 0;
+  GetObjectsFromSync(
+      &fake_storage_, root_id, 3,
+      callback::Capture([this] { message_loop_.PostQuitTask(); }, &status));
+  ASSERT_FALSE(RunLoopWithTimeout());
+  ASSERT_EQ(Status::OK, status);
+
+  // All objects are requested exactly once, and sibling nodes and values are
+  // requested concurrently, within the limit.
+  EXPECT_EQ(object_ids, fake_storage_.object_requests);
+  EXPECT_EQ(3u, fake_storage_.max_pending_requests);
+  EXPECT_EQ(0u, fake_storage_.pending_requests);
+}
+
 TEST_F(BTreeUtilsTest, ForEachEmptyTree) {
   std::vector<EntryChange> entries = {};
   ObjectId root_id = CreateTree(entries);
@@ -816,6 +901,175 @@ TEST_F(BTreeUtilsTest, ForEachEntryPrefix) {
   ASSERT_FALSE(RunLoopWithTimeout());
 }
 
+TEST_F(BTreeUtilsTest, ForEachEntryWithLocalNodesDoesNotStartCoroutine) {
+  // Create a tree from entries with keys from 00-99.
+  std::vector<EntryChange> entries;
+  ASSERT_TRUE(CreateEntryChanges(100, &entries));
+  ObjectId root_id = CreateTree(entries);
+
+  fake_storage_.synchronous_requests = std::numeric_limits<size_t>::max();
+  coroutine_service_.started_coroutines = 0;
+  int current_key = 0;
+  bool called = false;
+  Status status;
+  ForEachEntry(&coroutine_service_, &fake_storage_, root_id, "",
+               [&current_key](EntryAndNodeId e) {
+                 EXPECT_EQ(ftl::StringPrintf("key%02d", current_key),
+                           e.entry.key);
+                 current_key++;
+                 return true;
+               },
+               callback::Capture([&called] { called = true; }, &status));
+  EXPECT_TRUE(called);
+  EXPECT_EQ(Status::OK, status);
+  EXPECT_EQ(100, current_key);
+  EXPECT_EQ(0u, coroutine_service_.started_coroutines);
+}
+
+TEST_F(BTreeUtilsTest, ForEachEntryResumesInCoroutine) {
+  // Create a tree from entries with keys from 00-99.
+  std::vector<EntryChange> entries;
+  ASSERT_TRUE(CreateEntryChanges(100, &entries));
+  ObjectId root_id = CreateTree(entries);
+
+  // Only the first nodes are available synchronously: the iteration must
+  // continue in a coroutine without sending any entry twice.
+  fake_storage_.synchronous_requests = 3;
+  coroutine_service_.started_coroutines = 0;
+  int current_key = 0;
+  auto on_next = [&current_key](EntryAndNodeId e) {
+    EXPECT_EQ(ftl::StringPrintf("key%02d", current_key), e.entry.key);
+    current_key++;
+    return true;
+  };
+  auto on_done = [this](Status status) {
+    EXPECT_EQ(Status::OK, status);
+    message_loop_.PostQuitTask();
+  };
+  ForEachEntry(&coroutine_service_, &fake_storage_, root_id, "", on_next,
+               on_done);
+  ASSERT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(100, current_key);
+  EXPECT_EQ(1u, coroutine_service_.started_coroutines);
+}
+
+TEST_F(BTreeUtilsTest, CountEntries) {
+  // Create a tree from entries with keys from 00-99.
+  std::vector<EntryChange> entries;
+  ASSERT_TRUE(CreateEntryChanges(100, &entries));
+  ObjectId root_id = CreateTree(entries);
+
+  std::vector<std::pair<std::string, uint64_t>> expected_counts = {
+      {"", 100u},    {"key", 100u}, {"key3", 10u}, {"key30", 1u},
+      {"key9", 10u}, {"key300", 0u}, {"a", 0u},     {"z", 0u}};
+  for (const auto& expected : expected_counts) {
+    Status status;
+    uint64_t count;
+    CountEntries(&coroutine_service_, &fake_storage_, root_id, expected.first,
+                 callback::Capture([this] { message_loop_.PostQuitTask(); },
+                                   &status, &count));
+    ASSERT_FALSE(RunLoopWithTimeout());
+    EXPECT_EQ(Status::OK, status);
+    EXPECT_EQ(expected.second, count) << "prefix: " << expected.first;
+  }
+}
+
+TEST_F(BTreeUtilsTest, GetKeyAtOffset) {
+  // Create a tree from entries with keys from 00-99.
+  std::vector<EntryChange> entries;
+  ASSERT_TRUE(CreateEntryChanges(100, &entries));
+  ObjectId root_id = CreateTree(entries);
+
+  Status status;
+  std::string key;
+  for (uint64_t offset = 0; offset < 100; ++offset) {
+    GetKeyAtOffset(&coroutine_service_, &fake_storage_, root_id, "", offset,
+                   callback::Capture([this] { message_loop_.PostQuitTask(); },
+                                     &status, &key));
+    ASSERT_FALSE(RunLoopWithTimeout());
+    EXPECT_EQ(Status::OK, status);
+    EXPECT_EQ(ftl::StringPrintf("key%02d", static_cast<int>(offset)), key);
+  }
+
+  GetKeyAtOffset(&coroutine_service_, &fake_storage_, root_id, "key42", 10,
+                 callback::Capture([this] { message_loop_.PostQuitTask(); },
+                                   &status, &key));
+  ASSERT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+  EXPECT_EQ("key52", key);
+
+  GetKeyAtOffset(&coroutine_service_, &fake_storage_, root_id, "key421", 0,
+                 callback::Capture([this] { message_loop_.PostQuitTask(); },
+                                   &status, &key));
+  ASSERT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+  EXPECT_EQ("key43", key);
+
+  GetKeyAtOffset(&coroutine_service_, &fake_storage_, root_id, "key90", 10,
+                 callback::Capture([this] { message_loop_.PostQuitTask(); },
+                                   &status, &key));
+  ASSERT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::NOT_FOUND, status);
+}
+
+TEST_F(BTreeUtilsTest, SummariesFromNodesWithoutSummaries) {
+  // Create a tree without summaries, as written by version 0 of the node
+  // format.
+  // Expected layout (XX is key "keyXX"):
+  //          [03]
+  //       /        \
+  // [00, 01, 02]
+  std::vector<Entry> leaf_entries;
+  ASSERT_TRUE(CreateEntries(std::vector<size_t>({0, 1, 2}), &leaf_entries));
+  std::unique_ptr<const TreeNode> leaf;
+  ASSERT_TRUE(CreateNodeFromEntries(leaf_entries, std::vector<ObjectId>(4),
+                                    &leaf));
+  std::vector<Entry> root_entries;
+  ASSERT_TRUE(CreateEntries(std::vector<size_t>({3}), &root_entries));
+  Status status;
+  ObjectId root_id;
+  TreeNode::FromEntries(
+      &fake_storage_, 1u, root_entries, {leaf->GetId(), ""},
+      std::vector<SubtreeSummary>(),
+      callback::Capture([this] { message_loop_.PostQuitTask(); }, &status,
+                        &root_id));
+  ASSERT_FALSE(RunLoopWithTimeout());
+  ASSERT_EQ(Status::OK, status);
+
+  uint64_t count;
+  CountEntries(&coroutine_service_, &fake_storage_, root_id, "",
+               callback::Capture([this] { message_loop_.PostQuitTask(); },
+                                 &status, &count));
+  ASSERT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+  EXPECT_EQ(4u, count);
+
+  // Adding an entry rewrites the root with summaries. The existing child is
+  // not modified: it is reused as is, and its summary is counted.
+  std::vector<EntryChange> changes;
+  ASSERT_TRUE(CreateEntryChanges(std::vector<size_t>({4}), &changes));
+  ObjectId new_root_id;
+  std::unordered_set<ObjectId> new_nodes;
+  ApplyChanges(
+      &coroutine_service_, &fake_storage_, root_id,
+      std::make_unique<EntryChangeIterator>(changes.begin(), changes.end()),
+      callback::Capture([this] { message_loop_.PostQuitTask(); }, &status,
+                        &new_root_id, &new_nodes),
+      &kTestNodeLevelCalculator);
+  ASSERT_FALSE(RunLoopWithTimeout());
+  ASSERT_EQ(Status::OK, status);
+
+  std::unique_ptr<const TreeNode> new_root;
+  ASSERT_TRUE(CreateNodeFromId(new_root_id, &new_root));
+  ASSERT_TRUE(new_root->HasSummaries());
+  EXPECT_EQ(3u, new_root->GetChildSummary(0).entry_count);
+  EXPECT_EQ(1u, new_root->GetChildSummary(1).entry_count);
+  EXPECT_EQ(5u, new_root->GetSummary().entry_count);
+  EXPECT_EQ(5u * 5, new_root->GetSummary().key_bytes);
+  EXPECT_EQ(leaf->GetId(), new_root->GetChildId(0).ToString());
+  EXPECT_EQ(0u, new_nodes.count(leaf->GetId()));
+}
+
 TEST_F(BTreeUtilsTest, ForEachDiff) {
   std::unique_ptr<const Object> object;
   ASSERT_TRUE(AddObject("change1", &object));
@@ -866,6 +1120,103 @@ TEST_F(BTreeUtilsTest, ForEachDiff) {
   EXPECT_EQ(changes.size(), current_change);
 }
 
+TEST_F(BTreeUtilsTest, ForEachThreeWayDiff) {
+  std::unique_ptr<const Object> object;
+  ASSERT_TRUE(AddObject("left", &object));
+  ObjectId left_object_id = object->GetId();
+  ASSERT_TRUE(AddObject("right", &object));
+  ObjectId right_object_id = object->GetId();
+
+  std::vector<EntryChange> base_changes;
+  ASSERT_TRUE(CreateEntryChanges(50, &base_changes));
+  ObjectId base_root_id = CreateTree(base_changes);
+  const Entry& base_entry01 = base_changes[1].entry;
+  const Entry& base_entry10 = base_changes[10].entry;
+  const Entry& base_entry40 = base_changes[40].entry;
+  ASSERT_EQ("key01", base_entry01.key);
+  ASSERT_EQ("key10", base_entry10.key);
+  ASSERT_EQ("key40", base_entry40.key);
+
+  auto apply_changes = [this, &base_root_id](std::vector<EntryChange> changes) {
+    Status status;
+    ObjectId root_id;
+    std::unordered_set<ObjectId> new_nodes;
+    ApplyChanges(
+        &coroutine_service_, &fake_storage_, base_root_id,
+        std::make_unique<EntryChangeIterator>(changes.begin(), changes.end()),
+        callback::Capture([this] { message_loop_.PostQuitTask(); }, &status,
+                          &root_id, &new_nodes),
+        &kTestNodeLevelCalculator);
+    EXPECT_FALSE(RunLoopWithTimeout());
+    EXPECT_EQ(Status::OK, status);
+    return root_id;
+  };
+  // Left updates key01, deletes key40 and adds key255.
+  Entry left_entry01{"key01", left_object_id, KeyPriority::EAGER};
+  Entry left_entry255{"key255", left_object_id, KeyPriority::EAGER};
+  ObjectId left_root_id = apply_changes(
+      {EntryChange{left_entry01, false}, EntryChange{left_entry255, false},
+       EntryChange{base_entry40, true}});
+  // Right updates key01 and key10, and deletes key40.
+  Entry right_entry01{"key01", right_object_id, KeyPriority::EAGER};
+  Entry right_entry10{"key10", right_object_id, KeyPriority::EAGER};
+  ObjectId right_root_id = apply_changes(
+      {EntryChange{right_entry01, false}, EntryChange{right_entry10, false},
+       EntryChange{base_entry40, true}});
+
+  std::vector<ThreeWayChange> changes;
+  Status status;
+  ForEachThreeWayDiff(
+      &coroutine_service_, &fake_storage_, base_root_id, left_root_id,
+      right_root_id, "",
+      [&changes](ThreeWayChange change) {
+        changes.push_back(std::move(change));
+        return true;
+      },
+      callback::Capture([this] { message_loop_.PostQuitTask(); }, &status));
+  ASSERT_FALSE(RunLoopWithTimeout());
+  ASSERT_EQ(Status::OK, status);
+
+  ASSERT_EQ(4u, changes.size());
+  ASSERT_TRUE(changes[0].base && changes[0].left && changes[0].right);
+  EXPECT_EQ(base_entry01, *changes[0].base);
+  EXPECT_EQ(left_entry01, *changes[0].left);
+  EXPECT_EQ(right_entry01, *changes[0].right);
+
+  ASSERT_TRUE(changes[1].base && changes[1].left && changes[1].right);
+  EXPECT_EQ(base_entry10, *changes[1].base);
+  EXPECT_EQ(base_entry10, *changes[1].left);
+  EXPECT_EQ(right_entry10, *changes[1].right);
+
+  EXPECT_FALSE(changes[2].base);
+  ASSERT_TRUE(changes[2].left);
+  EXPECT_EQ(left_entry255, *changes[2].left);
+  EXPECT_FALSE(changes[2].right);
+
+  ASSERT_TRUE(changes[3].base);
+  EXPECT_EQ(base_entry40, *changes[3].base);
+  EXPECT_FALSE(changes[3].left);
+  EXPECT_FALSE(changes[3].right);
+
+  // Starting from a min key skips the smaller keys.
+  changes.clear();
+  ForEachThreeWayDiff(
+      &coroutine_service_, &fake_storage_, base_root_id, left_root_id,
+      right_root_id, "key2",
+      [&changes](ThreeWayChange change) {
+        changes.push_back(std::move(change));
+        return true;
+      },
+      callback::Capture([this] { message_loop_.PostQuitTask(); }, &status));
+  ASSERT_FALSE(RunLoopWithTimeout());
+  ASSERT_EQ(Status::OK, status);
+  ASSERT_EQ(2u, changes.size());
+  ASSERT_TRUE(changes[0].left);
+  EXPECT_EQ("key255", changes[0].left->key);
+  ASSERT_TRUE(changes[1].base);
+  EXPECT_EQ("key40", changes[1].base->key);
+}
+
 TEST_F(BTreeUtilsTest, ForEachDiffWithMinKey) {
   // Expected base tree layout (XX is key "keyXX"):
   //                     [50]
@@ -5,8 +5,11 @@
 #include "apps/ledger/src/storage/impl/btree/builder.h"
 
 #include "apps/ledger/src/callback/asynchronous_callback.h"
+#include "apps/ledger/src/callback/trace_callback.h"
+#include "apps/ledger/src/callback/trace_flow.h"
 #include "apps/ledger/src/callback/waiter.h"
 #include "apps/ledger/src/storage/impl/btree/internal_helper.h"
+#include "apps/ledger/src/storage/impl/btree/iterator.h"
 #include "apps/ledger/src/storage/impl/btree/synchronous_storage.h"
 #include "lib/ftl/functional/closure.h"
 #include "lib/ftl/functional/make_copyable.h"
@@ -90,9 +93,15 @@ class NodeBuilder {
     NULL_NODE,
   };
 
-  static NodeBuilder CreateExistingBuilder(uint8_t level, ObjectId object_id) {
-    return NodeBuilder(BuilderType::EXISTING_NODE, level, std::move(object_id),
+  static NodeBuilder CreateExistingBuilder(uint8_t level,
+                                           ObjectId object_id,
+                                           const SubtreeSummary* summary) {
+    NodeBuilder result(BuilderType::EXISTING_NODE, level, std::move(object_id),
                        {}, {});
+    if (summary) {
+      result.SetSummary(*summary);
+    }
+    return result;
   }
 
   static NodeBuilder CreateNewBuilder(uint8_t level,
@@ -121,6 +130,16 @@ class NodeBuilder {
   // Ensures that the entries and children of this builder are computed.
   Status ComputeContent(SynchronousStorage* page_storage);
 
+  // Records the summary of the tree represented by this builder.
+  void SetSummary(SubtreeSummary summary) {
+    has_summary_ = true;
+    summary_ = summary;
+  }
+
+  // Computes in |summary| the summary of the tree represented by this builder.
+  // This builder must not be a |NEW_NODE|.
+  Status GetSummary(SynchronousStorage* page_storage, SubtreeSummary* summary);
+
   // Delete the value with the given |key| from the builder. |key_level| must be
   // greater or equal then the node level.
   Status Delete(SynchronousStorage* page_storage,
@@ -211,6 +230,10 @@ class NodeBuilder {
   ObjectId object_id_;
   std::vector<Entry> entries_;
   std::vector<NodeBuilder> children_;
+  // Summary of the tree, only meaningful for |EXISTING_NODE| builders.
+  // |has_summary_| is false until the summary is known.
+  bool has_summary_ = false;
+  SubtreeSummary summary_;
 
   FTL_DISALLOW_COPY_AND_ASSIGN(NodeBuilder);
 };
@@ -228,6 +251,9 @@ Status NodeBuilder::FromId(SynchronousStorage* page_storage,
   *result = NodeBuilder(BuilderType::EXISTING_NODE, node->level(),
                         std::move(object_id), std::move(entries),
                         std::move(children));
+  if (node->HasSummaries()) {
+    result->SetSummary(node->GetSummary());
+  }
   return Status::OK;
 }
 
@@ -293,12 +319,13 @@ Status NodeBuilder::Build(SynchronousStorage* page_storage,
                           ObjectId* object_id,
                           std::unordered_set<ObjectId>* new_ids) {
   if (!*this) {
-    RETURN_ON_ERROR(
-        page_storage->TreeNodeFromEntries(0, {}, {""}, &object_id_));
+    RETURN_ON_ERROR(page_storage->TreeNodeFromEntries(
+        0, {}, {""}, {SubtreeSummary()}, &object_id_));
 
     *object_id = object_id_;
     new_ids->insert(object_id_);
     type_ = BuilderType::EXISTING_NODE;
+    SetSummary(SubtreeSummary());
     return Status::OK;
   }
   if (type_ == BuilderType::EXISTING_NODE) {
@@ -308,24 +335,47 @@ Status NodeBuilder::Build(SynchronousStorage* page_storage,
 
   std::vector<NodeBuilder*> to_build;
   while (CollectNodesToBuild(&to_build)) {
+    // Compute the summaries of all the children first: this might need to
+    // read nodes written without summaries, and must be done before any write
+    // is pending.
+    std::vector<std::vector<SubtreeSummary>> children_summaries(
+        to_build.size());
+    for (size_t i = 0; i < to_build.size(); ++i) {
+      for (auto& sub_child : to_build[i]->children_) {
+        FTL_DCHECK(sub_child.type_ != BuilderType::NEW_NODE);
+        SubtreeSummary sub_child_summary;
+        RETURN_ON_ERROR(sub_child.GetSummary(page_storage, &sub_child_summary));
+        children_summaries[i].push_back(sub_child_summary);
+      }
+    }
+
     auto waiter = callback::StatusWaiter<Status>::Create(Status::OK);
-    for (NodeBuilder* child : to_build) {
+    for (size_t i = 0; i < to_build.size(); ++i) {
+      NodeBuilder* child = to_build[i];
       std::vector<ObjectId> children;
-      for (const auto& sub_child : child->children_) {
-        FTL_DCHECK(sub_child.type_ != BuilderType::NEW_NODE);
-        children.push_back(sub_child.object_id_);
+      SubtreeSummary summary;
+      for (const auto& entry : child->entries_) {
+        ++summary.entry_count;
+        summary.key_bytes += entry.key.size();
+      }
+      for (size_t j = 0; j < child->children_.size(); ++j) {
+        children.push_back(child->children_[j].object_id_);
+        summary.entry_count += children_summaries[i][j].entry_count;
+        summary.key_bytes += children_summaries[i][j].key_bytes;
       }
-      TreeNode::FromEntries(page_storage->page_storage(), child->level_,
-                            child->entries_, std::move(children), [
-                              new_ids, child, callback = waiter->NewCallback()
-                            ](Status status, ObjectId object_id) {
-                              if (status == Status::OK) {
-                                child->type_ = BuilderType::EXISTING_NODE;
-                                child->object_id_ = std::move(object_id);
-                                new_ids->insert(child->object_id_);
-                              }
-                              callback(status);
-                            });
+      TreeNode::FromEntries(
+          page_storage->page_storage(), child->level_, child->entries_,
+          std::move(children), children_summaries[i],
+          [ new_ids, child, summary, callback = waiter->NewCallback() ](
+              Status status, ObjectId object_id) {
+            if (status == Status::OK) {
+              child->type_ = BuilderType::EXISTING_NODE;
+              child->object_id_ = std::move(object_id);
+              child->SetSummary(summary);
+              new_ids->insert(child->object_id_);
+            }
+            callback(status);
+          });
     }
     Status status;
     if (coroutine::SyncCall(page_storage->handler(),
@@ -364,6 +414,26 @@ Status NodeBuilder::ComputeContent(SynchronousStorage* page_storage) {
   return Status::OK;
 }
 
+Status NodeBuilder::GetSummary(SynchronousStorage* page_storage,
+                               SubtreeSummary* summary) {
+  if (!*this) {
+    *summary = SubtreeSummary();
+    return Status::OK;
+  }
+
+  FTL_DCHECK(type_ == BuilderType::EXISTING_NODE);
+
+  if (!has_summary_) {
+    // The parent of this node was written without summaries.
+    SubtreeSummary computed_summary;
+    RETURN_ON_ERROR(
+        GetSubtreeSummary(page_storage, object_id_, &computed_summary));
+    SetSummary(computed_summary);
+  }
+  *summary = summary_;
+  return Status::OK;
+}
+
 Status NodeBuilder::Delete(SynchronousStorage* page_storage,
                            uint8_t key_level,
                            std::string key,
@@ -575,12 +645,14 @@ void NodeBuilder::ExtractContent(const TreeNode& node,
   FTL_DCHECK(children);
   *entries = std::vector<Entry>(node.entries().begin(), node.entries().end());
   children->clear();
-  for (const auto& child_id : node.children_ids()) {
+  for (size_t i = 0; i < node.children_ids().size(); ++i) {
+    const auto& child_id = node.children_ids()[i];
     if (child_id.empty()) {
       children->push_back(NodeBuilder());
     } else {
-      children->push_back(
-          NodeBuilder::CreateExistingBuilder(node.level() - 1, child_id));
+      children->push_back(NodeBuilder::CreateExistingBuilder(
+          node.level() - 1, child_id,
+          node.HasSummaries() ? &node.GetChildSummary(i) : nullptr));
     }
   }
 }
@@ -626,9 +698,13 @@ void ApplyChanges(
     std::function<void(Status, ObjectId, std::unordered_set<ObjectId>)>
         callback,
     const NodeLevelCalculator* node_level_calculator) {
+  std::function<void(Status, ObjectId, std::unordered_set<ObjectId>)>
+      traced_callback =
+          TRACE_CALLBACK(std::move(callback), "ledger", "btree_apply_changes",
+                         "root_id", callback::TraceIdArg(root_id));
   coroutine_service->StartCoroutine(ftl::MakeCopyable([
     page_storage, root_id = root_id.ToString(), changes = std::move(changes),
-    callback = std::move(callback), node_level_calculator
+    callback = std::move(traced_callback), node_level_calculator
   ](coroutine::CoroutineHandler * handler) mutable {
     SynchronousStorage storage(page_storage, handler);
 
@@ -4,6 +4,9 @@
 
 #include "apps/ledger/src/storage/impl/btree/diff.h"
 
+#include <deque>
+#include <memory>
+
 #include "apps/ledger/src/storage/impl/btree/internal_helper.h"
 #include "apps/ledger/src/storage/impl/btree/iterator.h"
 #include "apps/ledger/src/storage/impl/btree/synchronous_storage.h"
@@ -12,12 +15,35 @@ namespace storage {
 namespace btree {
 namespace {
 
+// Difference between the base tree and the other tree for a single key.
+// |base| and |other| are null if the key is absent from the corresponding
+// tree.
+struct TwoWayChange {
+  std::unique_ptr<Entry> base;
+  std::unique_ptr<Entry> other;
+};
+
+std::unique_ptr<Entry> CloneEntry(const Entry* entry) {
+  if (!entry) {
+    return nullptr;
+  }
+  return std::make_unique<Entry>(*entry);
+}
+
+// Returns the key of |change|, which has at least one non-null entry.
+const std::string& GetKey(const ThreeWayChange& change) {
+  if (change.base) {
+    return change.base->key;
+  }
+  return change.left ? change.left->key : change.right->key;
+}
+
 // Aggregates 2 BTreeIterator and allows to walk these concurrently to compute
 // the diff.
 class IteratorPair {
  public:
   IteratorPair(SynchronousStorage* storage,
-               const std::function<bool(EntryChange)>& on_next)
+               const std::function<bool(TwoWayChange)>& on_next)
       : on_next_(on_next), left_(storage), right_(storage) {}
 
   // Initialize the pair with the ids of both roots.
@@ -251,17 +277,30 @@ class IteratorPair {
     }
   }
 
-  // Send a diff using the right iterator.
+  // Send a diff using the right iterator, and the entry of the left iterator
+  // if it is on the same key.
   bool SendRight() {
-    return on_next_({right_.CurrentEntry(), !diff_from_left_to_right_});
+    const Entry* left_entry = nullptr;
+    if (left_.HasValue() &&
+        left_.CurrentEntry().key == right_.CurrentEntry().key) {
+      left_entry = &left_.CurrentEntry();
+    }
+    return Send(left_entry, &right_.CurrentEntry());
   }
 
   // Send a diff using the left iterator.
-  bool SendLeft() {
-    return on_next_({left_.CurrentEntry(), diff_from_left_to_right_});
+  bool SendLeft() { return Send(&left_.CurrentEntry(), nullptr); }
+
+  // Send the diff between the given entries of the left and the right
+  // iterators, any of which can be null.
+  bool Send(const Entry* left_entry, const Entry* right_entry) {
+    if (!diff_from_left_to_right_) {
+      std::swap(left_entry, right_entry);
+    }
+    return on_next_({CloneEntry(left_entry), CloneEntry(right_entry)});
   }
 
-  const std::function<bool(EntryChange)>& on_next_;
+  const std::function<bool(TwoWayChange)>& on_next_;
   BTreeIterator left_;
   BTreeIterator right_;
   // Keep track whether the change is from left to right, or right to left.
@@ -270,11 +309,65 @@ class IteratorPair {
   bool diff_from_left_to_right_ = true;
 };
 
+// Diff between a base tree and another tree, read one change at a time. At
+// most the changes sent by a single step of the iterators are buffered.
+class DiffStream {
+ public:
+  explicit DiffStream(SynchronousStorage* storage)
+      : on_next_([this](TwoWayChange change) {
+          changes_.push_back(std::move(change));
+          return true;
+        }),
+        iterators_(storage, on_next_) {}
+
+  Status Init(ObjectIdView base_node_id,
+              ObjectIdView other_node_id,
+              ftl::StringView min_key) {
+    if (base_node_id == other_node_id) {
+      return Status::OK;
+    }
+    RETURN_ON_ERROR(iterators_.Init(base_node_id, other_node_id, min_key));
+    return Fill();
+  }
+
+  bool Finished() const { return changes_.empty(); }
+
+  // Returns the key of the current change. Only valid if |Finished| is false.
+  const std::string& CurrentKey() const {
+    FTL_DCHECK(!Finished());
+    const TwoWayChange& change = changes_.front();
+    return change.base ? change.base->key : change.other->key;
+  }
+
+  // Removes the current change from the stream and returns it.
+  Status Take(TwoWayChange* change) {
+    FTL_DCHECK(!Finished());
+    *change = std::move(changes_.front());
+    changes_.pop_front();
+    return Fill();
+  }
+
+ private:
+  Status Fill() {
+    while (changes_.empty() && !iterators_.Finished()) {
+      iterators_.SendDiff();
+      RETURN_ON_ERROR(iterators_.Advance());
+    }
+    return Status::OK;
+  }
+
+  std::deque<TwoWayChange> changes_;
+  const std::function<bool(TwoWayChange)> on_next_;
+  IteratorPair iterators_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(DiffStream);
+};
+
 Status ForEachDiffInternal(SynchronousStorage* storage,
                            ObjectIdView left_node_id,
                            ObjectIdView right_node_id,
                            std::string min_key,
-                           const std::function<bool(EntryChange)>& on_next) {
+                           const std::function<bool(TwoWayChange)>& on_next) {
   if (left_node_id == right_node_id) {
     return Status::OK;
   }
@@ -292,6 +385,58 @@ Status ForEachDiffInternal(SynchronousStorage* storage,
   return Status::OK;
 }
 
+Status ForEachThreeWayDiffInternal(
+    SynchronousStorage* storage,
+    ObjectIdView base_node_id,
+    ObjectIdView left_node_id,
+    ObjectIdView right_node_id,
+    std::string min_key,
+    const std::function<bool(ThreeWayChange)>& on_next) {
+  DiffStream left(storage);
+  DiffStream right(storage);
+  RETURN_ON_ERROR(left.Init(base_node_id, left_node_id, min_key));
+  RETURN_ON_ERROR(right.Init(base_node_id, right_node_id, min_key));
+
+  while (!left.Finished() || !right.Finished()) {
+    bool from_left =
+        !left.Finished() &&
+        (right.Finished() || left.CurrentKey() <= right.CurrentKey());
+    bool from_right =
+        !right.Finished() &&
+        (left.Finished() || right.CurrentKey() <= left.CurrentKey());
+
+    TwoWayChange left_change;
+    TwoWayChange right_change;
+    if (from_left) {
+      RETURN_ON_ERROR(left.Take(&left_change));
+    }
+    if (from_right) {
+      RETURN_ON_ERROR(right.Take(&right_change));
+    }
+
+    // A key absent from one of the diffs has the same entry on that side as
+    // in the base tree.
+    ThreeWayChange change;
+    if (from_left && from_right) {
+      change.base = std::move(left_change.base);
+      change.left = std::move(left_change.other);
+      change.right = std::move(right_change.other);
+    } else if (from_left) {
+      change.base = std::move(left_change.base);
+      change.left = std::move(left_change.other);
+      change.right = CloneEntry(change.base.get());
+    } else {
+      change.base = std::move(right_change.base);
+      change.left = CloneEntry(change.base.get());
+      change.right = std::move(right_change.other);
+    }
+    if (!on_next(std::move(change))) {
+      return Status::OK;
+    }
+  }
+  return Status::OK;
+}
+
 }  // namespace
 
 void ForEachDiff(coroutine::CoroutineService* coroutine_service,
@@ -301,15 +446,59 @@ void ForEachDiff(coroutine::CoroutineService* coroutine_service,
                  std::string min_key,
                  std::function<bool(EntryChange)> on_next,
                  std::function<void(Status)> on_done) {
-  coroutine_service->StartCoroutine([
-    page_storage, base_root_id, other_root_id, on_next = std::move(on_next),
-    min_key = std::move(min_key), on_done = std::move(on_done)
-  ](coroutine::CoroutineHandler * handler) {
-    SynchronousStorage storage(page_storage, handler);
-
-    on_done(ForEachDiffInternal(&storage, base_root_id, other_root_id,
-                                std::move(min_key), on_next));
-  });
+  // If the iteration is restarted in a coroutine, it resumes after the last
+  // change sent to |on_next|.
+  auto resume_key = std::make_shared<std::string>(std::move(min_key));
+  RunSynchronouslyOrInCoroutine(
+      coroutine_service, page_storage,
+      [
+        base_root_id = base_root_id.ToString(),
+        other_root_id = other_root_id.ToString(), resume_key,
+        on_next = std::move(on_next)
+      ](SynchronousStorage * storage) {
+        std::function<bool(TwoWayChange)> on_next_and_resume =
+            [&resume_key, &on_next](TwoWayChange change) {
+              EntryChange entry_change =
+                  change.other ? EntryChange{std::move(*change.other), false}
+                               : EntryChange{std::move(*change.base), true};
+              *resume_key = KeyAfter(entry_change.entry.key);
+              return on_next(std::move(entry_change));
+            };
+        return ForEachDiffInternal(storage, base_root_id, other_root_id,
+                                   *resume_key, on_next_and_resume);
+      },
+      std::move(on_done));
+}
+
+void ForEachThreeWayDiff(coroutine::CoroutineService* coroutine_service,
+                         PageStorage* page_storage,
+                         ObjectIdView base_root_id,
+                         ObjectIdView left_root_id,
+                         ObjectIdView right_root_id,
+                         std::string min_key,
+                         std::function<bool(ThreeWayChange)> on_next,
+                         std::function<void(Status)> on_done) {
+  // If the iteration is restarted in a coroutine, it resumes after the last
+  // change sent to |on_next|.
+  auto resume_key = std::make_shared<std::string>(std::move(min_key));
+  RunSynchronouslyOrInCoroutine(
+      coroutine_service, page_storage,
+      [
+        base_root_id = base_root_id.ToString(),
+        left_root_id = left_root_id.ToString(),
+        right_root_id = right_root_id.ToString(), resume_key,
+        on_next = std::move(on_next)
+      ](SynchronousStorage * storage) {
+        std::function<bool(ThreeWayChange)> on_next_and_resume =
+            [&resume_key, &on_next](ThreeWayChange change) {
+              *resume_key = KeyAfter(GetKey(change));
+              return on_next(std::move(change));
+            };
+        return ForEachThreeWayDiffInternal(storage, base_root_id, left_root_id,
+                                           right_root_id, *resume_key,
+                                           on_next_and_resume);
+      },
+      std::move(on_done));
 }
 
 }  // namespace btree
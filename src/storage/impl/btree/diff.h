@@ -27,6 +27,23 @@ void ForEachDiff(coroutine::CoroutineService* coroutine_service,
                  std::function<bool(EntryChange)> on_next,
                  std::function<void(Status)> on_done);
 
+// Iterates through the keys whose entry differs between the tree of root id
+// |base_root_id| and at least one of the trees of root ids |left_root_id| and
+// |right_root_id|, in key order, and calls |on_next| with the three entries of
+// each of these keys. The three trees are walked together, and the subtrees
+// that |left| or |right| share with |base| are skipped. Returning false from
+// |on_next| will immediately stop the iteration. |on_done| is called once,
+// upon successfull completion, i.e. when there are no more differences or
+// iteration was interrupted, or if an error occurs.
+void ForEachThreeWayDiff(coroutine::CoroutineService* coroutine_service,
+                         PageStorage* page_storage,
+                         ObjectIdView base_root_id,
+                         ObjectIdView left_root_id,
+                         ObjectIdView right_root_id,
+                         std::string min_key,
+                         std::function<bool(ThreeWayChange)> on_next,
+                         std::function<void(Status)> on_done);
+
 }  // namespace btree
 }  // namespace storage
 
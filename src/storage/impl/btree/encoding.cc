@@ -37,6 +37,14 @@ Entry ToEntry(const EntryStorage* entry_storage) {
 }
 }  // namespace
 
+bool operator==(const SubtreeSummary& lhs, const SubtreeSummary& rhs) {
+  return lhs.entry_count == rhs.entry_count && lhs.key_bytes == rhs.key_bytes;
+}
+
+bool operator!=(const SubtreeSummary& lhs, const SubtreeSummary& rhs) {
+  return !(lhs == rhs);
+}
+
 bool CheckValidTreeNodeSerialization(ftl::StringView data) {
   flatbuffers::Verifier verifier(
       reinterpret_cast<const unsigned char*>(data.data()), data.size());
@@ -76,12 +84,38 @@ bool CheckValidTreeNodeSerialization(ftl::StringView data) {
     return false;
   }
 
+  // Nodes of version 0 of the format have no summaries.
+  if (!tree_node->children_summaries()) {
+    return true;
+  }
+
+  // Check that there is a summary for each child index, and that empty
+  // children have empty summaries.
+  if (tree_node->children_summaries()->size() !=
+      tree_node->entries()->size() + 1) {
+    return false;
+  }
+  auto child_it = tree_node->children()->begin();
+  for (size_t i = 0; i < tree_node->children_summaries()->size(); ++i) {
+    if (child_it != tree_node->children()->end() && (*child_it)->index() == i) {
+      ++child_it;
+      continue;
+    }
+    const auto* summary = tree_node->children_summaries()->Get(i);
+    if (summary->entry_count() != 0 || summary->key_bytes() != 0) {
+      return false;
+    }
+  }
+
   return true;
 }
 
 std::string EncodeNode(uint8_t level,
                        const std::vector<Entry>& entries,
-                       const std::vector<ObjectId>& children) {
+                       const std::vector<ObjectId>& children,
+                       const std::vector<SubtreeSummary>& children_summaries) {
+  FTL_DCHECK(children_summaries.empty() ||
+             children_summaries.size() == children.size());
   flatbuffers::FlatBufferBuilder builder;
 
   auto entries_offsets = builder.CreateVector(
@@ -115,8 +149,23 @@ std::string EncodeNode(uint8_t level,
             ++current_index;
           }));
 
-  builder.Finish(
-      CreateTreeNodeStorage(builder, entries_offsets, children_offsets, level));
+  flatbuffers::Offset<flatbuffers::Vector<const SubtreeSummaryStorage*>>
+      summaries_offsets;
+  if (!children_summaries.empty()) {
+    summaries_offsets = builder.CreateVectorOfStructs(
+        children_summaries.size(),
+        static_cast<std::function<void(size_t, SubtreeSummaryStorage*)>>(
+            [&children_summaries](size_t i,
+                                  SubtreeSummaryStorage* summary_storage) {
+              *summary_storage =
+                  SubtreeSummaryStorage(children_summaries[i].entry_count,
+                                        children_summaries[i].key_bytes);
+            }));
+  }
+
+  builder.Finish(CreateTreeNodeStorage(builder, entries_offsets,
+                                       children_offsets, level,
+                                       summaries_offsets));
 
   return std::string(reinterpret_cast<const char*>(builder.GetBufferPointer()),
                      builder.GetSize());
@@ -125,7 +174,8 @@ std::string EncodeNode(uint8_t level,
 bool DecodeNode(ftl::StringView data,
                 uint8_t* level,
                 std::vector<Entry>* res_entries,
-                std::vector<ObjectId>* res_children) {
+                std::vector<ObjectId>* res_children,
+                std::vector<SubtreeSummary>* res_children_summaries) {
   FTL_DCHECK(CheckValidTreeNodeSerialization(data));
 
   const TreeNodeStorage* tree_node =
@@ -144,6 +194,16 @@ bool DecodeNode(ftl::StringView data,
     res_children->push_back(convert::ToString(&child_storage->object_id()));
   }
   res_children->resize(tree_node->entries()->size() + 1);
+  res_children_summaries->clear();
+  if (tree_node->children_summaries()) {
+    res_children_summaries->reserve(tree_node->children_summaries()->size());
+    for (const auto* summary_storage : *(tree_node->children_summaries())) {
+      SubtreeSummary summary;
+      summary.entry_count = summary_storage->entry_count();
+      summary.key_bytes = summary_storage->key_bytes();
+      res_children_summaries->push_back(summary);
+    }
+  }
 
   return true;
 }
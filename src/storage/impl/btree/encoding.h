@@ -12,16 +12,32 @@
 
 namespace storage {
 
+// Statistics about the entries stored in a subtree.
+struct SubtreeSummary {
+  uint64_t entry_count = 0;
+  uint64_t key_bytes = 0;
+};
+
+bool operator==(const SubtreeSummary& lhs, const SubtreeSummary& rhs);
+bool operator!=(const SubtreeSummary& lhs, const SubtreeSummary& rhs);
+
 bool CheckValidTreeNodeSerialization(ftl::StringView data);
 
+// Encodes a tree node. |children_summaries| must either be empty, in which
+// case the node is encoded without summaries as in version 0 of the format,
+// or contain exactly one summary for each element of |children|.
 std::string EncodeNode(uint8_t level,
                        const std::vector<Entry>& entries,
-                       const std::vector<ObjectId>& children);
+                       const std::vector<ObjectId>& children,
+                       const std::vector<SubtreeSummary>& children_summaries);
 
+// Decodes a tree node. |children_summaries| is left empty if the node was
+// encoded without summaries.
 bool DecodeNode(ftl::StringView data,
                 uint8_t* level,
                 std::vector<Entry>* entries,
-                std::vector<ObjectId>* children);
+                std::vector<ObjectId>* children,
+                std::vector<SubtreeSummary>* children_summaries);
 
 }  // namespace storage
 
@@ -23,15 +23,18 @@ TEST(EncodingTest, EmptyData) {
   std::vector<Entry> entries;
   std::vector<ObjectId> children{""};
 
-  std::string bytes = EncodeNode(level, entries, children);
+  std::string bytes = EncodeNode(level, entries, children, {});
 
   uint8_t res_level;
   std::vector<Entry> res_entries;
   std::vector<ObjectId> res_children;
-  EXPECT_TRUE(DecodeNode(bytes, &res_level, &res_entries, &res_children));
+  std::vector<SubtreeSummary> res_summaries;
+  EXPECT_TRUE(DecodeNode(bytes, &res_level, &res_entries, &res_children,
+                         &res_summaries));
   EXPECT_EQ(level, res_level);
   EXPECT_EQ(entries, res_entries);
   EXPECT_EQ(children, res_children);
+  EXPECT_TRUE(res_summaries.empty());
 }
 
 TEST(EncodingTest, SingleEntry) {
@@ -41,15 +44,18 @@ TEST(EncodingTest, SingleEntry) {
   std::vector<ObjectId> children = {MakeObjectId("child_1"),
                                     MakeObjectId("child_2")};
 
-  std::string bytes = EncodeNode(level, entries, children);
+  std::string bytes = EncodeNode(level, entries, children, {});
 
   uint8_t res_level;
   std::vector<Entry> res_entries;
   std::vector<ObjectId> res_children;
-  EXPECT_TRUE(DecodeNode(bytes, &res_level, &res_entries, &res_children));
+  std::vector<SubtreeSummary> res_summaries;
+  EXPECT_TRUE(DecodeNode(bytes, &res_level, &res_entries, &res_children,
+                         &res_summaries));
   EXPECT_EQ(level, res_level);
   EXPECT_EQ(entries, res_entries);
   EXPECT_EQ(children, res_children);
+  EXPECT_TRUE(res_summaries.empty());
 }
 
 TEST(EncodingTest, MoreEntries) {
@@ -63,16 +69,19 @@ TEST(EncodingTest, MoreEntries) {
       MakeObjectId("child_1"), MakeObjectId("child_2"), MakeObjectId("child_3"),
       MakeObjectId("child_4"), MakeObjectId("child_5")};
 
-  std::string bytes = EncodeNode(level, entries, children);
+  std::string bytes = EncodeNode(level, entries, children, {});
 
   uint8_t res_level;
   std::vector<Entry> res_entries;
   std::vector<ObjectId> res_children;
-  EXPECT_TRUE(DecodeNode(bytes, &res_level, &res_entries, &res_children));
+  std::vector<SubtreeSummary> res_summaries;
+  EXPECT_TRUE(DecodeNode(bytes, &res_level, &res_entries, &res_children,
+                         &res_summaries));
   EXPECT_EQ(level, res_level);
   EXPECT_EQ(level, res_level);
   EXPECT_EQ(entries, res_entries);
   EXPECT_EQ(children, res_children);
+  EXPECT_TRUE(res_summaries.empty());
 }
 
 TEST(EncodingTest, ZeroByte) {
@@ -82,15 +91,60 @@ TEST(EncodingTest, ZeroByte) {
   std::vector<ObjectId> children = {MakeObjectId("ch\0ld_1"_s),
                                     MakeObjectId("child_\0"_s)};
 
-  std::string bytes = EncodeNode(level, entries, children);
+  std::string bytes = EncodeNode(level, entries, children, {});
 
   uint8_t res_level;
   std::vector<Entry> res_entries;
   std::vector<ObjectId> res_children;
-  EXPECT_TRUE(DecodeNode(bytes, &res_level, &res_entries, &res_children));
+  std::vector<SubtreeSummary> res_summaries;
+  EXPECT_TRUE(DecodeNode(bytes, &res_level, &res_entries, &res_children,
+                         &res_summaries));
   EXPECT_EQ(level, res_level);
   EXPECT_EQ(entries, res_entries);
   EXPECT_EQ(children, res_children);
+  EXPECT_TRUE(res_summaries.empty());
+}
+
+TEST(EncodingTest, Summaries) {
+  uint8_t level = 1u;
+  std::vector<Entry> entries = {
+      {"key1", MakeObjectId("abc"), KeyPriority::EAGER},
+      {"key2", MakeObjectId("def"), KeyPriority::LAZY}};
+  std::vector<ObjectId> children = {MakeObjectId("child_1"), "",
+                                    MakeObjectId("child_3")};
+  std::vector<SubtreeSummary> summaries(3);
+  summaries[0].entry_count = 12;
+  summaries[0].key_bytes = 60;
+  summaries[2].entry_count = 3;
+  summaries[2].key_bytes = 15;
+
+  std::string bytes = EncodeNode(level, entries, children, summaries);
+  EXPECT_TRUE(CheckValidTreeNodeSerialization(bytes));
+
+  uint8_t res_level;
+  std::vector<Entry> res_entries;
+  std::vector<ObjectId> res_children;
+  std::vector<SubtreeSummary> res_summaries;
+  EXPECT_TRUE(DecodeNode(bytes, &res_level, &res_entries, &res_children,
+                         &res_summaries));
+  EXPECT_EQ(level, res_level);
+  EXPECT_EQ(entries, res_entries);
+  EXPECT_EQ(children, res_children);
+  EXPECT_EQ(summaries, res_summaries);
+}
+
+TEST(EncodingTest, SummariesAreDeterministic) {
+  std::vector<Entry> entries = {
+      {"key", MakeObjectId("object_id"), KeyPriority::EAGER}};
+  std::vector<ObjectId> children = {MakeObjectId("child_1"), ""};
+  std::vector<SubtreeSummary> summaries(2);
+  summaries[0].entry_count = 1;
+  summaries[0].key_bytes = 4;
+
+  EXPECT_EQ(EncodeNode(0u, entries, children, summaries),
+            EncodeNode(0u, entries, children, summaries));
+  EXPECT_NE(EncodeNode(0u, entries, children, {}),
+            EncodeNode(0u, entries, children, summaries));
 }
 
 std::string ToString(flatbuffers::FlatBufferBuilder* builder) {
@@ -158,6 +212,25 @@ TEST(EncodingTest, Errors) {
               })),
       builder.CreateVectorOfStructs(children, 0)));
   EXPECT_FALSE(CheckValidTreeNodeSerialization(ToString(&builder)));
+
+  // A non-empty summary for an empty child.
+  SubtreeSummaryStorage summaries[1] = {SubtreeSummaryStorage(1, 1)};
+  builder.Clear();
+  builder.Finish(CreateTreeNodeStorage(
+      builder,
+      builder.CreateVector(std::vector<flatbuffers::Offset<EntryStorage>>()),
+      builder.CreateVectorOfStructs(children, 0), 0,
+      builder.CreateVectorOfStructs(summaries, 1)));
+  EXPECT_FALSE(CheckValidTreeNodeSerialization(ToString(&builder)));
+
+  // Summaries missing for some children.
+  builder.Clear();
+  builder.Finish(CreateTreeNodeStorage(
+      builder,
+      builder.CreateVector(std::vector<flatbuffers::Offset<EntryStorage>>()),
+      builder.CreateVectorOfStructs(children, 0), 0,
+      builder.CreateVectorOfStructs(summaries, 0)));
+  EXPECT_FALSE(CheckValidTreeNodeSerialization(ToString(&builder)));
 }
 
 }  // namespace
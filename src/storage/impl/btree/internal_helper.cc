@@ -21,5 +21,11 @@ size_t GetEntryOrChildIndex(const std::vector<Entry> entries,
   return lower - entries.begin();
 }
 
+std::string KeyAfter(ftl::StringView key) {
+  std::string result = key.ToString();
+  result.push_back('\0');
+  return result;
+}
+
 }  // namespace btree
 }  // namespace storage
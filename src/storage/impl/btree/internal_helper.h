@@ -5,6 +5,7 @@
 #ifndef APPS_LEDGER_SRC_STORAGE_IMPL_BTREE_INTERNAL_HELPER_H_
 #define APPS_LEDGER_SRC_STORAGE_IMPL_BTREE_INTERNAL_HELPER_H_
 
+#include <string>
 #include <vector>
 
 #include "apps/ledger/src/storage/public/types.h"
@@ -27,6 +28,9 @@ namespace btree {
 size_t GetEntryOrChildIndex(const std::vector<Entry> entries,
                             ftl::StringView key);
 
+// Returns the smallest key that is greater than |key|.
+std::string KeyAfter(ftl::StringView key);
+
 }  // namespace btree
 }  // namespace storage
 
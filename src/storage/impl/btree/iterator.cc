@@ -4,9 +4,12 @@
 
 #include "apps/ledger/src/storage/impl/btree/iterator.h"
 
-#include "apps/ledger/src/callback/waiter.h"
+#include <memory>
+#include <queue>
+
 #include "apps/ledger/src/storage/impl/btree/internal_helper.h"
 #include "lib/ftl/functional/make_copyable.h"
+#include "lib/ftl/memory/ref_counted.h"
 
 namespace storage {
 namespace btree {
@@ -33,6 +36,270 @@ Status ForEachEntryInternal(
   return Status::OK;
 }
 
+// Returns the smallest key that is greater than all keys starting with
+// |prefix|, or an empty string if there is no such key.
+std::string PrefixUpperBound(ftl::StringView prefix) {
+  std::string result = prefix.ToString();
+  while (!result.empty() && static_cast<uint8_t>(result.back()) == 0xff) {
+    result.pop_back();
+  }
+  if (!result.empty()) {
+    ++result.back();
+  }
+  return result;
+}
+
+// Computes in |summary| the summary of the child at position |index| of
+// |node|.
+Status GetChildSummary(SynchronousStorage* storage,
+                       const TreeNode& node,
+                       size_t index,
+                       SubtreeSummary* summary) {
+  if (node.HasSummaries()) {
+    *summary = node.GetChildSummary(index);
+    return Status::OK;
+  }
+  ObjectIdView child_id = node.GetChildId(index);
+  if (child_id.empty()) {
+    *summary = SubtreeSummary();
+    return Status::OK;
+  }
+  return GetSubtreeSummary(storage, child_id, summary);
+}
+
+// Computes in |rank| the number of entries of the tree rooted at |root_id|
+// whose key is strictly lower than |key|.
+Status GetRank(SynchronousStorage* storage,
+               ObjectIdView root_id,
+               ftl::StringView key,
+               uint64_t* rank) {
+  *rank = 0;
+  std::unique_ptr<const TreeNode> node;
+  RETURN_ON_ERROR(storage->TreeNodeFromId(root_id, &node));
+  for (;;) {
+    size_t index = GetEntryOrChildIndex(node->entries(), key);
+    SubtreeSummary summary;
+    for (size_t i = 0; i < index; ++i) {
+      RETURN_ON_ERROR(GetChildSummary(storage, *node, i, &summary));
+      *rank += summary.entry_count + 1;
+    }
+    if (index < node->entries().size() && node->entries()[index].key == key) {
+      // All entries of the child at |index| are lower than |key|.
+      RETURN_ON_ERROR(GetChildSummary(storage, *node, index, &summary));
+      *rank += summary.entry_count;
+      return Status::OK;
+    }
+    ObjectIdView child_id = node->GetChildId(index);
+    if (child_id.empty()) {
+      return Status::OK;
+    }
+    std::unique_ptr<const TreeNode> child;
+    RETURN_ON_ERROR(storage->TreeNodeFromId(child_id, &child));
+    node = std::move(child);
+  }
+}
+
+// Finds the key of the entry at position |rank| in the tree rooted at
+// |root_id|.
+Status GetKeyAtRank(SynchronousStorage* storage,
+                    ObjectIdView root_id,
+                    uint64_t rank,
+                    std::string* key) {
+  std::unique_ptr<const TreeNode> node;
+  RETURN_ON_ERROR(storage->TreeNodeFromId(root_id, &node));
+  for (;;) {
+    size_t index = 0;
+    for (;; ++index) {
+      SubtreeSummary summary;
+      RETURN_ON_ERROR(GetChildSummary(storage, *node, index, &summary));
+      if (rank < summary.entry_count) {
+        break;
+      }
+      rank -= summary.entry_count;
+      if (index == node->entries().size()) {
+        return Status::NOT_FOUND;
+      }
+      if (rank == 0) {
+        *key = node->entries()[index].key;
+        return Status::OK;
+      }
+      --rank;
+    }
+    // The entry is in the subtree rooted at the child at |index|.
+    std::unique_ptr<const TreeNode> child;
+    RETURN_ON_ERROR(storage->TreeNodeFromId(node->GetChildId(index), &child));
+    node = std::move(child);
+  }
+}
+
+Status CountEntriesInternal(SynchronousStorage* storage,
+                            ObjectIdView root_id,
+                            ftl::StringView prefix,
+                            uint64_t* count) {
+  uint64_t begin;
+  RETURN_ON_ERROR(GetRank(storage, root_id, prefix, &begin));
+  std::string prefix_end = PrefixUpperBound(prefix);
+  uint64_t end;
+  if (prefix_end.empty()) {
+    SubtreeSummary summary;
+    RETURN_ON_ERROR(GetSubtreeSummary(storage, root_id, &summary));
+    end = summary.entry_count;
+  } else {
+    RETURN_ON_ERROR(GetRank(storage, root_id, prefix_end, &end));
+  }
+  FTL_DCHECK(end >= begin);
+  *count = end - begin;
+  return Status::OK;
+}
+
+Status GetKeyAtOffsetInternal(SynchronousStorage* storage,
+                              ObjectIdView root_id,
+                              ftl::StringView min_key,
+                              uint64_t offset,
+                              std::string* key) {
+  uint64_t rank;
+  RETURN_ON_ERROR(GetRank(storage, root_id, min_key, &rank));
+  return GetKeyAtRank(storage, root_id, rank + offset, key);
+}
+
+// Downloads the tree nodes and the values with EAGER priority of a tree that
+// are not available locally. The tree is explored breadth first: the children
+// of all the nodes of a level are requested concurrently, with at most
+// |max_concurrent_requests| requests pending at any time. Tree nodes are
+// requested before values, so that values are fetched while the tree is still
+// being explored.
+class ObjectsFromSyncFetcher
+    : public ftl::RefCountedThreadSafe<ObjectsFromSyncFetcher> {
+ public:
+  inline static ftl::RefPtr<ObjectsFromSyncFetcher> Create(
+      PageStorage* page_storage,
+      size_t max_concurrent_requests) {
+    return AdoptRef(
+        new ObjectsFromSyncFetcher(page_storage, max_concurrent_requests));
+  }
+
+  void Start(ObjectIdView root_id, std::function<void(Status)> callback) {
+    FTL_DCHECK(!callback_);
+    callback_ = std::move(callback);
+    AddNode(root_id);
+    FetchNext();
+  }
+
+ private:
+  FRIEND_REF_COUNTED_THREAD_SAFE(ObjectsFromSyncFetcher);
+  ObjectsFromSyncFetcher(PageStorage* page_storage,
+                         size_t max_concurrent_requests)
+      : page_storage_(page_storage),
+        max_concurrent_requests_(max_concurrent_requests) {
+    FTL_DCHECK(max_concurrent_requests_ > 0);
+  }
+  ~ObjectsFromSyncFetcher() {}
+
+  void AddNode(ObjectIdView node_id) {
+    if (requested_ids_.insert(node_id.ToString()).second) {
+      pending_nodes_.push(node_id.ToString());
+    }
+  }
+
+  void AddValue(ObjectIdView value_id) {
+    if (requested_ids_.insert(value_id.ToString()).second) {
+      pending_values_.push(value_id.ToString());
+    }
+  }
+
+  // Sends requests until the limit of concurrent requests is reached or there
+  // is nothing left to request. Objects available locally are returned
+  // synchronously: this method is not reentrant to avoid recursing once per
+  // local object.
+  void FetchNext() {
+    if (fetching_) {
+      return;
+    }
+    fetching_ = true;
+    ftl::RefPtr<ObjectsFromSyncFetcher> self(this);
+    while (status_ == Status::OK &&
+           pending_requests_ < max_concurrent_requests_) {
+      if (!pending_nodes_.empty()) {
+        ObjectId node_id = std::move(pending_nodes_.front());
+        pending_nodes_.pop();
+        ++pending_requests_;
+        TreeNode::FromId(
+            page_storage_, node_id,
+            [self](Status status, std::unique_ptr<const TreeNode> node) {
+              self->OnNode(status, std::move(node));
+            });
+        continue;
+      }
+      if (!pending_values_.empty()) {
+        ObjectId value_id = std::move(pending_values_.front());
+        pending_values_.pop();
+        ++pending_requests_;
+        page_storage_->GetObject(
+            value_id, PageStorage::Location::NETWORK,
+            [self](Status status, std::unique_ptr<const Object> object) {
+              self->OnRequestDone(status);
+            });
+        continue;
+      }
+      break;
+    }
+    fetching_ = false;
+
+    if (pending_requests_ == 0 && callback_) {
+      FTL_DCHECK(status_ != Status::OK ||
+                 (pending_nodes_.empty() && pending_values_.empty()));
+      auto callback = std::move(callback_);
+      callback_ = nullptr;
+      callback(status_);
+    }
+  }
+
+  void OnNode(Status status, std::unique_ptr<const TreeNode> node) {
+    if (status == Status::OK) {
+      for (int i = 0; i <= node->GetKeyCount(); ++i) {
+        ObjectIdView child_id = node->GetChildId(i);
+        if (!child_id.empty()) {
+          AddNode(child_id);
+        }
+      }
+      for (int i = 0; i < node->GetKeyCount(); ++i) {
+        Entry entry;
+        status = node->GetEntry(i, &entry);
+        if (status != Status::OK) {
+          break;
+        }
+        if (entry.priority == KeyPriority::EAGER) {
+          AddValue(entry.object_id);
+        }
+      }
+    }
+    OnRequestDone(status);
+  }
+
+  void OnRequestDone(Status status) {
+    FTL_DCHECK(pending_requests_ > 0);
+    --pending_requests_;
+    if (status != Status::OK && status_ == Status::OK) {
+      status_ = status;
+    }
+    FetchNext();
+  }
+
+  PageStorage* const page_storage_;
+  const size_t max_concurrent_requests_;
+
+  std::function<void(Status)> callback_;
+  std::queue<ObjectId> pending_nodes_;
+  std::queue<ObjectId> pending_values_;
+  // Ids of all the objects already added to one of the pending queues.
+  std::set<ObjectId> requested_ids_;
+  size_t pending_requests_ = 0;
+  bool fetching_ = false;
+  Status status_ = Status::OK;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ObjectsFromSyncFetcher);
+};
+
 }  // namespace
 
 BTreeIterator::BTreeIterator(SynchronousStorage* storage) : storage_(storage) {}
@@ -163,6 +430,34 @@ Status BTreeIterator::Descend(ftl::StringView node_id) {
   return Status::OK;
 }
 
+Status GetSubtreeSummary(SynchronousStorage* storage,
+                         ObjectIdView node_id,
+                         SubtreeSummary* summary) {
+  std::unique_ptr<const TreeNode> node;
+  RETURN_ON_ERROR(storage->TreeNodeFromId(node_id, &node));
+  if (node->HasSummaries()) {
+    *summary = node->GetSummary();
+    return Status::OK;
+  }
+
+  SubtreeSummary result;
+  for (const auto& entry : node->entries()) {
+    ++result.entry_count;
+    result.key_bytes += entry.key.size();
+  }
+  for (const auto& child_id : node->children_ids()) {
+    if (child_id.empty()) {
+      continue;
+    }
+    SubtreeSummary child_summary;
+    RETURN_ON_ERROR(GetSubtreeSummary(storage, child_id, &child_summary));
+    result.entry_count += child_summary.entry_count;
+    result.key_bytes += child_summary.key_bytes;
+  }
+  *summary = result;
+  return Status::OK;
+}
+
 void GetObjectIds(coroutine::CoroutineService* coroutine_service,
                   PageStorage* page_storage,
                   ObjectIdView root_id,
@@ -189,32 +484,13 @@ void GetObjectIds(coroutine::CoroutineService* coroutine_service,
                std::move(on_done));
 }
 
-void GetObjectsFromSync(coroutine::CoroutineService* coroutine_service,
-                        PageStorage* page_storage,
+void GetObjectsFromSync(PageStorage* page_storage,
                         ObjectIdView root_id,
+                        size_t max_concurrent_requests,
                         std::function<void(Status)> callback) {
-  ftl::RefPtr<callback::Waiter<Status, std::unique_ptr<const Object>>> waiter_ =
-      callback::Waiter<Status, std::unique_ptr<const Object>>::Create(
-          Status::OK);
-  auto on_next = [page_storage, waiter_](EntryAndNodeId e) {
-    if (e.entry.priority == KeyPriority::EAGER) {
-      page_storage->GetObject(e.entry.object_id, PageStorage::Location::NETWORK,
-                              waiter_->NewCallback());
-    }
-    return true;
-  };
-  auto on_done = [ callback = std::move(callback), waiter_ ](Status status) {
-    if (status != Status::OK) {
-      callback(status);
-      return;
-    }
-    waiter_->Finalize([callback = std::move(callback)](
-        Status s, std::vector<std::unique_ptr<const Object>> objects) {
-      callback(s);
-    });
-  };
-  ForEachEntry(coroutine_service, page_storage, root_id, "", std::move(on_next),
-               std::move(on_done));
+  FTL_DCHECK(!root_id.empty());
+  ObjectsFromSyncFetcher::Create(page_storage, max_concurrent_requests)
+      ->Start(root_id, std::move(callback));
 }
 
 void ForEachEntry(coroutine::CoroutineService* coroutine_service,
@@ -224,14 +500,60 @@ void ForEachEntry(coroutine::CoroutineService* coroutine_service,
                   std::function<bool(EntryAndNodeId)> on_next,
                   std::function<void(Status)> on_done) {
   FTL_DCHECK(!root_id.empty());
-  coroutine_service->StartCoroutine([
-    page_storage, root_id, min_key = std::move(min_key),
-    on_next = std::move(on_next), on_done = std::move(on_done)
-  ](coroutine::CoroutineHandler * handler) {
-    SynchronousStorage storage(page_storage, handler);
+  // If the iteration is restarted in a coroutine, it resumes after the last
+  // entry sent to |on_next|.
+  auto resume_key = std::make_shared<std::string>(std::move(min_key));
+  RunSynchronouslyOrInCoroutine(
+      coroutine_service, page_storage,
+      [ root_id = root_id.ToString(), resume_key,
+        on_next = std::move(on_next) ](SynchronousStorage * storage) {
+        std::string min_key = *resume_key;
+        return ForEachEntryInternal(
+            storage, root_id, min_key,
+            [&resume_key, &on_next](EntryAndNodeId next) {
+              *resume_key = KeyAfter(next.entry.key);
+              return on_next(next);
+            });
+      },
+      std::move(on_done));
+}
 
-    on_done(ForEachEntryInternal(&storage, root_id, min_key, on_next));
-  });
+void CountEntries(coroutine::CoroutineService* coroutine_service,
+                  PageStorage* page_storage,
+                  ObjectIdView root_id,
+                  std::string prefix,
+                  std::function<void(Status, uint64_t)> callback) {
+  FTL_DCHECK(!root_id.empty());
+  auto count = std::make_shared<uint64_t>(0);
+  RunSynchronouslyOrInCoroutine(
+      coroutine_service, page_storage,
+      [ root_id = root_id.ToString(), prefix = std::move(prefix),
+        count ](SynchronousStorage * storage) {
+        return CountEntriesInternal(storage, root_id, prefix, count.get());
+      },
+      [ count, callback = std::move(callback) ](Status status) {
+        callback(status, *count);
+      });
+}
+
+void GetKeyAtOffset(coroutine::CoroutineService* coroutine_service,
+                    PageStorage* page_storage,
+                    ObjectIdView root_id,
+                    std::string min_key,
+                    uint64_t offset,
+                    std::function<void(Status, std::string)> callback) {
+  FTL_DCHECK(!root_id.empty());
+  auto key = std::make_shared<std::string>();
+  RunSynchronouslyOrInCoroutine(
+      coroutine_service, page_storage,
+      [ root_id = root_id.ToString(), min_key = std::move(min_key), offset,
+        key ](SynchronousStorage * storage) {
+        return GetKeyAtOffsetInternal(storage, root_id, min_key, offset,
+                                      key.get());
+      },
+      [ key, callback = std::move(callback) ](Status status) {
+        callback(status, std::move(*key));
+      });
 }
 
 }  // namespace btree
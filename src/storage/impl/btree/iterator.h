@@ -94,6 +94,13 @@ class BTreeIterator {
   FTL_DISALLOW_COPY_AND_ASSIGN(BTreeIterator);
 };
 
+// Computes in |summary| the summary of the subtree rooted at |node_id|. The
+// nodes of the subtree that were written without summaries are walked to
+// compute it.
+Status GetSubtreeSummary(SynchronousStorage* storage,
+                         ObjectIdView node_id,
+                         SubtreeSummary* summary);
+
 // Retrieves the ids of all objects in the BTree, i.e tree nodes and values of
 // entries in the tree. After a successfull call, |callback| will be called
 // with the set of results.
@@ -104,10 +111,11 @@ void GetObjectIds(coroutine::CoroutineService* coroutine_service,
 
 // Tries to download all tree nodes and values with EAGER priority that are not
 // locally available from sync. To do this PageStorage::GetObject is called for
-// all corresponding objects.
-void GetObjectsFromSync(coroutine::CoroutineService* coroutine_service,
-                        PageStorage* page_storage,
+// all corresponding objects. The tree is explored breadth first, with at most
+// |max_concurrent_requests| calls pending at any time.
+void GetObjectsFromSync(PageStorage* page_storage,
                         ObjectIdView root_id,
+                        size_t max_concurrent_requests,
                         std::function<void(Status)> callback);
 
 // Iterates through the nodes of the tree with the given root and calls
@@ -124,6 +132,27 @@ void ForEachEntry(coroutine::CoroutineService* coroutine_service,
                   std::function<bool(EntryAndNodeId)> on_next,
                   std::function<void(Status)> on_done);
 
+// Counts the entries of the tree with the given root whose key starts with
+// |prefix| and calls |callback| with the result. Only the nodes on the paths
+// to the bounds of the prefix range are read, unless the tree contains nodes
+// written without summaries.
+void CountEntries(coroutine::CoroutineService* coroutine_service,
+                  PageStorage* page_storage,
+                  ObjectIdView root_id,
+                  std::string prefix,
+                  std::function<void(Status, uint64_t)> callback);
+
+// Finds the key of the entry at position |offset| among the entries of the
+// tree with the given root whose key is equal to or greater than |min_key|,
+// and calls |callback| with the result. The status will be |NOT_FOUND| if
+// there are not enough such entries.
+void GetKeyAtOffset(coroutine::CoroutineService* coroutine_service,
+                    PageStorage* page_storage,
+                    ObjectIdView root_id,
+                    std::string min_key,
+                    uint64_t offset,
+                    std::function<void(Status, std::string)> callback);
+
 }  // namespace btree
 }  // namespace storage
 
@@ -4,19 +4,70 @@
 
 #include "apps/ledger/src/storage/impl/btree/synchronous_storage.h"
 
+#include <utility>
+
+#include "apps/ledger/src/callback/capture.h"
+#include "lib/ftl/memory/ref_counted.h"
+
 namespace storage {
 namespace btree {
 
+namespace {
+
+// Whether a call made without a coroutine is still waiting for its result.
+// Results delivered after the call was abandoned are dropped.
+class PendingCall : public ftl::RefCountedThreadSafe<PendingCall> {
+ public:
+  inline static ftl::RefPtr<PendingCall> Create() {
+    return AdoptRef(new PendingCall());
+  }
+
+  bool waiting = true;
+
+ private:
+  FRIEND_REF_COUNTED_THREAD_SAFE(PendingCall);
+  PendingCall() {}
+  ~PendingCall() {}
+};
+
+}  // namespace
+
 SynchronousStorage::SynchronousStorage(PageStorage* page_storage,
                                        coroutine::CoroutineHandler* handler)
     : page_storage_(page_storage), handler_(handler) {}
 
+template <typename A, typename... Args>
+bool SynchronousStorage::SyncCall(const A& async_call, Args*... parameters) {
+  if (handler_) {
+    return coroutine::SyncCall(handler_, async_call, parameters...);
+  }
+  if (blocked_) {
+    return true;
+  }
+
+  bool called = false;
+  auto pending_call = PendingCall::Create();
+  auto capture =
+      callback::Capture([&called] { called = true; }, parameters...);
+  async_call([pending_call, capture](auto&&... results) mutable {
+    if (!pending_call->waiting) {
+      return;
+    }
+    capture(std::forward<decltype(results)>(results)...);
+  });
+  pending_call->waiting = false;
+  if (!called) {
+    blocked_ = true;
+    return true;
+  }
+  return false;
+}
+
 Status SynchronousStorage::TreeNodeFromId(
     ObjectIdView object_id,
     std::unique_ptr<const TreeNode>* result) {
   Status status;
-  if (coroutine::SyncCall(
-          handler_,
+  if (SyncCall(
           [this, &object_id](
               std::function<void(Status, std::unique_ptr<const TreeNode>)>
                   callback) {
@@ -38,8 +89,7 @@ Status SynchronousStorage::TreeNodesFromIds(
     TreeNode::FromId(page_storage_, object_id, waiter->NewCallback());
   }
   Status status;
-  if (coroutine::SyncCall(
-          handler_,
+  if (SyncCall(
           [waiter](std::function<void(
                        Status, std::vector<std::unique_ptr<const TreeNode>>)>
                        callback) { waiter->Finalize(std::move(callback)); },
@@ -53,20 +103,43 @@ Status SynchronousStorage::TreeNodeFromEntries(
     uint8_t level,
     const std::vector<Entry>& entries,
     const std::vector<ObjectId>& children,
+    const std::vector<SubtreeSummary>& children_summaries,
     ObjectId* result) {
   Status status;
-  if (coroutine::SyncCall(handler_,
-                          [this, level, &entries, &children](
-                              std::function<void(Status, ObjectId)> callback) {
-                            TreeNode::FromEntries(page_storage_, level, entries,
-                                                  children,
-                                                  std::move(callback));
-                          },
-                          &status, result)) {
+  if (SyncCall(
+          [this, level, &entries, &children, &children_summaries](
+              std::function<void(Status, ObjectId)> callback) {
+            TreeNode::FromEntries(page_storage_, level, entries, children,
+                                  children_summaries, std::move(callback));
+          },
+          &status, result)) {
     return Status::ILLEGAL_STATE;
   }
   return status;
 }
 
+void RunSynchronouslyOrInCoroutine(
+    coroutine::CoroutineService* coroutine_service,
+    PageStorage* page_storage,
+    std::function<Status(SynchronousStorage*)> algorithm,
+    std::function<void(Status)> on_done) {
+  {
+    SynchronousStorage storage(page_storage, nullptr);
+    Status status = algorithm(&storage);
+    if (!storage.blocked()) {
+      on_done(status);
+      return;
+    }
+  }
+
+  coroutine_service->StartCoroutine([
+    page_storage, algorithm = std::move(algorithm), on_done = std::move(on_done)
+  ](coroutine::CoroutineHandler * handler) {
+    SynchronousStorage storage(page_storage, handler);
+
+    on_done(algorithm(&storage));
+  });
+}
+
 }  // namespace btree
 }  // namespace storage
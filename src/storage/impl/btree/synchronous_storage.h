@@ -5,6 +5,7 @@
 #ifndef APPS_LEDGER_SRC_STORAGE_IMPL_BTREE_SYNCHRONOUS_STORAGE_H_
 #define APPS_LEDGER_SRC_STORAGE_IMPL_BTREE_SYNCHRONOUS_STORAGE_H_
 
+#include <functional>
 #include <memory>
 #include <vector>
 
@@ -19,6 +20,11 @@ namespace btree {
 
 // Wrapper for TreeNode and PageStorage that uses coroutines to make
 // asynchronous calls look like synchronous ones.
+//
+// If |handler| is null, the storage runs on the caller's stack and can only
+// serve the calls that complete synchronously, such as reading local objects.
+// A call that would block fails with |ILLEGAL_STATE| and marks the storage as
+// blocked: the computation must then be restarted in a coroutine.
 class SynchronousStorage {
  public:
   SynchronousStorage(PageStorage* page_storage,
@@ -27,24 +33,49 @@ class SynchronousStorage {
   PageStorage* page_storage() { return page_storage_; }
   coroutine::CoroutineHandler* handler() { return handler_; }
 
+  // Returns whether a call failed because it could not complete without a
+  // coroutine.
+  bool blocked() const { return blocked_; }
+
   Status TreeNodeFromId(ObjectIdView object_id,
                         std::unique_ptr<const TreeNode>* result);
 
   Status TreeNodesFromIds(std::vector<ObjectIdView> object_ids,
                           std::vector<std::unique_ptr<const TreeNode>>* result);
 
-  Status TreeNodeFromEntries(uint8_t level,
-                             const std::vector<Entry>& entries,
-                             const std::vector<ObjectId>& children,
-                             ObjectId* result);
+  Status TreeNodeFromEntries(
+      uint8_t level,
+      const std::vector<Entry>& entries,
+      const std::vector<ObjectId>& children,
+      const std::vector<SubtreeSummary>& children_summaries,
+      ObjectId* result);
 
  private:
+  // Equivalent of coroutine::SyncCall() that also supports running without a
+  // handler. Returns true if the computation must unwind its stack, either
+  // because the coroutine was interrupted or because the call did not
+  // complete synchronously.
+  template <typename A, typename... Args>
+  bool SyncCall(const A& async_call, Args*... parameters);
+
   PageStorage* page_storage_;
   coroutine::CoroutineHandler* handler_;
+  bool blocked_ = false;
 
   FTL_DISALLOW_COPY_AND_ASSIGN(SynchronousStorage);
 };
 
+// Runs |algorithm| on the caller's stack and calls |on_done| with its result.
+// If a call of |algorithm| to the storage would block, e.g. because a tree node
+// must be fetched from the network, the run is abandoned and |algorithm| is
+// run again from the start in a coroutine. |algorithm| must support being
+// restarted: the effects of the abandoned run are not rolled back.
+void RunSynchronouslyOrInCoroutine(
+    coroutine::CoroutineService* coroutine_service,
+    PageStorage* page_storage,
+    std::function<Status(SynchronousStorage*)> algorithm,
+    std::function<void(Status)> on_done);
+
 }  // namespace btree
 }  // namespace storage
 
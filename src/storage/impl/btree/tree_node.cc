@@ -22,13 +22,17 @@ TreeNode::TreeNode(PageStorage* page_storage,
                    std::string id,
                    uint8_t level,
                    std::vector<Entry> entries,
-                   std::vector<ObjectId> children)
+                   std::vector<ObjectId> children,
+                   std::vector<SubtreeSummary> children_summaries)
     : page_storage_(page_storage),
       id_(std::move(id)),
       level_(level),
       entries_(entries),
-      children_(children) {
+      children_(children),
+      children_summaries_(std::move(children_summaries)) {
   FTL_DCHECK(entries_.size() + 1 == children_.size());
+  FTL_DCHECK(children_summaries_.empty() ||
+             children_summaries_.size() == children_.size());
 }
 
 TreeNode::~TreeNode() {}
@@ -54,16 +58,19 @@ void TreeNode::FromId(
 void TreeNode::Empty(PageStorage* page_storage,
                      std::function<void(Status, ObjectId)> callback) {
   FromEntries(page_storage, 0u, std::vector<Entry>(), std::vector<ObjectId>(1),
-              std::move(callback));
+              std::vector<SubtreeSummary>(1), std::move(callback));
 }
 
-void TreeNode::FromEntries(PageStorage* page_storage,
-                           uint8_t level,
-                           const std::vector<Entry>& entries,
-                           const std::vector<ObjectId>& children,
-                           std::function<void(Status, ObjectId)> callback) {
+void TreeNode::FromEntries(
+    PageStorage* page_storage,
+    uint8_t level,
+    const std::vector<Entry>& entries,
+    const std::vector<ObjectId>& children,
+    const std::vector<SubtreeSummary>& children_summaries,
+    std::function<void(Status, ObjectId)> callback) {
   FTL_DCHECK(entries.size() + 1 == children.size());
-  std::string encoding = storage::EncodeNode(level, entries, children);
+  std::string encoding =
+      storage::EncodeNode(level, entries, children, children_summaries);
   page_storage->AddObjectFromLocal(mtl::WriteStringToSocket(encoding),
                                    encoding.length(), std::move(callback));
 }
@@ -118,6 +125,26 @@ Status TreeNode::FindKeyOrChild(convert::ExtendedStringView key,
   return Status::NOT_FOUND;
 }
 
+const SubtreeSummary& TreeNode::GetChildSummary(int index) const {
+  FTL_DCHECK(HasSummaries());
+  FTL_DCHECK(index >= 0 && index <= GetKeyCount());
+  return children_summaries_[index];
+}
+
+SubtreeSummary TreeNode::GetSummary() const {
+  FTL_DCHECK(HasSummaries());
+  SubtreeSummary summary;
+  for (const auto& entry : entries_) {
+    ++summary.entry_count;
+    summary.key_bytes += entry.key.size();
+  }
+  for (const auto& child_summary : children_summaries_) {
+    summary.entry_count += child_summary.entry_count;
+    summary.key_bytes += child_summary.key_bytes;
+  }
+  return summary;
+}
+
 const ObjectId& TreeNode::GetId() const {
   return id_;
 }
@@ -133,11 +160,13 @@ Status TreeNode::FromObject(PageStorage* page_storage,
   uint8_t level;
   std::vector<Entry> entries;
   std::vector<ObjectId> children;
-  if (!DecodeNode(json, &level, &entries, &children)) {
+  std::vector<SubtreeSummary> children_summaries;
+  if (!DecodeNode(json, &level, &entries, &children, &children_summaries)) {
     return Status::FORMAT_ERROR;
   }
   node->reset(new TreeNode(page_storage, object->GetId(), level,
-                           std::move(entries), std::move(children)));
+                           std::move(entries), std::move(children),
+                           std::move(children_summaries)));
   return Status::OK;
 }
 
@@ -10,6 +10,7 @@
 #include <vector>
 
 #include "apps/ledger/src/convert/convert.h"
+#include "apps/ledger/src/storage/impl/btree/encoding.h"
 #include "apps/ledger/src/storage/public/object.h"
 #include "apps/ledger/src/storage/public/page_storage.h"
 #include "apps/ledger/src/storage/public/types.h"
@@ -32,10 +33,14 @@ class TreeNode {
   // id in the children's vector indicates that there is no child in that
   // index. The |callback| will be called with the success or error status and
   // the id of the new node. It is expected that |children| = |entries| + 1.
+  // |children_summaries| must either contain the summary of the subtree rooted
+  // at each child, or be empty, in which case the node is stored without
+  // summaries.
   static void FromEntries(PageStorage* page_storage,
                           uint8_t level,
                           const std::vector<Entry>& entries,
                           const std::vector<ObjectId>& children,
+                          const std::vector<SubtreeSummary>& children_summaries,
                           std::function<void(Status, ObjectId)> callback);
 
   // Creates an empty node, i.e. a TreeNode with no entries and an empty child
@@ -69,6 +74,19 @@ class TreeNode {
   // might be found.
   Status FindKeyOrChild(convert::ExtendedStringView key, int* index) const;
 
+  // Returns whether this node stores the summaries of its subtrees. Nodes
+  // written before version 1 of the format do not.
+  bool HasSummaries() const { return !children_summaries_.empty(); }
+
+  // Returns the summary of the subtree rooted at the child at position
+  // |index|. |index| has to be in [0, GetKeyCount()], and |HasSummaries()|
+  // must be true.
+  const SubtreeSummary& GetChildSummary(int index) const;
+
+  // Returns the summary of the subtree rooted at this node. |HasSummaries()|
+  // must be true.
+  SubtreeSummary GetSummary() const;
+
   const ObjectId& GetId() const;
 
   uint8_t level() const { return level_; }
@@ -82,7 +100,8 @@ class TreeNode {
            std::string id,
            uint8_t level,
            std::vector<Entry> entries,
-           std::vector<ObjectId> children);
+           std::vector<ObjectId> children,
+           std::vector<SubtreeSummary> children_summaries);
 
   // Creates a |TreeNode| object for an existing |object| and stores it in the
   // given |node|.
@@ -95,6 +114,7 @@ class TreeNode {
   const uint8_t level_;
   const std::vector<Entry> entries_;
   const std::vector<ObjectId> children_;
+  const std::vector<SubtreeSummary> children_summaries_;
 };
 
 }  // namespace storage
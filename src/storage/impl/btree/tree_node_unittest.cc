@@ -158,7 +158,9 @@ TEST_F(TreeNodeTest, Serialization) {
   uint8_t level;
   std::vector<Entry> parsed_entries;
   std::vector<ObjectId> parsed_children;
-  EXPECT_TRUE(DecodeNode(data, &level, &parsed_entries, &parsed_children));
+  std::vector<SubtreeSummary> parsed_summaries;
+  EXPECT_TRUE(DecodeNode(data, &level, &parsed_entries, &parsed_children,
+                         &parsed_summaries));
   EXPECT_EQ(entries, parsed_entries);
   EXPECT_EQ(children, parsed_children);
 }
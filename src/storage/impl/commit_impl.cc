@@ -150,11 +150,19 @@ std::unique_ptr<Commit> CommitImpl::FromContentAndParents(
                const std::unique_ptr<const Commit>& c2) {
               return c1->GetId() < c2->GetId();
             });
-  // Compute timestamp.
-  struct timeval tv;
-  gettimeofday(&tv, NULL);
-  int64_t timestamp = static_cast<int64_t>(tv.tv_sec) * 1000000000L +
-                      static_cast<int64_t>(tv.tv_usec) * 1000L;
+  // Compute timestamp. A merge commit is made just newer than its most recent
+  // parent, so that it is deterministic and never ties with a parent.
+  int64_t timestamp;
+  if (parent_commits.size() == 2) {
+    timestamp = std::max(parent_commits[0]->GetTimestamp(),
+                         parent_commits[1]->GetTimestamp()) +
+                1;
+  } else {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    timestamp = static_cast<int64_t>(tv.tv_sec) * 1000000000L +
+                static_cast<int64_t>(tv.tv_usec) * 1000L;
+  }
 
   std::string storage_bytes = SerializeCommit(
       generation, timestamp, root_node_id, std::move(parent_commits));
@@ -27,6 +27,10 @@ class CommitImpl : public Commit {
       std::unique_ptr<const Commit> left,
       std::unique_ptr<const Commit> right);
 
+  // Factory method for creating a new commit with the given content and
+  // parents. The timestamp of a merge commit only depends on its parents, so
+  // that merging the same parents into the same content always produces the
+  // same commit, whichever device does the merge.
   static std::unique_ptr<Commit> FromContentAndParents(
       PageStorage* page_storage,
       ObjectIdView root_node_id,
@@ -4,6 +4,8 @@
 
 #include "apps/ledger/src/storage/impl/commit_impl.h"
 
+#include <algorithm>
+
 #include "apps/ledger/src/glue/crypto/rand.h"
 #include "apps/ledger/src/storage/fake/fake_page_storage.h"
 #include "apps/ledger/src/storage/public/constants.h"
@@ -64,6 +66,32 @@ TEST_F(CommitImplTest, CommitStorageBytes) {
   EXPECT_TRUE(CheckCommitStorageBytes(commit2));
 }
 
+TEST_F(CommitImplTest, MergeCommitIsDeterministic) {
+  ObjectId root_node_id = RandomId(kObjectIdSize);
+  std::unique_ptr<const Commit> parent1 =
+      std::make_unique<test::CommitRandomImpl>();
+  std::unique_ptr<const Commit> parent2 =
+      std::make_unique<test::CommitRandomImpl>();
+
+  std::vector<std::unique_ptr<const Commit>> parents;
+  parents.push_back(parent1->Clone());
+  parents.push_back(parent2->Clone());
+  std::unique_ptr<Commit> commit = CommitImpl::FromContentAndParents(
+      &page_storage_, root_node_id, std::move(parents));
+
+  // Merging the same parents, in any order, into the same content gives the
+  // same commit.
+  parents = std::vector<std::unique_ptr<const Commit>>();
+  parents.push_back(parent2->Clone());
+  parents.push_back(parent1->Clone());
+  std::unique_ptr<Commit> other_commit = CommitImpl::FromContentAndParents(
+      &page_storage_, root_node_id, std::move(parents));
+
+  EXPECT_TRUE(CheckCommitEquals(*commit, *other_commit));
+  EXPECT_EQ(std::max(parent1->GetTimestamp(), parent2->GetTimestamp()) + 1,
+            commit->GetTimestamp());
+}
+
 TEST_F(CommitImplTest, CloneCommit) {
   ObjectId root_node_id = RandomId(kObjectIdSize);
 
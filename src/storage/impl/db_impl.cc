@@ -14,6 +14,7 @@
 #include "lib/ftl/files/directory.h"
 #include "lib/ftl/strings/concatenate.h"
 #include "lib/ftl/strings/string_number_conversions.h"
+#include "lib/ftl/time/time_point.h"
 
 namespace storage {
 
@@ -39,6 +40,12 @@ const char kJournalLazyEntry = 'L';
 const char kJournalEagerEntry = 'E';
 const size_t kJournalEntryAddPrefixSize = 2;
 
+// Size of the LevelDB block cache of each page, the default of LevelDB.
+const size_t kBlockCacheSize = 8 * 1024 * 1024;
+// Reads fill the block cache: the memory used by LevelDB is sampled every
+// |kReadsPerMemoryUpdate| reads, in addition to after every write.
+const int kReadsPerMemoryUpdate = 64;
+
 constexpr ftl::StringView kUnsyncedCommitPrefix = "unsynced/commits/";
 constexpr ftl::StringView kUnsyncedObjectPrefix = "unsynced/objects/";
 
@@ -200,15 +207,32 @@ class BatchImpl : public DB::Batch {
 
 DbImpl::DbImpl(coroutine::CoroutineService* coroutine_service,
                PageStorageImpl* page_storage,
-               std::string db_path)
+               std::string db_path,
+               metrics::MetricsRegistry* metrics)
     : coroutine_service_(coroutine_service),
       page_storage_(page_storage),
-      db_path_(db_path) {
+      db_path_(db_path),
+      reads_(metrics::OrUnreported(metrics)->GetCounter("db_reads")),
+      scans_(metrics::OrUnreported(metrics)->GetCounter("db_scans")),
+      writes_(metrics::OrUnreported(metrics)->GetCounter("db_writes")),
+      batches_(metrics::OrUnreported(metrics)->GetCounter("db_batches")),
+      batch_latency_(
+          metrics::OrUnreported(metrics)->GetHistogram("db_batch_latency")),
+      memory_budget_(metrics::OrUnreported(metrics)->memory_budget()),
+      leveldb_memory_(metrics::OrUnreported(metrics),
+                      "memory_leveldb_bytes") {
   FTL_DCHECK(page_storage);
+  if (memory_budget_) {
+    memory_budget_->AddTrimmable(this);
+  }
 }
 
 DbImpl::~DbImpl() {
   FTL_DCHECK(!batch_);
+  if (memory_budget_) {
+    memory_budget_->RemoveTrimmable(this);
+  }
+  leveldb_memory_.Add(-leveldb_memory_usage_);
 }
 
 Status DbImpl::Init() {
@@ -217,8 +241,10 @@ Status DbImpl::Init() {
     return Status::INTERNAL_IO_ERROR;
   }
   leveldb::DB* db = nullptr;
+  block_cache_.reset(leveldb::NewLRUCache(kBlockCacheSize));
   leveldb::Options options;
   options.create_if_missing = true;
+  options.block_cache = block_cache_.get();
   leveldb::Status status = leveldb::DB::Open(options, db_path_, &db);
   if (!status.ok()) {
     FTL_LOG(ERROR) << "Failed to open ledger at " << db_path_
@@ -226,6 +252,7 @@ Status DbImpl::Init() {
     return Status::INTERNAL_IO_ERROR;
   }
   db_.reset(db);
+  UpdateMemoryUsage();
   return Status::OK;
 }
 
@@ -235,7 +262,11 @@ std::unique_ptr<DB::Batch> DbImpl::StartBatch() {
   return std::make_unique<BatchImpl>([this](bool execute) {
     std::unique_ptr<leveldb::WriteBatch> batch = std::move(batch_);
     if (execute) {
+      batches_->Increment();
+      ftl::TimePoint start = ftl::TimePoint::Now();
       leveldb::Status status = db_->Write(write_options_, batch.get());
+      batch_latency_->Record(ftl::TimePoint::Now() - start);
+      UpdateMemoryUsage();
       if (!status.ok()) {
         FTL_LOG(ERROR) << "Fail to execute batch with status: "
                        << status.ToString();
@@ -358,6 +389,7 @@ Status DbImpl::GetJournalValue(const JournalId& journal_id,
 Status DbImpl::GetJournalEntries(
     const JournalId& journal_id,
     std::unique_ptr<Iterator<const EntryChange>>* entries) {
+  scans_->Increment();
   std::unique_ptr<leveldb::Iterator> it(db_->NewIterator(read_options_));
   std::string prefix = GetJournalEntryPrefixFor(journal_id);
   it->Seek(prefix);
@@ -468,8 +500,17 @@ Status DbImpl::GetSyncMetadata(std::string* sync_state) {
   return Get(kSyncMetadata, sync_state);
 }
 
+void DbImpl::Trim() {
+  if (!db_) {
+    return;
+  }
+  block_cache_->Prune();
+  UpdateMemoryUsage();
+}
+
 Status DbImpl::GetByPrefix(const leveldb::Slice& prefix,
                            std::vector<std::string>* key_suffixes) {
+  scans_->Increment();
   std::vector<std::string> result;
   std::unique_ptr<leveldb::Iterator> it(db_->NewIterator(read_options_));
   for (it->Seek(prefix); it->Valid() && it->key().starts_with(prefix);
@@ -488,6 +529,7 @@ Status DbImpl::GetByPrefix(const leveldb::Slice& prefix,
 Status DbImpl::GetEntriesByPrefix(
     const leveldb::Slice& prefix,
     std::vector<std::pair<std::string, std::string>>* key_value_pairs) {
+  scans_->Increment();
   std::vector<std::pair<std::string, std::string>> result;
   std::unique_ptr<leveldb::Iterator> it(db_->NewIterator(read_options_));
   for (it->Seek(prefix); it->Valid() && it->key().starts_with(prefix);
@@ -505,6 +547,7 @@ Status DbImpl::GetEntriesByPrefix(
 }
 
 Status DbImpl::DeleteByPrefix(const leveldb::Slice& prefix) {
+  scans_->Increment();
   std::unique_ptr<leveldb::Iterator> it(db_->NewIterator(read_options_));
   for (it->Seek(prefix); it->Valid() && it->key().starts_with(prefix);
        it->Next()) {
@@ -514,23 +557,47 @@ Status DbImpl::DeleteByPrefix(const leveldb::Slice& prefix) {
 }
 
 Status DbImpl::Get(convert::ExtendedStringView key, std::string* value) {
-  return ConvertStatus(db_->Get(read_options_, key, value));
+  reads_->Increment();
+  Status status = ConvertStatus(db_->Get(read_options_, key, value));
+  if (++reads_since_memory_update_ >= kReadsPerMemoryUpdate) {
+    UpdateMemoryUsage();
+  }
+  return status;
 }
 
 Status DbImpl::Put(convert::ExtendedStringView key, ftl::StringView value) {
+  writes_->Increment();
   if (batch_) {
     batch_->Put(key, convert::ToSlice(value));
     return Status::OK;
   }
-  return ConvertStatus(db_->Put(write_options_, key, convert::ToSlice(value)));
+  Status status =
+      ConvertStatus(db_->Put(write_options_, key, convert::ToSlice(value)));
+  UpdateMemoryUsage();
+  return status;
 }
 
 Status DbImpl::Delete(convert::ExtendedStringView key) {
+  writes_->Increment();
   if (batch_) {
     batch_->Delete(key);
     return Status::OK;
   }
-  return ConvertStatus(db_->Delete(write_options_, key));
+  Status status = ConvertStatus(db_->Delete(write_options_, key));
+  UpdateMemoryUsage();
+  return status;
+}
+
+void DbImpl::UpdateMemoryUsage() {
+  reads_since_memory_update_ = 0;
+  std::string property;
+  int64_t usage;
+  if (!db_->GetProperty("leveldb.approximate-memory-usage", &property) ||
+      !ftl::StringToNumberWithError(property, &usage)) {
+    return;
+  }
+  leveldb_memory_.Add(usage - leveldb_memory_usage_);
+  leveldb_memory_usage_ = usage;
 }
 
 }  // namespace storage
@@ -8,8 +8,11 @@
 #include <utility>
 
 #include "apps/ledger/src/coroutine/coroutine.h"
+#include "apps/ledger/src/metrics/memory_budget.h"
+#include "apps/ledger/src/metrics/metrics_registry.h"
 #include "apps/ledger/src/storage/impl/db.h"
 
+#include "leveldb/cache.h"
 #include "leveldb/db.h"
 #include "leveldb/write_batch.h"
 
@@ -17,11 +20,16 @@ namespace storage {
 
 class PageStorageImpl;
 
-class DbImpl : public DB {
+// Implementation of DB backed by LevelDB. The number of LevelDB operations, the
+// latency of batch writes and the memory used by LevelDB are recorded in
+// |metrics|, if not null. The block cache of the database is emptied when the
+// memory budget of |metrics| is exceeded.
+class DbImpl : public DB, public metrics::MemoryBudget::Trimmable {
  public:
   DbImpl(coroutine::CoroutineService* coroutine_service,
          PageStorageImpl* page_storage,
-         std::string db_path);
+         std::string db_path,
+         metrics::MetricsRegistry* metrics = nullptr);
   ~DbImpl() override;
 
   Status Init() override;
@@ -78,6 +86,9 @@ class DbImpl : public DB {
   Status SetSyncMetadata(ftl::StringView sync_state) override;
   Status GetSyncMetadata(std::string* sync_state) override;
 
+  // metrics::MemoryBudget::Trimmable:
+  void Trim() override;
+
  private:
   Status GetByPrefix(const leveldb::Slice& prefix,
                      std::vector<std::string>* key_suffixes);
@@ -88,16 +99,32 @@ class DbImpl : public DB {
   Status Get(convert::ExtendedStringView key, std::string* value);
   Status Put(convert::ExtendedStringView key, ftl::StringView value);
   Status Delete(convert::ExtendedStringView key);
+  // Updates the memory account of the database with the memory currently used
+  // by LevelDB.
+  void UpdateMemoryUsage();
 
   coroutine::CoroutineService* const coroutine_service_;
   PageStorageImpl* const page_storage_;
   const std::string db_path_;
+  // The block cache must outlive |db_|.
+  std::unique_ptr<leveldb::Cache> block_cache_;
   std::unique_ptr<leveldb::DB> db_;
 
   const leveldb::WriteOptions write_options_;
   const leveldb::ReadOptions read_options_;
 
   std::unique_ptr<leveldb::WriteBatch> batch_;
+
+  metrics::Counter* const reads_;
+  metrics::Counter* const scans_;
+  metrics::Counter* const writes_;
+  metrics::Counter* const batches_;
+  metrics::Histogram* const batch_latency_;
+  metrics::MemoryBudget* const memory_budget_;
+  const metrics::MemoryAccount leveldb_memory_;
+  int64_t leveldb_memory_usage_ = 0;
+  // Number of reads since the memory usage was last updated.
+  int reads_since_memory_update_ = 0;
 };
 
 }  // namespace storage
@@ -4,14 +4,17 @@
 
 #include "apps/ledger/src/storage/impl/journal_db_impl.h"
 
+#include <algorithm>
 #include <functional>
 #include <string>
 
+#include "apps/ledger/src/callback/trace_flow.h"
 #include "apps/ledger/src/callback/waiter.h"
 #include "apps/ledger/src/storage/impl/btree/builder.h"
 #include "apps/ledger/src/storage/impl/commit_impl.h"
 #include "apps/ledger/src/storage/impl/db.h"
 #include "apps/ledger/src/storage/public/commit.h"
+#include "apps/tracing/lib/trace/event.h"
 #include "lib/ftl/functional/make_copyable.h"
 
 namespace storage {
@@ -29,7 +32,8 @@ JournalDBImpl::JournalDBImpl(JournalType type,
       id_(id),
       base_(base),
       valid_(true),
-      failed_operation_(false) {}
+      failed_operation_(false),
+      trace_flow_id_(TRACE_NONCE()) {}
 
 JournalDBImpl::~JournalDBImpl() {
   // Log a warning if the journal was not committed or rolled back.
@@ -143,6 +147,59 @@ void JournalDBImpl::GetParents(
   waiter->Finalize(std::move(callback));
 }
 
+void JournalDBImpl::GetExistingMerge(
+    std::function<void(Status, std::unique_ptr<const storage::Commit>)>
+        callback) {
+  FTL_DCHECK(other_);
+  std::vector<CommitId> heads;
+  Status status = page_storage_->GetHeadCommitIds(&heads);
+  if (status != Status::OK) {
+    callback(status, nullptr);
+    return;
+  }
+  // The parents of a commit stop being heads when the commit is added, so a
+  // merge of |base_| and |other_| can only exist if one of them is no longer a
+  // head. Otherwise, there is no need to look further.
+  bool parents_are_heads = true;
+  for (const CommitId& parent_id : {base_, *other_}) {
+    if (std::find(heads.begin(), heads.end(), parent_id) == heads.end()) {
+      parents_are_heads = false;
+    }
+  }
+  if (parents_are_heads) {
+    callback(Status::OK, nullptr);
+    return;
+  }
+
+  auto waiter =
+      callback::Waiter<Status, std::unique_ptr<const storage::Commit>>::Create(
+          Status::OK);
+  for (const CommitId& head_id : heads) {
+    if (head_id != base_ && head_id != *other_) {
+      page_storage_->GetCommit(head_id, waiter->NewCallback());
+    }
+  }
+  waiter->Finalize([
+    base = base_, other = *other_, callback = std::move(callback)
+  ](Status status,
+      std::vector<std::unique_ptr<const storage::Commit>> commits) {
+    if (status != Status::OK) {
+      callback(status, nullptr);
+      return;
+    }
+    for (auto& head : commits) {
+      std::vector<CommitIdView> parent_ids = head->GetParentIds();
+      if (parent_ids.size() == 2 &&
+          ((parent_ids[0] == base && parent_ids[1] == other) ||
+           (parent_ids[0] == other && parent_ids[1] == base))) {
+        callback(Status::OK, std::move(head));
+        return;
+      }
+    }
+    callback(Status::OK, nullptr);
+  });
+}
+
 Status JournalDBImpl::ClearCommittedJournal(
     std::unordered_set<ObjectId> new_nodes) {
   // Mark objects as unsynced in a single batch.
@@ -179,11 +236,45 @@ Status JournalDBImpl::ClearCommittedJournal(
 void JournalDBImpl::Commit(
     std::function<void(Status, std::unique_ptr<const storage::Commit>)>
         callback) {
+  TRACE_DURATION("ledger", "journal_commit");
   if (!valid_ || (type_ == JournalType::EXPLICIT && failed_operation_)) {
     callback(Status::ILLEGAL_STATE, nullptr);
     return;
   }
+  // Links the request to commit the journal to its result, which is returned
+  // once the tree of the journal entries is built.
+  TRACE_FLOW_BEGIN("ledger", "journal_commit", trace_flow_id_);
+  callback = [
+    trace_flow_id = trace_flow_id_, callback = std::move(callback)
+  ](Status status, std::unique_ptr<const storage::Commit> commit) {
+    TRACE_FLOW_END("ledger", "journal_commit", trace_flow_id);
+    callback(status, std::move(commit));
+  };
+
+  if (!other_) {
+    CreateCommit(std::move(callback));
+    return;
+  }
+  // Another device may have merged the same heads, and its merge been
+  // received from sync while this one was computed. Adopt that merge rather
+  // than adding a second commit with the same parents.
+  GetExistingMerge([ this, callback = std::move(callback) ](
+      Status status, std::unique_ptr<const storage::Commit> merge) {
+    if (status != Status::OK) {
+      callback(status, nullptr);
+      return;
+    }
+    if (merge) {
+      callback(Rollback(), std::move(merge));
+      return;
+    }
+    CreateCommit(callback);
+  });
+}
 
+void JournalDBImpl::CreateCommit(
+    std::function<void(Status, std::unique_ptr<const storage::Commit>)>
+        callback) {
   GetParents([ this, callback = std::move(callback) ](
       Status status,
       std::vector<std::unique_ptr<const storage::Commit>> parents) {
@@ -215,9 +306,13 @@ void JournalDBImpl::Commit(
             callback(Rollback(), std::move(parents.front()));
             return;
           }
+          TRACE_DURATION("ledger", "journal_add_commit");
           std::unique_ptr<storage::Commit> commit =
               CommitImpl::FromContentAndParents(page_storage_, object_id,
                                                 std::move(parents));
+          TRACE_FLOW_BEGIN("ledger", "commit",
+                           callback::TraceFlowId(commit->GetId()), "commit_id",
+                           callback::TraceIdArg(commit->GetId()));
           page_storage_->AddCommitFromLocal(
               commit->Clone(), ftl::MakeCopyable([
                 this, commit = std::move(commit),
@@ -68,6 +68,18 @@ class JournalDBImpl : public Journal {
   Status UpdateValueCounter(ObjectIdView object_id,
                             const std::function<int(int)>& operation);
 
+  // Applies the journal entries to the root of the base commit and adds the
+  // resulting commit to storage.
+  void CreateCommit(
+      std::function<void(Status, std::unique_ptr<const storage::Commit>)>
+          callback);
+
+  // Returns a head commit of the storage whose parents are |base_| and
+  // |other_|, or nullptr if there is none.
+  void GetExistingMerge(
+      std::function<void(Status, std::unique_ptr<const storage::Commit>)>
+          callback);
+
   void GetParents(
       std::function<void(Status,
                          std::vector<std::unique_ptr<const storage::Commit>>)>
@@ -90,6 +102,8 @@ class JournalDBImpl : public Journal {
   // other than rolling back will fail. IMPLICIT journals can still be commited
   // even if some operations have failed.
   bool failed_operation_;
+  // Id of the trace flow of the commit of this journal.
+  const uint64_t trace_flow_id_;
 };
 
 }  // namespace storage
@@ -41,13 +41,17 @@ std::string GetDirectoryName(ftl::StringView bytes) {
 
 LedgerStorageImpl::LedgerStorageImpl(
     ftl::RefPtr<ftl::TaskRunner> main_runner,
-    ftl::RefPtr<ftl::TaskRunner> io_runner,
+    ledger::IOPool* io_pool,
     coroutine::CoroutineService* coroutine_service,
     const std::string& base_storage_dir,
-    const std::string& ledger_name)
+    const std::string& ledger_name,
+    metrics::MetricsRegistry* metrics,
+    ledger::WorkerPool* worker_pool)
     : main_runner_(std::move(main_runner)),
-      io_runner_(std::move(io_runner)),
-      coroutine_service_(coroutine_service) {
+      io_pool_(io_pool),
+      coroutine_service_(coroutine_service),
+      metrics_(metrics::OrUnreported(metrics)),
+      worker_pool_(worker_pool) {
   storage_dir_ = ftl::Concatenate({base_storage_dir, "/", kSerializationVersion,
                                    "/", GetDirectoryName(ledger_name)});
 }
@@ -63,8 +67,11 @@ void LedgerStorageImpl::CreatePageStorage(
     callback(Status::INTERNAL_IO_ERROR, nullptr);
     return;
   }
+  metrics::MetricsRegistry* page_metrics =
+      metrics_->GetChild(metrics::PageNodeName(page_id));
   auto result = std::make_unique<PageStorageImpl>(
-      main_runner_, io_runner_, coroutine_service_, path, std::move(page_id));
+      main_runner_, io_pool_->GetRunner(path), coroutine_service_, path,
+      std::move(page_id), page_metrics, worker_pool_);
   result->Init(ftl::MakeCopyable([
     callback = std::move(callback), result = std::move(result)
   ](Status status) mutable {
@@ -82,8 +89,11 @@ void LedgerStorageImpl::GetPageStorage(
     const std::function<void(Status, std::unique_ptr<PageStorage>)>& callback) {
   std::string path = GetPathFor(page_id);
   if (files::IsDirectory(path)) {
+    metrics::MetricsRegistry* page_metrics =
+        metrics_->GetChild(metrics::PageNodeName(page_id));
     auto result = std::make_unique<PageStorageImpl>(
-        main_runner_, io_runner_, coroutine_service_, path, std::move(page_id));
+        main_runner_, io_pool_->GetRunner(path), coroutine_service_, path,
+        std::move(page_id), page_metrics, worker_pool_);
     result->Init(ftl::MakeCopyable([
       callback = std::move(callback), result = std::move(result)
     ](Status status) mutable {
@@ -8,6 +8,9 @@
 #include <string>
 
 #include "apps/ledger/src/coroutine/coroutine.h"
+#include "apps/ledger/src/environment/io_pool.h"
+#include "apps/ledger/src/environment/worker_pool.h"
+#include "apps/ledger/src/metrics/metrics_registry.h"
 #include "apps/ledger/src/storage/public/ledger_storage.h"
 #include "lib/ftl/tasks/task_runner.h"
 
@@ -15,11 +18,18 @@ namespace storage {
 
 class LedgerStorageImpl : public LedgerStorage {
  public:
+  // The file system accesses of each page storage run on the thread of
+  // |io_pool| assigned to the directory of the page. The metrics of each page
+  // storage are recorded in a child of |metrics| named after the page, if
+  // |metrics| is not null. The objects added to the pages are hashed on
+  // |worker_pool|, if not null.
   LedgerStorageImpl(ftl::RefPtr<ftl::TaskRunner> main_runner,
-                    ftl::RefPtr<ftl::TaskRunner> io_runner,
+                    ledger::IOPool* io_pool,
                     coroutine::CoroutineService* coroutine_service,
                     const std::string& base_storage_dir,
-                    const std::string& ledger_name);
+                    const std::string& ledger_name,
+                    metrics::MetricsRegistry* metrics = nullptr,
+                    ledger::WorkerPool* worker_pool = nullptr);
   ~LedgerStorageImpl() override;
 
   void CreatePageStorage(
@@ -38,8 +48,10 @@ class LedgerStorageImpl : public LedgerStorage {
   std::string GetPathFor(PageIdView page_id);
 
   ftl::RefPtr<ftl::TaskRunner> main_runner_;
-  ftl::RefPtr<ftl::TaskRunner> io_runner_;
+  ledger::IOPool* const io_pool_;
   coroutine::CoroutineService* const coroutine_service_;
+  metrics::MetricsRegistry* const metrics_;
+  ledger::WorkerPool* const worker_pool_;
   std::string storage_dir_;
 };
 
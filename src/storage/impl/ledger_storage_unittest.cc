@@ -20,8 +20,9 @@ namespace {
 class LedgerStorageTest : public test::TestWithMessageLoop {
  public:
   LedgerStorageTest()
-      : storage_(message_loop_.task_runner(),
-                 message_loop_.task_runner(),
+      : io_pool_(message_loop_.task_runner()),
+        storage_(message_loop_.task_runner(),
+                 &io_pool_,
                  &coroutine_service_,
                  tmp_dir_.path(),
                  "test_app") {}
@@ -31,6 +32,7 @@ class LedgerStorageTest : public test::TestWithMessageLoop {
  private:
   files::ScopedTempDir tmp_dir_;
   coroutine::CoroutineServiceImpl coroutine_service_;
+  ledger::IOPool io_pool_;
 
  protected:
   LedgerStorageImpl storage_;
@@ -15,8 +15,10 @@
 
 namespace storage {
 
-ObjectImpl::ObjectImpl(ObjectId id, std::string file_path)
-    : id_(id), file_path_(file_path) {}
+ObjectImpl::ObjectImpl(ObjectId id,
+                       std::string file_path,
+                       metrics::MemoryAccount account)
+    : id_(id), file_path_(file_path), account_(account) {}
 
 ObjectImpl::~ObjectImpl() {}
 
@@ -32,6 +34,7 @@ Status ObjectImpl::GetData(ftl::StringView* data) const {
       return Status::INTERNAL_IO_ERROR;
     }
     data_.swap(res);
+    data_charge_ = metrics::ScopedMemoryCharge(account_, data_.size());
   }
   *data = data_;
   return Status::OK;
@@ -9,11 +9,17 @@
 
 #include <vector>
 
+#include "apps/ledger/src/metrics/memory_budget.h"
+
 namespace storage {
 
 class ObjectImpl : public Object {
  public:
-  ObjectImpl(ObjectId id, std::string file_path);
+  // The content of the object, once read, is charged to |account| until the
+  // object is deleted.
+  ObjectImpl(ObjectId id,
+             std::string file_path,
+             metrics::MemoryAccount account = metrics::MemoryAccount());
   ~ObjectImpl() override;
 
   // Object:
@@ -23,8 +29,10 @@ class ObjectImpl : public Object {
  private:
   const ObjectId id_;
   const std::string file_path_;
+  const metrics::MemoryAccount account_;
 
   mutable std::string data_;
+  mutable metrics::ScopedMemoryCharge data_charge_;
 };
 
 }  // namespace storage
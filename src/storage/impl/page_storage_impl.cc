@@ -17,7 +17,9 @@
 
 #include "apps/ledger/src/callback/asynchronous_callback.h"
 #include "apps/ledger/src/callback/trace_callback.h"
+#include "apps/ledger/src/callback/trace_flow.h"
 #include "apps/ledger/src/callback/waiter.h"
+#include "apps/ledger/src/environment/worker_sequence.h"
 #include "apps/ledger/src/glue/crypto/hash.h"
 #include "apps/ledger/src/storage/impl/btree/diff.h"
 #include "apps/ledger/src/storage/impl/btree/iterator.h"
@@ -35,6 +37,7 @@
 #include "lib/ftl/logging.h"
 #include "lib/ftl/memory/weak_ptr.h"
 #include "lib/ftl/strings/concatenate.h"
+#include "lib/ftl/time/time_point.h"
 #include "lib/mtl/socket/socket_drainer.h"
 
 namespace storage {
@@ -47,6 +50,10 @@ const char kStagingDir[] = "/staging";
 
 const char kHexDigits[] = "0123456789ABCDEF";
 
+// Maximum number of objects requested concurrently from sync when downloading
+// the tree of a commit.
+constexpr size_t kMaxConcurrentObjectsFromSyncRequests = 16;
+
 struct StringPointerComparator {
   using is_transparent = std::true_type;
 
@@ -122,15 +129,27 @@ Status StagingToDestination(size_t expected_size,
   return Status::OK;
 }
 
+// Writes the data of an object to a staging file, then moves it to its final
+// path, named after its hash. If |worker_pool| is not null, the data is hashed
+// on it, while the next chunks are written to disk on the I/O thread.
 class FileWriterOnIOThread : public mtl::SocketDrainer::Client {
  public:
-  FileWriterOnIOThread(const std::string& staging_dir,
+  FileWriterOnIOThread(ftl::RefPtr<ftl::TaskRunner> io_runner,
+                       ledger::WorkerPool* worker_pool,
+                       const std::string& staging_dir,
                        const std::string& object_dir)
-      : staging_dir_(staging_dir),
+      : io_runner_(std::move(io_runner)),
+        staging_dir_(staging_dir),
         object_dir_(object_dir),
         drainer_(this),
+        hash_(std::make_shared<glue::SHA256StreamingHash>()),
         expected_size_(0),
-        size_(0u) {}
+        size_(0u),
+        weak_ptr_factory_(this) {
+    if (worker_pool) {
+      hash_sequence_ = std::make_unique<ledger::WorkerSequence>(worker_pool);
+    }
+  }
 
   ~FileWriterOnIOThread() override {
     // Cleanup staging file.
@@ -142,8 +161,12 @@ class FileWriterOnIOThread : public mtl::SocketDrainer::Client {
 
   void Start(mx::socket source,
              uint64_t expected_size,
+             uint64_t trace_flow_id,
              std::function<void(Status, ObjectId)> callback) {
+    TRACE_DURATION("ledger", "file_writer_io_start");
+    TRACE_FLOW_STEP("ledger", "file_writer", trace_flow_id);
     expected_size_ = expected_size;
+    trace_flow_id_ = trace_flow_id;
     callback_ = std::move(callback);
     // Using mkstemp to create an unique file. XXXXXX will be replaced.
     file_path_ = staging_dir_ + "/XXXXXX";
@@ -161,7 +184,14 @@ class FileWriterOnIOThread : public mtl::SocketDrainer::Client {
   // mtl::SocketDrainer::Client
   void OnDataAvailable(const void* data, size_t num_bytes) override {
     size_ += num_bytes;
-    hash_.Update(data, num_bytes);
+    if (hash_sequence_) {
+      hash_sequence_->PostTask([
+        hash = hash_,
+        chunk = std::string(static_cast<const char*>(data), num_bytes)
+      ] { hash->Update(chunk.data(), chunk.size()); });
+    } else {
+      hash_->Update(data, num_bytes);
+    }
     if (!ftl::WriteFileDescriptor(fd_.get(), static_cast<const char*>(data),
                                   num_bytes)) {
       FTL_LOG(ERROR) << "Error writing data to disk: " << strerror(errno);
@@ -172,6 +202,8 @@ class FileWriterOnIOThread : public mtl::SocketDrainer::Client {
 
   // mtl::SocketDrainer::Client
   void OnDataComplete() override {
+    TRACE_DURATION("ledger", "file_writer_complete", "size", size_);
+    TRACE_FLOW_END("ledger", "file_writer", trace_flow_id_);
     if (fsync(fd_.get()) != 0) {
       FTL_LOG(ERROR) << "Unable to save to disk.";
       callback_(Status::INTERNAL_IO_ERROR, "");
@@ -185,9 +217,30 @@ class FileWriterOnIOThread : public mtl::SocketDrainer::Client {
       return;
     }
 
-    std::string object_id;
-    hash_.Finish(&object_id);
+    if (!hash_sequence_) {
+      std::string object_id;
+      hash_->Finish(&object_id);
+      MoveToDestination(std::move(object_id));
+      return;
+    }
+    hash_sequence_->PostTask([
+      hash = hash_, io_runner = io_runner_,
+      weak_this = weak_ptr_factory_.GetWeakPtr()
+    ] {
+      // Called on a worker, once the previous chunks are hashed.
+      std::string object_id;
+      hash->Finish(&object_id);
+      io_runner->PostTask(
+          [ weak_this, object_id = std::move(object_id) ]() mutable {
+            if (weak_this) {
+              weak_this->MoveToDestination(std::move(object_id));
+            }
+          });
+    });
+  }
 
+  // Moves the staging file to the path of the object named |object_id|.
+  void MoveToDestination(ObjectId object_id) {
     std::string final_path = storage::GetFilePath(object_dir_, object_id);
     Status status =
         StagingToDestination(size_, file_path_, std::move(final_path));
@@ -199,27 +252,35 @@ class FileWriterOnIOThread : public mtl::SocketDrainer::Client {
     callback_(Status::OK, std::move(object_id));
   }
 
+  ftl::RefPtr<ftl::TaskRunner> io_runner_;
   const std::string& staging_dir_;
   const std::string& object_dir_;
   std::function<void(Status, ObjectId)> callback_;
   mtl::SocketDrainer drainer_;
   std::string file_path_;
   ftl::UniqueFD fd_;
-  glue::SHA256StreamingHash hash_;
+  // Shared with the hashing tasks, which may outlive this object.
+  std::shared_ptr<glue::SHA256StreamingHash> hash_;
+  std::unique_ptr<ledger::WorkerSequence> hash_sequence_;
   uint64_t expected_size_;
   uint64_t size_;
+  uint64_t trace_flow_id_ = 0u;
+
+  // Must be the last member field.
+  ftl::WeakPtrFactory<FileWriterOnIOThread> weak_ptr_factory_;
 };
 
 class FileWriter {
  public:
   FileWriter(ftl::RefPtr<ftl::TaskRunner> main_runner,
              ftl::RefPtr<ftl::TaskRunner> io_runner,
+             ledger::WorkerPool* worker_pool,
              const std::string& staging_dir,
              const std::string& object_dir)
       : main_runner_(std::move(main_runner)),
         io_runner_(std::move(io_runner)),
-        file_writer_on_io_thread_(
-            std::make_unique<FileWriterOnIOThread>(staging_dir, object_dir)),
+        file_writer_on_io_thread_(std::make_unique<FileWriterOnIOThread>(
+            io_runner_, worker_pool, staging_dir, object_dir)),
         weak_ptr_factory_(this) {
     FTL_DCHECK(main_runner_->RunsTasksOnCurrentThread());
   }
@@ -240,23 +301,28 @@ class FileWriter {
              uint64_t expected_size,
              std::function<void(Status, ObjectId)> callback) {
     FTL_DCHECK(main_runner_->RunsTasksOnCurrentThread());
+    TRACE_DURATION("ledger", "file_writer_start", "size", expected_size);
+    // Links the request to write the object to the writes on the io runner.
+    uint64_t trace_flow_id = TRACE_NONCE();
+    TRACE_FLOW_BEGIN("ledger", "file_writer", trace_flow_id);
 
     if (io_runner_->RunsTasksOnCurrentThread()) {
       file_writer_on_io_thread_->Start(std::move(source), expected_size,
-                                       std::move(callback));
+                                       trace_flow_id, std::move(callback));
       return;
     }
     callback_ = std::move(callback);
     io_runner_->PostTask(ftl::MakeCopyable([
       this, weak_this = weak_ptr_factory_.GetWeakPtr(),
-      source = std::move(source), expected_size
+      source = std::move(source), expected_size, trace_flow_id
     ]() mutable {
       // Called on the io runner.
 
       // |this| cannot be deleted here, because if the destructor of FileWriter
       // has been called after Start and before this has been run, it is still
       // waiting on the lock to be released as the posts are run in-order.
-      file_writer_on_io_thread_->Start(std::move(source), expected_size, [
+      file_writer_on_io_thread_->Start(std::move(source), expected_size,
+                                       trace_flow_id, [
         weak_this, main_runner = main_runner_
       ](Status status, ObjectId object_id) {
         // Called on the io runner.
@@ -291,16 +357,33 @@ PageStorageImpl::PageStorageImpl(ftl::RefPtr<ftl::TaskRunner> task_runner,
                                  ftl::RefPtr<ftl::TaskRunner> io_runner,
                                  coroutine::CoroutineService* coroutine_service,
                                  std::string page_dir,
-                                 PageId page_id)
+                                 PageId page_id,
+                                 metrics::MetricsRegistry* metrics,
+                                 ledger::WorkerPool* worker_pool)
     : main_runner_(task_runner),
       io_runner_(io_runner),
+      worker_pool_(worker_pool),
       coroutine_service_(coroutine_service),
       page_dir_(page_dir),
       page_id_(std::move(page_id)),
-      db_(coroutine_service, this, page_dir_ + kLevelDbDir),
+      metrics_(metrics::OrUnreported(metrics)),
+      db_(coroutine_service, this, page_dir_ + kLevelDbDir, metrics_),
       objects_dir_(page_dir_ + kObjectDir),
       staging_dir_(page_dir_ + kStagingDir),
-      page_sync_(nullptr) {}
+      page_sync_(nullptr),
+      local_commits_(metrics_->GetCounter("local_commits")),
+      sync_commits_(metrics_->GetCounter("sync_commits")),
+      objects_added_(metrics_->GetCounter("objects_added")),
+      bytes_hashed_(metrics_->GetCounter("bytes_hashed")),
+      add_object_latency_(metrics_->GetHistogram("add_object_latency")),
+      object_reads_(metrics_->GetCounter("object_reads")),
+      object_read_misses_(metrics_->GetCounter("object_read_misses")),
+      object_downloads_(metrics_->GetCounter("object_downloads")),
+      object_downloads_deduplicated_(
+          metrics_->GetCounter("object_downloads_deduplicated")),
+      unsynced_commits_(metrics_->GetGauge("unsynced_commits")),
+      unsynced_objects_(metrics_->GetGauge("unsynced_objects")),
+      object_memory_(metrics_, "memory_objects_bytes") {}
 
 PageStorageImpl::~PageStorageImpl() {}
 
@@ -335,6 +418,16 @@ void PageStorageImpl::Init(std::function<void(Status)> callback) {
     }
   }
 
+  // Initialize the sync backlog metrics.
+  std::vector<CommitId> unsynced_commit_ids;
+  if (db_.GetUnsyncedCommitIds(&unsynced_commit_ids) == Status::OK) {
+    unsynced_commits_->Set(unsynced_commit_ids.size());
+  }
+  std::vector<ObjectId> unsynced_object_ids;
+  if (db_.GetUnsyncedObjectIds(&unsynced_object_ids) == Status::OK) {
+    unsynced_objects_->Set(unsynced_object_ids.size());
+  }
+
   // Remove uncommited explicit journals.
   db_.RemoveExplicitJournals();
 
@@ -453,8 +546,9 @@ void PageStorageImpl::AddCommitsFromSync(
   auto waiter = callback::StatusWaiter<Status>::Create(Status::OK);
   // Get all objects from sync and then add the commit objects.
   for (const auto& leaf : leaves) {
-    btree::GetObjectsFromSync(coroutine_service_, this,
-                              leaf.second->GetRootId(), waiter->NewCallback());
+    btree::GetObjectsFromSync(this, leaf.second->GetRootId(),
+                              kMaxConcurrentObjectsFromSyncRequests,
+                              waiter->NewCallback());
   }
 
   waiter->Finalize(ftl::MakeCopyable([
@@ -515,6 +609,7 @@ void PageStorageImpl::GetUnsyncedCommits(
     callback(s, {});
     return;
   }
+  unsynced_commits_->Set(commit_ids.size());
 
   auto waiter = callback::Waiter<Status, std::unique_ptr<const Commit>>::Create(
       Status::OK);
@@ -532,7 +627,11 @@ void PageStorageImpl::GetUnsyncedCommits(
 }
 
 Status PageStorageImpl::MarkCommitSynced(const CommitId& commit_id) {
-  return db_.MarkCommitIdSynced(commit_id);
+  Status s = db_.MarkCommitIdSynced(commit_id);
+  if (s == Status::OK && unsynced_commits_->value() > 0) {
+    unsynced_commits_->Add(-1);
+  }
+  return s;
 }
 
 Status PageStorageImpl::GetDeltaObjects(const CommitId& commit_id,
@@ -563,6 +662,7 @@ void PageStorageImpl::GetUnsyncedObjectIds(
         callback(s, std::move(object_ids));
         return;
       }
+      unsynced_objects_->Set(unsynced_objects.size());
 
       std::set_intersection(commit_objects.begin(), commit_objects.end(),
                             unsynced_objects.begin(), unsynced_objects.end(),
@@ -573,7 +673,11 @@ void PageStorageImpl::GetUnsyncedObjectIds(
 }
 
 Status PageStorageImpl::MarkObjectSynced(ObjectIdView object_id) {
-  return db_.MarkObjectIdSynced(object_id);
+  Status s = db_.MarkObjectIdSynced(object_id);
+  if (s == Status::OK && unsynced_objects_->value() > 0) {
+    unsynced_objects_->Add(-1);
+  }
+  return s;
 }
 
 void PageStorageImpl::AddObjectFromSync(
@@ -616,15 +720,22 @@ void PageStorageImpl::GetObject(
         callback) {
   std::string file_path = GetFilePath(object_id);
   if (!files::IsFile(file_path)) {
-    if (location == Location::NETWORK) {
-      GetObjectFromSync(object_id, callback);
-    } else {
+    object_read_misses_->Increment();
+    if (location == Location::LOCAL) {
       callback(Status::NOT_FOUND, nullptr);
+    } else {
+      GetObjectFromSync(object_id,
+                        location == Location::NETWORK
+                            ? DownloadPriority::FOREGROUND
+                            : DownloadPriority::BACKGROUND,
+                        callback);
     }
     return;
   }
-  callback(Status::OK, std::make_unique<ObjectImpl>(object_id.ToString(),
-                                                    std::move(file_path)));
+  object_reads_->Increment();
+  callback(Status::OK,
+           std::make_unique<ObjectImpl>(object_id.ToString(),
+                                        std::move(file_path), object_memory_));
 }
 
 Status PageStorageImpl::SetSyncMetadata(ftl::StringView sync_state) {
@@ -647,6 +758,23 @@ void PageStorageImpl::GetCommitContents(const Commit& commit,
       std::move(on_done));
 }
 
+void PageStorageImpl::GetCommitContentsCount(
+    const Commit& commit,
+    std::string prefix,
+    std::function<void(Status, uint64_t)> callback) {
+  btree::CountEntries(coroutine_service_, this, commit.GetRootId(),
+                      std::move(prefix), std::move(callback));
+}
+
+void PageStorageImpl::GetCommitKeyAtOffset(
+    const Commit& commit,
+    std::string min_key,
+    uint64_t offset,
+    std::function<void(Status, std::string)> callback) {
+  btree::GetKeyAtOffset(coroutine_service_, this, commit.GetRootId(),
+                        std::move(min_key), offset, std::move(callback));
+}
+
 void PageStorageImpl::GetEntryFromCommit(
     const Commit& commit,
     std::string key,
@@ -688,6 +816,19 @@ void PageStorageImpl::GetCommitContentsDiff(
                      std::move(on_next_diff), std::move(on_done));
 }
 
+void PageStorageImpl::GetThreeWayContentsDiff(
+    const Commit& base_commit,
+    const Commit& left_commit,
+    const Commit& right_commit,
+    std::string min_key,
+    std::function<bool(ThreeWayChange)> on_next_diff,
+    std::function<void(Status)> on_done) {
+  btree::ForEachThreeWayDiff(
+      coroutine_service_, this, base_commit.GetRootId(),
+      left_commit.GetRootId(), right_commit.GetRootId(), std::move(min_key),
+      std::move(on_next_diff), std::move(on_done));
+}
+
 void PageStorageImpl::NotifyWatchers() {
   while (!commits_to_send_.empty()) {
     auto to_send = std::move(commits_to_send_.front());
@@ -702,11 +843,15 @@ void PageStorageImpl::AddCommits(
     std::vector<std::unique_ptr<const Commit>> commits,
     ChangeSource source,
     std::function<void(Status)> callback) {
+  TRACE_DURATION("ledger", "page_storage_add_commits", "count", commits.size(),
+                 "from_sync", source == ChangeSource::SYNC);
   // Apply all changes atomically.
   std::unique_ptr<DB::Batch> batch = db_.StartBatch();
   std::set<const CommitId*, StringPointerComparator> added_commits;
 
   for (const auto& commit : commits) {
+    TRACE_FLOW_STEP("ledger", "commit",
+                    callback::TraceFlowId(commit->GetId()));
     Status s =
         db_.AddCommitStorageBytes(commit->GetId(), commit->GetStorageBytes());
     if (s != Status::OK) {
@@ -753,6 +898,14 @@ void PageStorageImpl::AddCommits(
   }
 
   Status s = batch->Execute();
+  if (s == Status::OK) {
+    if (source == ChangeSource::LOCAL) {
+      local_commits_->Increment(commits.size());
+      unsynced_commits_->Add(commits.size());
+    } else {
+      sync_commits_->Increment(commits.size());
+    }
+  }
   bool notify_watchers = commits_to_send_.empty();
   commits_to_send_.emplace(source, std::move(commits));
   callback(s);
@@ -783,11 +936,18 @@ void PageStorageImpl::AddObject(
       TRACE_CALLBACK(std::move(callback), "ledger", "page_storage_add_object");
   auto file_writer =
       pending_operation_manager_.Manage(std::make_unique<FileWriter>(
-          main_runner_, io_runner_, staging_dir_, objects_dir_));
+          main_runner_, io_runner_, worker_pool_, staging_dir_,
+          objects_dir_));
 
   (*file_writer.first)->Start(std::move(data), size, [
+    this, size, start = ftl::TimePoint::Now(),
     cleanup = std::move(file_writer.second), callback = std::move(traced_callback)
   ](Status status, ObjectId object_id) {
+    add_object_latency_->Record(ftl::TimePoint::Now() - start);
+    if (status == Status::OK) {
+      objects_added_->Increment();
+      bytes_hashed_->Increment(size);
+    }
     callback(status, std::move(object_id));
     cleanup();
   });
@@ -795,34 +955,64 @@ void PageStorageImpl::AddObject(
 
 void PageStorageImpl::GetObjectFromSync(
     ObjectIdView object_id,
+    DownloadPriority priority,
     const std::function<void(Status, std::unique_ptr<const Object>)>&
         callback) {
   if (!page_sync_) {
     callback(Status::NOT_CONNECTED_ERROR, nullptr);
     return;
   }
-  page_sync_->GetObject(object_id, [
-    this, callback = std::move(callback), object_id = object_id.ToString()
+
+  // If the object is already being downloaded, wait for the result of the
+  // pending request instead of downloading it again, even if that request has
+  // a lower priority.
+  auto it = pending_object_requests_.find(object_id);
+  if (it != pending_object_requests_.end()) {
+    object_downloads_deduplicated_->Increment();
+    it->second.push_back(callback);
+    return;
+  }
+  pending_object_requests_[object_id.ToString()].push_back(callback);
+  object_downloads_->Increment();
+
+  page_sync_->GetObject(object_id, priority, [
+    this, object_id = object_id.ToString()
   ](Status status, uint64_t size, mx::socket data) {
     if (status != Status::OK) {
-      callback(status, nullptr);
+      CompleteObjectRequests(object_id, status);
       return;
     }
-    AddObjectFromSync(object_id, std::move(data), size, [
-      this, callback = std::move(callback), object_id
-    ](Status status) mutable {
-      if (status != Status::OK) {
-        callback(status, nullptr);
-        return;
-      }
-      std::string file_path = GetFilePath(object_id);
-      FTL_DCHECK(files::IsFile(file_path));
-      callback(Status::OK, std::make_unique<ObjectImpl>(std::move(object_id),
-                                                        std::move(file_path)));
-    });
+    AddObjectFromSync(object_id, std::move(data), size,
+                      [ this, object_id ](Status status) {
+                        CompleteObjectRequests(object_id, status);
+                      });
   });
 }
 
+void PageStorageImpl::CompleteObjectRequests(const ObjectId& object_id,
+                                             Status status) {
+  auto it = pending_object_requests_.find(object_id);
+  FTL_DCHECK(it != pending_object_requests_.end());
+  // Remove the pending callbacks before calling them, as they might request
+  // the object again.
+  auto callbacks = std::move(it->second);
+  pending_object_requests_.erase(it);
+
+  if (status != Status::OK) {
+    for (const auto& callback : callbacks) {
+      callback(status, nullptr);
+    }
+    return;
+  }
+
+  std::string file_path = GetFilePath(object_id);
+  FTL_DCHECK(files::IsFile(file_path));
+  for (const auto& callback : callbacks) {
+    callback(Status::OK, std::make_unique<ObjectImpl>(object_id, file_path,
+                                                      object_memory_));
+  }
+}
+
 std::string PageStorageImpl::GetFilePath(ObjectIdView object_id) const {
   return storage::GetFilePath(objects_dir_, object_id);
 }
@@ -7,12 +7,16 @@
 
 #include "apps/ledger/src/storage/public/page_storage.h"
 
+#include <map>
 #include <queue>
 #include <set>
 
 #include "apps/ledger/src/callback/pending_operation.h"
 #include "apps/ledger/src/convert/convert.h"
 #include "apps/ledger/src/coroutine/coroutine.h"
+#include "apps/ledger/src/environment/worker_pool.h"
+#include "apps/ledger/src/metrics/memory_budget.h"
+#include "apps/ledger/src/metrics/metrics_registry.h"
 #include "apps/ledger/src/storage/impl/db_impl.h"
 #include "apps/ledger/src/storage/public/page_sync_delegate.h"
 #include "lib/ftl/memory/ref_ptr.h"
@@ -23,11 +27,16 @@ namespace storage {
 
 class PageStorageImpl : public PageStorage {
  public:
+  // The activity of the page storage and of its database is recorded in
+  // |metrics|, if not null. If |worker_pool| is not null, the objects added to
+  // the page are hashed on it instead of on the I/O thread.
   PageStorageImpl(ftl::RefPtr<ftl::TaskRunner> main_runner,
                   ftl::RefPtr<ftl::TaskRunner> io_runner,
                   coroutine::CoroutineService* coroutine_service,
                   std::string page_dir,
-                  PageId page_id);
+                  PageId page_id,
+                  metrics::MetricsRegistry* metrics = nullptr,
+                  ledger::WorkerPool* worker_pool = nullptr);
   ~PageStorageImpl() override;
 
   // Initializes this PageStorageImpl. This includes initializing the underlying
@@ -98,6 +107,15 @@ class PageStorageImpl : public PageStorage {
                          std::string min_key,
                          std::function<bool(Entry)> on_next,
                          std::function<void(Status)> on_done) override;
+  void GetCommitContentsCount(
+      const Commit& commit,
+      std::string prefix,
+      std::function<void(Status, uint64_t)> callback) override;
+  void GetCommitKeyAtOffset(
+      const Commit& commit,
+      std::string min_key,
+      uint64_t offset,
+      std::function<void(Status, std::string)> callback) override;
   void GetEntryFromCommit(const Commit& commit,
                           std::string key,
                           std::function<void(Status, Entry)> callback) override;
@@ -106,6 +124,13 @@ class PageStorageImpl : public PageStorage {
                              std::string min_key,
                              std::function<bool(EntryChange)> on_next_diff,
                              std::function<void(Status)> on_done) override;
+  void GetThreeWayContentsDiff(
+      const Commit& base_commit,
+      const Commit& left_commit,
+      const Commit& right_commit,
+      std::string min_key,
+      std::function<bool(ThreeWayChange)> on_next_diff,
+      std::function<void(Status)> on_done) override;
 
  private:
   friend class PageStorageImplAccessorForTest;
@@ -120,8 +145,12 @@ class PageStorageImpl : public PageStorage {
                  const std::function<void(Status, ObjectId)>& callback);
   void GetObjectFromSync(
       ObjectIdView object_id,
+      DownloadPriority priority,
       const std::function<void(Status, std::unique_ptr<const Object>)>&
           callback);
+  // Completes all the pending GetObjectFromSync requests for |object_id| with
+  // the given |status|.
+  void CompleteObjectRequests(const ObjectId& object_id, Status status);
   std::string GetFilePath(ObjectIdView object_id) const;
 
   // Notifies the registered watchers with the |commits| in commit_to_send_.
@@ -129,9 +158,11 @@ class PageStorageImpl : public PageStorage {
 
   const ftl::RefPtr<ftl::TaskRunner> main_runner_;
   const ftl::RefPtr<ftl::TaskRunner> io_runner_;
+  ledger::WorkerPool* const worker_pool_;
   coroutine::CoroutineService* const coroutine_service_;
   const std::string page_dir_;
   const PageId page_id_;
+  metrics::MetricsRegistry* const metrics_;
   DbImpl db_;
   std::vector<CommitWatcher*> watchers_;
   std::set<ObjectId, convert::StringViewComparator> untracked_objects_;
@@ -139,7 +170,31 @@ class PageStorageImpl : public PageStorage {
   std::string staging_dir_;
   callback::PendingOperationManager pending_operation_manager_;
   PageSyncDelegate* page_sync_;
+  // Callbacks of the GetObjectFromSync requests waiting for an object being
+  // downloaded. Only one download is in flight for each object id.
+  std::map<ObjectId,
+           std::vector<std::function<void(Status,
+                                          std::unique_ptr<const Object>)>>,
+           convert::StringViewComparator>
+      pending_object_requests_;
   std::queue<std::pair<ChangeSource, std::vector<std::unique_ptr<const Commit>>>> commits_to_send_;
+
+  metrics::Counter* const local_commits_;
+  metrics::Counter* const sync_commits_;
+  metrics::Counter* const objects_added_;
+  metrics::Counter* const bytes_hashed_;
+  metrics::Histogram* const add_object_latency_;
+  metrics::Counter* const object_reads_;
+  metrics::Counter* const object_read_misses_;
+  metrics::Counter* const object_downloads_;
+  metrics::Counter* const object_downloads_deduplicated_;
+  // Number of commits and objects not yet synced to the cloud. They are
+  // refreshed each time the full list is read from the database, and updated
+  // as commits are added and commits and objects are marked as synced.
+  metrics::Gauge* const unsynced_commits_;
+  metrics::Gauge* const unsynced_objects_;
+  // Content of the objects read from disk and not yet released.
+  const metrics::MemoryAccount object_memory_;
 };
 
 }  // namespace storage
@@ -13,6 +13,7 @@
 
 #include "apps/ledger/src/callback/capture.h"
 #include "apps/ledger/src/coroutine/coroutine_impl.h"
+#include "apps/ledger/src/environment/worker_pool.h"
 #include "apps/ledger/src/glue/crypto/hash.h"
 #include "apps/ledger/src/glue/crypto/rand.h"
 #include "apps/ledger/src/storage/impl/btree/tree_node.h"
@@ -29,6 +30,7 @@
 #include "lib/ftl/files/file.h"
 #include "lib/ftl/files/path.h"
 #include "lib/ftl/files/scoped_temp_dir.h"
+#include "lib/ftl/functional/closure.h"
 #include "lib/ftl/functional/make_copyable.h"
 #include "lib/ftl/macros.h"
 #include "lib/ftl/strings/string_printf.h"
@@ -107,15 +109,30 @@ class FakeSyncDelegate : public PageSyncDelegate {
 
   void GetObject(
       ObjectIdView object_id,
+      DownloadPriority priority,
       std::function<void(Status status, uint64_t size, mx::socket data)>
           callback) {
     std::string id = object_id.ToString();
     std::string& value = id_to_value_[id];
     object_requests.insert(id);
+    get_object_calls++;
+    last_priority = priority;
+    if (delay_responses) {
+      pending_responses.push_back([ callback, value ] {
+        callback(Status::OK, value.size(), mtl::WriteStringToSocket(value));
+      });
+      return;
+    }
     callback(Status::OK, value.size(), mtl::WriteStringToSocket(value));
   }
 
   std::set<ObjectId> object_requests;
+  int get_object_calls = 0;
+  DownloadPriority last_priority = DownloadPriority::FOREGROUND;
+  // If true, the responses to GetObject are stored in |pending_responses|
+  // instead of being sent immediately.
+  bool delay_responses = false;
+  std::vector<ftl::Closure> pending_responses;
 
  private:
   std::map<ObjectId, std::string> id_to_value_;
@@ -514,6 +531,53 @@ TEST_F(PageStorageTest, CreateJournals) {
   EXPECT_NE(nullptr, journal);
 }
 
+TEST_F(PageStorageTest, MergeCommitAdoptsSyncedMerge) {
+  CommitId base_id = GetFirstHead()->GetId();
+
+  // Create two concurrent heads.
+  std::vector<CommitId> head_ids;
+  for (const std::string& key : {"left", "right"}) {
+    std::unique_ptr<Journal> journal;
+    EXPECT_EQ(Status::OK,
+              storage_->StartCommit(base_id, JournalType::EXPLICIT, &journal));
+    EXPECT_EQ(Status::OK,
+              journal->Put(key, RandomId(kObjectIdSize), KeyPriority::EAGER));
+    head_ids.push_back(TryCommitJournal(&journal, Status::OK)->GetId());
+  }
+
+  // Receive a merge of the two heads from sync.
+  std::vector<std::unique_ptr<const Commit>> parents;
+  parents.emplace_back(GetCommit(head_ids[0]));
+  parents.emplace_back(GetCommit(head_ids[1]));
+  ObjectId root_id = parents[0]->GetRootId().ToString();
+  std::unique_ptr<Commit> synced_merge = CommitImpl::FromContentAndParents(
+      storage_.get(), root_id, std::move(parents));
+  Status status;
+  storage_->AddCommitsFromSync(
+      CommitAndBytesFromCommit(*synced_merge),
+      callback::Capture([this] { message_loop_.PostQuitTask(); }, &status));
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(Status::OK, status);
+
+  // Committing a local merge of the same heads returns the synced merge
+  // instead of adding a new commit.
+  std::unique_ptr<Journal> journal;
+  EXPECT_EQ(Status::OK,
+            storage_->StartMergeCommit(head_ids[0], head_ids[1], &journal));
+  EXPECT_EQ(Status::OK,
+            journal->Put("merged", RandomId(kObjectIdSize),
+                         KeyPriority::EAGER));
+  std::unique_ptr<const Commit> merge = TryCommitJournal(&journal, Status::OK);
+  ASSERT_TRUE(merge);
+  EXPECT_EQ(synced_merge->GetId(), merge->GetId());
+  EXPECT_EQ(Status::ILLEGAL_STATE, journal->Rollback());
+
+  std::vector<CommitId> heads;
+  EXPECT_EQ(Status::OK, storage_->GetHeadCommitIds(&heads));
+  ASSERT_EQ(1u, heads.size());
+  EXPECT_EQ(synced_merge->GetId(), heads[0]);
+}
+
 TEST_F(PageStorageTest, JournalCommitFailsAfterFailedOperation) {
   FakeDbImpl db(&coroutine_service_, storage_.get());
 
@@ -579,6 +643,46 @@ TEST_F(PageStorageTest, AddObjectFromLocal) {
   EXPECT_TRUE(storage_->ObjectIsUntracked(object_id));
 }
 
+TEST_F(PageStorageTest, AddObjectFromLocalHashedOnWorkers) {
+  ledger::WorkerPool worker_pool(2);
+  files::ScopedTempDir page_dir;
+  PageStorageImpl storage(message_loop_.task_runner(), io_runner_,
+                          &coroutine_service_, page_dir.path(), RandomId(16),
+                          nullptr, &worker_pool);
+  Status status;
+  storage.Init(
+      callback::Capture([this] { message_loop_.PostQuitTask(); }, &status));
+  ASSERT_FALSE(RunLoopWithTimeout());
+  ASSERT_EQ(Status::OK, status);
+
+  // Large enough to be received, and hashed, in several chunks.
+  std::string value;
+  for (int i = 0; i < 100000; ++i) {
+    value.append(std::to_string(i));
+  }
+  ObjectData data(value);
+
+  ObjectId object_id;
+  storage.AddObjectFromLocal(
+      mtl::WriteStringToSocket(data.value), data.size,
+      callback::Capture([this] { message_loop_.PostQuitTask(); }, &status,
+                        &object_id));
+  ASSERT_FALSE(RunLoopWithTimeout());
+  ASSERT_EQ(Status::OK, status);
+  EXPECT_EQ(data.object_id, object_id);
+
+  std::unique_ptr<const Object> object;
+  storage.GetObject(
+      object_id, PageStorage::Location::LOCAL,
+      callback::Capture([this] { message_loop_.PostQuitTask(); }, &status,
+                        &object));
+  ASSERT_FALSE(RunLoopWithTimeout());
+  ASSERT_EQ(Status::OK, status);
+  ftl::StringView object_data;
+  ASSERT_EQ(Status::OK, object->GetData(&object_data));
+  EXPECT_EQ(data.value, convert::ToString(object_data));
+}
+
 TEST_F(PageStorageTest, InterruptAddObjectFromLocal) {
   ObjectData data("Some data");
 
@@ -682,6 +786,92 @@ TEST_F(PageStorageTest, GetObjectFromSync) {
                Status::NOT_CONNECTED_ERROR);
 }
 
+TEST_F(PageStorageTest, GetObjectFromSyncPriority) {
+  ObjectData foreground_data("Some data");
+  ObjectData background_data("Some other data");
+  FakeSyncDelegate sync;
+  sync.AddObject(foreground_data.object_id, foreground_data.value);
+  sync.AddObject(background_data.object_id, background_data.value);
+  storage_->SetSyncDelegate(&sync);
+
+  TryGetObject(background_data.object_id,
+               PageStorage::Location::NETWORK_IN_BACKGROUND);
+  EXPECT_EQ(1, sync.get_object_calls);
+  EXPECT_EQ(DownloadPriority::BACKGROUND, sync.last_priority);
+
+  TryGetObject(foreground_data.object_id, PageStorage::Location::NETWORK);
+  EXPECT_EQ(2, sync.get_object_calls);
+  EXPECT_EQ(DownloadPriority::FOREGROUND, sync.last_priority);
+}
+
+TEST_F(PageStorageTest, GetObjectFromSyncConcurrentRequests) {
+  ObjectData data("Some data");
+  FakeSyncDelegate sync;
+  sync.AddObject(data.object_id, data.value);
+  sync.delay_responses = true;
+  storage_->SetSyncDelegate(&sync);
+
+  std::vector<std::unique_ptr<const Object>> objects;
+  for (int i = 0; i < 3; ++i) {
+    storage_->GetObject(
+        data.object_id, PageStorage::Location::NETWORK,
+        [this, &objects](Status status, std::unique_ptr<const Object> object) {
+          EXPECT_EQ(Status::OK, status);
+          objects.push_back(std::move(object));
+          if (objects.size() == 3u) {
+            message_loop_.PostQuitTask();
+          }
+        });
+  }
+  // Only one download is started for the three requests.
+  EXPECT_EQ(1, sync.get_object_calls);
+  ASSERT_EQ(1u, sync.pending_responses.size());
+
+  sync.pending_responses[0]();
+  EXPECT_FALSE(RunLoopWithTimeout());
+  ASSERT_EQ(3u, objects.size());
+  for (const auto& object : objects) {
+    ASSERT_TRUE(object);
+    EXPECT_EQ(data.object_id, object->GetId());
+    ftl::StringView object_data;
+    ASSERT_EQ(Status::OK, object->GetData(&object_data));
+    EXPECT_EQ(data.value, convert::ToString(object_data));
+  }
+
+  // Once the download is done, the object is read locally.
+  TryGetObject(data.object_id, PageStorage::Location::NETWORK);
+  EXPECT_EQ(1, sync.get_object_calls);
+}
+
+TEST_F(PageStorageTest, GetObjectFromSyncConcurrentRequestsError) {
+  ObjectData data("Some data");
+  FakeSyncDelegate sync;
+  // Return content not matching the object id, so that adding it fails.
+  sync.AddObject(data.object_id, "Some other data");
+  sync.delay_responses = true;
+  storage_->SetSyncDelegate(&sync);
+
+  int callback_count = 0;
+  for (int i = 0; i < 2; ++i) {
+    storage_->GetObject(
+        data.object_id, PageStorage::Location::NETWORK,
+        [this, &callback_count](Status status,
+                                std::unique_ptr<const Object> object) {
+          EXPECT_EQ(Status::OBJECT_ID_MISMATCH, status);
+          EXPECT_FALSE(object);
+          if (++callback_count == 2) {
+            message_loop_.PostQuitTask();
+          }
+        });
+  }
+  EXPECT_EQ(1, sync.get_object_calls);
+  ASSERT_EQ(1u, sync.pending_responses.size());
+
+  sync.pending_responses[0]();
+  EXPECT_FALSE(RunLoopWithTimeout());
+  EXPECT_EQ(2, callback_count);
+}
+
 TEST_F(PageStorageTest, UnsyncedObjects) {
   int size = 3;
   ObjectData data[] = {
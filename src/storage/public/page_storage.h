@@ -39,7 +39,7 @@ class PageStorage {
   };
 
   // Location where to search an object. See |GetObject| call for usage.
-  enum Location { LOCAL, NETWORK };
+  enum Location { LOCAL, NETWORK, NETWORK_IN_BACKGROUND };
 
   PageStorage() {}
   virtual ~PageStorage() {}
@@ -137,7 +137,8 @@ class PageStorage {
   // an error will be returned through the given |callback|. If |location| is
   // LOCAL, only local storage will be checked. If |location| is NETWORK, then
   // a network request may be made if the requested object is not present
-  // locally.
+  // locally. NETWORK_IN_BACKGROUND is the same as NETWORK, except that the
+  // network request has a background priority.
   virtual void GetObject(
       ObjectIdView object_id,
       Location location,
@@ -163,6 +164,23 @@ class PageStorage {
                                  std::function<bool(Entry)> on_next,
                                  std::function<void(Status)> on_done) = 0;
 
+  // Counts the entries of the given |commit| whose key starts with |prefix|
+  // and calls |callback| with the result.
+  virtual void GetCommitContentsCount(
+      const Commit& commit,
+      std::string prefix,
+      std::function<void(Status, uint64_t)> callback) = 0;
+
+  // Finds the key of the entry at position |offset| among the entries of the
+  // given |commit| with a key equal to or greater than |min_key|, and calls
+  // |callback| with the result. The status of |callback| will be |NOT_FOUND|
+  // if there are not enough such entries.
+  virtual void GetCommitKeyAtOffset(
+      const Commit& commit,
+      std::string min_key,
+      uint64_t offset,
+      std::function<void(Status, std::string)> callback) = 0;
+
   // Retrieves the entry with the given |key| and calls |on_done| with the
   // result. The status of |on_done| will be |OK| on success, |NOT_FOUND| if
   // there is no such key in the given commit or an error status on failure.
@@ -183,6 +201,20 @@ class PageStorage {
       std::function<bool(EntryChange)> on_next_diff,
       std::function<void(Status)> on_done) = 0;
 
+  // Iterates over the keys whose entry in |left_commit| or in |right_commit|
+  // differs from the one in |base_commit|, and calls |on_next_diff| with the
+  // three entries of each key, in key order. Returning false from
+  // |on_next_diff| will immediately stop the iteration. |on_done| is called
+  // once, upon successfull completion, i.e. when there are no more differences
+  // or iteration was interrupted, or if an error occurs.
+  virtual void GetThreeWayContentsDiff(
+      const Commit& base_commit,
+      const Commit& left_commit,
+      const Commit& right_commit,
+      std::string min_key,
+      std::function<bool(ThreeWayChange)> on_next_diff,
+      std::function<void(Status)> on_done) = 0;
+
  private:
   FTL_DISALLOW_COPY_AND_ASSIGN(PageStorage);
 };
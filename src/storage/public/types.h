@@ -5,6 +5,7 @@
 #ifndef APPS_LEDGER_SRC_STORAGE_PUBLIC_TYPES_H_
 #define APPS_LEDGER_SRC_STORAGE_PUBLIC_TYPES_H_
 
+#include <memory>
 #include <ostream>
 #include <string>
 
@@ -28,6 +29,16 @@ enum class KeyPriority {
   LAZY,
 };
 
+// The priority at which an object missing locally is downloaded from the
+// cloud.
+enum class DownloadPriority {
+  // A client is waiting for the object.
+  FOREGROUND,
+  // The object is downloaded speculatively, and must not delay the downloads
+  // of the objects clients are waiting for.
+  BACKGROUND,
+};
+
 // An entry in a commit.
 struct Entry {
   std::string key;
@@ -47,6 +58,15 @@ struct EntryChange {
 bool operator==(const EntryChange& lhs, const EntryChange& rhs);
 bool operator!=(const EntryChange& lhs, const EntryChange& rhs);
 
+// The entries of a key in the common ancestor (|base|) and in the two commits
+// of a merge. An entry is null if the key is absent from the corresponding
+// commit.
+struct ThreeWayChange {
+  std::unique_ptr<Entry> base;
+  std::unique_ptr<Entry> left;
+  std::unique_ptr<Entry> right;
+};
+
 enum class ChangeSource { LOCAL, SYNC };
 
 enum class JournalType { IMPLICIT, EXPLICIT };
@@ -146,6 +146,23 @@ void PageStorageEmptyImpl::GetCommitContents(
   on_done(Status::NOT_IMPLEMENTED);
 }
 
+void PageStorageEmptyImpl::GetCommitContentsCount(
+    const Commit& commit,
+    std::string prefix,
+    std::function<void(Status, uint64_t)> callback) {
+  FTL_NOTIMPLEMENTED();
+  callback(Status::NOT_IMPLEMENTED, 0u);
+}
+
+void PageStorageEmptyImpl::GetCommitKeyAtOffset(
+    const Commit& commit,
+    std::string min_key,
+    uint64_t offset,
+    std::function<void(Status, std::string)> callback) {
+  FTL_NOTIMPLEMENTED();
+  callback(Status::NOT_IMPLEMENTED, "");
+}
+
 void PageStorageEmptyImpl::GetEntryFromCommit(
     const Commit& commit,
     std::string key,
@@ -164,5 +181,16 @@ void PageStorageEmptyImpl::GetCommitContentsDiff(
   on_done(Status::NOT_IMPLEMENTED);
 }
 
+void PageStorageEmptyImpl::GetThreeWayContentsDiff(
+    const Commit& base_commit,
+    const Commit& left_commit,
+    const Commit& right_commit,
+    std::string min_key,
+    std::function<bool(ThreeWayChange)> on_next_diff,
+    std::function<void(Status)> on_done) {
+  FTL_NOTIMPLEMENTED();
+  on_done(Status::NOT_IMPLEMENTED);
+}
+
 }  // namespace test
 }  // namespace storage
@@ -91,6 +91,17 @@ class PageStorageEmptyImpl : public PageStorage {
                          std::function<bool(Entry)> on_next,
                          std::function<void(Status)> on_done) override;
 
+  void GetCommitContentsCount(
+      const Commit& commit,
+      std::string prefix,
+      std::function<void(Status, uint64_t)> callback) override;
+
+  void GetCommitKeyAtOffset(
+      const Commit& commit,
+      std::string min_key,
+      uint64_t offset,
+      std::function<void(Status, std::string)> callback) override;
+
   void GetEntryFromCommit(const Commit& commit,
                           std::string key,
                           std::function<void(Status, Entry)> callback) override;
@@ -100,6 +111,14 @@ class PageStorageEmptyImpl : public PageStorage {
                              std::string min_key,
                              std::function<bool(EntryChange)> on_next_diff,
                              std::function<void(Status)> on_done) override;
+
+  void GetThreeWayContentsDiff(
+      const Commit& base_commit,
+      const Commit& left_commit,
+      const Commit& right_commit,
+      std::string min_key,
+      std::function<bool(ThreeWayChange)> on_next_diff,
+      std::function<void(Status)> on_done) override;
 };
 
 }  // namespace test
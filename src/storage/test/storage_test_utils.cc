@@ -188,7 +188,7 @@ StorageTest::~StorageTest(){};
   Status status;
   ObjectId id;
   TreeNode::FromEntries(
-      GetStorage(), 0u, entries, children,
+      GetStorage(), 0u, entries, children, std::vector<SubtreeSummary>(),
       callback::Capture([this] { message_loop_.PostQuitTask(); }, &status,
                         &id));
 
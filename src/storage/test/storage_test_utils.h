@@ -92,7 +92,7 @@ class StorageTest : public ::test::TestWithMessageLoop {
       std::unique_ptr<const TreeNode>* node);
 
   // Creates a new tree node from the given entries and children and updates
-  // |node| with the result.
+  // |node| with the result. The node is written without subtree summaries.
   ::testing::AssertionResult CreateNodeFromEntries(
       const std::vector<Entry>& entries,
       const std::vector<ObjectId>& children,
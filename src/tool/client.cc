@@ -13,6 +13,7 @@
 #include "apps/ledger/src/firebase/encoding.h"
 #include "apps/ledger/src/tool/clean_command.h"
 #include "apps/ledger/src/tool/doctor_command.h"
+#include "apps/ledger/src/tool/metrics_command.h"
 #include "apps/network/services/network_service.fidl.h"
 #include "lib/ftl/files/file.h"
 #include "lib/ftl/strings/concatenate.h"
@@ -25,6 +26,7 @@ namespace {
 
 constexpr ftl::StringView kUserIdFlag = "user-id";
 constexpr ftl::StringView kForceFlag = "force";
+constexpr ftl::StringView kResetFlag = "reset";
 
 // Inverse of the transformation currently used by DeviceRunner to translate
 // human-readable username to user ID.
@@ -72,12 +74,15 @@ void ClientApp::PrintUsage() {
   std::cout << "Options:" << std::endl;
   std::cout << " --user-id=<string> overrides the user ID to use" << std::endl;
   std::cout << " --force skips confirmation dialogs" << std::endl;
+  std::cout << " --reset resets the metrics after printing them" << std::endl;
   std::cout << "Commands:" << std::endl;
   std::cout << " - `doctor` - checks up the Ledger configuration (default)"
             << std::endl;
   std::cout
       << " - `clean` - wipes remote and local data of the most recent user "
       << std::endl;
+  std::cout << " - `metrics [<path prefix>]` - prints the metrics of the "
+            << "running Ledger" << std::endl;
 }
 
 std::unique_ptr<Command> ClientApp::CommandFromArgs(
@@ -108,6 +113,16 @@ std::unique_ptr<Command> ClientApp::CommandFromArgs(
         command_line_.HasOption(kForceFlag.ToString()));
   }
 
+  if (args[0] == "metrics") {
+    if (args.size() > 2) {
+      FTL_LOG(ERROR) << "Too many arguments for the " << args[0] << " command";
+      return nullptr;
+    }
+    return std::make_unique<MetricsCommand>(
+        user_repository_path_, args.size() > 1 ? args[1] : "",
+        command_line_.HasOption(kResetFlag.ToString()));
+  }
+
   return nullptr;
 }
 
@@ -118,7 +133,7 @@ bool ClientApp::Initialize() {
   }
 
   const std::unordered_set<std::string> known_options = {
-      kForceFlag.ToString(), kUserIdFlag.ToString()};
+      kForceFlag.ToString(), kResetFlag.ToString(), kUserIdFlag.ToString()};
 
   for (auto& option : command_line_.options()) {
     if (known_options.count(option.name) == 0) {
@@ -128,7 +143,8 @@ bool ClientApp::Initialize() {
     }
   }
 
-  std::unordered_set<std::string> valid_commands = {"doctor", "clean"};
+  std::unordered_set<std::string> valid_commands = {"doctor", "clean",
+                                                    "metrics"};
   const std::vector<std::string>& args = command_line_.positional_args();
   if (args.size() && valid_commands.count(args[0]) == 0) {
     FTL_LOG(ERROR) << "Unknown command: " << args[0];
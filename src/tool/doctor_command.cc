@@ -150,7 +150,8 @@ void DoctorCommand::CheckHttpConnectivity() {
         ftl::TimeDelta delta = ftl::TimePoint::Now() - request_start;
         ok(delta);
         CheckHttpsConnectivity();
-      });
+      },
+      ledger::RequestPriority::INTERACTIVE);
 }
 
 void DoctorCommand::CheckHttpsConnectivity() {
@@ -177,7 +178,8 @@ void DoctorCommand::CheckHttpsConnectivity() {
         ftl::TimeDelta delta = ftl::TimePoint::Now() - request_start;
         ok(delta);
         CheckObjects();
-      });
+      },
+      ledger::RequestPriority::INTERACTIVE);
 }
 
 void DoctorCommand::CheckObjects() {
@@ -214,7 +216,7 @@ void DoctorCommand::CheckObjects() {
 void DoctorCommand::CheckGetObject(std::string id,
                                    std::string expected_content) {
   what("GCS - retrieve test object");
-  cloud_provider_->GetObject(id, [
+  cloud_provider_->GetObject(id, ledger::RequestPriority::INTERACTIVE, [
     this, expected_content = std::move(expected_content),
     request_start = ftl::TimePoint::Now()
   ](cloud_provider::Status status, uint64_t size, mx::socket data) {
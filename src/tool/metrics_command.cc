@@ -0,0 +1,114 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "apps/ledger/src/tool/metrics_command.h"
+
+#include <iostream>
+
+#include "apps/ledger/src/app/constants.h"
+#include "apps/ledger/src/metrics/metrics_encoding.h"
+#include "lib/ftl/files/file.h"
+#include "lib/ftl/files/path.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/strings/concatenate.h"
+#include "lib/mtl/tasks/message_loop.h"
+
+namespace tool {
+
+namespace {
+
+// The Ledger checks for a request every second, see ledger::MetricsExporter.
+constexpr ftl::TimeDelta kTimeout = ftl::TimeDelta::FromSeconds(10);
+constexpr ftl::TimeDelta kPollPeriod = ftl::TimeDelta::FromMilliseconds(100);
+
+}  // namespace
+
+MetricsCommand::MetricsCommand(const std::string& user_repository_path,
+                               ftl::StringView path_prefix,
+                               bool reset)
+    : request_path_(ftl::Concatenate(
+          {user_repository_path, "/", ledger::kMetricsRequestFilename})),
+      metrics_path_(ftl::Concatenate(
+          {user_repository_path, "/", ledger::kMetricsFilename})),
+      path_prefix_(path_prefix.ToString()),
+      reset_(reset) {}
+
+void MetricsCommand::Start(ftl::Closure on_done) {
+  // Discard the answer to a previous request.
+  files::DeletePath(metrics_path_, false);
+  ftl::StringView request = reset_ ? ledger::kMetricsResetRequest : "";
+  if (!files::WriteFile(request_path_, request.data(), request.size())) {
+    FTL_LOG(ERROR) << "Unable to write the metrics request to "
+                   << request_path_;
+    on_done();
+    return;
+  }
+  WaitForMetrics(ftl::TimePoint::Now() + kTimeout, std::move(on_done));
+}
+
+void MetricsCommand::WaitForMetrics(ftl::TimePoint deadline,
+                                    ftl::Closure on_done) {
+  if (!files::IsFile(metrics_path_)) {
+    if (ftl::TimePoint::Now() > deadline) {
+      FTL_LOG(ERROR) << "The Ledger did not answer. Is it running for this "
+                     << "user?";
+      files::DeletePath(request_path_, false);
+      on_done();
+      return;
+    }
+    mtl::MessageLoop::GetCurrent()->task_runner()->PostDelayedTask(
+        [this, deadline, on_done] { WaitForMetrics(deadline, on_done); },
+        kPollPeriod);
+    return;
+  }
+
+  std::string data;
+  std::vector<metrics::MetricValue> metrics;
+  if (!files::ReadFileToString(metrics_path_, &data) ||
+      !metrics::DecodeMetrics(data, &metrics)) {
+    FTL_LOG(ERROR) << "Unable to read the metrics from " << metrics_path_;
+    on_done();
+    return;
+  }
+  files::DeletePath(metrics_path_, false);
+  PrintMetrics(metrics);
+  if (reset_) {
+    std::cout << "Metrics reset." << std::endl;
+  }
+  on_done();
+}
+
+void MetricsCommand::PrintMetrics(
+    const std::vector<metrics::MetricValue>& metrics) {
+  bool first = true;
+  std::string current_path;
+  for (const auto& metric : metrics) {
+    if (ftl::StringView(metric.path).substr(0, path_prefix_.size()) !=
+        path_prefix_) {
+      continue;
+    }
+    if (first || metric.path != current_path) {
+      first = false;
+      current_path = metric.path;
+      std::cout << (current_path.empty() ? "<root>" : current_path) << ":"
+                << std::endl;
+    }
+    std::cout << "  " << metric.name << ": ";
+    switch (metric.type) {
+      case metrics::MetricValue::Type::COUNTER:
+      case metrics::MetricValue::Type::GAUGE:
+        std::cout << metric.value << std::endl;
+        break;
+      case metrics::MetricValue::Type::HISTOGRAM:
+        std::cout << metric.count << " samples";
+        if (metric.count > 0) {
+          std::cout << ", mean " << metric.sum / metric.count << "us";
+        }
+        std::cout << std::endl;
+        break;
+    }
+  }
+}
+
+}  // namespace tool
@@ -0,0 +1,49 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef APPS_LEDGER_SRC_TOOL_METRICS_COMMAND_H_
+#define APPS_LEDGER_SRC_TOOL_METRICS_COMMAND_H_
+
+#include <string>
+#include <vector>
+
+#include "apps/ledger/src/metrics/metrics_registry.h"
+#include "apps/ledger/src/tool/command.h"
+#include "lib/ftl/strings/string_view.h"
+#include "lib/ftl/time/time_point.h"
+
+namespace tool {
+
+// Command that prints the metrics of the running Ledger, optionally restricted
+// to the repositories, ledgers or pages whose path starts with a given prefix.
+// The metrics are requested through the repository dir of the user, in which
+// the Ledger answers with them.
+class MetricsCommand : public Command {
+ public:
+  MetricsCommand(const std::string& user_repository_path,
+                 ftl::StringView path_prefix,
+                 bool reset);
+  ~MetricsCommand() {}
+
+  // Command:
+  void Start(ftl::Closure on_done) override;
+
+ private:
+  // Prints the metrics once the Ledger has answered, or fails after
+  // |deadline|.
+  void WaitForMetrics(ftl::TimePoint deadline, ftl::Closure on_done);
+
+  void PrintMetrics(const std::vector<metrics::MetricValue>& metrics);
+
+  const std::string request_path_;
+  const std::string metrics_path_;
+  const std::string path_prefix_;
+  const bool reset_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(MetricsCommand);
+};
+
+}  // namespace tool
+
+#endif  // APPS_LEDGER_SRC_TOOL_METRICS_COMMAND_H_